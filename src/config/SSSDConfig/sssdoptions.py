@@ -91,6 +91,7 @@ class SSSDOptions(object):
         'pam_verbosity': _('What kind of messages are displayed to the user during authentication'),
         'pam_response_filter': _('Filter PAM responses sent to the pam_sss'),
         'pam_id_timeout': _('How many seconds to keep identity information cached for PAM requests'),
+        'pam_auth_cache_timeout': _('How many seconds to remember a successful online authentication in memory'),
         'pam_pwd_expiration_warning': _('How many days before password expiration a warning should be displayed'),
         'pam_trusted_users': _('List of trusted uids or user\'s name'),
         'pam_public_domains': _('List of domains accessible even for untrusted users.'),
@@ -103,6 +104,7 @@ class SSSDOptions(object):
         'pam_p11_allowed_services': _('Allowed services for using smartcards'),
         'p11_wait_for_card_timeout': _('Additional timeout to wait for a card if requested'),
         'p11_uri': _('PKCS#11 URI to restrict the selection of devices for Smartcard authentication'),
+        'p11_child_persistent': _('Keep one p11_child running to handle all Smartcard requests'),
         'pam_initgroups_scheme' : _('When shall the PAM responder force an initgroups request'),
 
         # [sudo]
@@ -205,6 +207,9 @@ class SSSDOptions(object):
         'entry_cache_sudo_timeout': _('Entry cache timeout length (seconds)'),
         'entry_cache_resolver_timeout' : _('Entry cache timeout length (seconds)'),
         'refresh_expired_interval': _('How often should expired entries be refreshed in background'),
+        'max_initgroups_requests': _('Maximum number of concurrent initgroups requests sent to the backend'),
+        'max_refresh_requests': _('Maximum number of concurrent background refresh requests'),
+        'max_enumeration_requests': _('Maximum number of concurrent enumeration requests'),
         'dyndns_update': _("Whether to automatically update the client's DNS entry"),
         'dyndns_ttl': _("The TTL to apply to the client's DNS entry after updating it"),
         'dyndns_iface': _("The interface whose IP should be used for dynamic DNS updates"),
@@ -260,6 +265,7 @@ class SSSDOptions(object):
         'ipa_deskprofile_request_interval': _("The amount of time in minutes between lookups of Desktop Profiles "
                                               "rules against the IPA server when the last request did not find any "
                                               "rule"),
+        'ipa_extdom_max_in_flight': _("Maximum number of extdom requests sent to the IPA server in parallel"),
         'ipa_host_fqdn': _('The LDAP attribute that contains FQDN of the host.'),
         'ipa_host_object_class': _('The object class of a host entry in LDAP.'),
         'ipa_host_search_base': _('Use the given string as search base for host objects.'),
@@ -323,6 +329,8 @@ class SSSDOptions(object):
                                                       'database'),
         'ad_use_ldaps': _('Use LDAPS port for LDAP and Global Catalog requests'),
         'ad_allow_remote_domain_local_groups' : _('Do not filter domain local groups from other domains'),
+        'ad_pac_lazy_groups': _('Store the groups from the PAC without looking them up and resolve their names in the background'),
+        'ad_tokengroups_gc_lookup': _('Look up the groups of a user found in tokenGroups in the Global Catalog first'),
 
         # [provider/krb5]
         'krb5_kdcip': _('Kerberos server address'),
@@ -347,6 +355,10 @@ class SSSDOptions(object):
         'krb5_canonicalize': _("Enables principal canonicalization"),
         'krb5_use_enterprise_principal': _("Enables enterprise principals"),
         'krb5_map_user': _('A mapping from user names to Kerberos principal names'),
+        'krb5_child_pool_size': _('Number of krb5_child worker processes kept running'),
+        'krb5_child_pool_max_requests': _('Number of requests after which a krb5_child worker is replaced'),
+        'krb5_renew_threshold': _('Percentage of the TGT lifetime after which it is renewed'),
+        'krb5_renew_max_parallel': _('Maximal number of TGT renewals running at the same time'),
 
         # [provider/krb5/chpass]
         'krb5_kpasswd': _('Server where the change password service is running if not on the KDC'),
@@ -384,6 +396,8 @@ class SSSDOptions(object):
         'ldap_dns_service_name': _('Service name for DNS service lookups'),
         'ldap_page_size': _('The number of records to retrieve in a single LDAP query'),
         'ldap_deref_threshold': _('The number of members that must be missing to trigger a full deref'),
+        'ldap_nested_group_batch_size': _('Maximum number of missing group members looked up in a single search'),
+        'ldap_nested_group_cache_timeout': _('How long to keep resolved nested group members in memory'),
         'ldap_sasl_canonicalize': _('Whether the LDAP library should perform a reverse lookup to canonicalize the '
                                     'host name during a SASL bind'),
         'ldap_rfc2307_fallback_to_local_users': _('Allows to retain local users as members of an LDAP group for '
@@ -612,6 +612,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'entry_cache_ssh_host_timeout',
             'entry_cache_resolver_timeout',
             'refresh_expired_interval',
+            'max_initgroups_requests',
+            'max_refresh_requests',
+            'max_enumeration_requests',
             'lookup_family_order',
             'account_cache_expiration',
             'dns_resolver_server_timeout',
@@ -737,7 +740,11 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_canonicalize',
              'krb5_use_enterprise_principal',
              'krb5_use_kdcinfo',
-             'krb5_map_user'])
+             'krb5_map_user',
+             'krb5_child_pool_size',
+             'krb5_child_pool_max_requests',
+             'krb5_renew_threshold',
+             'krb5_renew_max_parallel'])
 
         options = domain.list_options()
 
@@ -900,7 +907,11 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'krb5_canonicalize',
             'krb5_use_enterprise_principal',
             'krb5_use_kdcinfo',
-            'krb5_map_user']
+            'krb5_map_user',
+            'krb5_child_pool_size',
+            'krb5_child_pool_max_requests',
+            'krb5_renew_threshold',
+            'krb5_renew_max_parallel']
 
         self.assertTrue(type(options) == dict,
                         "Options should be a dictionary")
@@ -989,6 +1000,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'entry_cache_ssh_host_timeout',
             'entry_cache_resolver_timeout',
             'refresh_expired_interval',
+            'max_initgroups_requests',
+            'max_refresh_requests',
+            'max_enumeration_requests',
             'account_cache_expiration',
             'lookup_family_order',
             'dns_resolver_server_timeout',
@@ -1115,7 +1129,11 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_canonicalize',
              'krb5_use_enterprise_principal',
              'krb5_use_kdcinfo',
-             'krb5_map_user'])
+             'krb5_map_user',
+             'krb5_child_pool_size',
+             'krb5_child_pool_max_requests',
+             'krb5_renew_threshold',
+             'krb5_renew_max_parallel'])
 
         options = domain.list_options()
 
@@ -146,6 +146,7 @@
 #define SYSDB_AUTH_TYPE "authType"
 #define SYSDB_USER_CERT "userCertificate"
 #define SYSDB_USER_MAPPED_CERT "userMappedCertificate"
+#define SYSDB_USER_MAPPED_CERT_HASH "userMappedCertificateHash"
 #define SYSDB_USER_EMAIL "mail"
 
 #define SYSDB_SUBDOMAIN_REALM "realmName"
@@ -157,6 +158,8 @@
 #define SYSDB_SUBDOMAIN_TRUST_DIRECTION "trustDirection"
 #define SYSDB_UPN_SUFFIXES "upnSuffixes"
 #define SYSDB_SITE "site"
+#define SYSDB_SITE_FOREST "siteForest"
+#define SYSDB_DC_RANKING "dcRanking"
 #define SYSDB_ENABLED "enabled"
 
 #define SYSDB_BASE_ID "baseID"
@@ -226,6 +229,8 @@
 #define SYSDB_NAME_FILTER "(&(|("SYSDB_UC")("SYSDB_GC"))(|("SYSDB_NAME_ALIAS"=%s)("SYSDB_NAME"=%s)))"
 #define SYSDB_ID_FILTER "(|(&("SYSDB_UC")("SYSDB_UIDNUM"=%u))(&("SYSDB_GC")("SYSDB_GIDNUM"=%u)))"
 #define SYSDB_USER_CERT_FILTER "(&("SYSDB_UC")%s)"
+#define SYSDB_USER_CERT_HASH_FILTER \
+    "(&("SYSDB_UC")("SYSDB_USER_MAPPED_CERT_HASH"=%s))"
 
 #define SYSDB_HAS_ENUMERATED "has_enumerated"
 #define SYSDB_HAS_ENUMERATED_ID       0x00000001
@@ -327,6 +332,7 @@
 
 struct confdb_ctx;
 struct sysdb_ctx;
+struct s3crypt_pool;
 
 struct sysdb_attrs {
     int num;
@@ -528,6 +534,25 @@ errno_t
 sysdb_set_site(struct sss_domain_info *dom,
                const char *site);
 
+errno_t
+sysdb_get_site_forest(TALLOC_CTX *mem_ctx,
+                      struct sss_domain_info *dom,
+                      const char **_forest);
+
+errno_t
+sysdb_set_site_forest(struct sss_domain_info *dom,
+                      const char *forest);
+
+/* Domain controllers ordered from the most to the least responsive one. */
+errno_t
+sysdb_get_dc_ranking(TALLOC_CTX *mem_ctx,
+                     struct sss_domain_info *dom,
+                     const char ***_dcs);
+
+errno_t
+sysdb_set_dc_ranking(struct sss_domain_info *dom,
+                     const char * const *dcs);
+
 errno_t
 sysdb_domain_set_enabled(struct sysdb_ctx *sysdb,
                          const char *name,
@@ -546,9 +571,26 @@ errno_t sysdb_subdomain_store(struct sysdb_ctx *sysdb,
                               uint32_t trust_direction,
                               struct ldb_message_element *upn_suffixes);
 
+/* Like sysdb_subdomain_store(), _changed is set to true if the cached
+ * entry was created or modified. */
+errno_t sysdb_subdomain_store_ext(struct sysdb_ctx *sysdb,
+                                  const char *name, const char *realm,
+                                  const char *flat_name, const char *domain_id,
+                                  enum sss_domain_mpg_mode mpg_mode,
+                                  bool enumerate, const char *forest,
+                                  uint32_t trust_direction,
+                                  struct ldb_message_element *upn_suffixes,
+                                  bool *_changed);
+
 errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                                 struct confdb_ctx *confdb);
 
+/* Like sysdb_update_subdomains(), _changed is set to true if a subdomain
+ * was added, enabled, disabled or any of its properties changed. */
+errno_t sysdb_update_subdomains_ext(struct sss_domain_info *domain,
+                                    struct confdb_ctx *confdb,
+                                    bool *_changed);
+
 errno_t sysdb_master_domain_update(struct sss_domain_info *domain);
 
 errno_t sysdb_master_domain_add_info(struct sss_domain_info *domain,
@@ -1189,6 +1231,19 @@ int sysdb_cache_password_ex(struct sss_domain_info *domain,
                             enum sss_authtok_type authtok_type,
                             size_t second_factor_size);
 
+/* Same as sysdb_cache_password_ex() but the password is hashed in one of
+ * the threads of pool, see util/s3crypt_pool.h. The cache is written from
+ * the event loop. */
+struct tevent_req *sysdb_cache_password_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct s3crypt_pool *pool,
+                                             struct sss_domain_info *domain,
+                                             const char *username,
+                                             const char *password,
+                                             enum sss_authtok_type authtok_type,
+                                             size_t second_factor_len);
+errno_t sysdb_cache_password_recv(struct tevent_req *req);
+
 errno_t check_failed_login_attempts(struct confdb_ctx *cdb,
                                     struct ldb_message *ldb_msg,
                                     uint32_t *failed_login_attempts,
@@ -1201,6 +1256,21 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
                      time_t *_expire_date,
                      time_t *_delayed_until);
 
+/* Same as sysdb_cache_auth() but the password is hashed in one of the
+ * threads of pool. The expire date and delay are returned also when the
+ * authentication fails. */
+struct tevent_req *sysdb_cache_auth_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         struct s3crypt_pool *pool,
+                                         struct sss_domain_info *domain,
+                                         const char *name,
+                                         const char *password,
+                                         struct confdb_ctx *cdb,
+                                         bool just_check);
+errno_t sysdb_cache_auth_recv(struct tevent_req *req,
+                              time_t *_expire_date,
+                              time_t *_delayed_until);
+
 int sysdb_store_custom(struct sss_domain_info *domain,
                        const char *object_name,
                        const char *subtree_name,
@@ -26,6 +26,7 @@
 #include "db/sysdb_iphosts.h"
 #include "db/sysdb_ipnetworks.h"
 #include "util/crypto/sss_crypto.h"
+#include "util/s3crypt_pool.h"
 #include "util/cert.h"
 #include <time.h>
 
@@ -1299,6 +1300,43 @@ static errno_t sysdb_create_ts_usr(struct sss_domain_info *domain,
 }
 
 /* =Replace-Attributes-On-Entry=========================================== */
+errno_t sysdb_msg_add_mapped_cert_hashes(struct ldb_message *msg)
+{
+    struct ldb_message_element *el;
+    unsigned int num_values;
+    unsigned int c;
+    char *hash;
+    int lret;
+
+    el = ldb_msg_find_element(msg, SYSDB_USER_MAPPED_CERT);
+    if (el == NULL) {
+        return EOK;
+    }
+
+    /* ldb_msg_add_empty() might move the elements of msg */
+    num_values = el->num_values;
+    lret = ldb_msg_add_empty(msg, SYSDB_USER_MAPPED_CERT_HASH, el->flags, NULL);
+    if (lret != LDB_SUCCESS) {
+        return sysdb_error_to_errno(lret);
+    }
+
+    for (c = 0; c < num_values; c++) {
+        el = ldb_msg_find_element(msg, SYSDB_USER_MAPPED_CERT);
+        hash = sss_sha256_hex(msg, el->values[c].data, el->values[c].length);
+        if (hash == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "Failed to hash mapped certificate.\n");
+            return ENOMEM;
+        }
+
+        lret = ldb_msg_add_steal_string(msg, SYSDB_USER_MAPPED_CERT_HASH, hash);
+        if (lret != LDB_SUCCESS) {
+            return sysdb_error_to_errno(lret);
+        }
+    }
+
+    return EOK;
+}
+
 static int sysdb_set_cache_entry_attr(struct ldb_context *ldb,
                                       struct ldb_dn *entry_dn,
                                       struct sysdb_attrs *attrs,
@@ -1325,6 +1363,11 @@ static int sysdb_set_cache_entry_attr(struct ldb_context *ldb,
         goto done;
     }
 
+    ret = sysdb_msg_add_mapped_cert_hashes(msg);
+    if (ret != EOK) {
+        goto done;
+    }
+
     lret = ldb_modify(ldb, msg);
     if (lret != LDB_SUCCESS) {
         DEBUG(SSSDBG_MINOR_FAILURE,
@@ -3232,16 +3275,14 @@ int sysdb_remove_group_member(struct sss_domain_info *domain,
 
 /* =Password-Caching====================================================== */
 
-int sysdb_cache_password_ex(struct sss_domain_info *domain,
-                            const char *username,
-                            const char *password,
-                            enum sss_authtok_type authtok_type,
-                            size_t second_factor_len)
+static int sysdb_store_password_hash(struct sss_domain_info *domain,
+                                     const char *username,
+                                     const char *hash,
+                                     enum sss_authtok_type authtok_type,
+                                     size_t second_factor_len)
 {
     TALLOC_CTX *tmp_ctx;
     struct sysdb_attrs *attrs;
-    char *hash = NULL;
-    char *salt;
     int ret;
 
     tmp_ctx = talloc_new(NULL);
@@ -3249,18 +3290,6 @@ int sysdb_cache_password_ex(struct sss_domain_info *domain,
         return ENOMEM;
     }
 
-    ret = s3crypt_gen_salt(tmp_ctx, &salt);
-    if (ret) {
-        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to generate random salt.\n");
-        goto fail;
-    }
-
-    ret = s3crypt_sha512(tmp_ctx, password, salt, &hash);
-    if (ret) {
-        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to create password hash.\n");
-        goto fail;
-    }
-
     attrs = sysdb_new_attrs(tmp_ctx);
     if (!attrs) {
         ERROR_OUT(ret, ENOMEM, fail);
@@ -3302,6 +3331,42 @@ fail:
     return ret;
 }
 
+int sysdb_cache_password_ex(struct sss_domain_info *domain,
+                            const char *username,
+                            const char *password,
+                            enum sss_authtok_type authtok_type,
+                            size_t second_factor_len)
+{
+    TALLOC_CTX *tmp_ctx;
+    char *hash = NULL;
+    char *salt;
+    int ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    ret = s3crypt_gen_salt(tmp_ctx, &salt);
+    if (ret) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to generate random salt.\n");
+        goto done;
+    }
+
+    ret = s3crypt_sha512(tmp_ctx, password, salt, &hash);
+    if (ret) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to create password hash.\n");
+        goto done;
+    }
+
+    ret = sysdb_store_password_hash(domain, username, hash,
+                                    authtok_type, second_factor_len);
+
+done:
+    talloc_zfree(tmp_ctx);
+    return ret;
+}
+
 int sysdb_cache_password(struct sss_domain_info *domain,
                          const char *username,
                          const char *password)
@@ -3310,6 +3375,105 @@ int sysdb_cache_password(struct sss_domain_info *domain,
                                    SSS_AUTHTOK_TYPE_PASSWORD, 0);
 }
 
+struct sysdb_cache_password_state {
+    struct sss_domain_info *domain;
+    const char *username;
+    enum sss_authtok_type authtok_type;
+    size_t second_factor_len;
+};
+
+static void sysdb_cache_password_done(struct tevent_req *subreq);
+
+struct tevent_req *sysdb_cache_password_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct s3crypt_pool *pool,
+                                             struct sss_domain_info *domain,
+                                             const char *username,
+                                             const char *password,
+                                             enum sss_authtok_type authtok_type,
+                                             size_t second_factor_len)
+{
+    struct sysdb_cache_password_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+    char *salt;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sysdb_cache_password_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->domain = domain;
+    state->authtok_type = authtok_type;
+    state->second_factor_len = second_factor_len;
+    state->username = talloc_strdup(state, username);
+    if (state->username == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    ret = s3crypt_gen_salt(state, &salt);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to generate random salt.\n");
+        goto immediately;
+    }
+
+    subreq = s3crypt_sha512_send(state, ev, pool, password, salt);
+    if (subreq == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    tevent_req_set_callback(subreq, sysdb_cache_password_done, req);
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void sysdb_cache_password_done(struct tevent_req *subreq)
+{
+    struct sysdb_cache_password_state *state;
+    struct tevent_req *req;
+    char *hash;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sysdb_cache_password_state);
+
+    ret = s3crypt_sha512_recv(state, subreq, &hash);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to create password hash.\n");
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = sysdb_store_password_hash(state->domain, state->username, hash,
+                                    state->authtok_type,
+                                    state->second_factor_len);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+errno_t sysdb_cache_password_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 static errno_t set_initgroups_expire_attribute(struct sss_domain_info *domain,
                                                const char *name)
 {
@@ -4606,19 +4770,18 @@ done:
     return ret;
 }
 
-static errno_t check_for_combined_2fa_password(struct sss_domain_info *domain,
-                                               struct ldb_message *ldb_msg,
-                                               const char *password,
-                                               const char *userhash)
+/* If the cached password is a combined 2FA password returns its first
+ * factor part of the given password, otherwise EINVAL. */
+static errno_t get_combined_2fa_first_factor(TALLOC_CTX *mem_ctx,
+                                             struct sss_domain_info *domain,
+                                             struct ldb_message *ldb_msg,
+                                             const char *password,
+                                             char **_short_pw)
 {
-
     unsigned int cached_authtok_type;
     unsigned int cached_fa2_len;
     char *short_pw;
-    char *comphash;
     size_t pw_len;
-    TALLOC_CTX *tmp_ctx;
-    int ret;
 
     cached_authtok_type = ldb_msg_find_attr_as_uint(ldb_msg,
                                                     SYSDB_CACHEDPWD_TYPE,
@@ -4641,20 +4804,39 @@ static errno_t check_for_combined_2fa_password(struct sss_domain_info *domain,
         return EINVAL;
     }
 
+    short_pw = talloc_strndup(mem_ctx, password, (pw_len - cached_fa2_len));
+    if (short_pw == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "talloc_strndup failed.\n");
+        return ENOMEM;
+    }
+    talloc_set_destructor((TALLOC_CTX *)short_pw,
+                          sss_erase_talloc_mem_securely);
+
+    *_short_pw = short_pw;
+    return EOK;
+}
+
+static errno_t check_for_combined_2fa_password(struct sss_domain_info *domain,
+                                               struct ldb_message *ldb_msg,
+                                               const char *password,
+                                               const char *userhash)
+{
+    char *short_pw;
+    char *comphash;
+    TALLOC_CTX *tmp_ctx;
+    int ret;
+
     tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "talloc_new failed.\n");
         return ENOMEM;
     }
 
-    short_pw = talloc_strndup(tmp_ctx, password, (pw_len - cached_fa2_len));
-    if (short_pw == NULL) {
-        DEBUG(SSSDBG_OP_FAILURE, "talloc_strndup failed.\n");
-        ret = ENOMEM;
+    ret = get_combined_2fa_first_factor(tmp_ctx, domain, ldb_msg, password,
+                                        &short_pw);
+    if (ret != EOK) {
         goto done;
     }
-    talloc_set_destructor((TALLOC_CTX *)short_pw,
-                          sss_erase_talloc_mem_securely);
 
     ret = s3crypt_sha512(tmp_ctx, short_pw, userhash, &comphash);
     if (ret != EOK) {
@@ -4678,33 +4860,10 @@ done:
     return ret;
 }
 
-int sysdb_cache_auth(struct sss_domain_info *domain,
-                     const char *name,
-                     const char *password,
-                     struct confdb_ctx *cdb,
-                     bool just_check,
-                     time_t *_expire_date,
-                     time_t *_delayed_until)
+static errno_t sysdb_cache_auth_check_args(struct sss_domain_info *domain,
+                                           const char *name,
+                                           struct confdb_ctx *cdb)
 {
-    TALLOC_CTX *tmp_ctx;
-    const char *attrs[] = { SYSDB_NAME, SYSDB_CACHEDPWD, SYSDB_DISABLED,
-                            SYSDB_LAST_LOGIN, SYSDB_LAST_ONLINE_AUTH,
-                            "lastCachedPasswordChange",
-                            "accountExpires", SYSDB_FAILED_LOGIN_ATTEMPTS,
-                            SYSDB_LAST_FAILED_LOGIN, SYSDB_CACHEDPWD_TYPE,
-                            SYSDB_CACHEDPWD_FA2_LEN, NULL };
-    struct ldb_message *ldb_msg;
-    const char *userhash;
-    char *comphash;
-    uint64_t lastLogin = 0;
-    int cred_expiration;
-    uint32_t failed_login_attempts = 0;
-    struct sysdb_attrs *update_attrs;
-    bool authentication_successful = false;
-    time_t expire_date = -1;
-    time_t delayed_until = -1;
-    int ret;
-
     if (name == NULL || *name == '\0') {
         DEBUG(SSSDBG_CRIT_FAILURE, "Missing user name.\n");
         return EINVAL;
@@ -4725,25 +4884,40 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
         return EINVAL;
     }
 
-    tmp_ctx = talloc_new(NULL);
-    if (!tmp_ctx) {
-        return ENOMEM;
-    }
+    return EOK;
+}
 
-    ret = ldb_transaction_start(domain->sysdb->ldb);
-    if (ret) {
-        talloc_zfree(tmp_ctx);
-        ret = sysdb_error_to_errno(ret);
-        return ret;
-    }
+/* Reads the cached user entry and checks whether offline authentication is
+ * allowed. Returns the stored password hash. */
+static errno_t sysdb_cache_auth_get_hash(TALLOC_CTX *mem_ctx,
+                                         struct sss_domain_info *domain,
+                                         const char *name,
+                                         struct confdb_ctx *cdb,
+                                         struct ldb_message **_ldb_msg,
+                                         const char **_userhash,
+                                         time_t *_expire_date,
+                                         time_t *_delayed_until)
+{
+    const char *attrs[] = { SYSDB_NAME, SYSDB_CACHEDPWD, SYSDB_DISABLED,
+                            SYSDB_LAST_LOGIN, SYSDB_LAST_ONLINE_AUTH,
+                            "lastCachedPasswordChange",
+                            "accountExpires", SYSDB_FAILED_LOGIN_ATTEMPTS,
+                            SYSDB_LAST_FAILED_LOGIN, SYSDB_CACHEDPWD_TYPE,
+                            SYSDB_CACHEDPWD_FA2_LEN, NULL };
+    struct ldb_message *ldb_msg;
+    const char *userhash;
+    uint64_t lastLogin = 0;
+    int cred_expiration;
+    uint32_t failed_login_attempts = 0;
+    int ret;
 
-    ret = sysdb_search_user_by_name(tmp_ctx, domain, name, attrs, &ldb_msg);
+    ret = sysdb_search_user_by_name(mem_ctx, domain, name, attrs, &ldb_msg);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "sysdb_search_user_by_name failed [%d][%s].\n",
                   ret, strerror(ret));
         if (ret == ENOENT) ret = ERR_ACCOUNT_UNKNOWN;
-        goto done;
+        return ret;
     }
 
     /* Check offline_auth_cache_timeout */
@@ -4756,28 +4930,27 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Failed to read expiration time of offline credentials.\n");
-        goto done;
+        return ret;
     }
     DEBUG(SSSDBG_TRACE_ALL, "Offline credentials expiration is [%d] days.\n",
               cred_expiration);
 
     if (cred_expiration) {
-        expire_date = lastLogin + (cred_expiration * 86400);
-        if (expire_date < time(NULL)) {
+        *_expire_date = lastLogin + (cred_expiration * 86400);
+        if (*_expire_date < time(NULL)) {
             DEBUG(SSSDBG_CONF_SETTINGS, "Cached user entry is too old.\n");
-            expire_date = 0;
-            ret = ERR_CACHED_CREDS_EXPIRED;
-            goto done;
+            *_expire_date = 0;
+            return ERR_CACHED_CREDS_EXPIRED;
         }
     } else {
-        expire_date = 0;
+        *_expire_date = 0;
     }
 
     ret = check_failed_login_attempts(cdb, ldb_msg, &failed_login_attempts,
-                                      &delayed_until);
+                                      _delayed_until);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to check login attempts\n");
-        goto done;
+        return ret;
     }
 
     /* TODO: verify user account (disabled, expired ...) */
@@ -4785,15 +4958,40 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
     userhash = ldb_msg_find_attr_as_string(ldb_msg, SYSDB_CACHEDPWD, NULL);
     if (userhash == NULL || *userhash == '\0') {
         DEBUG(SSSDBG_CONF_SETTINGS, "Cached credentials not available.\n");
-        ret = ERR_NO_CACHED_CREDS;
-        goto done;
+        return ERR_NO_CACHED_CREDS;
     }
 
-    ret = s3crypt_sha512(tmp_ctx, password, userhash, &comphash);
-    if (ret) {
-        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to create password hash.\n");
-        ret = ERR_INTERNAL;
-        goto done;
+    *_ldb_msg = ldb_msg;
+    *_userhash = userhash;
+    return EOK;
+}
+
+/* Records the result of an offline authentication in the cache. The entry
+ * is read again inside the transaction because other attempts for the same
+ * user might have run while the password was hashed. If they locked the
+ * account meanwhile, ERR_AUTH_DENIED is returned and nothing is written,
+ * even if the password was correct. If just_check is set, a successful
+ * authentication is only checked against the lockout. */
+static errno_t sysdb_cache_auth_store_result(struct sss_domain_info *domain,
+                                             const char *name,
+                                             struct confdb_ctx *cdb,
+                                             bool authentication_successful,
+                                             bool just_check,
+                                             time_t *_delayed_until)
+{
+    const char *attrs[] = { SYSDB_FAILED_LOGIN_ATTEMPTS,
+                            SYSDB_LAST_FAILED_LOGIN, NULL };
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *update_attrs;
+    struct ldb_message *ldb_msg;
+    uint32_t failed_login_attempts;
+    bool in_transaction = false;
+    errno_t sret;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
     }
 
     update_attrs = sysdb_new_attrs(tmp_ctx);
@@ -4803,13 +5001,29 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
         goto done;
     }
 
-    if (strcmp(userhash, comphash) == 0
-            || check_for_combined_2fa_password(domain, ldb_msg,
-                                               password, userhash) == EOK) {
-        /* TODO: probable good point for audit logging */
-        DEBUG(SSSDBG_CONF_SETTINGS, "Hashes do match!\n");
-        authentication_successful = true;
+    ret = sysdb_transaction_start(domain->sysdb);
+    if (ret != EOK) {
+        goto done;
+    }
+    in_transaction = true;
 
+    ret = sysdb_search_user_by_name(tmp_ctx, domain, name, attrs, &ldb_msg);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "sysdb_search_user_by_name failed [%d][%s].\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    ret = check_failed_login_attempts(cdb, ldb_msg, &failed_login_attempts,
+                                      _delayed_until);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Login attempts of [%s] were exceeded "
+              "while the password was checked.\n", name);
+        goto done;
+    }
+
+    if (authentication_successful) {
         if (just_check) {
             ret = EOK;
             goto done;
@@ -4820,7 +5034,6 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
         if (ret != EOK) {
             DEBUG(SSSDBG_MINOR_FAILURE, "sysdb_attrs_add_time_t failed, "
                       "but authentication is successful.\n");
-            ret = EOK;
             goto done;
         }
 
@@ -4829,14 +5042,9 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
         if (ret != EOK) {
             DEBUG(SSSDBG_MINOR_FAILURE, "sysdb_attrs_add_uint32 failed, "
                       "but authentication is successful.\n");
-            ret = EOK;
             goto done;
         }
-
     } else {
-        DEBUG(SSSDBG_CONF_SETTINGS, "Authentication failed.\n");
-        authentication_successful = false;
-
         ret = sysdb_attrs_add_time_t(update_attrs,
                                      SYSDB_LAST_FAILED_LOGIN,
                                      time(NULL));
@@ -4859,6 +5067,95 @@ int sysdb_cache_auth(struct sss_domain_info *domain,
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Failed to update Login attempt information!\n");
+        goto done;
+    }
+
+    ret = sysdb_transaction_commit(domain->sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to commit transaction!\n");
+        goto done;
+    }
+    in_transaction = false;
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(domain->sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not cancel transaction\n");
+        }
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+int sysdb_cache_auth(struct sss_domain_info *domain,
+                     const char *name,
+                     const char *password,
+                     struct confdb_ctx *cdb,
+                     bool just_check,
+                     time_t *_expire_date,
+                     time_t *_delayed_until)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_message *ldb_msg;
+    const char *userhash;
+    char *comphash;
+    bool authentication_successful = false;
+    time_t expire_date = -1;
+    time_t delayed_until = -1;
+    int ret;
+
+    ret = sysdb_cache_auth_check_args(domain, name, cdb);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    ret = ldb_transaction_start(domain->sysdb->ldb);
+    if (ret) {
+        talloc_zfree(tmp_ctx);
+        ret = sysdb_error_to_errno(ret);
+        return ret;
+    }
+
+    ret = sysdb_cache_auth_get_hash(tmp_ctx, domain, name, cdb, &ldb_msg,
+                                    &userhash, &expire_date, &delayed_until);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = s3crypt_sha512(tmp_ctx, password, userhash, &comphash);
+    if (ret) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to create password hash.\n");
+        ret = ERR_INTERNAL;
+        goto done;
+    }
+
+    if (strcmp(userhash, comphash) == 0
+            || check_for_combined_2fa_password(domain, ldb_msg,
+                                               password, userhash) == EOK) {
+        /* TODO: probable good point for audit logging */
+        DEBUG(SSSDBG_CONF_SETTINGS, "Hashes do match!\n");
+        authentication_successful = true;
+
+        if (just_check) {
+            ret = EOK;
+            goto done;
+        }
+    } else {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Authentication failed.\n");
+        authentication_successful = false;
+    }
+
+    ret = sysdb_cache_auth_store_result(domain, name, cdb,
+                                        authentication_successful, false,
+                                        &delayed_until);
+    if (ret == ERR_AUTH_DENIED) {
+        authentication_successful = false;
     }
 
 done:
@@ -4888,6 +5185,187 @@ done:
     return ret;
 }
 
+struct sysdb_cache_auth_state {
+    struct tevent_context *ev;
+    struct s3crypt_pool *pool;
+    struct sss_domain_info *domain;
+    struct confdb_ctx *cdb;
+    const char *name;
+    char *password;
+    bool just_check;
+
+    struct ldb_message *ldb_msg;
+    const char *userhash;
+    bool tried_first_factor;
+    time_t expire_date;
+    time_t delayed_until;
+};
+
+static void sysdb_cache_auth_hash_done(struct tevent_req *subreq);
+
+struct tevent_req *sysdb_cache_auth_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         struct s3crypt_pool *pool,
+                                         struct sss_domain_info *domain,
+                                         const char *name,
+                                         const char *password,
+                                         struct confdb_ctx *cdb,
+                                         bool just_check)
+{
+    struct sysdb_cache_auth_state *state;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct sysdb_cache_auth_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->pool = pool;
+    state->domain = domain;
+    state->cdb = cdb;
+    state->just_check = just_check;
+    state->expire_date = -1;
+    state->delayed_until = -1;
+
+    ret = sysdb_cache_auth_check_args(domain, name, cdb);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    state->name = talloc_strdup(state, name);
+    state->password = talloc_strdup(state, password);
+    if (state->name == NULL || state->password == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+    talloc_set_destructor((TALLOC_CTX *) state->password,
+                          sss_erase_talloc_mem_securely);
+
+    ret = sysdb_cache_auth_get_hash(state, domain, name, cdb,
+                                    &state->ldb_msg, &state->userhash,
+                                    &state->expire_date,
+                                    &state->delayed_until);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    subreq = s3crypt_sha512_send(state, ev, pool, state->password,
+                                 state->userhash);
+    if (subreq == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    tevent_req_set_callback(subreq, sysdb_cache_auth_hash_done, req);
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void sysdb_cache_auth_hash_done(struct tevent_req *subreq)
+{
+    struct sysdb_cache_auth_state *state;
+    struct tevent_req *req;
+    bool authentication_successful;
+    char *short_pw;
+    char *comphash;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sysdb_cache_auth_state);
+
+    ret = s3crypt_sha512_recv(state, subreq, &comphash);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to create password hash.\n");
+        tevent_req_error(req, ERR_INTERNAL);
+        return;
+    }
+
+    authentication_successful = (strcmp(state->userhash, comphash) == 0);
+    talloc_free(comphash);
+
+    if (!authentication_successful && !state->tried_first_factor) {
+        state->tried_first_factor = true;
+
+        ret = get_combined_2fa_first_factor(state, state->domain,
+                                            state->ldb_msg, state->password,
+                                            &short_pw);
+        if (ret == EOK) {
+            subreq = s3crypt_sha512_send(state, state->ev, state->pool,
+                                         short_pw, state->userhash);
+            talloc_free(short_pw);
+            if (subreq == NULL) {
+                tevent_req_error(req, ENOMEM);
+                return;
+            }
+
+            tevent_req_set_callback(subreq, sysdb_cache_auth_hash_done, req);
+            return;
+        } else if (ret == ENOMEM) {
+            tevent_req_error(req, ret);
+            return;
+        }
+    }
+
+    if (authentication_successful) {
+        /* TODO: probable good point for audit logging */
+        DEBUG(SSSDBG_CONF_SETTINGS, "Hashes do match!\n");
+    } else {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Authentication failed.\n");
+    }
+
+    /* Other attempts might have locked the account while the password was
+     * hashed, the lockout is checked again before the result is used. */
+    ret = sysdb_cache_auth_store_result(state->domain, state->name,
+                                        state->cdb,
+                                        authentication_successful,
+                                        state->just_check,
+                                        &state->delayed_until);
+    if (ret == ERR_AUTH_DENIED) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    if (!authentication_successful) {
+        tevent_req_error(req, ret == EOK ? ERR_AUTH_FAILED : ret);
+        return;
+    }
+
+    /* The failure to update the login information is not fatal. */
+    tevent_req_done(req);
+}
+
+errno_t sysdb_cache_auth_recv(struct tevent_req *req,
+                              time_t *_expire_date,
+                              time_t *_delayed_until)
+{
+    struct sysdb_cache_auth_state *state;
+
+    state = tevent_req_data(req, struct sysdb_cache_auth_state);
+
+    /* Set also on failure, the caller uses them to explain why. */
+    if (_expire_date != NULL) {
+        *_expire_date = state->expire_date;
+    }
+    if (_delayed_until != NULL) {
+        *_delayed_until = state->delayed_until;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
 static errno_t sysdb_update_members_ex(struct sss_domain_info *domain,
                                        const char *member,
                                        enum sysdb_member_type type,
@@ -5045,6 +5523,11 @@ errno_t sysdb_remove_attrs(struct sss_domain_info *domain,
             goto done;
         }
 
+        ret = sysdb_msg_add_mapped_cert_hashes(msg);
+        if (ret != EOK) {
+            goto done;
+        }
+
         /* We need to do individual modifies so that we can
          * skip unknown attributes. Otherwise, any nonexistent
          * attribute in the sysdb will cause other removals to
@@ -5061,6 +5544,7 @@ errno_t sysdb_remove_attrs(struct sss_domain_info *domain,
 
         /* Remove this attribute and move on to the next one */
         ldb_msg_remove_attr(msg, remove_attrs[i]);
+        ldb_msg_remove_attr(msg, SYSDB_USER_MAPPED_CERT_HASH);
     }
 
     ret = sysdb_transaction_commit(domain->sysdb);
@@ -5309,19 +5793,32 @@ errno_t sysdb_search_object_by_cert(TALLOC_CTX *mem_ctx,
                                     struct ldb_result **res)
 {
     int ret;
-    char *user_filter = NULL;
+    unsigned char *der;
+    size_t der_size;
+    char *hash;
     char *filter = NULL;
 
-    ret = sysdb_cert_derb64_to_ldap_filter(mem_ctx, cert,
-                                           SYSDB_USER_MAPPED_CERT,
-                                           &user_filter);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "sss_cert_derb64_to_ldap_filter failed.\n");
-        return ret;
+    if (cert == NULL || *cert == '\0') {
+        return EINVAL;
     }
 
-    filter = talloc_asprintf(NULL, SYSDB_USER_CERT_FILTER, user_filter);
-    talloc_free(user_filter);
+    der = sss_base64_decode(NULL, cert, &der_size);
+    if (der == NULL || der_size == 0) {
+        DEBUG(SSSDBG_OP_FAILURE, "sss_base64_decode failed.\n");
+        talloc_free(der);
+        return EINVAL;
+    }
+
+    /* The hash is indexed, this is a single index lookup with a short key
+     * instead of one with the whole certificate. */
+    hash = sss_sha256_hex(der, der, der_size);
+    if (hash == NULL) {
+        talloc_free(der);
+        return ENOMEM;
+    }
+
+    filter = talloc_asprintf(NULL, SYSDB_USER_CERT_HASH_FILTER, hash);
+    talloc_free(der);
     if (filter == NULL) {
         return ENOMEM;
     }
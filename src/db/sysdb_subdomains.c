@@ -302,6 +302,30 @@ static void link_forest_roots(struct sss_domain_info *domain)
 
 errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                                 struct confdb_ctx *confdb)
+{
+    return sysdb_update_subdomains_ext(domain, confdb, NULL);
+}
+
+static bool sysdb_string_lists_equal(const char **a, const char **b)
+{
+    size_t i;
+
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+
+    for (i = 0; a[i] != NULL && b[i] != NULL; i++) {
+        if (strcmp(a[i], b[i]) != 0) {
+            return false;
+        }
+    }
+
+    return a[i] == NULL && b[i] == NULL;
+}
+
+errno_t sysdb_update_subdomains_ext(struct sss_domain_info *domain,
+                                    struct confdb_ctx *confdb,
+                                    bool *_changed)
 {
     int i;
     errno_t ret;
@@ -332,6 +356,11 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
     uint32_t trust_direction;
     struct ldb_message_element *tmp_el;
     const char **upn_suffixes;
+    struct sss_domain_info **old_doms = NULL;
+    enum sss_domain_state *old_states = NULL;
+    size_t num_old = 0;
+    size_t c;
+    bool changed = false;
 
     tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
@@ -339,6 +368,30 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
         goto done;
     }
 
+    /* Remember the state of the known subdomains so we can tell whether
+     * the list of active domains has changed. */
+    for (dom = domain->subdomains; dom;
+            dom = get_next_domain(dom, SSS_GND_INCLUDE_DISABLED)) {
+        num_old++;
+    }
+
+    if (num_old > 0) {
+        old_doms = talloc_array(tmp_ctx, struct sss_domain_info *, num_old);
+        old_states = talloc_array(tmp_ctx, enum sss_domain_state, num_old);
+        if (old_doms == NULL || old_states == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        c = 0;
+        for (dom = domain->subdomains; dom;
+                dom = get_next_domain(dom, SSS_GND_INCLUDE_DISABLED)) {
+            old_doms[c] = dom;
+            old_states[c] = sss_domain_get_state(dom);
+            c++;
+        }
+    }
+
     basedn = ldb_dn_new(tmp_ctx, domain->sysdb->ldb, SYSDB_BASE);
     if (basedn == NULL) {
         ret = EIO;
@@ -360,7 +413,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
 
     if (res->count == 0) {
         ret = EOK;
-        goto done;
+        goto check_states;
     }
 
     for (i = 0; i < res->count; i++) {
@@ -424,6 +477,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 if ((dom->realm == NULL && realm != NULL)
                         || (dom->realm != NULL && realm != NULL
                             && strcasecmp(dom->realm, realm) != 0)) {
+                    changed = true;
                     DEBUG(SSSDBG_TRACE_INTERNAL,
                           "Realm name changed from [%s] to [%s]!\n",
                            dom->realm, realm);
@@ -437,6 +491,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 if ((dom->flat_name == NULL && flat != NULL)
                         || (dom->flat_name != NULL && flat != NULL
                             && strcasecmp(dom->flat_name, flat) != 0)) {
+                    changed = true;
                     DEBUG(SSSDBG_TRACE_INTERNAL,
                           "Flat name changed from [%s] to [%s]!\n",
                            dom->flat_name, flat);
@@ -450,6 +505,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 if ((dom->domain_id == NULL && id != NULL)
                         || (dom->domain_id != NULL && id != NULL
                             && strcasecmp(dom->domain_id, id) != 0)) {
+                    changed = true;
                     DEBUG(SSSDBG_TRACE_INTERNAL,
                           "Domain changed from [%s] to [%s]!\n",
                            dom->domain_id, id);
@@ -462,6 +518,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 }
 
                 if (dom->mpg_mode != mpg_mode) {
+                    changed = true;
                     DEBUG(SSSDBG_TRACE_INTERNAL,
                           "MPG state change from [%s] to [%s]!\n",
                            dom->mpg_mode == MPG_ENABLED ? "true" : "false",
@@ -470,6 +527,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 }
 
                 if (dom->enumerate != enumerate) {
+                    changed = true;
                     DEBUG(SSSDBG_TRACE_INTERNAL,
                           "enumerate state change from [%s] to [%s]!\n",
                            dom->enumerate ? "true" : "false",
@@ -480,6 +538,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 if ((dom->forest == NULL && forest != NULL)
                         || (dom->forest != NULL && forest != NULL
                             && strcasecmp(dom->forest, forest) != 0)) {
+                    changed = true;
                     DEBUG(SSSDBG_TRACE_INTERNAL,
                           "Forest changed from [%s] to [%s]!\n",
                            dom->forest, forest);
@@ -491,6 +550,10 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                     }
                 }
 
+                if (!sysdb_string_lists_equal(dom->upn_suffixes,
+                                              upn_suffixes)) {
+                    changed = true;
+                }
                 talloc_zfree(dom->upn_suffixes);
                 dom->upn_suffixes = talloc_steal(dom, upn_suffixes);
 
@@ -524,6 +587,7 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 }
 
                 if (dom->trust_direction != trust_direction) {
+                    changed = true;
                     DEBUG(SSSDBG_TRACE_INTERNAL,
                           "Trust direction change from [%d] to [%d]!\n",
                            dom->trust_direction, trust_direction);
@@ -544,11 +608,24 @@ errno_t sysdb_update_subdomains(struct sss_domain_info *domain,
                 goto done;
             }
             DLIST_ADD_END(domain->subdomains, dom, struct sss_domain_info *);
+            changed = true;
         }
     }
 
     link_forest_roots(domain);
 
+check_states:
+    for (c = 0; c < num_old; c++) {
+        if (sss_domain_get_state(old_doms[c]) != old_states[c]) {
+            changed = true;
+            break;
+        }
+    }
+
+    if (_changed != NULL) {
+        *_changed = changed;
+    }
+
     ret = EOK;
 
 done:
@@ -933,6 +1010,20 @@ errno_t sysdb_subdomain_store(struct sysdb_ctx *sysdb,
                               bool enumerate, const char *forest,
                               uint32_t trust_direction,
                               struct ldb_message_element *upn_suffixes)
+{
+    return sysdb_subdomain_store_ext(sysdb, name, realm, flat_name, domain_id,
+                                     mpg_mode, enumerate, forest,
+                                     trust_direction, upn_suffixes, NULL);
+}
+
+errno_t sysdb_subdomain_store_ext(struct sysdb_ctx *sysdb,
+                                  const char *name, const char *realm,
+                                  const char *flat_name, const char *domain_id,
+                                  enum sss_domain_mpg_mode mpg_mode,
+                                  bool enumerate, const char *forest,
+                                  uint32_t trust_direction,
+                                  struct ldb_message_element *upn_suffixes,
+                                  bool *_changed)
 {
     TALLOC_CTX *tmp_ctx;
     struct ldb_message *msg;
@@ -1077,6 +1168,9 @@ errno_t sysdb_subdomain_store(struct sysdb_ctx *sysdb,
     if (!store && realm_flags == 0 && flat_flags == 0 && id_flags == 0
             && mpg_flags == 0 && enum_flags == 0 && forest_flags == 0
             && td_flags == 0 && upn_flags == 0) {
+        if (_changed != NULL) {
+            *_changed = false;
+        }
         ret = EOK;
         goto done;
     }
@@ -1250,6 +1344,10 @@ errno_t sysdb_subdomain_store(struct sysdb_ctx *sysdb,
         goto done;
     }
 
+    if (_changed != NULL) {
+        *_changed = true;
+    }
+
     ret = EOK;
 
 done:
@@ -1370,15 +1468,21 @@ done:
     return ret;
 }
 
-errno_t
-sysdb_get_site(TALLOC_CTX *mem_ctx,
-               struct sss_domain_info *dom,
-               const char **_site)
+/* Returns the values of a single attribute of the domain entry as a NULL
+ * terminated array, or NULL if the attribute is not set. */
+static errno_t
+sysdb_domain_get_values(TALLOC_CTX *mem_ctx,
+                        struct sss_domain_info *dom,
+                        const char *attr_name,
+                        const char ***_values)
 {
     TALLOC_CTX *tmp_ctx;
     struct ldb_result *res;
+    struct ldb_message_element *el;
     struct ldb_dn *dn;
-    const char *attrs[] = { SYSDB_SITE, NULL };
+    const char *attrs[] = { attr_name, NULL };
+    const char **values;
+    unsigned int i;
     errno_t ret;
 
     tmp_ctx = talloc_new(NULL);
@@ -1400,7 +1504,7 @@ sysdb_get_site(TALLOC_CTX *mem_ctx,
     }
 
     if (res->count == 0) {
-        *_site = NULL;
+        *_values = NULL;
         ret = EOK;
         goto done;
     } else if (res->count != 1) {
@@ -1410,9 +1514,29 @@ sysdb_get_site(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    *_site = ldb_msg_find_attr_as_string(res->msgs[0], SYSDB_SITE, NULL);
-    talloc_steal(mem_ctx, *_site);
+    el = ldb_msg_find_element(res->msgs[0], attr_name);
+    if (el == NULL || el->num_values == 0) {
+        *_values = NULL;
+        ret = EOK;
+        goto done;
+    }
+
+    values = talloc_zero_array(tmp_ctx, const char *, el->num_values + 1);
+    if (values == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < el->num_values; i++) {
+        values[i] = talloc_strndup(values, (const char *)el->values[i].data,
+                                   el->values[i].length);
+        if (values[i] == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
 
+    *_values = talloc_steal(mem_ctx, values);
     ret = EOK;
 
 done:
@@ -1420,13 +1544,17 @@ done:
     return ret;
 }
 
-errno_t
-sysdb_set_site(struct sss_domain_info *dom,
-               const char *site)
+/* Replaces the values of a single attribute of the domain entry. The
+ * attribute is removed if values is NULL or empty. */
+static errno_t
+sysdb_domain_set_values(struct sss_domain_info *dom,
+                        const char *attr_name,
+                        const char * const *values)
 {
     TALLOC_CTX *tmp_ctx;
     struct ldb_message *msg;
     struct ldb_dn *dn;
+    size_t i;
     errno_t ret;
 
     tmp_ctx = talloc_new(NULL);
@@ -1448,14 +1576,14 @@ sysdb_set_site(struct sss_domain_info *dom,
 
     msg->dn = dn;
 
-    ret = ldb_msg_add_empty(msg, SYSDB_SITE, LDB_FLAG_MOD_REPLACE, NULL);
+    ret = ldb_msg_add_empty(msg, attr_name, LDB_FLAG_MOD_REPLACE, NULL);
     if (ret != LDB_SUCCESS) {
         ret = sysdb_error_to_errno(ret);
         goto done;
     }
 
-    if (site != NULL) {
-        ret = ldb_msg_add_string(msg, SYSDB_SITE, site);
+    for (i = 0; values != NULL && values[i] != NULL; i++) {
+        ret = ldb_msg_add_string(msg, attr_name, values[i]);
         if (ret != LDB_SUCCESS) {
             ret = sysdb_error_to_errno(ret);
             goto done;
@@ -1478,6 +1606,86 @@ done:
     return ret;
 }
 
+static errno_t
+sysdb_domain_get_value(TALLOC_CTX *mem_ctx,
+                       struct sss_domain_info *dom,
+                       const char *attr_name,
+                       const char **_value)
+{
+    const char **values;
+    errno_t ret;
+
+    ret = sysdb_domain_get_values(mem_ctx, dom, attr_name, &values);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (values == NULL) {
+        *_value = NULL;
+        return EOK;
+    }
+
+    *_value = talloc_steal(mem_ctx, values[0]);
+    talloc_free(values);
+
+    return EOK;
+}
+
+static errno_t
+sysdb_domain_set_value(struct sss_domain_info *dom,
+                       const char *attr_name,
+                       const char *value)
+{
+    const char *values[] = { value, NULL };
+
+    return sysdb_domain_set_values(dom, attr_name, values);
+}
+
+errno_t
+sysdb_get_site(TALLOC_CTX *mem_ctx,
+               struct sss_domain_info *dom,
+               const char **_site)
+{
+    return sysdb_domain_get_value(mem_ctx, dom, SYSDB_SITE, _site);
+}
+
+errno_t
+sysdb_set_site(struct sss_domain_info *dom,
+               const char *site)
+{
+    return sysdb_domain_set_value(dom, SYSDB_SITE, site);
+}
+
+errno_t
+sysdb_get_site_forest(TALLOC_CTX *mem_ctx,
+                      struct sss_domain_info *dom,
+                      const char **_forest)
+{
+    return sysdb_domain_get_value(mem_ctx, dom, SYSDB_SITE_FOREST, _forest);
+}
+
+errno_t
+sysdb_set_site_forest(struct sss_domain_info *dom,
+                      const char *forest)
+{
+    return sysdb_domain_set_value(dom, SYSDB_SITE_FOREST, forest);
+}
+
+errno_t
+sysdb_get_dc_ranking(TALLOC_CTX *mem_ctx,
+                     struct sss_domain_info *dom,
+                     const char ***_dcs)
+{
+    return sysdb_domain_get_values(mem_ctx, dom, SYSDB_DC_RANKING, _dcs);
+}
+
+errno_t
+sysdb_set_dc_ranking(struct sss_domain_info *dom,
+                     const char * const *dcs)
+{
+    return sysdb_domain_set_values(dom, SYSDB_DC_RANKING, dcs);
+}
+
 errno_t
 sysdb_domain_set_enabled(struct sysdb_ctx *sysdb,
                          const char *name,
@@ -22,6 +22,7 @@
 
 #include <talloc.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include "db/sysdb.h"
 #include "db/sysdb_private.h"
@@ -536,9 +537,9 @@ done:
     return ret;
 }
 
-static errno_t sysdb_sudo_set_refresh_time(struct sss_domain_info *domain,
-                                           const char *attr_name,
-                                           time_t value)
+static errno_t sysdb_sudo_set_container_value(struct sss_domain_info *domain,
+                                              const char *attr_name,
+                                              const char *value)
 {
     TALLOC_CTX *tmp_ctx;
     struct ldb_dn *dn;
@@ -594,7 +595,7 @@ static errno_t sysdb_sudo_set_refresh_time(struct sss_domain_info *domain,
         }
     }
 
-    lret = ldb_msg_add_fmt(msg, attr_name, "%lld", (long long)value);
+    lret = ldb_msg_add_string(msg, attr_name, value);
     if (lret != LDB_SUCCESS) {
         ret = sysdb_error_to_errno(lret);
         goto done;
@@ -618,6 +619,24 @@ done:
     return ret;
 }
 
+static errno_t sysdb_sudo_set_refresh_time(struct sss_domain_info *domain,
+                                           const char *attr_name,
+                                           time_t value)
+{
+    char *str;
+    errno_t ret;
+
+    str = talloc_asprintf(NULL, "%lld", (long long)value);
+    if (str == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_sudo_set_container_value(domain, attr_name, str);
+    talloc_free(str);
+
+    return ret;
+}
+
 static errno_t sysdb_sudo_get_refresh_time(struct sss_domain_info *domain,
                                            const char *attr_name,
                                            time_t *value)
@@ -687,6 +706,87 @@ errno_t sysdb_sudo_get_last_full_refresh(struct sss_domain_info *domain,
                                        SYSDB_SUDO_AT_LAST_FULL_REFRESH, value);
 }
 
+errno_t sysdb_sudo_get_revision(struct sss_domain_info *domain,
+                                uint64_t *_revision)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_dn *dn;
+    struct ldb_result *res;
+    errno_t ret;
+    int lret;
+    const char *attrs[2] = {SYSDB_SUDO_AT_REVISION, NULL};
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    dn = ldb_dn_new_fmt(tmp_ctx, domain->sysdb->ldb, SYSDB_TMPL_CUSTOM_SUBTREE,
+                        SUDORULE_SUBDIR, domain->name);
+    if (!dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    lret = ldb_search(domain->sysdb->ldb, tmp_ctx, &res, dn, LDB_SCOPE_BASE,
+                      attrs, NULL);
+    if (lret != LDB_SUCCESS) {
+        ret = sysdb_error_to_errno(lret);
+        goto done;
+    }
+
+    if (res->count == 0) {
+        *_revision = 0;
+        ret = EOK;
+        goto done;
+    } else if (res->count != 1) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Got more than one reply for base search!\n");
+        ret = EIO;
+        goto done;
+    }
+
+    *_revision = ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                             SYSDB_SUDO_AT_REVISION, 0);
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Called whenever rules are stored or removed. The revision is based on the
+ * current time so that it does not start over when the whole sudo subtree
+ * including this attribute is deleted. */
+static errno_t sysdb_sudo_bump_revision(struct sss_domain_info *domain)
+{
+    struct timeval tv;
+    uint64_t revision;
+    uint64_t now;
+    char *str;
+    errno_t ret;
+
+    ret = sysdb_sudo_get_revision(domain, &revision);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    gettimeofday(&tv, NULL);
+    now = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    revision = MAX(revision + 1, now);
+
+    str = talloc_asprintf(NULL, "%"PRIu64, revision);
+    if (str == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_sudo_set_container_value(domain, SYSDB_SUDO_AT_REVISION, str);
+    talloc_free(str);
+
+    return ret;
+}
+
 /* ====================  Purge functions ==================== */
 
 static const char *
@@ -851,6 +951,13 @@ errno_t sysdb_sudo_purge(struct sss_domain_info *domain,
         goto done;
     }
 
+    if (delete_filter != NULL || num_rules > 0) {
+        ret = sysdb_sudo_bump_revision(domain);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
     ret = sysdb_transaction_commit(domain->sysdb);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
@@ -1044,6 +1151,11 @@ sysdb_sudo_store(struct sss_domain_info *domain,
         }
     }
 
+    ret = sysdb_sudo_bump_revision(domain);
+    if (ret != EOK) {
+        goto done;
+    }
+
     ret = sysdb_transaction_commit(domain->sysdb);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Failed to commit transaction\n");
@@ -31,6 +31,8 @@
  * should be true if we have downloaded all rules atleast once */
 #define SYSDB_SUDO_AT_REFRESHED      "refreshed"
 #define SYSDB_SUDO_AT_LAST_FULL_REFRESH "sudoLastFullRefreshTime"
+/* changes whenever rules are stored or purged */
+#define SYSDB_SUDO_AT_REVISION       "sudoRulesRevision"
 
 /* sysdb attributes */
 #define SYSDB_SUDO_CACHE_OC            "sudoRule"
@@ -130,6 +132,9 @@ errno_t sysdb_sudo_set_last_full_refresh(struct sss_domain_info *domain,
 errno_t sysdb_sudo_get_last_full_refresh(struct sss_domain_info *domain,
                                          time_t *value);
 
+errno_t sysdb_sudo_get_revision(struct sss_domain_info *domain,
+                                uint64_t *_revision);
+
 errno_t sysdb_sudo_purge(struct sss_domain_info *domain,
                          const char *delete_filter,
                          struct sysdb_attrs **rules,
@@ -688,11 +688,12 @@ static int do_match(struct sss_certmap_ctx *ctx,
         return EINVAL;
     }
 
-    /* Issuer */
-    for (comp = parsed_match_rule->issuer; comp != NULL; comp = comp->next) {
-        match = (cert_content->issuer_str != NULL
-                    && regexec(&(comp->regexp), cert_content->issuer_str,
-                               0, NULL, 0) == 0);
+    /* The cheap bit-mask and OID checks come first, the regular
+     * expressions are only evaluated if they could change the result. */
+
+    /* Key Usage */
+    for (comp = parsed_match_rule->ku; comp != NULL; comp = comp->next) {
+        match = ((cert_content->key_usage & comp->ku) == comp->ku);
         if (match && parsed_match_rule->r == relation_or) {
             /* match */
             return 0;
@@ -700,13 +701,29 @@ static int do_match(struct sss_certmap_ctx *ctx,
             /* no match */
             return ENOENT;
         }
+    }
 
+    /* Extended Key Usage */
+    for (comp = parsed_match_rule->eku; comp != NULL; comp = comp->next) {
+        for (c = 0; comp->eku_oid_list[c] != NULL; c++) {
+            match = string_in_list(comp->eku_oid_list[c],
+                                   discard_const(
+                                         cert_content->extended_key_usage_oids),
+                                   true);
+            if (match && parsed_match_rule->r == relation_or) {
+                /* match */
+                return 0;
+            } else if (!match && parsed_match_rule->r == relation_and) {
+                /* no match */
+                return ENOENT;
+            }
+        }
     }
 
-    /* Subject */
-    for (comp = parsed_match_rule->subject; comp != NULL; comp = comp->next) {
-        match = (cert_content->subject_str != NULL
-                    && regexec(&(comp->regexp), cert_content->subject_str,
+    /* Issuer */
+    for (comp = parsed_match_rule->issuer; comp != NULL; comp = comp->next) {
+        match = (cert_content->issuer_str != NULL
+                    && regexec(&(comp->regexp), cert_content->issuer_str,
                                0, NULL, 0) == 0);
         if (match && parsed_match_rule->r == relation_or) {
             /* match */
@@ -718,9 +735,11 @@ static int do_match(struct sss_certmap_ctx *ctx,
 
     }
 
-    /* Key Usage */
-    for (comp = parsed_match_rule->ku; comp != NULL; comp = comp->next) {
-        match = ((cert_content->key_usage & comp->ku) == comp->ku);
+    /* Subject */
+    for (comp = parsed_match_rule->subject; comp != NULL; comp = comp->next) {
+        match = (cert_content->subject_str != NULL
+                    && regexec(&(comp->regexp), cert_content->subject_str,
+                               0, NULL, 0) == 0);
         if (match && parsed_match_rule->r == relation_or) {
             /* match */
             return 0;
@@ -728,23 +747,7 @@ static int do_match(struct sss_certmap_ctx *ctx,
             /* no match */
             return ENOENT;
         }
-    }
 
-    /* Extended Key Usage */
-    for (comp = parsed_match_rule->eku; comp != NULL; comp = comp->next) {
-        for (c = 0; comp->eku_oid_list[c] != NULL; c++) {
-            match = string_in_list(comp->eku_oid_list[c],
-                                   discard_const(
-                                         cert_content->extended_key_usage_oids),
-                                   true);
-            if (match && parsed_match_rule->r == relation_or) {
-                /* match */
-                return 0;
-            } else if (!match && parsed_match_rule->r == relation_and) {
-                /* no match */
-                return ENOENT;
-            }
-        }
     }
 
     /* SAN */
@@ -142,76 +142,646 @@ enum hbac_eval_result_int hbac_evaluate_rule(struct hbac_rule *rule,
                                              struct hbac_eval_req *hbac_req,
                                              enum hbac_error_code *error);
 
+/* Evaluates a single rule as part of hbac_evaluate(). Returns true if the
+ * evaluation is finished, either because the rule granted access or because
+ * an error occurred. */
+static bool hbac_evaluate_one(struct hbac_rule *rule,
+                              struct hbac_eval_req *hbac_req,
+                              struct hbac_info **info,
+                              enum hbac_eval_result *result)
+{
+    enum hbac_error_code ret;
+    enum hbac_eval_result_int intermediate_result;
+
+    hbac_rule_debug_print(rule);
+    intermediate_result = hbac_evaluate_rule(rule, hbac_req, &ret);
+    if (intermediate_result == HBAC_EVAL_UNMATCHED) {
+        /* This rule did not match at all. Skip it */
+        HBAC_DEBUG(HBAC_DBG_INFO, "The rule [%s] did not match.\n",
+                   rule->name);
+        return false;
+    } else if (intermediate_result == HBAC_EVAL_MATCHED) {
+        HBAC_DEBUG(HBAC_DBG_INFO, "ALLOWED by rule [%s].\n", rule->name);
+        *result = HBAC_EVAL_ALLOW;
+        if (info) {
+            (*info)->code = HBAC_SUCCESS;
+            (*info)->rule_name = strdup(rule->name);
+            if (!(*info)->rule_name) {
+                HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+                *result = HBAC_EVAL_ERROR;
+                (*info)->code = HBAC_ERROR_OUT_OF_MEMORY;
+            }
+        }
+        return true;
+    }
+
+    /* An error occurred processing this rule */
+    HBAC_DEBUG(HBAC_DBG_ERROR,
+               "Error %d occurred during evaluating of rule [%s].\n",
+               ret, rule->name);
+    *result = HBAC_EVAL_ERROR;
+    if (info) {
+        (*info)->code = ret;
+        (*info)->rule_name = strdup(rule->name);
+    }
+    /* Explicitly not checking the result of strdup(), since if
+     * it's NULL, we can't do anything anyway.
+     */
+    return true;
+}
+
+static errno_t hbac_alloc_info(struct hbac_info **info)
+{
+    if (info == NULL) {
+        return EOK;
+    }
+
+    *info = malloc(sizeof(struct hbac_info));
+    if (!*info) {
+        HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+        return ENOMEM;
+    }
+    (*info)->code = HBAC_ERROR_UNKNOWN;
+    (*info)->rule_name = NULL;
+
+    return EOK;
+}
+
 enum hbac_eval_result hbac_evaluate(struct hbac_rule **rules,
                                     struct hbac_eval_req *hbac_req,
                                     struct hbac_info **info)
 {
     uint32_t i;
 
-    enum hbac_error_code ret;
     enum hbac_eval_result result = HBAC_EVAL_DENY;
-    enum hbac_eval_result_int intermediate_result;
 
     HBAC_DEBUG(HBAC_DBG_INFO, "[< hbac_evaluate()\n");
     hbac_req_debug_print(hbac_req);
 
-    if (info) {
-        *info = malloc(sizeof(struct hbac_info));
-        if (!*info) {
-            HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
-            return HBAC_EVAL_OOM;
-        }
-        (*info)->code = HBAC_ERROR_UNKNOWN;
-        (*info)->rule_name = NULL;
+    if (hbac_alloc_info(info) != EOK) {
+        return HBAC_EVAL_OOM;
     }
 
     for (i = 0; rules[i]; i++) {
-        hbac_rule_debug_print(rules[i]);
-        intermediate_result = hbac_evaluate_rule(rules[i], hbac_req, &ret);
-        if (intermediate_result == HBAC_EVAL_UNMATCHED) {
-            /* This rule did not match at all. Skip it */
-            HBAC_DEBUG(HBAC_DBG_INFO, "The rule [%s] did not match.\n",
-                       rules[i]->name);
-            continue;
-        } else if (intermediate_result == HBAC_EVAL_MATCHED) {
-            HBAC_DEBUG(HBAC_DBG_INFO, "ALLOWED by rule [%s].\n", rules[i]->name);
-            result = HBAC_EVAL_ALLOW;
-            if (info) {
-                (*info)->code = HBAC_SUCCESS;
-                (*info)->rule_name = strdup(rules[i]->name);
-                if (!(*info)->rule_name) {
-                    HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
-                    result = HBAC_EVAL_ERROR;
-                    (*info)->code = HBAC_ERROR_OUT_OF_MEMORY;
-                }
-            }
+        if (hbac_evaluate_one(rules[i], hbac_req, info, &result)) {
             break;
-        } else {
-            /* An error occurred processing this rule */
-            HBAC_DEBUG(HBAC_DBG_ERROR,
-                       "Error %d occurred during evaluating of rule [%s].\n",
-                       ret, rules[i]->name);
-            result = HBAC_EVAL_ERROR;
-            if (info) {
-                (*info)->code = ret;
-                (*info)->rule_name = strdup(rules[i]->name);
-            }
-            /* Explicitly not checking the result of strdup(), since if
-             * it's NULL, we can't do anything anyway.
-             */
-            goto done;
         }
     }
 
     /* If we've reached the end of the loop, we have either set the
      * result to ALLOW explicitly or we'll stick with the default DENY.
      */
-done:
 
     HBAC_DEBUG(HBAC_DBG_INFO, "hbac_evaluate() >]\n");
     return result;
 }
 
+/* Compiled rule sets
+ *
+ * Rules are indexed by the names and groups of their service and target host
+ * elements. Keys are interned in lower case, which is only equivalent to the
+ * case-insensitive UTF-8 comparison done by hbac_evaluate_element() for
+ * ASCII names. Rules with non-ASCII names are therefore always candidates
+ * for the element in question, and a request with a non-ASCII name falls
+ * back to all rules. Candidates are evaluated in their original order with
+ * hbac_evaluate_rule(), so the result is the same as from hbac_evaluate().
+ */
+
+#define HBAC_INDEX_MIN_BUCKETS 16
+
+#define HBAC_CANDIDATE_SERVICE    0x01
+#define HBAC_CANDIDATE_TARGETHOST 0x02
+#define HBAC_CANDIDATE_ALL        (HBAC_CANDIDATE_SERVICE \
+                                   | HBAC_CANDIDATE_TARGETHOST)
+
+struct hbac_rule_list {
+    size_t *idx;
+    size_t num;
+    size_t size;
+};
+
+struct hbac_index_entry {
+    char *key;
+    unsigned long hash;
+    struct hbac_rule_list rules;
+    struct hbac_index_entry *next;
+};
+
+struct hbac_index {
+    struct hbac_index_entry **buckets;
+    size_t num_buckets;
+
+    /* Rules that match any name of this element */
+    struct hbac_rule_list always;
+};
+
+struct hbac_rule_set {
+    struct hbac_rule **rules;
+    size_t num_rules;
+
+    /* Rules that are missing elements, they are always evaluated so that
+     * the parse error is reported */
+    struct hbac_rule_list incomplete;
+
+    struct hbac_index services;
+    struct hbac_index targethosts;
+};
+
+static bool hbac_is_ascii(const char *name)
+{
+    const unsigned char *c;
+
+    for (c = (const unsigned char *) name; *c != '\0'; c++) {
+        if (*c > 0x7F) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static unsigned long hbac_key_hash(const char *key)
+{
+    const unsigned char *c;
+    unsigned long hash = 5381;
+
+    for (c = (const unsigned char *) key; *c != '\0'; c++) {
+        hash = hash * 33 + *c;
+    }
+
+    return hash;
+}
+
+static char *hbac_key_from_name(const char *name)
+{
+    char *key;
+    size_t i;
+
+    key = strdup(name);
+    if (key == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; key[i] != '\0'; i++) {
+        if (key[i] >= 'A' && key[i] <= 'Z') {
+            key[i] = key[i] - 'A' + 'a';
+        }
+    }
+
+    return key;
+}
+
+static errno_t hbac_rule_list_add(struct hbac_rule_list *list, size_t idx)
+{
+    size_t *new_idx;
+    size_t new_size;
+
+    /* Rules are added in order, a rule may reach the same list through
+     * several names. */
+    if (list->num > 0 && list->idx[list->num - 1] == idx) {
+        return EOK;
+    }
+
+    if (list->num == list->size) {
+        new_size = list->size == 0 ? 4 : list->size * 2;
+        new_idx = realloc(list->idx, new_size * sizeof(size_t));
+        if (new_idx == NULL) {
+            return ENOMEM;
+        }
+        list->idx = new_idx;
+        list->size = new_size;
+    }
+
+    list->idx[list->num] = idx;
+    list->num++;
+
+    return EOK;
+}
+
+static struct hbac_index_entry *hbac_index_find(struct hbac_index *index,
+                                                const char *key,
+                                                unsigned long hash)
+{
+    struct hbac_index_entry *entry;
+
+    for (entry = index->buckets[hash % index->num_buckets];
+         entry != NULL;
+         entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static errno_t hbac_index_add_name(struct hbac_index *index,
+                                   const char *name,
+                                   size_t idx)
+{
+    struct hbac_index_entry *entry;
+    unsigned long hash;
+    size_t bucket;
+    char *key;
+
+    if (!hbac_is_ascii(name)) {
+        return hbac_rule_list_add(&index->always, idx);
+    }
+
+    key = hbac_key_from_name(name);
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    hash = hbac_key_hash(key);
+    entry = hbac_index_find(index, key, hash);
+    if (entry != NULL) {
+        free(key);
+        return hbac_rule_list_add(&entry->rules, idx);
+    }
+
+    entry = calloc(1, sizeof(struct hbac_index_entry));
+    if (entry == NULL) {
+        free(key);
+        return ENOMEM;
+    }
+
+    entry->key = key;
+    entry->hash = hash;
+    if (hbac_rule_list_add(&entry->rules, idx) != EOK) {
+        free(entry->key);
+        free(entry);
+        return ENOMEM;
+    }
+
+    bucket = hash % index->num_buckets;
+    entry->next = index->buckets[bucket];
+    index->buckets[bucket] = entry;
+
+    return EOK;
+}
+
+static errno_t hbac_index_add_element(struct hbac_index *index,
+                                      struct hbac_rule_element *el,
+                                      size_t idx)
+{
+    errno_t ret;
+    size_t i;
+
+    if (el->category & HBAC_CATEGORY_ALL) {
+        return hbac_rule_list_add(&index->always, idx);
+    }
+
+    if (el->names) {
+        for (i = 0; el->names[i]; i++) {
+            ret = hbac_index_add_name(index, el->names[i], idx);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    if (el->groups) {
+        for (i = 0; el->groups[i]; i++) {
+            ret = hbac_index_add_name(index, el->groups[i], idx);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    return EOK;
+}
+
+static errno_t hbac_index_init(struct hbac_index *index, size_t num_rules)
+{
+    index->num_buckets = HBAC_INDEX_MIN_BUCKETS;
+    while (index->num_buckets < num_rules) {
+        index->num_buckets *= 2;
+    }
+
+    index->buckets = calloc(index->num_buckets,
+                            sizeof(struct hbac_index_entry *));
+    if (index->buckets == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static void hbac_index_free(struct hbac_index *index)
+{
+    struct hbac_index_entry *entry;
+    struct hbac_index_entry *next;
+    size_t i;
+
+    if (index->buckets != NULL) {
+        for (i = 0; i < index->num_buckets; i++) {
+            for (entry = index->buckets[i]; entry != NULL; entry = next) {
+                next = entry->next;
+                free(entry->rules.idx);
+                free(entry->key);
+                free(entry);
+            }
+        }
+    }
+
+    free(index->buckets);
+    free(index->always.idx);
+}
+
+static void hbac_rule_list_mark(struct hbac_rule_list *list,
+                                unsigned char *candidates,
+                                unsigned char flag)
+{
+    size_t i;
+
+    for (i = 0; i < list->num; i++) {
+        candidates[list->idx[i]] |= flag;
+    }
+}
+
+static errno_t hbac_index_mark_name(struct hbac_index *index,
+                                    const char *name,
+                                    size_t num_rules,
+                                    unsigned char *candidates,
+                                    unsigned char flag)
+{
+    struct hbac_index_entry *entry;
+    char *key;
+    size_t i;
+
+    if (!hbac_is_ascii(name)) {
+        for (i = 0; i < num_rules; i++) {
+            candidates[i] |= flag;
+        }
+        return EOK;
+    }
+
+    key = hbac_key_from_name(name);
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    entry = hbac_index_find(index, key, hbac_key_hash(key));
+    free(key);
+    if (entry != NULL) {
+        hbac_rule_list_mark(&entry->rules, candidates, flag);
+    }
+
+    return EOK;
+}
+
+static errno_t hbac_index_mark(struct hbac_index *index,
+                               struct hbac_request_element *req_el,
+                               size_t num_rules,
+                               unsigned char *candidates,
+                               unsigned char flag)
+{
+    errno_t ret;
+    size_t i;
+
+    hbac_rule_list_mark(&index->always, candidates, flag);
+
+    if (req_el == NULL) {
+        return EOK;
+    }
+
+    if (req_el->name != NULL) {
+        ret = hbac_index_mark_name(index, req_el->name, num_rules,
+                                   candidates, flag);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    if (req_el->groups != NULL) {
+        for (i = 0; req_el->groups[i]; i++) {
+            ret = hbac_index_mark_name(index, req_el->groups[i], num_rules,
+                                       candidates, flag);
+            if (ret != EOK) {
+                return ret;
+            }
+        }
+    }
+
+    return EOK;
+}
+
+enum hbac_error_code hbac_compile_rules(struct hbac_rule **rules,
+                                        struct hbac_rule_set **_rule_set)
+{
+    struct hbac_rule_set *rule_set;
+    struct hbac_rule *rule;
+    errno_t ret;
+    size_t i;
+
+    if (rules == NULL || _rule_set == NULL) {
+        return HBAC_ERROR_UNKNOWN;
+    }
+
+    rule_set = calloc(1, sizeof(struct hbac_rule_set));
+    if (rule_set == NULL) {
+        return HBAC_ERROR_OUT_OF_MEMORY;
+    }
+
+    rule_set->rules = rules;
+    while (rules[rule_set->num_rules] != NULL) {
+        rule_set->num_rules++;
+    }
+
+    ret = hbac_index_init(&rule_set->services, rule_set->num_rules);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = hbac_index_init(&rule_set->targethosts, rule_set->num_rules);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < rule_set->num_rules; i++) {
+        rule = rules[i];
+
+        if (!rule->enabled) {
+            /* Never matches */
+            continue;
+        }
+
+        if (!rule->users
+         || !rule->services
+         || !rule->targethosts
+         || !rule->srchosts) {
+            ret = hbac_rule_list_add(&rule_set->incomplete, i);
+            if (ret != EOK) {
+                goto done;
+            }
+            continue;
+        }
+
+        ret = hbac_index_add_element(&rule_set->services,
+                                     rule->services, i);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        ret = hbac_index_add_element(&rule_set->targethosts,
+                                     rule->targethosts, i);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    HBAC_DEBUG(HBAC_DBG_TRACE, "Compiled %lu HBAC rules\n",
+               (unsigned long) rule_set->num_rules);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+        hbac_free_rule_set(rule_set);
+        return HBAC_ERROR_OUT_OF_MEMORY;
+    }
+
+    *_rule_set = rule_set;
+    return HBAC_SUCCESS;
+}
+
+/* Returns a list of flags, one for each rule in the set. The rules whose
+ * flag is HBAC_CANDIDATE_ALL may match the request. */
+static errno_t hbac_rule_set_mark(struct hbac_rule_set *rule_set,
+                                  struct hbac_eval_req *hbac_req,
+                                  unsigned char **_candidates)
+{
+    unsigned char *candidates;
+    errno_t ret;
+
+    /* calloc(0) may return NULL */
+    candidates = calloc(rule_set->num_rules + 1, sizeof(unsigned char));
+    if (candidates == NULL) {
+        return ENOMEM;
+    }
+
+    hbac_rule_list_mark(&rule_set->incomplete, candidates, HBAC_CANDIDATE_ALL);
+
+    ret = hbac_index_mark(&rule_set->services, hbac_req->service,
+                          rule_set->num_rules, candidates,
+                          HBAC_CANDIDATE_SERVICE);
+    if (ret != EOK) {
+        free(candidates);
+        return ret;
+    }
+
+    ret = hbac_index_mark(&rule_set->targethosts, hbac_req->targethost,
+                          rule_set->num_rules, candidates,
+                          HBAC_CANDIDATE_TARGETHOST);
+    if (ret != EOK) {
+        free(candidates);
+        return ret;
+    }
+
+    *_candidates = candidates;
+    return EOK;
+}
+
+enum hbac_error_code hbac_rule_set_get_candidates(struct hbac_rule_set *rule_set,
+                                                  struct hbac_eval_req *hbac_req,
+                                                  size_t **_idx,
+                                                  size_t *_num)
+{
+    unsigned char *candidates;
+    size_t *idx;
+    size_t num = 0;
+    errno_t ret;
+    size_t i;
+
+    if (rule_set == NULL || hbac_req == NULL
+            || _idx == NULL || _num == NULL) {
+        return HBAC_ERROR_UNKNOWN;
+    }
+
+    ret = hbac_rule_set_mark(rule_set, hbac_req, &candidates);
+    if (ret != EOK) {
+        HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+        return HBAC_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* calloc(0) may return NULL */
+    idx = calloc(rule_set->num_rules + 1, sizeof(size_t));
+    if (idx == NULL) {
+        HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+        free(candidates);
+        return HBAC_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (i = 0; i < rule_set->num_rules; i++) {
+        if (candidates[i] == HBAC_CANDIDATE_ALL) {
+            idx[num] = i;
+            num++;
+        }
+    }
+
+    free(candidates);
+
+    *_idx = idx;
+    *_num = num;
+    return HBAC_SUCCESS;
+}
+
+enum hbac_eval_result hbac_evaluate_rule_set(struct hbac_rule_set *rule_set,
+                                             struct hbac_eval_req *hbac_req,
+                                             struct hbac_info **info)
+{
+    enum hbac_eval_result result = HBAC_EVAL_DENY;
+    unsigned char *candidates;
+    size_t num_evaluated = 0;
+    errno_t ret;
+    size_t i;
+
+    HBAC_DEBUG(HBAC_DBG_INFO, "[< hbac_evaluate_rule_set()\n");
+    hbac_req_debug_print(hbac_req);
+
+    if (hbac_alloc_info(info) != EOK) {
+        return HBAC_EVAL_OOM;
+    }
+
+    ret = hbac_rule_set_mark(rule_set, hbac_req, &candidates);
+    if (ret != EOK) {
+        HBAC_DEBUG(HBAC_DBG_ERROR, "Out of memory.\n");
+        return HBAC_EVAL_OOM;
+    }
+
+    for (i = 0; i < rule_set->num_rules; i++) {
+        if (candidates[i] != HBAC_CANDIDATE_ALL) {
+            continue;
+        }
+
+        num_evaluated++;
+        if (hbac_evaluate_one(rule_set->rules[i], hbac_req, info, &result)) {
+            break;
+        }
+    }
+
+    HBAC_DEBUG(HBAC_DBG_TRACE, "Evaluated %lu of %lu HBAC rules\n",
+               (unsigned long) num_evaluated,
+               (unsigned long) rule_set->num_rules);
+
+    free(candidates);
+    HBAC_DEBUG(HBAC_DBG_INFO, "hbac_evaluate_rule_set() >]\n");
+    return result;
+}
+
+void hbac_free_rule_set(struct hbac_rule_set *rule_set)
+{
+    if (rule_set == NULL) return;
+
+    hbac_index_free(&rule_set->services);
+    hbac_index_free(&rule_set->targethosts);
+    free(rule_set->incomplete.idx);
+    free(rule_set);
+}
+
 static errno_t hbac_evaluate_element(struct hbac_rule_element *rule_el,
                                      struct hbac_request_element *req_el,
                                      bool *matched);
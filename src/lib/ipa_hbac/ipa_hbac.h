@@ -309,6 +309,76 @@ const char *hbac_error_string(enum hbac_error_code code);
  */
 void hbac_free_info(struct hbac_info *info);
 
+/**
+ * Opaque set of HBAC rules indexed for evaluation, see #hbac_compile_rules
+ */
+struct hbac_rule_set;
+
+/**
+ * @brief Index a set of HBAC rules for repeated evaluation
+ *
+ * The rules are indexed by the names and groups of their service and target
+ * host elements, so that #hbac_evaluate_rule_set only has to evaluate the
+ * rules that can possibly match a request.
+ *
+ * @param[in] rules      A NULL-terminated list of rules. The rules are not
+ *                       copied and must not be modified or freed before the
+ *                       rule set is freed. Only the user elements, which are
+ *                       not indexed, may be replaced between evaluations.
+ * @param[out] rule_set  The compiled rule set
+ * @return
+ *  - #HBAC_SUCCESS:              The rule set was created
+ *  - #HBAC_ERROR_OUT_OF_MEMORY:  Insufficient memory
+ *  - #HBAC_ERROR_UNKNOWN:        Invalid arguments
+ */
+enum hbac_error_code hbac_compile_rules(struct hbac_rule **rules,
+                                        struct hbac_rule_set **rule_set);
+
+/**
+ * @brief Evaluate an authorization request against a compiled rule set
+ *
+ * The result is the same as the result of #hbac_evaluate called with the
+ * rules the set was compiled from.
+ *
+ * @param[in] rule_set A rule set created by #hbac_compile_rules
+ * @param[in] hbac_req A user authorization request
+ * @param[out] info    Extended information, see #hbac_evaluate
+ * @return See #hbac_evaluate
+ */
+enum hbac_eval_result hbac_evaluate_rule_set(struct hbac_rule_set *rule_set,
+                                             struct hbac_eval_req *hbac_req,
+                                             struct hbac_info **info);
+
+/**
+ * @brief List the rules of a compiled rule set that may match a request
+ *
+ * Only the listed rules are evaluated by #hbac_evaluate_rule_set for the
+ * same request, the user elements of the other rules are not used and
+ * do not have to be set.
+ *
+ * @param[in] rule_set A rule set created by #hbac_compile_rules
+ * @param[in] hbac_req A user authorization request, only the service and
+ *                     target host are used
+ * @param[out] idx     Indexes of the candidate rules in the list the set
+ *                     was compiled from, in ascending order. Must be freed
+ *                     with free().
+ * @param[out] num     Number of candidate rules
+ * @return
+ *  - #HBAC_SUCCESS:              The list was created
+ *  - #HBAC_ERROR_OUT_OF_MEMORY:  Insufficient memory
+ *  - #HBAC_ERROR_UNKNOWN:        Invalid arguments
+ */
+enum hbac_error_code hbac_rule_set_get_candidates(struct hbac_rule_set *rule_set,
+                                                  struct hbac_eval_req *hbac_req,
+                                                  size_t **idx,
+                                                  size_t *num);
+
+/**
+ * @brief Free a rule set created by #hbac_compile_rules
+ * @param rule_set The rule set to free, the rules themselves are not freed
+ */
+void hbac_free_rule_set(struct hbac_rule_set *rule_set);
+
 /** User element */
 #define HBAC_RULE_ELEMENT_USERS       0x01
 
@@ -31,6 +31,16 @@
 /* Time to wait during a C_Finalize C_Initialize cycle to discover
  * new slots. */
 #define PKCS11_FINIALIZE_INITIALIZE_WAIT_TIME 3
+
+/* Largest request a p11_child worker accepts, see p11c_worker(). */
+#define P11_CHILD_WORKER_BUF_SIZE (16 * 1024)
+
+/* OCSP responses are cached until their nextUpdate time but not longer than
+ * this and responses without nextUpdate are not cached at all. */
+#define P11_CHILD_OCSP_CACHE_MAX_AGE (60 * 60)
+#define P11_CHILD_OCSP_CACHE_MAX_ENTRIES 256
+#define P11_CHILD_OCSP_CACHE_DIGEST_MAX 64
+
 struct p11_ctx;
 
 struct cert_verify_opts {
@@ -39,6 +49,7 @@ struct cert_verify_opts {
     char *ocsp_default_responder;
     char *ocsp_default_responder_signing_cert;
     char *crl_file;
+    char *ocsp_cache_file;
     CK_MECHANISM_TYPE ocsp_dgst;
     bool soft_ocsp;
     bool soft_crl;
@@ -60,6 +71,14 @@ enum pin_mode {
 errno_t init_p11_ctx(TALLOC_CTX *mem_ctx, const char *ca_db,
                      bool wait_for_card, struct p11_ctx **p11_ctx);
 
+/* In persistent mode the PKCS#11 modules stay initialized after do_card()
+ * returns so that the next call can use them right away. */
+void p11_ctx_set_persistent(struct p11_ctx *p11_ctx, bool persistent);
+
+void p11_ctx_set_wait_for_card(struct p11_ctx *p11_ctx, bool wait_for_card);
+
+/* Can be called again with the same p11_ctx, the CA certificates and the CRL
+ * are only read again if one of the files was modified. */
 errno_t init_verification(struct p11_ctx *p11_ctx,
                           struct cert_verify_opts *cert_verify_opts);
 
@@ -72,4 +91,30 @@ errno_t do_card(TALLOC_CTX *mem_ctx, struct p11_ctx *p11_ctx,
 
 errno_t parse_cert_verify_opts(TALLOC_CTX *mem_ctx, const char *verify_opts,
                                struct cert_verify_opts **cert_verify_opts);
+
+/* Cache of OCSP results keyed by a hash of the certificate. If path is set
+ * the results are shared with other p11_child processes through this file.
+ * ca_db_mtime and crl_mtime identify the certificate store the responses
+ * were verified with, results stored for a different store or with other
+ * OCSP options in opts are ignored. */
+struct p11_ocsp_cache;
+
+errno_t p11_ocsp_cache_init(TALLOC_CTX *mem_ctx, const char *path,
+                            time_t ca_db_mtime, time_t crl_mtime,
+                            const struct cert_verify_opts *opts,
+                            struct p11_ocsp_cache **_cache);
+
+/* Returns EOK for a cached good status, EACCES for a cached revoked status
+ * and ENOENT if there is no valid entry for the certificate. */
+errno_t p11_ocsp_cache_lookup(struct p11_ocsp_cache *cache,
+                              const uint8_t *digest,
+                              size_t digest_len);
+
+/* The result is kept until next_update but not longer than
+ * P11_CHILD_OCSP_CACHE_MAX_AGE. */
+void p11_ocsp_cache_add(struct p11_ocsp_cache *cache,
+                        const uint8_t *digest,
+                        size_t digest_len,
+                        bool revoked,
+                        time_t next_update);
 #endif /* __P11_CHILD_H__ */
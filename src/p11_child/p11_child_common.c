@@ -55,31 +55,23 @@ static const char *op_mode_str(enum op_mode mode)
     }
 }
 
-static int do_work(TALLOC_CTX *mem_ctx, enum op_mode mode, const char *ca_db,
-                   struct cert_verify_opts *cert_verify_opts,
-                   bool wait_for_card,
-                   const char *cert_b64, const char *pin,
-                   const char *module_name, const char *token_name,
-                   const char *key_id, const char *uri, char **multi)
+static int do_op(TALLOC_CTX *mem_ctx, struct p11_ctx *p11_ctx,
+                 enum op_mode mode,
+                 struct cert_verify_opts *cert_verify_opts,
+                 const char *cert_b64, const char *pin,
+                 const char *module_name, const char *token_name,
+                 const char *key_id, const char *uri, char **multi)
 {
     int ret;
-    struct p11_ctx *p11_ctx;
-
-    ret = init_p11_ctx(mem_ctx, ca_db, wait_for_card, &p11_ctx);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "init_p11_ctx failed.\n");
-        return ret;
-    }
 
     if (cert_verify_opts->do_verification) {
         ret = init_verification(p11_ctx, cert_verify_opts);
         if (ret != 0) {
             DEBUG(SSSDBG_OP_FAILURE, "init_verification failed.\n");
-            goto done;
+            return ret;
         }
     }
 
-
     if (mode == OP_VERIFIY) {
         if (!cert_verify_opts->do_verification
                     || do_verification_b64(p11_ctx, cert_b64)) {
@@ -94,7 +86,28 @@ static int do_work(TALLOC_CTX *mem_ctx, enum op_mode mode, const char *ca_db,
                       module_name, token_name, key_id, uri, multi);
     }
 
-done:
+    return ret;
+}
+
+static int do_work(TALLOC_CTX *mem_ctx, enum op_mode mode, const char *ca_db,
+                   struct cert_verify_opts *cert_verify_opts,
+                   bool wait_for_card,
+                   const char *cert_b64, const char *pin,
+                   const char *module_name, const char *token_name,
+                   const char *key_id, const char *uri, char **multi)
+{
+    int ret;
+    struct p11_ctx *p11_ctx;
+
+    ret = init_p11_ctx(mem_ctx, ca_db, wait_for_card, &p11_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "init_p11_ctx failed.\n");
+        return ret;
+    }
+
+    ret = do_op(mem_ctx, p11_ctx, mode, cert_verify_opts, cert_b64, pin,
+                module_name, token_name, key_id, uri, multi);
+
     talloc_free(p11_ctx);
 
     return ret;
@@ -140,6 +153,308 @@ static errno_t p11c_recv_data(TALLOC_CTX *mem_ctx, int fd, char **pin)
     return EOK;
 }
 
+struct p11c_worker_req {
+    enum op_mode mode;
+    enum pin_mode pin_mode;
+    bool wait_for_card;
+    const char *pin;
+    char *module_name;
+    char *token_name;
+    char *key_id;
+    char *cert_b64;
+    char *uri;
+};
+
+static errno_t p11c_worker_parse_req(TALLOC_CTX *mem_ctx,
+                                     char *buf, size_t len,
+                                     struct p11c_worker_req **_wreq)
+{
+    struct p11c_worker_req *wreq;
+    const char **argv = NULL;
+    poptContext pc = NULL;
+    char **dest;
+    char *arg;
+    char *p;
+    size_t argc;
+    size_t c;
+    int opt;
+    errno_t ret;
+
+    struct poptOption options[] = {
+        {"auth", 0, POPT_ARG_NONE, NULL, 'a', NULL, NULL},
+        {"pre", 0, POPT_ARG_NONE, NULL, 'p', NULL, NULL},
+        {"verification", 0, POPT_ARG_NONE, NULL, 'v', NULL, NULL},
+        {"wait_for_card", 0, POPT_ARG_NONE, NULL, 'w', NULL, NULL},
+        {"pin", 0, POPT_ARG_NONE, NULL, 'i', NULL, NULL},
+        {"keypad", 0, POPT_ARG_NONE, NULL, 'k', NULL, NULL},
+        {"module_name", 0, POPT_ARG_STRING, NULL, 'm', NULL, NULL},
+        {"token_name", 0, POPT_ARG_STRING, NULL, 't', NULL, NULL},
+        {"key_id", 0, POPT_ARG_STRING, NULL, 'K', NULL, NULL},
+        {"certificate", 0, POPT_ARG_STRING, NULL, 'c', NULL, NULL},
+        {"uri", 0, POPT_ARG_STRING, NULL, 'u', NULL, NULL},
+        POPT_TABLEEND
+    };
+
+    if (len == 0 || buf[len - 1] != '\0') {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Request is not NUL-terminated.\n");
+        return EINVAL;
+    }
+
+    wreq = talloc_zero(mem_ctx, struct p11c_worker_req);
+    if (wreq == NULL) {
+        return ENOMEM;
+    }
+
+    /* The first string is the PIN, the others are the options. argv[0] is
+     * skipped by popt. */
+    argc = 0;
+    for (c = 0; c < len; c++) {
+        if (buf[c] == '\0') {
+            argc++;
+        }
+    }
+
+    argv = talloc_zero_array(wreq, const char *, argc + 1);
+    if (argv == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    wreq->pin = buf;
+    argv[0] = "p11_child";
+    p = buf + strlen(buf) + 1;
+    for (c = 1; c < argc; c++) {
+        argv[c] = p;
+        p += strlen(p) + 1;
+    }
+
+    pc = poptGetContext(argv[0], argc, argv, options, 0);
+    if (pc == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        dest = NULL;
+        switch (opt) {
+        case 'a':
+        case 'p':
+        case 'v':
+            if (wreq->mode != OP_NONE) {
+                DEBUG(SSSDBG_CRIT_FAILURE,
+                      "--verification, --auth and --pre are mutually "
+                      "exclusive and should be only used once.\n");
+                ret = EINVAL;
+                goto done;
+            }
+            wreq->mode = opt == 'a' ? OP_AUTH
+                                    : (opt == 'p' ? OP_PREAUTH : OP_VERIFIY);
+            break;
+        case 'i':
+        case 'k':
+            if (wreq->pin_mode != PIN_NONE) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "--pin and --keypad are mutually "
+                      "exclusive and should be only used once.\n");
+                ret = EINVAL;
+                goto done;
+            }
+            wreq->pin_mode = opt == 'i' ? PIN_STDIN : PIN_KEYPAD;
+            break;
+        case 'w':
+            wreq->wait_for_card = true;
+            break;
+        case 'm':
+            dest = &wreq->module_name;
+            break;
+        case 't':
+            dest = &wreq->token_name;
+            break;
+        case 'K':
+            dest = &wreq->key_id;
+            break;
+        case 'c':
+            dest = &wreq->cert_b64;
+            break;
+        case 'u':
+            dest = &wreq->uri;
+            break;
+        default:
+            DEBUG(SSSDBG_CRIT_FAILURE, "Invalid option %s: %s\n",
+                  poptBadOption(pc, 0), poptStrerror(opt));
+            ret = EINVAL;
+            goto done;
+        }
+
+        if (dest != NULL) {
+            arg = poptGetOptArg(pc);
+            *dest = talloc_strdup(wreq, arg == NULL ? "" : arg);
+            free(arg);
+            if (*dest == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+        }
+    }
+
+    if (wreq->mode == OP_NONE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Missing operation mode.\n");
+        ret = EINVAL;
+        goto done;
+    } else if (wreq->mode == OP_AUTH && (wreq->pin_mode == PIN_NONE
+                                        || wreq->module_name == NULL
+                                        || wreq->token_name == NULL
+                                        || wreq->key_id == NULL)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "PIN mode, --module_name, --token_name "
+              "and --key_id must be given for authentication.\n");
+        ret = EINVAL;
+        goto done;
+    } else if (wreq->mode == OP_VERIFIY && wreq->cert_b64 == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Missing certificate for verification.\n");
+        ret = EINVAL;
+        goto done;
+    }
+
+    if (wreq->mode == OP_AUTH && wreq->pin_mode == PIN_STDIN) {
+        if (*wreq->pin == '\0') {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Missing PIN.\n");
+            ret = EINVAL;
+            goto done;
+        }
+    } else {
+        wreq->pin = NULL;
+    }
+
+    *_wreq = wreq;
+    ret = EOK;
+
+done:
+    if (pc != NULL) {
+        poptFreeContext(pc);
+    }
+    if (ret != EOK) {
+        talloc_free(wreq);
+    }
+
+    return ret;
+}
+
+static errno_t p11c_worker_reply(errno_t req_ret, const char *multi)
+{
+    uint8_t *reply;
+    size_t reply_len;
+    size_t multi_len;
+    size_t p = 0;
+    ssize_t len;
+    errno_t ret;
+
+    multi_len = multi == NULL ? 0 : strlen(multi);
+    reply_len = sizeof(uint32_t) + multi_len;
+
+    reply = talloc_size(NULL, reply_len);
+    if (reply == NULL) {
+        return ENOMEM;
+    }
+
+    SAFEALIGN_SETMEM_UINT32(reply, (uint32_t) req_ret, &p);
+    if (multi_len != 0) {
+        safealign_memcpy(reply + p, multi, multi_len, &p);
+    }
+
+    errno = 0;
+    len = sss_atomic_write_frame_s(STDOUT_FILENO, reply, reply_len);
+    if (len == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "write failed [%d][%s].\n", ret, strerror(ret));
+    } else {
+        ret = EOK;
+    }
+
+    talloc_free(reply);
+    return ret;
+}
+
+/* In worker mode p11_child keeps running and handles one request after the
+ * other, each framed as described in sss_atomic_read_frame_s(). The PKCS#11
+ * modules stay initialized, the CA certificates are only read again if the
+ * file changed and OCSP responses are cached. A new session is still opened
+ * for every request, so no login state is carried over. A request is a
+ * sequence of NUL-terminated strings, the first is the PIN, which might be
+ * empty, and the others are the options a single-shot p11_child would get,
+ * e.g. "--pre" or "--module_name" followed by the name. The reply starts
+ * with a uint32_t return code followed by the output a single-shot
+ * p11_child would write to stdout. The worker exits when the PAM responder
+ * closes the pipe. */
+static errno_t p11c_worker(TALLOC_CTX *mem_ctx, const char *ca_db,
+                           struct cert_verify_opts *cert_verify_opts)
+{
+    char buf[P11_CHILD_WORKER_BUF_SIZE];
+    struct p11_ctx *p11_ctx;
+    struct p11c_worker_req *wreq;
+    TALLOC_CTX *tmp_ctx;
+    size_t num_requests = 0;
+    char *multi;
+    ssize_t len;
+    errno_t ret;
+
+    ret = init_p11_ctx(mem_ctx, ca_db, false, &p11_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "init_p11_ctx failed.\n");
+        return ret;
+    }
+    p11_ctx_set_persistent(p11_ctx, true);
+
+    while (true) {
+        errno = 0;
+        len = sss_atomic_read_frame_s(STDIN_FILENO, buf, sizeof(buf));
+        if (len == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "read failed [%d][%s].\n", ret, strerror(ret));
+            break;
+        } else if (len == 0) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  "No more requests, %zu handled\n", num_requests);
+            ret = EOK;
+            break;
+        }
+
+        tmp_ctx = talloc_new(mem_ctx);
+        if (tmp_ctx == NULL) {
+            sss_erase_mem_securely(buf, len);
+            ret = ENOMEM;
+            break;
+        }
+
+        multi = NULL;
+        ret = p11c_worker_parse_req(tmp_ctx, buf, len, &wreq);
+        if (ret == EOK) {
+            DEBUG(SSSDBG_TRACE_INTERNAL, "Running in [%s] mode.\n",
+                                         op_mode_str(wreq->mode));
+            p11_ctx_set_wait_for_card(p11_ctx, wreq->wait_for_card);
+            ret = do_op(tmp_ctx, p11_ctx, wreq->mode, cert_verify_opts,
+                        wreq->cert_b64, wreq->pin, wreq->module_name,
+                        wreq->token_name, wreq->key_id, wreq->uri, &multi);
+        }
+        sss_erase_mem_securely(buf, len);
+
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Request failed [%d]: %s\n",
+                                     ret, sss_strerror(ret));
+        }
+
+        ret = p11c_worker_reply(ret, multi);
+        talloc_free(tmp_ctx);
+        if (ret != EOK) {
+            break;
+        }
+        num_requests++;
+    }
+
+    talloc_free(p11_ctx);
+    return ret;
+}
+
 int main(int argc, const char *argv[])
 {
     int opt;
@@ -161,6 +476,7 @@ int main(int argc, const char *argv[])
     char *cert_b64 = NULL;
     bool wait_for_card = false;
     char *uri = NULL;
+    int worker = 0;
 
     struct poptOption long_options[] = {
         POPT_AUTOHELP
@@ -198,6 +514,8 @@ int main(int argc, const char *argv[])
          _("certificate to verify, base64 encoded"), NULL},
         {"uri", 0, POPT_ARG_STRING, &uri, 0,
          _("PKCS#11 URI to restrict selection"), NULL},
+        {"worker", 0, POPT_ARG_NONE, &worker, 0,
+         _("Handle requests from stdin until it is closed"), NULL},
         POPT_TABLEEND
     };
 
@@ -282,7 +600,14 @@ int main(int argc, const char *argv[])
         _exit(-1);
     }
 
-    if (mode == OP_NONE) {
+    if (worker) {
+        if (mode != OP_NONE || pin_mode != PIN_NONE) {
+            fprintf(stderr, "\nThe operation and PIN mode are given with "
+                            "each request in worker mode.\n\n");
+            poptPrintUsage(pc, stderr, 0);
+            _exit(-1);
+        }
+    } else if (mode == OP_NONE) {
         fprintf(stderr, "\nMissing operation mode, either " \
                         "--verify, --auth or --pre must be specified.\n\n");
         poptPrintUsage(pc, stderr, 0);
@@ -322,7 +647,8 @@ int main(int argc, const char *argv[])
 
     DEBUG(SSSDBG_TRACE_FUNC, "p11_child started.\n");
 
-    DEBUG(SSSDBG_TRACE_INTERNAL, "Running in [%s] mode.\n", op_mode_str(mode));
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Running in [%s] mode.\n",
+                                 worker ? "worker" : op_mode_str(mode));
 
     DEBUG(SSSDBG_TRACE_INTERNAL,
           "Running with effective IDs: [%"SPRIuid"][%"SPRIgid"].\n",
@@ -354,6 +680,17 @@ int main(int argc, const char *argv[])
         goto fail;
     }
 
+    if (worker) {
+        ret = p11c_worker(main_ctx, ca_db, cert_verify_opts);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "p11c_worker failed.\n");
+            goto fail;
+        }
+
+        talloc_free(main_ctx);
+        return EXIT_SUCCESS;
+    }
+
     if (mode == OP_VERIFIY && !cert_verify_opts->do_verification) {
         fprintf(stderr,
                 "Called verification with option 'no_verification', "
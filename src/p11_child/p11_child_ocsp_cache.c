@@ -0,0 +1,512 @@
+/*
+    SSSD
+
+    Helper child to commmunicate with SmartCard -- OCSP status cache
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "shared/murmurhash3.h"
+#include "p11_child/p11_child.h"
+
+#define OCSP_CACHE_MAGIC 0x5053434f /* "OCSP" */
+#define OCSP_CACHE_VERSION 2
+
+/* magic, version, ca_db_mtime, crl_mtime, opts_hash, number of entries */
+#define OCSP_CACHE_HEADER_SIZE (2 * sizeof(uint32_t) + 2 * sizeof(int64_t) \
+                                + 2 * sizeof(uint32_t))
+/* digest_len, digest, expire, revoked */
+#define OCSP_CACHE_RECORD_SIZE (sizeof(uint32_t) \
+                                + P11_CHILD_OCSP_CACHE_DIGEST_MAX \
+                                + sizeof(int64_t) + sizeof(uint32_t))
+#define OCSP_CACHE_FILE_MAX_SIZE (OCSP_CACHE_HEADER_SIZE \
+                                  + P11_CHILD_OCSP_CACHE_MAX_ENTRIES \
+                                                * OCSP_CACHE_RECORD_SIZE)
+
+struct ocsp_cache_entry {
+    uint8_t digest[P11_CHILD_OCSP_CACHE_DIGEST_MAX];
+    size_t digest_len;
+    time_t expire;
+    bool revoked;
+
+    struct ocsp_cache_entry *prev;
+    struct ocsp_cache_entry *next;
+};
+
+struct p11_ocsp_cache {
+    const char *path;
+    time_t ca_db_mtime;
+    time_t crl_mtime;
+    uint32_t opts_hash;
+
+    /* modification time of the cache file when it was read last */
+    time_t file_mtime;
+
+    /* most recently used first */
+    struct ocsp_cache_entry *entries;
+    size_t num_entries;
+};
+
+/* The responses were verified with the default responder, its signing
+ * certificate and the digest given in the options, results stored by a
+ * p11_child running with other options must not be used. */
+static uint32_t ocsp_cache_opts_hash(const struct cert_verify_opts *opts)
+{
+    const char *responder = "";
+    const char *signing_cert = "";
+    uint64_t dgst = 0;
+    uint32_t hash = 0;
+
+    if (opts != NULL) {
+        if (opts->ocsp_default_responder != NULL) {
+            responder = opts->ocsp_default_responder;
+        }
+        if (opts->ocsp_default_responder_signing_cert != NULL) {
+            signing_cert = opts->ocsp_default_responder_signing_cert;
+        }
+        dgst = opts->ocsp_dgst;
+    }
+
+    /* The terminating '\0' keeps the strings apart. */
+    hash = murmurhash3(responder, strlen(responder) + 1, hash);
+    hash = murmurhash3(signing_cert, strlen(signing_cert) + 1, hash);
+    hash = murmurhash3((const char *) &dgst, sizeof(dgst), hash);
+
+    return hash;
+}
+
+static struct ocsp_cache_entry *
+ocsp_cache_find(struct p11_ocsp_cache *cache,
+                const uint8_t *digest,
+                size_t digest_len,
+                time_t now)
+{
+    struct ocsp_cache_entry *entry;
+    struct ocsp_cache_entry *tmp;
+
+    DLIST_FOR_EACH_SAFE(entry, tmp, cache->entries) {
+        if (entry->expire <= now) {
+            DLIST_REMOVE(cache->entries, entry);
+            cache->num_entries--;
+            talloc_free(entry);
+            continue;
+        }
+
+        if (entry->digest_len == digest_len
+                && memcmp(entry->digest, digest, digest_len) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static errno_t ocsp_cache_insert(struct p11_ocsp_cache *cache,
+                                 const uint8_t *digest,
+                                 size_t digest_len,
+                                 bool revoked,
+                                 time_t expire)
+{
+    struct ocsp_cache_entry *entry;
+    struct ocsp_cache_entry *last;
+
+    entry = ocsp_cache_find(cache, digest, digest_len, time(NULL));
+    if (entry != NULL) {
+        entry->revoked = revoked;
+        entry->expire = expire;
+        DLIST_PROMOTE(cache->entries, entry);
+        return EOK;
+    }
+
+    if (cache->num_entries >= P11_CHILD_OCSP_CACHE_MAX_ENTRIES) {
+        for (last = cache->entries; last->next != NULL; last = last->next);
+        DLIST_REMOVE(cache->entries, last);
+        cache->num_entries--;
+        talloc_free(last);
+    }
+
+    entry = talloc_zero(cache, struct ocsp_cache_entry);
+    if (entry == NULL) {
+        return ENOMEM;
+    }
+
+    memcpy(entry->digest, digest, digest_len);
+    entry->digest_len = digest_len;
+    entry->expire = expire;
+    entry->revoked = revoked;
+
+    DLIST_ADD(cache->entries, entry);
+    cache->num_entries++;
+
+    return EOK;
+}
+
+/* Merges the entries of the cache file into the cache. Entries already in
+ * memory are kept, they are at least as recent as the ones on disk. */
+static errno_t ocsp_cache_read_file(struct p11_ocsp_cache *cache)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct stat st;
+    uint8_t *buf = NULL;
+    size_t p = 0;
+    uint32_t magic;
+    uint32_t version;
+    int64_t ca_db_mtime;
+    int64_t crl_mtime;
+    uint32_t opts_hash;
+    uint32_t num;
+    uint32_t digest_len;
+    int64_t expire;
+    uint32_t revoked;
+    time_t now = time(NULL);
+    errno_t ret;
+    ssize_t len;
+    uint32_t c;
+    int fd;
+
+    fd = open(cache->path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        ret = errno;
+        if (ret != ENOENT) {
+            DEBUG(SSSDBG_OP_FAILURE, "Cannot open OCSP cache [%s] [%d]: %s\n",
+                  cache->path, ret, sss_strerror(ret));
+        }
+        return ret;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, "fstat failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    /* Do not try again until the file changes. */
+    cache->file_mtime = st.st_mtime;
+
+    /* A good status in the cache file lets a certificate pass the OCSP
+     * check, only trust files nobody else could have written. */
+    if (!S_ISREG(st.st_mode) || st.st_uid != geteuid()
+            || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "OCSP cache [%s] must be a regular file owned by "
+              "uid [%"SPRIuid"] and not writable by others, ignoring it.\n",
+              cache->path, geteuid());
+        ret = EPERM;
+        goto done;
+    }
+
+    if (st.st_size < (off_t) OCSP_CACHE_HEADER_SIZE
+            || st.st_size > (off_t) OCSP_CACHE_FILE_MAX_SIZE) {
+        DEBUG(SSSDBG_OP_FAILURE, "OCSP cache [%s] has unexpected size, "
+                                 "ignoring it.\n", cache->path);
+        ret = EINVAL;
+        goto done;
+    }
+
+    buf = talloc_size(tmp_ctx, st.st_size);
+    if (buf == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    len = sss_atomic_read_s(fd, buf, st.st_size);
+    if (len != st.st_size) {
+        ret = len == -1 ? errno : EIO;
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot read OCSP cache [%s].\n",
+                                 cache->path);
+        goto done;
+    }
+
+    SAFEALIGN_COPY_UINT32(&magic, buf + p, &p);
+    SAFEALIGN_COPY_UINT32(&version, buf + p, &p);
+    SAFEALIGN_COPY_INT64(&ca_db_mtime, buf + p, &p);
+    SAFEALIGN_COPY_INT64(&crl_mtime, buf + p, &p);
+    SAFEALIGN_COPY_UINT32(&opts_hash, buf + p, &p);
+    SAFEALIGN_COPY_UINT32(&num, buf + p, &p);
+
+    if (magic != OCSP_CACHE_MAGIC || version != OCSP_CACHE_VERSION
+            || num > P11_CHILD_OCSP_CACHE_MAX_ENTRIES
+            || st.st_size != (off_t) (OCSP_CACHE_HEADER_SIZE
+                                      + num * OCSP_CACHE_RECORD_SIZE)) {
+        DEBUG(SSSDBG_OP_FAILURE, "OCSP cache [%s] is malformed, "
+                                 "ignoring it.\n", cache->path);
+        ret = EINVAL;
+        goto done;
+    }
+
+    if (ca_db_mtime != cache->ca_db_mtime || crl_mtime != cache->crl_mtime
+            || opts_hash != cache->opts_hash) {
+        DEBUG(SSSDBG_TRACE_FUNC, "OCSP cache [%s] was written for a different "
+                                 "CA DB, CRL or OCSP options, ignoring it.\n",
+                                 cache->path);
+        ret = EOK;
+        goto done;
+    }
+
+    for (c = 0; c < num; c++) {
+        SAFEALIGN_COPY_UINT32(&digest_len, buf + p, &p);
+        if (digest_len == 0 || digest_len > P11_CHILD_OCSP_CACHE_DIGEST_MAX) {
+            DEBUG(SSSDBG_OP_FAILURE, "OCSP cache [%s] is malformed, "
+                                     "ignoring the rest of it.\n",
+                                     cache->path);
+            break;
+        }
+
+        SAFEALIGN_COPY_INT64(&expire, buf + p + P11_CHILD_OCSP_CACHE_DIGEST_MAX,
+                             NULL);
+        SAFEALIGN_COPY_UINT32(&revoked,
+                              buf + p + P11_CHILD_OCSP_CACHE_DIGEST_MAX
+                                      + sizeof(int64_t), NULL);
+
+        /* Do not trust lifetimes longer than we would have set. */
+        if (expire > now && expire <= now + P11_CHILD_OCSP_CACHE_MAX_AGE
+                && ocsp_cache_find(cache, buf + p, digest_len, now) == NULL
+                && cache->num_entries < P11_CHILD_OCSP_CACHE_MAX_ENTRIES) {
+            ret = ocsp_cache_insert(cache, buf + p, digest_len,
+                                    revoked != 0, (time_t) expire);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+
+        p += OCSP_CACHE_RECORD_SIZE - sizeof(uint32_t);
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "Read OCSP cache [%s], [%zu] entries in use.\n",
+                            cache->path, cache->num_entries);
+    ret = EOK;
+
+done:
+    close(fd);
+    talloc_free(tmp_ctx);
+
+    return ret;
+}
+
+static errno_t ocsp_cache_write_file(struct p11_ocsp_cache *cache)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ocsp_cache_entry *entry;
+    struct stat st;
+    char *tmp_path;
+    uint8_t *buf;
+    size_t size;
+    size_t p = 0;
+    time_t now = time(NULL);
+    uint32_t num = 0;
+    errno_t ret;
+    ssize_t len;
+    int fd = -1;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    size = OCSP_CACHE_HEADER_SIZE
+                + cache->num_entries * OCSP_CACHE_RECORD_SIZE;
+    buf = talloc_zero_size(tmp_ctx, size);
+    tmp_path = talloc_asprintf(tmp_ctx, "%s.XXXXXX", cache->path);
+    if (buf == NULL || tmp_path == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    p = OCSP_CACHE_HEADER_SIZE;
+    DLIST_FOR_EACH(entry, cache->entries) {
+        if (entry->expire <= now) {
+            continue;
+        }
+
+        SAFEALIGN_SET_UINT32(buf + p, entry->digest_len, &p);
+        memcpy(buf + p, entry->digest, entry->digest_len);
+        p += P11_CHILD_OCSP_CACHE_DIGEST_MAX;
+        SAFEALIGN_SET_INT64(buf + p, entry->expire, &p);
+        SAFEALIGN_SET_UINT32(buf + p, entry->revoked ? 1 : 0, &p);
+        num++;
+    }
+    size = p;
+
+    p = 0;
+    SAFEALIGN_SET_UINT32(buf + p, OCSP_CACHE_MAGIC, &p);
+    SAFEALIGN_SET_UINT32(buf + p, OCSP_CACHE_VERSION, &p);
+    SAFEALIGN_SET_INT64(buf + p, cache->ca_db_mtime, &p);
+    SAFEALIGN_SET_INT64(buf + p, cache->crl_mtime, &p);
+    SAFEALIGN_SET_UINT32(buf + p, cache->opts_hash, &p);
+    SAFEALIGN_SET_UINT32(buf + p, num, &p);
+
+    fd = sss_unique_file(NULL, tmp_path, &ret);
+    if (fd == -1) {
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot create temporary OCSP cache file "
+                                 "[%d]: %s\n", ret, sss_strerror(ret));
+        goto done;
+    }
+
+    len = sss_atomic_write_s(fd, buf, size);
+    if (len != (ssize_t) size) {
+        ret = len == -1 ? errno : EIO;
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot write OCSP cache [%d]: %s\n",
+                                 ret, sss_strerror(ret));
+        goto done;
+    }
+
+    if (fstat(fd, &st) == 0) {
+        cache->file_mtime = st.st_mtime;
+    }
+
+    /* Other p11_child processes read either the old or the new file. */
+    if (rename(tmp_path, cache->path) != 0) {
+        ret = errno;
+        DEBUG(SSSDBG_OP_FAILURE, "Cannot rename [%s] to [%s] [%d]: %s\n",
+                                 tmp_path, cache->path, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "Wrote [%"PRIu32"] entries to OCSP cache [%s].\n",
+                            num, cache->path);
+    ret = EOK;
+
+done:
+    if (fd != -1) {
+        close(fd);
+        if (ret != EOK) {
+            unlink(tmp_path);
+        }
+    }
+    talloc_free(tmp_ctx);
+
+    return ret;
+}
+
+errno_t p11_ocsp_cache_init(TALLOC_CTX *mem_ctx, const char *path,
+                            time_t ca_db_mtime, time_t crl_mtime,
+                            const struct cert_verify_opts *opts,
+                            struct p11_ocsp_cache **_cache)
+{
+    struct p11_ocsp_cache *cache;
+
+    cache = talloc_zero(mem_ctx, struct p11_ocsp_cache);
+    if (cache == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "talloc_zero failed.\n");
+        return ENOMEM;
+    }
+
+    cache->ca_db_mtime = ca_db_mtime;
+    cache->crl_mtime = crl_mtime;
+    cache->opts_hash = ocsp_cache_opts_hash(opts);
+
+    /* Without the modification times there is no way to tell if the cache
+     * file belongs to the current CA DB, keep the cache in memory only. */
+    if (path != NULL && ca_db_mtime != 0) {
+        cache->path = talloc_strdup(cache, path);
+        if (cache->path == NULL) {
+            talloc_free(cache);
+            return ENOMEM;
+        }
+
+        /* Not fatal, the cache starts empty. */
+        ocsp_cache_read_file(cache);
+    }
+
+    *_cache = cache;
+
+    return EOK;
+}
+
+errno_t p11_ocsp_cache_lookup(struct p11_ocsp_cache *cache,
+                              const uint8_t *digest,
+                              size_t digest_len)
+{
+    struct ocsp_cache_entry *entry;
+    struct stat st;
+
+    if (cache == NULL || digest_len == 0) {
+        return ENOENT;
+    }
+
+    entry = ocsp_cache_find(cache, digest, digest_len, time(NULL));
+    if (entry == NULL && cache->path != NULL
+            && stat(cache->path, &st) == 0
+            && st.st_mtime != cache->file_mtime) {
+        /* Another p11_child might have checked the certificate meanwhile. */
+        ocsp_cache_read_file(cache);
+        entry = ocsp_cache_find(cache, digest, digest_len, time(NULL));
+    }
+
+    if (entry == NULL) {
+        return ENOENT;
+    }
+
+    DLIST_PROMOTE(cache->entries, entry);
+
+    return entry->revoked ? EACCES : EOK;
+}
+
+void p11_ocsp_cache_add(struct p11_ocsp_cache *cache,
+                        const uint8_t *digest,
+                        size_t digest_len,
+                        bool revoked,
+                        time_t next_update)
+{
+    time_t now = time(NULL);
+    time_t expire;
+    errno_t ret;
+
+    if (cache == NULL || digest_len == 0
+            || digest_len > P11_CHILD_OCSP_CACHE_DIGEST_MAX
+            || next_update <= now) {
+        return;
+    }
+
+    expire = MIN(next_update, now + P11_CHILD_OCSP_CACHE_MAX_AGE);
+
+    if (cache->path != NULL) {
+        /* Pick up what other p11_child processes added so that writing the
+         * file does not drop their entries. Not fatal. */
+        ocsp_cache_read_file(cache);
+    }
+
+    ret = ocsp_cache_insert(cache, digest, digest_len, revoked, expire);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Cannot cache OCSP status.\n");
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_ALL, "Caching OCSP status for %ld seconds.\n",
+                            (long) (expire - now));
+
+    if (cache->path != NULL) {
+        ret = ocsp_cache_write_file(cache);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "OCSP status is only cached in memory.\n");
+        }
+    }
+}
@@ -23,6 +23,8 @@
 */
 
 #include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <openssl/ssl.h>
 #include <openssl/crypto.h>
 #include <openssl/x509.h>
@@ -39,11 +41,29 @@
 #include "util/child_common.h"
 #include "p11_child/p11_child.h"
 
+/* Identifies the version of a file, a replaced file or one rewritten in
+ * the same second as the previous version has a different id. */
+struct p11_file_id {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtim;
+};
+
 struct p11_ctx {
     X509_STORE *x509_store;
     const char *ca_db;
     bool wait_for_card;
     struct cert_verify_opts *cert_verify_opts;
+
+    /* versions of the files x509_store was loaded from */
+    struct p11_file_id ca_db_id;
+    struct p11_file_id crl_id;
+
+    bool persistent;
+    CK_FUNCTION_LIST **modules;
+
+    struct p11_ocsp_cache *ocsp_cache;
 };
 
 static OCSP_RESPONSE *query_responder(BIO *cbio, const char *host,
@@ -278,6 +298,26 @@ done:
     return str;
 }
 
+/* Returns when the OCSP response should be fetched again or 0 if it
+ * cannot be cached. */
+static time_t get_next_update(ASN1_GENERALIZEDTIME *nextupd)
+{
+    int days;
+    int secs;
+
+    if (nextupd == NULL) {
+        return 0;
+    }
+
+    if (ASN1_TIME_diff(&days, &secs, NULL, nextupd) != 1) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Cannot evaluate nextUpdate of OCSP response, not caching it.\n");
+        return 0;
+    }
+
+    return time(NULL) + (time_t) days * 24 * 60 * 60 + secs;
+}
+
 static errno_t do_ocsp(struct p11_ctx *p11_ctx, X509 *cert)
 {
     OCSP_REQUEST *ocsp_req = NULL;
@@ -305,6 +345,8 @@ static errno_t do_ocsp(struct p11_ctx *p11_ctx, X509 *cert)
     STACK_OF(X509_OBJECT) *store_objects;
     const EVP_MD *ocsp_dgst = NULL;
     char *tmp_str;
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
 
     ocsp_urls = X509_get1_ocsp(cert);
     if (ocsp_urls == NULL
@@ -315,6 +357,23 @@ static errno_t do_ocsp(struct p11_ctx *p11_ctx, X509 *cert)
         return EOK;
     }
 
+    if (X509_digest(cert, EVP_sha256(), digest, &digest_len) != 1) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "X509_digest failed, OCSP response will not be cached.\n");
+        digest_len = 0;
+    } else {
+        ret = p11_ocsp_cache_lookup(p11_ctx->ocsp_cache, digest, digest_len);
+        if (ret == EOK) {
+            DEBUG(SSSDBG_TRACE_ALL, "Using cached OCSP status [good].\n");
+            goto done;
+        } else if (ret == EACCES) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Cached OCSP status says certificate is revoked.\n");
+            ret = EIO;
+            goto done;
+        }
+    }
+
     if (p11_ctx->cert_verify_opts->ocsp_default_responder != NULL) {
         url_str = p11_ctx->cert_verify_opts->ocsp_default_responder;
     } else {
@@ -472,6 +531,19 @@ static errno_t do_ocsp(struct p11_ctx *p11_ctx, X509 *cert)
         goto done;
     }
 
+    if (OCSP_check_validity(thisupd, nextupd, grace_time, -1) != 1) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "OCSP response is not valid anymore.\n");
+        ret = EIO;
+        goto done;
+    }
+
+    if (status == V_OCSP_CERTSTATUS_GOOD
+            || status == V_OCSP_CERTSTATUS_REVOKED) {
+        p11_ocsp_cache_add(p11_ctx->ocsp_cache, digest, digest_len,
+                           status == V_OCSP_CERTSTATUS_REVOKED,
+                           get_next_update(nextupd));
+    }
+
     if (status != V_OCSP_CERTSTATUS_GOOD) {
         DEBUG(SSSDBG_CRIT_FAILURE, "OCSP check failed with [%d][%s].\n",
                                    status, OCSP_cert_status_str(status));
@@ -483,12 +555,6 @@ static errno_t do_ocsp(struct p11_ctx *p11_ctx, X509 *cert)
         goto done;
     }
 
-    if (OCSP_check_validity(thisupd, nextupd, grace_time, -1) != 1) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "OCSP response is not valid anymore.\n");
-        ret = EIO;
-        goto done;
-    }
-
     DEBUG(SSSDBG_TRACE_ALL, "OCSP check was successful.\n");
     ret = EOK;
 
@@ -572,6 +638,14 @@ done:
 
 static int talloc_cleanup_openssl(struct p11_ctx *p11_ctx)
 {
+    X509_STORE_free(p11_ctx->x509_store);
+    p11_ctx->x509_store = NULL;
+
+    if (p11_ctx->modules != NULL) {
+        p11_kit_modules_finalize_and_release(p11_ctx->modules);
+        p11_ctx->modules = NULL;
+    }
+
     CRYPTO_cleanup_all_ex_data();
 
     return 0;
@@ -610,11 +684,41 @@ errno_t init_p11_ctx(TALLOC_CTX *mem_ctx, const char *ca_db,
     return EOK;
 }
 
-static int talloc_free_x509_store(struct p11_ctx *p11_ctx)
+void p11_ctx_set_persistent(struct p11_ctx *p11_ctx, bool persistent)
 {
-    X509_STORE_free(p11_ctx->x509_store);
+    p11_ctx->persistent = persistent;
+}
 
-    return 0;
+void p11_ctx_set_wait_for_card(struct p11_ctx *p11_ctx, bool wait_for_card)
+{
+    p11_ctx->wait_for_card = wait_for_card;
+}
+
+/* Returns a zeroed id if the file does not exist. */
+static void get_file_id(const char *path, struct p11_file_id *id)
+{
+    struct stat st;
+
+    memset(id, 0, sizeof(struct p11_file_id));
+
+    if (path == NULL || stat(path, &st) != 0) {
+        return;
+    }
+
+    id->dev = st.st_dev;
+    id->ino = st.st_ino;
+    id->size = st.st_size;
+    id->mtim = st.st_mtim;
+}
+
+static bool file_id_equal(const struct p11_file_id *a,
+                          const struct p11_file_id *b)
+{
+    return a->dev == b->dev
+            && a->ino == b->ino
+            && a->size == b->size
+            && a->mtim.tv_sec == b->mtim.tv_sec
+            && a->mtim.tv_nsec == b->mtim.tv_nsec;
 }
 
 errno_t init_verification(struct p11_ctx *p11_ctx,
@@ -625,6 +729,22 @@ errno_t init_verification(struct p11_ctx *p11_ctx,
     unsigned long err;
     X509_LOOKUP *lookup = NULL;
     X509_VERIFY_PARAM *verify_param = NULL;
+    struct p11_file_id ca_db_id;
+    struct p11_file_id crl_id;
+    struct p11_ocsp_cache *ocsp_cache = NULL;
+
+    get_file_id(p11_ctx->ca_db, &ca_db_id);
+    get_file_id(cert_verify_opts->crl_file, &crl_id);
+
+    if (p11_ctx->x509_store != NULL
+            && p11_ctx->cert_verify_opts == cert_verify_opts
+            && ca_db_id.mtim.tv_sec != 0
+            && file_id_equal(&ca_db_id, &p11_ctx->ca_db_id)
+            && file_id_equal(&crl_id, &p11_ctx->crl_id)) {
+        DEBUG(SSSDBG_TRACE_ALL,
+              "CA DB and CRL are unchanged, reusing certificate store.\n");
+        return EOK;
+    }
 
     store = X509_STORE_new();
     if (store == NULL) {
@@ -675,9 +795,29 @@ errno_t init_verification(struct p11_ctx *p11_ctx,
         }
     }
 
+    /* The OCSP responses cached so far were verified with the old store,
+     * the new cache only picks up results stored for the current one. */
+    ret = p11_ocsp_cache_init(p11_ctx, cert_verify_opts->ocsp_cache_file,
+                              ca_db_id.mtim.tv_sec, crl_id.mtim.tv_sec,
+                              cert_verify_opts,
+                              &ocsp_cache);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "p11_ocsp_cache_init failed.\n");
+        goto done;
+    }
+
+    if (p11_ctx->x509_store != NULL) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "CA DB or CRL changed, certificate store reloaded.\n");
+        X509_STORE_free(p11_ctx->x509_store);
+    }
+    talloc_free(p11_ctx->ocsp_cache);
+
     p11_ctx->x509_store = store;
+    p11_ctx->ocsp_cache = ocsp_cache;
     p11_ctx->cert_verify_opts = cert_verify_opts;
-    talloc_set_destructor(p11_ctx, talloc_free_x509_store);
+    p11_ctx->ca_db_id = ca_db_id;
+    p11_ctx->crl_id = crl_id;
 
     ret = EOK;
 
@@ -1582,6 +1722,23 @@ static errno_t wait_for_card(CK_FUNCTION_LIST *module, CK_SLOT_ID *slot_id)
     return EOK;
 }
 
+static errno_t load_modules(struct p11_ctx *p11_ctx)
+{
+    if (p11_ctx->modules != NULL) {
+        p11_kit_modules_finalize_and_release(p11_ctx->modules);
+    }
+
+    /* Maybe use P11_KIT_MODULE_TRUSTED ? */
+    p11_ctx->modules = p11_kit_modules_load_and_initialize(0);
+    if (p11_ctx->modules == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "p11_kit_modules_load_and_initialize failed.\n");
+        return EIO;
+    }
+
+    return EOK;
+}
+
 #define MAX_SLOTS 64
 
 errno_t do_card(TALLOC_CTX *mem_ctx, struct p11_ctx *p11_ctx,
@@ -1616,6 +1773,7 @@ errno_t do_card(TALLOC_CTX *mem_ctx, struct p11_ctx *p11_ctx,
     char *multi = NULL;
     bool pkcs11_session = false;
     bool pkcs11_login = false;
+    bool modules_reloaded = false;
     P11KitUri *uri = NULL;
 
     if (uri_str != NULL) {
@@ -1629,14 +1787,16 @@ errno_t do_card(TALLOC_CTX *mem_ctx, struct p11_ctx *p11_ctx,
         }
     }
 
-
-    /* Maybe use P11_KIT_MODULE_TRUSTED ? */
-    modules = p11_kit_modules_load_and_initialize(0);
-    if (modules == NULL) {
-        DEBUG(SSSDBG_OP_FAILURE,
-              "p11_kit_modules_load_and_initialize failed.\n");
-        return EIO;
+    if (p11_ctx->modules == NULL) {
+        ret = load_modules(p11_ctx);
+        if (ret != EOK) {
+            goto done;
+        }
+        modules_reloaded = true;
+    } else {
+        DEBUG(SSSDBG_TRACE_ALL, "Using already initialized modules.\n");
     }
+    modules = p11_ctx->modules;
 
     for (;;) {
         DEBUG(SSSDBG_TRACE_ALL, "Module List:\n");
@@ -1726,20 +1886,33 @@ errno_t do_card(TALLOC_CTX *mem_ctx, struct p11_ctx *p11_ctx,
             }
         }
 
+        /* Readers plugged in after the modules were initialized by an
+         * earlier request only show up after a new C_Initialize. */
+        if (modules[c] == NULL && !modules_reloaded) {
+            DEBUG(SSSDBG_TRACE_ALL,
+                  "No slot found, initializing the modules again.\n");
+            ret = load_modules(p11_ctx);
+            if (ret != EOK) {
+                goto done;
+            }
+            modules = p11_ctx->modules;
+            modules_reloaded = true;
+            continue;
+        }
+
         /* When e.g. using Yubikeys the slot isn't present until the device is
          * inserted, so we should wait for a slot as well. */
         if (p11_ctx->wait_for_card && modules[c] == NULL) {
             p11_kit_modules_finalize_and_release(modules);
+            p11_ctx->modules = NULL;
 
             sleep(PKCS11_FINIALIZE_INITIALIZE_WAIT_TIME);
 
-            modules = p11_kit_modules_load_and_initialize(0);
-            if (modules == NULL) {
-                DEBUG(SSSDBG_OP_FAILURE,
-                      "p11_kit_modules_load_and_initialize failed.\n");
-                ret = EIO;
+            ret = load_modules(p11_ctx);
+            if (ret != EOK) {
                 goto done;
             }
+            modules = p11_ctx->modules;
 
         } else {
             break;
@@ -1968,7 +2141,10 @@ done:
     free(slot_name);
     free(token_name);
     free(module_file_name);
-    p11_kit_modules_finalize_and_release(modules);
+    if (!p11_ctx->persistent && p11_ctx->modules != NULL) {
+        p11_kit_modules_finalize_and_release(p11_ctx->modules);
+        p11_ctx->modules = NULL;
+    }
     p11_kit_uri_free(uri);
 
     return ret;
@@ -25,6 +25,8 @@
 
 #include "providers/data_provider.h"
 
+struct ad_gpo_cache;
+
 struct ad_access_ctx {
     struct dp_option *ad_options;
     struct sdap_access_ctx *sdap_access_ctx;
@@ -49,6 +51,8 @@ struct ad_access_ctx {
     } gpo_map_type;
     hash_table_t *gpo_map_options_table;
     enum gpo_map_type gpo_default_right;
+    /* GPOs of this host and their evaluated policies */
+    struct ad_gpo_cache *gpo_cache;
 };
 
 struct tevent_req *
@@ -42,6 +42,7 @@ struct ad_cldap_ping_dc_state {
     struct fo_server_info *dc;
     struct sdap_handle *sh;
     const char *ad_domain;
+    struct timeval start_time;
 
     char *site;
     char *forest;
@@ -74,6 +75,7 @@ static struct tevent_req *ad_cldap_ping_dc_send(TALLOC_CTX *mem_ctx,
     state->opts = opts;
     state->dc = dc;
     state->ad_domain = ad_domain;
+    state->start_time = tevent_timeval_current();
 
     subreq = sdap_connect_host_send(state, ev, opts, be_res->resolv,
                                     be_res->family_order, host_db, "cldap",
@@ -152,6 +154,8 @@ static void ad_cldap_ping_dc_done(struct tevent_req *subreq)
     struct tevent_req *req;
     struct sysdb_attrs **reply;
     size_t reply_count;
+    struct timeval now;
+    struct timeval elapsed;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
@@ -185,8 +189,12 @@ static void ad_cldap_ping_dc_done(struct tevent_req *subreq)
         goto done;
     }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "%s:%d: found site (%s) and forest (%s)\n",
-          state->dc->host, state->dc->port, state->site, state->forest);
+    now = tevent_timeval_current();
+    elapsed = tevent_timeval_until(&state->start_time, &now);
+    DEBUG(SSSDBG_TRACE_FUNC, "%s:%d: found site (%s) and forest (%s) "
+          "in %ld ms\n", state->dc->host, state->dc->port,
+          state->site, state->forest,
+          (long)(elapsed.tv_sec * 1000 + elapsed.tv_usec / 1000));
 
     ret = EOK;
 
@@ -201,6 +209,7 @@ done:
 
 static errno_t ad_cldap_ping_dc_recv(TALLOC_CTX *mem_ctx,
                                      struct tevent_req *req,
+                                     const char **_dc,
                                      const char **_site,
                                      const char **_forest)
 {
@@ -209,12 +218,24 @@ static errno_t ad_cldap_ping_dc_recv(TALLOC_CTX *mem_ctx,
 
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
+    *_dc = talloc_strdup(mem_ctx, state->dc->host);
+    if (*_dc == NULL) {
+        return ENOMEM;
+    }
+
     *_site = talloc_steal(mem_ctx, state->site);
     *_forest = talloc_steal(mem_ctx, state->forest);
 
     return EOK;
 }
 
+/* Pings are started one after another with this delay between them, the
+ * next ping is started right away if all running pings have failed. The
+ * first domain controller that replies is used and the remaining pings are
+ * cancelled. Domain controllers that replied first in the past are pinged
+ * first, so the delay is usually not hit at all. */
+#define AD_CLDAP_PING_DELAY_MSEC 50
+
 struct ad_cldap_ping_parallel_state {
     struct tevent_context *ev;
     struct sdap_options *opts;
@@ -228,16 +249,16 @@ struct ad_cldap_ping_parallel_state {
     struct tevent_timer *te;
     int active_requests;
     size_t next_dc;
-    int batch;
 
+    const char *dc;
     const char *site;
     const char *forest;
 };
 
-static void ad_cldap_ping_parallel_batch(struct tevent_context *ev,
-                                         struct tevent_timer *te,
-                                         struct timeval tv,
-                                         void *data);
+static void ad_cldap_ping_parallel_next(struct tevent_context *ev,
+                                        struct tevent_timer *te,
+                                        struct timeval tv,
+                                        void *data);
 static void ad_cldap_ping_parallel_done(struct tevent_req *subreq);
 
 static struct tevent_req *
@@ -270,6 +291,11 @@ ad_cldap_ping_parallel_send(TALLOC_CTX *mem_ctx,
     state->dc_list = dc_list;
     state->dc_count = dc_count;
 
+    if (dc_count == 0) {
+        ret = ENOENT;
+        goto done;
+    }
+
     state->reqs_ctx = talloc_new(state);
     if (state->reqs_ctx == NULL) {
         ret = ENOMEM;
@@ -277,8 +303,7 @@ ad_cldap_ping_parallel_send(TALLOC_CTX *mem_ctx,
     }
 
     state->next_dc = 0;
-    state->batch = 1;
-    ad_cldap_ping_parallel_batch(ev, NULL, tv, req);
+    ad_cldap_ping_parallel_next(ev, NULL, tv, req);
 
     return req;
 
@@ -289,69 +314,47 @@ done:
     return req;
 }
 
-static void ad_cldap_ping_parallel_batch(struct tevent_context *ev,
-                                         struct tevent_timer *te,
-                                         struct timeval tv,
-                                         void *data)
+static void ad_cldap_ping_parallel_next(struct tevent_context *ev,
+                                        struct tevent_timer *te,
+                                        struct timeval tv,
+                                        void *data)
 {
     struct ad_cldap_ping_parallel_state *state;
     struct tevent_req *req;
     struct tevent_req *subreq;
-    uint32_t delay;
-    size_t limit;
-    size_t i;
+    struct fo_server_info *dc;
 
     req = talloc_get_type(data, struct tevent_req);
     state = tevent_req_data(req, struct ad_cldap_ping_parallel_state);
 
     state->te = NULL;
 
-    /* Issue three batches in total to avoid pinging too many domain controllers
-     * if not necessary. The first batch (5 pings) is issued immediately and we
-     * will wait 400ms for it to finish. If we don't get a reply in time we
-     * issue next batch (5 pings) and wait 200ms. If we still have no reply,
-     * we contact remaining domain controllers.
-     *
-     * This follows algorithm described at section 5.4.5.3 of MS-DISO:
-     * https://winprotocoldoc.blob.core.windows.net/productionwindowsarchives/WinArchive/%5bMS-DISO%5d.pdf
-     */
-    switch (state->batch) {
-        case 1:
-        case 2:
-            limit = MIN(state->dc_count, 5 + state->next_dc);
-            delay = 400000 / state->batch;
-            break;
-        default:
-            limit = state->dc_count;
-            delay = 0;
-    }
-
-    for (i = state->next_dc; i < limit; i++) {
-        DEBUG(SSSDBG_TRACE_ALL, "Batch %d: %s:%d\n", state->batch,
-              state->dc_list[i].host, state->dc_list[i].port);
-    }
-
-    for (; state->next_dc < limit; state->next_dc++) {
-        subreq = ad_cldap_ping_dc_send(state->reqs_ctx, ev, state->opts,
-                                       state->be_res, state->host_db,
-                                       &state->dc_list[state->next_dc],
-                                       state->ad_domain);
-        if (subreq == NULL) {
-            DEBUG(SSSDBG_OP_FAILURE, "Unable to create new ping request\n");
-            goto fail;
-        }
+    if (state->next_dc >= state->dc_count) {
+        return;
+    }
 
-        state->active_requests++;
-        tevent_req_set_callback(subreq, ad_cldap_ping_parallel_done, req);
+    dc = &state->dc_list[state->next_dc];
+    DEBUG(SSSDBG_TRACE_ALL, "Ping %zu: %s:%d\n", state->next_dc + 1,
+          dc->host, dc->port);
+
+    subreq = ad_cldap_ping_dc_send(state->reqs_ctx, ev, state->opts,
+                                   state->be_res, state->host_db,
+                                   dc, state->ad_domain);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to create new ping request\n");
+        goto fail;
     }
 
-    state->batch++;
-    if (delay > 0) {
-        tv = tevent_timeval_current_ofs(0, delay);
+    state->next_dc++;
+    state->active_requests++;
+    tevent_req_set_callback(subreq, ad_cldap_ping_parallel_done, req);
+
+    if (state->next_dc < state->dc_count) {
+        tv = tevent_timeval_current_ofs(0, AD_CLDAP_PING_DELAY_MSEC * 1000);
         state->te = tevent_add_timer(ev, state->reqs_ctx, tv,
-                                     ad_cldap_ping_parallel_batch, req);
+                                     ad_cldap_ping_parallel_next, req);
         if (state->te == NULL) {
-            DEBUG(SSSDBG_OP_FAILURE, "Unable to schedule next batch!\n");
+            DEBUG(SSSDBG_OP_FAILURE, "Unable to schedule next ping!\n");
             goto fail;
         }
     }
@@ -361,7 +364,7 @@ static void ad_cldap_ping_parallel_batch(struct tevent_context *ev,
 fail:
     if (state->active_requests == 0) {
         tevent_req_error(req, ENOMEM);
-        if (state->batch == 1) {
+        if (state->next_dc == 0) {
             tevent_req_post(req, ev);
         }
     }
@@ -377,7 +380,8 @@ static void ad_cldap_ping_parallel_done(struct tevent_req *subreq)
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_cldap_ping_parallel_state);
 
-    ret = ad_cldap_ping_dc_recv(state, subreq, &state->site, &state->forest);
+    ret = ad_cldap_ping_dc_recv(state, subreq, &state->dc, &state->site,
+                                &state->forest);
     talloc_zfree(subreq);
     state->active_requests--;
 
@@ -389,7 +393,7 @@ static void ad_cldap_ping_parallel_done(struct tevent_req *subreq)
         /* There are still servers to try, don't wait for the timer. */
         if (state->next_dc < state->dc_count) {
             talloc_zfree(state->te);
-            ad_cldap_ping_parallel_batch(state->ev, NULL, tv, req);
+            ad_cldap_ping_parallel_next(state->ev, NULL, tv, req);
             return;
         }
         /* There is no available server. */
@@ -401,6 +405,7 @@ static void ad_cldap_ping_parallel_done(struct tevent_req *subreq)
 
 static errno_t ad_cldap_ping_parallel_recv(TALLOC_CTX *mem_ctx,
                                            struct tevent_req *req,
+                                           const char **_dc,
                                            const char **_site,
                                            const char **_forest)
 {
@@ -409,6 +414,7 @@ static errno_t ad_cldap_ping_parallel_recv(TALLOC_CTX *mem_ctx,
 
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
+    *_dc = talloc_steal(mem_ctx, state->dc);
     *_site = talloc_steal(mem_ctx, state->site);
     *_forest = talloc_steal(mem_ctx, state->forest);
 
@@ -417,6 +423,7 @@ static errno_t ad_cldap_ping_parallel_recv(TALLOC_CTX *mem_ctx,
 
 struct ad_cldap_ping_domain_state {
     struct tevent_context *ev;
+    struct ad_srv_plugin_ctx *srv_ctx;
     struct sdap_options *opts;
     struct be_resolv_ctx *be_res;
     enum host_database *host_db;
@@ -424,6 +431,7 @@ struct ad_cldap_ping_domain_state {
 
     struct fo_server_info *dc_list;
     size_t dc_count;
+    const char *dc;
     const char *site;
     const char *forest;
 };
@@ -434,10 +442,7 @@ static void ad_cldap_ping_domain_done(struct tevent_req *subreq);
 static struct tevent_req *
 ad_cldap_ping_domain_send(TALLOC_CTX *mem_ctx,
                           struct tevent_context *ev,
-                          struct sdap_options *opts,
-                          struct be_resolv_ctx *be_res,
-                          enum host_database *host_db,
-                          const char *ad_domain,
+                          struct ad_srv_plugin_ctx *srv_ctx,
                           const char *discovery_domain)
 {
     struct ad_cldap_ping_domain_state *state;
@@ -453,10 +458,11 @@ ad_cldap_ping_domain_send(TALLOC_CTX *mem_ctx,
     }
 
     state->ev = ev;
-    state->opts = opts;
-    state->be_res = be_res;
-    state->host_db = host_db;
-    state->ad_domain = ad_domain;
+    state->srv_ctx = srv_ctx;
+    state->opts = srv_ctx->opts;
+    state->be_res = srv_ctx->be_res;
+    state->host_db = srv_ctx->host_dbs;
+    state->ad_domain = srv_ctx->ad_domain;
 
     domains = talloc_zero_array(state, const char *, 2);
     if (domains == NULL) {
@@ -475,7 +481,7 @@ ad_cldap_ping_domain_send(TALLOC_CTX *mem_ctx,
     /* Even though we use CLDAP (UDP) to perform the ping we need to discover
      * domain controllers in TCP namespace as they are not automatically
      * available under UDP. */
-    subreq = fo_discover_srv_send(state, ev, be_res->resolv, "ldap",
+    subreq = fo_discover_srv_send(state, ev, state->be_res->resolv, "ldap",
                                   FO_PROTO_TCP, domains);
     if (subreq == NULL) {
         ret = ENOMEM;
@@ -513,6 +519,15 @@ static void ad_cldap_ping_domain_discovery_done(struct tevent_req *subreq)
     DEBUG(SSSDBG_TRACE_FUNC, "Found %zu domain controllers in domain %s\n",
           state->dc_count, domain);
 
+    /* Ping the domain controllers that replied first in the past first. */
+    ret = ad_sort_servers_by_ranking(state->dc_list, state->dc_count,
+                                     state->srv_ctx->dc_ranking, false);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to sort domain controllers by "
+              "ranking [%d]: %s\n", ret, sss_strerror(ret));
+        /* continue */
+    }
+
     subreq = ad_cldap_ping_parallel_send(state, state->ev, state->opts,
                                          state->be_res, state->host_db,
                                          state->dc_list, state->dc_count,
@@ -540,8 +555,8 @@ static void ad_cldap_ping_domain_done(struct tevent_req *subreq)
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_cldap_ping_domain_state);
 
-    ret = ad_cldap_ping_parallel_recv(state, subreq, &state->site,
-                                      &state->forest);
+    ret = ad_cldap_ping_parallel_recv(state, subreq, &state->dc,
+                                      &state->site, &state->forest);
     talloc_zfree(subreq);
     if (ret != EOK) {
         tevent_req_error(req, ret);
@@ -553,6 +568,7 @@ static void ad_cldap_ping_domain_done(struct tevent_req *subreq)
 
 static errno_t ad_cldap_ping_domain_recv(TALLOC_CTX *mem_ctx,
                                          struct tevent_req *req,
+                                         const char **_dc,
                                          const char **_site,
                                          const char **_forest)
 {
@@ -561,6 +577,7 @@ static errno_t ad_cldap_ping_domain_recv(TALLOC_CTX *mem_ctx,
 
     TEVENT_REQ_RETURN_ON_ERROR(req);
 
+    *_dc = talloc_steal(mem_ctx, state->dc);
     *_site = talloc_steal(mem_ctx, state->site);
     *_forest = talloc_steal(mem_ctx, state->forest);
 
@@ -569,13 +586,12 @@ static errno_t ad_cldap_ping_domain_recv(TALLOC_CTX *mem_ctx,
 
 struct ad_cldap_ping_state {
     struct tevent_context *ev;
-    struct sdap_options *opts;
+    struct ad_srv_plugin_ctx *srv_ctx;
     struct be_resolv_ctx *be_res;
-    enum host_database *host_db;
-    const char *ad_domain;
     const char *discovery_domain;
     bool all_tried;
 
+    const char *dc;
     const char *site;
     const char *forest;
 };
@@ -622,11 +638,14 @@ struct tevent_req *ad_cldap_ping_send(TALLOC_CTX *mem_ctx,
     DEBUG(SSSDBG_TRACE_FUNC, "Sending CLDAP ping\n");
 
     state->ev = ev;
-    state->opts = srv_ctx->opts;
+    state->srv_ctx = srv_ctx;
     state->be_res = srv_ctx->be_res;
-    state->host_db = srv_ctx->host_dbs;
-    state->ad_domain = srv_ctx->ad_domain;
-    state->discovery_domain = discovery_domain;
+
+    state->discovery_domain = talloc_strdup(state, discovery_domain);
+    if (state->discovery_domain == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
 
     /* If possible, lookup the information in the current site first. */
     if (srv_ctx->current_site != NULL) {
@@ -671,9 +690,8 @@ static errno_t ad_cldap_ping_step(struct tevent_req *req,
 
     state = tevent_req_data(req, struct ad_cldap_ping_state);
 
-    subreq = ad_cldap_ping_domain_send(state, state->ev, state->opts,
-                                       state->be_res, state->host_db,
-                                       state->ad_domain, domain);
+    subreq = ad_cldap_ping_domain_send(state, state->ev, state->srv_ctx,
+                                       domain);
     if (subreq == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Out of memory!");
         return ENOMEM;
@@ -700,12 +718,20 @@ static void ad_cldap_ping_done(struct tevent_req *subreq)
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_cldap_ping_state);
 
-    ret = ad_cldap_ping_domain_recv(state, subreq, &state->site,
+    ret = ad_cldap_ping_domain_recv(state, subreq, &state->dc, &state->site,
                                     &state->forest);
     talloc_zfree(subreq);
     if (ret == EOK) {
         DEBUG(SSSDBG_TRACE_FUNC, "Found site: %s\n", state->site);
         DEBUG(SSSDBG_TRACE_FUNC, "Found forest: %s\n", state->forest);
+
+        ret = ad_srv_plugin_ctx_rank_dc(state->srv_ctx, state->dc);
+        if (ret != EOK) {
+            /* Not fatal. */
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to update domain controller "
+                  "ranking [%d]: %s\n", ret, sss_strerror(ret));
+        }
+
         tevent_req_done(req);
         return;
     }
@@ -71,6 +71,8 @@ enum ad_basic_opt {
     AD_UPDATE_SAMBA_MACHINE_ACCOUNT_PASSWORD,
     AD_USE_LDAPS,
     AD_ALLOW_REMOTE_DOMAIN_LOCAL,
+    AD_PAC_LAZY_GROUPS,
+    AD_TOKENGROUPS_GC_LOOKUP,
 
     AD_OPTS_BASIC /* opts counter */
 };
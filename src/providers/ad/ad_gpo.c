@@ -101,6 +101,10 @@
 
 #define GPO_CHILD_LOG_FILE "gpo_child"
 
+/* Maximum number of gpo_child processes downloading policy files for
+ * one access request */
+#define AD_GPO_CHILD_MAX_PARALLEL 4
+
 /* If INI_PARSE_IGNORE_NON_KVP is not defined, use 0 (no effect) */
 #ifndef INI_PARSE_IGNORE_NON_KVP
 #define INI_PARSE_IGNORE_NON_KVP 0
@@ -172,14 +176,11 @@ int ad_gpo_process_gpo_recv(struct tevent_req *req,
 
 struct tevent_req *ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
                                            struct tevent_context *ev,
-                                           bool send_to_child,
                                            struct sss_domain_info *domain,
-                                           const char *gpo_guid,
-                                           const char *smb_server,
-                                           const char *smb_share,
-                                           const char *smb_path,
+                                           struct gp_gpo **gpos,
+                                           int *cached_gpt_versions,
+                                           int num_gpos,
                                            const char *smb_cse_suffix,
-                                           int cached_gpt_version,
                                            int gpo_timeout_option);
 
 int ad_gpo_process_cse_recv(struct tevent_req *req);
@@ -1107,8 +1108,8 @@ ad_gpo_filter_gpos_by_dacl(TALLOC_CTX *mem_ctx,
         if (access_allowed) {
             DEBUG(SSSDBG_TRACE_FUNC,
                   "GPO applicable to target per security filtering\n");
-            dacl_filtered_gpos[gpo_dn_idx] = talloc_steal(dacl_filtered_gpos,
-                                                          candidate_gpo);
+            /* The GPO is owned by the list of candidates */
+            dacl_filtered_gpos[gpo_dn_idx] = candidate_gpo;
             gpo_dn_idx++;
         } else {
             DEBUG(SSSDBG_TRACE_FUNC,
@@ -1201,8 +1202,7 @@ ad_gpo_filter_gpos_by_cse_guid(TALLOC_CTX *mem_ctx,
         if (included) {
             DEBUG(SSSDBG_TRACE_ALL,
                   "GPO applicable to target per cse_guid filtering\n");
-            cse_filtered_gpos[gpo_dn_idx] = talloc_steal(cse_filtered_gpos,
-                                                         dacl_filtered_gpo);
+            cse_filtered_gpos[gpo_dn_idx] = dacl_filtered_gpo;
             dacl_filtered_gpos[i] = NULL;
             gpo_dn_idx++;
         } else {
@@ -1618,6 +1618,42 @@ ad_gpo_access_check(TALLOC_CTX *mem_ctx,
     return ret;
 }
 
+/*
+ * This function parses a raw policy setting value into a list of sids.
+ * A NULL value results in an empty list.
+ */
+static errno_t
+ad_gpo_split_sids(TALLOC_CTX *mem_ctx,
+                  const char *value,
+                  char ***_sids_list,
+                  int *_sids_list_size)
+{
+    int ret;
+    int i;
+    int sids_list_size = 0;
+    char **sids_list = NULL;
+
+    if (value != NULL) {
+        ret = split_on_separator(mem_ctx, value, ',', true, true,
+                                 &sids_list, &sids_list_size);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Cannot parse list of sids %s: %d\n", value, ret);
+            return EINVAL;
+        }
+
+        for (i = 0; i < sids_list_size; i++) {
+            /* remove the asterisk prefix found on sids */
+            sids_list[i]++;
+        }
+    }
+
+    *_sids_list = sids_list;
+    *_sids_list_size = sids_list_size;
+
+    return EOK;
+}
+
 /*
  * This function retrieves the raw policy_setting_value for the input key from
  * the GPO_Result object in the sysdb cache. It then parses the raw value and
@@ -1632,7 +1668,6 @@ parse_policy_setting_value(TALLOC_CTX *mem_ctx,
                            int *_sids_list_size)
 {
     int ret;
-    int i;
     const char *value;
     int sids_list_size;
     char **sids_list = NULL;
@@ -1651,21 +1686,11 @@ parse_policy_setting_value(TALLOC_CTX *mem_ctx,
     if (value == NULL) {
         DEBUG(SSSDBG_TRACE_FUNC,
               "No value for key [%s] found in gpo result\n", key);
-        sids_list_size = 0;
-    } else {
-        ret = split_on_separator(mem_ctx, value, ',', true, true,
-                                 &sids_list, &sids_list_size);
-        if (ret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE,
-                  "Cannot parse list of sids %s: %d\n", value, ret);
-            ret = EINVAL;
-            goto done;
-        }
+    }
 
-        for (i = 0; i < sids_list_size; i++) {
-            /* remove the asterisk prefix found on sids */
-            sids_list[i]++;
-        }
+    ret = ad_gpo_split_sids(mem_ctx, value, &sids_list, &sids_list_size);
+    if (ret != EOK) {
+        goto done;
     }
 
     *_sids_list = talloc_steal(mem_ctx, sids_list);
@@ -1748,6 +1773,328 @@ ad_gpo_perform_hbac_processing(TALLOC_CTX *mem_ctx,
     return ret;
 }
 
+/* == GPO cache ============================================================= */
+
+/*
+ * The GPOs linked to the host only change on the server, so the list
+ * retrieved from LDAP is shared by all requests until ad_gpo_cache_timeout
+ * expires. Security filtering depends on the user and is still done for
+ * each request.
+ *
+ * The resultant policy of a set of applicable GPOs only changes with the
+ * versions of the GPOs, so it is kept in memory keyed by their GUIDs and
+ * versions and the policy files are only parsed again after a change.
+ */
+#define AD_GPO_MAX_CACHED_POLICIES 8
+
+struct ad_gpo_candidates {
+    time_t expire;
+    const char *host_sid;
+    struct gp_gpo **gpos;
+    int num_gpos;
+
+    /* Requests using the list, it is freed after the last one finishes
+     * once it has been replaced */
+    int num_users;
+    bool retired;
+};
+
+struct ad_gpo_policy {
+    struct ad_gpo_policy *prev;
+    struct ad_gpo_policy *next;
+
+    const char *key;
+    /* Raw policy setting values indexed by gpo_map_type */
+    const char *allow_values[GPO_MAP_NUM_OPTS];
+    const char *deny_values[GPO_MAP_NUM_OPTS];
+};
+
+struct ad_gpo_cache {
+    struct ad_gpo_candidates *candidates;
+
+    struct ad_gpo_policy *policies;
+    int num_policies;
+
+    /* Key of the policy stored in the GPO Result object */
+    char *result_key;
+};
+
+static void ad_gpo_candidates_release(struct ad_gpo_candidates *candidates)
+{
+    if (candidates == NULL) {
+        return;
+    }
+
+    candidates->num_users--;
+    if (candidates->retired && candidates->num_users <= 0) {
+        talloc_free(candidates);
+    }
+}
+
+static errno_t
+ad_gpo_cache_set_candidates(struct ad_gpo_cache *cache,
+                            const char *host_sid,
+                            struct gp_gpo **gpos,
+                            int num_gpos,
+                            int timeout,
+                            struct ad_gpo_candidates **_candidates)
+{
+    struct ad_gpo_candidates *candidates;
+    struct ad_gpo_candidates *old;
+
+    candidates = talloc_zero(cache, struct ad_gpo_candidates);
+    if (candidates == NULL) {
+        return ENOMEM;
+    }
+
+    if (host_sid != NULL) {
+        candidates->host_sid = talloc_strdup(candidates, host_sid);
+        if (candidates->host_sid == NULL) {
+            talloc_free(candidates);
+            return ENOMEM;
+        }
+    }
+
+    candidates->gpos = talloc_steal(candidates, gpos);
+    candidates->num_gpos = num_gpos;
+    candidates->expire = time(NULL) + timeout;
+
+    old = cache->candidates;
+    if (old != NULL) {
+        if (old->num_users > 0) {
+            old->retired = true;
+        } else {
+            talloc_free(old);
+        }
+    }
+
+    cache->candidates = candidates;
+    *_candidates = candidates;
+    return EOK;
+}
+
+static struct ad_gpo_candidates *
+ad_gpo_cache_get_candidates(struct ad_gpo_cache *cache)
+{
+    if (cache->candidates == NULL
+            || cache->candidates->expire <= time(NULL)) {
+        return NULL;
+    }
+
+    return cache->candidates;
+}
+
+static struct ad_gpo_policy *
+ad_gpo_cache_find_policy(struct ad_gpo_cache *cache, const char *key)
+{
+    struct ad_gpo_policy *policy;
+
+    DLIST_FOR_EACH(policy, cache->policies) {
+        if (strcmp(policy->key, key) == 0) {
+            DLIST_PROMOTE(cache->policies, policy);
+            return policy;
+        }
+    }
+
+    return NULL;
+}
+
+static void ad_gpo_cache_add_policy(struct ad_gpo_cache *cache,
+                                    struct ad_gpo_policy *policy)
+{
+    struct ad_gpo_policy *old;
+    struct ad_gpo_policy *last = NULL;
+
+    old = ad_gpo_cache_find_policy(cache, policy->key);
+    if (old != NULL) {
+        DLIST_REMOVE(cache->policies, old);
+        cache->num_policies--;
+        talloc_free(old);
+    }
+
+    talloc_steal(cache, policy);
+    DLIST_ADD(cache->policies, policy);
+    cache->num_policies++;
+
+    if (cache->num_policies > AD_GPO_MAX_CACHED_POLICIES) {
+        DLIST_FOR_EACH(old, cache->policies) {
+            last = old;
+        }
+        DLIST_REMOVE(cache->policies, last);
+        cache->num_policies--;
+        talloc_free(last);
+    }
+}
+
+/*
+ * Builds the key of the policy of the applicable GPOs from their GUIDs and
+ * the versions of their cached policy files. Returns ENOENT if a policy file
+ * is not cached or its cache timeout expired.
+ */
+static errno_t
+ad_gpo_policy_key(TALLOC_CTX *mem_ctx,
+                  struct sss_domain_info *domain,
+                  struct gp_gpo **gpos,
+                  int num_gpos,
+                  char **_key)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_result *res;
+    char *key;
+    int version;
+    time_t timeout;
+    time_t now;
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    key = talloc_strdup(tmp_ctx, "");
+    if (key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    now = time(NULL);
+    for (i = 0; i < num_gpos; i++) {
+        ret = sysdb_gpo_get_gpo_by_guid(tmp_ctx, domain, gpos[i]->gpo_guid,
+                                        &res);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        version = ldb_msg_find_attr_as_int(res->msgs[0],
+                                           SYSDB_GPO_VERSION_ATTR, -1);
+        timeout = ldb_msg_find_attr_as_uint64(res->msgs[0],
+                                              SYSDB_GPO_TIMEOUT_ATTR, 0);
+        if (version < 0 || timeout < now) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Policy file of GPO [%s] must be "
+                  "checked for updates\n", gpos[i]->gpo_guid);
+            ret = ENOENT;
+            goto done;
+        }
+
+        key = talloc_asprintf_append(key, "%s:%d;",
+                                     gpos[i]->gpo_guid, version);
+        if (key == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    *_key = talloc_steal(mem_ctx, key);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Reads the resultant policy settings from the GPO Result object */
+static errno_t
+ad_gpo_policy_from_result(TALLOC_CTX *mem_ctx,
+                          struct sss_domain_info *domain,
+                          const char *key,
+                          struct ad_gpo_policy **_policy)
+{
+    struct ad_gpo_policy *policy;
+    const char *value;
+    errno_t ret;
+    int i;
+
+    policy = talloc_zero(mem_ctx, struct ad_gpo_policy);
+    if (policy == NULL) {
+        return ENOMEM;
+    }
+
+    policy->key = talloc_strdup(policy, key);
+    if (policy->key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < GPO_MAP_NUM_OPTS; i++) {
+        if (gpo_map_option_entries[i].allow_key == NULL) {
+            continue;
+        }
+
+        ret = sysdb_gpo_get_gpo_result_setting(policy, domain,
+                                    gpo_map_option_entries[i].allow_key,
+                                    &value);
+        if (ret != EOK && ret != ENOENT) {
+            goto done;
+        }
+        policy->allow_values[i] = ret == EOK ? value : NULL;
+
+        ret = sysdb_gpo_get_gpo_result_setting(policy, domain,
+                                    gpo_map_option_entries[i].deny_key,
+                                    &value);
+        if (ret != EOK && ret != ENOENT) {
+            goto done;
+        }
+        policy->deny_values[i] = ret == EOK ? value : NULL;
+    }
+
+    *_policy = policy;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(policy);
+    }
+    return ret;
+}
+
+/* Replaces the GPO Result object with the cached policy settings so that
+ * offline evaluation uses the same policy */
+static errno_t
+ad_gpo_policy_to_result(struct sss_domain_info *domain,
+                        struct ad_gpo_policy *policy)
+{
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    int i;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_gpo_delete_gpo_result_object(tmp_ctx, domain);
+    if (ret != EOK && ret != ENOENT) {
+        goto done;
+    }
+
+    for (i = 0; i < GPO_MAP_NUM_OPTS; i++) {
+        if (policy->allow_values[i] != NULL) {
+            ret = sysdb_gpo_store_gpo_result_setting(domain,
+                                        gpo_map_option_entries[i].allow_key,
+                                        policy->allow_values[i]);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+
+        if (policy->deny_values[i] != NULL) {
+            ret = sysdb_gpo_store_gpo_result_setting(domain,
+                                        gpo_map_option_entries[i].deny_key,
+                                        policy->deny_values[i]);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 /* == ad_gpo_access_send/recv implementation ================================*/
 
 struct ad_gpo_access_state {
@@ -1773,8 +2120,10 @@ struct ad_gpo_access_state {
     int num_dacl_filtered_gpos;
     struct gp_gpo **cse_filtered_gpos;
     int num_cse_filtered_gpos;
-    int cse_gpo_index;
+    int num_cse_in_flight;
+    errno_t cse_error;
     const char *ad_domain;
+    struct ad_gpo_candidates *candidates;
 };
 
 static void ad_gpo_connect_done(struct tevent_req *subreq);
@@ -1782,9 +2131,150 @@ static void ad_gpo_target_dn_retrieval_done(struct tevent_req *subreq);
 static void ad_gpo_process_som_done(struct tevent_req *subreq);
 static void ad_gpo_process_gpo_done(struct tevent_req *subreq);
 
-static errno_t ad_gpo_cse_step(struct tevent_req *req);
-static void ad_gpo_cse_done(struct tevent_req *subreq);
-static void ad_gpo_get_host_sid_retrieval_done(struct tevent_req *subreq);
+static errno_t ad_gpo_process_candidates(struct tevent_req *req,
+                                         struct ad_gpo_candidates *candidates);
+static errno_t ad_gpo_cse_step(struct tevent_req *req);
+static void ad_gpo_cse_done(struct tevent_req *subreq);
+static errno_t ad_gpo_cse_finish(struct ad_gpo_access_state *state);
+static void ad_gpo_get_host_sid_retrieval_done(struct tevent_req *subreq);
+
+static int ad_gpo_access_state_destructor(struct ad_gpo_access_state *state)
+{
+    ad_gpo_candidates_release(state->candidates);
+    return 0;
+}
+
+static errno_t
+ad_gpo_delete_result_object(struct ad_gpo_access_state *state)
+{
+    errno_t ret;
+
+    talloc_zfree(state->access_ctx->gpo_cache->result_key);
+
+    ret = sysdb_gpo_delete_gpo_result_object(state, state->host_domain);
+    if (ret != EOK) {
+        switch (ret) {
+        case ENOENT:
+            DEBUG(SSSDBG_TRACE_FUNC, "No GPO Result available in cache\n");
+            break;
+        default:
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  "Could not delete GPO Result from cache: [%s]\n",
+                  sss_strerror(ret));
+            return ret;
+        }
+    }
+
+    return EOK;
+}
+
+static errno_t
+ad_gpo_find_cached_policy(struct ad_gpo_access_state *state,
+                          struct ad_gpo_policy **_policy)
+{
+    struct ad_gpo_policy *policy;
+    char *key;
+    errno_t ret;
+
+    ret = ad_gpo_policy_key(state, state->host_domain,
+                            state->cse_filtered_gpos,
+                            state->num_cse_filtered_gpos, &key);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    policy = ad_gpo_cache_find_policy(state->access_ctx->gpo_cache, key);
+    talloc_free(key);
+    if (policy == NULL) {
+        return ENOENT;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Using cached policy of GPOs [%s]\n",
+          policy->key);
+
+    *_policy = policy;
+    return EOK;
+}
+
+/* Stores the policy just written to the GPO Result object in the cache */
+static void
+ad_gpo_cache_store_policy(struct ad_gpo_access_state *state)
+{
+    struct ad_gpo_cache *cache = state->access_ctx->gpo_cache;
+    struct ad_gpo_policy *policy;
+    char *key;
+    errno_t ret;
+
+    ret = ad_gpo_policy_key(state, state->host_domain,
+                            state->cse_filtered_gpos,
+                            state->num_cse_filtered_gpos, &key);
+    if (ret == EOK) {
+        ret = ad_gpo_policy_from_result(state, state->host_domain, key,
+                                        &policy);
+    }
+
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Policy will not be cached [%d]: %s\n",
+              ret, sss_strerror(ret));
+        return;
+    }
+
+    ad_gpo_cache_add_policy(cache, policy);
+
+    talloc_free(cache->result_key);
+    cache->result_key = talloc_strdup(cache, policy->key);
+}
+
+static errno_t
+ad_gpo_evaluate_cached_policy(struct ad_gpo_access_state *state,
+                              struct ad_gpo_policy *policy)
+{
+    struct ad_gpo_cache *cache = state->access_ctx->gpo_cache;
+    char **allow_sids;
+    int allow_size;
+    char **deny_sids;
+    int deny_size;
+    errno_t ret;
+
+    if (cache->result_key == NULL
+            || strcmp(cache->result_key, policy->key) != 0) {
+        /* Keep the GPO Result object in sync for offline evaluation */
+        talloc_zfree(cache->result_key);
+        ret = ad_gpo_policy_to_result(state->host_domain, policy);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Unable to store GPO Result [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return ret;
+        }
+
+        cache->result_key = talloc_strdup(cache, policy->key);
+    }
+
+    ret = ad_gpo_split_sids(state, policy->allow_values[state->gpo_map_type],
+                            &allow_sids, &allow_size);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = ad_gpo_split_sids(state, policy->deny_values[state->gpo_map_type],
+                            &deny_sids, &deny_size);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = ad_gpo_access_check(state, state->gpo_mode, state->gpo_map_type,
+                              state->user, state->gpo_implicit_deny,
+                              state->user_domain,
+                              allow_sids, allow_size, deny_sids, deny_size);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "GPO access check failed: [%d](%s)\n",
+              ret, sss_strerror(ret));
+    }
+
+    return ret;
+}
 
 struct tevent_req *
 ad_gpo_access_send(TALLOC_CTX *mem_ctx,
@@ -1802,6 +2292,7 @@ ad_gpo_access_send(TALLOC_CTX *mem_ctx,
     hash_key_t key;
     hash_value_t val;
     enum gpo_map_type gpo_map_type;
+    struct ad_gpo_candidates *candidates;
 
     req = tevent_req_create(mem_ctx, &state, struct ad_gpo_access_state);
     if (req == NULL) {
@@ -1809,6 +2300,8 @@ ad_gpo_access_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
+    talloc_set_destructor(state, ad_gpo_access_state_destructor);
+
     /* determine service's option_type (e.g. interactive, network, etc) */
     key.type = HASH_KEY_STRING;
     key.str = talloc_strdup(state, service);
@@ -1877,7 +2370,8 @@ ad_gpo_access_send(TALLOC_CTX *mem_ctx,
     state->num_dacl_filtered_gpos = 0;
     state->cse_filtered_gpos = NULL;
     state->num_cse_filtered_gpos = 0;
-    state->cse_gpo_index = 0;
+    state->num_cse_in_flight = 0;
+    state->cse_error = EOK;
     state->ev = ev;
     state->user = user;
     state->ldb_ctx = sysdb_ctx_get_ldb(state->host_domain->sysdb);
@@ -1890,6 +2384,28 @@ ad_gpo_access_send(TALLOC_CTX *mem_ctx,
     state->opts = ctx->sdap_access_ctx->id_ctx->opts;
     state->timeout = dp_opt_get_int(state->opts->basic, SDAP_SEARCH_TIMEOUT);
     state->conn = ad_get_dom_ldap_conn(ctx->ad_id_ctx, state->host_domain);
+
+    if (ctx->gpo_cache == NULL) {
+        ctx->gpo_cache = talloc_zero(ctx, struct ad_gpo_cache);
+        if (ctx->gpo_cache == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+    }
+
+    candidates = ad_gpo_cache_get_candidates(ctx->gpo_cache);
+    if (candidates != NULL) {
+        /* The GPOs were retrieved less than ad_gpo_cache_timeout ago */
+        DEBUG(SSSDBG_TRACE_FUNC, "Using cached list of GPOs\n");
+        state->host_sid = candidates->host_sid;
+
+        ret = ad_gpo_process_candidates(req, candidates);
+        if (ret == EAGAIN) {
+            return req;
+        }
+        goto immediately;
+    }
+
     state->sdap_op = sdap_id_op_create(state, state->conn->conn_cache);
     if (state->sdap_op == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "sdap_id_op_create failed.\n");
@@ -2415,9 +2931,10 @@ ad_gpo_process_som_done(struct tevent_req *subreq)
  * reduces it to a list of cse_filtered_gpos, based on whether each GPO's list
  * of cse_guids includes the "SecuritySettings" CSE GUID (used for HBAC).
  *
- * Ultimately, this function then sends each cse_filtered_gpo to the gpo_child,
- * which retrieves the GPT.INI and policy files (as needed). Once all files
- * have been downloaded, the ad_gpo_cse_done function performs HBAC processing.
+ * Ultimately, this function then sends the cse_filtered_gpos to a small number
+ * of gpo_child processes, which retrieve the GPT.INI and policy files (as
+ * needed). Once all files have been downloaded, the ad_gpo_cse_finish function
+ * performs HBAC processing.
  */
 static void
 ad_gpo_process_gpo_done(struct tevent_req *subreq)
@@ -2428,8 +2945,7 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
     int dp_error;
     struct gp_gpo **candidate_gpos = NULL;
     int num_candidate_gpos = 0;
-    int i = 0;
-    const char **cse_filtered_gpo_guids;
+    struct ad_gpo_candidates *candidates;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_gpo_access_state);
@@ -2446,34 +2962,66 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
               ret, sss_strerror(ret));
         goto done;
     } else if (ret == ENOENT) {
+        candidate_gpos = NULL;
+        num_candidate_gpos = 0;
+    }
+
+    ret = ad_gpo_cache_set_candidates(state->access_ctx->gpo_cache,
+                                      state->host_sid,
+                                      candidate_gpos, num_candidate_gpos,
+                                      state->gpo_timeout_option,
+                                      &candidates);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = ad_gpo_process_candidates(req, candidates);
+
+ done:
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+}
+
+/*
+ * Filters the candidate GPOs for the user and either evaluates the cached
+ * policy of the applicable GPOs or starts downloading their policy files.
+ * Returns EAGAIN if the request continues asynchronously.
+ */
+static errno_t
+ad_gpo_process_candidates(struct tevent_req *req,
+                          struct ad_gpo_candidates *candidates)
+{
+    struct ad_gpo_access_state *state;
+    struct ad_gpo_policy *policy;
+    int ret;
+    int i = 0;
+    const char **cse_filtered_gpo_guids;
+
+    state = tevent_req_data(req, struct ad_gpo_access_state);
+
+    /* Keep the candidates alive until the request is finished */
+    state->candidates = candidates;
+    candidates->num_users++;
+
+    if (candidates->num_gpos == 0) {
         DEBUG(SSSDBG_TRACE_FUNC,
               "No GPOs found that apply to this system.\n");
         /*
          * Delete the result object list, since there are no
          * GPOs to include in it.
          */
-        ret = sysdb_gpo_delete_gpo_result_object(state, state->host_domain);
-        if (ret != EOK) {
-            switch (ret) {
-            case ENOENT:
-                DEBUG(SSSDBG_TRACE_FUNC, "No GPO Result available in cache\n");
-                break;
-            default:
-                DEBUG(SSSDBG_FATAL_FAILURE,
-                      "Could not delete GPO Result from cache: [%s]\n",
-                      sss_strerror(ret));
-                goto done;
-            }
-        }
-
-        ret = EOK;
+        ret = ad_gpo_delete_result_object(state);
         goto done;
     }
 
     ret = ad_gpo_filter_gpos_by_dacl(state, state->user, state->host_sid,
                                      state->user_domain,
                                      state->opts->idmap_ctx->map,
-                                     candidate_gpos, num_candidate_gpos,
+                                     candidates->gpos, candidates->num_gpos,
                                      &state->dacl_filtered_gpos,
                                      &state->num_dacl_filtered_gpos);
     if (ret != EOK) {
@@ -2492,18 +3040,9 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
          * Delete the result object list, since there are no
          * GPOs to include in it.
          */
-        ret = sysdb_gpo_delete_gpo_result_object(state, state->host_domain);
+        ret = ad_gpo_delete_result_object(state);
         if (ret != EOK) {
-            switch (ret) {
-            case ENOENT:
-                DEBUG(SSSDBG_TRACE_FUNC, "No GPO Result available in cache\n");
-                break;
-            default:
-                DEBUG(SSSDBG_FATAL_FAILURE,
-                      "Could not delete GPO Result from cache: [%s]\n",
-                      sss_strerror(ret));
-                goto done;
-            }
+            goto done;
         }
 
         if (state->gpo_implicit_deny == true) {
@@ -2565,8 +3104,7 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
     for (i = 0; i < state->num_cse_filtered_gpos; i++) {
         DEBUG(SSSDBG_TRACE_FUNC, "cse_filtered_gpos[%d]->gpo_guid is %s\n", i,
                                   state->cse_filtered_gpos[i]->gpo_guid);
-        cse_filtered_gpo_guids[i] = talloc_steal(cse_filtered_gpo_guids,
-                                                 state->cse_filtered_gpos[i]->gpo_guid);
+        cse_filtered_gpo_guids[i] = state->cse_filtered_gpos[i]->gpo_guid;
         if (cse_filtered_gpo_guids[i] == NULL) {
             ret = ENOMEM;
             goto done;
@@ -2576,42 +3114,46 @@ ad_gpo_process_gpo_done(struct tevent_req *subreq)
     DEBUG(SSSDBG_TRACE_FUNC, "num_cse_filtered_gpos: %d\n",
           state->num_cse_filtered_gpos);
 
+    /* If the policy files of these GPOs were already processed and their
+     * versions did not change, there is no need to parse them again. */
+    ret = ad_gpo_find_cached_policy(state, &policy);
+    if (ret == EOK) {
+        ret = ad_gpo_evaluate_cached_policy(state, policy);
+        goto done;
+    } else if (ret != ENOENT) {
+        goto done;
+    }
+
     /*
      * before we start processing each gpo, we delete the GPO Result object
      * from the sysdb cache so that any previous policy settings are cleared;
      * subsequent functions will add the GPO Result object (and populate it
      * with resultant policy settings) for this policy application
      */
-    ret = sysdb_gpo_delete_gpo_result_object(state, state->host_domain);
+    ret = ad_gpo_delete_result_object(state);
     if (ret != EOK) {
-        switch (ret) {
-        case ENOENT:
-            DEBUG(SSSDBG_TRACE_FUNC, "No GPO Result available in cache\n");
-            break;
-        default:
-            DEBUG(SSSDBG_FATAL_FAILURE,
-                  "Could not delete GPO Result from cache: [%s]\n",
-                  sss_strerror(ret));
-            goto done;
-        }
+        goto done;
     }
 
     ret = ad_gpo_cse_step(req);
-
- done:
-
     if (ret == EOK) {
-        tevent_req_done(req);
-    } else if (ret != EAGAIN) {
-        tevent_req_error(req, ret);
+        /* all policy files are up to date in the GPO_CACHE */
+        ret = ad_gpo_cse_finish(state);
     }
+
+ done:
+    return ret;
 }
 
+/*
+ * This function determines whether the policy file of the GPO has to be
+ * (re)downloaded by the gpo_child and with which cached_gpt_version.
+ */
 static errno_t
-ad_gpo_cse_step(struct tevent_req *req)
+ad_gpo_cse_prepare(struct ad_gpo_access_state *state,
+                   struct gp_gpo *cse_filtered_gpo,
+                   int *_cached_gpt_version)
 {
-    struct tevent_req *subreq;
-    struct ad_gpo_access_state *state;
     int i = 0;
     struct ldb_result *res;
     errno_t ret;
@@ -2619,20 +3161,12 @@ ad_gpo_cse_step(struct tevent_req *req)
     int cached_gpt_version = 0;
     time_t policy_file_timeout = 0;
 
-    state = tevent_req_data(req, struct ad_gpo_access_state);
-
-    struct gp_gpo *cse_filtered_gpo =
-        state->cse_filtered_gpos[state->cse_gpo_index];
-
-    /* cse_filtered_gpo is NULL after all GPO policy files have been downloaded */
-    if (cse_filtered_gpo == NULL) return EOK;
-
-    DEBUG(SSSDBG_TRACE_FUNC, "cse filtered_gpos[%d]->gpo_guid is %s\n",
-          state->cse_gpo_index, cse_filtered_gpo->gpo_guid);
+    DEBUG(SSSDBG_TRACE_FUNC, "cse_filtered_gpo->gpo_guid is %s\n",
+          cse_filtered_gpo->gpo_guid);
     for (i = 0; i < cse_filtered_gpo->num_gpo_cse_guids; i++) {
         DEBUG(SSSDBG_TRACE_ALL,
-              "cse_filtered_gpos[%d]->gpo_cse_guids[%d]->gpo_guid is %s\n",
-              state->cse_gpo_index, i, cse_filtered_gpo->gpo_cse_guids[i]);
+              "cse_filtered_gpo->gpo_cse_guids[%d]->gpo_guid is %s\n",
+              i, cse_filtered_gpo->gpo_cse_guids[i]);
     }
 
     DEBUG(SSSDBG_TRACE_FUNC, "smb_server: %s\n", cse_filtered_gpo->smb_server);
@@ -2640,13 +3174,16 @@ ad_gpo_cse_step(struct tevent_req *req)
     DEBUG(SSSDBG_TRACE_FUNC, "smb_path: %s\n", cse_filtered_gpo->smb_path);
     DEBUG(SSSDBG_TRACE_FUNC, "gpo_guid: %s\n", cse_filtered_gpo->gpo_guid);
 
-    cse_filtered_gpo->policy_filename =
-        talloc_asprintf(state,
-                        GPO_CACHE_PATH"%s%s",
-                        cse_filtered_gpo->smb_path,
-                        GP_EXT_GUID_SECURITY_SUFFIX);
+    /* The GPO may be shared with other requests through the GPO cache */
     if (cse_filtered_gpo->policy_filename == NULL) {
-        return ENOMEM;
+        cse_filtered_gpo->policy_filename =
+            talloc_asprintf(cse_filtered_gpo,
+                            GPO_CACHE_PATH"%s%s",
+                            cse_filtered_gpo->smb_path,
+                            GP_EXT_GUID_SECURITY_SUFFIX);
+        if (cse_filtered_gpo->policy_filename == NULL) {
+            return ENOMEM;
+        }
     }
 
     /* retrieve gpo cache entry; set cached_gpt_version to -1 if unavailable */
@@ -2678,6 +3215,7 @@ ad_gpo_cse_step(struct tevent_req *req)
         if (policy_file_timeout >= time(NULL)) {
             send_to_child = false;
         }
+        talloc_free(res);
     } else if (ret == ENOENT) {
         DEBUG(SSSDBG_TRACE_FUNC, "ENOENT\n");
         cached_gpt_version = -1;
@@ -2691,97 +3229,218 @@ ad_gpo_cse_step(struct tevent_req *req)
     DEBUG(SSSDBG_TRACE_FUNC, "cached_gpt_version: %d\n", cached_gpt_version);
 
     cse_filtered_gpo->send_to_child = send_to_child;
+    *_cached_gpt_version = cached_gpt_version;
 
-    subreq = ad_gpo_process_cse_send(state,
-                                     state->ev,
-                                     send_to_child,
-                                     state->host_domain,
-                                     cse_filtered_gpo->gpo_guid,
-                                     cse_filtered_gpo->smb_server,
-                                     cse_filtered_gpo->smb_share,
-                                     cse_filtered_gpo->smb_path,
-                                     GP_EXT_GUID_SECURITY_SUFFIX,
-                                     cached_gpt_version,
-                                     state->gpo_timeout_option);
-
-    tevent_req_set_callback(subreq, ad_gpo_cse_done, req);
-    return EAGAIN;
+    return EOK;
 }
 
 /*
- * This cse-specific function (GP_EXT_GUID_SECURITY) increments the
- * cse_gpo_index until the policy settings for all applicable GPOs have been
- * stored as part of the GPO Result object in the sysdb cache. Once all
- * GPOs have been processed, this functions performs HBAC processing by
- * comparing the resultant policy setting values in the GPO Result object
- * with the user_sid/group_sids of interest.
+ * This function starts the download of the policy files of all GPOs whose
+ * cache timeout has expired. The GPOs are split round-robin between at most
+ * AD_GPO_CHILD_MAX_PARALLEL gpo_child processes, each of which downloads
+ * its whole batch over a single SMB connection. Returns EOK if there is
+ * nothing to download and EAGAIN if the downloads have been started. If a
+ * child cannot be started after others were, the error is left for
+ * ad_gpo_cse_done() to report once the running ones have finished.
  */
-static void
-ad_gpo_cse_done(struct tevent_req *subreq)
+static errno_t
+ad_gpo_cse_step(struct tevent_req *req)
 {
-    struct tevent_req *req;
+    struct tevent_req *subreq;
     struct ad_gpo_access_state *state;
-    int ret;
+    struct gp_gpo **downloads;
+    int *cached_gpt_versions;
+    struct gp_gpo **batch;
+    int *batch_versions;
+    int num_downloads = 0;
+    int num_children;
+    int num_batch;
+    int child;
+    int i;
+    errno_t ret;
 
-    req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_gpo_access_state);
 
-    struct gp_gpo *cse_filtered_gpo =
-        state->cse_filtered_gpos[state->cse_gpo_index];
+    downloads = talloc_array(state, struct gp_gpo *,
+                             state->num_cse_filtered_gpos);
+    cached_gpt_versions = talloc_array(state, int,
+                                       state->num_cse_filtered_gpos);
+    if (downloads == NULL || cached_gpt_versions == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
 
-    const char *gpo_guid = cse_filtered_gpo->gpo_guid;
+    for (i = 0; i < state->num_cse_filtered_gpos; i++) {
+        ret = ad_gpo_cse_prepare(state, state->cse_filtered_gpos[i],
+                                 &cached_gpt_versions[num_downloads]);
+        if (ret != EOK) {
+            goto done;
+        }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "gpo_guid: %s\n", gpo_guid);
+        if (state->cse_filtered_gpos[i]->send_to_child) {
+            downloads[num_downloads] = state->cse_filtered_gpos[i];
+            num_downloads++;
+        }
+    }
 
-    ret = ad_gpo_process_cse_recv(subreq);
+    if (num_downloads == 0) {
+        ret = EOK;
+        goto done;
+    }
 
-    talloc_zfree(subreq);
+    num_children = MIN(num_downloads, AD_GPO_CHILD_MAX_PARALLEL);
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Downloading %d policy files with %d gpo_child processes\n",
+          num_downloads, num_children);
 
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Unable to retrieve policy data: [%d](%s}\n",
-              ret, sss_strerror(ret));
-        goto done;
+    ret = EOK;
+    for (child = 0; child < num_children; child++) {
+        batch = talloc_array(state, struct gp_gpo *,
+                             num_downloads / num_children + 1);
+        batch_versions = talloc_array(batch, int,
+                                      num_downloads / num_children + 1);
+        if (batch == NULL || batch_versions == NULL) {
+            talloc_free(batch);
+            ret = ENOMEM;
+            break;
+        }
+
+        num_batch = 0;
+        for (i = child; i < num_downloads; i += num_children) {
+            batch[num_batch] = downloads[i];
+            batch_versions[num_batch] = cached_gpt_versions[i];
+            num_batch++;
+        }
+
+        subreq = ad_gpo_process_cse_send(state,
+                                         state->ev,
+                                         state->host_domain,
+                                         batch,
+                                         batch_versions,
+                                         num_batch,
+                                         GP_EXT_GUID_SECURITY_SUFFIX,
+                                         state->gpo_timeout_option);
+        talloc_free(batch);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            break;
+        }
+
+        tevent_req_set_callback(subreq, ad_gpo_cse_done, req);
+        state->num_cse_in_flight++;
     }
 
-    /*
-     * now that the policy file for this gpo have been downloaded to the
-     * GPO CACHE, we store all of the supported keys present in the file
-     * (as part of the GPO Result object in the sysdb cache).
-     */
-    ret = ad_gpo_store_policy_settings(state->host_domain,
-                                       cse_filtered_gpo->policy_filename);
     if (ret != EOK) {
+        if (state->num_cse_in_flight == 0) {
+            goto done;
+        }
+
+        /* The gpo_child processes already started still own the request,
+         * it fails when the last of them has finished. */
         DEBUG(SSSDBG_OP_FAILURE,
-              "ad_gpo_store_policy_settings failed: [%d](%s)\n",
-              ret, sss_strerror(ret));
-        goto done;
+              "Unable to start all gpo_child processes, waiting for the "
+              "%d running ones: [%d](%s)\n",
+              state->num_cse_in_flight, ret, sss_strerror(ret));
+        state->cse_error = ret;
     }
 
-    state->cse_gpo_index++;
-    ret = ad_gpo_cse_step(req);
+    ret = EAGAIN;
 
-    if (ret == EOK) {
-        /* ret is EOK only after all GPO policy files have been downloaded */
-        ret = ad_gpo_perform_hbac_processing(state,
-                                             state->gpo_mode,
-                                             state->gpo_map_type,
-                                             state->user,
-                                             state->gpo_implicit_deny,
-                                             state->user_domain,
-                                             state->host_domain);
+done:
+    talloc_free(downloads);
+    talloc_free(cached_gpt_versions);
+    return ret;
+}
+
+/*
+ * Once the policy files of all applicable GPOs are present in the GPO_CACHE,
+ * this cse-specific function (GP_EXT_GUID_SECURITY) stores their policy
+ * settings as part of the GPO Result object in the sysdb cache, in the order
+ * of the GPOs. It then performs HBAC processing by comparing the resultant
+ * policy setting values in the GPO Result object with the user_sid/group_sids
+ * of interest.
+ */
+static errno_t
+ad_gpo_cse_finish(struct ad_gpo_access_state *state)
+{
+    int i;
+    errno_t ret;
+
+    for (i = 0; i < state->num_cse_filtered_gpos; i++) {
+        DEBUG(SSSDBG_TRACE_FUNC, "gpo_guid: %s\n",
+              state->cse_filtered_gpos[i]->gpo_guid);
+
+        ret = ad_gpo_store_policy_settings(state->host_domain,
+                                state->cse_filtered_gpos[i]->policy_filename);
         if (ret != EOK) {
-            DEBUG(SSSDBG_OP_FAILURE, "HBAC processing failed: [%d](%s}\n",
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "ad_gpo_store_policy_settings failed: [%d](%s)\n",
                   ret, sss_strerror(ret));
-            goto done;
+            return ret;
+        }
+    }
+
+    ad_gpo_cache_store_policy(state);
+
+    ret = ad_gpo_perform_hbac_processing(state,
+                                         state->gpo_mode,
+                                         state->gpo_map_type,
+                                         state->user,
+                                         state->gpo_implicit_deny,
+                                         state->user_domain,
+                                         state->host_domain);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "HBAC processing failed: [%d](%s}\n",
+              ret, sss_strerror(ret));
+        return ret;
+    }
+
+    return EOK;
+}
+
+/*
+ * This function waits until all gpo_child processes started by
+ * ad_gpo_cse_step() have finished. The request fails if any download
+ * failed.
+ */
+static void
+ad_gpo_cse_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req;
+    struct ad_gpo_access_state *state;
+    int ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct ad_gpo_access_state);
+
+    ret = ad_gpo_process_cse_recv(subreq);
+    talloc_zfree(subreq);
+    state->num_cse_in_flight--;
+
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to retrieve policy data: [%d](%s}\n",
+              ret, sss_strerror(ret));
+        if (state->cse_error == EOK) {
+            state->cse_error = ret;
         }
+    }
 
+    if (state->num_cse_in_flight > 0) {
+        return;
+    }
+
+    ret = state->cse_error;
+    if (ret != EOK) {
+        goto done;
     }
 
+    ret = ad_gpo_cse_finish(state);
+
  done:
 
     if (ret == EOK) {
         tevent_req_done(req);
-    } else if (ret != EAGAIN) {
+    } else {
         tevent_req_error(req, ret);
     }
 }
@@ -4474,11 +5133,10 @@ ad_gpo_process_gpo_recv(struct tevent_req *req,
 /* == ad_gpo_process_cse_send/recv helpers ================================= */
 static errno_t
 create_cse_send_buffer(TALLOC_CTX *mem_ctx,
-                       const char *smb_server,
-                       const char *smb_share,
-                       const char *smb_path,
+                       struct gp_gpo **gpos,
+                       int *cached_gpt_versions,
+                       int num_gpos,
                        const char *smb_cse_suffix,
-                       int cached_gpt_version,
                        struct io_buffer **io_buf)
 {
     struct io_buffer *buf;
@@ -4487,10 +5145,8 @@ create_cse_send_buffer(TALLOC_CTX *mem_ctx,
     int smb_share_length;
     int smb_path_length;
     int smb_cse_suffix_length;
+    int i;
 
-    smb_server_length = strlen(smb_server);
-    smb_share_length = strlen(smb_share);
-    smb_path_length = strlen(smb_path);
     smb_cse_suffix_length = strlen(smb_cse_suffix);
 
     buf = talloc(mem_ctx, struct io_buffer);
@@ -4499,9 +5155,12 @@ create_cse_send_buffer(TALLOC_CTX *mem_ctx,
         return ENOMEM;
     }
 
-    buf->size = 5 * sizeof(uint32_t);
-    buf->size += smb_server_length + smb_share_length + smb_path_length +
-        smb_cse_suffix_length;
+    buf->size = sizeof(uint32_t);
+    for (i = 0; i < num_gpos; i++) {
+        buf->size += 5 * sizeof(uint32_t);
+        buf->size += strlen(gpos[i]->smb_server) + strlen(gpos[i]->smb_share)
+                     + strlen(gpos[i]->smb_path) + smb_cse_suffix_length;
+    }
 
     DEBUG(SSSDBG_TRACE_ALL, "buffer size: %zu\n", buf->size);
 
@@ -4513,38 +5172,56 @@ create_cse_send_buffer(TALLOC_CTX *mem_ctx,
     }
 
     rp = 0;
-    /* cached_gpt_version */
-    SAFEALIGN_SET_UINT32(&buf->data[rp], cached_gpt_version, &rp);
+    /* num_gpos */
+    SAFEALIGN_SET_UINT32(&buf->data[rp], num_gpos, &rp);
+
+    for (i = 0; i < num_gpos; i++) {
+        smb_server_length = strlen(gpos[i]->smb_server);
+        smb_share_length = strlen(gpos[i]->smb_share);
+        smb_path_length = strlen(gpos[i]->smb_path);
+
+        /* cached_gpt_version */
+        SAFEALIGN_SET_UINT32(&buf->data[rp], cached_gpt_versions[i], &rp);
 
-    /* smb_server */
-    SAFEALIGN_SET_UINT32(&buf->data[rp], smb_server_length, &rp);
-    safealign_memcpy(&buf->data[rp], smb_server, smb_server_length, &rp);
+        /* smb_server */
+        SAFEALIGN_SET_UINT32(&buf->data[rp], smb_server_length, &rp);
+        safealign_memcpy(&buf->data[rp], gpos[i]->smb_server,
+                         smb_server_length, &rp);
 
-    /* smb_share */
-    SAFEALIGN_SET_UINT32(&buf->data[rp], smb_share_length, &rp);
-    safealign_memcpy(&buf->data[rp], smb_share, smb_share_length, &rp);
+        /* smb_share */
+        SAFEALIGN_SET_UINT32(&buf->data[rp], smb_share_length, &rp);
+        safealign_memcpy(&buf->data[rp], gpos[i]->smb_share,
+                         smb_share_length, &rp);
 
-    /* smb_path */
-    SAFEALIGN_SET_UINT32(&buf->data[rp], smb_path_length, &rp);
-    safealign_memcpy(&buf->data[rp], smb_path, smb_path_length, &rp);
+        /* smb_path */
+        SAFEALIGN_SET_UINT32(&buf->data[rp], smb_path_length, &rp);
+        safealign_memcpy(&buf->data[rp], gpos[i]->smb_path,
+                         smb_path_length, &rp);
 
-    /* smb_cse_suffix */
-    SAFEALIGN_SET_UINT32(&buf->data[rp], smb_cse_suffix_length, &rp);
-    safealign_memcpy(&buf->data[rp], smb_cse_suffix, smb_cse_suffix_length, &rp);
+        /* smb_cse_suffix */
+        SAFEALIGN_SET_UINT32(&buf->data[rp], smb_cse_suffix_length, &rp);
+        safealign_memcpy(&buf->data[rp], smb_cse_suffix,
+                         smb_cse_suffix_length, &rp);
+    }
 
     *io_buf = buf;
     return EOK;
 }
 
+/*
+ * The gpo_child writes one response per GPO, in the order of the request.
+ * This function parses the response starting at offset *_p.
+ */
 static errno_t
 ad_gpo_parse_gpo_child_response(uint8_t *buf,
                                 ssize_t size,
+                                size_t *_p,
                                 uint32_t *_sysvol_gpt_version,
                                 uint32_t *_result)
 {
 
     int ret;
-    size_t p = 0;
+    size_t p = *_p;
     uint32_t sysvol_gpt_version;
     uint32_t result;
 
@@ -4556,6 +5233,7 @@ ad_gpo_parse_gpo_child_response(uint8_t *buf,
 
     *_sysvol_gpt_version = sysvol_gpt_version;
     *_result = result;
+    *_p = p;
 
     ret = EOK;
     return ret;
@@ -4567,9 +5245,8 @@ struct ad_gpo_process_cse_state {
     struct tevent_context *ev;
     struct sss_domain_info *domain;
     int gpo_timeout_option;
-    const char *gpo_guid;
-    const char *smb_path;
-    const char *smb_cse_suffix;
+    const char **gpo_guids;
+    int num_gpos;
     pid_t child_pid;
     uint8_t *buf;
     ssize_t len;
@@ -4582,22 +5259,19 @@ static void gpo_cse_done(struct tevent_req *subreq);
 
 /*
  * This cse-specific function (GP_EXT_GUID_SECURITY) sends the input smb uri
- * components and cached_gpt_version to the gpo child, which, in turn,
- * will download the GPT.INI file and policy files (as needed) and store
- * them in the GPO_CACHE directory. Note that if the send_to_child input is
- * false, this function simply completes the request.
+ * components and cached_gpt_versions of a batch of GPOs to one gpo child,
+ * which, in turn, will download the GPT.INI files and policy files (as
+ * needed) over a single SMB connection and store them in the GPO_CACHE
+ * directory.
  */
 struct tevent_req *
 ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
                         struct tevent_context *ev,
-                        bool send_to_child,
                         struct sss_domain_info *domain,
-                        const char *gpo_guid,
-                        const char *smb_server,
-                        const char *smb_share,
-                        const char *smb_path,
+                        struct gp_gpo **gpos,
+                        int *cached_gpt_versions,
+                        int num_gpos,
                         const char *smb_cse_suffix,
-                        int cached_gpt_version,
                         int gpo_timeout_option)
 {
     struct tevent_req *req;
@@ -4605,6 +5279,7 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
     struct ad_gpo_process_cse_state *state;
     struct io_buffer *buf = NULL;
     errno_t ret;
+    int i;
 
     req = tevent_req_create(mem_ctx, &state, struct ad_gpo_process_cse_state);
     if (req == NULL) {
@@ -4612,11 +5287,7 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
         return NULL;
     }
 
-    if (!send_to_child) {
-        /*
-         * if we don't need to talk to child (b/c cache timeout is still valid),
-         * we simply complete the request
-         */
+    if (num_gpos == 0) {
         ret = EOK;
         goto immediately;
     }
@@ -4626,9 +5297,22 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
     state->len = 0;
     state->domain = domain;
     state->gpo_timeout_option = gpo_timeout_option;
-    state->gpo_guid = gpo_guid;
-    state->smb_path = smb_path;
-    state->smb_cse_suffix = smb_cse_suffix;
+    state->num_gpos = num_gpos;
+    state->gpo_guids = talloc_array(state, const char *, num_gpos);
+    if (state->gpo_guids == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    for (i = 0; i < num_gpos; i++) {
+        state->gpo_guids[i] = talloc_strdup(state->gpo_guids,
+                                            gpos[i]->gpo_guid);
+        if (state->gpo_guids[i] == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+    }
+
     state->io = talloc(state, struct child_io_fds);
     if (state->io == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
@@ -4641,8 +5325,8 @@ ad_gpo_process_cse_send(TALLOC_CTX *mem_ctx,
     talloc_set_destructor((void *) state->io, child_io_destructor);
 
     /* prepare the data to pass to child */
-    ret = create_cse_send_buffer(state, smb_server, smb_share, smb_path,
-                                 smb_cse_suffix, cached_gpt_version, &buf);
+    ret = create_cse_send_buffer(state, gpos, cached_gpt_versions, num_gpos,
+                                 smb_cse_suffix, &buf);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "create_cse_send_buffer failed.\n");
         goto immediately;
@@ -4710,7 +5394,10 @@ static void gpo_cse_done(struct tevent_req *subreq)
     struct ad_gpo_process_cse_state *state;
     uint32_t sysvol_gpt_version = -1;
     uint32_t child_result;
+    errno_t first_error = EOK;
+    size_t p = 0;
     time_t now;
+    int i;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct ad_gpo_process_cse_state);
@@ -4725,30 +5412,43 @@ static void gpo_cse_done(struct tevent_req *subreq)
 
     PIPE_FD_CLOSE(state->io->read_from_child_fd);
 
-    ret = ad_gpo_parse_gpo_child_response(state->buf, state->len,
-                                          &sysvol_gpt_version, &child_result);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "ad_gpo_parse_gpo_child_response failed: [%d][%s]\n",
-              ret, sss_strerror(ret));
-        tevent_req_error(req, ret);
-        return;
-    } else if (child_result != 0){
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "Error in gpo_child: [%d][%s]\n",
-              child_result, strerror(child_result));
-        tevent_req_error(req, child_result);
-        return;
+    now = time(NULL);
+    for (i = 0; i < state->num_gpos; i++) {
+        ret = ad_gpo_parse_gpo_child_response(state->buf, state->len, &p,
+                                              &sysvol_gpt_version,
+                                              &child_result);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "ad_gpo_parse_gpo_child_response failed for [%s]: "
+                  "[%d][%s]\n", state->gpo_guids[i], ret, sss_strerror(ret));
+            tevent_req_error(req, first_error != EOK ? first_error : ret);
+            return;
+        } else if (child_result != 0){
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Error in gpo_child for [%s]: [%d][%s]\n",
+                  state->gpo_guids[i], child_result, strerror(child_result));
+            if (first_error == EOK) {
+                first_error = child_result;
+            }
+            continue;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, "[%s] sysvol_gpt_version: %d\n",
+              state->gpo_guids[i], sysvol_gpt_version);
+        ret = sysdb_gpo_store_gpo(state->domain, state->gpo_guids[i],
+                                  sysvol_gpt_version,
+                                  state->gpo_timeout_option, now);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Unable to store gpo cache entry: [%d](%s}\n",
+                  ret, sss_strerror(ret));
+            tevent_req_error(req, ret);
+            return;
+        }
     }
 
-    now = time(NULL);
-    DEBUG(SSSDBG_TRACE_FUNC, "sysvol_gpt_version: %d\n", sysvol_gpt_version);
-    ret = sysdb_gpo_store_gpo(state->domain, state->gpo_guid, sysvol_gpt_version,
-                              state->gpo_timeout_option, now);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "Unable to store gpo cache entry: [%d](%s}\n",
-              ret, sss_strerror(ret));
-        tevent_req_error(req, ret);
+    if (first_error != EOK) {
+        tevent_req_error(req, first_error);
         return;
     }
 
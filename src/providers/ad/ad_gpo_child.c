@@ -42,7 +42,10 @@
 #define INI_GENERAL_SECTION "General"
 #define GPT_INI_VERSION "Version"
 
-struct input_buffer {
+/* Upper limit on the number of GPOs downloaded in one gpo_child run */
+#define GPO_CHILD_MAX_GPOS 1024
+
+struct input_gpo {
     int cached_gpt_version;
     const char *smb_server;
     const char *smb_share;
@@ -50,75 +53,140 @@ struct input_buffer {
     const char *smb_cse_suffix;
 };
 
+struct input_buffer {
+    uint32_t num_gpos;
+    struct input_gpo *gpos;
+};
+
 static errno_t
-unpack_buffer(uint8_t *buf,
+unpack_string(TALLOC_CTX *mem_ctx,
+              uint8_t *buf,
               size_t size,
-              struct input_buffer *ibuf)
+              size_t *_p,
+              const char *name,
+              const char **_str)
 {
-    size_t p = 0;
+    size_t p = *_p;
     uint32_t len;
-    uint32_t cached_gpt_version;
+    char *str;
 
-    /* cached_gpt_version */
-    SAFEALIGN_COPY_UINT32_CHECK(&cached_gpt_version, buf + p, size, &p);
-    DEBUG(SSSDBG_TRACE_FUNC, "cached_gpt_version: %d\n", cached_gpt_version);
-    ibuf->cached_gpt_version = cached_gpt_version;
-
-    /* smb_server */
     SAFEALIGN_COPY_UINT32_CHECK(&len, buf + p, size, &p);
-    DEBUG(SSSDBG_TRACE_ALL, "smb_server length: %d\n", len);
-    if (len == 0) {
+    DEBUG(SSSDBG_TRACE_ALL, "%s length: %d\n", name, len);
+    if (len == 0 || len > size - p) {
         return EINVAL;
-    } else {
-        if (len > size - p) return EINVAL;
-        ibuf->smb_server = talloc_strndup(ibuf, (char *)(buf + p), len);
-        if (ibuf->smb_server == NULL) return ENOMEM;
-        DEBUG(SSSDBG_TRACE_ALL, "smb_server: %s\n", ibuf->smb_server);
-        p += len;
     }
 
-    /* smb_share */
-    SAFEALIGN_COPY_UINT32_CHECK(&len, buf + p, size, &p);
-    DEBUG(SSSDBG_TRACE_ALL, "smb_share length: %d\n", len);
-    if (len == 0) {
-        return EINVAL;
-    } else {
-        if (len > size - p) return EINVAL;
-        ibuf->smb_share = talloc_strndup(ibuf, (char *)(buf + p), len);
-        if (ibuf->smb_share == NULL) return ENOMEM;
-        DEBUG(SSSDBG_TRACE_ALL, "smb_share: %s\n", ibuf->smb_share);
-        p += len;
+    str = talloc_strndup(mem_ctx, (char *)(buf + p), len);
+    if (str == NULL) {
+        return ENOMEM;
     }
+    DEBUG(SSSDBG_TRACE_ALL, "%s: %s\n", name, str);
+    p += len;
 
-    /* smb_path */
-    SAFEALIGN_COPY_UINT32_CHECK(&len, buf + p, size, &p);
-    DEBUG(SSSDBG_TRACE_ALL, "smb_path length: %d\n", len);
-    if (len == 0) {
+    *_str = str;
+    *_p = p;
+    return EOK;
+}
+
+/*
+ * The input buffer has the following structure:
+ *   uint32_t num_gpos
+ * followed by num_gpos entries of:
+ *   uint32_t cached_gpt_version
+ *   uint32_t smb_server length, smb_server
+ *   uint32_t smb_share length, smb_share
+ *   uint32_t smb_path length, smb_path
+ *   uint32_t smb_cse_suffix length, smb_cse_suffix
+ */
+static errno_t
+unpack_buffer(uint8_t *buf,
+              size_t size,
+              struct input_buffer *ibuf)
+{
+    size_t p = 0;
+    uint32_t cached_gpt_version;
+    uint32_t num_gpos;
+    struct input_gpo *gpo;
+    uint32_t i;
+    errno_t ret;
+
+    SAFEALIGN_COPY_UINT32_CHECK(&num_gpos, buf + p, size, &p);
+    DEBUG(SSSDBG_TRACE_FUNC, "num_gpos: %u\n", num_gpos);
+    if (num_gpos == 0 || num_gpos > GPO_CHILD_MAX_GPOS) {
         return EINVAL;
-    } else {
-        if (len > size - p) return EINVAL;
-        ibuf->smb_path = talloc_strndup(ibuf, (char *)(buf + p), len);
-        if (ibuf->smb_path == NULL) return ENOMEM;
-        DEBUG(SSSDBG_TRACE_ALL, "smb_path: %s\n", ibuf->smb_path);
-        p += len;
     }
 
-    /* smb_cse_suffix */
-    SAFEALIGN_COPY_UINT32_CHECK(&len, buf + p, size, &p);
-    DEBUG(SSSDBG_TRACE_ALL, "smb_cse_suffix length: %d\n", len);
-    if (len == 0) {
-        return EINVAL;
-    } else {
-        if (len > size - p) return EINVAL;
-        ibuf->smb_cse_suffix = talloc_strndup(ibuf, (char *)(buf + p), len);
-        if (ibuf->smb_cse_suffix == NULL) return ENOMEM;
-        DEBUG(SSSDBG_TRACE_ALL, "smb_cse_suffix: %s\n", ibuf->smb_cse_suffix);
-        p += len;
+    ibuf->gpos = talloc_zero_array(ibuf, struct input_gpo, num_gpos);
+    if (ibuf->gpos == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_gpos; i++) {
+        gpo = &ibuf->gpos[i];
+
+        /* cached_gpt_version */
+        SAFEALIGN_COPY_UINT32_CHECK(&cached_gpt_version, buf + p, size, &p);
+        DEBUG(SSSDBG_TRACE_FUNC, "cached_gpt_version: %d\n",
+              cached_gpt_version);
+        gpo->cached_gpt_version = cached_gpt_version;
+
+        ret = unpack_string(ibuf->gpos, buf, size, &p, "smb_server",
+                            &gpo->smb_server);
+        if (ret != EOK) return ret;
+
+        ret = unpack_string(ibuf->gpos, buf, size, &p, "smb_share",
+                            &gpo->smb_share);
+        if (ret != EOK) return ret;
+
+        ret = unpack_string(ibuf->gpos, buf, size, &p, "smb_path",
+                            &gpo->smb_path);
+        if (ret != EOK) return ret;
+
+        ret = unpack_string(ibuf->gpos, buf, size, &p, "smb_cse_suffix",
+                            &gpo->smb_cse_suffix);
+        if (ret != EOK) return ret;
     }
 
+    ibuf->num_gpos = num_gpos;
     return EOK;
 }
 
+/*
+ * The backend closes its end of the pipe once the whole request has been
+ * written, so read until EOF. A batch of GPOs does not fit into
+ * IN_BUF_SIZE.
+ */
+static errno_t
+read_input(TALLOC_CTX *mem_ctx, uint8_t **_buf, size_t *_len)
+{
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    ssize_t got;
+    errno_t ret;
+
+    do {
+        buf = talloc_realloc(mem_ctx, buf, uint8_t, len + IN_BUF_SIZE);
+        if (buf == NULL) {
+            return ENOMEM;
+        }
+
+        errno = 0;
+        got = sss_atomic_read_s(STDIN_FILENO, buf + len, IN_BUF_SIZE);
+        if (got == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n",
+                  ret, strerror(ret));
+            talloc_free(buf);
+            return ret;
+        }
+
+        len += got;
+    } while (got == IN_BUF_SIZE);
+
+    *_buf = buf;
+    *_len = len;
+    return EOK;
+}
 
 static errno_t
 pack_buffer(struct response *r,
@@ -629,6 +697,37 @@ copy_smb_file_to_gpo_cache(SMBCCTX *smbc_ctx,
 }
 
 
+/*
+ * This function creates the smbc context shared by all downloads of one
+ * gpo_child run, so that the connection to the DC and its Kerberos
+ * authentication are reused between GPOs.
+ */
+static errno_t
+create_smbc_context(SMBCCTX **_smbc_ctx)
+{
+    SMBCCTX *smbc_ctx;
+
+    smbc_ctx = smbc_new_context();
+    if (smbc_ctx == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not allocate new smbc context\n");
+        return ENOMEM;
+    }
+
+    smbc_setOptionDebugToStderr(smbc_ctx, 1);
+    smbc_setFunctionAuthData(smbc_ctx, sssd_krb_get_auth_data_fn);
+    smbc_setOptionUseKerberos(smbc_ctx, 1);
+
+    /* Initialize the context using the previously specified options */
+    if (smbc_init_context(smbc_ctx) == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not initialize smbc context\n");
+        smbc_free_context(smbc_ctx, 0);
+        return ENOMEM;
+    }
+
+    *_smbc_ctx = smbc_ctx;
+    return EOK;
+}
+
 /*
  * Using its smb_uri components and cached_gpt_version inputs, this function
  * does several things:
@@ -651,35 +750,17 @@ copy_smb_file_to_gpo_cache(SMBCCTX *smbc_ctx,
  * - backend will read the policy file from the GPO_CACHE
  */
 static errno_t
-perform_smb_operations(int cached_gpt_version,
+perform_smb_operations(SMBCCTX *smbc_ctx,
+                       int cached_gpt_version,
                        const char *smb_server,
                        const char *smb_share,
                        const char *smb_path,
                        const char *smb_cse_suffix,
                        int *_sysvol_gpt_version)
 {
-    SMBCCTX *smbc_ctx;
     int ret;
     int sysvol_gpt_version;
 
-    smbc_ctx = smbc_new_context();
-    if (smbc_ctx == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not allocate new smbc context\n");
-        ret = ENOMEM;
-        goto done;
-    }
-
-    smbc_setOptionDebugToStderr(smbc_ctx, 1);
-    smbc_setFunctionAuthData(smbc_ctx, sssd_krb_get_auth_data_fn);
-    smbc_setOptionUseKerberos(smbc_ctx, 1);
-
-    /* Initialize the context using the previously specified options */
-    if (smbc_init_context(smbc_ctx) == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not initialize smbc context\n");
-        ret = ENOMEM;
-        goto done;
-    }
-
     /* download ini file */
     ret = copy_smb_file_to_gpo_cache(smbc_ctx, smb_server, smb_share, smb_path,
                                      GPT_INI);
@@ -687,14 +768,14 @@ perform_smb_operations(int cached_gpt_version,
         DEBUG(SSSDBG_CRIT_FAILURE,
               "copy_smb_file_to_gpo_cache failed [%d][%s]\n",
               ret, strerror(ret));
-        goto done;
+        return ret;
     }
 
     ret = ad_gpo_parse_ini_file(smb_path, &sysvol_gpt_version);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Cannot parse ini file: [%d][%s]\n", ret, strerror(ret));
-        goto done;
+        return ret;
     }
 
     DEBUG(SSSDBG_TRACE_FUNC, "sysvol_gpt_version: %d\n", sysvol_gpt_version);
@@ -707,15 +788,54 @@ perform_smb_operations(int cached_gpt_version,
             DEBUG(SSSDBG_CRIT_FAILURE,
                   "copy_smb_file_to_gpo_cache failed [%d][%s]\n",
                   ret, strerror(ret));
-            goto done;
+            return ret;
         }
     }
 
     *_sysvol_gpt_version = sysvol_gpt_version;
+    return EOK;
+}
 
- done:
-    smbc_free_context(smbc_ctx, 0);
-    return ret;
+/*
+ * The response of each GPO is written as soon as the GPO has been
+ * processed, so the backend receives the results in request order.
+ */
+static errno_t
+send_response(TALLOC_CTX *mem_ctx,
+              int sysvol_gpt_version,
+              int result)
+{
+    struct response *resp = NULL;
+    ssize_t written;
+    errno_t ret;
+
+    ret = prepare_response(mem_ctx, sysvol_gpt_version, result, &resp);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "prepare_response failed. [%d][%s].\n",
+                    ret, strerror(ret));
+        return ret;
+    }
+
+    errno = 0;
+
+    written = sss_atomic_write_s(AD_GPO_CHILD_OUT_FILENO, resp->buf, resp->size);
+    if (written == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "write failed [%d][%s].\n", ret,
+                    strerror(ret));
+        talloc_free(resp);
+        return ret;
+    }
+
+    if (written != resp->size) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Expected to write %zu bytes, wrote %zu\n",
+              resp->size, written);
+        talloc_free(resp);
+        return EIO;
+    }
+
+    talloc_free(resp);
+    return EOK;
 }
 
 int
@@ -730,10 +850,11 @@ main(int argc, const char *argv[])
     int result;
     TALLOC_CTX *main_ctx = NULL;
     uint8_t *buf = NULL;
-    ssize_t len = 0;
+    size_t len = 0;
     struct input_buffer *ibuf = NULL;
-    struct response *resp = NULL;
-    ssize_t written;
+    struct input_gpo *gpo;
+    SMBCCTX *smbc_ctx = NULL;
+    uint32_t i;
 
     struct poptOption long_options[] = {
         POPT_AUTOHELP
@@ -796,12 +917,6 @@ main(int argc, const char *argv[])
     }
     talloc_steal(main_ctx, debug_prg_name);
 
-    buf = talloc_size(main_ctx, sizeof(uint8_t)*IN_BUF_SIZE);
-    if (buf == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_size failed.\n");
-        goto fail;
-    }
-
     ibuf = talloc_zero(main_ctx, struct input_buffer);
     if (ibuf == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
@@ -810,11 +925,8 @@ main(int argc, const char *argv[])
 
     DEBUG(SSSDBG_TRACE_FUNC, "context initialized\n");
 
-    errno = 0;
-    len = sss_atomic_read_s(STDIN_FILENO, buf, IN_BUF_SIZE);
-    if (len == -1) {
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE, "read failed [%d][%s].\n", ret, strerror(ret));
+    ret = read_input(main_ctx, &buf, &len);
+    if (ret != EOK) {
         goto fail;
     }
 
@@ -827,44 +939,41 @@ main(int argc, const char *argv[])
         goto fail;
     }
 
-    DEBUG(SSSDBG_TRACE_FUNC, "performing smb operations\n");
-
-    result = perform_smb_operations(ibuf->cached_gpt_version,
-                                    ibuf->smb_server,
-                                    ibuf->smb_share,
-                                    ibuf->smb_path,
-                                    ibuf->smb_cse_suffix,
-                                    &sysvol_gpt_version);
-    if (result != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "perform_smb_operations failed.[%d][%s].\n",
-              result, strerror(result));
-        goto fail;
-    }
-
-    ret = prepare_response(main_ctx, sysvol_gpt_version, result, &resp);
+    ret = create_smbc_context(&smbc_ctx);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "prepare_response failed. [%d][%s].\n",
-                    ret, strerror(ret));
         goto fail;
     }
 
-    errno = 0;
+    for (i = 0; i < ibuf->num_gpos; i++) {
+        gpo = &ibuf->gpos[i];
 
-    written = sss_atomic_write_s(AD_GPO_CHILD_OUT_FILENO, resp->buf, resp->size);
-    if (written == -1) {
-        ret = errno;
-        DEBUG(SSSDBG_CRIT_FAILURE, "write failed [%d][%s].\n", ret,
-                    strerror(ret));
-        goto fail;
-    }
+        DEBUG(SSSDBG_TRACE_FUNC, "performing smb operations for [%s]\n",
+              gpo->smb_path);
 
-    if (written != resp->size) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Expected to write %zu bytes, wrote %zu\n",
-              resp->size, written);
-        goto fail;
+        sysvol_gpt_version = -1;
+        result = perform_smb_operations(smbc_ctx,
+                                        gpo->cached_gpt_version,
+                                        gpo->smb_server,
+                                        gpo->smb_share,
+                                        gpo->smb_path,
+                                        gpo->smb_cse_suffix,
+                                        &sysvol_gpt_version);
+        if (result != EOK) {
+            /* Report the failure and continue with the next GPO, the
+             * backend decides what to do with it. */
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "perform_smb_operations failed.[%d][%s].\n",
+                  result, strerror(result));
+        }
+
+        ret = send_response(main_ctx, sysvol_gpt_version, result);
+        if (ret != EOK) {
+            goto fail;
+        }
     }
 
+    smbc_free_context(smbc_ctx, 0);
+
     DEBUG(SSSDBG_TRACE_FUNC, "gpo_child completed successfully\n");
     close(AD_GPO_CHILD_OUT_FILENO);
     talloc_free(main_ctx);
@@ -872,6 +981,9 @@ main(int argc, const char *argv[])
 
 fail:
     DEBUG(SSSDBG_CRIT_FAILURE, "gpo_child failed!\n");
+    if (smbc_ctx != NULL) {
+        smbc_free_context(smbc_ctx, 0);
+    }
     close(AD_GPO_CHILD_OUT_FILENO);
     talloc_free(main_ctx);
     return EXIT_FAILURE;
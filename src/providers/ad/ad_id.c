@@ -210,6 +210,9 @@ ad_handle_acct_info_step(struct tevent_req *req)
                                                state->sdom,
                                                state->conn[state->cindex],
                                                noexist_delete,
+                                               dp_opt_get_bool(
+                                                   state->ad_options->basic,
+                                                   AD_PAC_LAZY_GROUPS),
                                                msg);
             if (subreq == NULL) {
                 DEBUG(SSSDBG_OP_FAILURE, "ad_handle_pac_initgr_send failed.\n");
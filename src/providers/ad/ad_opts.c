@@ -59,6 +59,8 @@ struct dp_option ad_basic_opts[] = {
     { "ad_update_samba_machine_account_password", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ad_use_ldaps", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ad_allow_remote_domain_local_groups", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ad_pac_lazy_groups", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ad_tokengroups_gc_lookup", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     DP_OPTION_TERMINATOR
 };
 
@@ -162,6 +164,8 @@ struct dp_option ad_def_ldap_opts[] = {
     { "ldap_pwdlockout_dn", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "wildcard_limit", DP_OPT_NUMBER, { .number = 1000 }, NULL_NUMBER},
     { "ldap_library_debug_level", DP_OPT_NUMBER, NULL_NUMBER, NULL_NUMBER},
+    { "ldap_nested_group_batch_size", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
+    { "ldap_nested_group_cache_timeout", DP_OPT_NUMBER, { .number = 60 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -187,6 +191,10 @@ struct dp_option ad_def_krb5_opts[] = {
     { "krb5_use_kdcinfo", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
     { "krb5_kdcinfo_lookahead", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "krb5_map_user", DP_OPT_STRING, NULL_STRING, NULL_STRING },
+    { "krb5_child_pool_size", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "krb5_child_pool_max_requests", DP_OPT_NUMBER, { .number = 100 }, NULL_NUMBER },
+    { "krb5_renew_threshold", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
+    { "krb5_renew_max_parallel", DP_OPT_NUMBER, { .number = 10 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -25,6 +25,7 @@
 #include "providers/ad/ad_common.h"
 #include "providers/ad/ad_id.h"
 #include "providers/ldap/sdap_idmap.h"
+#include "providers/ldap/sdap_async.h"
 #include "providers/ldap/sdap_async_ad.h"
 
 static errno_t find_user_entry(TALLOC_CTX *mem_ctx, struct sss_domain_info *dom,
@@ -513,6 +514,44 @@ done:
     return ret;
 }
 
+static void ad_pac_resolve_groups_bg_done(struct tevent_req *subreq)
+{
+    errno_t ret;
+
+    ret = sdap_ad_resolve_sids_batch_recv(subreq, NULL);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to resolve the groups from the "
+              "PAC [%d]: %s, they will be resolved when looked up directly\n",
+              ret, sss_strerror(ret));
+    }
+}
+
+/* The lookup is not part of the initgroups request, it runs as long as the
+ * id_ctx exists. */
+static void ad_pac_resolve_groups_in_background(struct tevent_context *ev,
+                                                struct sdap_id_ctx *id_ctx,
+                                                struct sdap_id_conn_ctx *conn,
+                                                struct sss_domain_info *dom,
+                                                char **sids)
+{
+    struct tevent_req *subreq;
+
+    if (sids == NULL || sids[0] == NULL) {
+        return;
+    }
+
+    subreq = sdap_ad_resolve_sids_batch_send(id_ctx, ev, id_ctx, conn, dom,
+                                             sids);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "sdap_ad_resolve_sids_batch_send failed.\n");
+        return;
+    }
+    talloc_steal(subreq, sids);
+
+    tevent_req_set_callback(subreq, ad_pac_resolve_groups_bg_done, NULL);
+}
+
 struct ad_handle_pac_initgr_state {
     struct dp_id_data *ar;
     const char *err;
@@ -537,6 +576,7 @@ struct tevent_req *ad_handle_pac_initgr_send(TALLOC_CTX *mem_ctx,
                                              struct sdap_domain *sdom,
                                              struct sdap_id_conn_ctx *conn,
                                              bool noexist_delete,
+                                             bool lazy_groups,
                                              struct ldb_message *msg)
 {
     int ret;
@@ -547,6 +587,7 @@ struct tevent_req *ad_handle_pac_initgr_send(TALLOC_CTX *mem_ctx,
     char *primary_group_sid;
     size_t num_sids;
     char **group_sids;
+    char **placeholder_sids = NULL;
     bool use_id_mapping;
 
     req = tevent_req_create(mem_ctx, &state,
@@ -581,7 +622,7 @@ struct tevent_req *ad_handle_pac_initgr_send(TALLOC_CTX *mem_ctx,
                                                        sdom->dom->name,
                                                        sdom->dom->domain_id);
     if (use_id_mapping
-            && sdom->dom->ignore_group_members == false) {
+            && (sdom->dom->ignore_group_members == false || lazy_groups)) {
         /* In contrast to the tokenGroups based group-membership lookup the
          * PAC based approach can be used for sub-domains with id-mapping as
          * well because the PAC will only contain groups which are valid in
@@ -595,6 +636,10 @@ struct tevent_req *ad_handle_pac_initgr_send(TALLOC_CTX *mem_ctx,
          * the group object if group members are ignored to avoid having to
          * transfer and retain members when the fake tokengroups object
          * without name is replaced by the full group object.
+         *
+         * With lazy_groups the groups stored under the name of their SID
+         * are replaced in the background without members, so this is not
+         * needed.
          */
 
         DEBUG(SSSDBG_TRACE_ALL, "Running PAC processing with id-mapping.\n");
@@ -603,10 +648,17 @@ struct tevent_req *ad_handle_pac_initgr_send(TALLOC_CTX *mem_ctx,
                                                         state->opts,
                                                         sdom->dom,
                                                         id_ctx->opts->idmap_ctx,
-                                                        num_sids, group_sids);
+                                                        num_sids, group_sids,
+                                                        state,
+                                                        lazy_groups ?
+                                                            &placeholder_sids
+                                                            : NULL);
         if (ret != EOK) {
             DEBUG(SSSDBG_OP_FAILURE,
                   "sdap_ad_save_group_membership_with_idmapping failed.\n");
+        } else if (lazy_groups) {
+            ad_pac_resolve_groups_in_background(be_ctx->ev, id_ctx, conn,
+                                                sdom->dom, placeholder_sids);
         }
 
         /* this path only includes cache operation, so we can finish the
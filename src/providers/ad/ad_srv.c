@@ -38,6 +38,9 @@
 
 #define AD_SITE_DOMAIN_FMT "%s._sites.%s"
 
+/* Number of domain controllers remembered in the ranking. */
+#define AD_DC_RANKING_MAX 8
+
 char *ad_site_dns_discovery_domain(TALLOC_CTX *mem_ctx,
                                    const char *site,
                                    const char *domain)
@@ -116,6 +119,129 @@ static errno_t ad_sort_servers_by_dns(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+/* Moves the servers which are present in the ranking to the front of the
+ * list, in the order of the ranking. If keep_priority is true, servers are
+ * only reordered within the same priority. */
+errno_t ad_sort_servers_by_ranking(struct fo_server_info *srv,
+                                   size_t num,
+                                   const char * const *ranking,
+                                   bool keep_priority)
+{
+    struct fo_server_info *sorted;
+    bool *used;
+    size_t start;
+    size_t end;
+    size_t out;
+    size_t i;
+    size_t r;
+
+    if (srv == NULL || num <= 1 || ranking == NULL || ranking[0] == NULL) {
+        return EOK;
+    }
+
+    sorted = talloc_array(NULL, struct fo_server_info, num);
+    if (sorted == NULL) {
+        return ENOMEM;
+    }
+
+    used = talloc_zero_array(sorted, bool, num);
+    if (used == NULL) {
+        talloc_free(sorted);
+        return ENOMEM;
+    }
+
+    out = 0;
+    for (start = 0; start < num; start = end) {
+        end = start + 1;
+        if (keep_priority) {
+            while (end < num && srv[end].priority == srv[start].priority) {
+                end++;
+            }
+        } else {
+            end = num;
+        }
+
+        for (r = 0; ranking[r] != NULL; r++) {
+            for (i = start; i < end; i++) {
+                if (!used[i] && strcasecmp(srv[i].host, ranking[r]) == 0) {
+                    sorted[out++] = srv[i];
+                    used[i] = true;
+                }
+            }
+        }
+
+        for (i = start; i < end; i++) {
+            if (!used[i]) {
+                sorted[out++] = srv[i];
+                used[i] = true;
+            }
+        }
+    }
+
+    memcpy(srv, sorted, num * sizeof(struct fo_server_info));
+    talloc_free(sorted);
+
+    return EOK;
+}
+
+/* Puts dc on the top of the ranking and stores the ranking in the cache so
+ * it is available after restart. */
+errno_t ad_srv_plugin_ctx_rank_dc(struct ad_srv_plugin_ctx *ctx,
+                                  const char *dc)
+{
+    const char **ranking;
+    size_t count;
+    size_t i;
+    errno_t ret;
+
+    if (dc == NULL) {
+        return EINVAL;
+    }
+
+    if (ctx->dc_ranking != NULL && ctx->dc_ranking[0] != NULL
+            && strcasecmp(ctx->dc_ranking[0], dc) == 0) {
+        return EOK;
+    }
+
+    ranking = talloc_zero_array(ctx, const char *, AD_DC_RANKING_MAX + 1);
+    if (ranking == NULL) {
+        return ENOMEM;
+    }
+
+    ranking[0] = talloc_strdup(ranking, dc);
+    if (ranking[0] == NULL) {
+        talloc_free(ranking);
+        return ENOMEM;
+    }
+    count = 1;
+
+    for (i = 0; ctx->dc_ranking != NULL && ctx->dc_ranking[i] != NULL
+                && count < AD_DC_RANKING_MAX; i++) {
+        if (strcasecmp(ctx->dc_ranking[i], dc) == 0) {
+            continue;
+        }
+
+        ranking[count] = talloc_strdup(ranking, ctx->dc_ranking[i]);
+        if (ranking[count] == NULL) {
+            talloc_free(ranking);
+            return ENOMEM;
+        }
+        count++;
+    }
+
+    talloc_free(ctx->dc_ranking);
+    ctx->dc_ranking = ranking;
+
+    ret = sysdb_set_dc_ranking(ctx->be_ctx->domain, ctx->dc_ranking);
+    if (ret != EOK) {
+        /* Not fatal. */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to store domain controller "
+              "ranking [%d]: %s\n", ret, sss_strerror(ret));
+    }
+
+    return EOK;
+}
+
 static void ad_srv_mark_renew_site(void *pvt)
 {
     struct ad_srv_plugin_ctx *ctx;
@@ -179,6 +305,29 @@ ad_srv_plugin_ctx_init(TALLOC_CTX *mem_ctx,
         }
     }
 
+    ret = sysdb_get_site_forest(ctx, be_ctx->domain, &ctx->current_forest);
+    if (ret != EOK) {
+        /* Not fatal. */
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Unable to get current forest from cache [%d]: %s\n",
+              ret, sss_strerror(ret));
+        ctx->current_forest = NULL;
+    }
+
+    ret = sysdb_get_dc_ranking(ctx, be_ctx->domain, &ctx->dc_ranking);
+    if (ret != EOK) {
+        /* Not fatal. */
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Unable to get domain controller ranking from cache [%d]: %s\n",
+              ret, sss_strerror(ret));
+        ctx->dc_ranking = NULL;
+    }
+
+    /* The site from the previous run is used for the first lookup so we do
+     * not have to wait for the CLDAP ping during startup. */
+    ctx->use_cached_site = (ctx->current_site != NULL
+                                && ctx->current_forest != NULL);
+
     ret = be_add_offline_cb(ctx, be_ctx, ad_srv_mark_renew_site, ctx, NULL);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "be_add_offline_cb failed.\n");
@@ -212,6 +361,13 @@ ad_srv_plugin_ctx_switch_site(struct ad_srv_plugin_ctx *ctx,
 
         talloc_zfree(ctx->current_forest);
         ctx->current_forest = forest;
+
+        ret = sysdb_set_site_forest(ctx->be_ctx->domain, ctx->current_forest);
+        if (ret != EOK) {
+            /* Not fatal. */
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to store forest information "
+                  "[%d]: %s\n", ret, sss_strerror(ret));
+        }
     }
 
     if (new_site == NULL) {
@@ -257,6 +413,75 @@ struct ad_srv_plugin_state {
     size_t num_backup_servers;
 };
 
+static void ad_srv_plugin_refresh_site_done(struct tevent_req *subreq);
+
+/* Verifies the cached site with a CLDAP ping in the background. The result
+ * is used once the servers are resolved again. */
+static errno_t ad_srv_plugin_refresh_site(struct ad_srv_plugin_ctx *ctx,
+                                          struct tevent_context *ev,
+                                          const char *discovery_domain)
+{
+    struct tevent_req *subreq;
+
+    subreq = ad_cldap_ping_send(ctx, ev, ctx, discovery_domain);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, ad_srv_plugin_refresh_site_done, ctx);
+
+    return EOK;
+}
+
+static void ad_srv_plugin_refresh_site_done(struct tevent_req *subreq)
+{
+    struct ad_srv_plugin_ctx *ctx;
+    TALLOC_CTX *tmp_ctx;
+    const char *site = NULL;
+    const char *forest = NULL;
+    errno_t ret;
+
+    ctx = tevent_req_callback_data(subreq, struct ad_srv_plugin_ctx);
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        talloc_zfree(subreq);
+        ctx->renew_site = true;
+        return;
+    }
+
+    ret = ad_cldap_ping_recv(tmp_ctx, subreq, &site, &forest);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to verify cached site "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+        /* Try again during the next lookup. */
+        ctx->renew_site = true;
+        goto done;
+    }
+
+    if (ctx->ad_site_override != NULL) {
+        site = ctx->ad_site_override;
+    }
+
+    if (site != NULL && ctx->current_site != NULL
+            && strcmp(site, ctx->current_site) != 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Site changed from '%s' to '%s'\n",
+              ctx->current_site, site);
+    }
+
+    ret = ad_srv_plugin_ctx_switch_site(ctx, site, forest);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to set site [%d]: %s\n",
+              ret, sss_strerror(ret));
+        ctx->renew_site = true;
+        goto done;
+    }
+
+done:
+    talloc_free(tmp_ctx);
+}
+
 static void ad_srv_plugin_ping_done(struct tevent_req *subreq);
 static void ad_srv_plugin_servers_done(struct tevent_req *subreq);
 
@@ -321,6 +546,21 @@ struct tevent_req *ad_srv_plugin_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
 
+    if (ctx->renew_site && ctx->use_cached_site) {
+        ctx->use_cached_site = false;
+
+        ret = ad_srv_plugin_refresh_site(ctx, ev, state->discovery_domain);
+        if (ret == EOK) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Using cached site '%s' and forest "
+                  "'%s'\n", ctx->current_site, ctx->current_forest);
+            ctx->renew_site = false;
+        } else {
+            /* Not fatal, ping in the foreground. */
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to refresh site in the "
+                  "background [%d]: %s\n", ret, sss_strerror(ret));
+        }
+    }
+
     subreq = ad_cldap_ping_send(state, ev, state->ctx, state->discovery_domain);
     if (subreq == NULL) {
         ret = ENOMEM;
@@ -492,6 +732,25 @@ static void ad_srv_plugin_servers_done(struct tevent_req *subreq)
         /* continue */
     }
 
+    /* Try the domain controllers which answered the CLDAP ping first. */
+    ret = ad_sort_servers_by_ranking(state->primary_servers,
+                                     state->num_primary_servers,
+                                     state->ctx->dc_ranking, true);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to sort primary servers by "
+              "ranking [%d]: %s\n", ret, sss_strerror(ret));
+        /* continue */
+    }
+
+    ret = ad_sort_servers_by_ranking(state->backup_servers,
+                                     state->num_backup_servers,
+                                     state->ctx->dc_ranking, true);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to sort backup servers by "
+              "ranking [%d]: %s\n", ret, sss_strerror(ret));
+        /* continue */
+    }
+
     tevent_req_done(req);
 }
 
@@ -31,8 +31,14 @@ struct ad_srv_plugin_ctx {
     const char *ad_site_override;
     const char *current_site;
     const char *current_forest;
+    /* Domain controllers that answered the CLDAP ping first, the most
+     * recent one first. */
+    const char **dc_ranking;
 
     bool renew_site;
+    /* Site and forest were loaded from the cache and were not verified
+     * with a CLDAP ping yet. */
+    bool use_cached_site;
 };
 
 struct ad_srv_plugin_ctx *
@@ -61,6 +67,14 @@ errno_t ad_srv_plugin_recv(TALLOC_CTX *mem_ctx,
                             struct fo_server_info **_backup_servers,
                             size_t *_num_backup_servers);
 
+errno_t ad_sort_servers_by_ranking(struct fo_server_info *srv,
+                                   size_t num,
+                                   const char * const *ranking,
+                                   bool keep_priority);
+
+errno_t ad_srv_plugin_ctx_rank_dc(struct ad_srv_plugin_ctx *ctx,
+                                  const char *dc);
+
 char *ad_site_dns_discovery_domain(TALLOC_CTX *mem_ctx,
                                    const char *site,
                                    const char *domain);
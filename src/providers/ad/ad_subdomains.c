@@ -570,7 +570,8 @@ ad_subdom_store(struct confdb_ctx *cdb,
                 struct sdap_idmap_ctx *idmap_ctx,
                 struct sss_domain_info *domain,
                 struct sysdb_attrs *subdom_attrs,
-                bool enumerate)
+                bool enumerate,
+                bool *_changed)
 {
     TALLOC_CTX *tmp_ctx;
     const char *name;
@@ -631,8 +632,9 @@ ad_subdom_store(struct confdb_ctx *cdb,
     DEBUG(SSSDBG_CONF_SETTINGS, "MPG mode of %s is %s\n",
                                 name, str_domain_mpg_mode(mpg_mode));
 
-    ret = sysdb_subdomain_store(domain->sysdb, name, realm, flat, sid_str,
-                                mpg_mode, enumerate, domain->forest, 0, NULL);
+    ret = sysdb_subdomain_store_ext(domain->sysdb, name, realm, flat, sid_str,
+                                    mpg_mode, enumerate, domain->forest, 0,
+                                    NULL, _changed);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "sysdb_subdomain_store failed.\n");
         goto done;
@@ -664,6 +666,8 @@ static errno_t ad_subdomains_refresh(struct be_ctx *be_ctx,
     size_t c, h;
     int ret;
     bool enumerate;
+    bool changed;
+    bool existing_changed = false;
 
     domain = be_ctx->domain;
     memset(handled, 0, sizeof(bool) * num_subdomains);
@@ -708,6 +712,7 @@ static errno_t ad_subdomains_refresh(struct be_ctx *be_ctx,
         if (c >= num_subdomains) {
             /* ok this subdomain does not exist anymore, let's clean up */
             sss_domain_set_state(dom, DOM_DISABLED);
+            existing_changed = true;
 
             /* Just disable the forest root but do not remove sdap data */
             if (sss_domain_is_forest_root(dom)) {
@@ -747,14 +752,21 @@ static errno_t ad_subdomains_refresh(struct be_ctx *be_ctx,
                 goto done;
             }
 
+            /* ad_subdom_store() only writes attributes which differ from
+             * the cached entry. */
+            changed = false;
             ret = ad_subdom_store(be_ctx->cdb, idmap_ctx, domain,
-                                  subdomains[c], enumerate);
+                                  subdomains[c], enumerate, &changed);
             if (ret) {
                 /* Nothing we can do about the error. Let's at least try
                  * to reuse the existing domains
                  */
                 DEBUG(SSSDBG_MINOR_FAILURE, "Failed to parse subdom data, "
                       "will try to use cached subdomain\n");
+            } else if (changed) {
+                DEBUG(SSSDBG_TRACE_FUNC, "Subdomain %s has changed\n",
+                      dom->name);
+                existing_changed = true;
             }
             handled[c] = true;
             h++;
@@ -762,9 +774,10 @@ static errno_t ad_subdomains_refresh(struct be_ctx *be_ctx,
     }
 
     if (num_subdomains == h) {
-        /* all domains were already accounted for and have been updated */
+        /* all domains were already accounted for, only reinitialize the
+         * subdomains if any of them was removed or has changed */
         ret = EOK;
-        *_changes = false;
+        *_changes = existing_changed;
         goto done;
     }
 
@@ -784,7 +797,7 @@ static errno_t ad_subdomains_refresh(struct be_ctx *be_ctx,
         }
 
         ret = ad_subdom_store(be_ctx->cdb, idmap_ctx, domain,
-                              subdomains[c], enumerate);
+                              subdomains[c], enumerate, NULL);
         if (ret) {
             DEBUG(SSSDBG_MINOR_FAILURE, "Failed to parse subdom data, "
                   "will try to use cached subdomain\n");
@@ -85,6 +85,8 @@ struct be_ctx {
     struct session_recording_conf sr_conf;
     struct be_failover_ctx *be_fo;
     struct be_resolv_ctx *be_res;
+    /* Threads hashing cached passwords, NULL if they are not used */
+    struct s3crypt_pool *crypt_pool;
 
     /* Functions to be invoked when the
      * backend goes online or offline
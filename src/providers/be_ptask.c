@@ -90,10 +90,33 @@ static void be_ptask_timeout(struct tevent_context *ev,
     DEBUG(SSSDBG_OP_FAILURE, "Task [%s]: timed out\n", task->name);
 
     talloc_zfree(task->req);
+    talloc_zfree(task->slot);
     be_ptask_schedule(task, BE_PTASK_PERIOD, BE_PTASK_SCHEDULE_FROM_NOW);
 }
 
 static void be_ptask_done(struct tevent_req *req);
+static void be_ptask_admitted(struct tevent_req *req);
+static void be_ptask_run(struct be_ptask *task);
+
+static bool be_ptask_get_class(struct be_ptask *task,
+                               enum dp_req_class *_class)
+{
+    if (task->be_ctx->provider == NULL) {
+        return false;
+    }
+
+    if (task->flags & BE_PTASK_CLASS_REFRESH) {
+        *_class = DP_REQ_CLASS_REFRESH;
+        return true;
+    }
+
+    if (task->flags & BE_PTASK_CLASS_ENUMERATION) {
+        *_class = DP_REQ_CLASS_ENUMERATION;
+        return true;
+    }
+
+    return false;
+}
 
 static void be_ptask_execute(struct tevent_context *ev,
                              struct tevent_timer *tt,
@@ -101,7 +124,7 @@ static void be_ptask_execute(struct tevent_context *ev,
                              void *pvt)
 {
     struct be_ptask *task = NULL;
-    struct tevent_timer *timeout = NULL;
+    enum dp_req_class class;
 
     task = talloc_get_type(pvt, struct be_ptask);
     task->timer = NULL; /* timer is freed by tevent */
@@ -124,17 +147,63 @@ static void be_ptask_execute(struct tevent_context *ev,
         /* continue */
     }
 
+    task->last_execution = tv.tv_sec;
+
+    if (!be_ptask_get_class(task, &class)) {
+        be_ptask_run(task);
+        return;
+    }
+
+    /* Wait until user facing requests leave room for the task */
+    task->req = dp_req_admission_send(task, task->be_ctx->provider, class,
+                                      task->name);
+    if (task->req == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "Task [%s]: failed to execute task, "
+              "will try again later\n", task->name);
+
+        be_ptask_schedule(task, BE_PTASK_PERIOD, BE_PTASK_SCHEDULE_FROM_NOW);
+        return;
+    }
+
+    tevent_req_set_callback(task->req, be_ptask_admitted, task);
+}
+
+static void be_ptask_admitted(struct tevent_req *req)
+{
+    struct be_ptask *task = NULL;
+    errno_t ret;
+
+    task = tevent_req_callback_data(req, struct be_ptask);
+
+    ret = dp_req_admission_recv(task, req, &task->slot);
+    talloc_zfree(req);
+    task->req = NULL;
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Task [%s]: failed to get a scheduling "
+              "slot [%d]: %s\n", task->name, ret, sss_strerror(ret));
+
+        be_ptask_schedule(task, BE_PTASK_PERIOD, BE_PTASK_SCHEDULE_FROM_NOW);
+        return;
+    }
+
+    be_ptask_run(task);
+}
+
+static void be_ptask_run(struct be_ptask *task)
+{
+    struct tevent_timer *timeout = NULL;
+    struct timeval tv;
+
     DEBUG(SSSDBG_TRACE_FUNC, "Task [%s]: executing task, timeout %lu "
                               "seconds\n", task->name, task->timeout);
 
-    task->last_execution = tv.tv_sec;
-
     task->req = task->send_fn(task, task->ev, task->be_ctx, task, task->pvt);
     if (task->req == NULL) {
         /* skip this iteration and try again later */
         DEBUG(SSSDBG_OP_FAILURE, "Task [%s]: failed to execute task, "
               "will try again later\n", task->name);
 
+        talloc_zfree(task->slot);
         be_ptask_schedule(task, BE_PTASK_PERIOD, BE_PTASK_SCHEDULE_FROM_NOW);
         return;
     }
@@ -150,6 +219,7 @@ static void be_ptask_execute(struct tevent_context *ev,
             /* If we can't guarantee a timeout,
              * we need to cancel the request. */
             talloc_zfree(task->req);
+            talloc_zfree(task->slot);
 
             DEBUG(SSSDBG_OP_FAILURE, "Task [%s]: failed to set timeout, "
                   "the task will be rescheduled\n", task->name);
@@ -172,6 +242,7 @@ static void be_ptask_done(struct tevent_req *req)
     ret = task->recv_fn(req);
     talloc_zfree(req);
     task->req = NULL;
+    talloc_zfree(task->slot);
     switch (ret) {
     case EOK:
         DEBUG(SSSDBG_TRACE_FUNC, "Task [%s]: finished successfully\n",
@@ -286,6 +357,12 @@ static int be_ptask_flag_check(uint32_t flags)
         return EINVAL;
     }
 
+    tmpflags = flags & (BE_PTASK_CLASS_REFRESH |
+                        BE_PTASK_CLASS_ENUMERATION);
+    if (be_ptask_flag_bits(tmpflags) > 1) {
+        return EINVAL;
+    }
+
     return EOK;
 }
 
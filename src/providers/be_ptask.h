@@ -57,6 +57,17 @@ struct be_ptask;
 /* current request will be executed as planned */
 #define BE_PTASK_OFFLINE_EXECUTE     0x0020
 
+/**
+ * Flags defining the scheduling class of the task. The task waits for a free
+ * slot of the class before it is executed, together with the data provider
+ * requests of the same class. Without these flags the task runs as soon as
+ * it is due.
+ */
+/* background refresh of cached data */
+#define BE_PTASK_CLASS_REFRESH       0x0040
+/* enumeration */
+#define BE_PTASK_CLASS_ENUMERATION   0x0080
+
 typedef struct tevent_req *
 (*be_ptask_send_t)(TALLOC_CTX *mem_ctx,
                    struct tevent_context *ev,
@@ -39,6 +39,7 @@ struct be_ptask {
     time_t next_execution;  /* next time when the task is scheduled */
     time_t last_execution;  /* last time when send was called */
     struct tevent_req *req; /* active tevent request */
+    struct dp_req_slot *slot; /* scheduling slot of the active request */
     struct tevent_timer *timer; /* active tevent timer */
     uint32_t flags;
     bool enabled;
@@ -149,10 +149,70 @@ struct be_refresh_cb_ctx {
     struct be_refresh_cb cb;
 };
 
+/* Pacing of the refresh. Batches are always issued one at a time, the
+ * number of concurrent requests is not changed. What is adjusted after
+ * each batch is the number of entries it refreshes and the pause before
+ * the next one: the batch grows by a constant step while the directory
+ * answers quickly and it is halved (and the pause doubled) when the batch
+ * is slow or fails with a timeout. */
+#define BE_REFRESH_BATCH_MIN 10
+#define BE_REFRESH_BATCH_INITIAL 200
+#define BE_REFRESH_BATCH_MAX 1000
+#define BE_REFRESH_BATCH_STEP 50
+
+#define BE_REFRESH_DELAY_MIN 500 /* msec */
+#define BE_REFRESH_DELAY_MAX 8000 /* msec */
+
+#define BE_REFRESH_LATENCY_LOW 20 /* msec per entry */
+#define BE_REFRESH_LATENCY_HIGH 200 /* msec per entry */
+
+/* A batch is postponed while user facing data provider requests are in
+ * progress, but at most this many times in a row so the refresh is not
+ * starved on a busy system. */
+#define BE_REFRESH_MAX_YIELDS 10
+
+struct be_refresh_pacing {
+    size_t batch_size; /* entries per batch */
+    uint32_t delay;    /* msec between batches */
+};
+
 struct be_refresh_ctx {
     struct be_refresh_cb_ctx callbacks[BE_REFRESH_TYPE_SENTINEL];
+    struct be_refresh_pacing pacing;
 };
 
+static bool be_refresh_is_congestion(errno_t ret)
+{
+    switch (ret) {
+    case ETIMEDOUT:
+    case EBUSY:
+    case ERR_NETWORK_IO:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void be_refresh_pacing_update(struct be_refresh_pacing *pacing,
+                                   size_t count,
+                                   uint32_t msec,
+                                   errno_t ret)
+{
+    uint32_t per_entry;
+
+    per_entry = count > 0 ? msec / count : msec;
+
+    if (be_refresh_is_congestion(ret) || per_entry > BE_REFRESH_LATENCY_HIGH) {
+        pacing->batch_size = MAX(pacing->batch_size / 2,
+                                 BE_REFRESH_BATCH_MIN);
+        pacing->delay = MIN(pacing->delay * 2, BE_REFRESH_DELAY_MAX);
+    } else if (ret == EOK && per_entry < BE_REFRESH_LATENCY_LOW) {
+        pacing->batch_size = MIN(pacing->batch_size + BE_REFRESH_BATCH_STEP,
+                                 BE_REFRESH_BATCH_MAX);
+        pacing->delay = MAX(pacing->delay / 2, BE_REFRESH_DELAY_MIN);
+    }
+}
+
 static errno_t be_refresh_ctx_init(struct be_ctx *be_ctx,
                                    const char *attr_name)
 {
@@ -165,6 +225,9 @@ static errno_t be_refresh_ctx_init(struct be_ctx *be_ctx,
         return ENOMEM;
     }
 
+    ctx->pacing.batch_size = BE_REFRESH_BATCH_INITIAL;
+    ctx->pacing.delay = BE_REFRESH_DELAY_MIN;
+
     ctx->callbacks[BE_REFRESH_TYPE_INITGROUPS].name = "initgroups";
     ctx->callbacks[BE_REFRESH_TYPE_INITGROUPS].attr_name = SYSDB_NAME;
     ctx->callbacks[BE_REFRESH_TYPE_USERS].name = "users";
@@ -181,7 +244,8 @@ static errno_t be_refresh_ctx_init(struct be_ctx *be_ctx,
                               be_refresh_send, be_refresh_recv,
                               ctx, "Refresh Records",
                               BE_PTASK_OFFLINE_SKIP |
-                              BE_PTASK_SCHEDULE_FROM_NOW,
+                              BE_PTASK_SCHEDULE_FROM_NOW |
+                              BE_PTASK_CLASS_REFRESH,
                               NULL);
         if (ret != EOK) {
             DEBUG(SSSDBG_FATAL_FAILURE,
@@ -302,6 +366,14 @@ struct be_refresh_state {
 
     size_t batch_size;
     char **refresh_batch;
+
+    /* per-batch latency */
+    struct timeval batch_start;
+    size_t num_batches;
+    size_t num_refreshed;
+    uint64_t total_msec;
+    uint32_t max_msec;
+    uint32_t num_yields;
 };
 
 static errno_t be_refresh_batch_step(struct tevent_req *req,
@@ -340,7 +412,7 @@ struct tevent_req *be_refresh_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
 
-    state->batch_size = 200;
+    state->batch_size = BE_REFRESH_BATCH_MAX;
     state->refresh_batch = talloc_zero_array(state, char *, state->batch_size+1);
     if (state->refresh_batch == NULL) {
         ret = ENOMEM;
@@ -462,7 +534,7 @@ static errno_t be_refresh_batch_step(struct tevent_req *req,
     }
 
     remaining = state->refresh_val_size - state->refresh_index;
-    batch_size = MIN(remaining, state->batch_size);
+    batch_size = MIN(remaining, state->ctx->pacing.batch_size);
     DEBUG(SSSDBG_FUNC_DATA,
           "This batch will refresh %zu entries (so far %zu/%zu)\n",
           batch_size, state->refresh_index, state->refresh_val_size);
@@ -490,11 +562,29 @@ static void be_refresh_batch_step_wakeup(struct tevent_context *ev,
     struct tevent_req *req;
     struct tevent_req *subreq = NULL;
     struct be_refresh_state *state = NULL;
+    struct timeval next;
 
     req = talloc_get_type(pvt, struct tevent_req);
     state = tevent_req_data(req, struct be_refresh_state);
 
+    if (state->num_yields < BE_REFRESH_MAX_YIELDS
+            && dp_req_user_requests_pending(state->be_ctx->provider)) {
+        state->num_yields++;
+        DEBUG(SSSDBG_TRACE_INTERNAL, "User requests are in progress, "
+              "postponing refresh batch by %u ms\n",
+              state->ctx->pacing.delay);
+
+        next = tevent_timeval_current_ofs(0, state->ctx->pacing.delay * 1000);
+        if (tevent_add_timer(ev, req, next, be_refresh_batch_step_wakeup,
+                             req) == NULL) {
+            tevent_req_error(req, ENOMEM);
+        }
+        return;
+    }
+    state->num_yields = 0;
+
     DEBUG(SSSDBG_TRACE_INTERNAL, "Issuing refresh\n");
+    state->batch_start = tevent_timeval_current();
     subreq = state->cb_ctx->cb.send_fn(state, state->ev, state->be_ctx,
                                        state->domain,
                                        state->refresh_batch,
@@ -506,6 +596,40 @@ static void be_refresh_batch_step_wakeup(struct tevent_context *ev,
     tevent_req_set_callback(subreq, be_refresh_done, req);
 }
 
+static uint32_t be_refresh_elapsed_msec(struct timeval *start)
+{
+    struct timeval now;
+    int64_t msec;
+
+    now = tevent_timeval_current();
+    msec = (now.tv_sec - start->tv_sec) * 1000
+           + (now.tv_usec - start->tv_usec) / 1000;
+
+    return msec > 0 ? msec : 0;
+}
+
+static void be_refresh_batch_done(struct be_refresh_state *state,
+                                  errno_t ret)
+{
+    size_t count;
+    uint32_t msec;
+
+    for (count = 0; state->refresh_batch[count] != NULL; count++);
+
+    msec = be_refresh_elapsed_msec(&state->batch_start);
+    be_refresh_pacing_update(&state->ctx->pacing, count, msec, ret);
+
+    state->num_batches++;
+    state->num_refreshed += count;
+    state->total_msec += msec;
+    state->max_msec = MAX(state->max_msec, msec);
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Batch of %zu %s refreshed in %u ms "
+          "[%d]: %s; next batch size %zu, delay %u ms\n",
+          count, state->cb_ctx->name, msec, ret, sss_strerror(ret),
+          state->ctx->pacing.batch_size, state->ctx->pacing.delay);
+}
+
 static void be_refresh_done(struct tevent_req *subreq)
 {
     struct be_refresh_state *state = NULL;
@@ -517,11 +641,17 @@ static void be_refresh_done(struct tevent_req *subreq)
 
     ret = state->cb_ctx->cb.recv_fn(subreq);
     talloc_zfree(subreq);
-    if (ret != EOK) {
+    be_refresh_batch_done(state, ret);
+    if (be_refresh_is_congestion(ret)) {
+        /* the remaining entries of this batch are still expired and will
+         * be picked up by the next refresh, continue with smaller batch */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Refresh batch failed [%d]: %s, "
+              "backing off\n", ret, sss_strerror(ret));
+    } else if (ret != EOK) {
         goto done;
     }
 
-    ret = be_refresh_batch_step(req, 500);
+    ret = be_refresh_batch_step(req, state->ctx->pacing.delay);
     if (ret == EAGAIN) {
         DEBUG(SSSDBG_TRACE_INTERNAL,
               "Another batch in this step in progress\n");
@@ -543,6 +673,13 @@ static void be_refresh_done(struct tevent_req *subreq)
     }
 
 done:
+    if (state->num_batches > 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Refreshed %zu entries in %zu batches, "
+              "average batch latency %"PRIu64" ms, maximum %u ms\n",
+              state->num_refreshed, state->num_batches,
+              state->total_msec / state->num_batches, state->max_msec);
+    }
+
     if (ret != EOK) {
         tevent_req_error(req, ret);
         return;
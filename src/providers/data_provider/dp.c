@@ -177,6 +177,11 @@ dp_init_send(TALLOC_CTX *mem_ctx,
     state->provider->gid = gid;
     state->provider->be_ctx = be_ctx;
 
+    ret = dp_init_request_queues(state->provider);
+    if (ret != EOK) {
+        goto done;
+    }
+
     state->sbus_name = sss_iface_domain_bus(state, be_ctx->domain);
     if (state->sbus_name == NULL) {
         DEBUG(SSSDBG_FATAL_FAILURE, "Could not get sbus backend name.\n");
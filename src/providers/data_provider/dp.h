@@ -182,6 +182,10 @@ bool dp_method_enabled(struct data_provider *provider,
 void dp_terminate_domain_requests(struct data_provider *provider,
                                   const char *domain);
 
+/* Returns true if there are user facing requests (lookups, authentication,
+ * initgroups) in progress so background tasks may postpone their work. */
+bool dp_req_user_requests_pending(struct data_provider *provider);
+
 void dp_sbus_domain_active(struct data_provider *provider,
                            struct sss_domain_info *dom);
 void dp_sbus_domain_inconsistent(struct data_provider *provider,
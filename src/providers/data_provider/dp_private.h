@@ -45,6 +45,22 @@ enum dp_clients {
 struct dp_req;
 struct dp_client;
 
+struct dp_req_queue {
+    /* Maximum number of running requests, 0 means unlimited. */
+    uint32_t limit;
+    uint32_t num_running;
+
+    /* Requests waiting for a free slot. */
+    uint32_t num_queued;
+    struct dp_req_queue_item *queued;
+
+    /* Queue-time statistics. */
+    uint64_t num_started;
+    uint64_t num_delayed;
+    uint64_t total_wait_msec;
+    uint32_t max_wait_msec;
+};
+
 struct dp_module {
     bool initialized;
     const char *name;
@@ -90,6 +106,10 @@ struct data_provider {
         /* List of all ongoing requests. */
         uint32_t num_active;
         struct dp_req *active;
+
+        /* Per-class scheduling queues. */
+        struct dp_req_queue classes[DP_REQ_CLASS_SENTINEL];
+        struct tevent_immediate *dispatch_imm;
     } requests;
 
     struct dp_module **modules;
@@ -120,6 +140,8 @@ errno_t dp_init_targets(TALLOC_CTX *mem_ctx,
 
 /* Data provider request. */
 
+errno_t dp_init_request_queues(struct data_provider *provider);
+
 void dp_terminate_active_requests(struct data_provider *provider);
 
 /* Client shared functions. */
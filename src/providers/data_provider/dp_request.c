@@ -28,6 +28,32 @@
 #include "util/util.h"
 #include "util/probes.h"
 
+/* Default maximum number of concurrently running requests of each class,
+ * 0 means unlimited. Lookups and authentication a user waits for are never
+ * limited, the background classes can be tuned per domain. */
+#define DP_REQ_LIMIT_INTERACTIVE 0
+#define DP_REQ_LIMIT_INITGROUPS 50
+#define DP_REQ_LIMIT_REFRESH 4
+#define DP_REQ_LIMIT_ENUMERATION 1
+
+/* Requests waiting in the queue longer than this are reported. */
+#define DP_REQ_SLOW_QUEUE_MSEC 1000
+
+struct dp_req_queue_item {
+    struct data_provider *provider;
+    enum dp_req_class class;
+    const char *name;
+    struct timeval queued_at;
+
+    /* Either a data provider request or a background task waiting for
+     * admission. */
+    struct dp_req *dp_req;
+    struct tevent_req *admission_req;
+
+    struct dp_req_queue_item *prev;
+    struct dp_req_queue_item *next;
+};
+
 struct dp_req {
     struct data_provider *provider;
     uint32_t dp_flags;
@@ -44,6 +70,11 @@ struct dp_req {
     struct tevent_req *handler_req;
     void *request_data;
 
+    /* Scheduling. */
+    enum dp_req_class class;
+    struct dp_req_queue_item *queued;
+    bool running;
+
     /* Active request list. */
     struct dp_req *prev;
     struct dp_req *next;
@@ -81,8 +112,504 @@ static bool check_method_data(struct dp_method *method,
     return true;
 }
 
+static const char *dp_req_class_to_string(enum dp_req_class class)
+{
+    switch (class) {
+    case DP_REQ_CLASS_INTERACTIVE:
+        return "interactive";
+    case DP_REQ_CLASS_INITGROUPS:
+        return "initgroups";
+    case DP_REQ_CLASS_REFRESH:
+        return "refresh";
+    case DP_REQ_CLASS_ENUMERATION:
+        return "enumeration";
+    case DP_REQ_CLASS_SENTINEL:
+        break;
+    }
+
+    return "unknown";
+}
+
+static enum dp_req_class dp_req_get_class(struct dp_req *dp_req)
+{
+    struct dp_sudo_data *sudo_data;
+    struct dp_id_data *id_data;
+
+    switch (dp_req->method) {
+    case DPM_ACCOUNT_HANDLER:
+        id_data = talloc_get_type(dp_req->request_data, struct dp_id_data);
+        if (id_data == NULL) {
+            break;
+        }
+
+        if (id_data->filter_type == BE_FILTER_ENUM) {
+            return DP_REQ_CLASS_ENUMERATION;
+        }
+
+        if ((id_data->entry_type & BE_REQ_TYPE_MASK) == BE_REQ_INITGROUPS) {
+            return DP_REQ_CLASS_INITGROUPS;
+        }
+        break;
+    case DPM_SUDO_HANDLER:
+        sudo_data = talloc_get_type(dp_req->request_data,
+                                    struct dp_sudo_data);
+        if (sudo_data != NULL && sudo_data->type == BE_REQ_SUDO_FULL) {
+            return DP_REQ_CLASS_REFRESH;
+        }
+        break;
+    case DPM_REFRESH_ACCESS_RULES:
+        return DP_REQ_CLASS_REFRESH;
+    case DPM_AUTOFS_ENUMERATE:
+        return DP_REQ_CLASS_ENUMERATION;
+    default:
+        break;
+    }
+
+    /* Everything else is a lookup or authentication a user waits for. */
+    return DP_REQ_CLASS_INTERACTIVE;
+}
+
+static uint32_t dp_req_elapsed_msec(struct timeval *start)
+{
+    struct timeval now;
+    int64_t msec;
+
+    now = tevent_timeval_current();
+    msec = (now.tv_sec - start->tv_sec) * 1000
+           + (now.tv_usec - start->tv_usec) / 1000;
+
+    return msec > 0 ? msec : 0;
+}
+
+static bool dp_req_queue_has_slot(struct dp_req_queue *queue)
+{
+    return queue->limit == 0 || queue->num_running < queue->limit;
+}
+
+static bool dp_req_can_start(struct data_provider *provider,
+                             enum dp_req_class class)
+{
+    int i;
+
+    /* Never overtake requests of the same or higher priority
+     * that are already waiting. */
+    for (i = 0; i <= class; i++) {
+        if (provider->requests.classes[i].num_queued > 0) {
+            return false;
+        }
+    }
+
+    return dp_req_queue_has_slot(&provider->requests.classes[class]);
+}
+
+static int dp_req_queue_item_destructor(struct dp_req_queue_item *item)
+{
+    struct dp_req_queue *queue;
+
+    queue = &item->provider->requests.classes[item->class];
+
+    DLIST_REMOVE(queue->queued, item);
+    queue->num_queued--;
+
+    return 0;
+}
+
+static struct dp_req_queue_item *
+dp_req_queue_add(TALLOC_CTX *mem_ctx,
+                 struct data_provider *provider,
+                 enum dp_req_class class,
+                 const char *name)
+{
+    struct dp_req_queue_item *item;
+    struct dp_req_queue *queue;
+
+    item = talloc_zero(mem_ctx, struct dp_req_queue_item);
+    if (item == NULL) {
+        return NULL;
+    }
+
+    item->provider = provider;
+    item->class = class;
+    item->name = name;
+    item->queued_at = tevent_timeval_current();
+
+    queue = &provider->requests.classes[class];
+    DLIST_ADD_END(queue->queued, item, struct dp_req_queue_item *);
+    queue->num_queued++;
+    queue->num_delayed++;
+
+    talloc_set_destructor(item, dp_req_queue_item_destructor);
+
+    DP_REQ_DEBUG(SSSDBG_TRACE_FUNC, name,
+                 "Request queued in class [%s]: %u running, %u waiting.",
+                 dp_req_class_to_string(class),
+                 queue->num_running, queue->num_queued);
+
+    return item;
+}
+
+static void dp_req_queue_remove(struct dp_req_queue_item **_item)
+{
+    struct dp_req_queue_item *item = *_item;
+    struct dp_req_queue *queue;
+    uint32_t msec;
+
+    if (item == NULL) {
+        return;
+    }
+
+    queue = &item->provider->requests.classes[item->class];
+    msec = dp_req_elapsed_msec(&item->queued_at);
+
+    queue->total_wait_msec += msec;
+    queue->max_wait_msec = MAX(queue->max_wait_msec, msec);
+
+    DP_REQ_DEBUG(msec >= DP_REQ_SLOW_QUEUE_MSEC ? SSSDBG_MINOR_FAILURE
+                                                : SSSDBG_TRACE_FUNC,
+                 item->name, "Request waited %u ms in class [%s] queue.",
+                 msec, dp_req_class_to_string(item->class));
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Class [%s]: %"PRIu64" requests started, "
+          "%"PRIu64" delayed, average delay %"PRIu64" ms, maximum %u ms\n",
+          dp_req_class_to_string(item->class), queue->num_started,
+          queue->num_delayed, queue->total_wait_msec / queue->num_delayed,
+          queue->max_wait_msec);
+
+    talloc_zfree(*_item);
+}
+
+static errno_t dp_req_enqueue(struct dp_req *dp_req)
+{
+    dp_req->queued = dp_req_queue_add(dp_req, dp_req->provider,
+                                      dp_req->class, dp_req->name);
+    if (dp_req->queued == NULL) {
+        return ENOMEM;
+    }
+
+    dp_req->queued->dp_req = dp_req;
+
+    return EOK;
+}
+
+static void dp_req_done(struct tevent_req *subreq);
+static void dp_req_admit_queued(struct dp_req_queue_item *item);
+
+static errno_t dp_req_run(struct dp_req *dp_req)
+{
+    struct dp_req_params *dp_params;
+    struct dp_req_queue *queue;
+    dp_req_send_fn send_fn;
+
+    dp_params = talloc_zero(dp_req, struct dp_req_params);
+    if (dp_params == NULL) {
+        return ENOMEM;
+    }
+
+    dp_params->ev = dp_req->provider->ev;
+    dp_params->be_ctx = dp_req->provider->be_ctx;
+    dp_params->domain = dp_req->domain;
+    dp_params->target = dp_req->target;
+    dp_params->method = dp_req->method;
+
+    send_fn = dp_req->execute->send_fn;
+    dp_req->handler_req = send_fn(dp_req, dp_req->execute->method_data,
+                                  dp_req->request_data, dp_params);
+    if (dp_req->handler_req == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(dp_req->handler_req, dp_req_done, dp_req->req);
+
+    queue = &dp_req->provider->requests.classes[dp_req->class];
+    queue->num_running++;
+    queue->num_started++;
+    dp_req->running = true;
+
+    return EOK;
+}
+
+static void dp_req_dispatch(struct tevent_context *ev,
+                            struct tevent_immediate *imm,
+                            void *private_data)
+{
+    struct data_provider *provider;
+    struct dp_req_queue *queue;
+    struct dp_req *dp_req;
+    errno_t ret;
+    int class;
+
+    provider = talloc_get_type(private_data, struct data_provider);
+
+    for (class = 0; class < DP_REQ_CLASS_SENTINEL; class++) {
+        queue = &provider->requests.classes[class];
+
+        while (queue->queued != NULL && dp_req_queue_has_slot(queue)) {
+            if (queue->queued->admission_req != NULL) {
+                dp_req_admit_queued(queue->queued);
+                continue;
+            }
+
+            dp_req = queue->queued->dp_req;
+            dp_req_queue_remove(&dp_req->queued);
+
+            ret = dp_req_run(dp_req);
+            if (ret != EOK) {
+                DP_REQ_DEBUG(SSSDBG_CRIT_FAILURE, dp_req->name,
+                             "Unable to start request [%d]: %s",
+                             ret, sss_strerror(ret));
+                tevent_req_error(dp_req->req, ret);
+            }
+        }
+
+        if (queue->queued != NULL) {
+            /* Lower priority classes wait until this queue drains. */
+            break;
+        }
+    }
+}
+
+static void dp_req_schedule_dispatch(struct data_provider *provider)
+{
+    bool queued = false;
+    int i;
+
+    if (provider->terminating) {
+        return;
+    }
+
+    for (i = 0; i < DP_REQ_CLASS_SENTINEL; i++) {
+        if (provider->requests.classes[i].num_queued > 0) {
+            queued = true;
+            break;
+        }
+    }
+
+    if (!queued) {
+        return;
+    }
+
+    if (provider->requests.dispatch_imm == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Bug: request queues are not "
+              "initialized!\n");
+        return;
+    }
+
+    tevent_schedule_immediate(provider->requests.dispatch_imm, provider->ev,
+                              dp_req_dispatch, provider);
+}
+
+static void dp_req_release(struct dp_req *dp_req)
+{
+    if (!dp_req->running) {
+        return;
+    }
+
+    dp_req->running = false;
+    dp_req->provider->requests.classes[dp_req->class].num_running--;
+
+    dp_req_schedule_dispatch(dp_req->provider);
+}
+
+struct dp_req_slot {
+    struct data_provider *provider;
+    enum dp_req_class class;
+};
+
+static int dp_req_slot_destructor(struct dp_req_slot *slot)
+{
+    slot->provider->requests.classes[slot->class].num_running--;
+    dp_req_schedule_dispatch(slot->provider);
+
+    return 0;
+}
+
+struct dp_req_admission_state {
+    struct data_provider *provider;
+    enum dp_req_class class;
+    struct dp_req_queue_item *queued;
+    struct dp_req_slot *slot;
+};
+
+static errno_t dp_req_admission_take_slot(struct dp_req_admission_state *state)
+{
+    struct dp_req_queue *queue;
+
+    state->slot = talloc_zero(state, struct dp_req_slot);
+    if (state->slot == NULL) {
+        return ENOMEM;
+    }
+
+    state->slot->provider = state->provider;
+    state->slot->class = state->class;
+
+    queue = &state->provider->requests.classes[state->class];
+    queue->num_running++;
+    queue->num_started++;
+
+    talloc_set_destructor(state->slot, dp_req_slot_destructor);
+
+    return EOK;
+}
+
+struct tevent_req *dp_req_admission_send(TALLOC_CTX *mem_ctx,
+                                         struct data_provider *provider,
+                                         enum dp_req_class class,
+                                         const char *name)
+{
+    struct dp_req_admission_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct dp_req_admission_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->provider = provider;
+    state->class = class;
+
+    if (dp_req_can_start(provider, class)) {
+        ret = dp_req_admission_take_slot(state);
+        goto immediately;
+    }
+
+    state->queued = dp_req_queue_add(state, provider, class, name);
+    if (state->queued == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    state->queued->admission_req = req;
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, provider->ev);
+
+    return req;
+}
+
+static void dp_req_admit_queued(struct dp_req_queue_item *item)
+{
+    struct dp_req_admission_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = item->admission_req;
+    state = tevent_req_data(req, struct dp_req_admission_state);
+
+    dp_req_queue_remove(&state->queued);
+    ret = dp_req_admission_take_slot(state);
+
+    /* The task must not start while the queues are dispatched. */
+    tevent_req_defer_callback(req, state->provider->ev);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+errno_t dp_req_admission_recv(TALLOC_CTX *mem_ctx,
+                              struct tevent_req *req,
+                              struct dp_req_slot **_slot)
+{
+    struct dp_req_admission_state *state;
+
+    state = tevent_req_data(req, struct dp_req_admission_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_slot = talloc_steal(mem_ctx, state->slot);
+
+    return EOK;
+}
+
+static uint32_t dp_req_get_limit(struct be_ctx *be_ctx,
+                                 const char *option,
+                                 int default_limit)
+{
+    int limit;
+    errno_t ret;
+
+    ret = confdb_get_int(be_ctx->cdb, be_ctx->conf_path, option,
+                         default_limit, &limit);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Failed to get %s from confdb. "
+              "Will use %d.\n", option, default_limit);
+        return default_limit;
+    }
+
+    if (limit < 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Invalid value %d of %s, "
+              "will use %d.\n", limit, option, default_limit);
+        return default_limit;
+    }
+
+    return limit;
+}
+
+errno_t dp_init_request_queues(struct data_provider *provider)
+{
+    struct dp_req_queue *classes = provider->requests.classes;
+    struct be_ctx *be_ctx = provider->be_ctx;
+
+    provider->requests.dispatch_imm = tevent_create_immediate(provider);
+    if (provider->requests.dispatch_imm == NULL) {
+        return ENOMEM;
+    }
+
+    classes[DP_REQ_CLASS_INTERACTIVE].limit = DP_REQ_LIMIT_INTERACTIVE;
+    classes[DP_REQ_CLASS_INITGROUPS].limit =
+        dp_req_get_limit(be_ctx, CONFDB_DOMAIN_MAX_INITGROUPS_REQUESTS,
+                         DP_REQ_LIMIT_INITGROUPS);
+    classes[DP_REQ_CLASS_REFRESH].limit =
+        dp_req_get_limit(be_ctx, CONFDB_DOMAIN_MAX_REFRESH_REQUESTS,
+                         DP_REQ_LIMIT_REFRESH);
+    classes[DP_REQ_CLASS_ENUMERATION].limit =
+        dp_req_get_limit(be_ctx, CONFDB_DOMAIN_MAX_ENUMERATION_REQUESTS,
+                         DP_REQ_LIMIT_ENUMERATION);
+
+    DEBUG(SSSDBG_CONF_SETTINGS, "Request limits: initgroups %u, "
+          "refresh %u, enumeration %u\n",
+          classes[DP_REQ_CLASS_INITGROUPS].limit,
+          classes[DP_REQ_CLASS_REFRESH].limit,
+          classes[DP_REQ_CLASS_ENUMERATION].limit);
+
+    return EOK;
+}
+
+bool dp_req_user_requests_pending(struct data_provider *provider)
+{
+    struct dp_req_queue *queue;
+    int i;
+
+    if (provider == NULL) {
+        return false;
+    }
+
+    for (i = DP_REQ_CLASS_INTERACTIVE; i <= DP_REQ_CLASS_INITGROUPS; i++) {
+        queue = &provider->requests.classes[i];
+        if (queue->num_running > 0 || queue->num_queued > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 static int dp_req_destructor(struct dp_req *dp_req)
 {
+    talloc_zfree(dp_req->queued);
+    dp_req_release(dp_req);
+
     DLIST_REMOVE(dp_req->provider->requests.active, dp_req);
 
     if (dp_req->provider->requests.num_active == 0) {
@@ -199,8 +726,6 @@ file_dp_request(TALLOC_CTX *mem_ctx,
                 struct tevent_req *req,
                 struct dp_req **_dp_req)
 {
-    struct dp_req_params *dp_params;
-    dp_req_send_fn send_fn;
     struct dp_req *dp_req;
     struct be_ctx *be_ctx;
     errno_t ret;
@@ -232,32 +757,16 @@ file_dp_request(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
-    /* File request */
-
-    dp_params = talloc_zero(dp_req, struct dp_req_params);
-    if (dp_params == NULL) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    dp_params->ev = provider->ev;
-    dp_params->be_ctx = be_ctx;
-    dp_params->domain = dp_req->domain;
-    dp_params->target = dp_req->target;
-    dp_params->method = dp_req->method;
+    /* File request, background requests wait until there is a free slot
+     * in their class. */
 
-    send_fn = dp_req->execute->send_fn;
-    dp_req->handler_req = send_fn(dp_req, dp_req->execute->method_data,
-                                  dp_req->request_data, dp_params);
-    if (dp_req->handler_req == NULL) {
-        ret = ENOMEM;
-        goto done;
+    dp_req->class = dp_req_get_class(dp_req);
+    if (dp_req_can_start(provider, dp_req->class)) {
+        ret = dp_req_run(dp_req);
+    } else {
+        ret = dp_req_enqueue(dp_req);
     }
 
-    *_dp_req = dp_req;
-
-    ret = EOK;
-
 done:
     return ret;
 }
@@ -268,8 +777,6 @@ struct dp_req_state {
     void *output_data;
 };
 
-static void dp_req_done(struct tevent_req *subreq);
-
 struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
                                struct data_provider *provider,
                                const char *domain,
@@ -329,8 +836,6 @@ struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
 
     talloc_set_name_const(state->output_data, dp_req->execute->output_dtype);
 
-    tevent_req_set_callback(dp_req->handler_req, dp_req_done, req);
-
     return req;
 
 immediately:
@@ -358,6 +863,7 @@ static void dp_req_done(struct tevent_req *subreq)
     /* subreq is the same as dp_req->handler_req */
     talloc_zfree(subreq);
     state->dp_req->handler_req = NULL;
+    dp_req_release(state->dp_req);
 
     PROBE(DP_REQ_DONE, state->dp_req->name, state->dp_req->target,
           state->dp_req->method, ret, sss_strerror(ret));
@@ -406,6 +912,14 @@ errno_t _dp_req_recv(TALLOC_CTX *mem_ctx,
 
 static void dp_terminate_request(struct dp_req *dp_req)
 {
+    if (dp_req->queued != NULL) {
+        /* The handler was not started yet. */
+        DP_REQ_DEBUG(SSSDBG_TRACE_ALL, dp_req->name, "Terminating queued.");
+        talloc_zfree(dp_req->queued);
+        tevent_req_error(dp_req->req, ERR_TERMINATED);
+        return;
+    }
+
     if (dp_req->handler_req == NULL) {
         /* This may occur when the handler already finished but the caller
          * of dp request did not yet received data/free dp_req. We just
@@ -418,6 +932,7 @@ static void dp_terminate_request(struct dp_req *dp_req)
     DP_REQ_DEBUG(SSSDBG_TRACE_ALL, dp_req->name, "Terminating.");
 
     talloc_zfree(dp_req->handler_req);
+    dp_req_release(dp_req);
     tevent_req_error(dp_req->req, ERR_TERMINATED);
 }
 
@@ -26,9 +26,22 @@
 #include "providers/data_provider/dp.h"
 
 struct data_provider;
+struct dp_req_slot;
 enum dp_targets;
 enum dp_methods;
 
+/* Scheduling classes of data provider requests, ordered from the highest
+ * priority. A request of lower class is not started as long as there is
+ * a queued request of higher class. */
+enum dp_req_class {
+    DP_REQ_CLASS_INTERACTIVE,
+    DP_REQ_CLASS_INITGROUPS,
+    DP_REQ_CLASS_REFRESH,
+    DP_REQ_CLASS_ENUMERATION,
+
+    DP_REQ_CLASS_SENTINEL
+};
+
 struct tevent_req *dp_req_send(TALLOC_CTX *mem_ctx,
                                struct data_provider *provider,
                                const char *domain,
@@ -81,4 +94,24 @@ errno_t _dp_req_recv(TALLOC_CTX *mem_ctx,
 #define dp_req_recv_no_output(req) \
     _dp_req_recv(req, req, "dp_no_output", NULL)
 
+/**
+ * Background tasks which do not run through dp_req_send() wait here for
+ * a free slot of their class, so they are scheduled together with the
+ * data provider requests. The slot is held until it is freed.
+ *
+ * @example
+ *     struct dp_req_slot *slot;
+ *     ret = dp_req_admission_recv(state, req, &slot);
+ *     ...
+ *     talloc_free(slot);
+ */
+struct tevent_req *dp_req_admission_send(TALLOC_CTX *mem_ctx,
+                                         struct data_provider *provider,
+                                         enum dp_req_class class,
+                                         const char *name);
+
+errno_t dp_req_admission_recv(TALLOC_CTX *mem_ctx,
+                              struct tevent_req *req,
+                              struct dp_req_slot **_slot);
+
 #endif /* _DP_REQUEST_H_ */
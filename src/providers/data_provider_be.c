@@ -45,6 +45,7 @@
 #include "providers/be_refresh.h"
 #include "providers/be_ptask.h"
 #include "util/child_common.h"
+#include "util/s3crypt_pool.h"
 #include "resolv/async_resolv.h"
 #include "sss_iface/sss_iface_async.h"
 
@@ -561,6 +562,16 @@ errno_t be_process_init(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    if (be_ctx->domain->cache_credentials) {
+        ret = s3crypt_pool_init(be_ctx, be_ctx->ev, 0, &be_ctx->crypt_pool);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to start password hashing "
+                  "threads [%d]: %s. Passwords will be hashed in the main "
+                  "loop.\n", ret, sss_strerror(ret));
+            be_ctx->crypt_pool = NULL;
+        }
+    }
+
     req = dp_init_send(be_ctx, be_ctx->ev, be_ctx, be_ctx->uid, be_ctx->gid);
     if (req == NULL) {
         ret = ENOMEM;
@@ -445,6 +445,8 @@ static void ipa_fetch_hbac_rules_done(struct tevent_req *subreq)
 
     if (found == false) {
         /* No rules were found that apply to this host. */
+        talloc_zfree(state->access_ctx->compiled_rules);
+        state->access_ctx->rules_generation++;
         ret = ipa_common_purge_rules(state->be_ctx->domain,
                                      HBAC_RULES_SUBDIR);
         if (ret != EOK) {
@@ -459,6 +461,8 @@ static void ipa_fetch_hbac_rules_done(struct tevent_req *subreq)
     ret = ipa_common_save_rules(state->be_ctx->domain,
                                 state->hosts, state->services, state->rules,
                                 &state->access_ctx->last_update);
+    /* Bumped even if saving failed, the cache may be partially updated */
+    state->access_ctx->rules_generation++;
 
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Unable to save HBAC rules\n");
@@ -483,28 +487,31 @@ static errno_t ipa_fetch_hbac_recv(struct tevent_req *req)
     return EOK;
 }
 
-errno_t ipa_hbac_evaluate_rules(struct be_ctx *be_ctx,
-                                struct dp_option *ipa_options,
-                                struct pam_data *pd)
+/* The HBAC rules in the cache only change when they are saved after a
+ * refresh, so their hosts and services are converted and indexed once per
+ * refresh instead of on every access check. */
+static errno_t
+ipa_hbac_get_compiled_rules(struct ipa_access_ctx *access_ctx,
+                            struct hbac_ctx *hbac_ctx,
+                            struct ipa_hbac_compiled_rules **_compiled)
 {
     TALLOC_CTX *tmp_ctx;
-    struct hbac_ctx hbac_ctx;
-    struct hbac_rule **hbac_rules;
-    struct hbac_eval_req *eval_req;
-    enum hbac_eval_result result;
-    struct hbac_info *info = NULL;
+    struct ipa_hbac_compiled_rules *compiled;
     const char **attrs_get_cached_rules;
     errno_t ret;
 
+    if (access_ctx->compiled_rules != NULL
+            && access_ctx->compiled_rules->generation
+                    == access_ctx->rules_generation) {
+        *_compiled = access_ctx->compiled_rules;
+        return EOK;
+    }
+
     tmp_ctx = talloc_new(NULL);
     if (tmp_ctx == NULL) {
         return ENOMEM;
     }
 
-    hbac_ctx.be_ctx = be_ctx;
-    hbac_ctx.ipa_options = ipa_options;
-    hbac_ctx.pd = pd;
-
     /* Get HBAC rules from the sysdb */
     attrs_get_cached_rules = hbac_get_attrs_to_get_cached_rules(tmp_ctx);
     if (attrs_get_cached_rules == NULL) {
@@ -513,29 +520,83 @@ errno_t ipa_hbac_evaluate_rules(struct be_ctx *be_ctx,
         ret = ENOMEM;
         goto done;
     }
-    ret = ipa_common_get_cached_rules(tmp_ctx, be_ctx->domain,
+    ret = ipa_common_get_cached_rules(tmp_ctx, hbac_ctx->be_ctx->domain,
                                       IPA_HBAC_RULE, HBAC_RULES_SUBDIR,
                                       attrs_get_cached_rules,
-                                      &hbac_ctx.rule_count, &hbac_ctx.rules);
+                                      &hbac_ctx->rule_count, &hbac_ctx->rules);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Could not retrieve rules from the cache\n");
         goto done;
     }
 
-    ret = hbac_ctx_to_rules(tmp_ctx, &hbac_ctx, &hbac_rules, &eval_req);
-    if (ret == EPERM) {
+    ret = hbac_compile_ctx_rules(tmp_ctx, hbac_ctx, &compiled);
+    if (ret != EOK) {
+        goto done;
+    }
+    compiled->generation = access_ctx->rules_generation;
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Compiled %zu HBAC rules\n",
+          hbac_ctx->rule_count);
+
+    talloc_free(access_ctx->compiled_rules);
+    access_ctx->compiled_rules = talloc_steal(access_ctx, compiled);
+    *_compiled = compiled;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t ipa_hbac_evaluate_rules(struct be_ctx *be_ctx,
+                                       struct ipa_access_ctx *access_ctx,
+                                       struct pam_data *pd)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct hbac_ctx hbac_ctx;
+    struct ipa_hbac_compiled_rules *compiled;
+    struct hbac_eval_req *eval_req;
+    enum hbac_eval_result result;
+    struct hbac_info *info = NULL;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    hbac_ctx.be_ctx = be_ctx;
+    hbac_ctx.ipa_options = access_ctx->ipa_options;
+    hbac_ctx.pd = pd;
+    hbac_ctx.rule_count = 0;
+    hbac_ctx.rules = NULL;
+
+    hbac_enable_debug(hbac_debug_messages);
+
+    ret = ipa_hbac_get_compiled_rules(access_ctx, &hbac_ctx, &compiled);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (compiled->deny_rules) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "DENY rules detected. Denying access to all users\n");
         ret = ERR_ACCESS_DENIED;
         goto done;
-    } else if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct HBAC rules\n");
+    }
+
+    ret = hbac_ctx_to_eval_request(tmp_ctx, &hbac_ctx, &eval_req);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct eval request\n");
         goto done;
     }
 
-    hbac_enable_debug(hbac_debug_messages);
+    ret = hbac_evaluate_compiled_rules(compiled, be_ctx->domain, eval_req,
+                                       &result, &info);
+    if (ret != EOK) {
+        goto done;
+    }
 
-    result = hbac_evaluate(hbac_rules, eval_req, &info);
     if (result == HBAC_EVAL_ALLOW) {
         DEBUG(SSSDBG_MINOR_FAILURE, "Access granted by HBAC rule [%s]\n",
               info->rule_name);
@@ -681,8 +742,8 @@ static void ipa_pam_access_handler_done(struct tevent_req *subreq)
         goto done;
     }
 
-    ret = ipa_hbac_evaluate_rules(state->be_ctx,
-                                  state->access_ctx->ipa_options, state->pd);
+    ret = ipa_hbac_evaluate_rules(state->be_ctx, state->access_ctx,
+                                  state->pd);
     if (ret == EOK) {
         state->pd->pam_status = PAM_SUCCESS;
     } else if (ret == ERR_ACCESS_DENIED) {
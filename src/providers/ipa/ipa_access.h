@@ -32,10 +32,16 @@ enum ipa_access_mode {
     IPA_ACCESS_ALLOW
 };
 
+struct ipa_hbac_compiled_rules;
+
 struct ipa_access_ctx {
     struct sdap_id_ctx *sdap_ctx;
     struct dp_option *ipa_options;
     time_t last_update;
+    /* Incremented every time the HBAC rules in the cache change */
+    uint64_t rules_generation;
+    /* HBAC rules compiled from the cache at rules_generation */
+    struct ipa_hbac_compiled_rules *compiled_rules;
     struct sdap_access_ctx *sdap_access_ctx;
 
     struct sdap_attr_map *host_map;
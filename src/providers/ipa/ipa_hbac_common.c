@@ -64,11 +64,6 @@ hbac_attrs_to_rule(TALLOC_CTX *mem_ctx,
                    size_t index,
                    struct hbac_rule **rule);
 
-static errno_t
-hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
-                         struct hbac_ctx *hbac_ctx,
-                         struct hbac_eval_req **request);
-
 errno_t
 hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
                   struct hbac_ctx *hbac_ctx,
@@ -81,7 +76,7 @@ hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
     size_t i;
     TALLOC_CTX *tmp_ctx = NULL;
 
-    if (!rules || !request) return EINVAL;
+    if (!rules) return EINVAL;
 
     tmp_ctx = talloc_new(mem_ctx);
     if (tmp_ctx == NULL) return ENOMEM;
@@ -106,18 +101,140 @@ hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
     }
     new_rules[i] = NULL;
 
-    /* Create the eval request */
-    ret = hbac_ctx_to_eval_request(tmp_ctx, hbac_ctx, &new_request);
+    /* Create the eval request, unless the caller only needs the rules */
+    if (request != NULL) {
+        ret = hbac_ctx_to_eval_request(tmp_ctx, hbac_ctx, &new_request);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct eval request\n");
+            goto done;
+        }
+        *request = talloc_steal(mem_ctx, new_request);
+    }
+
+    *rules = talloc_steal(mem_ctx, new_rules);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int
+hbac_compiled_rules_destructor(struct ipa_hbac_compiled_rules *compiled)
+{
+    hbac_free_rule_set(compiled->rule_set);
+    return 0;
+}
+
+errno_t
+hbac_compile_ctx_rules(TALLOC_CTX *mem_ctx,
+                       struct hbac_ctx *hbac_ctx,
+                       struct ipa_hbac_compiled_rules **_compiled)
+{
+    struct ipa_hbac_compiled_rules *compiled;
+    enum hbac_error_code hret;
+    size_t i;
+    errno_t ret;
+
+    compiled = talloc_zero(mem_ctx, struct ipa_hbac_compiled_rules);
+    if (compiled == NULL) {
+        return ENOMEM;
+    }
+    talloc_set_destructor(compiled, hbac_compiled_rules_destructor);
+
+    ret = hbac_ctx_to_rules(compiled, hbac_ctx, &compiled->rules, NULL);
+    if (ret == EPERM) {
+        compiled->deny_rules = true;
+        *_compiled = compiled;
+        return EOK;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct HBAC rules\n");
+        goto done;
+    }
+
+    hret = hbac_compile_rules(compiled->rules, &compiled->rule_set);
+    if (hret != HBAC_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not compile HBAC rules [%s]\n",
+              hbac_error_string(hret));
+        ret = hret == HBAC_ERROR_OUT_OF_MEMORY ? ENOMEM : EINVAL;
+        goto done;
+    }
+
+    /* The user elements are not indexed, they are resolved again for every
+     * request by hbac_evaluate_compiled_rules(). */
+    for (i = 0; i < hbac_ctx->rule_count; i++) {
+        talloc_zfree(compiled->rules[i]->users);
+    }
+
+    compiled->rule_count = hbac_ctx->rule_count;
+    compiled->rule_attrs = talloc_steal(compiled, hbac_ctx->rules);
+
+    *_compiled = compiled;
+    ret = EOK;
+
+done:
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Could not construct eval request\n");
+        talloc_free(compiled);
+    }
+    return ret;
+}
+
+errno_t
+hbac_evaluate_compiled_rules(struct ipa_hbac_compiled_rules *compiled,
+                             struct sss_domain_info *domain,
+                             struct hbac_eval_req *eval_req,
+                             enum hbac_eval_result *_result,
+                             struct hbac_info **_info)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct hbac_rule *rule;
+    enum hbac_error_code hret;
+    size_t *candidates = NULL;
+    size_t num_candidates = 0;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    /* Only the rules that match the service and the target host are
+     * evaluated, the members of the other rules are not looked up. */
+    hret = hbac_rule_set_get_candidates(compiled->rule_set, eval_req,
+                                        &candidates, &num_candidates);
+    if (hret != HBAC_SUCCESS) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Could not select HBAC rules [%s]\n",
+              hbac_error_string(hret));
+        ret = hret == HBAC_ERROR_OUT_OF_MEMORY ? ENOMEM : EINVAL;
         goto done;
     }
 
-    *rules = talloc_steal(mem_ctx, new_rules);
-    *request = talloc_steal(mem_ctx, new_request);
+    for (i = 0; i < num_candidates; i++) {
+        rule = compiled->rules[candidates[i]];
+
+        ret = hbac_user_attrs_to_rule(tmp_ctx, domain, rule->name,
+                                      compiled->rule_attrs[candidates[i]],
+                                      &rule->users);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Could not parse users for rule [%s]\n", rule->name);
+            goto done;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Resolved users of %zu of %zu HBAC rules\n",
+          num_candidates, compiled->rule_count);
+
+    *_result = hbac_evaluate_rule_set(compiled->rule_set, eval_req, _info);
     ret = EOK;
 
 done:
+    /* The user elements belong to this request only */
+    for (i = 0; i < num_candidates; i++) {
+        compiled->rules[candidates[i]]->users = NULL;
+    }
+    free(candidates);
     talloc_free(tmp_ctx);
     return ret;
 }
@@ -282,7 +399,7 @@ hbac_eval_host_element(TALLOC_CTX *mem_ctx,
                        const char *hostname,
                        struct hbac_request_element **host_element);
 
-static errno_t
+errno_t
 hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
                          struct hbac_ctx *hbac_ctx,
                          struct hbac_eval_req **request)
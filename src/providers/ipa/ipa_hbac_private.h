@@ -59,11 +59,44 @@ replace_attribute_name(const char *old_name,
                        const char *new_name, const size_t count,
                        struct sysdb_attrs **list);
 
+/* The eval request is only created if request is not NULL */
 errno_t hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
                           struct hbac_ctx *hbac_ctx,
                           struct hbac_rule ***rules,
                           struct hbac_eval_req **request);
 
+errno_t
+hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
+                         struct hbac_ctx *hbac_ctx,
+                         struct hbac_eval_req **request);
+
+/* HBAC rules converted and indexed once per rule refresh. Only the service
+ * and host elements are kept, members of the user element are resolved
+ * against the cache on every evaluation, for the rules that can match the
+ * request only, because users and groups may be cached after the rules were
+ * compiled. */
+struct ipa_hbac_compiled_rules {
+    uint64_t generation;
+    /* The cached rules contain DENY rules */
+    bool deny_rules;
+    size_t rule_count;
+    struct sysdb_attrs **rule_attrs;
+    struct hbac_rule **rules;
+    struct hbac_rule_set *rule_set;
+};
+
+errno_t
+hbac_compile_ctx_rules(TALLOC_CTX *mem_ctx,
+                       struct hbac_ctx *hbac_ctx,
+                       struct ipa_hbac_compiled_rules **_compiled);
+
+errno_t
+hbac_evaluate_compiled_rules(struct ipa_hbac_compiled_rules *compiled,
+                             struct sss_domain_info *domain,
+                             struct hbac_eval_req *eval_req,
+                             enum hbac_eval_result *_result,
+                             struct hbac_info **_info);
+
 errno_t
 hbac_get_category(struct sysdb_attrs *attrs,
                   const char *category_attr,
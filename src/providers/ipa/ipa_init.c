@@ -800,6 +800,7 @@ errno_t sssm_ipa_selinux_init(TALLOC_CTX *mem_ctx,
     struct ipa_selinux_ctx *selinux_ctx;
     struct ipa_init_ctx *init_ctx;
     struct ipa_options *opts;
+    errno_t ret;
 
     init_ctx = talloc_get_type(module_data, struct ipa_init_ctx);
     opts = init_ctx->options;
@@ -815,6 +816,13 @@ errno_t sssm_ipa_selinux_init(TALLOC_CTX *mem_ctx,
     selinux_ctx->host_search_bases = opts->id->sdom->host_search_bases;
     selinux_ctx->selinux_search_bases = opts->selinux_search_bases;
 
+    ret = sss_hash_create(selinux_ctx, 0, &selinux_ctx->user_labels);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "sss_hash_create() failed.\n");
+        talloc_free(selinux_ctx);
+        return ret;
+    }
+
     dp_set_method(dp_methods, DPM_SELINUX_HANDLER,
                   ipa_selinux_handler_send, ipa_selinux_handler_recv, selinux_ctx,
                   struct ipa_selinux_ctx, struct pam_data, struct pam_data *);
@@ -51,6 +51,7 @@ struct dp_option ipa_basic_opts[] = {
     { "ipa_deskprofile_search_base", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "ipa_deskprofile_refresh", DP_OPT_NUMBER, { .number = 5 }, NULL_NUMBER },
     { "ipa_deskprofile_request_interval", DP_OPT_NUMBER, { .number = 60 }, NULL_NUMBER },
+    { "ipa_extdom_max_in_flight", DP_OPT_NUMBER, { .number = 8 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -168,6 +169,8 @@ struct dp_option ipa_def_ldap_opts[] = {
     { "ldap_pwdlockout_dn", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "wildcard_limit", DP_OPT_NUMBER, { .number = 1000 }, NULL_NUMBER},
     { "ldap_library_debug_level", DP_OPT_NUMBER, NULL_NUMBER, NULL_NUMBER},
+    { "ldap_nested_group_batch_size", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
+    { "ldap_nested_group_cache_timeout", DP_OPT_NUMBER, { .number = 60 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -328,6 +331,10 @@ struct dp_option ipa_def_krb5_opts[] = {
     { "krb5_use_kdcinfo", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
     { "krb5_kdcinfo_lookahead", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "krb5_map_user", DP_OPT_STRING, NULL_STRING, NULL_STRING },
+    { "krb5_child_pool_size", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "krb5_child_pool_max_requests", DP_OPT_NUMBER, { .number = 100 }, NULL_NUMBER },
+    { "krb5_renew_threshold", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
+    { "krb5_renew_max_parallel", DP_OPT_NUMBER, { .number = 10 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -1170,29 +1170,45 @@ static const char *ipa_s2n_reqinp2str(TALLOC_CTX *mem_ctx,
     return str;
 }
 
+/* The objects of the list are requested concurrently on the connection,
+ * at most max_in_flight extdom requests at a time, and each object is saved
+ * as soon as its reply arrives. */
 struct ipa_s2n_get_list_state {
     struct tevent_context *ev;
     struct ipa_id_ctx *ipa_ctx;
     struct sss_domain_info *dom;
     struct sdap_handle *sh;
     enum extdom_protocol protocol;
-    struct req_input req_input;
+    enum req_input_type list_type;
     char **list;
     size_t list_idx;
     int exop_timeout;
     int entry_type;
     enum request_types request_type;
+    struct sysdb_attrs *mapped_attrs;
+
+    int max_in_flight;
+    int num_in_flight;
+    errno_t error;
+};
+
+struct ipa_s2n_get_list_item {
+    struct tevent_req *req;
+    const char *name;
+    struct req_input req_input;
     struct resp_attrs *attrs;
     struct sss_domain_info *obj_domain;
     struct sysdb_attrs *override_attrs;
-    struct sysdb_attrs *mapped_attrs;
 };
 
-static errno_t ipa_s2n_get_list_step(struct tevent_req *req);
+static errno_t ipa_s2n_get_list_fill(struct tevent_req *req);
+static errno_t ipa_s2n_get_list_step(struct ipa_s2n_get_list_item *item);
 static void ipa_s2n_get_list_get_override_done(struct tevent_req *subreq);
 static void ipa_s2n_get_list_next(struct tevent_req *subreq);
 static void ipa_s2n_get_list_ipa_next(struct tevent_req *subreq);
-static errno_t ipa_s2n_get_list_save_step(struct tevent_req *req);
+static errno_t ipa_s2n_get_list_save_step(struct ipa_s2n_get_list_item *item);
+static void ipa_s2n_get_list_item_done(struct ipa_s2n_get_list_item *item,
+                                       errno_t ret);
 
 static struct tevent_req *ipa_s2n_get_list_send(TALLOC_CTX *mem_ctx,
                                                 struct tevent_context *ev,
@@ -1228,23 +1244,42 @@ static struct tevent_req *ipa_s2n_get_list_send(TALLOC_CTX *mem_ctx,
     state->dom = dom;
     state->sh = sh;
     state->protocol = extdom_preferred_protocol(sh);
+    state->list_type = list_type;
     state->list = list;
     state->list_idx = 0;
-    state->req_input.type = list_type;
-    state->req_input.inp.name = NULL;
     state->exop_timeout = exop_timeout;
     state->entry_type = entry_type;
     state->request_type = request_type;
-    state->attrs = NULL;
-    state->override_attrs = NULL;
     state->mapped_attrs = mapped_attrs;
+    state->num_in_flight = 0;
+    state->error = EOK;
+
+    state->max_in_flight = dp_opt_get_int(ipa_ctx->ipa_options->basic,
+                                          IPA_EXTDOM_MAX_IN_FLIGHT);
+    if (state->max_in_flight < 1) {
+        state->max_in_flight = 1;
+    }
+
+    if (state->request_type == REQ_FULL_WITH_MEMBERS
+            && state->protocol == EXTDOM_V0) {
+        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_exop failed, protocol > V0 needed "
+                                 "for this request.\n");
+        ret = EINVAL;
+        goto done;
+    }
 
-    ret = ipa_s2n_get_list_step(req);
+    ret = ipa_s2n_get_list_fill(req);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
+        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_fill failed.\n");
         goto done;
     }
 
+    if (state->num_in_flight == 0) {
+        /* empty list */
+        tevent_req_done(req);
+        tevent_req_post(req, ev);
+    }
+
 done:
     if (ret != EOK) {
         tevent_req_error(req, ret);
@@ -1254,11 +1289,47 @@ done:
     return req;
 }
 
-static errno_t ipa_s2n_get_list_step(struct tevent_req *req)
+/* Starts requests for the next objects of the list until the window is
+ * full. */
+static errno_t ipa_s2n_get_list_fill(struct tevent_req *req)
 {
-    int ret;
     struct ipa_s2n_get_list_state *state = tevent_req_data(req,
                                                struct ipa_s2n_get_list_state);
+    struct ipa_s2n_get_list_item *item;
+    errno_t ret;
+
+    while (state->error == EOK
+            && state->num_in_flight < state->max_in_flight
+            && state->list[state->list_idx] != NULL) {
+        item = talloc_zero(state, struct ipa_s2n_get_list_item);
+        if (item == NULL) {
+            return ENOMEM;
+        }
+
+        item->req = req;
+        item->name = state->list[state->list_idx];
+        item->req_input.type = state->list_type;
+        item->req_input.inp.name = NULL;
+        state->list_idx++;
+
+        ret = ipa_s2n_get_list_step(item);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
+            talloc_free(item);
+            return ret;
+        }
+
+        state->num_in_flight++;
+    }
+
+    return EOK;
+}
+
+static errno_t ipa_s2n_get_list_step(struct ipa_s2n_get_list_item *item)
+{
+    int ret;
+    struct ipa_s2n_get_list_state *state = tevent_req_data(item->req,
+                                               struct ipa_s2n_get_list_state);
     struct berval *bv_req;
     struct tevent_req *subreq;
     struct sss_domain_info *parent_domain;
@@ -1269,56 +1340,56 @@ static errno_t ipa_s2n_get_list_step(struct tevent_req *req)
     struct dp_id_data *ar;
 
     parent_domain = get_domains_head(state->dom);
-    switch (state->req_input.type) {
+    switch (item->req_input.type) {
     case REQ_INP_NAME:
 
-        ret = sss_parse_name(state, state->dom->names, state->list[state->list_idx],
+        ret = sss_parse_name(item, state->dom->names, item->name,
                              &domain_name, &short_name);
         if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, "Unable to parse name '%s' [%d]: %s\n",
-                                        state->list[state->list_idx],
+                                        item->name,
                                         ret, sss_strerror(ret));
             return ret;
         }
 
         if (domain_name) {
-            state->obj_domain = find_domain_by_name(parent_domain,
-                                                    domain_name, true);
-            if (state->obj_domain == NULL) {
+            item->obj_domain = find_domain_by_name(parent_domain,
+                                                   domain_name, true);
+            if (item->obj_domain == NULL) {
                 DEBUG(SSSDBG_OP_FAILURE, "find_domain_by_name failed.\n");
                 return ENOMEM;
             }
         } else {
-            state->obj_domain = parent_domain;
+            item->obj_domain = parent_domain;
         }
 
-        state->req_input.inp.name = short_name;
+        item->req_input.inp.name = short_name;
 
-        if (strcmp(state->obj_domain->name,
+        if (strcmp(item->obj_domain->name,
             state->ipa_ctx->sdap_id_ctx->be->domain->name) == 0) {
             DEBUG(SSSDBG_TRACE_INTERNAL,
                   "Looking up IPA object [%s] from LDAP.\n",
-                  state->list[state->list_idx]);
-            ret = get_dp_id_data_for_user_name(state,
-                                               state->list[state->list_idx],
-                                               state->obj_domain->name,
+                  item->name);
+            ret = get_dp_id_data_for_user_name(item,
+                                               item->name,
+                                               item->obj_domain->name,
                                                &ar);
             if (ret != EOK) {
                 DEBUG(SSSDBG_OP_FAILURE,
                       "Failed to create lookup date for IPA object [%s].\n",
-                      state->list[state->list_idx]);
+                      item->name);
                 return ret;
             }
             ar->entry_type = state->entry_type;
 
-            subreq = ipa_id_get_account_info_send(state, state->ev,
+            subreq = ipa_id_get_account_info_send(item, state->ev,
                                                   state->ipa_ctx, ar);
             if (subreq == NULL) {
                 DEBUG(SSSDBG_OP_FAILURE,
                       "ipa_id_get_account_info_send failed.\n");
                 return ENOMEM;
             }
-            tevent_req_set_callback(subreq, ipa_s2n_get_list_ipa_next, req);
+            tevent_req_set_callback(subreq, ipa_s2n_get_list_ipa_next, item);
 
             return EOK;
         }
@@ -1326,62 +1397,56 @@ static errno_t ipa_s2n_get_list_step(struct tevent_req *req)
         break;
     case REQ_INP_ID:
         errno = 0;
-        id = strtouint32(state->list[state->list_idx], &endptr, 10);
-        if (errno != 0 || *endptr != '\0'
-                || (state->list[state->list_idx] == endptr)) {
+        id = strtouint32(item->name, &endptr, 10);
+        if (errno != 0 || *endptr != '\0' || (item->name == endptr)) {
             DEBUG(SSSDBG_OP_FAILURE, "strtouint32 failed.\n");
             return EINVAL;
         }
-        state->req_input.inp.id = id;
-        state->obj_domain = state->dom;
+        item->req_input.inp.id = id;
+        item->obj_domain = state->dom;
 
         break;
     case REQ_INP_SECID:
-        state->req_input.inp.secid = state->list[state->list_idx];
-        state->obj_domain = find_domain_by_sid(parent_domain,
-                                               state->req_input.inp.secid);
-        if (state->obj_domain == NULL) {
+        item->req_input.inp.secid = item->name;
+        item->obj_domain = find_domain_by_sid(parent_domain,
+                                              item->req_input.inp.secid);
+        if (item->obj_domain == NULL) {
             DEBUG(SSSDBG_OP_FAILURE,
                   "find_domain_by_sid failed for SID [%s].\n",
-                  state->req_input.inp.secid);
+                  item->req_input.inp.secid);
             return EINVAL;
         }
 
         break;
     default:
         DEBUG(SSSDBG_OP_FAILURE, "Unexpected input type [%d].\n",
-                                 state->req_input.type);
+                                 item->req_input.type);
         return EINVAL;
     }
 
-    ret = s2n_encode_request(state, state->obj_domain->name, state->entry_type,
-                             state->request_type, &state->req_input,
+    ret = s2n_encode_request(item, item->obj_domain->name, state->entry_type,
+                             state->request_type, &item->req_input,
                              state->protocol, &bv_req);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "s2n_encode_request failed.\n");
         return ret;
     }
 
-    if (state->request_type == REQ_FULL_WITH_MEMBERS && state->protocol == EXTDOM_V0) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_exop failed, protocol > V0 needed for this request.\n");
-        return EINVAL;
-    }
-
-    if (state->req_input.type == REQ_INP_NAME
-            && state->req_input.inp.name != NULL) {
+    if (item->req_input.type == REQ_INP_NAME
+            && item->req_input.inp.name != NULL) {
         DEBUG(SSSDBG_TRACE_FUNC,
               "Sending request_type: [%s] for object [%s].\n",
               ipa_s2n_reqtype2str(state->request_type),
-              state->list[state->list_idx]);
+              item->name);
     }
 
-    subreq = ipa_s2n_exop_send(state, state->ev, state->sh, state->protocol,
+    subreq = ipa_s2n_exop_send(item, state->ev, state->sh, state->protocol,
                                state->exop_timeout, bv_req);
     if (subreq == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_exop_send failed.\n");
         return ENOMEM;
     }
-    tevent_req_set_callback(subreq, ipa_s2n_get_list_next, req);
+    tevent_req_set_callback(subreq, ipa_s2n_get_list_next, item);
 
     return EOK;
 }
@@ -1389,62 +1454,54 @@ static errno_t ipa_s2n_get_list_step(struct tevent_req *req)
 static void ipa_s2n_get_list_next(struct tevent_req *subreq)
 {
     int ret;
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
-    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
+    struct ipa_s2n_get_list_item *item = tevent_req_callback_data(subreq,
+                                              struct ipa_s2n_get_list_item);
+    struct ipa_s2n_get_list_state *state = tevent_req_data(item->req,
                                                struct ipa_s2n_get_list_state);
     char *retoid = NULL;
     struct berval *retdata = NULL;
     const char *sid_str;
     struct dp_id_data *ar;
 
-    ret = ipa_s2n_exop_recv(subreq, state, &retoid, &retdata);
+    ret = ipa_s2n_exop_recv(subreq, item, &retoid, &retdata);
     talloc_zfree(subreq);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "s2n exop request failed.\n");
-        goto fail;
+        goto done;
     }
 
-    talloc_zfree(state->attrs);
-    ret = s2n_response_to_attrs(state, state->dom, retoid, retdata,
-                                &state->attrs);
+    ret = s2n_response_to_attrs(item, state->dom, retoid, retdata,
+                                &item->attrs);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "s2n_response_to_attrs failed.\n");
-        goto fail;
+        goto done;
     }
 
     DEBUG(SSSDBG_TRACE_FUNC, "Received [%s] attributes from IPA server.\n",
-                             state->attrs->a.name);
+                             item->attrs->a.name);
 
     if (is_default_view(state->ipa_ctx->view_name)) {
-        ret = ipa_s2n_get_list_save_step(req);
-        if (ret == EOK) {
-            tevent_req_done(req);
-        } else if (ret != EAGAIN) {
-            DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_save_step failed.\n");
-            goto fail;
-        }
-
-        return;
+        ret = ipa_s2n_get_list_save_step(item);
+        goto done;
     }
 
-    ret = sysdb_attrs_get_string(state->attrs->sysdb_attrs, SYSDB_SID_STR,
+    ret = sysdb_attrs_get_string(item->attrs->sysdb_attrs, SYSDB_SID_STR,
                                  &sid_str);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               "Object [%s] has no SID, please check the "
               "ipaNTSecurityIdentifier attribute on the server-side",
-              state->attrs->a.name);
-        goto fail;
+              item->attrs->a.name);
+        goto done;
     }
 
-    ret = get_dp_id_data_for_sid(state, sid_str, state->obj_domain->name, &ar);
+    ret = get_dp_id_data_for_sid(item, sid_str, item->obj_domain->name, &ar);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "get_dp_id_data_for_sid failed.\n");
-        goto fail;
+        goto done;
     }
 
-    subreq = ipa_get_ad_override_send(state, state->ev,
+    subreq = ipa_get_ad_override_send(item, state->ev,
                            state->ipa_ctx->sdap_id_ctx,
                            state->ipa_ctx->ipa_options,
                            dp_opt_get_string(state->ipa_ctx->ipa_options->basic,
@@ -1454,110 +1511,101 @@ static void ipa_s2n_get_list_next(struct tevent_req *subreq)
     if (subreq == NULL) {
         DEBUG(SSSDBG_OP_FAILURE, "ipa_get_ad_override_send failed.\n");
         ret = ENOMEM;
-        goto fail;
+        goto done;
     }
-    tevent_req_set_callback(subreq, ipa_s2n_get_list_get_override_done, req);
+    tevent_req_set_callback(subreq, ipa_s2n_get_list_get_override_done, item);
 
     return;
 
-fail:
-    tevent_req_error(req,ret);
-    return;
+done:
+    ipa_s2n_get_list_item_done(item, ret);
 }
 
 static void ipa_s2n_get_list_ipa_next(struct tevent_req *subreq)
 {
     int ret;
     int dp_error;
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
-    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
-                                               struct ipa_s2n_get_list_state);
+    struct ipa_s2n_get_list_item *item = tevent_req_callback_data(subreq,
+                                              struct ipa_s2n_get_list_item);
 
     ret = ipa_id_get_account_info_recv(subreq, &dp_error);
     talloc_zfree(subreq);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "ipa_id_get_account_info failed: %d %d\n", ret,
                                  dp_error);
-        goto done;
     }
 
-    state->list_idx++;
-    if (state->list[state->list_idx] == NULL) {
-        tevent_req_done(req);
-        return;
-    }
-
-    ret = ipa_s2n_get_list_step(req);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
-        goto done;
-    }
-
-    return;
-
-done:
-    tevent_req_error(req,ret);
-    return;
+    ipa_s2n_get_list_item_done(item, ret);
 }
 
 static void ipa_s2n_get_list_get_override_done(struct tevent_req *subreq)
 {
     int ret;
-    struct tevent_req *req = tevent_req_callback_data(subreq,
-                                                      struct tevent_req);
-    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
-                                               struct ipa_s2n_get_list_state);
+    struct ipa_s2n_get_list_item *item = tevent_req_callback_data(subreq,
+                                              struct ipa_s2n_get_list_item);
 
-    ret = ipa_get_ad_override_recv(subreq, NULL, state, &state->override_attrs);
+    ret = ipa_get_ad_override_recv(subreq, NULL, item, &item->override_attrs);
     talloc_zfree(subreq);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "IPA override lookup failed: %d\n", ret);
-        goto fail;
-    }
-
-    ret = ipa_s2n_get_list_save_step(req);
-    if (ret == EOK) {
-        tevent_req_done(req);
-    } else if (ret != EAGAIN) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_save_step failed.\n");
-        goto fail;
+        goto done;
     }
 
-    return;
+    ret = ipa_s2n_get_list_save_step(item);
 
-fail:
-    tevent_req_error(req,ret);
-    return;
+done:
+    ipa_s2n_get_list_item_done(item, ret);
 }
 
-static errno_t ipa_s2n_get_list_save_step(struct tevent_req *req)
+static errno_t ipa_s2n_get_list_save_step(struct ipa_s2n_get_list_item *item)
 {
     int ret;
-    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
+    struct ipa_s2n_get_list_state *state = tevent_req_data(item->req,
                                                struct ipa_s2n_get_list_state);
 
-    ret = ipa_s2n_save_objects(state->dom, &state->req_input, state->attrs,
+    ret = ipa_s2n_save_objects(state->dom, &item->req_input, item->attrs,
                                NULL, state->ipa_ctx->view_name,
-                               state->override_attrs, state->mapped_attrs,
+                               item->override_attrs, state->mapped_attrs,
                                false);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_save_objects failed.\n");
         return ret;
     }
 
-    state->list_idx++;
-    if (state->list[state->list_idx] == NULL) {
-        return EOK;
+    return EOK;
+}
+
+/* Called once per object of the list. After an error no new requests are
+ * started, the request fails once the pending ones have finished. */
+static void ipa_s2n_get_list_item_done(struct ipa_s2n_get_list_item *item,
+                                       errno_t ret)
+{
+    struct tevent_req *req = item->req;
+    struct ipa_s2n_get_list_state *state = tevent_req_data(req,
+                                               struct ipa_s2n_get_list_state);
+
+    talloc_free(item);
+    state->num_in_flight--;
+
+    if (ret != EOK && state->error == EOK) {
+        state->error = ret;
     }
 
-    ret = ipa_s2n_get_list_step(req);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, "ipa_s2n_get_list_step failed.\n");
-        return ret;
+    ret = ipa_s2n_get_list_fill(req);
+    if (ret != EOK && state->error == EOK) {
+        state->error = ret;
     }
 
-    return EAGAIN;
+    if (state->num_in_flight > 0) {
+        return;
+    }
+
+    if (state->error != EOK) {
+        tevent_req_error(req, state->error);
+        return;
+    }
+
+    tevent_req_done(req);
 }
 
 static int ipa_s2n_get_list_recv(struct tevent_req *req)
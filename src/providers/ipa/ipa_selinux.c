@@ -35,6 +35,7 @@
 #include "providers/ipa/ipa_hbac_private.h"
 #include "providers/ipa/ipa_access.h"
 #include "providers/ipa/ipa_selinux_maps.h"
+#include "providers/ipa/ipa_selinux_labels.h"
 #include "providers/ipa/ipa_subdomains.h"
 #include "providers/ipa/ipa_rules_common.h"
 
@@ -1513,6 +1514,7 @@ struct ipa_selinux_handler_state {
 
     struct sysdb_attrs *user;
     struct sysdb_attrs *host;
+    struct selinux_child_input *sci;
 };
 
 static void ipa_selinux_handler_get_done(struct tevent_req *subreq);
@@ -1621,6 +1623,23 @@ static void ipa_selinux_handler_get_done(struct tevent_req *subreq)
               ret, sss_strerror(ret));
         goto done;
     }
+    state->sci = sci;
+
+    /* The rules still resolve to the label set at the previous login, the
+     * fork of selinux_child and the semanage transaction can be skipped. */
+    if (ipa_selinux_label_is_set(state->selinux_ctx->user_labels,
+                                 sci->username, sci->seuser,
+                                 sci->mls_range)) {
+        DEBUG(SSSDBG_TRACE_FUNC, "SELinux label of [%s] is unchanged\n",
+              sci->username);
+
+        if (!be_is_offline(state->be_ctx)) {
+            state->selinux_ctx->last_update = time(NULL);
+        }
+
+        state->pd->pam_status = PAM_SUCCESS;
+        goto done;
+    }
 
     /* Update the SELinux context in a privileged child as the back end is
      * running unprivileged
@@ -1649,10 +1668,16 @@ static void ipa_selinux_handler_done(struct tevent_req *subreq)
     ret = selinux_child_recv(subreq);
     talloc_free(subreq);
     if (ret != EOK) {
+        ipa_selinux_label_remove(state->selinux_ctx->user_labels,
+                                 state->sci->username);
         state->pd->pam_status = PAM_SYSTEM_ERR;
         goto done;
     }
 
+    ipa_selinux_label_store(state->selinux_ctx->user_labels,
+                            state->sci->username, state->sci->seuser,
+                            state->sci->mls_range);
+
     if (!be_is_offline(state->be_ctx)) {
         state->selinux_ctx->last_update = time(NULL);
     }
@@ -34,6 +34,9 @@ struct ipa_selinux_ctx {
     struct sdap_search_base **selinux_search_bases;
     struct sdap_search_base **host_search_bases;
     struct sdap_search_base **hbac_search_bases;
+
+    /* The SELinux label last set for each user, "seuser:mls_range" */
+    hash_table_t *user_labels;
 };
 
 struct tevent_req *
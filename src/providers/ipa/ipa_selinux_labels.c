@@ -0,0 +1,179 @@
+/*
+    SSSD
+
+    IPA Backend Module -- SELinux labels set for the users
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <selinux/selinux.h>
+
+#include "providers/ipa/ipa_selinux_labels.h"
+
+#define SELINUX_DEFAULT_LOGIN "__default__"
+
+static char *ipa_selinux_label(TALLOC_CTX *mem_ctx,
+                               const char *seuser,
+                               const char *mls_range)
+{
+    return talloc_asprintf(mem_ctx, "%s:%s", seuser, mls_range);
+}
+
+static bool ipa_selinux_str_equal(const char *a, const char *b)
+{
+    return strcmp(a == NULL ? "" : a, b == NULL ? "" : b) == 0;
+}
+
+/* The login mapping can be changed on the host without SSSD, e.g. with
+ * semanage, so the system must still map the user to the label. */
+static bool ipa_selinux_label_in_system(const char *username,
+                                        const char *seuser,
+                                        const char *mls_range)
+{
+    char *sys_seuser = NULL;
+    char *sys_level = NULL;
+    char *def_seuser = NULL;
+    char *def_level = NULL;
+    bool matches = false;
+    int ret;
+
+    ret = getseuserbyname(username, &sys_seuser, &sys_level);
+    if (ret != 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "getseuserbyname() failed for [%s]\n",
+              username);
+        goto done;
+    }
+
+    if (*seuser != '\0') {
+        matches = ipa_selinux_str_equal(sys_seuser, seuser)
+                      && ipa_selinux_str_equal(sys_level, mls_range);
+        goto done;
+    }
+
+    /* An empty SELinux user means the user has no mapping of its own and
+     * the system default applies. */
+    ret = getseuserbyname(SELINUX_DEFAULT_LOGIN, &def_seuser, &def_level);
+    if (ret != 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "getseuserbyname() failed for the "
+              "default login\n");
+        goto done;
+    }
+
+    matches = ipa_selinux_str_equal(sys_seuser, def_seuser)
+                  && ipa_selinux_str_equal(sys_level, def_level);
+
+done:
+    free(sys_seuser);
+    free(sys_level);
+    free(def_seuser);
+    free(def_level);
+
+    return matches;
+}
+
+bool ipa_selinux_label_is_set(hash_table_t *labels,
+                              const char *username,
+                              const char *seuser,
+                              const char *mls_range)
+{
+    hash_key_t key;
+    hash_value_t value;
+    char *label;
+    bool is_set;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(username);
+
+    hret = hash_lookup(labels, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return false;
+    }
+
+    label = ipa_selinux_label(NULL, seuser, mls_range);
+    if (label == NULL) {
+        return false;
+    }
+
+    is_set = strcmp(label, (const char *) value.ptr) == 0;
+    talloc_free(label);
+    if (!is_set) {
+        return false;
+    }
+
+    if (!ipa_selinux_label_in_system(username, seuser, mls_range)) {
+        DEBUG(SSSDBG_TRACE_FUNC, "SELinux label of [%s] was changed on "
+              "the system\n", username);
+        ipa_selinux_label_remove(labels, username);
+        return false;
+    }
+
+    return true;
+}
+
+void ipa_selinux_label_remove(hash_table_t *labels,
+                              const char *username)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(username);
+
+    hret = hash_lookup(labels, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return;
+    }
+
+    hash_delete(labels, &key);
+    talloc_free(value.ptr);
+}
+
+void ipa_selinux_label_store(hash_table_t *labels,
+                             const char *username,
+                             const char *seuser,
+                             const char *mls_range)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    ipa_selinux_label_remove(labels, username);
+
+    if (hash_count(labels) >= IPA_SELINUX_MAX_LABELS) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Too many SELinux labels, the label of "
+              "[%s] is not remembered\n", username);
+        return;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(username);
+
+    value.type = HASH_VALUE_PTR;
+    value.ptr = ipa_selinux_label(labels, seuser, mls_range);
+    if (value.ptr == NULL) {
+        return;
+    }
+
+    hret = hash_enter(labels, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        /* Not fatal, selinux_child will be started at the next login. */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to remember the SELinux label "
+              "of [%s]: %s\n", username, hash_error_string(hret));
+        talloc_free(value.ptr);
+    }
+}
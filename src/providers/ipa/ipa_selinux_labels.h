@@ -0,0 +1,48 @@
+/*
+    SSSD
+
+    IPA Backend Module -- SELinux labels set for the users
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IPA_SELINUX_LABELS_H_
+#define IPA_SELINUX_LABELS_H_
+
+#include <dhash.h>
+
+#include "util/util.h"
+
+/* Users beyond this number are not remembered, selinux_child is started
+ * for them at every login as before. */
+#define IPA_SELINUX_MAX_LABELS 1024
+
+/* Returns true if the label was set for the user by this back end and the
+ * system still maps the user to it. */
+bool ipa_selinux_label_is_set(hash_table_t *labels,
+                              const char *username,
+                              const char *seuser,
+                              const char *mls_range);
+
+void ipa_selinux_label_store(hash_table_t *labels,
+                             const char *username,
+                             const char *seuser,
+                             const char *mls_range);
+
+void ipa_selinux_label_remove(hash_table_t *labels,
+                              const char *username);
+
+#endif /* IPA_SELINUX_LABELS_H_ */
@@ -332,9 +332,25 @@ static errno_t krb5_auth_prepare_ccache_name(struct krb5child_req *kr,
     return EOK;
 }
 
-static void krb5_auth_store_creds(struct sss_domain_info *domain,
+static void krb5_auth_store_creds_done(struct tevent_req *req)
+{
+    errno_t ret;
+
+    ret = sysdb_cache_password_recv(req);
+    talloc_free(req);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              "Failed to cache password, offline auth may not work."
+                  " (%d)[%s]!?\n", ret, strerror(ret));
+        /* password caching failures are not fatal errors */
+    }
+}
+
+static void krb5_auth_store_creds(struct be_ctx *be_ctx,
+                                  struct sss_domain_info *domain,
                                   struct pam_data *pd)
 {
+    struct tevent_req *req;
     const char *password = NULL;
     const char *fa2;
     size_t password_len;
@@ -398,14 +414,20 @@ static void krb5_auth_store_creds(struct sss_domain_info *domain,
         return;
     }
 
-    ret = sysdb_cache_password_ex(domain, pd->user, password,
-                                  sss_authtok_get_type(pd->authtok), fa2_len);
-    if (ret) {
+    /* The reply does not wait for the password to be hashed and stored,
+     * the request is owned by be_ctx so it outlives pd. */
+    req = sysdb_cache_password_send(be_ctx, be_ctx->ev, be_ctx->crypt_pool,
+                                    domain, pd->user, password,
+                                    sss_authtok_get_type(pd->authtok),
+                                    fa2_len);
+    if (req == NULL) {
         DEBUG(SSSDBG_OP_FAILURE,
-              "Failed to cache password, offline auth may not work."
-                  " (%d)[%s]!?\n", ret, strerror(ret));
+              "Failed to cache password, offline auth may not work.\n");
         /* password caching failures are not fatal errors */
+        return;
     }
+
+    tevent_req_set_callback(req, krb5_auth_store_creds_done, NULL);
 }
 
 static bool is_otp_enabled(struct ldb_message *user_msg)
@@ -1161,7 +1183,7 @@ static void krb5_auth_done(struct tevent_req *subreq)
             && (!res->otp
                 || (res->otp && sss_authtok_get_type(pd->authtok) ==
                                                        SSS_AUTHTOK_TYPE_2FA))) {
-        krb5_auth_store_creds(state->domain, pd);
+        krb5_auth_store_creds(state->be_ctx, state->domain, pd);
     }
 
     /* The SSS_OTP message will prevent pam_sss from putting the entered
@@ -47,6 +47,7 @@
 #define CHILD_OPT_FAST_PRINCIPAL "fast-principal"
 #define CHILD_OPT_CANONICALIZE "canonicalize"
 #define CHILD_OPT_SSS_CREDS_PASSWORD "sss-creds-password"
+#define CHILD_OPT_WORKER "worker"
 
 struct krb5child_req {
     struct pam_data *pd;
@@ -106,6 +107,11 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
 int handle_child_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
                       uint8_t **buf, ssize_t *len);
 
+/* Starts the krb5_child worker pool if krb5_child_pool_size is set,
+ * handle_child_send() uses it afterwards. */
+errno_t krb5_child_pool_init(struct krb5_ctx *krb5_ctx,
+                             struct tevent_context *ev);
+
 struct krb5_child_response {
     int32_t msg_status;
     struct tgt_times tgtt;
@@ -28,6 +28,9 @@
 #include <fcntl.h>
 #include <ctype.h>
 #include <popt.h>
+#ifdef HAVE_PRCTL
+#include <sys/prctl.h>
+#endif
 
 #include <security/pam_modules.h>
 
@@ -3239,6 +3242,330 @@ static void try_open_krb5_conf(void)
     }
 }
 
+/* Runs a request which was already unpacked into kr and writes the reply to
+ * STDOUT_FILENO. The request drops privileges to the user, so the calling
+ * process cannot handle another request afterwards. */
+static errno_t k5c_handle_request(struct krb5_req *kr, uint32_t offline)
+{
+    krb5_error_code kerr;
+    errno_t ret;
+
+    kerr = privileged_krb5_setup(kr, offline);
+    if (kerr != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "privileged_krb5_setup failed.\n");
+        ret = EFAULT;
+        goto done;
+    }
+
+    /* For PKINIT we might need access to the pcscd socket which by default
+     * is only allowed for authenticated users. Since PKINIT is part of
+     * the authentication and the user is not authenticated yet, we have
+     * to use different privileges and can only drop it only after the TGT is
+     * received. The fast_uid and fast_gid are the IDs the backend is running
+     * with. This can be either root or the 'sssd' user. Root is allowed by
+     * default and the 'sssd' user is allowed with the help of the
+     * sssd-pcsc.rules policy-kit rule. So those IDs are a suitable choice. We
+     * can only call switch_creds() because after the TGT is returned we have
+     * to switch to the IDs of the user to store the TGT. */
+    if (IS_SC_AUTHTOK(kr->pd->authtok)) {
+        kerr = switch_creds(kr, kr->fast_uid, kr->fast_gid, 0, NULL,
+                            &kr->pcsc_saved_creds);
+    } else {
+        kerr = k5c_become_user(kr->uid, kr->gid, kr->posix_domain);
+    }
+    if (kerr != 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "become_user failed.\n");
+        ret = EFAULT;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "Running as [%"SPRIuid"][%"SPRIgid"].\n", geteuid(), getegid());
+
+    try_open_krb5_conf();
+
+    ret = k5c_setup(kr, offline);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "krb5_child_setup failed.\n");
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Will perform %s\n", krb5_child_command_to_str(kr->pd->cmd));
+    switch(kr->pd->cmd) {
+    case SSS_PAM_AUTHENTICATE:
+        /* If we are offline, we need to create an empty ccache file */
+        if (offline) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Will perform offline auth\n");
+            ret = create_empty_ccache(kr);
+        } else {
+            DEBUG(SSSDBG_TRACE_FUNC, "Will perform online auth\n");
+            ret = tgt_req_child(kr);
+        }
+        break;
+    case SSS_PAM_CHAUTHTOK:
+        ret = changepw_child(kr, false);
+        break;
+    case SSS_PAM_CHAUTHTOK_PRELIM:
+        ret = changepw_child(kr, true);
+        break;
+    case SSS_PAM_ACCT_MGMT:
+        ret = kuserok_child(kr);
+        break;
+    case SSS_CMD_RENEW:
+        if (offline) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Cannot renew TGT while offline\n");
+            ret = KRB5_KDC_UNREACH;
+            goto done;
+        }
+        ret = renew_tgt_child(kr);
+        break;
+    case SSS_PAM_PREAUTH:
+        ret = tgt_req_child(kr);
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "PAM command [%d] not supported.\n", kr->pd->cmd);
+        ret = EINVAL;
+        goto done;
+    }
+
+    ret = k5c_send_data(kr, STDOUT_FILENO, ret);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to send reply\n");
+    }
+
+done:
+    return ret;
+}
+
+static struct krb5_req *k5c_new_req(uid_t fast_uid, gid_t fast_gid,
+                                    struct cli_opts *cli_opts,
+                                    int sss_creds_password)
+{
+    struct krb5_req *kr;
+
+    kr = talloc_zero(NULL, struct krb5_req);
+    if (kr == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
+        return NULL;
+    }
+
+    kr->fast_uid = fast_uid;
+    kr->fast_gid = fast_gid;
+    kr->cli_opts = cli_opts;
+    if (sss_creds_password != 0) {
+        kr->krb5_get_init_creds_password = sss_krb5_get_init_creds_password;
+    } else {
+        kr->krb5_get_init_creds_password = krb5_get_init_creds_password;
+    }
+
+    return kr;
+}
+
+/* Runs in the process forked by the worker for a single request, never
+ * returns. */
+static void k5c_worker_run_request(uint8_t *buf, size_t len, int out_fd,
+                                   uid_t fast_uid, gid_t fast_gid,
+                                   struct cli_opts *cli_opts,
+                                   int sss_creds_password)
+{
+    struct krb5_req *kr;
+    uint32_t offline;
+    errno_t ret;
+
+    /* The request is handled exactly as in a freshly executed krb5_child,
+     * with stdin closed and the reply written to stdout. */
+    close(STDIN_FILENO);
+    if (dup2(out_fd, STDOUT_FILENO) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "dup2 failed [%d][%s].\n", ret, strerror(ret));
+        _exit(-1);
+    }
+    close(out_fd);
+
+#ifdef HAVE_PRCTL
+    /* Do not outlive the worker if it is killed after a timeout. */
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0) == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "prctl failed [%d][%s].\n", ret, strerror(ret));
+        /* Not fatal */
+    }
+#endif
+
+    debug_prg_name = talloc_asprintf(NULL, "krb5_child[%d]", getpid());
+    if (debug_prg_name == NULL) {
+        debug_prg_name = "krb5_child";
+    }
+
+    kr = k5c_new_req(fast_uid, fast_gid, cli_opts, sss_creds_password);
+    if (kr == NULL) {
+        _exit(-1);
+    }
+
+    ret = unpack_buffer(buf, len, kr, &offline);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "unpack_buffer failed.\n");
+    } else {
+        ret = k5c_handle_request(kr, offline);
+    }
+
+    if (ret == EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC, "krb5_child request completed successfully\n");
+    } else {
+        DEBUG(SSSDBG_CRIT_FAILURE, "krb5_child request failed!\n");
+    }
+
+    krb5_cleanup(kr);
+    talloc_free(kr);
+    _exit(ret == EOK ? 0 : -1);
+}
+
+static errno_t k5c_worker_request(uint8_t *buf, size_t len,
+                                  uid_t fast_uid, gid_t fast_gid,
+                                  struct cli_opts *cli_opts,
+                                  int sss_creds_password)
+{
+    int pipefd[2] = PIPE_INIT;
+    uint8_t chunk[CHILD_MSG_CHUNK];
+    uint8_t *reply = NULL;
+    size_t reply_len = 0;
+    ssize_t size;
+    int status;
+    pid_t pid;
+    errno_t ret;
+
+    ret = pipe(pipefd);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        return ret;
+    }
+
+    pid = fork();
+    if (pid == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "fork failed [%d][%s].\n", ret, strerror(ret));
+        PIPE_CLOSE(pipefd);
+        return ret;
+    } else if (pid == 0) {
+        PIPE_FD_CLOSE(pipefd[0]);
+        k5c_worker_run_request(buf, len, pipefd[1], fast_uid, fast_gid,
+                               cli_opts, sss_creds_password);
+    }
+
+    PIPE_FD_CLOSE(pipefd[1]);
+
+    /* An empty reply is passed on as well, the back end treats it the same
+     * way as a krb5_child which exited without a reply. */
+    do {
+        errno = 0;
+        size = sss_atomic_read_s(pipefd[0], chunk, sizeof(chunk));
+        if (size == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "read failed [%d][%s].\n", ret, strerror(ret));
+            break;
+        } else if (size == 0) {
+            break;
+        }
+
+        reply = talloc_realloc(NULL, reply, uint8_t, reply_len + size);
+        if (reply == NULL) {
+            ret = ENOMEM;
+            break;
+        }
+        memcpy(reply + reply_len, chunk, size);
+        reply_len += size;
+    } while (size == (ssize_t) sizeof(chunk));
+    PIPE_FD_CLOSE(pipefd[0]);
+
+    do {
+        errno = 0;
+        pid = waitpid(pid, &status, 0);
+    } while (pid == -1 && errno == EINTR);
+
+    if (pid > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+        DEBUG(SSSDBG_OP_FAILURE, "Request process exited with status [%d]\n",
+              status);
+    }
+
+    if (ret == EOK) {
+        errno = 0;
+        size = sss_atomic_write_frame_s(STDOUT_FILENO, reply, reply_len);
+        if (size == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "write failed [%d][%s].\n", ret, strerror(ret));
+        }
+    }
+
+    talloc_free(reply);
+    return ret;
+}
+
+/* In worker mode krb5_child keeps running and handles one request after the
+ * other, each framed as described in sss_atomic_read_frame_s(). Every
+ * request runs in a process forked from the worker because it drops
+ * privileges to the user, while the worker has to keep the privileges of
+ * the back end for the next request. This still saves the exec of a new
+ * binary, loading the libraries and, since the worker keeps a krb5 context
+ * open, parsing krb5.conf for every request. The worker exits when the
+ * back end closes the pipe. */
+static errno_t k5c_worker(uid_t fast_uid, gid_t fast_gid,
+                          struct cli_opts *cli_opts,
+                          int sss_creds_password)
+{
+    uint8_t buf[IN_BUF_SIZE];
+    krb5_context kctx = NULL;
+    krb5_error_code kerr;
+    size_t num_requests = 0;
+    ssize_t len;
+    errno_t ret;
+
+    kerr = krb5_init_context(&kctx);
+    if (kerr != 0) {
+        KRB5_CHILD_DEBUG(SSSDBG_MINOR_FAILURE, kerr);
+        /* Not fatal, each request creates its own context anyway. */
+        kctx = NULL;
+    }
+
+    while (true) {
+        errno = 0;
+        len = sss_atomic_read_frame_s(STDIN_FILENO, buf, sizeof(buf));
+        if (len == -1) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "read failed [%d][%s].\n", ret, strerror(ret));
+            break;
+        } else if (len == 0) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  "No more requests, %zu handled\n", num_requests);
+            ret = EOK;
+            break;
+        }
+
+        ret = k5c_worker_request(buf, len, fast_uid, fast_gid, cli_opts,
+                                 sss_creds_password);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Cannot handle request [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            break;
+        }
+        num_requests++;
+    }
+
+    if (kctx != NULL) {
+        krb5_free_context(kctx);
+    }
+
+    return ret;
+}
+
 int main(int argc, const char *argv[])
 {
     struct krb5_req *kr = NULL;
@@ -3248,11 +3575,11 @@ int main(int argc, const char *argv[])
     int debug_fd = -1;
     const char *opt_logger = NULL;
     errno_t ret;
-    krb5_error_code kerr;
     uid_t fast_uid = 0;
     gid_t fast_gid = 0;
     struct cli_opts cli_opts = { 0 };
     int sss_creds_password = 0;
+    int worker = 0;
 
     struct poptOption long_options[] = {
         POPT_AUTOHELP
@@ -3287,6 +3614,8 @@ int main(int argc, const char *argv[])
          _("Requests canonicalization of the principal name"), NULL},
         {CHILD_OPT_SSS_CREDS_PASSWORD, 0, POPT_ARG_NONE, &sss_creds_password,
          0, _("Use custom version of krb5_get_init_creds_password"), NULL},
+        {CHILD_OPT_WORKER, 0, POPT_ARG_NONE, &worker, 0,
+         _("Handle framed requests until stdin is closed"), NULL},
         POPT_TABLEEND
     };
 
@@ -3333,23 +3662,18 @@ int main(int argc, const char *argv[])
 
     DEBUG(SSSDBG_TRACE_FUNC, "krb5_child started.\n");
 
-    kr = talloc_zero(NULL, struct krb5_req);
+    if (worker) {
+        ret = k5c_worker(fast_uid, fast_gid, &cli_opts, sss_creds_password);
+        goto done;
+    }
+
+    kr = k5c_new_req(fast_uid, fast_gid, &cli_opts, sss_creds_password);
     if (kr == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
         ret = ENOMEM;
         goto done;
     }
     talloc_steal(kr, debug_prg_name);
 
-    kr->fast_uid = fast_uid;
-    kr->fast_gid = fast_gid;
-    kr->cli_opts = &cli_opts;
-    if (sss_creds_password != 0) {
-        kr->krb5_get_init_creds_password = sss_krb5_get_init_creds_password;
-    } else {
-        kr->krb5_get_init_creds_password = krb5_get_init_creds_password;
-    }
-
     ret = k5c_recv_data(kr, STDIN_FILENO, &offline);
     if (ret != EOK) {
         goto done;
@@ -3357,90 +3681,7 @@ int main(int argc, const char *argv[])
 
     close(STDIN_FILENO);
 
-    kerr = privileged_krb5_setup(kr, offline);
-    if (kerr != 0) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "privileged_krb5_setup failed.\n");
-        ret = EFAULT;
-        goto done;
-    }
-
-    /* For PKINIT we might need access to the pcscd socket which by default
-     * is only allowed for authenticated users. Since PKINIT is part of
-     * the authentication and the user is not authenticated yet, we have
-     * to use different privileges and can only drop it only after the TGT is
-     * received. The fast_uid and fast_gid are the IDs the backend is running
-     * with. This can be either root or the 'sssd' user. Root is allowed by
-     * default and the 'sssd' user is allowed with the help of the
-     * sssd-pcsc.rules policy-kit rule. So those IDs are a suitable choice. We
-     * can only call switch_creds() because after the TGT is returned we have
-     * to switch to the IDs of the user to store the TGT. */
-    if (IS_SC_AUTHTOK(kr->pd->authtok)) {
-        kerr = switch_creds(kr, kr->fast_uid, kr->fast_gid, 0, NULL,
-                            &kr->pcsc_saved_creds);
-    } else {
-        kerr = k5c_become_user(kr->uid, kr->gid, kr->posix_domain);
-    }
-    if (kerr != 0) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "become_user failed.\n");
-        ret = EFAULT;
-        goto done;
-    }
-
-    DEBUG(SSSDBG_TRACE_INTERNAL,
-          "Running as [%"SPRIuid"][%"SPRIgid"].\n", geteuid(), getegid());
-
-    try_open_krb5_conf();
-
-    ret = k5c_setup(kr, offline);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "krb5_child_setup failed.\n");
-        goto done;
-    }
-
-    DEBUG(SSSDBG_TRACE_FUNC,
-          "Will perform %s\n", krb5_child_command_to_str(kr->pd->cmd));
-    switch(kr->pd->cmd) {
-    case SSS_PAM_AUTHENTICATE:
-        /* If we are offline, we need to create an empty ccache file */
-        if (offline) {
-            DEBUG(SSSDBG_TRACE_FUNC, "Will perform offline auth\n");
-            ret = create_empty_ccache(kr);
-        } else {
-            DEBUG(SSSDBG_TRACE_FUNC, "Will perform online auth\n");
-            ret = tgt_req_child(kr);
-        }
-        break;
-    case SSS_PAM_CHAUTHTOK:
-        ret = changepw_child(kr, false);
-        break;
-    case SSS_PAM_CHAUTHTOK_PRELIM:
-        ret = changepw_child(kr, true);
-        break;
-    case SSS_PAM_ACCT_MGMT:
-        ret = kuserok_child(kr);
-        break;
-    case SSS_CMD_RENEW:
-        if (offline) {
-            DEBUG(SSSDBG_CRIT_FAILURE, "Cannot renew TGT while offline\n");
-            ret = KRB5_KDC_UNREACH;
-            goto done;
-        }
-        ret = renew_tgt_child(kr);
-        break;
-    case SSS_PAM_PREAUTH:
-        ret = tgt_req_child(kr);
-        break;
-    default:
-        DEBUG(SSSDBG_CRIT_FAILURE,
-              "PAM command [%d] not supported.\n", kr->pd->cmd);
-        ret = EINVAL;
-        goto done;
-    }
-
-    ret = k5c_send_data(kr, STDOUT_FILENO, ret);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to send reply\n");
-    }
+    ret = k5c_handle_request(kr, offline);
 
 done:
     if (ret == EOK) {
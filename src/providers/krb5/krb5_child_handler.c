@@ -509,8 +509,557 @@ fail:
     return ret;
 }
 
+/* A pool of krb5_child processes running in worker mode, see k5c_worker() in
+ * krb5_child.c. A worker handles one request at a time and is replaced
+ * after krb5_child_pool_max_requests requests. If all workers are busy and
+ * the pool is full, requests wait in a queue for the next free worker. */
+struct krb5_child_worker {
+    struct krb5_child_worker *prev;
+    struct krb5_child_worker *next;
+
+    struct krb5_child_pool *pool;
+    pid_t pid;
+    struct child_io_fds *io;
+    struct sss_child_ctx_old *child_ctx;
+    size_t num_requests;
+
+    /* The request currently handled by this worker, NULL if idle. */
+    struct tevent_req *req;
+};
+
+struct krb5_child_pool_run_state;
+
+struct krb5_child_pool {
+    struct krb5_ctx *krb5_ctx;
+    struct tevent_context *ev;
+    size_t size;
+    size_t max_requests;
+
+    size_t num_workers;
+    struct krb5_child_worker *workers;
+    struct krb5_child_pool_run_state *queue;
+    struct tevent_immediate *dispatch_imm;
+};
+
+static void krb5_child_pool_schedule_dispatch(struct krb5_child_pool *pool);
+static void krb5_child_pool_run_fail(struct tevent_req *req, errno_t ret);
+
+static int krb5_child_worker_destructor(struct krb5_child_worker *worker)
+{
+    DLIST_REMOVE(worker->pool->workers, worker);
+    worker->pool->num_workers--;
+
+    /* The worker would exit once its pipes are closed but it might be
+     * stuck in a request, child_handler_destroy() kills it and still
+     * collects its exit status. */
+    if (worker->child_ctx != NULL) {
+        child_handler_destroy(worker->child_ctx);
+        worker->child_ctx = NULL;
+    }
+
+    return 0;
+}
+
+static void krb5_child_worker_exited(int child_status,
+                                     struct tevent_signal *sige,
+                                     void *pvt)
+{
+    struct krb5_child_worker *worker;
+    struct krb5_child_pool *pool;
+
+    worker = talloc_get_type(pvt, struct krb5_child_worker);
+    pool = worker->pool;
+
+    DEBUG(SSSDBG_MINOR_FAILURE, "krb5_child worker [%d] exited after %zu "
+          "requests\n", worker->pid, worker->num_requests);
+
+    /* Freed by the caller. */
+    worker->child_ctx = NULL;
+
+    if (worker->req != NULL) {
+        krb5_child_pool_run_fail(worker->req, EIO);
+        return;
+    }
+
+    talloc_free(worker);
+    krb5_child_pool_schedule_dispatch(pool);
+}
+
+static errno_t krb5_child_worker_spawn(struct krb5_child_pool *pool,
+                                       struct krb5_child_worker **_worker)
+{
+    int pipefd_to_child[2] = PIPE_INIT;
+    int pipefd_from_child[2] = PIPE_INIT;
+    struct krb5_child_worker *worker;
+    const char **extra_args;
+    size_t c;
+    pid_t pid;
+    errno_t ret;
+
+    worker = talloc_zero(pool, struct krb5_child_worker);
+    if (worker == NULL) {
+        return ENOMEM;
+    }
+    worker->pool = pool;
+    worker->pid = -1;
+
+    worker->io = talloc(worker, struct child_io_fds);
+    if (worker->io == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    worker->io->write_to_child_fd = -1;
+    worker->io->read_from_child_fd = -1;
+    talloc_set_destructor((void *) worker->io, child_io_destructor);
+
+    ret = set_extra_args(worker, pool->krb5_ctx, &extra_args);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "set_extra_args failed.\n");
+        goto fail;
+    }
+
+    for (c = 0; extra_args[c] != NULL; c++);
+    extra_args = talloc_realloc(worker, extra_args, const char *, c + 2);
+    if (extra_args == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    extra_args[c] = "--"CHILD_OPT_WORKER;
+    extra_args[c + 1] = NULL;
+
+    ret = pipe(pipefd_from_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+    ret = pipe(pipefd_to_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    pid = fork();
+    if (pid == 0) { /* child */
+        exec_child_ex(worker,
+                      pipefd_to_child, pipefd_from_child,
+                      KRB5_CHILD, KRB5_CHILD_LOG_FILE,
+                      extra_args, false,
+                      STDIN_FILENO, STDOUT_FILENO);
+
+        /* We should never get here */
+        DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Could not exec KRB5 child\n");
+    } else if (pid < 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "fork failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    talloc_zfree(extra_args);
+
+    worker->pid = pid;
+    worker->io->read_from_child_fd = pipefd_from_child[0];
+    PIPE_FD_CLOSE(pipefd_from_child[1]);
+    worker->io->write_to_child_fd = pipefd_to_child[1];
+    PIPE_FD_CLOSE(pipefd_to_child[0]);
+    sss_fd_nonblocking(worker->io->read_from_child_fd);
+    sss_fd_nonblocking(worker->io->write_to_child_fd);
+
+    DLIST_ADD(pool->workers, worker);
+    pool->num_workers++;
+    talloc_set_destructor(worker, krb5_child_worker_destructor);
+
+    ret = child_handler_setup(pool->ev, pid, krb5_child_worker_exited, worker,
+                              &worker->child_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Could not set up child signal handler\n");
+        kill(pid, SIGKILL);
+        talloc_free(worker);
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started krb5_child worker [%d], %zu of %zu\n",
+          pid, pool->num_workers, pool->size);
+
+    *_worker = worker;
+    return EOK;
+
+fail:
+    PIPE_CLOSE(pipefd_from_child);
+    PIPE_CLOSE(pipefd_to_child);
+    talloc_free(worker);
+    return ret;
+}
+
+/* Returns EAGAIN if all workers are busy and the pool is full. */
+static errno_t krb5_child_pool_get_worker(struct krb5_child_pool *pool,
+                                          struct krb5_child_worker **_worker)
+{
+    struct krb5_child_worker *worker;
+
+    DLIST_FOR_EACH(worker, pool->workers) {
+        if (worker->req == NULL) {
+            *_worker = worker;
+            return EOK;
+        }
+    }
+
+    if (pool->num_workers >= pool->size) {
+        return EAGAIN;
+    }
+
+    return krb5_child_worker_spawn(pool, _worker);
+}
+
+errno_t krb5_child_pool_init(struct krb5_ctx *krb5_ctx,
+                             struct tevent_context *ev)
+{
+    struct krb5_child_pool *pool;
+    struct krb5_child_worker *worker;
+    int size;
+    int max_requests;
+    size_t c;
+    errno_t ret;
+
+    size = dp_opt_get_int(krb5_ctx->opts, KRB5_CHILD_POOL_SIZE);
+    if (size <= 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "krb5_child pool is disabled\n");
+        return EOK;
+    }
+
+    max_requests = dp_opt_get_int(krb5_ctx->opts,
+                                  KRB5_CHILD_POOL_MAX_REQUESTS);
+
+    pool = talloc_zero(krb5_ctx, struct krb5_child_pool);
+    if (pool == NULL) {
+        return ENOMEM;
+    }
+
+    pool->krb5_ctx = krb5_ctx;
+    pool->ev = ev;
+    pool->size = size;
+    pool->max_requests = max_requests > 0 ? max_requests : 0;
+
+    pool->dispatch_imm = tevent_create_immediate(pool);
+    if (pool->dispatch_imm == NULL) {
+        talloc_free(pool);
+        return ENOMEM;
+    }
+
+    for (c = 0; c < pool->size; c++) {
+        ret = krb5_child_worker_spawn(pool, &worker);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Cannot start krb5_child worker "
+                  "[%d]: %s\n", ret, sss_strerror(ret));
+            /* Not fatal, the worker will be started on demand. */
+            break;
+        }
+    }
+
+    DEBUG(SSSDBG_CONF_SETTINGS, "krb5_child pool of %zu workers, %zu "
+          "requests per worker\n", pool->size, pool->max_requests);
+
+    krb5_ctx->child_pool = pool;
+    return EOK;
+}
+
+struct krb5_child_pool_run_state {
+    struct krb5_child_pool_run_state *prev;
+    struct krb5_child_pool_run_state *next;
+
+    struct tevent_context *ev;
+    struct tevent_req *req;
+    struct krb5_child_pool *pool;
+    struct io_buffer *buf;
+    uint32_t timeout;
+    bool queued;
+
+    struct krb5_child_worker *worker;
+    struct tevent_req *subreq;
+    struct tevent_timer *timeout_handler;
+
+    uint8_t *reply;
+    ssize_t reply_len;
+};
+
+static errno_t krb5_child_pool_run_start(struct tevent_req *req,
+                                         struct krb5_child_worker *worker);
+static void krb5_child_pool_run_written(struct tevent_req *subreq);
+static void krb5_child_pool_run_done(struct tevent_req *subreq);
+
+/* Detaches the request from its worker. A worker which did not finish its
+ * request cleanly or reached its request limit is stopped. */
+static void krb5_child_pool_release(struct krb5_child_pool_run_state *state,
+                                    bool reusable)
+{
+    struct krb5_child_worker *worker = state->worker;
+
+    talloc_zfree(state->subreq);
+    talloc_zfree(state->timeout_handler);
+
+    if (worker == NULL) {
+        return;
+    }
+
+    state->worker = NULL;
+    worker->req = NULL;
+    worker->num_requests++;
+
+    if (!reusable) {
+        talloc_free(worker);
+    } else if (state->pool->max_requests > 0
+            && worker->num_requests >= state->pool->max_requests) {
+        DEBUG(SSSDBG_TRACE_FUNC, "krb5_child worker [%d] handled %zu "
+              "requests, replacing it\n", worker->pid, worker->num_requests);
+        talloc_free(worker);
+    }
+
+    krb5_child_pool_schedule_dispatch(state->pool);
+}
+
+static int krb5_child_pool_run_destructor(struct krb5_child_pool_run_state *state)
+{
+    if (state->queued) {
+        DLIST_REMOVE(state->pool->queue, state);
+        state->queued = false;
+    }
+
+    /* The reply of an abandoned request must not be read as the reply of
+     * the next one. */
+    krb5_child_pool_release(state, false);
+
+    return 0;
+}
+
+static void krb5_child_pool_run_fail(struct tevent_req *req, errno_t ret)
+{
+    struct krb5_child_pool_run_state *state;
+
+    state = tevent_req_data(req, struct krb5_child_pool_run_state);
+
+    krb5_child_pool_release(state, false);
+    tevent_req_error(req, ret);
+}
+
+static void krb5_child_pool_dispatch(struct tevent_context *ev,
+                                     struct tevent_immediate *imm,
+                                     void *pvt)
+{
+    struct krb5_child_pool *pool;
+    struct krb5_child_pool_run_state *state;
+    struct krb5_child_worker *worker;
+    errno_t ret;
+
+    pool = talloc_get_type(pvt, struct krb5_child_pool);
+
+    while (pool->queue != NULL) {
+        ret = krb5_child_pool_get_worker(pool, &worker);
+        if (ret == EAGAIN) {
+            return;
+        }
+
+        state = pool->queue;
+        DLIST_REMOVE(pool->queue, state);
+        state->queued = false;
+
+        if (ret != EOK) {
+            tevent_req_error(state->req, ret);
+            continue;
+        }
+
+        ret = krb5_child_pool_run_start(state->req, worker);
+        if (ret != EOK) {
+            krb5_child_pool_run_fail(state->req, ret);
+        }
+    }
+}
+
+static void krb5_child_pool_schedule_dispatch(struct krb5_child_pool *pool)
+{
+    if (pool->queue == NULL) {
+        return;
+    }
+
+    tevent_schedule_immediate(pool->dispatch_imm, pool->ev,
+                              krb5_child_pool_dispatch, pool);
+}
+
+static void krb5_child_pool_run_timeout(struct tevent_context *ev,
+                                        struct tevent_timer *te,
+                                        struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct krb5_child_pool_run_state *state;
+
+    state = tevent_req_data(req, struct krb5_child_pool_run_state);
+    state->timeout_handler = NULL;
+
+    DEBUG(SSSDBG_IMPORTANT_INFO,
+          "Timeout for krb5_child worker [%d] reached. In case KDC is "
+          "distant or network is slow you may consider increasing value of "
+          "krb5_auth_timeout.\n", state->worker->pid);
+
+    krb5_child_pool_run_fail(req, ETIMEDOUT);
+}
+
+static struct tevent_req *
+krb5_child_pool_run_send(TALLOC_CTX *mem_ctx,
+                         struct tevent_context *ev,
+                         struct krb5_child_pool *pool,
+                         struct io_buffer *buf,
+                         uint32_t timeout)
+{
+    struct krb5_child_pool_run_state *state;
+    struct krb5_child_worker *worker;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct krb5_child_pool_run_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->req = req;
+    state->pool = pool;
+    state->buf = buf;
+    state->timeout = timeout;
+    talloc_set_destructor(state, krb5_child_pool_run_destructor);
+
+    ret = krb5_child_pool_get_worker(pool, &worker);
+    if (ret == EAGAIN) {
+        DEBUG(SSSDBG_TRACE_FUNC, "All %zu krb5_child workers are busy, "
+              "queuing the request\n", pool->num_workers);
+        DLIST_ADD_END(pool->queue, state, struct krb5_child_pool_run_state *);
+        state->queued = true;
+        return req;
+    } else if (ret != EOK) {
+        goto immediately;
+    }
+
+    ret = krb5_child_pool_run_start(req, worker);
+    if (ret != EOK) {
+        krb5_child_pool_release(state, false);
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t krb5_child_pool_run_start(struct tevent_req *req,
+                                         struct krb5_child_worker *worker)
+{
+    struct krb5_child_pool_run_state *state;
+    struct timeval tv;
+
+    state = tevent_req_data(req, struct krb5_child_pool_run_state);
+
+    worker->req = req;
+    state->worker = worker;
+
+    tv = tevent_timeval_current_ofs(state->timeout, 0);
+    state->timeout_handler = tevent_add_timer(state->ev, state, tv,
+                                              krb5_child_pool_run_timeout,
+                                              req);
+    if (state->timeout_handler == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
+        return ENOMEM;
+    }
+
+    state->subreq = write_pipe_frame_send(state, state->ev,
+                                          state->buf->data, state->buf->size,
+                                          worker->io->write_to_child_fd);
+    if (state->subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(state->subreq, krb5_child_pool_run_written, req);
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Request sent to krb5_child worker [%d]\n",
+          worker->pid);
+
+    return EOK;
+}
+
+static void krb5_child_pool_run_written(struct tevent_req *subreq)
+{
+    struct krb5_child_pool_run_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct krb5_child_pool_run_state);
+
+    ret = write_pipe_recv(subreq);
+    talloc_zfree(subreq);
+    state->subreq = NULL;
+    if (ret != EOK) {
+        krb5_child_pool_run_fail(req, ret);
+        return;
+    }
+
+    state->subreq = read_pipe_frame_send(state, state->ev,
+                                         state->worker->io->read_from_child_fd);
+    if (state->subreq == NULL) {
+        krb5_child_pool_run_fail(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(state->subreq, krb5_child_pool_run_done, req);
+}
+
+static void krb5_child_pool_run_done(struct tevent_req *subreq)
+{
+    struct krb5_child_pool_run_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct krb5_child_pool_run_state);
+
+    ret = read_pipe_frame_recv(subreq, state, &state->reply,
+                               &state->reply_len);
+    talloc_zfree(subreq);
+    state->subreq = NULL;
+    if (ret != EOK) {
+        krb5_child_pool_run_fail(req, ret);
+        return;
+    }
+
+    krb5_child_pool_release(state, true);
+    tevent_req_done(req);
+}
+
+static errno_t krb5_child_pool_run_recv(struct tevent_req *req,
+                                        TALLOC_CTX *mem_ctx,
+                                        uint8_t **_buf,
+                                        ssize_t *_len)
+{
+    struct krb5_child_pool_run_state *state;
+
+    state = tevent_req_data(req, struct krb5_child_pool_run_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_buf = talloc_steal(mem_ctx, state->reply);
+    *_len = state->reply_len;
+
+    return EOK;
+}
+
 static void handle_child_step(struct tevent_req *subreq);
 static void handle_child_done(struct tevent_req *subreq);
+static void handle_child_pool_done(struct tevent_req *subreq);
 
 struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
                                      struct tevent_context *ev,
@@ -549,6 +1098,20 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    if (kr->krb5_ctx->child_pool != NULL) {
+        subreq = krb5_child_pool_run_send(state, ev, kr->krb5_ctx->child_pool,
+                                          buf,
+                                          dp_opt_get_int(kr->krb5_ctx->opts,
+                                                         KRB5_AUTH_TIMEOUT));
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+        tevent_req_set_callback(subreq, handle_child_pool_done, req);
+
+        return req;
+    }
+
     ret = fork_child(req);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "fork_child failed.\n");
@@ -619,6 +1182,24 @@ static void handle_child_done(struct tevent_req *subreq)
     return;
 }
 
+static void handle_child_pool_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct handle_child_state *state = tevent_req_data(req,
+                                                    struct handle_child_state);
+    int ret;
+
+    ret = krb5_child_pool_run_recv(subreq, state, &state->buf, &state->len);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
 int handle_child_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
                       uint8_t **buf, ssize_t *len)
 {
@@ -63,6 +63,10 @@ enum krb5_opts {
     KRB5_USE_KDCINFO,
     KRB5_KDCINFO_LOOKAHEAD,
     KRB5_MAP_USER,
+    KRB5_CHILD_POOL_SIZE,
+    KRB5_CHILD_POOL_MAX_REQUESTS,
+    KRB5_RENEW_THRESHOLD,
+    KRB5_RENEW_MAX_PARALLEL,
 
     KRB5_OPTS
 };
@@ -82,6 +86,7 @@ struct krb5_service {
 struct fo_service;
 struct deferred_auth_ctx;
 struct renew_tgt_ctx;
+struct krb5_child_pool;
 
 enum krb5_config_type {
     K5C_GENERIC,
@@ -134,6 +139,9 @@ struct krb5_ctx {
 
     hash_table_t *wait_queue_hash;
 
+    /* NULL unless krb5_child_pool_size is set */
+    struct krb5_child_pool *child_pool;
+
     enum krb5_config_type config_type;
 
     struct map_id_name_to_krb_primary *name_to_primary;
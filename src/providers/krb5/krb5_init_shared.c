@@ -82,6 +82,12 @@ errno_t krb5_child_init(struct krb5_ctx *krb5_auth_ctx,
         goto done;
     }
 
+    ret = krb5_child_pool_init(krb5_auth_ctx, bectx->ev);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "krb5_child_pool_init failed.\n");
+        goto done;
+    }
+
     ret = EOK;
 
 done:
@@ -44,5 +44,9 @@ struct dp_option default_krb5_opts[] = {
     { "krb5_use_kdcinfo", DP_OPT_BOOL, BOOL_TRUE, BOOL_TRUE },
     { "krb5_kdcinfo_lookahead", DP_OPT_STRING, NULL_STRING, NULL_STRING },
     { "krb5_map_user", DP_OPT_STRING, NULL_STRING, NULL_STRING },
+    { "krb5_child_pool_size", DP_OPT_NUMBER, { .number = 0 }, NULL_NUMBER },
+    { "krb5_child_pool_max_requests", DP_OPT_NUMBER, { .number = 100 }, NULL_NUMBER },
+    { "krb5_renew_threshold", DP_OPT_NUMBER, { .number = 50 }, NULL_NUMBER },
+    { "krb5_renew_max_parallel", DP_OPT_NUMBER, { .number = 10 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
@@ -30,7 +30,15 @@
 #include "providers/krb5/krb5_ccache.h"
 
 #define INITIAL_TGT_TABLE_SIZE 10
-
+#define INITIAL_RENEW_HEAP_SIZE 16
+#define RENEW_NOT_QUEUED ((size_t) -1)
+#define DEFAULT_RENEW_THRESHOLD 50
+
+/* The TGTs waiting for renewal are kept in a binary min-heap ordered by the
+ * time the renewal should start. A single timer is armed for the earliest
+ * entry. When it fires all due entries are started, but never more than
+ * max_parallel at a time. The remaining due entries stay in the heap and are
+ * started when a running renewal finishes. */
 struct renew_tgt_ctx {
     hash_table_t *tgt_table;
     struct be_ctx *be_ctx;
@@ -38,53 +46,419 @@ struct renew_tgt_ctx {
     struct krb5_ctx *krb5_ctx;
     time_t timer_interval;
     struct tevent_timer *te;
+    time_t te_deadline;
+
+    struct renew_data **heap;
+    size_t heap_count;
+    size_t heap_size;
+
+    int renew_threshold;
+    int max_parallel;
+    size_t num_running;
+
+    uint64_t num_renewed;
+    uint64_t num_failed;
+    uint64_t total_latency_ms;
+    uint64_t max_latency_ms;
+    time_t max_delay;
+    time_t stats_logged_at;
 };
 
 struct renew_data {
+    struct renew_tgt_ctx *renew_tgt_ctx;
+    const char *upn;
     const char *ccfile;
     time_t start_time;
     time_t lifetime;
     time_t start_renew_at;
     struct pam_data *pd;
+
+    size_t heap_idx;
+    struct auth_data *auth_data;
 };
 
 struct auth_data {
+    struct renew_tgt_ctx *renew_tgt_ctx;
     struct be_ctx *be_ctx;
     struct krb5_ctx *krb5_ctx;
     struct pam_data *pd;
     struct renew_data *renew_data;
     hash_table_t *table;
     hash_key_t key;
+    struct timeval started;
 };
 
+static void renew_heap_swap(struct renew_tgt_ctx *ctx, size_t a, size_t b)
+{
+    struct renew_data *tmp;
+
+    tmp = ctx->heap[a];
+    ctx->heap[a] = ctx->heap[b];
+    ctx->heap[b] = tmp;
+
+    ctx->heap[a]->heap_idx = a;
+    ctx->heap[b]->heap_idx = b;
+}
+
+static void renew_heap_up(struct renew_tgt_ctx *ctx, size_t idx)
+{
+    size_t parent;
+
+    while (idx > 0) {
+        parent = (idx - 1) / 2;
+        if (ctx->heap[parent]->start_renew_at <= ctx->heap[idx]->start_renew_at) {
+            break;
+        }
+        renew_heap_swap(ctx, parent, idx);
+        idx = parent;
+    }
+}
+
+static void renew_heap_down(struct renew_tgt_ctx *ctx, size_t idx)
+{
+    size_t child;
+
+    while ((child = 2 * idx + 1) < ctx->heap_count) {
+        if (child + 1 < ctx->heap_count
+                && ctx->heap[child + 1]->start_renew_at
+                        < ctx->heap[child]->start_renew_at) {
+            child++;
+        }
+        if (ctx->heap[idx]->start_renew_at <= ctx->heap[child]->start_renew_at) {
+            break;
+        }
+        renew_heap_swap(ctx, idx, child);
+        idx = child;
+    }
+}
+
+static errno_t renew_heap_insert(struct renew_tgt_ctx *ctx,
+                                 struct renew_data *renew_data)
+{
+    struct renew_data **heap;
+    size_t size;
+
+    if (ctx->heap_count == ctx->heap_size) {
+        size = ctx->heap_size == 0 ? INITIAL_RENEW_HEAP_SIZE
+                                   : 2 * ctx->heap_size;
+        heap = talloc_realloc(ctx, ctx->heap, struct renew_data *, size);
+        if (heap == NULL) {
+            return ENOMEM;
+        }
+        ctx->heap = heap;
+        ctx->heap_size = size;
+    }
+
+    renew_data->heap_idx = ctx->heap_count;
+    ctx->heap[ctx->heap_count] = renew_data;
+    ctx->heap_count++;
+    renew_heap_up(ctx, renew_data->heap_idx);
+
+    return EOK;
+}
+
+static void renew_heap_remove(struct renew_tgt_ctx *ctx,
+                              struct renew_data *renew_data)
+{
+    size_t idx = renew_data->heap_idx;
+
+    if (idx == RENEW_NOT_QUEUED) {
+        return;
+    }
+
+    renew_data->heap_idx = RENEW_NOT_QUEUED;
+    ctx->heap_count--;
+    if (idx == ctx->heap_count) {
+        return;
+    }
+
+    ctx->heap[idx] = ctx->heap[ctx->heap_count];
+    ctx->heap[idx]->heap_idx = idx;
+    renew_heap_up(ctx, idx);
+    renew_heap_down(ctx, ctx->heap[idx]->heap_idx);
+}
+
+/* Number of heap entries which are due at now. Subtrees with a root in the
+ * future are skipped, so this only walks the due entries. */
+static size_t renew_heap_count_due(struct renew_tgt_ctx *ctx, size_t idx,
+                                   time_t now)
+{
+    if (idx >= ctx->heap_count || ctx->heap[idx]->start_renew_at > now) {
+        return 0;
+    }
+
+    return 1 + renew_heap_count_due(ctx, 2 * idx + 1, now)
+             + renew_heap_count_due(ctx, 2 * idx + 2, now);
+}
+
+struct renew_tgt_stats {
+    size_t num_queued;          /* TGTs waiting for their renewal time */
+    size_t num_waiting;         /* due TGTs waiting for a free slot */
+    size_t num_running;
+    uint64_t num_renewed;
+    uint64_t num_failed;
+    uint64_t avg_latency_ms;
+    uint64_t max_latency_ms;
+    time_t max_delay;           /* longest wait past the renewal time */
+};
+
+static errno_t get_renew_tgt_stats(struct krb5_ctx *krb5_ctx,
+                                   struct renew_tgt_stats *stats)
+{
+    struct renew_tgt_ctx *renew_tgt_ctx = krb5_ctx->renew_tgt_ctx;
+    uint64_t finished;
+
+    if (renew_tgt_ctx == NULL) {
+        return ENOENT;
+    }
+
+    memset(stats, 0, sizeof(struct renew_tgt_stats));
+    stats->num_queued = renew_tgt_ctx->heap_count;
+    stats->num_waiting = renew_heap_count_due(renew_tgt_ctx, 0, time(NULL));
+    stats->num_running = renew_tgt_ctx->num_running;
+    stats->num_renewed = renew_tgt_ctx->num_renewed;
+    stats->num_failed = renew_tgt_ctx->num_failed;
+    stats->max_latency_ms = renew_tgt_ctx->max_latency_ms;
+    stats->max_delay = renew_tgt_ctx->max_delay;
+
+    finished = renew_tgt_ctx->num_renewed + renew_tgt_ctx->num_failed;
+    if (finished > 0) {
+        stats->avg_latency_ms = renew_tgt_ctx->total_latency_ms / finished;
+    }
+
+    return EOK;
+}
+
+/* Called on every scheduling pass, the statistics are logged at most once
+ * per krb5_renew_interval so that they are also visible while renewals are
+ * continuously running. */
+static void renew_tgt_log_stats(struct renew_tgt_ctx *renew_tgt_ctx,
+                                time_t now)
+{
+    struct renew_tgt_stats stats;
+    errno_t ret;
+
+    if (renew_tgt_ctx->stats_logged_at != 0
+            && now - renew_tgt_ctx->stats_logged_at
+                    < renew_tgt_ctx->timer_interval) {
+        return;
+    }
+
+    ret = get_renew_tgt_stats(renew_tgt_ctx->krb5_ctx, &stats);
+    if (ret != EOK) {
+        return;
+    }
+    renew_tgt_ctx->stats_logged_at = now;
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "TGT renewals: [%"PRIu64"] succeeded, [%"PRIu64"] failed, "
+          "latency avg [%"PRIu64"] ms max [%"PRIu64"] ms, longest delay "
+          "[%ld] s, [%zu] running, [%zu] waiting for a free slot, [%zu] "
+          "TGTs queued.\n",
+          stats.num_renewed, stats.num_failed, stats.avg_latency_ms,
+          stats.max_latency_ms, (long) stats.max_delay, stats.num_running,
+          stats.num_waiting, stats.num_queued);
+}
+
+static int renew_tgt_ctx_destructor(struct renew_tgt_ctx *ctx)
+{
+    /* The heap is freed together with the renewal items, there is no need
+     * to keep it in order. */
+    ctx->heap = NULL;
+    ctx->heap_count = 0;
+    talloc_zfree(ctx->te);
+
+    return 0;
+}
+
+static int renew_data_destructor(struct renew_data *renew_data)
+{
+    if (renew_data->renew_tgt_ctx->heap != NULL) {
+        renew_heap_remove(renew_data->renew_tgt_ctx, renew_data);
+    }
+
+    if (renew_data->auth_data != NULL) {
+        renew_data->auth_data->renew_data = NULL;
+    }
+
+    return 0;
+}
+
+static int auth_data_destructor(struct auth_data *auth_data)
+{
+    if (auth_data->renew_data != NULL) {
+        auth_data->renew_data->auth_data = NULL;
+    }
+
+    return 0;
+}
+
+static void renew_tgt_timer_handler(struct tevent_context *ev,
+                                    struct tevent_timer *te,
+                                    struct timeval current_time, void *data);
+
+/* Makes sure the timer fires for the earliest entry of the heap. If all
+ * renewal slots are busy no timer is needed, the next finished renewal will
+ * start the waiting ones. */
+static void renew_tgt_arm_timer(struct renew_tgt_ctx *renew_tgt_ctx)
+{
+    time_t deadline;
+
+    if (renew_tgt_ctx->heap_count == 0
+            || (renew_tgt_ctx->max_parallel > 0
+                && renew_tgt_ctx->num_running
+                        >= renew_tgt_ctx->max_parallel)) {
+        talloc_zfree(renew_tgt_ctx->te);
+        return;
+    }
+
+    deadline = renew_tgt_ctx->heap[0]->start_renew_at;
+    if (renew_tgt_ctx->te != NULL) {
+        if (renew_tgt_ctx->te_deadline <= deadline) {
+            return;
+        }
+        talloc_zfree(renew_tgt_ctx->te);
+    }
+
+    renew_tgt_ctx->te = tevent_add_timer(renew_tgt_ctx->ev, renew_tgt_ctx,
+                                         tevent_timeval_set(deadline, 0),
+                                         renew_tgt_timer_handler,
+                                         renew_tgt_ctx);
+    if (renew_tgt_ctx->te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed, the renewal "
+              "will be retried when the next TGT is added.\n");
+        return;
+    }
+    renew_tgt_ctx->te_deadline = deadline;
+
+    DEBUG(SSSDBG_TRACE_ALL, "Next TGT renewal at [%.24s].\n",
+          ctime(&deadline));
+}
+
+/* Puts the renewal item back into the heap after a renewal which failed for
+ * a temporary reason. It is retried after krb5_renew_interval. */
+static void renew_tgt_retry(struct auth_data *auth_data)
+{
+    struct renew_data *renew_data = auth_data->renew_data;
+    int ret;
+
+    if (renew_data == NULL) {
+        /* The item was replaced or removed meanwhile. */
+        return;
+    }
+
+    DEBUG(SSSDBG_FUNC_DATA, "Giving back pam data.\n");
+    renew_data->pd = talloc_steal(renew_data, auth_data->pd);
+    renew_data->start_renew_at = time(NULL)
+                                 + auth_data->renew_tgt_ctx->timer_interval;
+
+    ret = renew_heap_insert(auth_data->renew_tgt_ctx, renew_data);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Failed to requeue [%s] for renewal.\n", renew_data->ccfile);
+        ret = hash_delete(auth_data->table, &auth_data->key);
+        if (ret != HASH_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "hash_delete failed.\n");
+        }
+    }
+}
+
+static void renew_tgt_update_stats(struct renew_tgt_ctx *renew_tgt_ctx,
+                                   struct auth_data *auth_data,
+                                   bool success)
+{
+    struct timeval now;
+    struct timeval diff;
+    uint64_t latency_ms;
+
+    now = tevent_timeval_current();
+    diff = tevent_timeval_until(&auth_data->started, &now);
+    latency_ms = diff.tv_sec * 1000 + diff.tv_usec / 1000;
+
+    if (success) {
+        renew_tgt_ctx->num_renewed++;
+    } else {
+        renew_tgt_ctx->num_failed++;
+    }
+    renew_tgt_ctx->total_latency_ms += latency_ms;
+    renew_tgt_ctx->max_latency_ms = MAX(renew_tgt_ctx->max_latency_ms,
+                                        latency_ms);
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Renewal for user [%s] took [%"PRIu64"] ms, [%zu] renewals "
+          "running, [%zu] waiting.\n", auth_data->pd->user, latency_ms,
+          renew_tgt_ctx->num_running,
+          renew_heap_count_due(renew_tgt_ctx, 0, now.tv_sec));
+}
 
+static void renew_tgt_schedule(struct renew_tgt_ctx *renew_tgt_ctx);
 static void renew_tgt_done(struct tevent_req *req);
-static void renew_tgt(struct tevent_context *ev, struct tevent_timer *te,
-                      struct timeval current_time, void *private_data)
+
+static errno_t renew_tgt(struct renew_tgt_ctx *renew_tgt_ctx,
+                         struct renew_data *renew_data,
+                         time_t now)
 {
-    struct auth_data *auth_data = talloc_get_type(private_data,
-                                                  struct auth_data);
+    struct auth_data *auth_data;
     struct tevent_req *req;
 
-    req = krb5_auth_queue_send(auth_data, ev, auth_data->be_ctx, auth_data->pd,
+    auth_data = talloc_zero(renew_tgt_ctx, struct auth_data);
+    if (auth_data == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
+        return ENOMEM;
+    }
+
+/* We need to steal the pam_data here, because a successful renewal of the
+ * ticket might add a new renewal item to the list with the same key (upn).
+ * This would delete renew_data and all its children. But we cannot be sure
+ * that adding the new renewal item is the last operation of the renewal
+ * process with access the pam_data. To be on the safe side we steal the
+ * pam_data and make it a child of auth_data which is only freed after the
+ * renewal process is finished. In the case of an error during renewal we
+ * might want to steal the pam_data back to renew_data before freeing
+ * auth_data to allow a new renewal attempt. */
+    auth_data->pd = talloc_move(auth_data, &renew_data->pd);
+    auth_data->renew_tgt_ctx = renew_tgt_ctx;
+    auth_data->krb5_ctx = renew_tgt_ctx->krb5_ctx;
+    auth_data->be_ctx = renew_tgt_ctx->be_ctx;
+    auth_data->table = renew_tgt_ctx->tgt_table;
+    auth_data->renew_data = renew_data;
+    auth_data->started = tevent_timeval_current();
+    auth_data->key.type = HASH_KEY_STRING;
+    auth_data->key.str = talloc_strdup(auth_data, renew_data->upn);
+    if (auth_data->key.str == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_strdup failed.\n");
+        renew_data->pd = talloc_steal(renew_data, auth_data->pd);
+        talloc_free(auth_data);
+        return ENOMEM;
+    }
+
+    renew_data->auth_data = auth_data;
+    talloc_set_destructor(auth_data, auth_data_destructor);
+
+    req = krb5_auth_queue_send(auth_data, renew_tgt_ctx->ev,
+                               auth_data->be_ctx, auth_data->pd,
                                auth_data->krb5_ctx);
     if (req == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "krb5_auth_send failed.\n");
-/* Give back the pam data to the renewal item to be able to retry at the next
- * time the renewals re run. */
-        auth_data->renew_data->pd = talloc_steal(auth_data->renew_data,
-                                                 auth_data->pd);
+        renew_data->pd = talloc_steal(renew_data, auth_data->pd);
         talloc_free(auth_data);
-        return;
+        return ENOMEM;
     }
 
     tevent_req_set_callback(req, renew_tgt_done, auth_data);
+
+    renew_tgt_ctx->num_running++;
+    renew_tgt_ctx->max_delay = MAX(renew_tgt_ctx->max_delay,
+                                   now - renew_data->start_renew_at);
+
+    return EOK;
 }
 
 static void renew_tgt_done(struct tevent_req *req)
 {
     struct auth_data *auth_data = tevent_req_callback_data(req,
                                                            struct auth_data);
+    struct renew_tgt_ctx *renew_tgt_ctx = auth_data->renew_tgt_ctx;
     int ret;
     int pam_status = PAM_SYSTEM_ERR;
     int dp_err;
@@ -92,13 +466,12 @@ static void renew_tgt_done(struct tevent_req *req)
 
     ret = krb5_auth_queue_recv(req, &pam_status, &dp_err);
     talloc_free(req);
+    renew_tgt_ctx->num_running--;
+    renew_tgt_update_stats(renew_tgt_ctx, auth_data,
+                           ret == EOK && pam_status == PAM_SUCCESS);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, "krb5_auth request failed.\n");
-        if (auth_data->renew_data != NULL) {
-            DEBUG(SSSDBG_FUNC_DATA, "Giving back pam data.\n");
-            auth_data->renew_data->pd = talloc_steal(auth_data->renew_data,
-                                                     auth_data->pd);
-        }
+        renew_tgt_retry(auth_data);
     } else {
         switch (pam_status) {
             case PAM_SUCCESS:
@@ -133,104 +506,83 @@ static void renew_tgt_done(struct tevent_req *req)
                       "Cannot renewed TGT for user [%s] while offline, "
                           "will retry later.\n",
                           auth_data->pd->user);
-                if (auth_data->renew_data != NULL) {
-                    DEBUG(SSSDBG_FUNC_DATA, "Giving back pam data.\n");
-                    auth_data->renew_data->pd = talloc_steal(auth_data->renew_data,
-                                                             auth_data->pd);
-                }
+                renew_tgt_retry(auth_data);
                 break;
             default:
                 DEBUG(SSSDBG_CRIT_FAILURE,
                       "Failed to renew TGT for user [%s].\n",
                           auth_data->pd->user);
-                ret = hash_delete(auth_data->table, &auth_data->key);
-                if (ret != HASH_SUCCESS) {
-                    DEBUG(SSSDBG_CRIT_FAILURE, "hash_delete failed.\n");
+                /* Do not remove a renewal item which was added for a new
+                 * TGT meanwhile. */
+                if (auth_data->renew_data != NULL) {
+                    ret = hash_delete(auth_data->table, &auth_data->key);
+                    if (ret != HASH_SUCCESS) {
+                        DEBUG(SSSDBG_CRIT_FAILURE, "hash_delete failed.\n");
+                    }
                 }
         }
     }
 
     talloc_zfree(auth_data);
+
+    renew_tgt_schedule(renew_tgt_ctx);
 }
 
-static errno_t renew_all_tgts(struct renew_tgt_ctx *renew_tgt_ctx)
+/* Starts the renewal of all due TGTs as long as there are free slots and
+ * arms the timer for the next one. */
+static void renew_tgt_schedule(struct renew_tgt_ctx *renew_tgt_ctx)
 {
-    int ret;
-    hash_entry_t *entries;
-    unsigned long count;
-    size_t c;
-    time_t now;
-    struct auth_data *auth_data;
     struct renew_data *renew_data;
-    struct tevent_timer *te = NULL;
+    hash_key_t key;
+    time_t now;
+    int ret;
 
-    ret = hash_entries(renew_tgt_ctx->tgt_table, &count, &entries);
-    if (ret != HASH_SUCCESS) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "hash_entries failed.\n");
-        return ENOMEM;
+    if (be_is_offline(renew_tgt_ctx->be_ctx)) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Offline, disable renew timer.\n");
+        talloc_zfree(renew_tgt_ctx->te);
+        return;
     }
 
     now = time(NULL);
 
-    for (c = 0; c < count; c++) {
-        renew_data = talloc_get_type(entries[c].value.ptr, struct renew_data);
-        DEBUG(SSSDBG_TRACE_ALL,
-              "Checking [%s] for renewal at [%.24s].\n", renew_data->ccfile,
-                  ctime(&renew_data->start_renew_at));
-        /* If renew_data->pd == NULL a renewal request for this data is
-         * currently running so we skip it. */
-        if (renew_data->start_renew_at < now && renew_data->pd != NULL) {
-            auth_data = talloc_zero(renew_tgt_ctx, struct auth_data);
-            if (auth_data == NULL) {
-                DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
-            } else {
-/* We need to steal the pam_data here, because a successful renewal of the
- * ticket might add a new renewal item to the list with the same key (upn).
- * This would delete renew_data and all its children. But we cannot be sure
- * that adding the new renewal item is the last operation of the renewal
- * process with access the pam_data. To be on the safe side we steal the
- * pam_data and make it a child of auth_data which is only freed after the
- * renewal process is finished. In the case of an error during renewal we
- * might want to steal the pam_data back to renew_data before freeing
- * auth_data to allow a new renewal attempt. */
-                auth_data->pd = talloc_move(auth_data, &renew_data->pd);
-                auth_data->krb5_ctx = renew_tgt_ctx->krb5_ctx;
-                auth_data->be_ctx = renew_tgt_ctx->be_ctx;
-                auth_data->table = renew_tgt_ctx->tgt_table;
-                auth_data->renew_data = renew_data;
-                auth_data->key.type = entries[c].key.type;
-                auth_data->key.str = talloc_strdup(auth_data,
-                                                   entries[c].key.str);
-                if (auth_data->key.str == NULL) {
-                    DEBUG(SSSDBG_CRIT_FAILURE, "talloc_strdup failed.\n");
-                } else {
-                    te = tevent_add_timer(renew_tgt_ctx->ev,
-                                          auth_data, tevent_timeval_current(),
-                                          renew_tgt, auth_data);
-                    if (te == NULL) {
-                        DEBUG(SSSDBG_CRIT_FAILURE,
-                              "tevent_add_timer failed.\n");
-                    }
-                }
-            }
+    while (renew_tgt_ctx->heap_count > 0
+            && (renew_tgt_ctx->max_parallel == 0
+                || renew_tgt_ctx->num_running
+                        < renew_tgt_ctx->max_parallel)) {
+        renew_data = renew_tgt_ctx->heap[0];
+        if (renew_data->start_renew_at > now) {
+            break;
+        }
 
-            if (auth_data == NULL || te == NULL) {
-                DEBUG(SSSDBG_CRIT_FAILURE,
-                      "Failed to renew TGT in [%s].\n", renew_data->ccfile);
-                ret = hash_delete(renew_tgt_ctx->tgt_table, &entries[c].key);
-                if (ret != HASH_SUCCESS) {
-                    DEBUG(SSSDBG_CRIT_FAILURE, "hash_delete failed.\n");
-                }
+        DEBUG(SSSDBG_TRACE_ALL, "Renewing [%s], scheduled for [%.24s].\n",
+              renew_data->ccfile, ctime(&renew_data->start_renew_at));
+
+        renew_heap_remove(renew_tgt_ctx, renew_data);
+        ret = renew_tgt(renew_tgt_ctx, renew_data, now);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  "Failed to renew TGT in [%s].\n", renew_data->ccfile);
+            key.type = HASH_KEY_STRING;
+            key.str = discard_const_p(char, renew_data->upn);
+            ret = hash_delete(renew_tgt_ctx->tgt_table, &key);
+            if (ret != HASH_SUCCESS) {
+                DEBUG(SSSDBG_CRIT_FAILURE, "hash_delete failed.\n");
             }
         }
     }
 
-    talloc_free(entries);
+    if (renew_tgt_ctx->max_parallel > 0
+            && renew_tgt_ctx->num_running >= renew_tgt_ctx->max_parallel) {
+        DEBUG(SSSDBG_TRACE_LIBS,
+              "[%zu] renewals running, [%zu] waiting for a free slot.\n",
+              renew_tgt_ctx->num_running,
+              renew_heap_count_due(renew_tgt_ctx, 0, now));
+    }
 
-    return EOK;
-}
+    renew_tgt_log_stats(renew_tgt_ctx, now);
 
-static void renew_handler(struct renew_tgt_ctx *renew_tgt_ctx);
+    renew_tgt_arm_timer(renew_tgt_ctx);
+}
 
 static void renew_tgt_offline_callback(void *private_data)
 {
@@ -245,7 +597,7 @@ static void renew_tgt_online_callback(void *private_data)
     struct renew_tgt_ctx *renew_tgt_ctx = talloc_get_type(private_data,
                                                           struct renew_tgt_ctx);
 
-    renew_handler(renew_tgt_ctx);
+    renew_tgt_schedule(renew_tgt_ctx);
 }
 
 static void renew_tgt_timer_handler(struct tevent_context *ev,
@@ -258,48 +610,7 @@ static void renew_tgt_timer_handler(struct tevent_context *ev,
     /* forget the timer event, it will be freed by the tevent timer loop */
     renew_tgt_ctx->te = NULL;
 
-    renew_handler(renew_tgt_ctx);
-}
-
-static void renew_handler(struct renew_tgt_ctx *renew_tgt_ctx)
-{
-    struct timeval next;
-    int ret;
-
-    if (be_is_offline(renew_tgt_ctx->be_ctx)) {
-        DEBUG(SSSDBG_CONF_SETTINGS, "Offline, disable renew timer.\n");
-        return;
-    }
-
-    ret = renew_all_tgts(renew_tgt_ctx);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "renew_all_tgts failed. "
-                  "Disabling automatic TGT renewal\n");
-        sss_log(SSS_LOG_ERR, "Disabling automatic TGT renewal.");
-        talloc_zfree(renew_tgt_ctx);
-        return;
-    }
-
-    if (renew_tgt_ctx->te != NULL) {
-        DEBUG(SSSDBG_TRACE_LIBS,
-              "There is an active renewal timer, doing nothing.\n");
-        return;
-    }
-
-    DEBUG(SSSDBG_TRACE_LIBS, "Adding new renew timer.\n");
-
-    next = tevent_timeval_current_ofs(renew_tgt_ctx->timer_interval,
-                                      0);
-    renew_tgt_ctx->te = tevent_add_timer(renew_tgt_ctx->ev, renew_tgt_ctx,
-                                         next, renew_tgt_timer_handler,
-                                         renew_tgt_ctx);
-    if (renew_tgt_ctx->te == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
-        sss_log(SSS_LOG_ERR, "Disabling automatic TGT renewal.");
-        talloc_zfree(renew_tgt_ctx);
-    }
-
-    return;
+    renew_tgt_schedule(renew_tgt_ctx);
 }
 
 static void renew_del_cb(hash_entry_t *entry, hash_destroy_enum type, void *pvt)
@@ -476,13 +787,29 @@ errno_t init_renew_tgt(struct krb5_ctx *krb5_ctx, struct be_ctx *be_ctx,
                        struct tevent_context *ev, time_t renew_intv)
 {
     int ret;
-    struct timeval next;
+    int threshold;
+    int max_parallel;
+
+    threshold = dp_opt_get_int(krb5_ctx->opts, KRB5_RENEW_THRESHOLD);
+    if (threshold <= 0 || threshold >= 100) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Invalid value [%d] of krb5_renew_threshold, "
+              "using [%d].\n", threshold, DEFAULT_RENEW_THRESHOLD);
+        threshold = DEFAULT_RENEW_THRESHOLD;
+    }
+
+    max_parallel = dp_opt_get_int(krb5_ctx->opts, KRB5_RENEW_MAX_PARALLEL);
+    if (max_parallel < 0) {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Invalid value [%d] of "
+              "krb5_renew_max_parallel, no limit is used.\n", max_parallel);
+        max_parallel = 0;
+    }
 
     krb5_ctx->renew_tgt_ctx = talloc_zero(krb5_ctx, struct renew_tgt_ctx);
     if (krb5_ctx->renew_tgt_ctx == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc_zero failed.\n");
         return ENOMEM;
     }
+    talloc_set_destructor(krb5_ctx->renew_tgt_ctx, renew_tgt_ctx_destructor);
 
     ret = sss_hash_create_ex(krb5_ctx->renew_tgt_ctx, INITIAL_TGT_TABLE_SIZE,
                              &krb5_ctx->renew_tgt_ctx->tgt_table, 0, 0, 0, 0,
@@ -496,6 +823,8 @@ errno_t init_renew_tgt(struct krb5_ctx *krb5_ctx, struct be_ctx *be_ctx,
     krb5_ctx->renew_tgt_ctx->krb5_ctx = krb5_ctx;
     krb5_ctx->renew_tgt_ctx->ev = ev;
     krb5_ctx->renew_tgt_ctx->timer_interval = renew_intv;
+    krb5_ctx->renew_tgt_ctx->renew_threshold = threshold;
+    krb5_ctx->renew_tgt_ctx->max_parallel = max_parallel;
 
     ret = check_ccache_files(krb5_ctx->renew_tgt_ctx);
     if (ret != EOK) {
@@ -503,17 +832,6 @@ errno_t init_renew_tgt(struct krb5_ctx *krb5_ctx, struct be_ctx *be_ctx,
               "Failed to read ccache files, continuing ...\n");
     }
 
-    next = tevent_timeval_current_ofs(krb5_ctx->renew_tgt_ctx->timer_interval,
-                                      0);
-    krb5_ctx->renew_tgt_ctx->te = tevent_add_timer(ev, krb5_ctx->renew_tgt_ctx,
-                                                   next, renew_tgt_timer_handler,
-                                                   krb5_ctx->renew_tgt_ctx);
-    if (krb5_ctx->renew_tgt_ctx->te == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
-        ret = ENOMEM;
-        goto fail;
-    }
-
     DEBUG(SSSDBG_TRACE_LIBS,
           "Adding offline callback to remove renewal timer.\n");
     ret = be_add_offline_cb(krb5_ctx->renew_tgt_ctx, be_ctx,
@@ -578,6 +896,9 @@ errno_t add_tgt_to_renew_table(struct krb5_ctx *krb5_ctx, const char *ccfile,
         ret = ENOMEM;
         goto done;
     }
+    renew_data->renew_tgt_ctx = krb5_ctx->renew_tgt_ctx;
+    renew_data->heap_idx = RENEW_NOT_QUEUED;
+    talloc_set_destructor(renew_data, renew_data_destructor);
 
     if (ccfile[0] == '/') {
         renew_data->ccfile = talloc_asprintf(renew_data, "FILE:%s", ccfile);
@@ -590,10 +911,18 @@ errno_t add_tgt_to_renew_table(struct krb5_ctx *krb5_ctx, const char *ccfile,
         renew_data->ccfile = talloc_strdup(renew_data, ccfile);
     }
 
+    renew_data->upn = talloc_strdup(renew_data, upn);
+    if (renew_data->upn == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "talloc_strdup failed.\n");
+        ret = ENOMEM;
+        goto done;
+    }
+
     renew_data->start_time = tgtt->starttime;
     renew_data->lifetime = tgtt->endtime;
-    renew_data->start_renew_at = (time_t) (tgtt->starttime +
-                                        0.5 *(tgtt->endtime - tgtt->starttime));
+    renew_data->start_renew_at = tgtt->starttime
+                            + (tgtt->endtime - tgtt->starttime)
+                                * krb5_ctx->renew_tgt_ctx->renew_threshold / 100;
 
     ret = copy_pam_data(renew_data, pd, &renew_data->pd);
     if (ret != EOK) {
@@ -621,10 +950,26 @@ errno_t add_tgt_to_renew_table(struct krb5_ctx *krb5_ctx, const char *ccfile,
         goto done;
     }
 
+    /* hash_enter() already owns renew_data, if it cannot be queued it is
+     * removed from the table again. */
+    ret = renew_heap_insert(krb5_ctx->renew_tgt_ctx, renew_data);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to queue [%s] for renewal.\n",
+              renew_data->ccfile);
+        renew_data = NULL;
+        if (hash_delete(krb5_ctx->renew_tgt_ctx->tgt_table,
+                        &key) != HASH_SUCCESS) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "hash_delete failed.\n");
+        }
+        goto done;
+    }
+
     DEBUG(SSSDBG_TRACE_LIBS,
           "Added [%s] for renewal at [%.24s].\n", renew_data->ccfile,
                                            ctime(&renew_data->start_renew_at));
 
+    renew_tgt_arm_timer(krb5_ctx->renew_tgt_ctx);
+
     ret = EOK;
 
 done:
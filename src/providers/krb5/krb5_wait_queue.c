@@ -1,7 +1,8 @@
 /*
     SSSD
 
-    Kerberos 5 Backend Module - Serialize the request of a user
+    Kerberos 5 Backend Module - Serialize the request of a user and share
+                                the result of identical requests
 
     Authors:
         Sumit Bose <sbose@redhat.com>
@@ -40,6 +41,9 @@ struct queue_entry {
     struct tevent_req *parent_req;
     struct pam_data *pd;
     struct krb5_ctx *krb5_ctx;
+
+    /* Waits for the result of the running request instead of running */
+    bool share_result;
 };
 
 static void wait_queue_auth_done(struct tevent_req *req);
@@ -47,6 +51,136 @@ static void wait_queue_auth_done(struct tevent_req *req);
 static void krb5_auth_queue_finish(struct tevent_req *req, errno_t ret,
                                    int pam_status, int dp_err);
 
+static void krb5_auth_queue_complete(struct tevent_req *req, errno_t ret,
+                                     int pam_status, int dp_err);
+
+/* Returns true if the template expands '%P', the PID of the client, which
+ * is the only part of the credential cache name taken from the request. */
+static bool ccname_template_has_pid(const char *ccname_template)
+{
+    const char *p;
+
+    if (ccname_template == NULL) {
+        return false;
+    }
+
+    for (p = ccname_template; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+
+        p++;
+        if (*p == 'P') {
+            return true;
+        } else if (*p == '\0') {
+            break;
+        }
+    }
+
+    return false;
+}
+
+/* Compares the tokens in a time that does not depend on where they
+ * differ. */
+static bool wait_queue_authtok_equal(const uint8_t *a, const uint8_t *b,
+                                     size_t size)
+{
+    volatile uint8_t diff = 0;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        diff |= a[i] ^ b[i];
+    }
+
+    return diff == 0;
+}
+
+/* Only plain password or Smartcard PIN authentications with identical
+ * credentials and the same credential cache name can share a result.
+ * Tokens with a one-time second factor, OAUTH2 or passkey data are only
+ * valid once. Everything else writes a credential cache of its own or
+ * changes the password and must run on its own, one request after the
+ * other. */
+static bool wait_queue_can_share(struct krb5_ctx *krb5_ctx,
+                                 struct pam_data *running,
+                                 struct pam_data *pd)
+{
+    enum sss_authtok_type type;
+    size_t size;
+
+    if (running == NULL || pd == NULL) {
+        return false;
+    }
+
+    if (running->cli_pid != pd->cli_pid
+            && ccname_template_has_pid(dp_opt_get_cstring(krb5_ctx->opts,
+                                                          KRB5_CCNAME_TMPL))) {
+        return false;
+    }
+
+    if (running->cmd != SSS_PAM_AUTHENTICATE
+            || pd->cmd != SSS_PAM_AUTHENTICATE) {
+        return false;
+    }
+
+    if ((running->domain == NULL) != (pd->domain == NULL)
+            || (pd->domain != NULL
+                    && strcmp(running->domain, pd->domain) != 0)) {
+        return false;
+    }
+
+    if (running->authtok == NULL || pd->authtok == NULL) {
+        return false;
+    }
+
+    type = sss_authtok_get_type(pd->authtok);
+    if (type != SSS_AUTHTOK_TYPE_PASSWORD && type != SSS_AUTHTOK_TYPE_SC_PIN) {
+        return false;
+    }
+
+    if (type != sss_authtok_get_type(running->authtok)) {
+        return false;
+    }
+
+    size = sss_authtok_get_size(pd->authtok);
+    if (size != sss_authtok_get_size(running->authtok)) {
+        return false;
+    }
+
+    return wait_queue_authtok_equal(sss_authtok_get_data(running->authtok),
+                                    sss_authtok_get_data(pd->authtok), size);
+}
+
+/* Adds the responses of src to dst, keeping their order. */
+static errno_t wait_queue_copy_responses(struct pam_data *dst,
+                                         struct pam_data *src)
+{
+    struct response_data *resp;
+    struct response_data *new;
+    struct response_data **tail;
+    errno_t ret;
+
+    for (tail = &dst->resp_list; *tail != NULL; tail = &(*tail)->next);
+
+    for (resp = src->resp_list; resp != NULL; resp = resp->next) {
+        ret = pam_add_response(dst, resp->type, resp->len, resp->data);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        /* pam_add_response() adds at the start, move it to the end */
+        new = dst->resp_list;
+        dst->resp_list = new->next;
+        new->next = NULL;
+        new->do_not_send_to_client = resp->do_not_send_to_client;
+
+        *tail = new;
+        tail = &new->next;
+    }
+
+    return EOK;
+}
+
 static void wait_queue_auth(struct tevent_context *ev, struct tevent_timer *te,
                             struct timeval current_time, void *private_data)
 {
@@ -141,6 +275,8 @@ static errno_t add_to_wait_queue(struct be_ctx *be_ctx,
             queue_entry->parent_req = parent_req;
             queue_entry->pd = pd;
             queue_entry->krb5_ctx = krb5_ctx;
+            queue_entry->share_result = wait_queue_can_share(krb5_ctx,
+                                                             head->pd, pd);
 
             DLIST_ADD_END(head, queue_entry, struct queue_entry *);
 
@@ -153,6 +289,8 @@ static errno_t add_to_wait_queue(struct be_ctx *be_ctx,
                 return ENOMEM;
             }
             value.ptr = head;
+            /* The head keeps the data of the running request */
+            head->pd = pd;
 
             ret = hash_enter(krb5_ctx->wait_queue_hash, &key, &value);
             if (ret != HASH_SUCCESS) {
@@ -209,6 +347,7 @@ static void check_wait_queue(struct krb5_ctx *krb5_ctx, char *username)
                 queue_entry = head->next;
 
                 DLIST_REMOVE(head, queue_entry);
+                head->pd = queue_entry->pd;
 
                 te = tevent_add_timer(queue_entry->be_ctx->ev, krb5_ctx,
                                       tevent_timeval_current(), wait_queue_auth,
@@ -239,6 +378,83 @@ static void check_wait_queue(struct krb5_ctx *krb5_ctx, char *username)
     return;
 }
 
+/* Hands the result of the request which ran for pd to all requests which
+ * were waiting for it. If the request failed they run on their own. */
+static void share_wait_queue_result(struct krb5_ctx *krb5_ctx,
+                                    struct pam_data *pd,
+                                    errno_t result,
+                                    int pam_status,
+                                    int dp_err)
+{
+    int ret;
+    hash_key_t key;
+    hash_value_t value;
+    struct queue_entry *head;
+    struct queue_entry *queue_entry;
+    struct queue_entry *next;
+    errno_t copy_ret;
+
+    if (krb5_ctx->wait_queue_hash == NULL) {
+        return;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = pd->user;
+
+    ret = hash_lookup(krb5_ctx->wait_queue_hash, &key, &value);
+    if (ret != HASH_SUCCESS || value.type != HASH_VALUE_PTR) {
+        return;
+    }
+
+    head = talloc_get_type(value.ptr, struct queue_entry);
+    if (head->pd != pd) {
+        /* The request did not run from the wait queue */
+        return;
+    }
+    head->pd = NULL;
+
+    for (queue_entry = head->next; queue_entry != NULL; queue_entry = next) {
+        next = queue_entry->next;
+
+        if (!queue_entry->share_result) {
+            continue;
+        }
+        queue_entry->share_result = false;
+
+        if (result != EOK) {
+            DEBUG(SSSDBG_TRACE_LIBS,
+                  "Request [%p] of user [%s] will run on its own.\n",
+                  queue_entry->parent_req, pd->user);
+            continue;
+        }
+
+        DLIST_REMOVE(head, queue_entry);
+
+        copy_ret = EOK;
+        if (queue_entry->pd != pd) {
+            queue_entry->pd->offline_auth = pd->offline_auth;
+            queue_entry->pd->account_locked = pd->account_locked;
+            copy_ret = wait_queue_copy_responses(queue_entry->pd, pd);
+            if (copy_ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      "Failed to copy PAM responses [%d]: %s\n",
+                      copy_ret, sss_strerror(copy_ret));
+            }
+        }
+
+        DEBUG(SSSDBG_TRACE_LIBS,
+              "Request [%p] of user [%s] shares the result of the running "
+              "request.\n", queue_entry->parent_req, pd->user);
+
+        /* The callbacks must not run while the wait queue is processed. */
+        tevent_req_defer_callback(queue_entry->parent_req,
+                                  queue_entry->be_ctx->ev);
+        krb5_auth_queue_complete(queue_entry->parent_req, copy_ret,
+                                 pam_status, dp_err);
+        talloc_free(queue_entry);
+    }
+}
+
 struct krb5_auth_queue_state {
     struct krb5_ctx *krb5_ctx;
     struct pam_data *pd;
@@ -313,17 +529,11 @@ static void krb5_auth_queue_done(struct tevent_req *subreq)
 
     ret = krb5_auth_recv(subreq, &state->pam_status, &state->dp_err);
     talloc_zfree(subreq);
-
-    check_wait_queue(state->krb5_ctx, state->pd->user);
-
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "krb5_auth_recv failed with: %d\n", ret);
-        tevent_req_error(req, ret);
-        return;
     }
 
-    DEBUG(SSSDBG_TRACE_LIBS, "krb5_auth_queue request [%p] done.\n", req);
-    tevent_req_done(req);
+    krb5_auth_queue_finish(req, ret, state->pam_status, state->dp_err);
 }
 
 /* This is a violation of the tevent_req style. Ideally, the wait queue would
@@ -339,8 +549,22 @@ static void krb5_auth_queue_finish(struct tevent_req *req,
     struct krb5_auth_queue_state *state = \
                 tevent_req_data(req, struct krb5_auth_queue_state);
 
+    share_wait_queue_result(state->krb5_ctx, state->pd, ret,
+                            pam_status, dp_err);
+
     check_wait_queue(state->krb5_ctx, state->pd->user);
 
+    krb5_auth_queue_complete(req, ret, pam_status, dp_err);
+}
+
+static void krb5_auth_queue_complete(struct tevent_req *req,
+                                     errno_t ret,
+                                     int pam_status,
+                                     int dp_err)
+{
+    struct krb5_auth_queue_state *state = \
+                tevent_req_data(req, struct krb5_auth_queue_state);
+
     state->pam_status = pam_status;
     state->dp_err = dp_err;
     if (ret != EOK) {
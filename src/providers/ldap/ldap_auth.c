@@ -1004,6 +1004,51 @@ immediately:
     return req;
 }
 
+static void sdap_pam_auth_cache_password_done(struct tevent_req *req)
+{
+    const char *username = (const char *) tevent_req_callback_data_void(req);
+    errno_t ret;
+
+    ret = sysdb_cache_password_recv(req);
+    /* password caching failures are not fatal errors */
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to cache password for %s\n",
+              username);
+    } else {
+        DEBUG(SSSDBG_CONF_SETTINGS, "Password successfully cached for %s\n",
+              username);
+    }
+
+    talloc_free(req);
+}
+
+/* The password is hashed and stored after the reply is sent, the request
+ * is owned by be_ctx. */
+static errno_t sdap_pam_auth_cache_password(struct be_ctx *be_ctx,
+                                            const char *username,
+                                            const char *password)
+{
+    struct tevent_req *req;
+    const char *name;
+
+    req = sysdb_cache_password_send(be_ctx, be_ctx->ev, be_ctx->crypt_pool,
+                                    be_ctx->domain, username, password,
+                                    SSS_AUTHTOK_TYPE_PASSWORD, 0);
+    if (req == NULL) {
+        return ENOMEM;
+    }
+
+    name = talloc_strdup(req, username);
+    if (name == NULL) {
+        talloc_free(req);
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(req, sdap_pam_auth_cache_password_done,
+                            discard_const(name));
+    return EOK;
+}
+
 static void sdap_pam_auth_handler_done(struct tevent_req *subreq)
 {
     struct sdap_pam_auth_handler_state *state;
@@ -1066,17 +1111,14 @@ static void sdap_pam_auth_handler_done(struct tevent_req *subreq)
     if (ret == EOK && state->be_ctx->domain->cache_credentials) {
         ret = sss_authtok_get_password(state->pd->authtok, &password, NULL);
         if (ret == EOK) {
-            ret = sysdb_cache_password(state->be_ctx->domain, state->pd->user,
-                                       password);
+            ret = sdap_pam_auth_cache_password(state->be_ctx, state->pd->user,
+                                               password);
         }
 
         /* password caching failures are not fatal errors */
         if (ret != EOK) {
             DEBUG(SSSDBG_OP_FAILURE, "Failed to cache password for %s\n",
                   state->pd->user);
-        } else {
-            DEBUG(SSSDBG_CONF_SETTINGS, "Password successfully cached for %s\n",
-                  state->pd->user);
         }
     }
 
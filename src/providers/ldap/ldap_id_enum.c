@@ -108,7 +108,8 @@ errno_t ldap_id_setup_enumeration(struct be_ctx *be_ctx,
                           0,                        /* max_backoff */
                           send_fn, recv_fn,
                           ectx, name,
-                          BE_PTASK_OFFLINE_SKIP | BE_PTASK_SCHEDULE_FROM_LAST,
+                          BE_PTASK_OFFLINE_SKIP | BE_PTASK_SCHEDULE_FROM_LAST
+                              | BE_PTASK_CLASS_ENUMERATION,
                           &id_ctx->task);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE,
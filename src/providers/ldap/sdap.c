@@ -485,12 +485,14 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
         switch(ret) {
         case EAGAIN:
             /* This attribute contained range values and needs more to
-             * be retrieved
+             * be retrieved. Remember where the next range starts so the
+             * caller can fetch the rest, the values are stored below.
              */
-            /* TODO: return the set of attributes that need additional retrieval
-             * For now, we'll continue below and treat it as regular values.
-             */
-            /* FALLTHROUGH */
+            ret = sdap_range_add_pending(attrs, base_attr, range_offset);
+            if (ret != EOK) {
+                goto done;
+            }
+            break;
         case ECANCELED:
             /* FALLTHROUGH */
         case EOK:
@@ -1788,6 +1790,61 @@ char *sdap_make_oc_list(TALLOC_CTX *mem_ctx, struct sdap_attr_map *map)
     }
 }
 
+errno_t sdap_make_or_filter(TALLOC_CTX *mem_ctx,
+                            const char *attr,
+                            const char **values,
+                            size_t num_values,
+                            char **_filter)
+{
+    TALLOC_CTX *tmp_ctx;
+    char *filter;
+    char *clean_value;
+    size_t i;
+    errno_t ret;
+
+    if (num_values == 0) {
+        return EINVAL;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    filter = talloc_strdup(tmp_ctx, "(|");
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < num_values; i++) {
+        ret = sss_filter_sanitize(tmp_ctx, values[i], &clean_value);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        filter = talloc_asprintf_append_buffer(filter, "(%s=%s)",
+                                               attr, clean_value);
+        if (filter == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    filter = talloc_strdup_append_buffer(filter, ")");
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    *_filter = talloc_steal(mem_ctx, filter);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 struct sss_domain_info *sdap_get_object_domain(struct sdap_options *opts,
                                                struct sysdb_attrs *obj,
                                                struct sss_domain_info *dom)
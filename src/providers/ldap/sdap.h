@@ -241,6 +241,8 @@ enum sdap_basic_opt {
     SDAP_PWDLOCKOUT_DN,
     SDAP_WILDCARD_LIMIT,
     SDAP_LIBRARY_DEBUG_LEVEL,
+    SDAP_NESTED_GROUP_BATCH_SIZE,
+    SDAP_NESTED_GROUP_CACHE_TIMEOUT,
 
     SDAP_OPTS_BASIC /* opts counter */
 };
@@ -530,6 +532,12 @@ struct sdap_options {
 
     /* Certificate mapping support */
     struct sdap_certmap_ctx *sdap_certmap_ctx;
+
+    /* Recently resolved nested group members shared among requests */
+    struct sdap_nested_group_cache *nested_group_cache;
+
+    /* TGTs obtained by ldap_child for this domain */
+    struct sdap_tgt_cache_entry *tgt_cache;
 };
 
 struct sdap_server_opts {
@@ -686,6 +694,13 @@ void sdap_steal_server_opts(struct sdap_id_ctx *id_ctx,
 
 char *sdap_make_oc_list(TALLOC_CTX *mem_ctx, struct sdap_attr_map *map);
 
+/* Builds a (|(attr=value1)(attr=value2)...) filter of the sanitized values */
+errno_t sdap_make_or_filter(TALLOC_CTX *mem_ctx,
+                            const char *attr,
+                            const char **values,
+                            size_t num_values,
+                            char **_filter);
+
 size_t sdap_steal_objects_in_dom(struct sdap_options *opts,
                                  struct sysdb_attrs **dom_objects,
                                  size_t offset,
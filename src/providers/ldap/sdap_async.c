@@ -25,6 +25,7 @@
 #include "util/strtonum.h"
 #include "util/probes.h"
 #include "providers/ldap/sdap_async_private.h"
+#include "providers/ldap/sdap_range.h"
 
 #define REPLY_REALLOC_INCREMENT 10
 
@@ -1831,6 +1832,7 @@ static void generic_ext_search_handler(struct tevent_req *subreq,
 struct sdap_get_and_parse_generic_state {
     struct sdap_attr_map *map;
     int map_num_attrs;
+    bool report_ranges;
 
     struct sdap_reply sreply;
     struct sdap_options *opts;
@@ -1856,7 +1858,8 @@ struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
                                                    LDAPControl **clientctrls,
                                                    int sizelimit,
                                                    int timeout,
-                                                   bool allow_paging)
+                                                   bool allow_paging,
+                                                   bool report_ranges)
 {
     struct tevent_req *req = NULL;
     struct tevent_req *subreq = NULL;
@@ -1869,6 +1872,7 @@ struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
 
     state->map = map;
     state->map_num_attrs = map_num_attrs;
+    state->report_ranges = report_ranges;
     state->opts = opts;
 
     if (allow_paging) {
@@ -1914,6 +1918,10 @@ static errno_t sdap_get_and_parse_generic_parse_entry(struct sdap_handle *sh,
         return ret;
     }
 
+    if (!state->report_ranges) {
+        sdap_range_remove_pending(attrs);
+    }
+
     ret = add_to_reply(state, &state->sreply, attrs);
     if (ret != EOK) {
         talloc_free(attrs);
@@ -1980,11 +1988,14 @@ struct tevent_req *sdap_get_generic_send(TALLOC_CTX *memctx,
     req = tevent_req_create(memctx, &state, struct sdap_get_generic_state);
     if (!req) return NULL;
 
+    /* Group entries may be passed to nested group processing which
+     * retrieves the remaining ranges of their members. */
     subreq = sdap_get_and_parse_generic_send(memctx, ev, opts, sh, search_base,
                                              scope, filter, attrs,
                                              map, map_num_attrs,
                                              false, NULL, NULL, 0, timeout,
-                                             allow_paging);
+                                             allow_paging,
+                                             map == opts->group_map);
     if (subreq == NULL) {
         return NULL;
     }
@@ -2390,6 +2401,8 @@ static errno_t sdap_sd_search_parse_entry(struct sdap_handle *sh,
         return ret;
     }
 
+    sdap_range_remove_pending(attrs);
+
     ret = add_to_reply(state, &state->sreply, attrs);
     if (ret != EOK) {
         talloc_free(attrs);
@@ -2658,6 +2671,8 @@ static errno_t sdap_asq_search_parse_entry(struct sdap_handle *sh,
                   "sdap_parse_entry failed [%d]: %s\n", ret, strerror(ret));
             goto done;
         }
+
+        sdap_range_remove_pending(res[mi]->attrs);
     }
     ldap_value_free_len(vals);
 
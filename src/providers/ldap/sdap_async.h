@@ -216,7 +216,9 @@ int sdap_cli_connect_recv(struct tevent_req *req,
                           struct sdap_handle **gsh,
                           struct sdap_server_opts **srv_opts);
 
-/* Exposes all options of generic send while allowing to parse by map */
+/* Exposes all options of generic send while allowing to parse by map.
+ * If report_ranges is true, attributes the server returned only partially
+ * are recorded in the entries, see sdap_range_get_pending(). */
 struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
                                                    struct tevent_context *ev,
                                                    struct sdap_options *opts,
@@ -232,7 +234,8 @@ struct tevent_req *sdap_get_and_parse_generic_send(TALLOC_CTX *memctx,
                                                    LDAPControl **clientctrls,
                                                    int sizelimit,
                                                    int timeout,
-                                                   bool allow_paging);
+                                                   bool allow_paging,
+                                                   bool report_ranges);
 int sdap_get_and_parse_generic_recv(struct tevent_req *req,
                                     TALLOC_CTX *mem_ctx,
                                     size_t *reply_count,
@@ -254,6 +257,32 @@ int sdap_get_generic_recv(struct tevent_req *req,
                          TALLOC_CTX *mem_ctx, size_t *reply_count,
                          struct sysdb_attrs ***reply_list);
 
+/* Called for each range of values as soon as it is received. The values
+ * may be stolen by the callback. */
+typedef errno_t (*sdap_range_values_fn)(struct ldb_message_element *values,
+                                        void *pvt);
+
+/* Retrieve further values of a ranged attribute of entry dn, starting at
+ * offset as recorded by sdap_range_get_pending(). Ranges of step values are
+ * requested several at once and each is passed to values_fn when it
+ * arrives. Only a limited number of ranges is retrieved, recv returns the
+ * offset to continue from or 0 if all values were retrieved. */
+struct tevent_req *
+sdap_range_retrieve_send(TALLOC_CTX *mem_ctx,
+                         struct tevent_context *ev,
+                         struct sdap_options *opts,
+                         struct sdap_handle *sh,
+                         const char *dn,
+                         const char *attr,
+                         uint32_t offset,
+                         uint32_t step,
+                         int timeout,
+                         sdap_range_values_fn values_fn,
+                         void *pvt);
+
+errno_t sdap_range_retrieve_recv(struct tevent_req *req,
+                                 uint32_t *_next_offset);
+
 bool sdap_has_deref_support_ex(struct sdap_handle *sh,
                                struct sdap_options *opts,
                                bool ignore_client);
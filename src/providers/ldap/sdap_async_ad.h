@@ -29,7 +29,9 @@ errno_t sdap_ad_save_group_membership_with_idmapping(const char *username,
                                                struct sss_domain_info *user_dom,
                                                struct sdap_idmap_ctx *idmap_ctx,
                                                size_t num_sids,
-                                               char **sids);
+                                               char **sids,
+                                               TALLOC_CTX *mem_ctx,
+                                               char ***_placeholder_sids);
 
 errno_t
 sdap_ad_tokengroups_get_posix_members(TALLOC_CTX *mem_ctx,
@@ -56,4 +58,15 @@ sdap_ad_resolve_sids_send(TALLOC_CTX *mem_ctx,
                           char **sids);
 
 errno_t sdap_ad_resolve_sids_recv(struct tevent_req *req);
+
+struct tevent_req *
+sdap_ad_resolve_sids_batch_send(TALLOC_CTX *mem_ctx,
+                                struct tevent_context *ev,
+                                struct sdap_id_ctx *id_ctx,
+                                struct sdap_id_conn_ctx *conn,
+                                struct sss_domain_info *dom,
+                                char **sids);
+
+errno_t sdap_ad_resolve_sids_batch_recv(struct tevent_req *req,
+                                        size_t *_num_searches);
 #endif /* SDAP_ASYNC_AD_H_ */
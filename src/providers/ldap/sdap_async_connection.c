@@ -1091,6 +1091,7 @@ struct sdap_kinit_state {
     const char *krb_service_name;
     struct tevent_context *ev;
     struct be_ctx *be;
+    struct sdap_options *opts;
 
     struct fo_server *kdc_srv;
     time_t expire_time;
@@ -1104,6 +1105,7 @@ static
 struct tevent_req *sdap_kinit_send(TALLOC_CTX *memctx,
                                    struct tevent_context *ev,
                                    struct be_ctx *be,
+                                   struct sdap_options *opts,
                                    struct sdap_handle *sh,
                                    const char *krb_service_name,
                                    int    timeout,
@@ -1116,6 +1118,7 @@ struct tevent_req *sdap_kinit_send(TALLOC_CTX *memctx,
     struct tevent_req *req;
     struct tevent_req *subreq;
     struct sdap_kinit_state *state;
+    char *ccname;
     int ret;
 
     DEBUG(SSSDBG_TRACE_FUNC, "Attempting kinit (%s, %s, %s, %d)\n",
@@ -1138,6 +1141,7 @@ struct tevent_req *sdap_kinit_send(TALLOC_CTX *memctx,
     state->timeout = timeout;
     state->lifetime = lifetime;
     state->krb_service_name = krb_service_name;
+    state->opts = opts;
 
     if (canonicalize) {
         ret = setenv("KRB5_CANONICALIZE", "true", 1);
@@ -1151,6 +1155,25 @@ struct tevent_req *sdap_kinit_send(TALLOC_CTX *memctx,
         return NULL;
     }
 
+    ret = sdap_tgt_cache_lookup(state, opts, realm, principal, keytab,
+                                &ccname, &state->expire_time);
+    if (ret == EOK) {
+        ret = setenv("KRB5CCNAME", ccname, 1);
+        if (ret == -1) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  "Unable to set env. variable KRB5CCNAME!\n");
+            talloc_free(req);
+            return NULL;
+        }
+
+        tevent_req_done(req);
+        tevent_req_post(req, ev);
+        return req;
+    } else if (ret != ENOENT) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to look up cached TGT "
+              "[%d]: %s. Not fatal.\n", ret, sss_strerror(ret));
+    }
+
     subreq = sdap_kinit_next_kdc(req);
     if (!subreq) {
         talloc_free(req);
@@ -1258,6 +1281,14 @@ static void sdap_kinit_done(struct tevent_req *subreq)
             return;
         }
 
+        ret = sdap_tgt_cache_store(state->opts, state->realm,
+                                   state->principal, state->keytab,
+                                   ccname, expire_time);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to cache TGT "
+                  "[%d]: %s. Not fatal.\n", ret, sss_strerror(ret));
+        }
+
         state->expire_time = expire_time;
         tevent_req_done(req);
         return;
@@ -1766,6 +1797,7 @@ static void sdap_cli_kinit_step(struct tevent_req *req)
 
     subreq = sdap_kinit_send(state, state->ev,
                              state->be,
+                             state->opts,
                              state->sh,
                              state->service->kinit_service_name,
                         dp_opt_get_int(state->opts->basic,
@@ -1786,6 +1818,26 @@ static void sdap_cli_kinit_step(struct tevent_req *req)
     tevent_req_set_callback(subreq, sdap_cli_kinit_done, req);
 }
 
+/* The server rejected the bind, do not reuse a cached TGT which might
+ * be the reason, e.g. after the keytab was refreshed. */
+static void sdap_cli_invalidate_tgt(struct sdap_cli_connect_state *state)
+{
+    const char *sasl_mech;
+
+    sasl_mech = dp_opt_get_string(state->opts->basic, SDAP_SASL_MECH);
+    if (sasl_mech == NULL || !sdap_sasl_mech_needs_kinit(sasl_mech)
+            || !dp_opt_get_bool(state->opts->basic, SDAP_KRB5_KINIT)) {
+        return;
+    }
+
+    sdap_tgt_cache_invalidate(state->opts,
+                              sdap_gssapi_realm(state->opts->basic),
+                              dp_opt_get_string(state->opts->basic,
+                                                SDAP_SASL_AUTHID),
+                              dp_opt_get_string(state->opts->basic,
+                                                SDAP_KRB5_KEYTAB));
+}
+
 static void sdap_cli_kinit_done(struct tevent_req *subreq)
 {
     struct tevent_req *req = tevent_req_callback_data(subreq,
@@ -2004,6 +2056,7 @@ static void sdap_cli_auth_done(struct tevent_req *subreq)
     ret = sdap_auth_recv(subreq, NULL, NULL);
     talloc_zfree(subreq);
     if (ret) {
+        sdap_cli_invalidate_tgt(state);
         tevent_req_error(req, ret);
         return;
     }
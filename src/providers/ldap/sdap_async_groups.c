@@ -27,6 +27,7 @@
 #include "providers/ldap/sdap_async_private.h"
 #include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap_idmap.h"
+#include "providers/ldap/sdap_range.h"
 
 /* ==Group-Parsing Routines=============================================== */
 
@@ -1916,7 +1917,7 @@ static errno_t sdap_get_groups_next_base(struct tevent_req *req)
             state->filter, state->attrs,
             state->opts->group_map, SDAP_OPTS_GROUP,
             0, NULL, NULL, sizelimit, state->timeout,
-            need_paging);
+            need_paging, true);
     if (!subreq) {
         return ENOMEM;
     }
@@ -1926,6 +1927,7 @@ static errno_t sdap_get_groups_next_base(struct tevent_req *req)
 }
 
 static void sdap_nested_done(struct tevent_req *req);
+static void sdap_search_group_drop_ranges(struct sdap_get_groups_state *state);
 static void sdap_search_group_copy_batch(struct sdap_get_groups_state *state,
                                          struct sysdb_attrs **groups,
                                          size_t count);
@@ -1997,6 +1999,8 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
     }
 
     if (state->no_members) {
+        sdap_search_group_drop_ranges(state);
+
         ret = sysdb_attrs_primary_fqdn_list(state->dom, state,
                                 state->groups, state->count,
                                 state->opts->group_map[SDAP_AT_GROUP_NAME].name,
@@ -2048,6 +2052,7 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
     }
 
     /* We have all of the groups. Save them to the sysdb */
+    sdap_search_group_drop_ranges(state);
     state->check_count = state->count;
 
     ret = sysdb_transaction_start(state->sysdb);
@@ -2087,6 +2092,16 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
     }
 }
 
+/* Only nested group processing retrieves the remaining members. */
+static void sdap_search_group_drop_ranges(struct sdap_get_groups_state *state)
+{
+    size_t i;
+
+    for (i = 0; i < state->count; i++) {
+        sdap_range_remove_pending(state->groups[i]);
+    }
+}
+
 static void sdap_search_group_copy_batch(struct sdap_get_groups_state *state,
                                          struct sysdb_attrs **groups,
                                          size_t count)
@@ -29,6 +29,9 @@
 #include "providers/ad/ad_common.h"
 #include "lib/idmap/sss_idmap.h"
 
+/* Number of group SIDs resolved with one LDAP search */
+#define SDAP_AD_RESOLVE_SIDS_BATCH_SIZE 50
+
 struct sdap_get_ad_tokengroups_state {
     struct tevent_context *ev;
     struct sss_idmap_ctx *idmap_ctx;
@@ -410,6 +413,296 @@ errno_t sdap_ad_resolve_sids_recv(struct tevent_req *req)
     return EOK;
 }
 
+/* Looks up the groups of the given SIDs and stores them without members.
+ * SIDs of the same domain are resolved SDAP_AD_RESOLVE_SIDS_BATCH_SIZE at a
+ * time with one search over conn. SIDs which are not found are silently
+ * skipped. */
+struct sdap_ad_resolve_sids_batch_state {
+    struct tevent_context *ev;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_id_conn_ctx *conn;
+    char **sids;
+    struct sss_domain_info **doms;
+    size_t num_sids;
+
+    struct sdap_domain *sdom;
+    const char **batch;
+    size_t num_batch;
+    const char **attrs;
+    char *filter;
+    struct sdap_id_op *op;
+
+    size_t num_searches;
+    size_t num_resolved;
+};
+
+static errno_t sdap_ad_resolve_sids_batch_next(struct tevent_req *req);
+static errno_t sdap_ad_resolve_sids_batch_connect(struct tevent_req *req);
+static void sdap_ad_resolve_sids_batch_connect_done(struct tevent_req *subreq);
+static void sdap_ad_resolve_sids_batch_done(struct tevent_req *subreq);
+
+struct tevent_req *
+sdap_ad_resolve_sids_batch_send(TALLOC_CTX *mem_ctx,
+                                struct tevent_context *ev,
+                                struct sdap_id_ctx *id_ctx,
+                                struct sdap_id_conn_ctx *conn,
+                                struct sss_domain_info *dom,
+                                char **sids)
+{
+    struct sdap_ad_resolve_sids_batch_state *state;
+    struct tevent_req *req;
+    const char *member_filter[2];
+    size_t i;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_ad_resolve_sids_batch_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->id_ctx = id_ctx;
+    state->conn = conn;
+    state->sids = sids;
+
+    if (sids == NULL || sids[0] == NULL) {
+        ret = EOK;
+        goto immediately;
+    }
+
+    for (state->num_sids = 0; sids[state->num_sids] != NULL;
+         state->num_sids++);
+
+    state->doms = talloc_zero_array(state, struct sss_domain_info *,
+                                    state->num_sids);
+    state->batch = talloc_zero_array(state, const char *,
+                                     SDAP_AD_RESOLVE_SIDS_BATCH_SIZE);
+    if (state->doms == NULL || state->batch == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    for (i = 0; i < state->num_sids; i++) {
+        state->doms[i] = sss_get_domain_by_sid_ldap_fallback(
+                                                  get_domains_head(dom),
+                                                  sids[i]);
+        if (state->doms[i] == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "SID %s does not belong to any known "
+                                         "domain\n", sids[i]);
+        }
+    }
+
+    /* The members are not needed to resolve the group names */
+    member_filter[0] = id_ctx->opts->group_map[SDAP_AT_GROUP_MEMBER].name;
+    member_filter[1] = NULL;
+
+    ret = build_attrs_from_map(state, id_ctx->opts->group_map,
+                               SDAP_OPTS_GROUP, member_filter,
+                               &state->attrs, NULL);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    ret = sdap_ad_resolve_sids_batch_next(req);
+    if (ret != EAGAIN) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t sdap_ad_resolve_sids_batch_next(struct tevent_req *req)
+{
+    struct sdap_ad_resolve_sids_batch_state *state;
+    struct sss_domain_info *dom = NULL;
+    char *sid_filter;
+    char *oc_list;
+    size_t i;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    /* Take the next unresolved SIDs of the same domain, the resolved ones
+     * are removed from the list by resetting their domain. */
+    state->num_batch = 0;
+    for (i = 0; i < state->num_sids
+                && state->num_batch < SDAP_AD_RESOLVE_SIDS_BATCH_SIZE; i++) {
+        if (state->doms[i] == NULL
+                || (dom != NULL && state->doms[i] != dom)) {
+            continue;
+        }
+
+        dom = state->doms[i];
+        state->batch[state->num_batch] = state->sids[i];
+        state->num_batch++;
+        state->doms[i] = NULL;
+    }
+
+    if (state->num_batch == 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Resolved %zu group SIDs "
+              "with %zu searches\n", state->num_resolved,
+              state->num_searches);
+        return EOK;
+    }
+
+    state->sdom = sdap_domain_get(state->id_ctx->opts, dom);
+    if (state->sdom == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "SDAP domain does not exist?\n");
+        return ERR_INTERNAL;
+    }
+
+    talloc_zfree(state->filter);
+    ret = sdap_make_or_filter(state,
+                state->id_ctx->opts->group_map[SDAP_AT_GROUP_OBJECTSID].name,
+                state->batch, state->num_batch, &sid_filter);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    oc_list = sdap_make_oc_list(state, state->id_ctx->opts->group_map);
+    if (oc_list == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Failed to create objectClass list.\n");
+        return ENOMEM;
+    }
+
+    state->filter = talloc_asprintf(state, "(&%s(%s)(%s=*))",
+                    sid_filter, oc_list,
+                    state->id_ctx->opts->group_map[SDAP_AT_GROUP_NAME].name);
+    talloc_free(sid_filter);
+    talloc_free(oc_list);
+    if (state->filter == NULL) {
+        return ENOMEM;
+    }
+
+    talloc_zfree(state->op);
+    state->op = sdap_id_op_create(state, state->conn->conn_cache);
+    if (state->op == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE, "sdap_id_op_create failed\n");
+        return ENOMEM;
+    }
+
+    return sdap_ad_resolve_sids_batch_connect(req);
+}
+
+static errno_t sdap_ad_resolve_sids_batch_connect(struct tevent_req *req)
+{
+    struct sdap_ad_resolve_sids_batch_state *state;
+    struct tevent_req *subreq;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    subreq = sdap_id_op_connect_send(state->op, state, &ret);
+    if (subreq == NULL) {
+        return ret;
+    }
+
+    tevent_req_set_callback(subreq, sdap_ad_resolve_sids_batch_connect_done, req);
+    return EAGAIN;
+}
+
+static void sdap_ad_resolve_sids_batch_connect_done(struct tevent_req *subreq)
+{
+    struct sdap_ad_resolve_sids_batch_state *state;
+    struct tevent_req *req;
+    int dp_error;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    subreq = sdap_get_groups_send(state, state->ev, state->sdom,
+                                  state->id_ctx->opts,
+                                  sdap_id_op_handle(state->op),
+                                  state->attrs, state->filter,
+                                  dp_opt_get_int(state->id_ctx->opts->basic,
+                                                 SDAP_SEARCH_TIMEOUT),
+                                  SDAP_LOOKUP_WILDCARD, true);
+    if (subreq == NULL) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    tevent_req_set_callback(subreq, sdap_ad_resolve_sids_batch_done, req);
+}
+
+static void sdap_ad_resolve_sids_batch_done(struct tevent_req *subreq)
+{
+    struct sdap_ad_resolve_sids_batch_state *state;
+    struct tevent_req *req;
+    int dp_error = DP_ERR_FATAL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    ret = sdap_get_groups_recv(subreq, NULL, NULL);
+    talloc_zfree(subreq);
+    ret = sdap_id_op_done(state->op, ret, &dp_error);
+    if (dp_error == DP_ERR_OK && ret != EOK) {
+        /* retry */
+        ret = sdap_ad_resolve_sids_batch_connect(req);
+        if (ret != EAGAIN) {
+            tevent_req_error(req, ret);
+        }
+        return;
+    }
+
+    state->num_searches++;
+    if (ret == ENOENT) {
+        /* e.g. built-in groups outside of the search base */
+        DEBUG(SSSDBG_TRACE_FUNC, "None of the %zu group SIDs were found\n",
+              state->num_batch);
+    } else if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    } else {
+        state->num_resolved += state->num_batch;
+    }
+
+    ret = sdap_ad_resolve_sids_batch_next(req);
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+}
+
+errno_t sdap_ad_resolve_sids_batch_recv(struct tevent_req *req,
+                                        size_t *_num_searches)
+{
+    struct sdap_ad_resolve_sids_batch_state *state;
+
+    state = tevent_req_data(req, struct sdap_ad_resolve_sids_batch_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (_num_searches != NULL) {
+        *_num_searches = state->num_searches;
+    }
+
+    return EOK;
+}
+
 
 struct sdap_ad_tokengroups_initgr_mapping_state {
     struct tevent_context *ev;
@@ -563,7 +856,9 @@ errno_t sdap_ad_save_group_membership_with_idmapping(const char *username,
                                                struct sss_domain_info *user_dom,
                                                struct sdap_idmap_ctx *idmap_ctx,
                                                size_t num_sids,
-                                               char **sids)
+                                               char **sids,
+                                               TALLOC_CTX *mem_ctx,
+                                               char ***_placeholder_sids)
 {
     TALLOC_CTX *tmp_ctx = NULL;
     struct sss_domain_info *domain = NULL;
@@ -576,6 +871,9 @@ errno_t sdap_ad_save_group_membership_with_idmapping(const char *username,
     gid_t gid;
     char **groups = NULL;
     size_t num_groups;
+    char **placeholder_sids = NULL;
+    size_t num_placeholders = 0;
+    const char *sid_name;
     errno_t ret;
     errno_t sret;
     bool in_transaction = false;
@@ -593,6 +891,12 @@ errno_t sdap_ad_save_group_membership_with_idmapping(const char *username,
         goto done;
     }
 
+    placeholder_sids = talloc_zero_array(tmp_ctx, char *, num_sids + 1);
+    if (placeholder_sids == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
     now = time(NULL);
     ret = sysdb_transaction_start(user_dom->sysdb);
     if (ret != EOK) {
@@ -633,6 +937,21 @@ errno_t sdap_ad_save_group_membership_with_idmapping(const char *username,
                 ret = EINVAL;
                 goto done;
             }
+
+            /* A group stored earlier under the name of its SID is still
+             * incomplete. */
+            if (_placeholder_sids != NULL) {
+                sid_name = sss_create_internal_fqname(tmp_ctx, sid,
+                                                      domain->name);
+                if (sid_name == NULL) {
+                    ret = ENOMEM;
+                    goto done;
+                }
+                if (strcmp(name, sid_name) == 0) {
+                    placeholder_sids[num_placeholders] = discard_const(sid);
+                    num_placeholders++;
+                }
+            }
         } else if (ret == ENOENT) {
             /* This is a new group. For now, we will store it under the name
              * of its SID. When a direct lookup of the group or its GID occurs,
@@ -663,6 +982,9 @@ errno_t sdap_ad_save_group_membership_with_idmapping(const char *username,
                                              "group: [%s]\n", strerror(ret));
                 goto done;
             }
+
+            placeholder_sids[num_placeholders] = discard_const(sid);
+            num_placeholders++;
         } else {
             /* Unexpected error */
             DEBUG(SSSDBG_MINOR_FAILURE, "Could not look up group in sysdb: "
@@ -697,6 +1019,19 @@ errno_t sdap_ad_save_group_membership_with_idmapping(const char *username,
     }
     in_transaction = false;
 
+    if (_placeholder_sids != NULL) {
+        for (i = 0; i < num_placeholders; i++) {
+            placeholder_sids[i] = talloc_strdup(placeholder_sids,
+                                                placeholder_sids[i]);
+            if (placeholder_sids[i] == NULL) {
+                ret = ENOMEM;
+                goto done;
+            }
+        }
+
+        *_placeholder_sids = talloc_steal(mem_ctx, placeholder_sids);
+    }
+
 done:
     talloc_free(tmp_ctx);
 
@@ -733,7 +1068,8 @@ static void sdap_ad_tokengroups_initgr_mapping_done(struct tevent_req *subreq)
                                                        state->domain,
                                                        state->idmap_ctx,
                                                        num_sids,
-                                                       sids);
+                                                       sids,
+                                                       NULL, NULL);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE,
               "sdap_ad_save_group_membership_with_idmapping failed.\n");
@@ -773,10 +1109,19 @@ struct sdap_ad_tokengroups_initgr_posix_state {
     size_t num_missing_sids;
     char **cached_groups;
     size_t num_cached_groups;
+
+    /* Set if the missing groups are looked up in the Global Catalog first */
+    struct sdap_id_conn_ctx *gc_conn;
+    size_t num_gc_searches;
+    size_t num_sid_lookups;
 };
 
 static void
 sdap_ad_tokengroups_initgr_posix_tg_done(struct tevent_req *subreq);
+static void
+sdap_ad_tokengroups_initgr_posix_gc_done(struct tevent_req *subreq);
+static errno_t
+sdap_ad_tokengroups_initgr_posix_resolve_sids(struct tevent_req *req);
 
 static void
 sdap_ad_tokengroups_initgr_posix_sids_connect_done(struct tevent_req *subreq);
@@ -846,6 +1191,13 @@ sdap_ad_tokengroups_initgr_posix_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
 
+    if (dp_opt_get_bool(subdom_id_ctx->ad_options->basic, AD_ENABLE_GC)
+            && dp_opt_get_bool(subdom_id_ctx->ad_options->basic,
+                               AD_TOKENGROUPS_GC_LOOKUP)) {
+        state->gc_conn = subdom_id_ctx->gc_ctx;
+        state->gc_conn->ignore_mark_offline = true;
+    }
+
     subreq = sdap_id_op_connect_send(state->op, state, &ret);
     if (subreq == NULL) {
         ret = ENOMEM;
@@ -1065,28 +1417,119 @@ sdap_ad_tokengroups_initgr_posix_tg_done(struct tevent_req *subreq)
         goto done;
     }
 
-    /* download missing SIDs */
-    subreq = sdap_ad_resolve_sids_send(state, state->ev, state->id_ctx,
-                                       state->conn,
-                                       state->opts, state->domain,
-                                       state->missing_sids);
-    if (subreq == NULL) {
+    if (state->gc_conn != NULL && state->num_missing_sids > 0) {
+        /* The Global Catalog holds the groups of all domains of the forest,
+         * several of them can be found with one search. */
+        subreq = sdap_ad_resolve_sids_batch_send(state, state->ev,
+                                                 state->id_ctx,
+                                                 state->gc_conn,
+                                                 state->domain,
+                                                 state->missing_sids);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        tevent_req_set_callback(subreq,
+                                sdap_ad_tokengroups_initgr_posix_gc_done,
+                                req);
+        return;
+    }
+
+    ret = sdap_ad_tokengroups_initgr_posix_resolve_sids(req);
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+}
+
+static void
+sdap_ad_tokengroups_initgr_posix_gc_done(struct tevent_req *subreq)
+{
+    struct sdap_ad_tokengroups_initgr_posix_state *state = NULL;
+    struct tevent_req *req = NULL;
+    char **missing_sids;
+    size_t num_missing_sids;
+    char **cached_groups;
+    size_t num_cached_groups;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_ad_tokengroups_initgr_posix_state);
+
+    ret = sdap_ad_resolve_sids_batch_recv(subreq, &state->num_gc_searches);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        /* Not fatal, the groups are looked up one by one. */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to resolve missing SIDs in the "
+              "Global Catalog [%d]: %s\n", ret, sss_strerror(ret));
+    }
+
+    ret = sdap_ad_tokengroups_get_posix_members(state, state->domain,
+                                                state->num_missing_sids,
+                                                state->missing_sids,
+                                                &num_missing_sids,
+                                                &missing_sids,
+                                                &num_cached_groups,
+                                                &cached_groups);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "%zu of %zu missing SIDs were found in the "
+          "Global Catalog\n", state->num_missing_sids - num_missing_sids,
+          state->num_missing_sids);
+
+    state->cached_groups = concatenate_string_array(state,
+                                                    state->cached_groups,
+                                                    state->num_cached_groups,
+                                                    cached_groups,
+                                                    num_cached_groups);
+    if (state->cached_groups == NULL) {
         ret = ENOMEM;
         goto done;
     }
+    state->num_cached_groups += num_cached_groups;
 
-    tevent_req_set_callback(subreq, sdap_ad_tokengroups_initgr_posix_sids_done,
-                            req);
+    talloc_free(state->missing_sids);
+    state->missing_sids = missing_sids;
+    state->num_missing_sids = num_missing_sids;
 
-    return;
+    ret = sdap_ad_tokengroups_initgr_posix_resolve_sids(req);
 
 done:
     if (ret != EOK) {
         tevent_req_error(req, ret);
         return;
     }
+}
 
-    tevent_req_done(req);
+/* Looks up the remaining missing SIDs one by one in their own domain */
+static errno_t
+sdap_ad_tokengroups_initgr_posix_resolve_sids(struct tevent_req *req)
+{
+    struct sdap_ad_tokengroups_initgr_posix_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_ad_tokengroups_initgr_posix_state);
+
+    state->num_sid_lookups = state->num_missing_sids;
+
+    /* download missing SIDs */
+    subreq = sdap_ad_resolve_sids_send(state, state->ev, state->id_ctx,
+                                       state->conn,
+                                       state->opts, state->domain,
+                                       state->missing_sids);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_ad_tokengroups_initgr_posix_sids_done,
+                            req);
+
+    return EOK;
 }
 
 static void
@@ -1132,6 +1575,13 @@ sdap_ad_tokengroups_initgr_posix_sids_done(struct tevent_req *subreq)
         goto done;
     }
 
+    /* The tokenGroups attribute is read with one search */
+    DEBUG(SSSDBG_TRACE_FUNC, "Group memberships of [%s] resolved with "
+          "%zu LDAP round trips: 1 tokenGroups search, %zu Global Catalog "
+          "searches, %zu lookups of single SIDs\n", state->username,
+          1 + state->num_gc_searches + state->num_sid_lookups,
+          state->num_gc_searches, state->num_sid_lookups);
+
     /* update membership of existing groups */
     ret = sdap_ad_tokengroups_update_members(state->username,
                                              state->sysdb, state->domain,
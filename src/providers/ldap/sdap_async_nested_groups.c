@@ -31,11 +31,13 @@
 
 #include "util/util.h"
 #include "util/probes.h"
+#include "util/sss_ptr_hash.h"
 #include "db/sysdb.h"
 #include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap_async.h"
 #include "providers/ldap/sdap_async_private.h"
 #include "providers/ldap/sdap_idmap.h"
+#include "providers/ldap/sdap_range.h"
 #include "providers/ipa/ipa_dn.h"
 
 #define sdap_nested_group_sysdb_search_users(domain, dn) \
@@ -55,12 +57,23 @@ struct sdap_nested_group_member {
     const char *dn;
     const char *user_filter;
     const char *group_filter;
+
+    /* entry already fetched by a batched lookup, if any */
+    struct sysdb_attrs *entry;
 };
 
 #ifndef EXTERNAL_MEMBERS_CHUNK
 #define EXTERNAL_MEMBERS_CHUNK  16
 #endif /* EXTERNAL_MEMBERS_CHUNK */
 
+#ifndef NESTED_GROUP_CACHE_MAX_ENTRIES
+#define NESTED_GROUP_CACHE_MAX_ENTRIES 10000
+#endif /* NESTED_GROUP_CACHE_MAX_ENTRIES */
+
+#ifndef BATCH_LOOKUPS_IN_FLIGHT
+#define BATCH_LOOKUPS_IN_FLIGHT 4
+#endif /* BATCH_LOOKUPS_IN_FLIGHT */
+
 struct sdap_external_missing_member {
     const char **parent_group_dns;
     size_t parent_dn_idx;
@@ -78,6 +91,8 @@ struct sdap_nested_group_ctx {
     bool try_deref;
     int deref_threshold;
     int max_nesting_level;
+    int batch_size;
+    struct sdap_nested_group_cache *cache;
 };
 
 static struct tevent_req *
@@ -132,6 +147,16 @@ sdap_nested_group_lookup_unknown_recv(TALLOC_CTX *mem_ctx,
                                       struct sysdb_attrs **_entry,
                                       enum sdap_nested_group_dn_type *_type);
 
+static struct tevent_req *
+sdap_nested_group_lookup_batch_send(TALLOC_CTX *mem_ctx,
+                                    struct tevent_context *ev,
+                                    struct sdap_nested_group_ctx *group_ctx,
+                                    struct sdap_nested_group_member *members,
+                                    int num_members);
+
+static errno_t sdap_nested_group_lookup_batch_recv(TALLOC_CTX *mem_ctx,
+                                                   struct tevent_req *req);
+
 static struct tevent_req *
 sdap_nested_group_deref_send(TALLOC_CTX *mem_ctx,
                              struct tevent_context *ev,
@@ -391,6 +416,215 @@ static errno_t sdap_nested_group_external_add(hash_table_t *table,
     return EOK;
 }
 
+/* Members resolved from LDAP are kept for a short time in a table shared
+ * among all nested group requests of the backend so that overlapping
+ * nested groups do not need to download the same objects again. */
+struct sdap_nested_group_cache {
+    hash_table_t *table;
+    time_t timeout;
+};
+
+struct sdap_nested_group_cache_entry {
+    enum sdap_nested_group_dn_type type;
+    struct sysdb_attrs *attrs;
+    time_t expire;
+};
+
+static struct sdap_nested_group_cache *
+sdap_nested_group_cache_get_ctx(struct sdap_options *opts)
+{
+    struct sdap_nested_group_cache *cache;
+    int timeout;
+
+    if (opts->nested_group_cache != NULL) {
+        return opts->nested_group_cache;
+    }
+
+    timeout = dp_opt_get_int(opts->basic, SDAP_NESTED_GROUP_CACHE_TIMEOUT);
+    if (timeout <= 0) {
+        return NULL;
+    }
+
+    cache = talloc_zero(opts, struct sdap_nested_group_cache);
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->timeout = timeout;
+    cache->table = sss_ptr_hash_create(cache, NULL, NULL);
+    if (cache->table == NULL) {
+        talloc_free(cache);
+        return NULL;
+    }
+
+    opts->nested_group_cache = cache;
+
+    return cache;
+}
+
+/* DNs are compared case-insensitively, the same member may be referenced
+ * with a different case by different groups. */
+static char *
+sdap_nested_group_cache_key(TALLOC_CTX *mem_ctx, const char *dn)
+{
+    return sss_tc_utf8_str_tolower(mem_ctx, dn);
+}
+
+static void
+sdap_nested_group_cache_purge(struct sdap_nested_group_cache *cache,
+                              time_t now)
+{
+    struct sdap_nested_group_cache_entry *entry;
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    int hret;
+
+    hret = hash_values(cache->table, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        entry = sss_ptr_get_value(&values[i],
+                                  struct sdap_nested_group_cache_entry);
+        if (entry != NULL && entry->expire <= now) {
+            /* removes the entry from the table as well */
+            talloc_free(entry);
+        }
+    }
+
+    talloc_free(values);
+}
+
+static void
+sdap_nested_group_cache_add(struct sdap_nested_group_ctx *group_ctx,
+                            const char *dn,
+                            enum sdap_nested_group_dn_type type,
+                            struct sysdb_attrs *attrs)
+{
+    struct sdap_nested_group_cache *cache = group_ctx->cache;
+    struct sdap_nested_group_cache_entry *entry;
+    char *key;
+    time_t now;
+    errno_t ret;
+
+    if (cache == NULL || dn == NULL) {
+        return;
+    }
+
+    key = sdap_nested_group_cache_key(NULL, dn);
+    if (key == NULL) {
+        return;
+    }
+
+    now = time(NULL);
+
+    entry = sss_ptr_hash_lookup(cache->table, key,
+                                struct sdap_nested_group_cache_entry);
+    if (entry != NULL) {
+        if (entry->expire > now) {
+            /* do not prolong the lifetime of entries taken from the cache */
+            goto done;
+        }
+
+        talloc_free(entry);
+    }
+
+    if (hash_count(cache->table) >= NESTED_GROUP_CACHE_MAX_ENTRIES) {
+        sdap_nested_group_cache_purge(cache, now);
+        if (hash_count(cache->table) >= NESTED_GROUP_CACHE_MAX_ENTRIES) {
+            DEBUG(SSSDBG_TRACE_ALL, "Nested group cache is full, "
+                  "[%s] will not be cached\n", dn);
+            goto done;
+        }
+    }
+
+    entry = talloc_zero(cache->table, struct sdap_nested_group_cache_entry);
+    if (entry == NULL) {
+        goto done;
+    }
+
+    entry->type = type;
+    entry->expire = now + cache->timeout;
+    entry->attrs = sysdb_new_attrs(entry);
+    if (entry->attrs == NULL) {
+        talloc_free(entry);
+        goto done;
+    }
+
+    ret = sysdb_attrs_copy(attrs, entry->attrs);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to copy [%s] into nested group "
+              "cache [%d]: %s\n", dn, ret, sss_strerror(ret));
+        talloc_free(entry);
+        goto done;
+    }
+
+    ret = sss_ptr_hash_add(cache->table, key, entry,
+                           struct sdap_nested_group_cache_entry);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to add [%s] into nested group "
+              "cache [%d]: %s\n", dn, ret, sss_strerror(ret));
+        talloc_free(entry);
+        goto done;
+    }
+
+done:
+    talloc_free(key);
+}
+
+static errno_t
+sdap_nested_group_cache_lookup(TALLOC_CTX *mem_ctx,
+                               struct sdap_nested_group_ctx *group_ctx,
+                               const char *dn,
+                               enum sdap_nested_group_dn_type *_type,
+                               struct sysdb_attrs **_attrs)
+{
+    struct sdap_nested_group_cache *cache = group_ctx->cache;
+    struct sdap_nested_group_cache_entry *entry;
+    struct sysdb_attrs *attrs;
+    char *key;
+    errno_t ret;
+
+    if (cache == NULL) {
+        return ENOENT;
+    }
+
+    key = sdap_nested_group_cache_key(NULL, dn);
+    if (key == NULL) {
+        return ENOMEM;
+    }
+
+    entry = sss_ptr_hash_lookup(cache->table, key,
+                                struct sdap_nested_group_cache_entry);
+    talloc_free(key);
+    if (entry == NULL) {
+        return ENOENT;
+    }
+
+    if (entry->expire <= time(NULL)) {
+        talloc_free(entry);
+        return ENOENT;
+    }
+
+    attrs = sysdb_new_attrs(mem_ctx);
+    if (attrs == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_attrs_copy(entry->attrs, attrs);
+    if (ret != EOK) {
+        talloc_free(attrs);
+        return ret;
+    }
+
+    *_type = entry->type;
+    *_attrs = attrs;
+
+    return EOK;
+}
+
 static errno_t sdap_nested_group_sysdb_search(struct sss_domain_info *domain,
                                               const char *dn,
                                               bool user)
@@ -449,18 +683,22 @@ done:
 }
 
 static errno_t
-sdap_nested_group_check_cache(struct sdap_options *opts,
-                              struct sss_domain_info *domain,
+sdap_nested_group_check_cache(TALLOC_CTX *mem_ctx,
+                              struct sdap_nested_group_ctx *group_ctx,
                               const char *member_dn,
-                              enum sdap_nested_group_dn_type *_type)
+                              enum sdap_nested_group_dn_type *_type,
+                              struct sysdb_attrs **_entry)
 {
     struct sdap_domain *sdap_domain = NULL;
     struct sss_domain_info *member_domain = NULL;
+    errno_t mret;
     errno_t ret;
 
+    *_entry = NULL;
+
     /* determine correct domain of this member */
-    sdap_domain = sdap_domain_get_by_dn(opts, member_dn);
-    member_domain = sdap_domain == NULL ? domain : sdap_domain->dom;
+    sdap_domain = sdap_domain_get_by_dn(group_ctx->opts, member_dn);
+    member_domain = sdap_domain == NULL ? group_ctx->domain : sdap_domain->dom;
 
     /* search in users */
     PROBE(SDAP_NESTED_GROUP_SYSDB_SEARCH_USERS_PRE);
@@ -492,6 +730,19 @@ sdap_nested_group_check_cache(struct sdap_options *opts,
     ret = ENOENT;
 
 done:
+    if (ret == EAGAIN || ret == ENOENT) {
+        /* missing or expired in the sysdb, but it may have been resolved
+         * recently by another request */
+        mret = sdap_nested_group_cache_lookup(mem_ctx, group_ctx, member_dn,
+                                              _type, _entry);
+        if (mret == EOK) {
+            /* the object is known but must be processed */
+            ret = EAGAIN;
+        } else if (mret != ENOENT) {
+            ret = mret;
+        }
+    }
+
     return ret;
 }
 
@@ -539,16 +790,19 @@ sdap_nested_group_split_members(TALLOC_CTX *mem_ctx,
                                 struct ldb_message_element *members,
                                 struct sdap_nested_group_member **_missing,
                                 int *_num_missing,
-                                int *_num_groups)
+                                int *_num_groups,
+                                int *_num_cached)
 {
     TALLOC_CTX *tmp_ctx = NULL;
     struct sdap_nested_group_member *missing = NULL;
+    struct sysdb_attrs *entry = NULL;
     enum sdap_nested_group_dn_type type;
     char *dn = NULL;
     char *user_filter = NULL;
     char *group_filter = NULL;
     int num_missing = 0;
     int num_groups = 0;
+    int num_cached = 0;
     hash_key_t key;
     bool bret;
     bool is_user;
@@ -560,6 +814,7 @@ sdap_nested_group_split_members(TALLOC_CTX *mem_ctx,
         *_missing = NULL;
         *_num_missing = 0;
         *_num_groups = 0;
+        *_num_cached = 0;
         return EOK;
     }
 
@@ -583,6 +838,9 @@ sdap_nested_group_split_members(TALLOC_CTX *mem_ctx,
      * - it is a group and we have reached the maximal nesting level
      * - it is not under user nor group search bases
      *
+     * if dn was recently resolved by another request
+     * - we already have the object and do not need to look it up
+     *
      * if dn is in sysdb but expired
      * - we know what object type it is
      *
@@ -607,10 +865,10 @@ sdap_nested_group_split_members(TALLOC_CTX *mem_ctx,
             continue;
         }
 
-        /* check sysdb */
+        /* check nested group cache and sysdb */
         PROBE(SDAP_NESTED_GROUP_CHECK_CACHE_PRE);
-        ret = sdap_nested_group_check_cache(group_ctx->opts, group_ctx->domain,
-                                            dn, &type);
+        ret = sdap_nested_group_check_cache(missing, group_ctx, dn,
+                                            &type, &entry);
         PROBE(SDAP_NESTED_GROUP_CHECK_CACHE_POST);
         if (ret == EOK) {
             /* found and valid */
@@ -655,6 +913,7 @@ sdap_nested_group_split_members(TALLOC_CTX *mem_ctx,
                       "(level %d), skipping\n", dn, nesting_level);
                 talloc_zfree(user_filter);
                 talloc_zfree(group_filter);
+                talloc_zfree(entry);
                 continue;
             }
         }
@@ -668,13 +927,23 @@ sdap_nested_group_split_members(TALLOC_CTX *mem_ctx,
         missing[num_missing].type = type;
         missing[num_missing].user_filter = talloc_steal(missing, user_filter);
         missing[num_missing].group_filter = talloc_steal(missing, group_filter);
+        missing[num_missing].entry = entry;
+        if (entry != NULL) {
+            DEBUG(SSSDBG_TRACE_ALL, "[%s] found in nested group cache\n", dn);
+            num_cached++;
+            entry = NULL;
+        }
 
         num_missing++;
-        if (threshold > 0 && num_missing > threshold) {
+        if (threshold > 0 && num_missing - num_cached > threshold) {
             if (_num_missing) {
                 *_num_missing = num_missing;
             }
 
+            if (_num_cached) {
+                *_num_cached = num_cached;
+            }
+
             ret = ERR_DEREF_THRESHOLD;
             goto done;
         }
@@ -706,6 +975,10 @@ sdap_nested_group_split_members(TALLOC_CTX *mem_ctx,
         *_num_groups = num_groups;
     }
 
+    if (_num_cached) {
+        *_num_cached = num_cached;
+    }
+
     ret = EOK;
 
 done:
@@ -835,6 +1108,9 @@ sdap_nested_group_send(TALLOC_CTX *mem_ctx,
                                                       SDAP_DEREF_THRESHOLD);
     state->group_ctx->max_nesting_level = dp_opt_get_int(opts->basic,
                                                          SDAP_NESTING_LEVEL);
+    state->group_ctx->batch_size = dp_opt_get_int(opts->basic,
+                                                  SDAP_NESTED_GROUP_BATCH_SIZE);
+    state->group_ctx->cache = sdap_nested_group_cache_get_ctx(opts);
     state->group_ctx->domain = sdom->dom;
     state->group_ctx->opts = opts;
     state->group_ctx->user_search_bases = sdom->user_search_bases;
@@ -986,14 +1262,27 @@ struct sdap_nested_group_process_state {
     struct sdap_nested_group_member *missing;
     int num_missing_total;
     int num_missing_groups;
+    int num_missing_cached;
     struct ldb_message_element *ext_members;
     struct ldb_message_element *members;
     int nesting_level;
     char *group_dn;
     bool deref;
     bool deref_shortcut;
+
+    /* Remaining ranges of the member attribute, retrieved in windows of
+     * several ranges whose members are looked up before the next window
+     * is requested. */
+    bool range_pending;
+    uint32_t range_offset;
+    uint32_t range_step;
+    unsigned int range_first;
 };
 
+static errno_t sdap_nested_group_process_range(struct tevent_req *req);
+static errno_t
+sdap_nested_group_process_members(struct tevent_req *req,
+                                  struct ldb_message_element *members);
 static void sdap_nested_group_process_done(struct tevent_req *subreq);
 
 static struct tevent_req *
@@ -1006,10 +1295,8 @@ sdap_nested_group_process_send(TALLOC_CTX *mem_ctx,
     struct sdap_nested_group_process_state *state = NULL;
     struct sdap_attr_map *group_map = NULL;
     struct tevent_req *req = NULL;
-    struct tevent_req *subreq = NULL;
     const char *orig_dn = NULL;
     errno_t ret;
-    int split_threshold;
 
     req = tevent_req_create(mem_ctx, &state,
                             struct sdap_nested_group_process_state);
@@ -1040,6 +1327,19 @@ sdap_nested_group_process_send(TALLOC_CTX *mem_ctx,
     DEBUG(SSSDBG_TRACE_INTERNAL, "About to process group [%s]\n", orig_dn);
     PROBE(SDAP_NESTED_GROUP_PROCESS_SEND, state->group_dn);
 
+    /* Active Directory returns only the first range of values of large
+     * attributes. The marker is dropped from the group before the member
+     * list is looked up so that it is never saved. */
+    ret = sdap_range_get_pending(group, group_map[SDAP_AT_GROUP_MEMBER].name,
+                                 &state->range_offset);
+    if (ret == EOK) {
+        state->range_pending = true;
+        state->range_step = state->range_offset;
+    } else if (ret != ENOENT) {
+        goto immediately;
+    }
+    sdap_range_remove_pending(group);
+
     /* get member list, both direct and external */
     state->ext_members = sdap_nested_group_ext_members(state->group_ctx->opts,
                                                        group);
@@ -1055,19 +1355,67 @@ sdap_nested_group_process_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
 
+    ret = sdap_nested_group_add_ext_members(state->group_ctx,
+                                            group,
+                                            state->ext_members);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to split external member list "
+                                    "[%d]: %s\n", ret, sss_strerror(ret));
+        goto immediately;
+    }
+
+    if (state->members == NULL) {
+        state->range_pending = false;
+    }
+
+    /* Dereference returns all members, otherwise the members of the first
+     * range are looked up before the remaining ranges are retrieved. */
+    ret = sdap_nested_group_process_members(req, state->members);
+    if (ret != EAGAIN) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t
+sdap_nested_group_process_members(struct tevent_req *req,
+                                  struct ldb_message_element *members)
+{
+    struct sdap_nested_group_process_state *state = NULL;
+    struct sdap_nested_group_ctx *group_ctx = NULL;
+    struct tevent_req *subreq = NULL;
+    errno_t ret;
+    int split_threshold;
+
+    state = tevent_req_data(req, struct sdap_nested_group_process_state);
+    group_ctx = state->group_ctx;
+
     split_threshold = state->group_ctx->try_deref ? \
                             state->group_ctx->deref_threshold : \
                             -1;
 
     /* get members that need to be refreshed */
+    talloc_zfree(state->missing);
     PROBE(SDAP_NESTED_GROUP_PROCESS_SPLIT_PRE);
     ret = sdap_nested_group_split_members(state, state->group_ctx,
                                           split_threshold,
                                           state->nesting_level,
-                                          state->members,
+                                          members,
                                           &state->missing,
                                           &state->num_missing_total,
-                                          &state->num_missing_groups);
+                                          &state->num_missing_groups,
+                                          &state->num_missing_cached);
     PROBE(SDAP_NESTED_GROUP_PROCESS_SPLIT_POST);
     if (ret == ERR_DEREF_THRESHOLD) {
         DEBUG(SSSDBG_TRACE_FUNC,
@@ -1076,22 +1424,18 @@ sdap_nested_group_process_send(TALLOC_CTX *mem_ctx,
     } else if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, "Unable to split member list "
                                     "[%d]: %s\n", ret, sss_strerror(ret));
-        goto immediately;
-    }
-
-    ret = sdap_nested_group_add_ext_members(state->group_ctx,
-                                            group,
-                                            state->ext_members);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Unable to split external member list "
-                                    "[%d]: %s\n", ret, sss_strerror(ret));
-        goto immediately;
+        return ret;
     }
 
     if (state->num_missing_total == 0
             && hash_count(state->group_ctx->missing_external) == 0) {
-        ret = EOK; /* we're done */
-        goto immediately;
+        if (state->range_pending && !group_ctx->try_deref) {
+            return sdap_nested_group_process_range(req);
+        }
+
+        if (!state->range_pending) {
+            return EOK; /* we're done */
+        }
     }
 
     /* If there are only indirect members of the group, it's still safe to
@@ -1101,46 +1445,141 @@ sdap_nested_group_process_send(TALLOC_CTX *mem_ctx,
     DEBUG(SSSDBG_TRACE_INTERNAL,
           "Looking up %d/%d members of group [%s]\n",
           state->num_missing_total,
-          state->members ? state->members->num_values : 0,
-          orig_dn);
+          members ? members->num_values : 0,
+          state->group_dn);
 
-    /* process members */
+    /* process members, those found in the nested group cache do not need
+     * to be looked up */
     if (group_ctx->try_deref
-            && state->num_missing_total > group_ctx->deref_threshold) {
+            && (state->range_pending
+                || state->num_missing_total - state->num_missing_cached
+                        > group_ctx->deref_threshold)) {
         DEBUG(SSSDBG_TRACE_INTERNAL, "Dereferencing members of group [%s]\n",
-                                      orig_dn);
+                                      state->group_dn);
         state->deref = true;
-        subreq = sdap_nested_group_deref_send(state, ev, group_ctx,
-                                              state->members, orig_dn,
+        subreq = sdap_nested_group_deref_send(state, state->ev, group_ctx,
+                                              state->members, state->group_dn,
                                               state->nesting_level);
     } else {
         DEBUG(SSSDBG_TRACE_INTERNAL, "Members of group [%s] will be "
-                                      "processed individually\n", orig_dn);
+                                      "processed individually\n",
+                                      state->group_dn);
         state->deref = false;
-        subreq = sdap_nested_group_single_send(state, ev, group_ctx,
+        subreq = sdap_nested_group_single_send(state, state->ev, group_ctx,
                                                state->missing,
                                                state->num_missing_total,
                                                state->num_missing_groups,
                                                state->nesting_level);
     }
     if (subreq == NULL) {
-        ret = ENOMEM;
-        goto immediately;
+        return ENOMEM;
     }
 
     tevent_req_set_callback(subreq, sdap_nested_group_process_done, req);
 
-    return req;
+    return EAGAIN;
+}
 
-immediately:
+static errno_t
+sdap_nested_group_process_range_values(struct ldb_message_element *values,
+                                       void *pvt)
+{
+    struct sdap_nested_group_process_state *state = NULL;
+    struct ldb_message_element *members = NULL;
+    unsigned int i;
+
+    state = talloc_get_type(pvt, struct sdap_nested_group_process_state);
+    members = state->members;
+
+    /* Changes in state->members will propagate into sysdb_attrs of
+     * the group, the whole member list is saved with the group. */
+    members->values = talloc_realloc(members, members->values,
+                                     struct ldb_val,
+                                     members->num_values + values->num_values);
+    if (members->values == NULL) {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < values->num_values; i++) {
+        members->values[members->num_values].data =
+                talloc_steal(members->values, values->values[i].data);
+        members->values[members->num_values].length =
+                values->values[i].length;
+        members->num_values++;
+    }
+
+    return EOK;
+}
+
+static void sdap_nested_group_process_range_done(struct tevent_req *subreq);
+
+static errno_t sdap_nested_group_process_range(struct tevent_req *req)
+{
+    struct sdap_nested_group_process_state *state = NULL;
+    struct sdap_attr_map *group_map = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_nested_group_process_state);
+    group_map = state->group_ctx->opts->group_map;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Retrieving members of group [%s] "
+          "from offset %"PRIu32"\n", state->group_dn, state->range_offset);
+
+    state->range_first = state->members->num_values;
+
+    subreq = sdap_range_retrieve_send(state, state->ev,
+                                      state->group_ctx->opts,
+                                      state->group_ctx->sh,
+                                      state->group_dn,
+                                      group_map[SDAP_AT_GROUP_MEMBER].name,
+                                      state->range_offset,
+                                      state->range_step,
+                                      dp_opt_get_int(state->group_ctx->opts->basic,
+                                                     SDAP_SEARCH_TIMEOUT),
+                                      sdap_nested_group_process_range_values,
+                                      state);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_nested_group_process_range_done, req);
+
+    return EAGAIN;
+}
+
+static void sdap_nested_group_process_range_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_process_state *state = NULL;
+    struct ldb_message_element window;
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_process_state);
+
+    ret = sdap_range_retrieve_recv(subreq, &state->range_offset);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to retrieve members of group [%s] "
+              "[%d]: %s\n", state->group_dn, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    state->range_pending = state->range_offset != 0;
+
+    /* Only the members received in this window are looked up. */
+    window = *state->members;
+    window.num_values = state->members->num_values - state->range_first;
+    window.values = state->members->values + state->range_first;
+
+    ret = sdap_nested_group_process_members(req, &window);
+
+done:
     if (ret == EOK) {
         tevent_req_done(req);
-    } else {
+    } else if (ret != EAGAIN) {
         tevent_req_error(req, ret);
     }
-    tevent_req_post(req, ev);
-
-    return req;
 }
 
 static void sdap_nested_group_process_done(struct tevent_req *subreq)
@@ -1167,6 +1606,7 @@ static void sdap_nested_group_process_done(struct tevent_req *subreq)
                 /* If we previously short-cut dereference, we need to split the
                  * members again to get full list of missing member types
                  */
+                talloc_zfree(state->missing);
                 PROBE(SDAP_NESTED_GROUP_PROCESS_SPLIT_PRE);
                 ret = sdap_nested_group_split_members(state, state->group_ctx,
                                                       -1,
@@ -1174,7 +1614,8 @@ static void sdap_nested_group_process_done(struct tevent_req *subreq)
                                                       state->members,
                                                       &state->missing,
                                                       &state->num_missing_total,
-                                                      &state->num_missing_groups);
+                                                      &state->num_missing_groups,
+                                                      &state->num_missing_cached);
                 PROBE(SDAP_NESTED_GROUP_PROCESS_SPLIT_POST);
                 if (ret != EOK) {
                     DEBUG(SSSDBG_CRIT_FAILURE, "Unable to split member list "
@@ -1204,6 +1645,9 @@ static void sdap_nested_group_process_done(struct tevent_req *subreq)
     } else {
         ret = sdap_nested_group_single_recv(subreq);
         talloc_zfree(subreq);
+        if (ret == EOK && state->range_pending) {
+            ret = sdap_nested_group_process_range(req);
+        }
     }
 
 done:
@@ -1358,6 +1802,7 @@ struct sdap_nested_group_single_state {
 };
 
 static errno_t sdap_nested_group_single_step(struct tevent_req *req);
+static void sdap_nested_group_single_batch_done(struct tevent_req *subreq);
 static void sdap_nested_group_single_step_done(struct tevent_req *subreq);
 static void sdap_nested_group_single_done(struct tevent_req *subreq);
 
@@ -1372,6 +1817,7 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
 {
     struct sdap_nested_group_single_state *state = NULL;
     struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
     errno_t ret;
 
     req = tevent_req_create(mem_ctx, &state,
@@ -1396,7 +1842,23 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
     }
     state->num_groups = 0; /* we will count exact number of the groups */
 
-    /* process each member individually */
+    if (group_ctx->batch_size > 1 && num_members > 1) {
+        /* fetch as many members as possible with combined searches first,
+         * the rest will be looked up individually */
+        subreq = sdap_nested_group_lookup_batch_send(state, ev, group_ctx,
+                                                     members, num_members);
+        if (subreq == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        tevent_req_set_callback(subreq, sdap_nested_group_single_batch_done,
+                                req);
+
+        return req;
+    }
+
+    /* process each member individually */
     ret = sdap_nested_group_single_step(req);
     if (ret != EAGAIN) {
         goto immediately;
@@ -1415,89 +1877,20 @@ immediately:
     return req;
 }
 
-static errno_t sdap_nested_group_single_step(struct tevent_req *req)
-{
-    struct sdap_nested_group_single_state *state = NULL;
-    struct tevent_req *subreq = NULL;
-
-    state = tevent_req_data(req, struct sdap_nested_group_single_state);
-
-    if (state->member_index >= state->num_members) {
-        /* we're done */
-        return EOK;
-    }
-
-    state->current_member = &state->members[state->member_index];
-    state->member_index++;
-
-    switch (state->current_member->type) {
-    case SDAP_NESTED_GROUP_DN_USER:
-        subreq = sdap_nested_group_lookup_user_send(state, state->ev,
-                                                    state->group_ctx,
-                                                    state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_GROUP:
-        subreq = sdap_nested_group_lookup_group_send(state, state->ev,
-                                                     state->group_ctx,
-                                                     state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_UNKNOWN:
-        subreq = sdap_nested_group_lookup_unknown_send(state, state->ev,
-                                                   state->group_ctx,
-                                                   state->current_member);
-        break;
-    }
-
-    if (subreq == NULL) {
-        return ENOMEM;
-    }
-
-    tevent_req_set_callback(subreq, sdap_nested_group_single_step_done, req);
-
-    return EAGAIN;
-}
-
 static errno_t
-sdap_nested_group_single_step_process(struct tevent_req *subreq)
+sdap_nested_group_single_add_entry(struct sdap_nested_group_single_state *state,
+                                   struct sysdb_attrs *entry,
+                                   bool check_nesting)
 {
-    struct sdap_nested_group_single_state *state = NULL;
-    struct tevent_req *req = NULL;
-    struct sysdb_attrs *entry = NULL;
-    enum sdap_nested_group_dn_type type = SDAP_NESTED_GROUP_DN_UNKNOWN;
     const char *orig_dn = NULL;
     errno_t ret;
 
-    req = tevent_req_callback_data(subreq, struct tevent_req);
-    state = tevent_req_data(req, struct sdap_nested_group_single_state);
-
-    /* set correct type if possible */
-    if (state->current_member->type == SDAP_NESTED_GROUP_DN_UNKNOWN) {
-        ret = sdap_nested_group_lookup_unknown_recv(state, subreq,
-                                                    &entry, &type);
-        if (ret != EOK) {
-            goto done;
-        }
-
-        if (entry != NULL) {
-            state->current_member->type = type;
-        }
-    }
+    /* share the entry with other requests before it is modified */
+    sdap_nested_group_cache_add(state->group_ctx, state->current_member->dn,
+                                state->current_member->type, entry);
 
     switch (state->current_member->type) {
     case SDAP_NESTED_GROUP_DN_USER:
-        if (entry == NULL) {
-            /* type was not unknown, receive data */
-            ret = sdap_nested_group_lookup_user_recv(state, subreq, &entry);
-            if (ret != EOK) {
-                goto done;
-            }
-
-            if (entry == NULL) {
-                /* user not found, continue */
-                break;
-            }
-        }
-
         /* The original DN of the user object itself might differ from the one
          * used in the member attribute, e.g. different case. To make sure if
          * can be found in a hash table when iterating over group members the
@@ -1525,33 +1918,21 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
         }
         break;
     case SDAP_NESTED_GROUP_DN_GROUP:
-        if (entry == NULL) {
-            /* type was not unknown, receive data */
-            ret = sdap_nested_group_lookup_group_recv(state, subreq, &entry);
+        /* if the type was unknown we had to pull the group,
+         * but we don't want to process it if we have reached
+         * the nesting level */
+        if (check_nesting
+                && state->nesting_level >= state->group_ctx->max_nesting_level) {
+            ret = sysdb_attrs_get_string(entry, SYSDB_ORIG_DN, &orig_dn);
             if (ret != EOK) {
-                goto done;
-            }
-
-            if (entry == NULL) {
-                /* group not found, continue */
-                break;
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      "The entry has no originalDN\n");
+                orig_dn = "invalid";
             }
-        } else {
-            /* the type was unknown so we had to pull the group,
-             * but we don't want to process it if we have reached
-             * the nesting level */
-            if (state->nesting_level >= state->group_ctx->max_nesting_level) {
-                ret = sysdb_attrs_get_string(entry, SYSDB_ORIG_DN, &orig_dn);
-                if (ret != EOK) {
-                    DEBUG(SSSDBG_MINOR_FAILURE,
-                          "The entry has no originalDN\n");
-                    orig_dn = "invalid";
-                }
 
-                DEBUG(SSSDBG_TRACE_ALL, "[%s] is outside nesting limit "
-                      "(level %d), skipping\n", orig_dn, state->nesting_level);
-                break;
-            }
+            DEBUG(SSSDBG_TRACE_ALL, "[%s] is outside nesting limit "
+                  "(level %d), skipping\n", orig_dn, state->nesting_level);
+            break;
         }
 
         /* save group in hash table */
@@ -1583,46 +1964,192 @@ done:
     return ret;
 }
 
-static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
+static errno_t sdap_nested_group_single_step(struct tevent_req *req)
+{
+    struct sdap_nested_group_single_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct sdap_nested_group_single_state);
+
+    do {
+        if (state->member_index >= state->num_members) {
+            /* we're done */
+            return EOK;
+        }
+
+        state->current_member = &state->members[state->member_index];
+        state->member_index++;
+
+        if (state->current_member->entry == NULL) {
+            break;
+        }
+
+        /* already fetched by a batched lookup */
+        ret = sdap_nested_group_single_add_entry(state,
+                                                 state->current_member->entry,
+                                                 false);
+        state->current_member->entry = NULL;
+        if (ret != EOK) {
+            return ret;
+        }
+    } while (true);
+
+    switch (state->current_member->type) {
+    case SDAP_NESTED_GROUP_DN_USER:
+        subreq = sdap_nested_group_lookup_user_send(state, state->ev,
+                                                    state->group_ctx,
+                                                    state->current_member);
+        break;
+    case SDAP_NESTED_GROUP_DN_GROUP:
+        subreq = sdap_nested_group_lookup_group_send(state, state->ev,
+                                                     state->group_ctx,
+                                                     state->current_member);
+        break;
+    case SDAP_NESTED_GROUP_DN_UNKNOWN:
+        subreq = sdap_nested_group_lookup_unknown_send(state, state->ev,
+                                                   state->group_ctx,
+                                                   state->current_member);
+        break;
+    }
+
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_nested_group_single_step_done, req);
+
+    return EAGAIN;
+}
+
+static errno_t
+sdap_nested_group_single_step_process(struct tevent_req *subreq)
 {
     struct sdap_nested_group_single_state *state = NULL;
     struct tevent_req *req = NULL;
+    struct sysdb_attrs *entry = NULL;
+    enum sdap_nested_group_dn_type type = SDAP_NESTED_GROUP_DN_UNKNOWN;
+    bool check_nesting = false;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
     state = tevent_req_data(req, struct sdap_nested_group_single_state);
 
-    /* process direct members */
-    ret = sdap_nested_group_single_step_process(subreq);
+    switch (state->current_member->type) {
+    case SDAP_NESTED_GROUP_DN_USER:
+        ret = sdap_nested_group_lookup_user_recv(state, subreq, &entry);
+        break;
+    case SDAP_NESTED_GROUP_DN_GROUP:
+        ret = sdap_nested_group_lookup_group_recv(state, subreq, &entry);
+        break;
+    case SDAP_NESTED_GROUP_DN_UNKNOWN:
+        /* set correct type if possible */
+        ret = sdap_nested_group_lookup_unknown_recv(state, subreq,
+                                                    &entry, &type);
+        if (ret == EOK && entry != NULL) {
+            state->current_member->type = type;
+            check_nesting = true;
+        }
+        break;
+    default:
+        ret = EINVAL;
+        break;
+    }
+
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (entry == NULL) {
+        /* entry not found, continue */
+        ret = EOK;
+        goto done;
+    }
+
+    ret = sdap_nested_group_single_add_entry(state, entry, check_nesting);
+
+done:
+    return ret;
+}
+
+static errno_t sdap_nested_group_single_recurse(struct tevent_req *req)
+{
+    struct sdap_nested_group_single_state *state = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_nested_group_single_state);
+
+    /* we have processed all direct members,
+     * now recurse and process nested groups */
+    subreq = sdap_nested_group_recurse_send(state, state->ev,
+                                            state->group_ctx,
+                                            state->nested_groups,
+                                            state->num_groups,
+                                            state->nesting_level + 1);
+    if (subreq == NULL) {
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_nested_group_single_done, req);
+
+    return EAGAIN;
+}
+
+static void sdap_nested_group_single_batch_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_single_state *state = NULL;
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_single_state);
+
+    ret = sdap_nested_group_lookup_batch_recv(state, subreq);
     talloc_zfree(subreq);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, "Error processing direct membership "
-                                    "[%d]: %s\n", ret, strerror(ret));
+        DEBUG(SSSDBG_CRIT_FAILURE, "Error looking up members in batches "
+                                    "[%d]: %s\n", ret, sss_strerror(ret));
         goto done;
     }
 
+    /* process fetched members and look up the rest individually */
     ret = sdap_nested_group_single_step(req);
     if (ret == EOK) {
-        /* we have processed all direct members,
-         * now recurse and process nested groups */
-        subreq = sdap_nested_group_recurse_send(state, state->ev,
-                                                state->group_ctx,
-                                                state->nested_groups,
-                                                state->num_groups,
-                                                state->nesting_level + 1);
-        if (subreq == NULL) {
-            ret = ENOMEM;
-            goto done;
-        }
+        ret = sdap_nested_group_single_recurse(req);
+    }
 
-        tevent_req_set_callback(subreq, sdap_nested_group_single_done, req);
+done:
+    if (ret == EOK) {
+        /* tevent_req_error() cannot cope with EOK */
+        DEBUG(SSSDBG_CRIT_FAILURE, "We should not get here with EOK\n");
+        tevent_req_error(req, EINVAL);
     } else if (ret != EAGAIN) {
-        /* error */
+        tevent_req_error(req, ret);
+    }
+
+    return;
+}
+
+static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+
+    /* process direct members */
+    ret = sdap_nested_group_single_step_process(subreq);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Error processing direct membership "
+                                    "[%d]: %s\n", ret, strerror(ret));
         goto done;
     }
 
-    /* we're not done yet */
-    ret = EAGAIN;
+    ret = sdap_nested_group_single_step(req);
+    if (ret == EOK) {
+        ret = sdap_nested_group_single_recurse(req);
+    }
 
 done:
     if (ret == EOK) {
@@ -2193,26 +2720,601 @@ sdap_nested_group_lookup_unknown_recv(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
-struct sdap_nested_group_deref_state {
-    struct tevent_context *ev;
-    struct sdap_nested_group_ctx *group_ctx;
-    struct ldb_message_element *members;
-    int nesting_level;
+struct sdap_nested_group_batch {
+    enum sdap_nested_group_dn_type type;
+    const char *parent_dn;
+    const char *rdn_attr;
+    const char *filter;
 
-    struct sysdb_attrs **nested_groups;
-    int num_groups;
+    struct sdap_nested_group_member **members;
+    struct ldb_dn **dns;
+    int num_members;
 };
 
-static void sdap_nested_group_deref_direct_done(struct tevent_req *subreq);
-static void sdap_nested_group_deref_done(struct tevent_req *subreq);
-
-static struct tevent_req *
-sdap_nested_group_deref_send(TALLOC_CTX *mem_ctx,
-                             struct tevent_context *ev,
-                             struct sdap_nested_group_ctx *group_ctx,
-                             struct ldb_message_element *members,
-                             const char *group_dn,
-                             int nesting_level)
+static bool
+sdap_nested_group_batch_match(struct sdap_nested_group_batch *batch,
+                              enum sdap_nested_group_dn_type type,
+                              const char *parent_dn,
+                              const char *rdn_attr,
+                              const char *filter)
+{
+    if (batch->type != type) {
+        return false;
+    }
+
+    if (strcasecmp(batch->rdn_attr, rdn_attr) != 0) {
+        return false;
+    }
+
+    if (strcasecmp(batch->parent_dn, parent_dn) != 0) {
+        return false;
+    }
+
+    if (batch->filter == NULL || filter == NULL) {
+        return batch->filter == filter;
+    }
+
+    return strcmp(batch->filter, filter) == 0;
+}
+
+static errno_t
+sdap_nested_group_batch_add(TALLOC_CTX *mem_ctx,
+                            struct sdap_nested_group_ctx *group_ctx,
+                            struct sdap_nested_group_member *member,
+                            struct sdap_nested_group_batch **_batches,
+                            int *_num_batches)
+{
+    struct sdap_nested_group_batch *batches = *_batches;
+    struct sdap_nested_group_batch *batch = NULL;
+    int num_batches = *_num_batches;
+    struct ldb_context *ldb;
+    struct ldb_dn *dn = NULL;
+    struct ldb_dn *parent = NULL;
+    const char *filter = NULL;
+    const char *rdn_attr = NULL;
+    const char *parent_dn = NULL;
+    errno_t ret;
+    int i;
+
+    if (member->entry != NULL) {
+        /* we already have this one */
+        return EOK;
+    }
+
+    switch (member->type) {
+    case SDAP_NESTED_GROUP_DN_USER:
+        if (group_ctx->opts->schema_type == SDAP_SCHEMA_IPA_V1) {
+            /* the user name is guessed from the DN, no search is needed */
+            return EOK;
+        }
+        filter = member->user_filter;
+        break;
+    case SDAP_NESTED_GROUP_DN_GROUP:
+        filter = member->group_filter;
+        break;
+    case SDAP_NESTED_GROUP_DN_UNKNOWN:
+        /* we don't know which filter to use, look it up individually */
+        return EOK;
+    }
+
+    ldb = sysdb_ctx_get_ldb(group_ctx->domain->sysdb);
+
+    dn = ldb_dn_new(mem_ctx, ldb, member->dn);
+    if (dn == NULL) {
+        return ENOMEM;
+    }
+
+    /* multi-valued RDNs are not supported by ldb_dn and will be
+     * looked up individually */
+    if (!ldb_dn_validate(dn) || ldb_dn_get_comp_num(dn) < 2) {
+        DEBUG(SSSDBG_TRACE_ALL, "[%s] can not be looked up in a batch\n",
+                                 member->dn);
+        ret = EOK;
+        goto done;
+    }
+
+    parent = ldb_dn_get_parent(dn, dn);
+    if (parent == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    rdn_attr = ldb_dn_get_rdn_name(dn);
+    parent_dn = ldb_dn_get_linearized(parent);
+    if (rdn_attr == NULL || parent_dn == NULL) {
+        ret = EOK;
+        goto done;
+    }
+
+    /* only the last batch with the same key can still have free space */
+    for (i = num_batches - 1; i >= 0; i--) {
+        if (sdap_nested_group_batch_match(&batches[i], member->type,
+                                          parent_dn, rdn_attr, filter)) {
+            break;
+        }
+    }
+
+    if (i < 0 || batches[i].num_members >= group_ctx->batch_size) {
+        batches = talloc_realloc(mem_ctx, batches,
+                                 struct sdap_nested_group_batch,
+                                 num_batches + 1);
+        if (batches == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        *_batches = batches;
+
+        batch = &batches[num_batches];
+        memset(batch, 0, sizeof(struct sdap_nested_group_batch));
+
+        batch->type = member->type;
+        batch->filter = filter;
+        batch->parent_dn = talloc_strdup(batches, parent_dn);
+        batch->rdn_attr = talloc_strdup(batches, rdn_attr);
+        batch->members = talloc_zero_array(batches,
+                                           struct sdap_nested_group_member *,
+                                           group_ctx->batch_size);
+        batch->dns = talloc_zero_array(batches, struct ldb_dn *,
+                                       group_ctx->batch_size);
+        if (batch->parent_dn == NULL || batch->rdn_attr == NULL
+                || batch->members == NULL || batch->dns == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        num_batches++;
+        *_num_batches = num_batches;
+    } else {
+        batch = &batches[i];
+    }
+
+    batch->members[batch->num_members] = member;
+    batch->dns[batch->num_members] = talloc_steal(batch->dns, dn);
+    batch->num_members++;
+    dn = NULL;
+
+    ret = EOK;
+
+done:
+    talloc_free(dn);
+    return ret;
+}
+
+struct sdap_nested_group_batch_search_state {
+    struct sdap_nested_group_ctx *group_ctx;
+    struct sdap_nested_group_batch *batch;
+};
+
+static void sdap_nested_group_batch_search_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+sdap_nested_group_batch_search_send(TALLOC_CTX *mem_ctx,
+                                    struct tevent_context *ev,
+                                    struct sdap_nested_group_ctx *group_ctx,
+                                    struct sdap_nested_group_batch *batch)
+{
+    struct sdap_nested_group_batch_search_state *state = NULL;
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    struct sdap_attr_map *map = NULL;
+    const struct ldb_val *val = NULL;
+    const char **attrs = NULL;
+    const char *base_filter = NULL;
+    const char *filter = NULL;
+    char *or_filter = NULL;
+    char *value = NULL;
+    char *sanitized = NULL;
+    char *oc_list = NULL;
+    size_t map_num;
+    errno_t ret;
+    int i;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_nested_group_batch_search_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->group_ctx = group_ctx;
+    state->batch = batch;
+
+    or_filter = talloc_strdup(state, "");
+    if (or_filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    for (i = 0; i < batch->num_members; i++) {
+        val = ldb_dn_get_rdn_val(batch->dns[i]);
+        if (val == NULL) {
+            ret = EINVAL;
+            goto immediately;
+        }
+
+        value = talloc_strndup(state, (const char *)val->data, val->length);
+        if (value == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        ret = sss_filter_sanitize(state, value, &sanitized);
+        if (ret != EOK) {
+            goto immediately;
+        }
+
+        or_filter = talloc_asprintf_append_buffer(or_filter, "(%s=%s)",
+                                                  batch->rdn_attr, sanitized);
+        if (or_filter == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        talloc_zfree(value);
+        talloc_zfree(sanitized);
+    }
+
+    if (batch->type == SDAP_NESTED_GROUP_DN_USER) {
+        map = group_ctx->opts->user_map;
+        map_num = group_ctx->opts->user_map_cnt;
+
+        /* only pull down username and originalDN */
+        attrs = talloc_array(state, const char *, 3);
+        if (attrs == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        attrs[0] = "objectClass";
+        attrs[1] = map[SDAP_AT_USER_NAME].name;
+        attrs[2] = NULL;
+
+        base_filter = talloc_asprintf(state, "(objectclass=%s)",
+                                      map[SDAP_OC_USER].name);
+    } else {
+        map = group_ctx->opts->group_map;
+        map_num = SDAP_OPTS_GROUP;
+
+        ret = build_attrs_from_map(state, map, SDAP_OPTS_GROUP, NULL,
+                                   &attrs, NULL);
+        if (ret != EOK) {
+            goto immediately;
+        }
+
+        oc_list = sdap_make_oc_list(state, map);
+        if (oc_list == NULL) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Failed to create objectClass list.\n");
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        base_filter = talloc_asprintf(state, "(&(%s)(%s=*))", oc_list,
+                                      map[SDAP_AT_GROUP_NAME].name);
+    }
+    if (base_filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    filter = talloc_asprintf(state, "(&%s(|%s))", base_filter, or_filter);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    /* use search base filter if needed */
+    filter = sdap_combine_filters(state, filter, batch->filter);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Looking up %d %s in [%s]\n",
+          batch->num_members,
+          batch->type == SDAP_NESTED_GROUP_DN_USER ? "users" : "groups",
+          batch->parent_dn);
+
+    subreq = sdap_get_generic_send(state, ev, group_ctx->opts, group_ctx->sh,
+                                   batch->parent_dn, LDAP_SCOPE_ONELEVEL,
+                                   filter, attrs, map, map_num,
+                                   dp_opt_get_int(group_ctx->opts->basic,
+                                                  SDAP_SEARCH_TIMEOUT),
+                                   false);
+    if (subreq == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    tevent_req_set_callback(subreq, sdap_nested_group_batch_search_done, req);
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void sdap_nested_group_batch_search_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_batch_search_state *state = NULL;
+    struct sdap_nested_group_batch *batch = NULL;
+    struct tevent_req *req = NULL;
+    struct sysdb_attrs **entries = NULL;
+    struct ldb_context *ldb = NULL;
+    struct ldb_dn *dn = NULL;
+    const char *orig_dn = NULL;
+    size_t count = 0;
+    size_t found = 0;
+    errno_t ret;
+    size_t i;
+    int j;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_batch_search_state);
+    batch = state->batch;
+
+    ret = sdap_get_generic_recv(subreq, state, &count, &entries);
+    talloc_zfree(subreq);
+    if (ret == ENOENT) {
+        count = 0;
+    } else if (ret != EOK) {
+        /* not fatal, the members will be looked up individually */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Batched lookup in [%s] failed "
+              "[%d]: %s\n", batch->parent_dn, ret, sss_strerror(ret));
+        count = 0;
+    }
+
+    ldb = sysdb_ctx_get_ldb(state->group_ctx->domain->sysdb);
+
+    for (i = 0; i < count; i++) {
+        ret = sysdb_attrs_get_string(entries[i], SYSDB_ORIG_DN, &orig_dn);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "The entry has no originalDN\n");
+            continue;
+        }
+
+        dn = ldb_dn_new(state, ldb, orig_dn);
+        if (dn == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        /* the filter matches any value of the RDN attribute so we need
+         * to make sure that this is really the object we asked for */
+        for (j = 0; j < batch->num_members; j++) {
+            if (batch->members[j]->entry == NULL
+                    && ldb_dn_compare(dn, batch->dns[j]) == 0) {
+                batch->members[j]->entry = entries[i];
+                found++;
+                break;
+            }
+        }
+
+        talloc_zfree(dn);
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "%zu/%d members found in [%s]\n",
+          found, batch->num_members, batch->parent_dn);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t
+sdap_nested_group_batch_search_recv(TALLOC_CTX *mem_ctx,
+                                    struct tevent_req *req)
+{
+    struct sdap_nested_group_batch_search_state *state = NULL;
+    struct sdap_nested_group_batch *batch = NULL;
+    int i;
+
+    state = tevent_req_data(req, struct sdap_nested_group_batch_search_state);
+    batch = state->batch;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    for (i = 0; i < batch->num_members; i++) {
+        if (batch->members[i]->entry != NULL) {
+            talloc_steal(mem_ctx, batch->members[i]->entry);
+        }
+    }
+
+    return EOK;
+}
+
+struct sdap_nested_group_lookup_batch_state {
+    struct tevent_context *ev;
+    struct sdap_nested_group_ctx *group_ctx;
+    struct sdap_nested_group_batch *batches;
+    int num_batches;
+    int batch_index;
+    int num_active;
+
+    /* holds entries found by all batches */
+    TALLOC_CTX *entries;
+};
+
+static errno_t sdap_nested_group_lookup_batch_step(struct tevent_req *req);
+static void sdap_nested_group_lookup_batch_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+sdap_nested_group_lookup_batch_send(TALLOC_CTX *mem_ctx,
+                                    struct tevent_context *ev,
+                                    struct sdap_nested_group_ctx *group_ctx,
+                                    struct sdap_nested_group_member *members,
+                                    int num_members)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    errno_t ret;
+    int i;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_nested_group_lookup_batch_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->group_ctx = group_ctx;
+    state->batches = NULL;
+    state->num_batches = 0;
+    state->batch_index = 0;
+    state->num_active = 0;
+
+    state->entries = talloc_new(state);
+    if (state->entries == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    /* group members by container, RDN attribute and search filter */
+    for (i = 0; i < num_members; i++) {
+        ret = sdap_nested_group_batch_add(state, group_ctx, &members[i],
+                                          &state->batches,
+                                          &state->num_batches);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "Unable to add member into a batch "
+                  "[%d]: %s\n", ret, sss_strerror(ret));
+            goto immediately;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "%d members split into %d batches\n",
+          num_members, state->num_batches);
+
+    ret = sdap_nested_group_lookup_batch_step(req);
+    if (ret != EAGAIN) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t sdap_nested_group_lookup_batch_step(struct tevent_req *req)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct sdap_nested_group_batch *batch = NULL;
+    struct tevent_req *subreq = NULL;
+
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    while (state->num_active < BATCH_LOOKUPS_IN_FLIGHT
+            && state->batch_index < state->num_batches) {
+        batch = &state->batches[state->batch_index];
+        state->batch_index++;
+
+        if (batch->num_members < 2) {
+            /* base search is cheaper for a single member */
+            continue;
+        }
+
+        subreq = sdap_nested_group_batch_search_send(state, state->ev,
+                                                     state->group_ctx,
+                                                     batch);
+        if (subreq == NULL) {
+            return ENOMEM;
+        }
+
+        tevent_req_set_callback(subreq, sdap_nested_group_lookup_batch_done,
+                                req);
+
+        state->num_active++;
+    }
+
+    if (state->num_active > 0) {
+        return EAGAIN;
+    }
+
+    /* we're done */
+    return EOK;
+}
+
+static void sdap_nested_group_lookup_batch_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    ret = sdap_nested_group_batch_search_recv(state->entries, subreq);
+    talloc_zfree(subreq);
+    state->num_active--;
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sdap_nested_group_lookup_batch_step(req);
+
+done:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else if (ret != EAGAIN) {
+        tevent_req_error(req, ret);
+    }
+
+    return;
+}
+
+static errno_t sdap_nested_group_lookup_batch_recv(TALLOC_CTX *mem_ctx,
+                                                   struct tevent_req *req)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    talloc_steal(mem_ctx, state->entries);
+
+    return EOK;
+}
+
+struct sdap_nested_group_deref_state {
+    struct tevent_context *ev;
+    struct sdap_nested_group_ctx *group_ctx;
+    struct ldb_message_element *members;
+    int nesting_level;
+
+    struct sysdb_attrs **nested_groups;
+    int num_groups;
+};
+
+static void sdap_nested_group_deref_direct_done(struct tevent_req *subreq);
+static void sdap_nested_group_deref_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+sdap_nested_group_deref_send(TALLOC_CTX *mem_ctx,
+                             struct tevent_context *ev,
+                             struct sdap_nested_group_ctx *group_ctx,
+                             struct ldb_message_element *members,
+                             const char *group_dn,
+                             int nesting_level)
 {
     struct sdap_nested_group_deref_state *state = NULL;
     struct tevent_req *req = NULL;
@@ -2389,6 +3491,10 @@ sdap_nested_group_deref_direct_process(struct tevent_req *subreq)
                 continue;
             }
 
+            sdap_nested_group_cache_add(state->group_ctx, orig_dn,
+                                        SDAP_NESTED_GROUP_DN_USER,
+                                        entries[i]->attrs);
+
             /* save user in hash table */
             ret = sdap_nested_group_hash_user(state->group_ctx,
                                               entries[i]->attrs);
@@ -2414,6 +3520,10 @@ sdap_nested_group_deref_direct_process(struct tevent_req *subreq)
                 continue;
             }
 
+            sdap_nested_group_cache_add(state->group_ctx, orig_dn,
+                                        SDAP_NESTED_GROUP_DN_GROUP,
+                                        entries[i]->attrs);
+
             /* save group in hash table */
             ret = sdap_nested_group_hash_group(state->group_ctx,
                                                entries[i]->attrs);
@@ -88,6 +88,26 @@ int sdap_get_tgt_recv(struct tevent_req *req,
                       char **ccname,
                       time_t *expire_time_out);
 
+errno_t sdap_tgt_cache_lookup(TALLOC_CTX *mem_ctx,
+                              struct sdap_options *opts,
+                              const char *realm_str,
+                              const char *princ_str,
+                              const char *keytab_name,
+                              char **_ccname,
+                              time_t *_expire_time);
+
+errno_t sdap_tgt_cache_store(struct sdap_options *opts,
+                             const char *realm_str,
+                             const char *princ_str,
+                             const char *keytab_name,
+                             const char *ccname,
+                             time_t expire_time);
+
+void sdap_tgt_cache_invalidate(struct sdap_options *opts,
+                               const char *realm_str,
+                               const char *princ_str,
+                               const char *keytab_name);
+
 int sdap_save_users(TALLOC_CTX *memctx,
                     struct sysdb_ctx *sysdb,
                     struct sss_domain_info *dom,
@@ -0,0 +1,376 @@
+/*
+    SSSD
+
+    Retrieval of ranged attribute values
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+
+#include "util/util.h"
+#include "providers/ldap/sdap_async.h"
+#include "providers/ldap/sdap_range.h"
+
+/* Number of ranges requested in parallel. The server returns at most
+ * MaxValRange values per request, so each range has the size of the
+ * first one. Requests past the last range return no values and are
+ * ignored. One request retrieves at most this many ranges so the caller
+ * can process them before asking for more. */
+#define SDAP_RANGE_REQUESTS_IN_FLIGHT 4
+
+struct sdap_range_retrieve_state {
+    struct tevent_context *ev;
+    struct sdap_options *opts;
+    struct sdap_handle *sh;
+    const char *dn;
+    const char *attr;
+    int timeout;
+    sdap_range_values_fn values_fn;
+    void *pvt;
+
+    uint32_t step;
+    uint32_t next_low;
+    uint32_t window_end;
+    int num_in_flight;
+
+    /* Lower bound of the last range, known once the server replies
+     * with range=<low>-* */
+    bool end_found;
+    uint32_t end_low;
+
+    /* Lowest range that failed. */
+    errno_t error;
+    uint32_t error_low;
+
+    size_t num_requests;
+    size_t num_values;
+};
+
+struct sdap_range_chunk {
+    struct tevent_req *req;
+    uint32_t low;
+    uint32_t high;
+};
+
+static errno_t sdap_range_retrieve_fill(struct tevent_req *req);
+static void sdap_range_retrieve_done(struct tevent_req *subreq);
+
+struct tevent_req *
+sdap_range_retrieve_send(TALLOC_CTX *mem_ctx,
+                         struct tevent_context *ev,
+                         struct sdap_options *opts,
+                         struct sdap_handle *sh,
+                         const char *dn,
+                         const char *attr,
+                         uint32_t offset,
+                         uint32_t step,
+                         int timeout,
+                         sdap_range_values_fn values_fn,
+                         void *pvt)
+{
+    struct sdap_range_retrieve_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_range_retrieve_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    if (offset == 0 || step == 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Invalid range offset\n");
+        ret = EINVAL;
+        goto immediately;
+    }
+
+    state->ev = ev;
+    state->opts = opts;
+    state->sh = sh;
+    state->timeout = timeout;
+    state->values_fn = values_fn;
+    state->pvt = pvt;
+    state->step = step;
+    state->next_low = offset;
+    if (step > (UINT32_MAX - offset) / SDAP_RANGE_REQUESTS_IN_FLIGHT) {
+        state->window_end = UINT32_MAX;
+    } else {
+        state->window_end = offset + step * SDAP_RANGE_REQUESTS_IN_FLIGHT;
+    }
+
+    state->dn = talloc_strdup(state, dn);
+    state->attr = talloc_strdup(state, attr);
+    if (state->dn == NULL || state->attr == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Retrieving values of [%s] of [%s] "
+          "from offset %"PRIu32"\n", attr, dn, offset);
+
+    ret = sdap_range_retrieve_fill(req);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    if (state->num_in_flight == 0) {
+        /* No range can follow the offset. */
+        ret = EOK;
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t sdap_range_retrieve_issue(struct tevent_req *req,
+                                         uint32_t low,
+                                         uint32_t high)
+{
+    struct sdap_range_retrieve_state *state;
+    struct sdap_range_chunk *chunk;
+    struct tevent_req *subreq;
+    const char **attrs;
+
+    state = tevent_req_data(req, struct sdap_range_retrieve_state);
+
+    chunk = talloc_zero(state, struct sdap_range_chunk);
+    if (chunk == NULL) {
+        return ENOMEM;
+    }
+
+    chunk->req = req;
+    chunk->low = low;
+    chunk->high = high;
+
+    attrs = talloc_zero_array(chunk, const char *, 2);
+    if (attrs == NULL) {
+        talloc_free(chunk);
+        return ENOMEM;
+    }
+
+    attrs[0] = talloc_asprintf(attrs, "%s;range=%"PRIu32"-%"PRIu32,
+                               state->attr, low, high);
+    if (attrs[0] == NULL) {
+        talloc_free(chunk);
+        return ENOMEM;
+    }
+
+    /* The reply tells whether more values follow this range. */
+    subreq = sdap_get_and_parse_generic_send(chunk, state->ev, state->opts,
+                                             state->sh, state->dn,
+                                             LDAP_SCOPE_BASE, "(objectClass=*)",
+                                             attrs, NULL, 0, 0, NULL, NULL, 0,
+                                             state->timeout, false, true);
+    if (subreq == NULL) {
+        talloc_free(chunk);
+        return ENOMEM;
+    }
+
+    tevent_req_set_callback(subreq, sdap_range_retrieve_done, chunk);
+
+    state->num_in_flight++;
+    state->num_requests++;
+
+    return EOK;
+}
+
+static errno_t sdap_range_retrieve_fill(struct tevent_req *req)
+{
+    struct sdap_range_retrieve_state *state;
+    uint32_t high;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct sdap_range_retrieve_state);
+
+    while (state->num_in_flight < SDAP_RANGE_REQUESTS_IN_FLIGHT
+            && state->next_low < state->window_end
+            && !state->end_found && state->error == EOK) {
+        if (state->next_low > UINT32_MAX - state->step) {
+            break;
+        }
+
+        high = state->next_low + state->step - 1;
+        ret = sdap_range_retrieve_issue(req, state->next_low, high);
+        if (ret != EOK) {
+            return ret;
+        }
+
+        state->next_low = high + 1;
+    }
+
+    return EOK;
+}
+
+static void sdap_range_retrieve_set_end(struct sdap_range_retrieve_state *state,
+                                        uint32_t low)
+{
+    if (!state->end_found || low < state->end_low) {
+        state->end_low = low;
+    }
+
+    state->end_found = true;
+}
+
+static errno_t sdap_range_retrieve_chunk(struct sdap_range_chunk *chunk,
+                                         size_t count,
+                                         struct sysdb_attrs **reply)
+{
+    struct sdap_range_retrieve_state *state;
+    struct ldb_message_element *el;
+    uint32_t next;
+    errno_t ret;
+
+    state = tevent_req_data(chunk->req, struct sdap_range_retrieve_state);
+
+    if (count != 1) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Range %"PRIu32"-%"PRIu32" of [%s] "
+              "returned %zu entries\n", chunk->low, chunk->high,
+              state->dn, count);
+        sdap_range_retrieve_set_end(state, chunk->low);
+        return EOK;
+    }
+
+    ret = sysdb_attrs_get_el_ext(reply[0], state->attr, false, &el);
+    if (ret == ENOENT) {
+        /* Range past the last value. */
+        sdap_range_retrieve_set_end(state, chunk->low);
+        return EOK;
+    } else if (ret != EOK) {
+        return ret;
+    }
+
+    state->num_values += el->num_values;
+    ret = state->values_fn(el, state->pvt);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    ret = sdap_range_get_pending(reply[0], state->attr, &next);
+    if (ret == ENOENT) {
+        /* This was range=<low>-* */
+        sdap_range_retrieve_set_end(state, chunk->low);
+        return EOK;
+    } else if (ret != EOK) {
+        return ret;
+    }
+
+    if (next <= chunk->high) {
+        /* The server returned fewer values than requested, ask for the
+         * rest of this range. */
+        return sdap_range_retrieve_issue(chunk->req, next, chunk->high);
+    }
+
+    return EOK;
+}
+
+static void sdap_range_retrieve_done(struct tevent_req *subreq)
+{
+    struct sdap_range_retrieve_state *state;
+    struct sdap_range_chunk *chunk;
+    struct sysdb_attrs **reply;
+    struct tevent_req *req;
+    size_t count;
+    errno_t ret;
+
+    chunk = tevent_req_callback_data(subreq, struct sdap_range_chunk);
+    req = chunk->req;
+    state = tevent_req_data(req, struct sdap_range_retrieve_state);
+
+    ret = sdap_get_and_parse_generic_recv(subreq, chunk, &count, &reply);
+    talloc_zfree(subreq);
+    state->num_in_flight--;
+
+    if (state->end_found && chunk->low > state->end_low) {
+        /* Speculative request past the last range. */
+        ret = EOK;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Range %"PRIu32"-%"PRIu32" of [%s] "
+              "failed [%d]: %s\n", chunk->low, chunk->high, state->dn,
+              ret, sss_strerror(ret));
+
+        if (state->error == EOK || chunk->low < state->error_low) {
+            state->error = ret;
+            state->error_low = chunk->low;
+        }
+        ret = EOK;
+    } else {
+        ret = sdap_range_retrieve_chunk(chunk, count, reply);
+    }
+
+    talloc_free(chunk);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sdap_range_retrieve_fill(req);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (state->num_in_flight > 0) {
+        return;
+    }
+
+    /* A failed request past the last range is expected. */
+    if (state->error != EOK
+            && (!state->end_found || state->error_low <= state->end_low)) {
+        ret = state->error;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Retrieved %zu values of [%s] of [%s] "
+          "in %zu range requests\n", state->num_values, state->attr,
+          state->dn, state->num_requests);
+
+done:
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+errno_t sdap_range_retrieve_recv(struct tevent_req *req,
+                                 uint32_t *_next_offset)
+{
+    struct sdap_range_retrieve_state *state;
+
+    state = tevent_req_data(req, struct sdap_range_retrieve_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (state->end_found || state->next_low < state->window_end) {
+        *_next_offset = 0;
+    } else {
+        *_next_offset = state->window_end;
+    }
+
+    return EOK;
+}
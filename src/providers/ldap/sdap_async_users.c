@@ -864,7 +864,7 @@ static errno_t sdap_search_user_next_base(struct tevent_req *req)
             state->filter, state->attrs,
             state->opts->user_map, state->opts->user_map_cnt,
             0, NULL, NULL, sizelimit, state->timeout,
-            need_paging);
+            need_paging, false);
     if (subreq == NULL) {
         return ENOMEM;
     }
@@ -512,3 +512,231 @@ static errno_t set_tgt_child_timeout(struct tevent_req *req,
 
     return EOK;
 }
+
+/* ==TGT-cache============================================================ */
+
+/* The TGT is stored by ldap_child in a per-realm ccache file that outlives
+ * the child, so a ticket obtained for one connection can be reused by every
+ * later connection of the same principal until it gets close to expiry.
+ * Every domain keeps its own list in its sdap_options, the entries are
+ * allocated on the options and go away with them. Since domains of the same
+ * realm write the same ccache file, an entry also remembers which file it
+ * saw and is dropped once another ticket has been renamed over it. */
+
+/* A new ticket is requested once less than 1/SDAP_TGT_CACHE_RENEW_DIVISOR
+ * of its lifetime remains. */
+#define SDAP_TGT_CACHE_RENEW_DIVISOR 4
+
+struct sdap_tgt_cache_entry {
+    char *realm;
+    char *principal;
+    char *keytab;
+    char *ccname;
+    dev_t ccache_dev;
+    ino_t ccache_ino;
+    time_t issue_time;
+    time_t expire_time;
+
+    struct sdap_tgt_cache_entry *prev;
+    struct sdap_tgt_cache_entry *next;
+};
+
+static bool sdap_tgt_cache_str_equal(const char *s1, const char *s2)
+{
+    if (s1 == NULL || s2 == NULL) {
+        return s1 == s2;
+    }
+
+    return strcmp(s1, s2) == 0;
+}
+
+static struct sdap_tgt_cache_entry *
+sdap_tgt_cache_find(struct sdap_options *opts,
+                    const char *realm_str,
+                    const char *princ_str,
+                    const char *keytab_name)
+{
+    struct sdap_tgt_cache_entry *entry;
+
+    DLIST_FOR_EACH(entry, opts->tgt_cache) {
+        if (sdap_tgt_cache_str_equal(entry->realm, realm_str)
+                && sdap_tgt_cache_str_equal(entry->principal, princ_str)
+                && sdap_tgt_cache_str_equal(entry->keytab, keytab_name)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void sdap_tgt_cache_remove(struct sdap_options *opts,
+                                  struct sdap_tgt_cache_entry *entry)
+{
+    DLIST_REMOVE(opts->tgt_cache, entry);
+    talloc_free(entry);
+}
+
+static bool sdap_tgt_cache_ccache_stat(const char *ccname, struct stat *st)
+{
+    const char *path;
+    int ret;
+
+    if (strncmp(ccname, "FILE:", 5) != 0) {
+        /* ldap_child only creates FILE ccaches */
+        return false;
+    }
+    path = ccname + 5;
+
+    ret = stat(path, st);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_TRACE_FUNC, "Cached ccache [%s] is not available "
+              "[%d]: %s\n", path, ret, sss_strerror(ret));
+        return false;
+    }
+
+    return true;
+}
+
+errno_t sdap_tgt_cache_lookup(TALLOC_CTX *mem_ctx,
+                              struct sdap_options *opts,
+                              const char *realm_str,
+                              const char *princ_str,
+                              const char *keytab_name,
+                              char **_ccname,
+                              time_t *_expire_time)
+{
+    struct sdap_tgt_cache_entry *entry;
+    struct stat st;
+    time_t renew_time;
+    time_t now;
+    char *ccname;
+
+    entry = sdap_tgt_cache_find(opts, realm_str, princ_str, keytab_name);
+    if (entry == NULL) {
+        return ENOENT;
+    }
+
+    /* Get a new ticket ahead of expiry, once the remaining lifetime drops
+     * below a fraction of the original one. */
+    renew_time = entry->expire_time
+                 - (entry->expire_time - entry->issue_time)
+                   / SDAP_TGT_CACHE_RENEW_DIVISOR;
+    now = time(NULL);
+    if (now >= renew_time) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Cached TGT for [%s] expires at [%ld], "
+              "a new one is needed\n", princ_str ? princ_str : "default",
+              (long)entry->expire_time);
+        sdap_tgt_cache_remove(opts, entry);
+        return ENOENT;
+    }
+
+    if (!sdap_tgt_cache_ccache_stat(entry->ccname, &st)) {
+        sdap_tgt_cache_remove(opts, entry);
+        return ENOENT;
+    }
+
+    if (st.st_dev != entry->ccache_dev || st.st_ino != entry->ccache_ino) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Ccache [%s] was replaced since the TGT "
+              "was cached\n", entry->ccname);
+        sdap_tgt_cache_remove(opts, entry);
+        return ENOENT;
+    }
+
+    ccname = talloc_strdup(mem_ctx, entry->ccname);
+    if (ccname == NULL) {
+        return ENOMEM;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Using cached TGT for [%s] in [%s], "
+          "expires at [%ld]\n", princ_str ? princ_str : "default",
+          ccname, (long)entry->expire_time);
+
+    *_ccname = ccname;
+    *_expire_time = entry->expire_time;
+    return EOK;
+}
+
+errno_t sdap_tgt_cache_store(struct sdap_options *opts,
+                             const char *realm_str,
+                             const char *princ_str,
+                             const char *keytab_name,
+                             const char *ccname,
+                             time_t expire_time)
+{
+    struct sdap_tgt_cache_entry *entry;
+    struct sdap_tgt_cache_entry *next;
+    struct stat st;
+
+    /* ldap_child uses one ccache file per realm, so a new ticket replaces
+     * any cached ticket stored in the same ccache. */
+    for (entry = opts->tgt_cache; entry != NULL; entry = next) {
+        next = entry->next;
+        if (strcmp(entry->ccname, ccname) == 0
+                || (sdap_tgt_cache_str_equal(entry->realm, realm_str)
+                    && sdap_tgt_cache_str_equal(entry->principal, princ_str)
+                    && sdap_tgt_cache_str_equal(entry->keytab, keytab_name))) {
+            sdap_tgt_cache_remove(opts, entry);
+        }
+    }
+
+    if (!sdap_tgt_cache_ccache_stat(ccname, &st)) {
+        return ENOENT;
+    }
+
+    entry = talloc_zero(opts, struct sdap_tgt_cache_entry);
+    if (entry == NULL) {
+        return ENOMEM;
+    }
+
+    entry->ccache_dev = st.st_dev;
+    entry->ccache_ino = st.st_ino;
+
+    entry->issue_time = time(NULL);
+    entry->expire_time = expire_time;
+    entry->ccname = talloc_strdup(entry, ccname);
+    if (entry->ccname == NULL) {
+        goto fail;
+    }
+
+    if (realm_str != NULL) {
+        entry->realm = talloc_strdup(entry, realm_str);
+        if (entry->realm == NULL) {
+            goto fail;
+        }
+    }
+
+    if (princ_str != NULL) {
+        entry->principal = talloc_strdup(entry, princ_str);
+        if (entry->principal == NULL) {
+            goto fail;
+        }
+    }
+
+    if (keytab_name != NULL) {
+        entry->keytab = talloc_strdup(entry, keytab_name);
+        if (entry->keytab == NULL) {
+            goto fail;
+        }
+    }
+
+    DLIST_ADD(opts->tgt_cache, entry);
+    return EOK;
+
+fail:
+    talloc_free(entry);
+    return ENOMEM;
+}
+
+void sdap_tgt_cache_invalidate(struct sdap_options *opts,
+                               const char *realm_str,
+                               const char *princ_str,
+                               const char *keytab_name)
+{
+    struct sdap_tgt_cache_entry *entry;
+
+    entry = sdap_tgt_cache_find(opts, realm_str, princ_str, keytab_name);
+    if (entry != NULL) {
+        sdap_tgt_cache_remove(opts, entry);
+    }
+}
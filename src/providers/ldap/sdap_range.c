@@ -140,3 +140,84 @@ done:
     talloc_free(tmp_ctx);
     return ret;
 }
+
+errno_t sdap_range_add_pending(struct sysdb_attrs *attrs,
+                               const char *attr,
+                               uint32_t offset)
+{
+    char *value;
+    errno_t ret;
+
+    value = talloc_asprintf(attrs, "%s;%"PRIu32, attr, offset);
+    if (value == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_attrs_add_string(attrs, SDAP_RANGE_PENDING, value);
+    talloc_free(value);
+
+    return ret;
+}
+
+errno_t sdap_range_get_pending(struct sysdb_attrs *attrs,
+                               const char *attr,
+                               uint32_t *_offset)
+{
+    struct ldb_message_element *el;
+    const char *value;
+    const char *sep;
+    char *endptr;
+    uint32_t offset;
+    size_t attr_len;
+    errno_t ret;
+    unsigned int i;
+
+    ret = sysdb_attrs_get_el_ext(attrs, SDAP_RANGE_PENDING, false, &el);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    attr_len = strlen(attr);
+    for (i = 0; i < el->num_values; i++) {
+        value = (const char *)el->values[i].data;
+        sep = strrchr(value, ';');
+        if (sep == NULL || (size_t)(sep - value) != attr_len
+                || strncasecmp(value, attr, attr_len) != 0) {
+            continue;
+        }
+
+        offset = strtouint32(sep + 1, &endptr, 10);
+        if (errno != 0 || *endptr != '\0') {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Invalid pending range [%s]\n", value);
+            return EINVAL;
+        }
+
+        *_offset = offset;
+        return EOK;
+    }
+
+    return ENOENT;
+}
+
+void sdap_range_remove_pending(struct sysdb_attrs *attrs)
+{
+    int i;
+
+    for (i = 0; i < attrs->num; i++) {
+        if (strcasecmp(attrs->a[i].name, SDAP_RANGE_PENDING) == 0) {
+            break;
+        }
+    }
+
+    if (i == attrs->num) {
+        return;
+    }
+
+    talloc_free(attrs->a[i].values);
+    talloc_free(discard_const(attrs->a[i].name));
+
+    memmove(&attrs->a[i], &attrs->a[i + 1],
+            (attrs->num - i - 1) * sizeof(struct ldb_message_element));
+    attrs->num--;
+}
@@ -24,6 +24,13 @@
 #define SDAP_RANGE_H_
 
 #include "src/util/util.h"
+#include "db/sysdb.h"
+
+/* Internal attribute recording ranged attributes whose remaining values
+ * were not returned yet. Each value has the form "<attribute>;<offset>".
+ * It is only kept in search results that asked for it and must never be
+ * stored in the cache. */
+#define SDAP_RANGE_PENDING "sdapRangePending"
 
 errno_t sdap_parse_range(TALLOC_CTX *mem_ctx,
                          const char *attr_desc,
@@ -31,4 +38,16 @@ errno_t sdap_parse_range(TALLOC_CTX *mem_ctx,
                          uint32_t *range_offset,
                          bool disable_range_retrieval);
 
+errno_t sdap_range_add_pending(struct sysdb_attrs *attrs,
+                               const char *attr,
+                               uint32_t offset);
+
+/* Returns ENOENT if all values of attr were already retrieved. */
+errno_t sdap_range_get_pending(struct sysdb_attrs *attrs,
+                               const char *attr,
+                               uint32_t *_offset);
+
+/* Pointers to other elements of attrs are not valid afterwards. */
+void sdap_range_remove_pending(struct sysdb_attrs *attrs);
+
 #endif /* SDAP_RANGE_H_ */
@@ -141,7 +141,8 @@ get_subdomains_recv(TALLOC_CTX *mem_ctx,
 
 /* ====== Iterate over all domains, searching for their subdomains  ======= */
 static errno_t process_subdomains(struct sss_domain_info *dom,
-                                  struct confdb_ctx *confdb);
+                                  struct confdb_ctx *confdb,
+                                  bool *_changed);
 static void set_time_of_last_request(struct resp_ctx *rctx);
 static errno_t check_last_request(struct resp_ctx *rctx, const char *hint);
 
@@ -149,6 +150,8 @@ struct sss_dp_get_domains_state {
     struct resp_ctx *rctx;
     struct sss_domain_info *dom;
     const char *hint;
+    /* Whether the list of domains has changed. */
+    bool changed;
 };
 
 static void
@@ -262,6 +265,19 @@ static void sss_resp_update_certmaps(struct resp_ctx *rctx)
     }
 }
 
+static bool resp_has_ipa_domain(struct resp_ctx *rctx)
+{
+    struct sss_domain_info *dom;
+
+    for (dom = rctx->domains; dom != NULL; dom = dom->next) {
+        if (dom->provider != NULL && strcmp(dom->provider, "ipa") == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 static void
 sss_dp_get_domains_process(struct tevent_req *subreq)
 {
@@ -273,6 +289,7 @@ sss_dp_get_domains_process(struct tevent_req *subreq)
     uint16_t dp_err;
     uint32_t dp_ret;
     const char *err_msg;
+    bool changed = false;
 
     ret = get_subdomains_recv(subreq, subreq, &dp_err, &dp_ret, &err_msg);
     talloc_zfree(subreq);
@@ -280,7 +297,10 @@ sss_dp_get_domains_process(struct tevent_req *subreq)
         goto fail;
     }
 
-    ret = process_subdomains(state->dom, state->rctx->cdb);
+    ret = process_subdomains(state->dom, state->rctx->cdb, &changed);
+    if (changed) {
+        state->changed = true;
+    }
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "process_subdomains failed, "
                                   "trying next domain.\n");
@@ -298,6 +318,19 @@ sss_dp_get_domains_process(struct tevent_req *subreq)
     if (state->dom == NULL) {
         /* No more domains to check, refreshing the active configuration */
         set_time_of_last_request(state->rctx);
+
+        sss_resp_update_certmaps(state->rctx);
+
+        /* Rebuilding the cache_req domain list and the negative cache is
+         * only needed if the list of domains has changed. IPA may change
+         * the domain resolution order without touching the domains. */
+        if (!state->changed && state->rctx->cr_domains != NULL
+                && !resp_has_ipa_domain(state->rctx)) {
+            DEBUG(SSSDBG_TRACE_FUNC, "Domains have not changed\n");
+            tevent_req_done(req);
+            return;
+        }
+
         ret = sss_resp_populate_cr_domains(state->rctx);
         if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE,
@@ -306,8 +339,6 @@ sss_dp_get_domains_process(struct tevent_req *subreq)
             goto fail;
         }
 
-        sss_resp_update_certmaps(state->rctx);
-
         ret = sss_ncache_reset_repopulate_permanent(state->rctx,
                                                     state->rctx->ncache);
         if (ret != EOK) {
@@ -333,8 +364,10 @@ fail:
 }
 
 static errno_t
-process_subdomains(struct sss_domain_info *domain, struct confdb_ctx *confdb)
+process_subdomains(struct sss_domain_info *domain, struct confdb_ctx *confdb,
+                   bool *_changed)
 {
+    bool master_changed = false;
     int ret;
 
     if (domain->realm == NULL ||
@@ -346,12 +379,16 @@ process_subdomains(struct sss_domain_info *domain, struct confdb_ctx *confdb)
                                          "failed.\n");
                 goto done;
         }
+        master_changed = true;
     }
 
     /* Retrieve all subdomains of this domain from sysdb
      * and create their struct sss_domain_info representations
      */
-    ret = sysdb_update_subdomains(domain, confdb);
+    ret = sysdb_update_subdomains_ext(domain, confdb, _changed);
+    if (ret == EOK && master_changed) {
+        *_changed = true;
+    }
     if (ret != EOK) {
         DEBUG(SSSDBG_FUNC_DATA, "sysdb_update_subdomains failed.\n");
         goto done;
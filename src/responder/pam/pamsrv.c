@@ -35,6 +35,7 @@
 
 #include "config.h"
 #include "util/util.h"
+#include "util/s3crypt_pool.h"
 #include "db/sysdb.h"
 #include "confdb/confdb.h"
 #include "responder/common/responder_packet.h"
@@ -50,6 +51,7 @@
 #define DEFAULT_ALLOWED_UIDS ALL_UIDS_ALLOWED
 #define DEFAULT_PAM_CERT_AUTH false
 #define DEFAULT_PAM_CERT_DB_PATH SYSCONFDIR"/sssd/pki/sssd_auth_ca_db.pem"
+#define DEFAULT_PAM_P11_CHILD_PERSISTENT false
 #define DEFAULT_PAM_INITGROUPS_SCHEME "no_session"
 
 static errno_t get_trusted_uids(struct pam_ctx *pctx)
@@ -164,6 +166,8 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
     struct pam_ctx *pctx;
     int ret;
     int id_timeout;
+    int auth_cache_timeout;
+    bool p11_child_persistent;
     int fd_limit;
     char *tmpstr = NULL;
 
@@ -174,7 +178,7 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
                            SSS_PAM_PRIV_SOCKET_NAME, priv_pipe_fd,
                            CONFDB_PAM_CONF_ENTRY,
                            SSS_BUS_PAM, SSS_PAM_SBUS_SERVICE_NAME,
-                           sss_connection_setup,
+                           pam_connection_setup,
                            &rctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE, "sss_process_init() failed\n");
@@ -292,6 +296,25 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
             goto done;
         }
 
+        ret = confdb_get_bool(pctx->rctx->cdb,
+                              CONFDB_PAM_CONF_ENTRY,
+                              CONFDB_PAM_P11_CHILD_PERSISTENT,
+                              DEFAULT_PAM_P11_CHILD_PERSISTENT,
+                              &p11_child_persistent);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_FATAL_FAILURE, "Failed to read %s [%d]: %s\n",
+                  CONFDB_PAM_P11_CHILD_PERSISTENT, ret, sss_strerror(ret));
+            goto done;
+        }
+
+        if (p11_child_persistent) {
+            ret = p11_child_worker_init(pctx, rctx->ev, &pctx->p11_worker);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE, "Unable to set up the p11_child "
+                      "worker [%d]: %s. Not fatal.\n", ret, sss_strerror(ret));
+                pctx->p11_worker = NULL;
+            }
+        }
     }
 
     if (pctx->cert_auth || pctx->num_prompting_config_sections != 0) {
@@ -327,6 +350,33 @@ static int pam_process_init(TALLOC_CTX *mem_ctx,
         }
     }
 
+    ret = s3crypt_pool_init(pctx, rctx->ev, 0, &pctx->crypt_pool);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to start password hashing "
+              "threads [%d]: %s. Cached passwords will be checked in the "
+              "main loop.\n", ret, sss_strerror(ret));
+        pctx->crypt_pool = NULL;
+    }
+
+    ret = confdb_get_int(cdb, CONFDB_PAM_CONF_ENTRY,
+                         CONFDB_PAM_AUTH_CACHE_TIMEOUT, 0,
+                         &auth_cache_timeout);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, "Failed to read %s [%d]: %s\n",
+              CONFDB_PAM_AUTH_CACHE_TIMEOUT, ret, sss_strerror(ret));
+        goto done;
+    }
+
+    if (auth_cache_timeout > 0) {
+        ret = pam_auth_cache_init(pctx, rctx->ev, pctx->crypt_pool,
+                                  auth_cache_timeout, &pctx->auth_cache);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Unable to set up the authentication "
+                  "cache [%d]: %s. Not fatal.\n", ret, sss_strerror(ret));
+            pctx->auth_cache = NULL;
+        }
+    }
+
     /* The responder is initialized. Now tell it to the monitor. */
     ret = sss_monitor_service_init(rctx, rctx->ev, SSS_BUS_PAM,
                                    SSS_PAM_SBUS_SERVICE_NAME,
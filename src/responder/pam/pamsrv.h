@@ -29,6 +29,9 @@
 #include "lib/certmap/sss_certmap.h"
 
 struct pam_auth_req;
+struct pam_auth_cache;
+struct s3crypt_pool;
+struct p11_child_worker;
 
 typedef void (pam_dp_callback_t)(struct pam_auth_req *preq);
 
@@ -57,11 +60,27 @@ struct pam_ctx {
     char *ca_db;
     struct sss_certmap_ctx *sss_certmap_ctx;
     char **smartcard_services;
+    /* Long-running p11_child, NULL if p11_child_persistent is not set */
+    struct p11_child_worker *p11_worker;
 
     char **prompting_config_sections;
     int num_prompting_config_sections;
 
     enum pam_initgroups_scheme initgroups_scheme;
+
+    /* Threads checking cached passwords, NULL if they are not used */
+    struct s3crypt_pool *crypt_pool;
+
+    /* Recent successful authentications, NULL if disabled */
+    struct pam_auth_cache *auth_cache;
+};
+
+/* State kept for each client connection. pam_sss uses one connection for
+ * all stages of a PAM transaction. */
+struct pam_state_ctx {
+    /* logon name of the last user whose group memberships were refreshed
+     * on this connection */
+    char *initgr_logon_name;
 };
 
 struct pam_auth_req {
@@ -76,8 +95,13 @@ struct pam_auth_req {
     bool is_uid_trusted;
     void *data;
     bool use_cached_auth;
+    /* value of use_cached_auth while the cached password is checked */
+    bool saved_use_cached_auth;
     /* whether cached authentication was tried and failed */
     bool cached_auth_failed;
+    /* whether the in-memory authentication cache was already consulted */
+    bool auth_cache_checked;
+    bool auth_cache_hit;
 
     struct ldb_message *user_obj;
     struct cert_auth_info *cert_list;
@@ -87,6 +111,8 @@ struct pam_auth_req {
 
 struct sss_cmd_table *get_pam_cmds(void);
 
+int pam_connection_setup(struct cli_ctx *cctx);
+
 errno_t
 pam_dp_send_req(struct pam_auth_req *preq);
 
@@ -94,6 +120,14 @@ int LOCAL_pam_handler(struct pam_auth_req *preq);
 
 errno_t p11_child_init(struct pam_ctx *pctx);
 
+/* The worker process itself is started with the first request. */
+errno_t p11_child_worker_init(TALLOC_CTX *mem_ctx,
+                              struct tevent_context *ev,
+                              struct p11_child_worker **_worker);
+
+/* Returns -1 if the worker process is not running. */
+pid_t p11_child_worker_get_pid(struct p11_child_worker *worker);
+
 struct cert_auth_info;
 const char *sss_cai_get_cert(struct cert_auth_info *i);
 const char *sss_cai_get_token_name(struct cert_auth_info *i);
@@ -107,8 +141,11 @@ void sss_cai_set_cert_user_objs(struct cert_auth_info *i,
 void sss_cai_check_users(struct cert_auth_info **list, size_t *_cert_count,
                          size_t *_cert_user_count);
 
+/* If p11_worker is not NULL the request is sent to the long-running
+ * p11_child instead of a new one, except when waiting for a card. */
 struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
                                        struct tevent_context *ev,
+                                       struct p11_child_worker *p11_worker,
                                        const char *ca_db,
                                        time_t timeout,
                                        const char *verify_opts,
@@ -141,4 +178,34 @@ errno_t pam_eval_prompting_config(struct pam_ctx *pctx, struct pam_data *pd);
 
 enum pam_initgroups_scheme pam_initgroups_string_to_enum(const char *str);
 const char *pam_initgroup_enum_to_string(enum pam_initgroups_scheme scheme);
+
+/* pamsrv_auth_cache.c */
+errno_t pam_auth_cache_init(TALLOC_CTX *mem_ctx,
+                            struct tevent_context *ev,
+                            struct s3crypt_pool *pool,
+                            time_t timeout,
+                            struct pam_auth_cache **_cache);
+
+/* Remembers the password of a successful online authentication. Nothing is
+ * stored if a one-time password might have been used. */
+void pam_auth_cache_store(struct pam_auth_cache *cache,
+                          struct pam_data *pd);
+
+/* Stores or drops entries depending on the command and the result of a
+ * finished request. cache_hit is true if the request was answered from the
+ * cache. */
+void pam_auth_cache_update(struct pam_auth_cache *cache,
+                           struct pam_data *pd,
+                           bool cache_hit);
+
+/* Drops all entries of the given internal user name. */
+void pam_auth_cache_invalidate(struct pam_auth_cache *cache,
+                               const char *username);
+
+/* Returns EOK if the password matches a cached entry, ENOENT otherwise. */
+struct tevent_req *pam_auth_cache_check_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct pam_auth_cache *cache,
+                                             struct pam_data *pd);
+errno_t pam_auth_cache_check_recv(struct tevent_req *req);
 #endif /* __PAMSRV_H__ */
@@ -0,0 +1,639 @@
+/*
+    SSSD
+
+    PAM Responder - cache of successful online authentications
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+
+#include "util/util.h"
+#include "util/crypto/sss_crypto.h"
+#include "util/s3crypt_pool.h"
+#include "responder/pam/pamsrv.h"
+
+/* The cache only remembers that a password was accepted by the back end for
+ * a user and a PAM service. Users are identified by their internal fully
+ * qualified name, which already contains the domain. The password itself is
+ * never stored, only a salted hash, created the same way as the hash of
+ * cached credentials in the sysdb.
+ *
+ * Entries are grouped by user so that all entries of a user can be dropped
+ * at once, e.g. after a password change. Each entry is removed by a timer
+ * after pam_auth_cache_timeout seconds. */
+
+struct pam_auth_cache {
+    struct tevent_context *ev;
+    struct s3crypt_pool *pool;
+    time_t timeout;
+    hash_table_t *users;
+
+    /* Incremented on every invalidation. Hashes which were computed while
+     * an invalidation happened are not stored. */
+    uint64_t generation;
+};
+
+struct pam_auth_cache_user {
+    struct pam_auth_cache *cache;
+    char *key;
+    struct pam_auth_cache_entry *entries;
+};
+
+struct pam_auth_cache_entry {
+    struct pam_auth_cache_user *user;
+    char *service;
+    char *hash;
+    /* Environment items sent with the original reply, e.g. KRB5CCNAME */
+    struct response_data *env;
+
+    struct pam_auth_cache_entry *prev;
+    struct pam_auth_cache_entry *next;
+};
+
+errno_t pam_auth_cache_init(TALLOC_CTX *mem_ctx,
+                            struct tevent_context *ev,
+                            struct s3crypt_pool *pool,
+                            time_t timeout,
+                            struct pam_auth_cache **_cache)
+{
+    struct pam_auth_cache *cache;
+    errno_t ret;
+
+    cache = talloc_zero(mem_ctx, struct pam_auth_cache);
+    if (cache == NULL) {
+        return ENOMEM;
+    }
+
+    cache->ev = ev;
+    cache->pool = pool;
+    cache->timeout = timeout;
+
+    ret = sss_hash_create(cache, 10, &cache->users);
+    if (ret != EOK) {
+        talloc_free(cache);
+        return ret;
+    }
+
+    *_cache = cache;
+
+    return EOK;
+}
+
+static struct pam_auth_cache_user *
+pam_auth_cache_get_user(struct pam_auth_cache *cache, const char *key)
+{
+    hash_key_t hkey;
+    hash_value_t value;
+    int hret;
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = discard_const_p(char, key);
+
+    hret = hash_lookup(cache->users, &hkey, &value);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return talloc_get_type(value.ptr, struct pam_auth_cache_user);
+}
+
+static void pam_auth_cache_remove_user(struct pam_auth_cache_user *user)
+{
+    hash_key_t hkey;
+    int hret;
+
+    hkey.type = HASH_KEY_STRING;
+    hkey.str = user->key;
+
+    hret = hash_delete(user->cache->users, &hkey);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Could not remove [%s] from the authentication cache: [%s]\n",
+              user->key, hash_error_string(hret));
+    }
+
+    talloc_free(user);
+}
+
+static struct pam_auth_cache_entry *
+pam_auth_cache_find(struct pam_auth_cache *cache,
+                    const char *user,
+                    const char *service)
+{
+    struct pam_auth_cache_user *cache_user;
+    struct pam_auth_cache_entry *entry;
+
+    cache_user = pam_auth_cache_get_user(cache, user);
+    if (cache_user == NULL) {
+        return NULL;
+    }
+
+    DLIST_FOR_EACH(entry, cache_user->entries) {
+        if (strcmp(entry->service, service) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void pam_auth_cache_entry_expired(struct tevent_context *ev,
+                                         struct tevent_timer *te,
+                                         struct timeval tv,
+                                         void *pvt)
+{
+    struct pam_auth_cache_entry *entry;
+    struct pam_auth_cache_user *user;
+
+    entry = talloc_get_type(pvt, struct pam_auth_cache_entry);
+    user = entry->user;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "[%s] for service [%s] removed from the authentication cache\n",
+          user->key, entry->service);
+
+    DLIST_REMOVE(user->entries, entry);
+    talloc_free(entry);
+
+    if (user->entries == NULL) {
+        pam_auth_cache_remove_user(user);
+    }
+}
+
+static errno_t pam_auth_cache_copy_env(TALLOC_CTX *mem_ctx,
+                                       struct response_data *resp_list,
+                                       struct response_data **_env)
+{
+    struct response_data *env = NULL;
+    struct response_data *resp;
+    struct response_data *copy;
+
+    for (resp = resp_list; resp != NULL; resp = resp->next) {
+        if (resp->type != SSS_PAM_ENV_ITEM) {
+            continue;
+        }
+
+        copy = talloc_zero(mem_ctx, struct response_data);
+        if (copy == NULL) {
+            return ENOMEM;
+        }
+
+        copy->type = resp->type;
+        copy->len = resp->len;
+        copy->data = talloc_memdup(copy, resp->data, resp->len);
+        if (copy->data == NULL) {
+            talloc_free(copy);
+            return ENOMEM;
+        }
+
+        copy->next = env;
+        env = copy;
+    }
+
+    *_env = env;
+
+    return EOK;
+}
+
+static errno_t pam_auth_cache_add(struct pam_auth_cache *cache,
+                                  const char *username,
+                                  const char *service,
+                                  char *hash,
+                                  struct response_data *env)
+{
+    struct pam_auth_cache_user *user;
+    struct pam_auth_cache_entry *entry;
+    struct tevent_timer *te;
+    hash_key_t hkey;
+    hash_value_t value;
+    int hret;
+    errno_t ret;
+
+    user = pam_auth_cache_get_user(cache, username);
+    if (user == NULL) {
+        user = talloc_zero(cache, struct pam_auth_cache_user);
+        if (user == NULL) {
+            return ENOMEM;
+        }
+
+        user->cache = cache;
+        user->key = talloc_strdup(user, username);
+        if (user->key == NULL) {
+            talloc_free(user);
+            return ENOMEM;
+        }
+
+        hkey.type = HASH_KEY_STRING;
+        hkey.str = user->key;
+        value.type = HASH_VALUE_PTR;
+        value.ptr = user;
+
+        hret = hash_enter(cache->users, &hkey, &value);
+        if (hret != HASH_SUCCESS) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "Could not add [%s] to the authentication cache: [%s]\n",
+                  user->key, hash_error_string(hret));
+            talloc_free(user);
+            return EIO;
+        }
+    } else {
+        /* Replace the entry of the same service. */
+        DLIST_FOR_EACH(entry, user->entries) {
+            if (strcmp(entry->service, service) == 0) {
+                DLIST_REMOVE(user->entries, entry);
+                talloc_free(entry);
+                break;
+            }
+        }
+    }
+
+    entry = talloc_zero(user, struct pam_auth_cache_entry);
+    if (entry == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    entry->user = user;
+    entry->hash = talloc_steal(entry, hash);
+    entry->env = talloc_steal(entry, env);
+    entry->service = talloc_strdup(entry, service);
+    if (entry->service == NULL) {
+        talloc_free(entry);
+        ret = ENOMEM;
+        goto done;
+    }
+
+    te = tevent_add_timer(cache->ev, entry,
+                          tevent_timeval_current_ofs(cache->timeout, 0),
+                          pam_auth_cache_entry_expired, entry);
+    if (te == NULL) {
+        talloc_free(entry);
+        ret = ENOMEM;
+        goto done;
+    }
+
+    DLIST_ADD(user->entries, entry);
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          "[%s] for service [%s] added to the authentication cache\n",
+          user->key, service);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK && user->entries == NULL) {
+        pam_auth_cache_remove_user(user);
+    }
+    return ret;
+}
+
+void pam_auth_cache_invalidate(struct pam_auth_cache *cache,
+                               const char *username)
+{
+    struct pam_auth_cache_user *user;
+
+    if (cache == NULL || username == NULL) {
+        return;
+    }
+
+    cache->generation++;
+
+    user = pam_auth_cache_get_user(cache, username);
+    if (user == NULL) {
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "Removing [%s] from the authentication cache\n", user->key);
+    pam_auth_cache_remove_user(user);
+}
+
+/* A one-time password is only valid once, so it must never be accepted
+ * from the cache. The back end reports with SSS_OTP that the password
+ * contained an OTP and with SSS_PAM_OTP_INFO that the user has a second
+ * factor, in which case the password alone may not be enough. */
+static bool pam_auth_cache_is_otp(struct response_data *resp_list)
+{
+    struct response_data *resp;
+
+    for (resp = resp_list; resp != NULL; resp = resp->next) {
+        if (resp->type == SSS_OTP || resp->type == SSS_PAM_OTP_INFO) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+struct pam_auth_cache_store_state {
+    struct pam_auth_cache *cache;
+    uint64_t generation;
+    char *user;
+    char *service;
+    struct response_data *env;
+};
+
+static void pam_auth_cache_store_done(struct tevent_req *subreq);
+
+void pam_auth_cache_store(struct pam_auth_cache *cache,
+                          struct pam_data *pd)
+{
+    struct pam_auth_cache_store_state *state;
+    struct tevent_req *subreq;
+    const char *password;
+    char *salt;
+    errno_t ret;
+
+    if (cache == NULL || pd->user == NULL) {
+        return;
+    }
+
+    ret = sss_authtok_get_password(pd->authtok, &password, NULL);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_TRACE_LIBS, "No password to cache.\n");
+        return;
+    }
+
+    if (pam_auth_cache_is_otp(pd->resp_list)) {
+        DEBUG(SSSDBG_TRACE_LIBS,
+              "[%s] might have used a one-time password, not caching.\n",
+              pd->user);
+        return;
+    }
+
+    state = talloc_zero(cache, struct pam_auth_cache_store_state);
+    if (state == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    state->cache = cache;
+    state->generation = cache->generation;
+    state->user = talloc_strdup(state, pd->user);
+    state->service = talloc_strdup(state,
+                                   pd->service != NULL ? pd->service : "");
+    if (state->user == NULL || state->service == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = pam_auth_cache_copy_env(state, pd->resp_list, &state->env);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = s3crypt_gen_salt(state, &salt);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to generate random salt.\n");
+        goto done;
+    }
+
+    subreq = s3crypt_sha512_send(state, cache->ev, cache->pool,
+                                 password, salt);
+    if (subreq == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    tevent_req_set_callback(subreq, pam_auth_cache_store_done, state);
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Failed to add [%s] to the authentication cache [%d]: %s. "
+              "Not fatal.\n", pd->user, ret, sss_strerror(ret));
+        talloc_free(state);
+    }
+}
+
+static void pam_auth_cache_store_done(struct tevent_req *subreq)
+{
+    struct pam_auth_cache_store_state *state;
+    char *hash;
+    errno_t ret;
+
+    state = tevent_req_callback_data(subreq,
+                                     struct pam_auth_cache_store_state);
+
+    ret = s3crypt_sha512_recv(state, subreq, &hash);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to create password hash.\n");
+        goto done;
+    }
+
+    if (state->generation != state->cache->generation) {
+        DEBUG(SSSDBG_TRACE_FUNC, "The authentication cache was invalidated "
+              "meanwhile, not adding [%s].\n", state->user);
+        ret = EOK;
+        goto done;
+    }
+
+    ret = pam_auth_cache_add(state->cache, state->user, state->service,
+                             hash, state->env);
+
+done:
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              "Failed to add [%s] to the authentication cache [%d]: %s. "
+              "Not fatal.\n", state->user, ret, sss_strerror(ret));
+    }
+    talloc_free(state);
+}
+
+void pam_auth_cache_update(struct pam_auth_cache *cache,
+                           struct pam_data *pd,
+                           bool cache_hit)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    switch (pd->cmd) {
+    case SSS_PAM_AUTHENTICATE:
+    case SSS_PAM_ACCT_MGMT:
+        switch (pd->pam_status) {
+        case PAM_SUCCESS:
+            /* Only remember passwords the back end has just accepted. */
+            if (pd->cmd == SSS_PAM_AUTHENTICATE
+                    && !pd->offline_auth
+                    && !cache_hit) {
+                pam_auth_cache_store(cache, pd);
+            }
+            break;
+        case PAM_AUTH_ERR:
+        case PAM_PERM_DENIED:
+        case PAM_ACCT_EXPIRED:
+        case PAM_NEW_AUTHTOK_REQD:
+        case PAM_MAXTRIES:
+            /* The password is wrong, the account is locked or the password
+             * has to be changed. */
+            pam_auth_cache_invalidate(cache, pd->user);
+            break;
+        default:
+            break;
+        }
+        break;
+    case SSS_PAM_CHAUTHTOK:
+        if (pd->pam_status == PAM_SUCCESS) {
+            pam_auth_cache_invalidate(cache, pd->user);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+struct pam_auth_cache_check_state {
+    struct pam_auth_cache *cache;
+    uint64_t generation;
+    struct pam_data *pd;
+    char *hash;
+    struct response_data *env;
+};
+
+static void pam_auth_cache_check_done(struct tevent_req *subreq);
+
+struct tevent_req *pam_auth_cache_check_send(TALLOC_CTX *mem_ctx,
+                                             struct tevent_context *ev,
+                                             struct pam_auth_cache *cache,
+                                             struct pam_data *pd)
+{
+    struct pam_auth_cache_check_state *state;
+    struct pam_auth_cache_entry *entry;
+    struct tevent_req *subreq;
+    struct tevent_req *req;
+    const char *password;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct pam_auth_cache_check_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    state->cache = cache;
+    state->generation = cache->generation;
+    state->pd = pd;
+
+    if (pd->user == NULL) {
+        ret = ENOENT;
+        goto immediately;
+    }
+
+    ret = sss_authtok_get_password(pd->authtok, &password, NULL);
+    if (ret != EOK) {
+        ret = ENOENT;
+        goto immediately;
+    }
+
+    entry = pam_auth_cache_find(cache, pd->user,
+                                pd->service != NULL ? pd->service : "");
+    if (entry == NULL) {
+        DEBUG(SSSDBG_TRACE_ALL,
+              "[%s] not found in the authentication cache.\n", pd->user);
+        ret = ENOENT;
+        goto immediately;
+    }
+
+    /* The entry might be removed while the hash is computed. */
+    state->hash = talloc_strdup(state, entry->hash);
+    if (state->hash == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    ret = pam_auth_cache_copy_env(state, entry->env, &state->env);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    subreq = s3crypt_sha512_send(state, ev, cache->pool, password,
+                                 state->hash);
+    if (subreq == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    tevent_req_set_callback(subreq, pam_auth_cache_check_done, req);
+
+    return req;
+
+immediately:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void pam_auth_cache_check_done(struct tevent_req *subreq)
+{
+    struct pam_auth_cache_check_state *state;
+    struct response_data *resp;
+    struct tevent_req *req;
+    char *hash;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct pam_auth_cache_check_state);
+
+    ret = s3crypt_sha512_recv(state, subreq, &hash);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "Failed to create password hash.\n");
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    if (state->generation != state->cache->generation) {
+        DEBUG(SSSDBG_TRACE_FUNC, "The authentication cache was invalidated "
+              "meanwhile, not using it for [%s].\n", state->pd->user);
+        tevent_req_error(req, ENOENT);
+        return;
+    }
+
+    if (strcmp(hash, state->hash) != 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Password of [%s] does not match the "
+              "authentication cache.\n", state->pd->user);
+        tevent_req_error(req, ENOENT);
+        return;
+    }
+
+    /* The ccache of the original login is still valid, tell pam_sss
+     * about it again. */
+    for (resp = state->env; resp != NULL; resp = resp->next) {
+        ret = pam_add_response(state->pd, resp->type, resp->len, resp->data);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "pam_add_response failed.\n");
+            tevent_req_error(req, ret);
+            return;
+        }
+    }
+
+    tevent_req_done(req);
+}
+
+errno_t pam_auth_cache_check_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
@@ -725,6 +725,7 @@ static errno_t get_password_for_cache_auth(struct sss_auth_token *authtok,
 static int pam_forwarder(struct cli_ctx *cctx, int pam_cmd);
 static void pam_handle_cached_login(struct pam_auth_req *preq, int ret,
                                     time_t expire_date, time_t delayed_until, bool cached_auth);
+static void pam_cached_login_done(struct tevent_req *req);
 
 /*
  * Add a request to add a variable to the PAM user environment, containing the
@@ -823,8 +824,7 @@ static void pam_reply(struct pam_auth_req *preq)
     struct pam_data *pd;
     struct pam_ctx *pctx;
     uint32_t user_info_type;
-    time_t exp_date = -1;
-    time_t delay_until = -1;
+    struct tevent_req *req;
     char* pam_account_expired_message;
     char* pam_account_locked_message;
     int pam_verbosity;
@@ -903,13 +903,18 @@ static void pam_reply(struct pam_auth_req *preq)
                     goto done;
                 }
 
-                ret = sysdb_cache_auth(preq->domain,
-                                       pd->user, password,
-                                       pctx->rctx->cdb, false,
-                                       &exp_date, &delay_until);
-
-                pam_handle_cached_login(preq, ret, exp_date, delay_until,
-                                        use_cached_auth);
+                /* The password is hashed outside of the event loop, the
+                 * reply is sent from pam_cached_login_done() */
+                req = sysdb_cache_auth_send(preq, cctx->ev, pctx->crypt_pool,
+                                            preq->domain, pd->user, password,
+                                            pctx->rctx->cdb, false);
+                if (req == NULL) {
+                    DEBUG(SSSDBG_CRIT_FAILURE,
+                          "sysdb_cache_auth_send failed.\n");
+                    goto done;
+                }
+                preq->saved_use_cached_auth = use_cached_auth;
+                tevent_req_set_callback(req, pam_cached_login_done, preq);
                 return;
             }
             break;
@@ -983,6 +988,7 @@ static void pam_reply(struct pam_auth_req *preq)
         preq->domain->cache_credentials &&
         !pd->offline_auth &&
         !pd->last_auth_saved &&
+        !preq->auth_cache_hit &&
         NEED_CHECK_PROVIDER(preq->domain->provider)) {
         ret = set_last_login(preq);
         if (ret != EOK) {
@@ -991,6 +997,8 @@ static void pam_reply(struct pam_auth_req *preq)
         return;
     }
 
+    pam_auth_cache_update(pctx->auth_cache, pd, preq->auth_cache_hit);
+
     ret = sss_packet_new(prctx->creq, 0, sss_packet_get_cmd(prctx->creq->in),
                          &prctx->creq->out);
     if (ret != EOK) {
@@ -1190,10 +1198,72 @@ static void pam_handle_cached_login(struct pam_auth_req *preq, int ret,
     return;
 }
 
+static void pam_cached_login_done(struct tevent_req *req)
+{
+    struct pam_auth_req *preq;
+    time_t exp_date = -1;
+    time_t delay_until = -1;
+    errno_t ret;
+
+    preq = tevent_req_callback_data(req, struct pam_auth_req);
+
+    ret = sysdb_cache_auth_recv(req, &exp_date, &delay_until);
+    talloc_free(req);
+
+    pam_handle_cached_login(preq, ret, exp_date, delay_until,
+                            preq->saved_use_cached_auth);
+}
+
 static void pam_forwarder_cb(struct tevent_req *req);
 static void pam_forwarder_cert_cb(struct tevent_req *req);
 static int pam_check_user_search(struct pam_auth_req *preq);
 
+int pam_connection_setup(struct cli_ctx *cctx)
+{
+    int ret;
+
+    ret = sss_connection_setup(cctx);
+    if (ret != EOK) return ret;
+
+    cctx->state_ctx = talloc_zero(cctx, struct pam_state_ctx);
+    if (cctx->state_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static bool pam_conn_initgr_done(struct cli_ctx *cctx, const char *logon_name)
+{
+    struct pam_state_ctx *state_ctx;
+
+    state_ctx = talloc_get_type(cctx->state_ctx, struct pam_state_ctx);
+    if (state_ctx == NULL || state_ctx->initgr_logon_name == NULL
+            || logon_name == NULL) {
+        return false;
+    }
+
+    return strcmp(state_ctx->initgr_logon_name, logon_name) == 0;
+}
+
+static void pam_conn_set_initgr_done(struct cli_ctx *cctx,
+                                     const char *logon_name)
+{
+    struct pam_state_ctx *state_ctx;
+
+    state_ctx = talloc_get_type(cctx->state_ctx, struct pam_state_ctx);
+    if (state_ctx == NULL || logon_name == NULL
+            || pam_conn_initgr_done(cctx, logon_name)) {
+        return;
+    }
+
+    talloc_free(state_ctx->initgr_logon_name);
+    state_ctx->initgr_logon_name = talloc_strdup(state_ctx, logon_name);
+    if (state_ctx->initgr_logon_name == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, "talloc_strdup failed. Not fatal.\n");
+    }
+}
+
 
 /* TODO: we should probably return some sort of cookie that is set in the
  * PAM_ENVIRONMENT, so that we can save performing some calls and cache
@@ -1402,7 +1472,7 @@ static errno_t check_cert(TALLOC_CTX *mctx,
         return ret;
     }
 
-    req = pam_check_cert_send(mctx, ev,
+    req = pam_check_cert_send(mctx, ev, pctx->p11_worker,
                               pctx->ca_db, p11_child_timeout,
                               cert_verification_opts, pctx->sss_certmap_ctx,
                               uri, pd);
@@ -1983,6 +2053,16 @@ static void pam_check_user_search_next(struct tevent_req *req)
             DEBUG(SSSDBG_OP_FAILURE, "Could not look up initgroup timeout\n");
         }
 
+        /* The later stages of a PAM transaction reuse the connection of the
+         * first one, there is no need to refresh the groups again even if
+         * the PAM conversation took longer than pam_id_timeout. */
+        if (ret != EOK && pam_conn_initgr_done(preq->cctx,
+                                               preq->pd->logon_name)) {
+            DEBUG(SSSDBG_TRACE_ALL, "Groups of [%s] were already refreshed "
+                  "on this connection.\n", preq->pd->logon_name);
+            ret = EOK;
+        }
+
         if ((ret == EOK) || user_has_session
                 || pctx->initgroups_scheme == PAM_INITGR_NEVER) {
             DEBUG(SSSDBG_TRACE_ALL, "No new initgroups needed because:\n");
@@ -2074,6 +2154,8 @@ static void pam_check_user_search_done(struct pam_auth_req *preq, int ret,
                   "Proceeding with PAM actions\n");
         }
 
+        pam_conn_set_initgr_done(preq->cctx, preq->pd->logon_name);
+
         pam_dom_forwarder(preq);
     }
 
@@ -2191,11 +2273,39 @@ static bool pam_can_user_cache_auth(struct sss_domain_info *domain,
     return result;
 }
 
+static void pam_auth_cache_check_done(struct tevent_req *req)
+{
+    struct pam_auth_req *preq;
+    errno_t ret;
+
+    preq = tevent_req_callback_data(req, struct pam_auth_req);
+
+    ret = pam_auth_cache_check_recv(req);
+    talloc_free(req);
+    if (ret != EOK) {
+        if (ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE, "Checking the authentication cache "
+                  "failed [%d]: %s. Not fatal.\n", ret, sss_strerror(ret));
+        }
+        pam_dom_forwarder(preq);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          "[%s] authenticated from the authentication cache.\n",
+          preq->pd->user);
+    preq->auth_cache_hit = true;
+    preq->pd->pam_status = PAM_SUCCESS;
+    preq->callback = pam_reply;
+    pam_reply(preq);
+}
+
 static void pam_dom_forwarder(struct pam_auth_req *preq)
 {
     int ret;
     struct pam_ctx *pctx =
             talloc_get_type(preq->cctx->rctx->pvt_ctx, struct pam_ctx);
+    struct tevent_req *req;
     const char *cert_user;
     struct ldb_result *cert_user_objs;
     size_t c;
@@ -2226,6 +2336,23 @@ static void pam_dom_forwarder(struct pam_auth_req *preq)
         return;
     }
 
+    if (pctx->auth_cache != NULL
+            && !preq->auth_cache_checked
+            && preq->pd->cmd == SSS_PAM_AUTHENTICATE
+            && pam_is_authtok_cachable(preq->pd->authtok)) {
+        preq->auth_cache_checked = true;
+
+        req = pam_auth_cache_check_send(preq, preq->cctx->ev,
+                                        pctx->auth_cache, preq->pd);
+        if (req == NULL) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  "pam_auth_cache_check_send failed. Not fatal.\n");
+        } else {
+            tevent_req_set_callback(req, pam_auth_cache_check_done, preq);
+            return;
+        }
+    }
+
     if (pam_can_user_cache_auth(preq->domain,
                                 preq->pd->cmd,
                                 preq->pd->authtok,
@@ -20,6 +20,7 @@
 */
 
 #include <time.h>
+#include <signal.h>
 
 #include "util/util.h"
 #include "providers/data_provider.h"
@@ -31,6 +32,9 @@
 #include "util/crypto/sss_crypto.h"
 #include "db/sysdb.h"
 
+/* Keep in sync with P11_CHILD_WORKER_BUF_SIZE in p11_child.h */
+#define P11_CHILD_WORKER_MAX_REQUEST (16 * 1024)
+
 
 struct cert_auth_info {
     char *cert;
@@ -685,6 +689,607 @@ done:
     return ret;
 }
 
+/* A p11_child running in worker mode, see p11c_worker() in
+ * p11_child_common.c. It is started with the first request and handles one
+ * request at a time, the others wait in the queue. If the CA DB or the
+ * verification options of a request differ from the ones the worker was
+ * started with, it is replaced. */
+struct p11_child_worker {
+    struct tevent_context *ev;
+    char *ca_db;
+    char *verify_opts;
+
+    pid_t pid;
+    struct child_io_fds *io;
+    struct sss_child_ctx_old *child_ctx;
+    size_t num_requests;
+
+    /* The request currently handled by the worker, NULL if idle. */
+    struct tevent_req *req;
+    struct p11_child_worker_run_state *queue;
+    struct tevent_immediate *dispatch_imm;
+};
+
+struct p11_child_worker_run_state {
+    struct p11_child_worker_run_state *prev;
+    struct p11_child_worker_run_state *next;
+
+    struct tevent_context *ev;
+    struct tevent_req *req;
+    struct p11_child_worker *worker;
+    const char *ca_db;
+    const char *verify_opts;
+    uint8_t *buf;
+    size_t len;
+    time_t timeout;
+    bool queued;
+    bool running;
+
+    struct tevent_req *subreq;
+    struct tevent_timer *timeout_handler;
+
+    uint8_t *reply;
+    ssize_t reply_len;
+};
+
+static void p11_child_worker_schedule_dispatch(struct p11_child_worker *worker);
+static void p11_child_worker_run_fail(struct tevent_req *req, errno_t ret);
+
+static void p11_child_worker_stop(struct p11_child_worker *worker)
+{
+    /* The worker would exit once its pipes are closed but it might be
+     * stuck in a request, child_handler_destroy() kills it and still
+     * collects its exit status. */
+    if (worker->child_ctx != NULL) {
+        child_handler_destroy(worker->child_ctx);
+        worker->child_ctx = NULL;
+    }
+
+    if (worker->pid != -1) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Stopping p11_child worker [%d] after %zu "
+              "requests\n", worker->pid, worker->num_requests);
+    }
+
+    talloc_zfree(worker->io);
+    talloc_zfree(worker->ca_db);
+    talloc_zfree(worker->verify_opts);
+    worker->pid = -1;
+    worker->num_requests = 0;
+}
+
+static int p11_child_worker_destructor(struct p11_child_worker *worker)
+{
+    p11_child_worker_stop(worker);
+
+    return 0;
+}
+
+static void p11_child_worker_exited(int child_status,
+                                    struct tevent_signal *sige,
+                                    void *pvt)
+{
+    struct p11_child_worker *worker;
+
+    worker = talloc_get_type(pvt, struct p11_child_worker);
+
+    DEBUG(SSSDBG_MINOR_FAILURE, "p11_child worker [%d] exited with status "
+          "[%d]\n", worker->pid, child_status);
+
+    /* Freed by the caller. */
+    worker->child_ctx = NULL;
+
+    if (worker->req != NULL) {
+        p11_child_worker_run_fail(worker->req, ERR_P11_CHILD);
+        return;
+    }
+
+    p11_child_worker_stop(worker);
+    p11_child_worker_schedule_dispatch(worker);
+}
+
+static errno_t p11_child_worker_spawn(struct p11_child_worker *worker,
+                                      const char *ca_db,
+                                      const char *verify_opts)
+{
+    int pipefd_to_child[2] = PIPE_INIT;
+    int pipefd_from_child[2] = PIPE_INIT;
+    const char *extra_args[6] = { NULL };
+    size_t arg_c = 0;
+    pid_t pid;
+    errno_t ret;
+
+    worker->ca_db = talloc_strdup(worker, ca_db);
+    if (worker->ca_db == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    if (verify_opts != NULL) {
+        worker->verify_opts = talloc_strdup(worker, verify_opts);
+        if (worker->verify_opts == NULL) {
+            ret = ENOMEM;
+            goto fail;
+        }
+    }
+
+    worker->io = talloc(worker, struct child_io_fds);
+    if (worker->io == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    worker->io->write_to_child_fd = -1;
+    worker->io->read_from_child_fd = -1;
+    talloc_set_destructor((void *) worker->io, child_io_destructor);
+
+    /* extra_args are added in revers order */
+    extra_args[arg_c++] = "--worker";
+    extra_args[arg_c++] = worker->ca_db;
+    extra_args[arg_c++] = "--ca_db";
+    if (worker->verify_opts != NULL) {
+        extra_args[arg_c++] = worker->verify_opts;
+        extra_args[arg_c++] = "--verify";
+    }
+
+    ret = pipe(pipefd_from_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+    ret = pipe(pipefd_to_child);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "pipe failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    pid = fork();
+    if (pid == 0) { /* child */
+        exec_child_ex(worker, pipefd_to_child, pipefd_from_child,
+                      P11_CHILD_PATH, P11_CHILD_LOG_FILE, extra_args, false,
+                      STDIN_FILENO, STDOUT_FILENO);
+
+        /* We should never get here */
+        DEBUG(SSSDBG_CRIT_FAILURE, "BUG: Could not exec p11 child\n");
+    } else if (pid < 0) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "fork failed [%d][%s].\n", ret, strerror(ret));
+        goto fail;
+    }
+
+    worker->pid = pid;
+    worker->io->read_from_child_fd = pipefd_from_child[0];
+    PIPE_FD_CLOSE(pipefd_from_child[1]);
+    worker->io->write_to_child_fd = pipefd_to_child[1];
+    PIPE_FD_CLOSE(pipefd_to_child[0]);
+    sss_fd_nonblocking(worker->io->read_from_child_fd);
+    sss_fd_nonblocking(worker->io->write_to_child_fd);
+
+    ret = child_handler_setup(worker->ev, pid, p11_child_worker_exited,
+                              worker, &worker->child_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Could not set up child signal handler\n");
+        kill(pid, SIGKILL);
+        p11_child_worker_stop(worker);
+        return ERR_P11_CHILD;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started p11_child worker [%d]\n", pid);
+
+    return EOK;
+
+fail:
+    PIPE_CLOSE(pipefd_from_child);
+    PIPE_CLOSE(pipefd_to_child);
+    p11_child_worker_stop(worker);
+    return ret;
+}
+
+errno_t p11_child_worker_init(TALLOC_CTX *mem_ctx,
+                              struct tevent_context *ev,
+                              struct p11_child_worker **_worker)
+{
+    struct p11_child_worker *worker;
+
+    worker = talloc_zero(mem_ctx, struct p11_child_worker);
+    if (worker == NULL) {
+        return ENOMEM;
+    }
+
+    worker->ev = ev;
+    worker->pid = -1;
+
+    worker->dispatch_imm = tevent_create_immediate(worker);
+    if (worker->dispatch_imm == NULL) {
+        talloc_free(worker);
+        return ENOMEM;
+    }
+
+    talloc_set_destructor(worker, p11_child_worker_destructor);
+
+    *_worker = worker;
+    return EOK;
+}
+
+pid_t p11_child_worker_get_pid(struct p11_child_worker *worker)
+{
+    return worker->pid;
+}
+
+static errno_t p11_child_worker_run_start(struct tevent_req *req);
+static void p11_child_worker_run_written(struct tevent_req *subreq);
+static void p11_child_worker_run_done(struct tevent_req *subreq);
+
+/* Detaches the request from the worker. A worker which did not finish its
+ * request cleanly is stopped. */
+static void p11_child_worker_release(struct p11_child_worker_run_state *state,
+                                     bool reusable)
+{
+    struct p11_child_worker *worker = state->worker;
+
+    talloc_zfree(state->subreq);
+    talloc_zfree(state->timeout_handler);
+
+    if (!state->running) {
+        return;
+    }
+
+    state->running = false;
+    worker->req = NULL;
+    worker->num_requests++;
+
+    if (!reusable) {
+        p11_child_worker_stop(worker);
+    }
+
+    p11_child_worker_schedule_dispatch(worker);
+}
+
+static int
+p11_child_worker_run_destructor(struct p11_child_worker_run_state *state)
+{
+    if (state->queued) {
+        DLIST_REMOVE(state->worker->queue, state);
+        state->queued = false;
+    }
+
+    /* The reply of an abandoned request must not be read as the reply of
+     * the next one. */
+    p11_child_worker_release(state, false);
+
+    return 0;
+}
+
+static void p11_child_worker_run_fail(struct tevent_req *req, errno_t ret)
+{
+    struct p11_child_worker_run_state *state;
+
+    state = tevent_req_data(req, struct p11_child_worker_run_state);
+
+    p11_child_worker_release(state, false);
+    tevent_req_error(req, ret);
+}
+
+static void p11_child_worker_dispatch(struct tevent_context *ev,
+                                      struct tevent_immediate *imm,
+                                      void *pvt)
+{
+    struct p11_child_worker *worker;
+    struct p11_child_worker_run_state *state;
+    errno_t ret;
+
+    worker = talloc_get_type(pvt, struct p11_child_worker);
+
+    while (worker->req == NULL && worker->queue != NULL) {
+        state = worker->queue;
+        DLIST_REMOVE(worker->queue, state);
+        state->queued = false;
+
+        ret = p11_child_worker_run_start(state->req);
+        if (ret != EOK) {
+            p11_child_worker_run_fail(state->req, ret);
+        }
+    }
+}
+
+static void p11_child_worker_schedule_dispatch(struct p11_child_worker *worker)
+{
+    if (worker->queue == NULL) {
+        return;
+    }
+
+    tevent_schedule_immediate(worker->dispatch_imm, worker->ev,
+                              p11_child_worker_dispatch, worker);
+}
+
+static void p11_child_worker_run_timeout(struct tevent_context *ev,
+                                         struct tevent_timer *te,
+                                         struct timeval tv, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct p11_child_worker_run_state *state;
+
+    state = tevent_req_data(req, struct p11_child_worker_run_state);
+    state->timeout_handler = NULL;
+
+    if (state->queued) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Timeout reached while waiting for the p11_child worker, "
+              "consider increasing p11_child_timeout.\n");
+        DLIST_REMOVE(state->worker->queue, state);
+        state->queued = false;
+    } else {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "Timeout reached for p11_child worker [%d], "
+              "consider increasing p11_child_timeout.\n", state->worker->pid);
+    }
+
+    p11_child_worker_run_fail(req, ERR_P11_CHILD_TIMEOUT);
+}
+
+static struct tevent_req *
+p11_child_worker_run_send(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          struct p11_child_worker *worker,
+                          const char *ca_db,
+                          const char *verify_opts,
+                          uint8_t *buf, size_t len,
+                          time_t timeout)
+{
+    struct p11_child_worker_run_state *state;
+    struct tevent_req *req;
+    struct timeval tv;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct p11_child_worker_run_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    state->ev = ev;
+    state->req = req;
+    state->worker = worker;
+    state->ca_db = ca_db;
+    state->verify_opts = verify_opts;
+    state->buf = buf;
+    state->len = len;
+    state->timeout = timeout;
+    talloc_set_destructor(state, p11_child_worker_run_destructor);
+
+    /* The time spent waiting for the worker counts towards the timeout as
+     * well, the PAM client waits the whole time. */
+    tv = tevent_timeval_current_ofs(state->timeout, 0);
+    state->timeout_handler = tevent_add_timer(state->ev, state, tv,
+                                              p11_child_worker_run_timeout,
+                                              req);
+    if (state->timeout_handler == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_timer failed.\n");
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    if (worker->req != NULL || worker->queue != NULL) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              "p11_child worker is busy, queuing the request\n");
+        DLIST_ADD_END(worker->queue, state,
+                      struct p11_child_worker_run_state *);
+        state->queued = true;
+        return req;
+    }
+
+    ret = p11_child_worker_run_start(req);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    return req;
+
+immediately:
+    p11_child_worker_release(state, false);
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static errno_t p11_child_worker_run_start(struct tevent_req *req)
+{
+    struct p11_child_worker_run_state *state;
+    struct p11_child_worker *worker;
+    errno_t ret;
+
+    state = tevent_req_data(req, struct p11_child_worker_run_state);
+    worker = state->worker;
+
+    if (worker->pid != -1
+            && (strcmp(worker->ca_db, state->ca_db) != 0
+                || (worker->verify_opts == NULL) != (state->verify_opts == NULL)
+                || (worker->verify_opts != NULL
+                    && strcmp(worker->verify_opts, state->verify_opts) != 0))) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Certificate verification settings changed, "
+              "replacing p11_child worker [%d]\n", worker->pid);
+        p11_child_worker_stop(worker);
+    }
+
+    if (worker->pid == -1) {
+        ret = p11_child_worker_spawn(worker, state->ca_db, state->verify_opts);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "Cannot start p11_child worker [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            return ret;
+        }
+    }
+
+    worker->req = req;
+    state->running = true;
+
+    state->subreq = write_pipe_frame_send(state, state->ev,
+                                          state->buf, state->len,
+                                          worker->io->write_to_child_fd);
+    if (state->subreq == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(state->subreq, p11_child_worker_run_written, req);
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, "Request sent to p11_child worker [%d]\n",
+          worker->pid);
+
+    return EOK;
+}
+
+static void p11_child_worker_run_written(struct tevent_req *subreq)
+{
+    struct p11_child_worker_run_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct p11_child_worker_run_state);
+
+    ret = write_pipe_recv(subreq);
+    talloc_zfree(subreq);
+    state->subreq = NULL;
+    if (ret != EOK) {
+        p11_child_worker_run_fail(req, ret);
+        return;
+    }
+
+    state->subreq = read_pipe_frame_send(state, state->ev,
+                                         state->worker->io->read_from_child_fd);
+    if (state->subreq == NULL) {
+        p11_child_worker_run_fail(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(state->subreq, p11_child_worker_run_done, req);
+}
+
+static void p11_child_worker_run_done(struct tevent_req *subreq)
+{
+    struct p11_child_worker_run_state *state;
+    struct tevent_req *req;
+    uint32_t child_ret;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct p11_child_worker_run_state);
+
+    ret = read_pipe_frame_recv(subreq, state, &state->reply,
+                               &state->reply_len);
+    talloc_zfree(subreq);
+    state->subreq = NULL;
+    if (ret != EOK) {
+        p11_child_worker_run_fail(req, ret);
+        return;
+    }
+
+    if (state->reply_len < sizeof(uint32_t)) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Reply of p11_child worker too short.\n");
+        p11_child_worker_run_fail(req, EIO);
+        return;
+    }
+
+    SAFEALIGN_COPY_UINT32(&child_ret, state->reply, NULL);
+    if (child_ret != EOK) {
+        /* Same as a single-shot p11_child which exits without output. */
+        DEBUG(SSSDBG_OP_FAILURE, "p11_child worker request failed [%d]: %s\n",
+              child_ret, sss_strerror(child_ret));
+        state->reply_len = 0;
+    } else {
+        state->reply_len -= sizeof(uint32_t);
+        memmove(state->reply, state->reply + sizeof(uint32_t),
+                state->reply_len);
+    }
+
+    p11_child_worker_release(state, true);
+    tevent_req_done(req);
+}
+
+static errno_t p11_child_worker_run_recv(struct tevent_req *req,
+                                         TALLOC_CTX *mem_ctx,
+                                         uint8_t **_buf,
+                                         ssize_t *_len)
+{
+    struct p11_child_worker_run_state *state;
+
+    state = tevent_req_data(req, struct p11_child_worker_run_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_buf = talloc_steal(mem_ctx, state->reply);
+    *_len = state->reply_len;
+
+    return EOK;
+}
+
+/* The request for a p11_child worker, see p11c_worker(). The options in
+ * extra_args are in reverse order. */
+static errno_t get_p11_child_worker_buffer(TALLOC_CTX *mem_ctx,
+                                           struct pam_data *pd,
+                                           const char **extra_args,
+                                           size_t arg_c,
+                                           uint8_t **_buf, size_t *_len)
+{
+    uint8_t *pin_buf = NULL;
+    size_t pin_len = 0;
+    uint8_t *buf;
+    size_t len;
+    size_t p = 0;
+    size_t c;
+    errno_t ret;
+
+    if (pd->cmd == SSS_PAM_AUTHENTICATE) {
+        ret = get_p11_child_write_buffer(mem_ctx, pd, &pin_buf, &pin_len);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "get_p11_child_write_buffer failed.\n");
+            return ret;
+        }
+    }
+
+    len = pin_len + 1;
+    for (c = 0; c < arg_c; c++) {
+        len += strlen(extra_args[c]) + 1;
+    }
+
+    if (len > P11_CHILD_WORKER_MAX_REQUEST) {
+        DEBUG(SSSDBG_OP_FAILURE, "Request too large for p11_child worker.\n");
+        ret = EMSGSIZE;
+        goto done;
+    }
+
+    buf = talloc_size(mem_ctx, len);
+    if (buf == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    talloc_set_destructor((void *) buf, sss_erase_talloc_mem_securely);
+
+    if (pin_len != 0) {
+        safealign_memcpy(buf, pin_buf, pin_len, &p);
+    }
+    buf[p++] = '\0';
+    for (c = arg_c; c > 0; c--) {
+        safealign_memcpy(&buf[p], extra_args[c - 1],
+                         strlen(extra_args[c - 1]) + 1, &p);
+    }
+
+    *_buf = buf;
+    *_len = len;
+    ret = EOK;
+
+done:
+    if (pin_buf != NULL) {
+        sss_erase_mem_securely(pin_buf, pin_len);
+        talloc_free(pin_buf);
+    }
+
+    return ret;
+}
+
 struct pam_check_cert_state {
     int child_status;
     struct sss_child_ctx_old *child_ctx;
@@ -699,12 +1304,14 @@ struct pam_check_cert_state {
 
 static void p11_child_write_done(struct tevent_req *subreq);
 static void p11_child_done(struct tevent_req *subreq);
+static void p11_child_worker_done(struct tevent_req *subreq);
 static void p11_child_timeout(struct tevent_context *ev,
                               struct tevent_timer *te,
                               struct timeval tv, void *pvt);
 
 struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
                                        struct tevent_context *ev,
+                                       struct p11_child_worker *p11_worker,
                                        const char *ca_db,
                                        time_t timeout,
                                        const char *verify_opts,
@@ -727,6 +1334,7 @@ struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
     const char *module_name = NULL;
     const char *token_name = NULL;
     const char *key_id = NULL;
+    bool wait_for_card = false;
 
     req = tevent_req_create(mem_ctx, &state, struct pam_check_cert_state);
     if (req == NULL) {
@@ -755,12 +1363,7 @@ struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
 
     if ((pd->cli_flags & PAM_CLI_FLAGS_REQUIRE_CERT_AUTH) && pd->priv == 1) {
         extra_args[arg_c++] = "--wait_for_card";
-    }
-    extra_args[arg_c++] = ca_db;
-    extra_args[arg_c++] = "--ca_db";
-    if (verify_opts != NULL) {
-        extra_args[arg_c++] = verify_opts;
-        extra_args[arg_c++] = "--verify";
+        wait_for_card = true;
     }
 
     if (sss_authtok_get_type(pd->authtok) == SSS_AUTHTOK_TYPE_SC_PIN
@@ -812,6 +1415,37 @@ struct tevent_req *pam_check_cert_send(TALLOC_CTX *mem_ctx,
     state->ev = ev;
     state->sss_certmap_ctx = sss_certmap_ctx;
     state->child_status = EFAULT;
+
+    /* Waiting for a card would block the worker for all other requests. */
+    if (p11_worker != NULL && !wait_for_card) {
+        ret = get_p11_child_worker_buffer(state, pd, extra_args, arg_c,
+                                          &write_buf, &write_buf_len);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, "get_p11_child_worker_buffer failed.\n");
+            goto done;
+        }
+
+        subreq = p11_child_worker_run_send(state, ev, p11_worker, ca_db,
+                                           verify_opts, write_buf,
+                                           write_buf_len, timeout);
+        if (subreq == NULL) {
+            DEBUG(SSSDBG_OP_FAILURE, "p11_child_worker_run_send failed.\n");
+            ret = ENOMEM;
+            goto done;
+        }
+        tevent_req_set_callback(subreq, p11_child_worker_done, req);
+
+        ret = EOK;
+        goto done;
+    }
+
+    extra_args[arg_c++] = ca_db;
+    extra_args[arg_c++] = "--ca_db";
+    if (verify_opts != NULL) {
+        extra_args[arg_c++] = verify_opts;
+        extra_args[arg_c++] = "--verify";
+    }
+
     state->io = talloc(state, struct child_io_fds);
     if (state->io == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE, "talloc failed.\n");
@@ -982,6 +1616,34 @@ static void p11_child_done(struct tevent_req *subreq)
     return;
 }
 
+static void p11_child_worker_done(struct tevent_req *subreq)
+{
+    uint8_t *buf;
+    ssize_t buf_len;
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct pam_check_cert_state *state = tevent_req_data(req,
+                                                   struct pam_check_cert_state);
+    int ret;
+
+    ret = p11_child_worker_run_recv(subreq, state, &buf, &buf_len);
+    talloc_zfree(subreq);
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    ret = parse_p11_child_response(state, buf, buf_len, state->sss_certmap_ctx,
+                                   &state->cert_list);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, "parse_p11_child_response failed.\n");
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
 static void p11_child_timeout(struct tevent_context *ev,
                               struct tevent_timer *te,
                               struct timeval tv, void *pvt)
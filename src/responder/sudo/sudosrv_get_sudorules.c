@@ -390,16 +390,475 @@ static errno_t sudosrv_cached_rules_by_ng(TALLOC_CTX *mem_ctx,
     return ret;
 }
 
-static errno_t sudosrv_cached_rules(TALLOC_CTX *mem_ctx,
-                                    struct resp_ctx *rctx,
-                                    struct sss_domain_info *domain,
-                                    uid_t cli_uid,
-                                    uid_t orig_uid,
-                                    const char *username,
-                                    char **groups,
-                                    bool inverse_order,
-                                    struct sysdb_attrs ***_rules,
-                                    uint32_t *_num_rules)
+/* Rules containing one sudoUser value, as indexes into the sorted rules */
+struct sudosrv_rule_list {
+    uint32_t *idx;
+    uint32_t count;
+};
+
+/* In-memory copy of the rules of one domain. It is built from the cache
+ * once and used until the back end stores or removes rules, which changes
+ * the revision of the sudo subtree. */
+struct sudosrv_rule_index {
+    struct sudosrv_rule_index *prev;
+    struct sudosrv_rule_index *next;
+
+    const char *domain;
+    uint64_t revision;
+    bool inverse_order;
+
+    /* sorted by sudoOrder */
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+
+    /* sudoUser value -> struct sudosrv_rule_list */
+    hash_table_t *by_user;
+    /* rules with at least one +netgroup sudoUser */
+    struct sudosrv_rule_list netgroups;
+};
+
+static errno_t sudosrv_rule_list_add(TALLOC_CTX *mem_ctx,
+                                     struct sudosrv_rule_list *list,
+                                     uint32_t idx)
+{
+    /* The rules are indexed in order, a rule that contains the same value
+     * twice would be the last one. */
+    if (list->count > 0 && list->idx[list->count - 1] == idx) {
+        return EOK;
+    }
+
+    list->idx = talloc_realloc(mem_ctx, list->idx, uint32_t, list->count + 1);
+    if (list->idx == NULL) {
+        return ENOMEM;
+    }
+
+    list->idx[list->count] = idx;
+    list->count++;
+
+    return EOK;
+}
+
+static errno_t sudosrv_rule_index_add_value(struct sudosrv_rule_index *index,
+                                            const char *value,
+                                            uint32_t idx)
+{
+    struct sudosrv_rule_list *list;
+    hash_key_t key;
+    hash_value_t hvalue;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(value);
+
+    hret = hash_lookup(index->by_user, &key, &hvalue);
+    if (hret == HASH_SUCCESS) {
+        list = talloc_get_type(hvalue.ptr, struct sudosrv_rule_list);
+    } else if (hret == HASH_ERROR_KEY_NOT_FOUND) {
+        list = talloc_zero(index->by_user, struct sudosrv_rule_list);
+        if (list == NULL) {
+            return ENOMEM;
+        }
+
+        hvalue.type = HASH_VALUE_PTR;
+        hvalue.ptr = list;
+
+        hret = hash_enter(index->by_user, &key, &hvalue);
+        if (hret != HASH_SUCCESS) {
+            DEBUG(SSSDBG_OP_FAILURE, "Unable to index sudoUser [%s]: %s\n",
+                  value, hash_error_string(hret));
+            talloc_free(list);
+            return EIO;
+        }
+    } else {
+        DEBUG(SSSDBG_OP_FAILURE, "Unable to look up sudoUser [%s]: %s\n",
+              value, hash_error_string(hret));
+        return EIO;
+    }
+
+    return sudosrv_rule_list_add(list, list, idx);
+}
+
+static errno_t sudosrv_rule_index_build(TALLOC_CTX *mem_ctx,
+                                        struct sss_domain_info *domain,
+                                        uint64_t revision,
+                                        bool inverse_order,
+                                        struct sudosrv_rule_index **_index)
+{
+    struct sudosrv_rule_index *index;
+    struct ldb_message_element *el;
+    const char *value;
+    char *filter;
+    uint32_t i;
+    unsigned int j;
+    errno_t ret;
+    const char *attrs[] = { SYSDB_OBJECTCLASS,
+                            SYSDB_SUDO_CACHE_AT_CN,
+                            SYSDB_SUDO_CACHE_AT_USER,
+                            SYSDB_SUDO_CACHE_AT_HOST,
+                            SYSDB_SUDO_CACHE_AT_COMMAND,
+                            SYSDB_SUDO_CACHE_AT_OPTION,
+                            SYSDB_SUDO_CACHE_AT_RUNAS,
+                            SYSDB_SUDO_CACHE_AT_RUNASUSER,
+                            SYSDB_SUDO_CACHE_AT_RUNASGROUP,
+                            SYSDB_SUDO_CACHE_AT_NOTBEFORE,
+                            SYSDB_SUDO_CACHE_AT_NOTAFTER,
+                            SYSDB_SUDO_CACHE_AT_ORDER,
+                            NULL };
+
+    index = talloc_zero(mem_ctx, struct sudosrv_rule_index);
+    if (index == NULL) {
+        return ENOMEM;
+    }
+
+    index->revision = revision;
+    index->inverse_order = inverse_order;
+    index->domain = talloc_strdup(index, domain->name);
+    if (index->domain == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_hash_create(index, 0, &index->by_user);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    filter = talloc_asprintf(index, "(&(%s=%s)(%s=*))",
+                             SYSDB_OBJECTCLASS, SYSDB_SUDO_CACHE_OC,
+                             SYSDB_SUDO_CACHE_AT_USER);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sudosrv_query_cache(index, domain, attrs, filter,
+                              &index->rules, &index->num_rules);
+    talloc_free(filter);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sort_sudo_rules(index->rules, index->num_rules, inverse_order);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < index->num_rules; i++) {
+        ret = sysdb_attrs_get_el_ext(index->rules[i],
+                                     SYSDB_SUDO_CACHE_AT_USER, false, &el);
+        if (ret == ENOENT) {
+            continue;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        for (j = 0; j < el->num_values; j++) {
+            value = (const char *)el->values[j].data;
+            if (value == NULL) {
+                continue;
+            }
+
+            if (value[0] == '+') {
+                ret = sudosrv_rule_list_add(index, &index->netgroups, i);
+            } else {
+                ret = sudosrv_rule_index_add_value(index, value, i);
+            }
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Indexed %u sudo rules of [%s]\n",
+          index->num_rules, domain->name);
+
+    *_index = index;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(index);
+    }
+
+    return ret;
+}
+
+/* Returns the index of the domain, rebuilding it if the rules changed. */
+static errno_t sudosrv_rule_index_get(struct sudo_ctx *sudo_ctx,
+                                      struct sss_domain_info *domain,
+                                      bool inverse_order,
+                                      struct sudosrv_rule_index **_index)
+{
+    struct sudosrv_rule_index *index;
+    struct sudosrv_rule_index *new_index;
+    uint64_t revision;
+    errno_t ret;
+
+    if (IS_SUBDOMAIN(domain)) {
+        /* rules are stored inside parent domain tree */
+        domain = domain->parent;
+    }
+
+    ret = sysdb_sudo_get_revision(domain, &revision);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    DLIST_FOR_EACH(index, sudo_ctx->indexes) {
+        if (strcmp(index->domain, domain->name) == 0) {
+            break;
+        }
+    }
+
+    if (index != NULL && index->revision == revision
+            && index->inverse_order == inverse_order) {
+        *_index = index;
+        return EOK;
+    }
+
+    ret = sudosrv_rule_index_build(sudo_ctx, domain, revision, inverse_order,
+                                   &new_index);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    if (index != NULL) {
+        DLIST_REMOVE(sudo_ctx->indexes, index);
+        talloc_free(index);
+    }
+    DLIST_ADD(sudo_ctx->indexes, new_index);
+
+    *_index = new_index;
+    return EOK;
+}
+
+static int sudosrv_idx_cmp(const void *a, const void *b)
+{
+    uint32_t i1 = *(const uint32_t *)a;
+    uint32_t i2 = *(const uint32_t *)b;
+
+    return i1 < i2 ? -1 : (i1 > i2 ? 1 : 0);
+}
+
+static struct sudosrv_rule_list *
+sudosrv_rule_index_find(struct sudosrv_rule_index *index,
+                        const char *value)
+{
+    hash_key_t key;
+    hash_value_t hvalue;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(value);
+
+    hret = hash_lookup(index->by_user, &key, &hvalue);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return talloc_get_type(hvalue.ptr, struct sudosrv_rule_list);
+}
+
+static struct sysdb_attrs *
+sudosrv_rule_index_copy(TALLOC_CTX *mem_ctx,
+                        struct sysdb_attrs *rule,
+                        const char *uid_value)
+{
+    struct sysdb_attrs *copy;
+    size_t i;
+    errno_t ret;
+
+    copy = sysdb_new_attrs(mem_ctx);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < rule->num; i++) {
+        /* Rules matched by user have only sudoUser: #uid, see
+         * sudosrv_cached_rules_by_user() */
+        if (uid_value != NULL
+                && strcmp(rule->a[i].name, SYSDB_SUDO_CACHE_AT_USER) == 0) {
+            continue;
+        }
+
+        ret = sysdb_attrs_copy_values(rule, copy, rule->a[i].name);
+        if (ret != EOK) {
+            talloc_free(copy);
+            return NULL;
+        }
+    }
+
+    if (uid_value != NULL) {
+        ret = sysdb_attrs_add_string(copy, SYSDB_SUDO_CACHE_AT_USER,
+                                     uid_value);
+        if (ret != EOK) {
+            talloc_free(copy);
+            return NULL;
+        }
+    }
+
+    return copy;
+}
+
+/* Same result as sudosrv_cached_rules_by_user() and
+ * sudosrv_cached_rules_by_ng() together, already sorted. */
+static errno_t sudosrv_rule_index_lookup(TALLOC_CTX *mem_ctx,
+                                         struct sudosrv_rule_index *index,
+                                         uid_t cli_uid,
+                                         uid_t orig_uid,
+                                         const char *username,
+                                         char **groupnames,
+                                         struct sysdb_attrs ***_rules,
+                                         uint32_t *_num_rules)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs **rules;
+    struct sudosrv_rule_list **lists;
+    uint32_t num_lists;
+    uint32_t l;
+    uint32_t *user_idx;
+    uint32_t num_user_idx = 0;
+    uint32_t num_rules = 0;
+    uint32_t u, n, i;
+    const char *value;
+    const char *uid_value;
+    bool by_user;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    /* ALL, name, #uid and %group for each group */
+    num_lists = 3;
+    for (i = 0; groupnames != NULL && groupnames[i] != NULL; i++) {
+        num_lists++;
+    }
+
+    lists = talloc_zero_array(tmp_ctx, struct sudosrv_rule_list *, num_lists);
+    if (lists == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    l = 0;
+    lists[l++] = sudosrv_rule_index_find(index, "ALL");
+    lists[l++] = sudosrv_rule_index_find(index, username);
+
+    if (orig_uid != 0) {
+        value = talloc_asprintf(tmp_ctx, "#%"SPRIuid, orig_uid);
+        if (value == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        lists[l++] = sudosrv_rule_index_find(index, value);
+    }
+
+    for (i = 0; groupnames != NULL && groupnames[i] != NULL; i++) {
+        value = talloc_asprintf(tmp_ctx, "%%%s", groupnames[i]);
+        if (value == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        lists[l++] = sudosrv_rule_index_find(index, value);
+    }
+
+    for (i = 0; i < l; i++) {
+        if (lists[i] != NULL) {
+            num_user_idx += lists[i]->count;
+        }
+    }
+
+    user_idx = talloc_array(tmp_ctx, uint32_t, num_user_idx + 1);
+    if (user_idx == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    num_user_idx = 0;
+    for (i = 0; i < l; i++) {
+        if (lists[i] == NULL) {
+            continue;
+        }
+
+        memcpy(user_idx + num_user_idx, lists[i]->idx,
+               lists[i]->count * sizeof(uint32_t));
+        num_user_idx += lists[i]->count;
+    }
+
+    qsort(user_idx, num_user_idx, sizeof(uint32_t), sudosrv_idx_cmp);
+
+    uid_value = talloc_asprintf(tmp_ctx, "#%"SPRIuid, cli_uid);
+    if (uid_value == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    rules = talloc_zero_array(tmp_ctx, struct sysdb_attrs *,
+                              num_user_idx + index->netgroups.count + 1);
+    if (rules == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* Merge the rules matching the user with the netgroup rules. */
+    u = 0;
+    n = 0;
+    while (u < num_user_idx || n < index->netgroups.count) {
+        if (n >= index->netgroups.count
+                || (u < num_user_idx
+                    && user_idx[u] <= index->netgroups.idx[n])) {
+            i = user_idx[u];
+            by_user = true;
+        } else {
+            i = index->netgroups.idx[n];
+            by_user = false;
+        }
+
+        while (u < num_user_idx && user_idx[u] == i) {
+            u++;
+        }
+        while (n < index->netgroups.count && index->netgroups.idx[n] == i) {
+            n++;
+        }
+
+        rules[num_rules] = sudosrv_rule_index_copy(rules, index->rules[i],
+                                                   by_user ? uid_value : NULL);
+        if (rules[num_rules] == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+        num_rules++;
+    }
+
+    if (num_rules == 0) {
+        *_rules = NULL;
+        *_num_rules = 0;
+        ret = EOK;
+        goto done;
+    }
+
+    *_rules = talloc_steal(mem_ctx, rules);
+    *_num_rules = num_rules;
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t sudosrv_search_rules(TALLOC_CTX *mem_ctx,
+                                   struct sss_domain_info *domain,
+                                   uid_t cli_uid,
+                                   uid_t orig_uid,
+                                   const char *username,
+                                   char **groups,
+                                   bool inverse_order,
+                                   struct sysdb_attrs ***_rules,
+                                   uint32_t *_num_rules)
 {
     TALLOC_CTX *tmp_ctx;
     struct sysdb_attrs **user_rules;
@@ -459,6 +918,68 @@ static errno_t sudosrv_cached_rules(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    *_rules = talloc_steal(mem_ctx, rules);
+    *_num_rules = num_rules;
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t sudosrv_cached_rules(TALLOC_CTX *mem_ctx,
+                                    struct resp_ctx *rctx,
+                                    struct sss_domain_info *domain,
+                                    uid_t cli_uid,
+                                    uid_t orig_uid,
+                                    const char *username,
+                                    char **groups,
+                                    bool inverse_order,
+                                    struct sysdb_attrs ***_rules,
+                                    uint32_t *_num_rules)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sudo_ctx *sudo_ctx;
+    struct sudosrv_rule_index *index;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    sudo_ctx = talloc_get_type(rctx->pvt_ctx, struct sudo_ctx);
+
+    ret = sudosrv_rule_index_get(sudo_ctx, domain, inverse_order, &index);
+    if (ret == EOK) {
+        ret = sudosrv_rule_index_lookup(tmp_ctx, index, cli_uid, orig_uid,
+                                        username, groups,
+                                        &rules, &num_rules);
+    }
+
+    if (ret != EOK) {
+        /* Not fatal, search the cache directly. */
+        DEBUG(SSSDBG_MINOR_FAILURE, "Unable to use the sudo rule index "
+              "[%d]: %s\n", ret, sss_strerror(ret));
+
+        ret = sudosrv_search_rules(tmp_ctx, domain, cli_uid, orig_uid,
+                                   username, groups, inverse_order,
+                                   &rules, &num_rules);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    if (num_rules == 0) {
+        *_rules = NULL;
+        *_num_rules = 0;
+        ret = EOK;
+        goto done;
+    }
+
     ret = sudosrv_format_rules(rctx, rules, num_rules);
     if (ret != EOK) {
         DEBUG(SSSDBG_OP_FAILURE, "Could not format sudo rules\n");
@@ -40,6 +40,8 @@ enum sss_sudo_type {
     SSS_SUDO_USER
 };
 
+struct sudosrv_rule_index;
+
 struct sudo_ctx {
     struct resp_ctx *rctx;
 
@@ -49,6 +51,9 @@ struct sudo_ctx {
     bool timed;
     bool inverse_order;
     int threshold;
+
+    /* rules of each domain indexed by sudoUser */
+    struct sudosrv_rule_index *indexes;
 };
 
 struct sudo_cmd_ctx {
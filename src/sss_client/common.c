@@ -64,18 +64,51 @@
 
 /* common functions */
 
-static int sss_cli_sd = -1; /* the sss client socket descriptor */
-static struct stat sss_cli_sb; /* the sss client stat buffer */
+/* the connection used by all requests which do not bring their own */
+static struct sss_cli_conn sss_cli_global_conn = { .sd = -1 };
+
+static void sss_cli_conn_close(struct sss_cli_conn *conn)
+{
+    if (conn->sd != -1) {
+        close(conn->sd);
+        conn->sd = -1;
+    }
+    conn->cred_checked = false;
+}
+
+/* A connection inherited from the parent process must not be shared with
+ * it. The descriptor is only closed if it still refers to our socket, the
+ * application might have closed and reused it meanwhile. */
+static void sss_cli_conn_check_pid(struct sss_cli_conn *conn)
+{
+    struct stat mysb;
+    int ret;
+
+    if (getpid() == conn->pid) {
+        return;
+    }
+
+    if (conn->sd != -1) {
+        ret = fstat(conn->sd, &mysb);
+        if (ret == 0) {
+            if (S_ISSOCK(mysb.st_mode) &&
+                mysb.st_dev == conn->sb.st_dev &&
+                mysb.st_ino == conn->sb.st_ino) {
+                close(conn->sd);
+            }
+        }
+    }
+    conn->sd = -1;
+    conn->cred_checked = false;
+    conn->pid = getpid();
+}
 
 #if HAVE_FUNCTION_ATTRIBUTE_DESTRUCTOR
 __attribute__((destructor))
 #endif
 static void sss_cli_close_socket(void)
 {
-    if (sss_cli_sd != -1) {
-        close(sss_cli_sd);
-        sss_cli_sd = -1;
-    }
+    sss_cli_conn_close(&sss_cli_global_conn);
 }
 
 /* Requests:
@@ -86,7 +119,8 @@ static void sss_cli_close_socket(void)
  * byte 12-15: 32bit unsigned (reserved)
  * byte 16-X: (optional) request structure associated to the command code used
  */
-static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
+static enum sss_status sss_cli_send_req(struct sss_cli_conn *conn,
+                                        enum sss_cli_command cmd,
                                         struct sss_cli_req_data *rd,
                                         int timeout,
                                         int *errnop)
@@ -107,7 +141,7 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
         int res, error;
 
         *errnop = 0;
-        pfd.fd = sss_cli_sd;
+        pfd.fd = conn->sd;
         pfd.events = POLLOUT;
 
         do {
@@ -141,19 +175,19 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
             break;
         }
         if (*errnop) {
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             return SSS_STATUS_UNAVAIL;
         }
 
         errno = 0;
         if (datasent < SSS_NSS_HEADER_SIZE) {
-            res = send(sss_cli_sd,
+            res = send(conn->sd,
                        (char *)header + datasent,
                        SSS_NSS_HEADER_SIZE - datasent,
                        SSS_DEFAULT_WRITE_FLAGS);
         } else {
             rdsent = datasent - SSS_NSS_HEADER_SIZE;
-            res = send(sss_cli_sd,
+            res = send(conn->sd,
                        (const char *)rd->data + rdsent,
                        rd->len - rdsent,
                        SSS_DEFAULT_WRITE_FLAGS);
@@ -169,7 +203,7 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
             }
 
             /* Write failed */
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             *errnop = error;
             return SSS_STATUS_UNAVAIL;
         }
@@ -189,7 +223,8 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
  * byte 16-X: (optional) reply structure associated to the command code used
  */
 
-static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
+static enum sss_status sss_cli_recv_rep(struct sss_cli_conn *conn,
+                                        enum sss_cli_command cmd,
                                         int timeout,
                                         uint8_t **_buf, int *_len,
                                         int *errnop)
@@ -216,7 +251,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
         int bufrecv;
         int res, error;
 
-        pfd.fd = sss_cli_sd;
+        pfd.fd = conn->sd;
         pfd.events = POLLIN;
 
         do {
@@ -253,19 +288,19 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
             break;
         }
         if (*errnop) {
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             ret = SSS_STATUS_UNAVAIL;
             goto failed;
         }
 
         errno = 0;
         if (datarecv < SSS_NSS_HEADER_SIZE) {
-            res = read(sss_cli_sd,
+            res = read(conn->sd,
                        (char *)header + datarecv,
                        SSS_NSS_HEADER_SIZE - datarecv);
         } else {
             bufrecv = datarecv - SSS_NSS_HEADER_SIZE;
-            res = read(sss_cli_sd,
+            res = read(conn->sd,
                        (char *) buf + bufrecv,
                        header[0] - datarecv);
         }
@@ -284,7 +319,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
              * since the transaction has failed half way
              * through. */
 
-            sss_cli_close_socket();
+            sss_cli_conn_close(conn);
             *errnop = error;
             ret = SSS_STATUS_UNAVAIL;
             goto failed;
@@ -298,7 +333,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
              * been read, do checks and proceed */
             if (header[2] != 0) {
                 /* server side error */
-                sss_cli_close_socket();
+                sss_cli_conn_close(conn);
                 *errnop = header[2];
                 if (*errnop == EAGAIN) {
                     ret = SSS_STATUS_TRYAGAIN;
@@ -310,7 +345,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
             }
             if (header[1] != cmd) {
                 /* wrong command id */
-                sss_cli_close_socket();
+                sss_cli_conn_close(conn);
                 *errnop = EBADMSG;
                 ret = SSS_STATUS_UNAVAIL;
                 goto failed;
@@ -319,7 +354,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
                 len = header[0] - SSS_NSS_HEADER_SIZE;
                 buf = malloc(len);
                 if (!buf) {
-                    sss_cli_close_socket();
+                    sss_cli_conn_close(conn);
                     *errnop = ENOMEM;
                     ret = SSS_STATUS_UNAVAIL;
                     goto failed;
@@ -329,7 +364,7 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
     }
 
     if (pollhup) {
-        sss_cli_close_socket();
+        sss_cli_conn_close(conn);
     }
 
     *_len = len;
@@ -345,6 +380,7 @@ failed:
 /* this function will check command codes match and returned length is ok */
 /* repbuf and replen report only the data section not the header */
 static enum sss_status sss_cli_make_request_nochecks(
+                                       struct sss_cli_conn *conn,
                                        enum sss_cli_command cmd,
                                        struct sss_cli_req_data *rd,
                                        int timeout,
@@ -356,13 +392,13 @@ static enum sss_status sss_cli_make_request_nochecks(
     int len = 0;
 
     /* send data */
-    ret = sss_cli_send_req(cmd, rd, timeout, errnop);
+    ret = sss_cli_send_req(conn, cmd, rd, timeout, errnop);
     if (ret != SSS_STATUS_SUCCESS) {
         return ret;
     }
 
     /* data sent, now get reply */
-    ret = sss_cli_recv_rep(cmd, timeout, &buf, &len, errnop);
+    ret = sss_cli_recv_rep(conn, cmd, timeout, &buf, &len, errnop);
     if (ret != SSS_STATUS_SUCCESS) {
         return ret;
     }
@@ -388,7 +424,8 @@ static enum sss_status sss_cli_make_request_nochecks(
  * 0-3: 32bit unsigned version number
  */
 
-static bool sss_cli_check_version(const char *socket_name, int timeout)
+static bool sss_cli_check_version(struct sss_cli_conn *conn,
+                                  const char *socket_name, int timeout)
 {
     uint8_t *repbuf = NULL;
     size_t replen;
@@ -418,7 +455,7 @@ static bool sss_cli_check_version(const char *socket_name, int timeout)
     req.len = sizeof(expected_version);
     req.data = &expected_version;
 
-    nret = sss_cli_make_request_nochecks(SSS_GET_VERSION, &req, timeout,
+    nret = sss_cli_make_request_nochecks(conn, SSS_GET_VERSION, &req, timeout,
                                          &repbuf, &replen, &errnop);
     if (nret != SSS_STATUS_SUCCESS) {
         return false;
@@ -529,7 +566,8 @@ static int make_safe_fd(int fd)
     return new_fd;
 }
 
-static int sss_cli_open_socket(int *errnop, const char *socket_name, int timeout)
+static int sss_cli_open_socket(struct sss_cli_conn *conn, int *errnop,
+                               const char *socket_name, int timeout)
 {
     struct sockaddr_un nssaddr;
     bool inprogress = true;
@@ -624,7 +662,7 @@ static int sss_cli_open_socket(int *errnop, const char *socket_name, int timeout
         return -1;
     }
 
-    ret = fstat(sd, &sss_cli_sb);
+    ret = fstat(sd, &conn->sb);
     if (ret != 0) {
         close(sd);
         return -1;
@@ -633,35 +671,22 @@ static int sss_cli_open_socket(int *errnop, const char *socket_name, int timeout
     return sd;
 }
 
-static enum sss_status sss_cli_check_socket(int *errnop,
-                                            const char *socket_name,
-                                            int timeout)
+static enum sss_status sss_cli_conn_check_socket(struct sss_cli_conn *conn,
+                                                 int *errnop,
+                                                 const char *socket_name,
+                                                 int timeout)
 {
-    static pid_t mypid;
-    struct stat mysb;
     int mysd;
-    int ret;
 
-    if (getpid() != mypid) {
-        ret = fstat(sss_cli_sd, &mysb);
-        if (ret == 0) {
-            if (S_ISSOCK(mysb.st_mode) &&
-                mysb.st_dev == sss_cli_sb.st_dev &&
-                mysb.st_ino == sss_cli_sb.st_ino) {
-                sss_cli_close_socket();
-            }
-        }
-        sss_cli_sd = -1;
-        mypid = getpid();
-    }
+    sss_cli_conn_check_pid(conn);
 
     /* check if the socket has been closed on the other side */
-    if (sss_cli_sd != -1) {
+    if (conn->sd != -1) {
         struct pollfd pfd;
         int res, error;
 
         *errnop = 0;
-        pfd.fd = sss_cli_sd;
+        pfd.fd = conn->sd;
         pfd.events = POLLIN | POLLOUT;
 
         do {
@@ -698,25 +723,33 @@ static enum sss_status sss_cli_check_socket(int *errnop,
             return SSS_STATUS_SUCCESS;
         }
 
-        sss_cli_close_socket();
+        sss_cli_conn_close(conn);
     }
 
-    mysd = sss_cli_open_socket(errnop, socket_name, timeout);
+    mysd = sss_cli_open_socket(conn, errnop, socket_name, timeout);
     if (mysd == -1) {
         return SSS_STATUS_UNAVAIL;
     }
 
-    sss_cli_sd = mysd;
+    conn->sd = mysd;
 
-    if (sss_cli_check_version(socket_name, timeout)) {
+    if (sss_cli_check_version(conn, socket_name, timeout)) {
         return SSS_STATUS_SUCCESS;
     }
 
-    sss_cli_close_socket();
+    sss_cli_conn_close(conn);
     *errnop = EFAULT;
     return SSS_STATUS_UNAVAIL;
 }
 
+static enum sss_status sss_cli_check_socket(int *errnop,
+                                            const char *socket_name,
+                                            int timeout)
+{
+    return sss_cli_conn_check_socket(&sss_cli_global_conn, errnop,
+                                     socket_name, timeout);
+}
+
 /* this function will check command codes match and returned length is ok */
 /* repbuf and replen report only the data section not the header */
 enum nss_status sss_nss_make_request_timeout(enum sss_cli_command cmd,
@@ -745,8 +778,8 @@ enum nss_status sss_nss_make_request_timeout(enum sss_cli_command cmd,
 #endif
     }
 
-    ret = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                        errnop);
+    ret = sss_cli_make_request_nochecks(&sss_cli_global_conn, cmd, rd,
+                                        timeout, repbuf, replen, errnop);
     if (ret == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
         ret = sss_cli_check_socket(errnop, SSS_NSS_SOCKET_NAME, timeout);
@@ -761,8 +794,8 @@ enum nss_status sss_nss_make_request_timeout(enum sss_cli_command cmd,
         }
 
         /* and make request one more time */
-        ret = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                            errnop);
+        ret = sss_cli_make_request_nochecks(&sss_cli_global_conn, cmd, rd,
+                                            timeout, repbuf, replen, errnop);
     }
     switch (ret) {
     case SSS_STATUS_TRYAGAIN:
@@ -824,8 +857,8 @@ int sss_pac_make_request(enum sss_cli_command cmd,
         return NSS_STATUS_UNAVAIL;
     }
 
-    ret = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                        errnop);
+    ret = sss_cli_make_request_nochecks(&sss_cli_global_conn, cmd, rd,
+                                        timeout, repbuf, replen, errnop);
     if (ret == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
         ret = sss_cli_check_socket(errnop, SSS_PAC_SOCKET_NAME, timeout);
@@ -834,8 +867,8 @@ int sss_pac_make_request(enum sss_cli_command cmd,
         }
 
         /* and make request one more time */
-        ret = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                            errnop);
+        ret = sss_cli_make_request_nochecks(&sss_cli_global_conn, cmd, rd,
+                                            timeout, repbuf, replen, errnop);
     }
     switch (ret) {
     case SSS_STATUS_TRYAGAIN:
@@ -888,21 +921,47 @@ errno_t check_server_cred(int sockfd)
     return 0;
 }
 
-int sss_pam_make_request(enum sss_cli_command cmd,
-                      struct sss_cli_req_data *rd,
-                      uint8_t **repbuf, size_t *replen,
-                      int *errnop)
+/* The credentials of the server are only checked when the connection is
+ * (re-)opened, all stages of a PAM transaction can then reuse it. */
+static enum sss_status sss_pam_conn_check_socket(struct sss_cli_conn *conn,
+                                                 int *errnop,
+                                                 const char *socket_name,
+                                                 int timeout)
 {
-    int ret, statret;
+    enum sss_status status;
     errno_t error;
+
+    status = sss_cli_conn_check_socket(conn, errnop, socket_name, timeout);
+    if (status != SSS_STATUS_SUCCESS) {
+        return status;
+    }
+
+    if (!conn->cred_checked) {
+        error = check_server_cred(conn->sd);
+        if (error != 0) {
+            sss_cli_conn_close(conn);
+            *errnop = error;
+            return SSS_STATUS_UNAVAIL;
+        }
+        conn->cred_checked = true;
+    }
+
+    return SSS_STATUS_SUCCESS;
+}
+
+static int sss_pam_conn_make_request(struct sss_cli_conn *conn,
+                                     enum sss_cli_command cmd,
+                                     struct sss_cli_req_data *rd,
+                                     uint8_t **repbuf, size_t *replen,
+                                     int *errnop)
+{
+    int ret, statret;
     enum sss_status status;
     char *envval;
     struct stat stat_buf;
     const char *socket_name;
     int timeout = SSS_CLI_SOCKET_TIMEOUT;
 
-    sss_pam_lock();
-
     /* avoid looping in the pam daemon */
     envval = getenv("_SSS_LOOPS");
     if (envval && strcmp(envval, "NO") == 0) {
@@ -955,33 +1014,26 @@ int sss_pam_make_request(enum sss_cli_command cmd,
         }
     }
 
-    status = sss_cli_check_socket(errnop, socket_name, timeout);
+    status = sss_pam_conn_check_socket(conn, errnop, socket_name, timeout);
     if (status != SSS_STATUS_SUCCESS) {
         ret = PAM_SERVICE_ERR;
         goto out;
     }
 
-    error = check_server_cred(sss_cli_sd);
-    if (error != 0) {
-        sss_cli_close_socket();
-        *errnop = error;
-        ret = PAM_SERVICE_ERR;
-        goto out;
-    }
-
-    status = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                           errnop);
+    status = sss_cli_make_request_nochecks(conn, cmd, rd, timeout,
+                                           repbuf, replen, errnop);
     if (status == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
-        status = sss_cli_check_socket(errnop, socket_name, timeout);
+        status = sss_pam_conn_check_socket(conn, errnop, socket_name,
+                                           timeout);
         if (status != SSS_STATUS_SUCCESS) {
             ret = PAM_SERVICE_ERR;
             goto out;
         }
 
         /* and make request one more time */
-        status = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                               errnop);
+        status = sss_cli_make_request_nochecks(conn, cmd, rd, timeout,
+                                               repbuf, replen, errnop);
     }
 
     if (status == SSS_STATUS_SUCCESS) {
@@ -991,7 +1043,23 @@ int sss_pam_make_request(enum sss_cli_command cmd,
     }
 
 out:
+    return ret;
+}
+
+int sss_pam_make_request(enum sss_cli_command cmd,
+                      struct sss_cli_req_data *rd,
+                      uint8_t **repbuf, size_t *replen,
+                      int *errnop)
+{
+    int ret;
+
+    sss_pam_lock();
+
+    ret = sss_pam_conn_make_request(&sss_cli_global_conn, cmd, rd,
+                                    repbuf, replen, errnop);
+
     sss_pam_unlock();
+
     return ret;
 }
 
@@ -999,14 +1067,48 @@ void sss_pam_close_fd(void)
 {
     sss_pam_lock();
 
-    if (sss_cli_sd != -1) {
-        close(sss_cli_sd);
-        sss_cli_sd = -1;
-    }
+    sss_cli_conn_close(&sss_cli_global_conn);
 
     sss_pam_unlock();
 }
 
+struct sss_cli_conn *sss_pam_conn_new(void)
+{
+    struct sss_cli_conn *conn;
+
+    conn = calloc(1, sizeof(struct sss_cli_conn));
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    conn->sd = -1;
+    conn->pid = getpid();
+
+    return conn;
+}
+
+void sss_pam_conn_free(struct sss_cli_conn *conn)
+{
+    if (conn == NULL) {
+        return;
+    }
+
+    sss_cli_conn_check_pid(conn);
+    sss_cli_conn_close(conn);
+    free(conn);
+}
+
+int sss_pam_make_request_conn(struct sss_cli_conn *conn,
+                              enum sss_cli_command cmd,
+                              struct sss_cli_req_data *rd,
+                              uint8_t **repbuf, size_t *replen,
+                              int *errnop)
+{
+    /* A PAM handle must not be used by multiple threads at once, so there
+     * is no need to serialize requests on its own connection. */
+    return sss_pam_conn_make_request(conn, cmd, rd, repbuf, replen, errnop);
+}
+
 static enum sss_status
 sss_cli_make_request_with_checks(enum sss_cli_command cmd,
                                  struct sss_cli_req_data *rd,
@@ -1022,8 +1124,8 @@ sss_cli_make_request_with_checks(enum sss_cli_command cmd,
         return SSS_STATUS_UNAVAIL;
     }
 
-    ret = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                        errnop);
+    ret = sss_cli_make_request_nochecks(&sss_cli_global_conn, cmd, rd,
+                                        timeout, repbuf, replen, errnop);
     if (ret == SSS_STATUS_UNAVAIL && *errnop == EPIPE) {
         /* try reopen socket */
         ret = sss_cli_check_socket(errnop, socket_name, timeout);
@@ -1032,8 +1134,8 @@ sss_cli_make_request_with_checks(enum sss_cli_command cmd,
         }
 
         /* and make request one more time */
-        ret = sss_cli_make_request_nochecks(cmd, rd, timeout, repbuf, replen,
-                                            errnop);
+        ret = sss_cli_make_request_nochecks(&sss_cli_global_conn, cmd, rd,
+                                            timeout, repbuf, replen, errnop);
     }
 
     return ret;
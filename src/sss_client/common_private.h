@@ -27,6 +27,21 @@
 
 #include "config.h"
 
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* A connection to one of the responders */
+struct sss_cli_conn {
+    int sd;
+    /* stat of the socket, to recognize it after fork() */
+    struct stat sb;
+    /* the process which opened the socket */
+    pid_t pid;
+    /* whether the server credentials were checked, PAM only */
+    bool cred_checked;
+};
+
 #if HAVE_PTHREAD
 #include <pthread.h>
 
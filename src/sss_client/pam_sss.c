@@ -55,6 +55,7 @@
 
 #define PWEXP_FLAG "pam_sss:password_expired_flag"
 #define FD_DESTRUCTOR "pam_sss:fd_destructor"
+#define CONN_DATA "pam_sss:connection"
 #define PAM_SSS_AUTHOK_TYPE "pam_sss:authtok_type"
 #define PAM_SSS_AUTHOK_SIZE "pam_sss:authtok_size"
 #define PAM_SSS_AUTHOK_DATA "pam_sss:authtok_data"
@@ -120,6 +121,39 @@ static void close_fd(pam_handle_t *pamh, void *ptr, int err)
     sss_pam_close_fd();
 }
 
+static void close_conn(pam_handle_t *pamh, void *ptr, int err)
+{
+    D(("Closing the connection"));
+    sss_pam_conn_free(ptr);
+}
+
+/* All stages of a PAM transaction use the same connection to the PAM
+ * responder, it is closed by pam_end(). */
+static struct sss_cli_conn *get_conn(pam_handle_t *pamh)
+{
+    struct sss_cli_conn *conn = NULL;
+    int ret;
+
+    ret = pam_get_data(pamh, CONN_DATA, (const void **) &conn);
+    if (ret == PAM_SUCCESS && conn != NULL) {
+        return conn;
+    }
+
+    conn = sss_pam_conn_new();
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    ret = pam_set_data(pamh, CONN_DATA, conn, close_conn);
+    if (ret != PAM_SUCCESS) {
+        D(("pam_set_data failed, using the shared connection."));
+        sss_pam_conn_free(conn);
+        return NULL;
+    }
+
+    return conn;
+}
+
 struct cert_auth_info {
     char *cert_user;
     char *cert;
@@ -1332,6 +1366,7 @@ static int send_and_receive(pam_handle_t *pamh, struct pam_items *pi,
     uint8_t *repbuf = NULL;
     size_t replen;
     int pam_status = PAM_SYSTEM_ERR;
+    struct sss_cli_conn *conn;
 
     print_pam_items(pi);
 
@@ -1344,11 +1379,17 @@ static int send_and_receive(pam_handle_t *pamh, struct pam_items *pi,
     rd.data = buf;
 
     errnop = 0;
-    ret = sss_pam_make_request(task, &rd, &repbuf, &replen, &errnop);
+    conn = get_conn(pamh);
+    if (conn != NULL) {
+        ret = sss_pam_make_request_conn(conn, task, &rd, &repbuf, &replen,
+                                        &errnop);
+    } else {
+        ret = sss_pam_make_request(task, &rd, &repbuf, &replen, &errnop);
 
-    sret = pam_set_data(pamh, FD_DESTRUCTOR, NULL, close_fd);
-    if (sret != PAM_SUCCESS) {
-        D(("pam_set_data failed, client might leaks fds"));
+        sret = pam_set_data(pamh, FD_DESTRUCTOR, NULL, close_fd);
+        if (sret != PAM_SUCCESS) {
+            D(("pam_set_data failed, client might leaks fds"));
+        }
     }
 
     if (ret != PAM_SUCCESS) {
@@ -646,6 +646,20 @@ int sss_pam_make_request(enum sss_cli_command cmd,
                          int *errnop);
 void sss_pam_close_fd(void);
 
+/* A private connection to the PAM responder. pam_sss keeps one for each PAM
+ * handle so that all stages of a PAM transaction are sent over the same
+ * socket without waiting for other handles of the process. */
+struct sss_cli_conn;
+
+struct sss_cli_conn *sss_pam_conn_new(void);
+void sss_pam_conn_free(struct sss_cli_conn *conn);
+
+int sss_pam_make_request_conn(struct sss_cli_conn *conn,
+                              enum sss_cli_command cmd,
+                              struct sss_cli_req_data *rd,
+                              uint8_t **repbuf, size_t *replen,
+                              int *errnop);
+
 /* Checks access to the PAC responder and opens the socket, if available.
  * Required for processes like krb5_child that need to open the socket
  * before dropping privs.
@@ -40,7 +40,8 @@ struct test_ctx {
     struct dp_method *dp_methods;
 };
 
-static int test_setup(void **state)
+static int test_setup_common(void **state,
+                             struct sss_test_conf_param *params)
 {
     struct test_ctx *test_ctx;
 
@@ -50,12 +51,14 @@ static int test_setup(void **state)
     assert_non_null(test_ctx);
 
     test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
-                                         TEST_DOM_NAME, TEST_ID_PROVIDER, NULL);
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         params);
     assert_non_null(test_ctx->tctx);
 
     test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
     test_ctx->provider = mock_dp(test_ctx, test_ctx->be_ctx);
     test_ctx->dp_methods = mock_dp_get_methods(test_ctx->provider, DPT_ID);
+    assert_int_equal(dp_init_request_queues(test_ctx->provider), EOK);
 
     check_leaks_push(test_ctx);
 
@@ -64,6 +67,23 @@ static int test_setup(void **state)
     return 0;
 }
 
+static int test_setup(void **state)
+{
+    return test_setup_common(state, NULL);
+}
+
+static int test_setup_limits(void **state)
+{
+    struct sss_test_conf_param params[] = {
+        { CONFDB_DOMAIN_MAX_INITGROUPS_REQUESTS, "-1" },
+        { CONFDB_DOMAIN_MAX_REFRESH_REQUESTS, "2" },
+        { CONFDB_DOMAIN_MAX_ENUMERATION_REQUESTS, "0" },
+        { NULL, NULL },             /* Sentinel */
+    };
+
+    return test_setup_common(state, params);
+}
+
 static int test_teardown(void **state)
 {
     struct test_ctx *test_ctx;
@@ -408,6 +428,242 @@ static void test_fast_reply(void **state)
     talloc_free(md);
 }
 
+static struct tevent_req *
+enumerate_send(TALLOC_CTX *mem_ctx,
+               struct method_data *md,
+               struct dp_id_data *data,
+               struct dp_req_params *params)
+{
+    struct tevent_req *req;
+    struct test_state *state;
+
+    req = tevent_req_create(mem_ctx, &state, struct test_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create failed.\n");
+        return NULL;
+    }
+
+    tevent_req_done(req);
+    tevent_req_post(req, params->ev);
+
+    return req;
+}
+
+static errno_t
+enumerate_recv(TALLOC_CTX *mem_ctx,
+               struct tevent_req *req,
+               struct recv_data *recv_data)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+static void test_enumeration_queued(void **state)
+{
+    errno_t ret;
+    struct test_ctx *test_ctx;
+    struct dp_req_queue *queue;
+    struct tevent_req *req;
+    struct tevent_req *req2;
+    struct method_data *md;
+    struct dp_id_data *data;
+    struct dp_id_data *data2;
+    struct recv_data *recv_data;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+    queue = &test_ctx->provider->requests.classes[DP_REQ_CLASS_ENUMERATION];
+
+    md = talloc(test_ctx, struct method_data);
+    assert_non_null(md);
+
+    dp_set_method(test_ctx->dp_methods,
+                  DPM_ACCOUNT_HANDLER,
+                  enumerate_send, enumerate_recv,
+                  md,
+                  struct method_data, struct dp_id_data, struct recv_data);
+
+    data = talloc_zero(test_ctx, struct dp_id_data);
+    assert_non_null(data);
+    data->entry_type = BE_REQ_USER;
+    data->filter_type = BE_FILTER_ENUM;
+
+    data2 = talloc_zero(test_ctx, struct dp_id_data);
+    assert_non_null(data2);
+    data2->entry_type = BE_REQ_GROUP;
+    data2->filter_type = BE_FILTER_ENUM;
+
+    /* Only one enumeration may run at the same time. */
+    req = dp_req_send(test_ctx, test_ctx->provider, NULL, "Enumeration",
+                      DPT_ID, DPM_ACCOUNT_HANDLER, 0, data, NULL);
+    assert_non_null(req);
+
+    req2 = dp_req_send(test_ctx, test_ctx->provider, NULL, "Enumeration",
+                       DPT_ID, DPM_ACCOUNT_HANDLER, 0, data2, NULL);
+    assert_non_null(req2);
+
+    assert_int_equal(queue->num_running, 1);
+    assert_int_equal(queue->num_queued, 1);
+
+    tevent_loop_wait(test_ctx->tctx->ev);
+
+    assert_int_equal(queue->num_running, 0);
+    assert_int_equal(queue->num_queued, 0);
+    assert_int_equal(queue->num_started, 2);
+    assert_int_equal(queue->num_delayed, 1);
+
+    ret = dp_req_recv_ptr(test_ctx, req, struct recv_data, &recv_data);
+    assert_int_equal(ret, EOK);
+    talloc_free(recv_data);
+
+    ret = dp_req_recv_ptr(test_ctx, req2, struct recv_data, &recv_data);
+    assert_int_equal(ret, EOK);
+    talloc_free(recv_data);
+
+    talloc_free(req);
+    talloc_free(req2);
+    talloc_free(md);
+}
+
+struct admission_result {
+    TALLOC_CTX *mem_ctx;
+    struct dp_req_slot *slot;
+    errno_t ret;
+    bool done;
+};
+
+static void test_admission_done(struct tevent_req *req)
+{
+    struct admission_result *result;
+
+    result = tevent_req_callback_data(req, struct admission_result);
+    result->ret = dp_req_admission_recv(result->mem_ctx, req, &result->slot);
+    result->done = true;
+    talloc_free(req);
+}
+
+static void test_background_task_not_delaying(void **state)
+{
+    errno_t ret;
+    struct test_ctx *test_ctx;
+    struct dp_req_queue *refresh;
+    struct dp_req_queue *interactive;
+    struct admission_result results[5];
+    struct tevent_req *req;
+    struct method_data *md;
+    struct dp_id_data *data;
+    struct recv_data *recv_data;
+    int i;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+    refresh = &test_ctx->provider->requests.classes[DP_REQ_CLASS_REFRESH];
+    interactive =
+        &test_ctx->provider->requests.classes[DP_REQ_CLASS_INTERACTIVE];
+
+    /* Background tasks take all refresh slots and one more waits. */
+    assert_int_equal(refresh->limit + 1, 5);
+    memset(results, 0, sizeof(results));
+    for (i = 0; i < 5; i++) {
+        results[i].mem_ctx = test_ctx;
+        req = dp_req_admission_send(test_ctx, test_ctx->provider,
+                                    DP_REQ_CLASS_REFRESH, "Background");
+        assert_non_null(req);
+        tevent_req_set_callback(req, test_admission_done, &results[i]);
+    }
+
+    assert_int_equal(refresh->num_running, 4);
+    assert_int_equal(refresh->num_queued, 1);
+
+    while (!results[0].done || !results[1].done
+            || !results[2].done || !results[3].done) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+    for (i = 0; i < 4; i++) {
+        assert_int_equal(results[i].ret, EOK);
+        assert_non_null(results[i].slot);
+    }
+    assert_false(results[4].done);
+
+    /* A lookup starts at once while the background tasks are running. */
+    md = talloc(test_ctx, struct method_data);
+    assert_non_null(md);
+
+    dp_set_method(test_ctx->dp_methods,
+                  DPM_ACCOUNT_HANDLER,
+                  enumerate_send, enumerate_recv,
+                  md,
+                  struct method_data, struct dp_id_data, struct recv_data);
+
+    data = talloc_zero(test_ctx, struct dp_id_data);
+    assert_non_null(data);
+    data->entry_type = BE_REQ_USER;
+    data->filter_type = BE_FILTER_NAME;
+
+    req = dp_req_send(test_ctx, test_ctx->provider, NULL, "Lookup",
+                      DPT_ID, DPM_ACCOUNT_HANDLER, 0, data, NULL);
+    assert_non_null(req);
+
+    assert_int_equal(interactive->num_running, 1);
+    assert_int_equal(interactive->num_queued, 0);
+    assert_int_equal(interactive->num_delayed, 0);
+
+    while (tevent_req_is_in_progress(req)) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+
+    ret = dp_req_recv_ptr(test_ctx, req, struct recv_data, &recv_data);
+    assert_int_equal(ret, EOK);
+    talloc_free(recv_data);
+    talloc_free(req);
+    assert_false(results[4].done);
+
+    /* Releasing a slot admits the waiting task. */
+    talloc_zfree(results[0].slot);
+    while (!results[4].done) {
+        tevent_loop_once(test_ctx->tctx->ev);
+    }
+    assert_int_equal(results[4].ret, EOK);
+    assert_int_equal(refresh->num_running, 4);
+    assert_int_equal(refresh->num_queued, 0);
+    assert_int_equal(refresh->num_delayed, 1);
+
+    for (i = 1; i < 5; i++) {
+        talloc_free(results[i].slot);
+    }
+    assert_int_equal(refresh->num_running, 0);
+
+    talloc_free(md);
+}
+
+static void test_request_limits_default(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct dp_req_queue *classes;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+    classes = test_ctx->provider->requests.classes;
+
+    assert_int_equal(classes[DP_REQ_CLASS_INTERACTIVE].limit, 0);
+    assert_int_equal(classes[DP_REQ_CLASS_INITGROUPS].limit, 50);
+    assert_int_equal(classes[DP_REQ_CLASS_REFRESH].limit, 4);
+    assert_int_equal(classes[DP_REQ_CLASS_ENUMERATION].limit, 1);
+}
+
+static void test_request_limits_config(void **state)
+{
+    struct test_ctx *test_ctx;
+    struct dp_req_queue *classes;
+
+    test_ctx = talloc_get_type(*state, struct test_ctx);
+    classes = test_ctx->provider->requests.classes;
+
+    assert_int_equal(classes[DP_REQ_CLASS_INTERACTIVE].limit, 0);
+    /* an invalid value falls back to the default */
+    assert_int_equal(classes[DP_REQ_CLASS_INITGROUPS].limit, 50);
+    assert_int_equal(classes[DP_REQ_CLASS_REFRESH].limit, 2);
+    assert_int_equal(classes[DP_REQ_CLASS_ENUMERATION].limit, 0);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -435,6 +691,18 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_nonexist_dom,
                                         test_setup,
                                         test_teardown),
+        cmocka_unit_test_setup_teardown(test_enumeration_queued,
+                                        test_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_background_task_not_delaying,
+                                        test_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_request_limits_default,
+                                        test_setup,
+                                        test_teardown),
+        cmocka_unit_test_setup_teardown(test_request_limits_config,
+                                        test_setup_limits,
+                                        test_teardown),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
@@ -30,6 +30,8 @@
 #include <arpa/inet.h>
 
 #include "providers/ad/ad_pac.h"
+#include "providers/ldap/sdap_async.h"
+#include "providers/ldap/sdap_async_ad.h"
 #include "util/crypto/sss_crypto.h"
 #include "util/util_sss_idmap.h"
 
@@ -183,6 +185,212 @@ static void test_check_if_pac_is_available(void **state)
     talloc_free(ar);
 }
 
+/* The LDAP connection and search used by sdap_ad_resolve_sids_batch_send()
+ * are replaced, every search only records how many SIDs it contained. */
+#define TEST_DOM1_SID "S-1-5-21-1-2-3"
+#define TEST_DOM2_SID "S-1-5-21-4-5-6"
+#define MAX_BATCH_SEARCHES 10
+
+static struct tevent_context *batch_ev;
+static size_t batch_num_searches;
+static size_t batch_search_sids[MAX_BATCH_SEARCHES];
+static char batch_search_dom[MAX_BATCH_SEARCHES][32];
+
+struct batch_mock_state {
+    int dummy;
+};
+
+static struct tevent_req *batch_mock_req(TALLOC_CTX *mem_ctx, errno_t ret)
+{
+    struct batch_mock_state *state;
+    struct tevent_req *req;
+
+    req = tevent_req_create(mem_ctx, &state, struct batch_mock_state);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, batch_ev);
+
+    return req;
+}
+
+struct sdap_id_op *__wrap_sdap_id_op_create(TALLOC_CTX *memctx,
+                                            struct sdap_id_conn_cache *cache)
+{
+    return (struct sdap_id_op *) talloc_new(memctx);
+}
+
+struct tevent_req *__wrap_sdap_id_op_connect_send(struct sdap_id_op *op,
+                                                  TALLOC_CTX *memctx,
+                                                  int *ret_out)
+{
+    *ret_out = EOK;
+    return batch_mock_req(memctx, EOK);
+}
+
+int __wrap_sdap_id_op_connect_recv(struct tevent_req *req, int *dp_error)
+{
+    *dp_error = DP_ERR_OK;
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+struct sdap_handle *__wrap_sdap_id_op_handle(struct sdap_id_op *op)
+{
+    return NULL;
+}
+
+int __wrap_sdap_id_op_done(struct sdap_id_op *op, int ret, int *dp_error)
+{
+    *dp_error = (ret == EOK ? DP_ERR_OK : DP_ERR_FATAL);
+    return ret;
+}
+
+struct tevent_req *
+__wrap_sdap_get_groups_send(TALLOC_CTX *memctx,
+                            struct tevent_context *ev,
+                            struct sdap_domain *sdom,
+                            struct sdap_options *opts,
+                            struct sdap_handle *sh,
+                            const char **attrs,
+                            const char *filter,
+                            int timeout,
+                            enum sdap_entry_lookup_type lookup_type,
+                            bool no_members)
+{
+    const char *p;
+    size_t num = 0;
+
+    assert_true(batch_num_searches < MAX_BATCH_SEARCHES);
+    assert_true(no_members);
+
+    for (p = strstr(filter, "(objectSID="); p != NULL;
+         p = strstr(p + 1, "(objectSID=")) {
+        num++;
+    }
+
+    batch_search_sids[batch_num_searches] = num;
+    strncpy(batch_search_dom[batch_num_searches], sdom->dom->name,
+            sizeof(batch_search_dom[0]) - 1);
+    batch_num_searches++;
+
+    return batch_mock_req(memctx, sss_mock_type(errno_t));
+}
+
+int __wrap_sdap_get_groups_recv(struct tevent_req *req,
+                                TALLOC_CTX *mem_ctx, char **timestamp)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static void test_sdap_ad_resolve_sids_batch_done(struct tevent_req *req)
+{
+    struct ad_sysdb_test_ctx *test_ctx =
+        tevent_req_callback_data(req, struct ad_sysdb_test_ctx);
+    size_t num_searches;
+    errno_t ret;
+
+    ret = sdap_ad_resolve_sids_batch_recv(req, &num_searches);
+    talloc_free(req);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_searches, 3);
+
+    test_ev_done(test_ctx->tctx, EOK);
+}
+
+static void test_sdap_ad_resolve_sids_batch(void **state)
+{
+    struct ad_sysdb_test_ctx *test_ctx =
+        talloc_get_type(*state, struct ad_sysdb_test_ctx);
+    struct sss_domain_info *dom2;
+    struct sdap_id_ctx *id_ctx;
+    struct sdap_id_conn_ctx *conn;
+    struct tevent_req *req;
+    char **sids;
+    size_t c;
+    errno_t ret;
+
+    batch_ev = test_ctx->tctx->ev;
+    batch_num_searches = 0;
+
+    dom2 = find_domain_by_name(test_ctx->tctx->dom, TEST_DOM2_NAME, true);
+    assert_non_null(dom2);
+    test_ctx->tctx->dom->domain_id = talloc_strdup(test_ctx->tctx->dom,
+                                                   TEST_DOM1_SID);
+    assert_non_null(test_ctx->tctx->dom->domain_id);
+    dom2->domain_id = talloc_strdup(dom2, TEST_DOM2_SID);
+    assert_non_null(dom2->domain_id);
+
+    id_ctx = talloc_zero(test_ctx, struct sdap_id_ctx);
+    assert_non_null(id_ctx);
+    id_ctx->opts = talloc_zero(id_ctx, struct sdap_options);
+    assert_non_null(id_ctx->opts);
+
+    ret = dp_copy_defaults(id_ctx->opts, ad_def_ldap_opts, SDAP_OPTS_BASIC,
+                           &id_ctx->opts->basic);
+    assert_int_equal(ret, EOK);
+    ret = sdap_copy_map(id_ctx->opts, ad_2008r2_group_map, SDAP_OPTS_GROUP,
+                        &id_ctx->opts->group_map);
+    assert_int_equal(ret, EOK);
+    ret = sdap_domain_add(id_ctx->opts, test_ctx->tctx->dom, NULL);
+    assert_int_equal(ret, EOK);
+    ret = sdap_domain_add(id_ctx->opts, dom2, NULL);
+    assert_int_equal(ret, EOK);
+
+    conn = talloc_zero(id_ctx, struct sdap_id_conn_ctx);
+    assert_non_null(conn);
+
+    /* 60 SIDs of the first domain, 3 of the second one interleaved and one
+     * of an unknown domain which is skipped */
+    sids = talloc_zero_array(id_ctx, char *, 65);
+    assert_non_null(sids);
+    for (c = 0; c < 60; c++) {
+        sids[c] = talloc_asprintf(sids, TEST_DOM1_SID"-%zu", 1000 + c);
+        assert_non_null(sids[c]);
+    }
+    for (c = 0; c < 3; c++) {
+        sids[60 + c] = sids[10 * c];
+        sids[10 * c] = talloc_asprintf(sids, TEST_DOM2_SID"-%zu", 2000 + c);
+        assert_non_null(sids[10 * c]);
+    }
+    sids[63] = talloc_strdup(sids, "S-1-5-32-544");
+    assert_non_null(sids[63]);
+
+    /* The second search finds nothing, the lookup continues */
+    will_return(__wrap_sdap_get_groups_send, EOK);
+    will_return(__wrap_sdap_get_groups_send, ENOENT);
+    will_return(__wrap_sdap_get_groups_send, EOK);
+
+    req = sdap_ad_resolve_sids_batch_send(test_ctx, test_ctx->tctx->ev,
+                                          id_ctx, conn, test_ctx->tctx->dom,
+                                          sids);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_sdap_ad_resolve_sids_batch_done,
+                            test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    /* The first SID belongs to the second domain, so its SIDs come first
+     * and the 60 SIDs of the first domain are split at the batch size. */
+    assert_int_equal(batch_num_searches, 3);
+    assert_int_equal(batch_search_sids[0], 3);
+    assert_string_equal(batch_search_dom[0], TEST_DOM2_NAME);
+    assert_int_equal(batch_search_sids[1], 50);
+    assert_string_equal(batch_search_dom[1], TEST_DOM1_NAME);
+    assert_int_equal(batch_search_sids[2], 10);
+    assert_string_equal(batch_search_dom[2], TEST_DOM1_NAME);
+
+    talloc_free(id_ctx);
+}
+
 #define TEST_PAC_BASE64 \
     "BQAAAAAAAAABAAAA6AEAAFgAAAAAAAAACgAAABAAAABAAgAAAA" \
     "AAAAwAAAA4AAAAUAIAAAAAAAAGAAAAFAAAAIgCAAAAAAAABwAA" \
@@ -993,6 +1201,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_check_if_pac_is_available,
                                         test_ad_sysdb_setup,
                                         test_ad_sysdb_teardown),
+        cmocka_unit_test_setup_teardown(test_sdap_ad_resolve_sids_batch,
+                                        test_ad_sysdb_setup,
+                                        test_ad_sysdb_teardown),
         cmocka_unit_test_setup_teardown(test_ad_get_data_from_pac,
                                         test_ad_common_setup,
                                         test_ad_common_teardown),
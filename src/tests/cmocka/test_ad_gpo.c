@@ -401,6 +401,103 @@ void test_ad_gpo_parse_sd(void **state)
     talloc_free(sd);
 }
 
+static void add_cached_policy(struct ad_gpo_cache *cache, const char *key)
+{
+    struct ad_gpo_policy *policy;
+
+    policy = talloc_zero(test_ctx, struct ad_gpo_policy);
+    assert_non_null(policy);
+    policy->key = talloc_strdup(policy, key);
+    assert_non_null(policy->key);
+    policy->allow_values[GPO_MAP_INTERACTIVE] = talloc_strdup(policy,
+                                                              "*S-1-5-32-544");
+    assert_non_null(policy->allow_values[GPO_MAP_INTERACTIVE]);
+
+    ad_gpo_cache_add_policy(cache, policy);
+}
+
+void test_ad_gpo_cache_policies(void **state)
+{
+    struct ad_gpo_cache *cache;
+    struct ad_gpo_policy *policy;
+    char *key;
+    int i;
+
+    cache = talloc_zero(test_ctx, struct ad_gpo_cache);
+    assert_non_null(cache);
+
+    assert_null(ad_gpo_cache_find_policy(cache, "{GUID-1}:1;"));
+
+    for (i = 0; i < AD_GPO_MAX_CACHED_POLICIES + 2; i++) {
+        key = talloc_asprintf(cache, "{GUID-%d}:1;", i);
+        assert_non_null(key);
+        add_cached_policy(cache, key);
+    }
+    assert_int_equal(cache->num_policies, AD_GPO_MAX_CACHED_POLICIES);
+
+    /* The least recently used policies were evicted */
+    assert_null(ad_gpo_cache_find_policy(cache, "{GUID-0}:1;"));
+    assert_null(ad_gpo_cache_find_policy(cache, "{GUID-1}:1;"));
+
+    policy = ad_gpo_cache_find_policy(cache, "{GUID-2}:1;");
+    assert_non_null(policy);
+    assert_string_equal(policy->allow_values[GPO_MAP_INTERACTIVE],
+                        "*S-1-5-32-544");
+    assert_ptr_equal(cache->policies, policy);
+
+    /* A new version is a different policy */
+    assert_null(ad_gpo_cache_find_policy(cache, "{GUID-2}:2;"));
+
+    /* Replacing a policy does not add a new one */
+    add_cached_policy(cache, "{GUID-2}:1;");
+    assert_int_equal(cache->num_policies, AD_GPO_MAX_CACHED_POLICIES);
+    assert_non_null(ad_gpo_cache_find_policy(cache, "{GUID-3}:1;"));
+
+    talloc_free(cache);
+}
+
+void test_ad_gpo_cache_candidates(void **state)
+{
+    struct ad_gpo_cache *cache;
+    struct ad_gpo_candidates *first;
+    struct ad_gpo_candidates *second;
+    struct gp_gpo **gpos;
+    int ret;
+
+    cache = talloc_zero(test_ctx, struct ad_gpo_cache);
+    assert_non_null(cache);
+
+    assert_null(ad_gpo_cache_get_candidates(cache));
+
+    gpos = talloc_zero_array(test_ctx, struct gp_gpo *, 2);
+    assert_non_null(gpos);
+    gpos[0] = talloc_zero(gpos, struct gp_gpo);
+    assert_non_null(gpos[0]);
+
+    ret = ad_gpo_cache_set_candidates(cache, "S-1-5-21-1-2-3-1000", gpos, 1,
+                                      60, &first);
+    assert_int_equal(ret, EOK);
+    assert_ptr_equal(ad_gpo_cache_get_candidates(cache), first);
+    assert_string_equal(first->host_sid, "S-1-5-21-1-2-3-1000");
+    assert_int_equal(first->num_gpos, 1);
+
+    /* A request still uses the first list when it is replaced */
+    first->num_users++;
+
+    ret = ad_gpo_cache_set_candidates(cache, NULL, NULL, 0, 0, &second);
+    assert_int_equal(ret, EOK);
+    assert_true(first->retired);
+    assert_int_equal(first->num_gpos, 1);
+
+    /* The list expired immediately */
+    assert_null(ad_gpo_cache_get_candidates(cache));
+
+    /* The leak check in teardown fails if the first list is not freed */
+    ad_gpo_candidates_release(first);
+
+    talloc_free(cache);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -442,6 +539,12 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_ad_gpo_parse_sd,
                                         ad_gpo_test_setup,
                                         ad_gpo_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_gpo_cache_policies,
+                                        ad_gpo_test_setup,
+                                        ad_gpo_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ad_gpo_cache_candidates,
+                                        ad_gpo_test_setup,
+                                        ad_gpo_test_teardown),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
@@ -111,6 +111,23 @@ int be_add_offline_cb(TALLOC_CTX *mem_ctx,
     return ERR_OK;
 }
 
+/* The tasks in this test have no data provider, they never wait for
+ * a scheduling slot. */
+struct tevent_req *dp_req_admission_send(TALLOC_CTX *mem_ctx,
+                                         struct data_provider *provider,
+                                         enum dp_req_class class,
+                                         const char *name)
+{
+    return NULL;
+}
+
+errno_t dp_req_admission_recv(TALLOC_CTX *mem_ctx,
+                              struct tevent_req *req,
+                              struct dp_req_slot **_slot)
+{
+    return ENOSYS;
+}
+
 struct test_be_ptask_state {
     struct test_ctx *test_ctx;
 };
@@ -0,0 +1,229 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - pacing of the background refresh
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+/* In order to access opaque types */
+#include "providers/be_refresh.c"
+
+#include "tests/cmocka/common_mock.h"
+
+errno_t be_ptask_create(TALLOC_CTX *mem_ctx,
+                        struct be_ctx *be_ctx,
+                        time_t period,
+                        time_t first_delay,
+                        time_t enabled_delay,
+                        time_t random_offset,
+                        time_t timeout,
+                        time_t max_backoff,
+                        be_ptask_send_t send_fn,
+                        be_ptask_recv_t recv_fn,
+                        void *pvt,
+                        const char *name,
+                        uint32_t flags,
+                        struct be_ptask **_task)
+{
+    return ENOSYS;
+}
+
+time_t be_ptask_get_period(struct be_ptask *task)
+{
+    return 0;
+}
+
+bool dp_req_user_requests_pending(struct data_provider *provider)
+{
+    return false;
+}
+
+static void init_pacing(struct be_refresh_pacing *pacing)
+{
+    pacing->batch_size = BE_REFRESH_BATCH_INITIAL;
+    pacing->delay = BE_REFRESH_DELAY_MIN;
+}
+
+/* msec a batch of count entries takes at the given latency per entry */
+#define BATCH_MSEC(count, per_entry) ((count) * (per_entry))
+
+static void test_pacing_fast_grows(void **state)
+{
+    struct be_refresh_pacing pacing;
+    size_t expected;
+
+    init_pacing(&pacing);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size, 1), EOK);
+    expected = BE_REFRESH_BATCH_INITIAL + BE_REFRESH_BATCH_STEP;
+    assert_int_equal(pacing.batch_size, expected);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN);
+
+    /* the batch does not grow beyond the maximum */
+    while (expected < BE_REFRESH_BATCH_MAX) {
+        be_refresh_pacing_update(&pacing, pacing.batch_size,
+                                 BATCH_MSEC(pacing.batch_size, 1), EOK);
+        expected += BE_REFRESH_BATCH_STEP;
+    }
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_MAX);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size, 1), EOK);
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_MAX);
+}
+
+static void test_pacing_moderate_keeps(void **state)
+{
+    struct be_refresh_pacing pacing;
+
+    init_pacing(&pacing);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size,
+                                        BE_REFRESH_LATENCY_LOW),
+                             EOK);
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_INITIAL);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size,
+                                        BE_REFRESH_LATENCY_HIGH),
+                             EOK);
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_INITIAL);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN);
+
+    /* other errors than congestion do not change the pacing */
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size, 1), EIO);
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_INITIAL);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN);
+}
+
+static void test_pacing_slow_shrinks(void **state)
+{
+    struct be_refresh_pacing pacing;
+
+    init_pacing(&pacing);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size,
+                                        BE_REFRESH_LATENCY_HIGH + 1),
+                             EOK);
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_INITIAL / 2);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN * 2);
+}
+
+static void test_pacing_congestion_shrinks(void **state)
+{
+    struct be_refresh_pacing pacing;
+    errno_t errors[] = { ETIMEDOUT, EBUSY, ERR_NETWORK_IO };
+    size_t expected;
+    size_t i;
+
+    for (i = 0; i < N_ELEMENTS(errors); i++) {
+        init_pacing(&pacing);
+
+        /* the latency does not matter */
+        be_refresh_pacing_update(&pacing, pacing.batch_size, 1, errors[i]);
+        assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_INITIAL / 2);
+        assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN * 2);
+    }
+
+    /* the batch and the delay stay within bounds */
+    init_pacing(&pacing);
+    expected = BE_REFRESH_BATCH_INITIAL;
+    while (expected > BE_REFRESH_BATCH_MIN) {
+        be_refresh_pacing_update(&pacing, pacing.batch_size, 0, ETIMEDOUT);
+        expected = MAX(expected / 2, BE_REFRESH_BATCH_MIN);
+    }
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_MIN);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MAX);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size, 0, ETIMEDOUT);
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_MIN);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MAX);
+}
+
+static void test_pacing_recovers(void **state)
+{
+    struct be_refresh_pacing pacing;
+
+    init_pacing(&pacing);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size, 0, ETIMEDOUT);
+    be_refresh_pacing_update(&pacing, pacing.batch_size, 0, ETIMEDOUT);
+    assert_int_equal(pacing.batch_size, BE_REFRESH_BATCH_INITIAL / 4);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN * 4);
+
+    /* the batch grows additively while the delay is halved */
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size, 1), EOK);
+    assert_int_equal(pacing.batch_size,
+                     BE_REFRESH_BATCH_INITIAL / 4 + BE_REFRESH_BATCH_STEP);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN * 2);
+
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size, 1), EOK);
+    be_refresh_pacing_update(&pacing, pacing.batch_size,
+                             BATCH_MSEC(pacing.batch_size, 1), EOK);
+    assert_int_equal(pacing.delay, BE_REFRESH_DELAY_MIN);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_pacing_fast_grows),
+        cmocka_unit_test(test_pacing_moderate_keeps),
+        cmocka_unit_test(test_pacing_slow_shrinks),
+        cmocka_unit_test(test_pacing_congestion_shrinks),
+        cmocka_unit_test(test_pacing_recovers),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
@@ -450,6 +450,109 @@ static void echo_child_read_done(struct tevent_req *subreq)
     echo_state->child_test_ctx->test_ctx->done = true;
 }
 
+static void wait_for_req(struct tevent_context *ev, struct tevent_req *req)
+{
+    while (tevent_req_is_in_progress(req)) {
+        assert_int_equal(tevent_loop_once(ev), 0);
+    }
+}
+
+/* Test that several frames can be passed over the same pipe */
+void test_pipe_frames(void **state)
+{
+    errno_t ret;
+    ssize_t len;
+    uint8_t *buf;
+    uint8_t sync_buf[IN_BUF_SIZE];
+    struct tevent_req *req;
+    struct child_test_ctx *child_tctx = talloc_get_type(*state,
+                                                        struct child_test_ctx);
+    struct tevent_context *ev = child_tctx->test_ctx->ev;
+    int rfd = child_tctx->pipefd_to_child[0];
+    int wfd = child_tctx->pipefd_to_child[1];
+
+    sss_fd_nonblocking(rfd);
+    sss_fd_nonblocking(wfd);
+
+    /* Blocking writer, asynchronous reader */
+    len = sss_atomic_write_frame_s(wfd, discard_const(ECHO_STR),
+                                   sizeof(ECHO_STR));
+    assert_int_equal(len, sizeof(ECHO_STR));
+    len = sss_atomic_write_frame_s(wfd, NULL, 0);
+    assert_int_equal(len, 0);
+
+    req = read_pipe_frame_send(child_tctx, ev, rfd);
+    assert_non_null(req);
+    wait_for_req(ev, req);
+    ret = read_pipe_frame_recv(req, child_tctx, &buf, &len);
+    talloc_free(req);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(len, sizeof(ECHO_STR));
+    assert_string_equal(buf, ECHO_STR);
+    talloc_free(buf);
+
+    req = read_pipe_frame_send(child_tctx, ev, rfd);
+    assert_non_null(req);
+    wait_for_req(ev, req);
+    ret = read_pipe_frame_recv(req, child_tctx, &buf, &len);
+    talloc_free(req);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(len, 0);
+    talloc_free(buf);
+
+    /* Asynchronous writer, blocking reader */
+    req = write_pipe_frame_send(child_tctx, ev,
+                                discard_const(ECHO_STR), sizeof(ECHO_STR),
+                                wfd);
+    assert_non_null(req);
+    wait_for_req(ev, req);
+    ret = write_pipe_recv(req);
+    talloc_free(req);
+    assert_int_equal(ret, EOK);
+
+    len = sss_atomic_read_frame_s(rfd, sync_buf, 4);
+    assert_int_equal(len, -1);
+    assert_int_equal(errno, EMSGSIZE);
+
+    req = write_pipe_frame_send(child_tctx, ev,
+                                discard_const(ECHO_STR), sizeof(ECHO_STR),
+                                wfd);
+    assert_non_null(req);
+    wait_for_req(ev, req);
+    ret = write_pipe_recv(req);
+    talloc_free(req);
+    assert_int_equal(ret, EOK);
+
+    /* The oversized frame above left its payload in the pipe, drain it
+     * before reading the second frame. */
+    len = sss_atomic_read_s(rfd, sync_buf, sizeof(ECHO_STR));
+    assert_int_equal(len, sizeof(ECHO_STR));
+
+    len = sss_atomic_read_frame_s(rfd, sync_buf, sizeof(sync_buf));
+    assert_int_equal(len, sizeof(ECHO_STR));
+    assert_string_equal(sync_buf, ECHO_STR);
+
+    /* A closed pipe is reported before a frame and as an error inside
+     * a frame */
+    close(wfd);
+    child_tctx->pipefd_to_child[1] = -1;
+    len = sss_atomic_read_frame_s(rfd, sync_buf, sizeof(sync_buf));
+    assert_int_equal(len, 0);
+    assert_int_equal(errno, 0);
+
+    req = read_pipe_frame_send(child_tctx, ev, rfd);
+    assert_non_null(req);
+    wait_for_req(ev, req);
+    ret = read_pipe_frame_recv(req, child_tctx, &buf, &len);
+    talloc_free(req);
+    assert_int_equal(ret, EPIPE);
+
+    close(rfd);
+    child_tctx->pipefd_to_child[0] = -1;
+    close(child_tctx->pipefd_from_child[0]);
+    close(child_tctx->pipefd_from_child[1]);
+}
+
 void sss_child_cb(int pid, int wait_status, void *pvt);
 
 /* Just make sure the exec works. The child does nothing but exits */
@@ -527,6 +630,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_exec_child_echo,
                                         child_test_setup,
                                         child_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pipe_frames,
+                                        child_test_setup,
+                                        child_test_teardown),
         cmocka_unit_test_setup_teardown(test_sss_child,
                                         child_test_setup,
                                         child_test_teardown),
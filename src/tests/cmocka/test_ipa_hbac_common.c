@@ -0,0 +1,309 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - HBAC rules compiled from the cache
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+#include "providers/ipa/ipa_common.h"
+#include "providers/ipa/ipa_opts.h"
+#include "providers/ipa/ipa_hbac_private.h"
+#include "providers/ipa/ipa_rules_common.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_ipa_hbac_common_conf.ldb"
+#define TEST_DOM_NAME "ipa.example.com"
+
+#define TEST_USER "user1"
+#define TEST_GROUP "admins"
+/* Neither DN has the layout get_ipa_groupname() can parse a name from, so
+ * both are only resolved once the entry is in the cache */
+#define TEST_USER_DN "uid=user1,cn=users,cn=accounts,dc=example,dc=com"
+#define TEST_GROUP_DN "cn=admins,ou=groups,dc=example,dc=com"
+
+struct hbac_common_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct be_ctx *be_ctx;
+    struct dp_option *ipa_options;
+};
+
+static int hbac_common_test_setup(void **state)
+{
+    struct hbac_common_test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context,
+                           struct hbac_common_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, "ipa", NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
+    assert_non_null(test_ctx->be_ctx);
+
+    ret = dp_copy_options(test_ctx, ipa_basic_opts, IPA_OPTS_BASIC,
+                          &test_ctx->ipa_options);
+    assert_int_equal(ret, EOK);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int hbac_common_test_teardown(void **state)
+{
+    struct hbac_common_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct hbac_common_test_ctx);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static struct sysdb_attrs *test_rule_attrs(TALLOC_CTX *mem_ctx,
+                                           const char *member_dn)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(mem_ctx);
+    assert_non_null(attrs);
+
+    ret = sysdb_attrs_add_string(attrs, IPA_CN, "allow_member");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(attrs, IPA_ENABLED_FLAG, IPA_TRUE_VALUE);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(attrs, IPA_ACCESS_RULE_TYPE, IPA_HBAC_ALLOW);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(attrs, IPA_MEMBER_USER, member_dn);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(attrs, IPA_SERVICE_CATEGORY, "all");
+    assert_int_equal(ret, EOK);
+    ret = sysdb_attrs_add_string(attrs, IPA_HOST_CATEGORY, "all");
+    assert_int_equal(ret, EOK);
+
+    return attrs;
+}
+
+static struct ipa_hbac_compiled_rules *
+test_compile(struct hbac_common_test_ctx *test_ctx, const char *member_dn)
+{
+    struct ipa_hbac_compiled_rules *compiled;
+    struct hbac_ctx hbac_ctx;
+    errno_t ret;
+
+    hbac_ctx.be_ctx = test_ctx->be_ctx;
+    hbac_ctx.ipa_options = test_ctx->ipa_options;
+    hbac_ctx.pd = NULL;
+    hbac_ctx.rule_count = 1;
+    hbac_ctx.rules = talloc_zero_array(test_ctx, struct sysdb_attrs *, 2);
+    assert_non_null(hbac_ctx.rules);
+    hbac_ctx.rules[0] = test_rule_attrs(hbac_ctx.rules, member_dn);
+
+    ret = hbac_compile_ctx_rules(test_ctx, &hbac_ctx, &compiled);
+    assert_int_equal(ret, EOK);
+    assert_false(compiled->deny_rules);
+
+    return compiled;
+}
+
+static struct hbac_eval_req *test_eval_req(TALLOC_CTX *mem_ctx,
+                                           const char *group)
+{
+    struct hbac_eval_req *eval_req;
+
+    eval_req = talloc_zero(mem_ctx, struct hbac_eval_req);
+    assert_non_null(eval_req);
+    eval_req->request_time = time(NULL);
+
+    eval_req->user = talloc_zero(eval_req, struct hbac_request_element);
+    assert_non_null(eval_req->user);
+    eval_req->user->name = TEST_USER;
+    eval_req->user->groups = talloc_zero_array(eval_req, const char *, 2);
+    assert_non_null(eval_req->user->groups);
+    eval_req->user->groups[0] = group;
+
+    eval_req->service = talloc_zero(eval_req, struct hbac_request_element);
+    assert_non_null(eval_req->service);
+    eval_req->service->name = "sshd";
+    eval_req->service->groups = talloc_zero_array(eval_req, const char *, 1);
+    assert_non_null(eval_req->service->groups);
+
+    eval_req->targethost = talloc_zero(eval_req, struct hbac_request_element);
+    assert_non_null(eval_req->targethost);
+    eval_req->targethost->name = "client.example.com";
+    eval_req->targethost->groups = talloc_zero_array(eval_req,
+                                                     const char *, 1);
+    assert_non_null(eval_req->targethost->groups);
+
+    eval_req->srchost = talloc_zero(eval_req, struct hbac_request_element);
+    assert_non_null(eval_req->srchost);
+    eval_req->srchost->groups = talloc_zero_array(eval_req, const char *, 1);
+    assert_non_null(eval_req->srchost->groups);
+
+    return eval_req;
+}
+
+static enum hbac_eval_result
+test_evaluate(struct hbac_common_test_ctx *test_ctx,
+              struct ipa_hbac_compiled_rules *compiled,
+              struct hbac_eval_req *eval_req)
+{
+    enum hbac_eval_result result;
+    struct hbac_info *info = NULL;
+    errno_t ret;
+
+    ret = hbac_evaluate_compiled_rules(compiled, test_ctx->tctx->dom,
+                                       eval_req, &result, &info);
+    assert_int_equal(ret, EOK);
+    hbac_free_info(info);
+
+    return result;
+}
+
+static void test_hbac_compiled_group_cached_later(void **state)
+{
+    struct hbac_common_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct hbac_common_test_ctx);
+    struct ipa_hbac_compiled_rules *compiled;
+    struct hbac_eval_req *eval_req;
+    struct sysdb_attrs *group_attrs;
+    char *fqname;
+    errno_t ret;
+
+    compiled = test_compile(test_ctx, TEST_GROUP_DN);
+    eval_req = test_eval_req(test_ctx, TEST_GROUP);
+
+    /* The group is not known yet */
+    assert_int_equal(test_evaluate(test_ctx, compiled, eval_req),
+                     HBAC_EVAL_DENY);
+
+    /* The group is cached after the rules were compiled */
+    fqname = sss_create_internal_fqname(test_ctx, TEST_GROUP,
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+    group_attrs = sysdb_new_attrs(test_ctx);
+    assert_non_null(group_attrs);
+    ret = sysdb_attrs_add_string(group_attrs, SYSDB_ORIG_DN, TEST_GROUP_DN);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_add_group(test_ctx->tctx->dom, fqname, 10001,
+                          group_attrs, 0, time(NULL));
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(test_evaluate(test_ctx, compiled, eval_req),
+                     HBAC_EVAL_ALLOW);
+
+    /* A user outside of the group is still denied */
+    eval_req->user->groups[0] = NULL;
+    assert_int_equal(test_evaluate(test_ctx, compiled, eval_req),
+                     HBAC_EVAL_DENY);
+
+    talloc_free(group_attrs);
+    talloc_free(fqname);
+    talloc_free(eval_req);
+    talloc_free(compiled);
+}
+
+static void test_hbac_compiled_user_cached_later(void **state)
+{
+    struct hbac_common_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct hbac_common_test_ctx);
+    struct ipa_hbac_compiled_rules *compiled;
+    struct hbac_eval_req *eval_req;
+    char *fqname;
+    errno_t ret;
+
+    compiled = test_compile(test_ctx, TEST_USER_DN);
+    eval_req = test_eval_req(test_ctx, NULL);
+
+    assert_int_equal(test_evaluate(test_ctx, compiled, eval_req),
+                     HBAC_EVAL_DENY);
+
+    /* The user is cached after the rules were compiled */
+    fqname = sss_create_internal_fqname(test_ctx, TEST_USER,
+                                        test_ctx->tctx->dom->name);
+    assert_non_null(fqname);
+    ret = sysdb_add_user(test_ctx->tctx->dom, fqname, 10001, 10001,
+                         NULL, NULL, "/bin/sh", TEST_USER_DN,
+                         NULL, 0, time(NULL));
+    assert_int_equal(ret, EOK);
+
+    assert_int_equal(test_evaluate(test_ctx, compiled, eval_req),
+                     HBAC_EVAL_ALLOW);
+
+    talloc_free(fqname);
+    talloc_free(eval_req);
+    talloc_free(compiled);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_hbac_compiled_group_cached_later,
+                                        hbac_common_test_setup,
+                                        hbac_common_test_teardown),
+        cmocka_unit_test_setup_teardown(test_hbac_compiled_user_cached_later,
+                                        hbac_common_test_setup,
+                                        hbac_common_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
@@ -0,0 +1,415 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - concurrent extdom requests for object lists
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+/* In order to access opaque types */
+#include "providers/ipa/ipa_s2n_exop.c"
+
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+#include "providers/ipa/ipa_opts.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_ipa_s2n_exop_conf.ldb"
+#define TEST_DOM_NAME "ipa_s2n_exop_test"
+#define TEST_ID_PROVIDER "ipa"
+
+#define TEST_LIST_LEN 5
+
+struct s2n_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct ipa_id_ctx *ipa_ctx;
+    struct sdap_handle *sh;
+    char **list;
+
+    /* list index of the objects in the order their requests were started */
+    size_t started[TEST_LIST_LEN];
+    struct tevent_req *pending[TEST_LIST_LEN];
+    size_t num_started;
+    size_t num_pending;
+    size_t max_pending;
+
+    bool done;
+    errno_t result;
+};
+
+static struct s2n_test_ctx *s2n_test_ctx;
+
+/* The objects of the IPA domain itself are looked up with a regular account
+ * request instead of an extended operation, the mocks below let the test
+ * decide when and how each of them finishes. */
+errno_t get_dp_id_data_for_user_name(TALLOC_CTX *mem_ctx,
+                                     const char *user_name,
+                                     const char *domain_name,
+                                     struct dp_id_data **_ar)
+{
+    struct dp_id_data *ar;
+
+    ar = talloc_zero(mem_ctx, struct dp_id_data);
+    assert_non_null(ar);
+
+    ar->filter_type = BE_FILTER_NAME;
+    ar->filter_value = talloc_strdup(ar, user_name);
+    assert_non_null(ar->filter_value);
+    ar->domain = talloc_strdup(ar, domain_name);
+    assert_non_null(ar->domain);
+
+    *_ar = ar;
+    return EOK;
+}
+
+struct test_acct_state {
+    int dummy;
+};
+
+struct tevent_req *
+ipa_id_get_account_info_send(TALLOC_CTX *memctx, struct tevent_context *ev,
+                             struct ipa_id_ctx *ipa_ctx,
+                             struct dp_id_data *ar)
+{
+    struct test_acct_state *state;
+    struct tevent_req *req;
+    size_t i;
+
+    assert_true(s2n_test_ctx->num_started < TEST_LIST_LEN);
+
+    for (i = 0; s2n_test_ctx->list[i] != NULL; i++) {
+        if (strcmp(s2n_test_ctx->list[i], ar->filter_value) == 0) {
+            break;
+        }
+    }
+    assert_non_null(s2n_test_ctx->list[i]);
+
+    req = tevent_req_create(memctx, &state, struct test_acct_state);
+    assert_non_null(req);
+
+    s2n_test_ctx->started[s2n_test_ctx->num_started] = i;
+    s2n_test_ctx->pending[s2n_test_ctx->num_started] = req;
+    s2n_test_ctx->num_started++;
+    s2n_test_ctx->num_pending++;
+    s2n_test_ctx->max_pending = MAX(s2n_test_ctx->max_pending,
+                                    s2n_test_ctx->num_pending);
+
+    return req;
+}
+
+int ipa_id_get_account_info_recv(struct tevent_req *req, int *dp_error)
+{
+    *dp_error = DP_ERR_OK;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+/* Not used for the objects of the IPA domain */
+errno_t get_dp_id_data_for_sid(TALLOC_CTX *mem_ctx, const char *sid,
+                               const char *domain_name,
+                               struct dp_id_data **_ar)
+{
+    return ENOSYS;
+}
+
+struct tevent_req *ipa_get_ad_override_send(TALLOC_CTX *mem_ctx,
+                                            struct tevent_context *ev,
+                                            struct sdap_id_ctx *sdap_id_ctx,
+                                            struct ipa_options *ipa_options,
+                                            const char *ipa_realm,
+                                            const char *view_name,
+                                            struct dp_id_data *ar)
+{
+    return NULL;
+}
+
+errno_t ipa_get_ad_override_recv(struct tevent_req *req, int *dp_error_out,
+                                 TALLOC_CTX *mem_ctx,
+                                 struct sysdb_attrs **override_attrs)
+{
+    return ENOSYS;
+}
+
+errno_t ad_get_pac_data_from_user_entry(TALLOC_CTX *mem_ctx,
+                                        struct ldb_message *msg,
+                                        struct sss_idmap_ctx *idmap_ctx,
+                                        char **username,
+                                        char **user_sid,
+                                        char **primary_group_sid,
+                                        size_t *num_sids,
+                                        char ***group_sids)
+{
+    return ENOSYS;
+}
+
+static void test_finish_acct(size_t idx, errno_t ret)
+{
+    struct tevent_req *req;
+
+    assert_true(idx < s2n_test_ctx->num_started);
+    req = s2n_test_ctx->pending[idx];
+    assert_non_null(req);
+
+    /* the callback might start the next request */
+    s2n_test_ctx->pending[idx] = NULL;
+    s2n_test_ctx->num_pending--;
+
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+}
+
+static void test_get_list_done(struct tevent_req *req)
+{
+    struct s2n_test_ctx *test_ctx;
+
+    test_ctx = tevent_req_callback_data(req, struct s2n_test_ctx);
+
+    test_ctx->result = ipa_s2n_get_list_recv(req);
+    test_ctx->done = true;
+    talloc_free(req);
+}
+
+static void test_get_list_send(int max_in_flight)
+{
+    struct tevent_req *req;
+    errno_t ret;
+
+    ret = dp_opt_set_int(s2n_test_ctx->ipa_ctx->ipa_options->basic,
+                         IPA_EXTDOM_MAX_IN_FLIGHT, max_in_flight);
+    assert_int_equal(ret, EOK);
+
+    req = ipa_s2n_get_list_send(s2n_test_ctx, s2n_test_ctx->tctx->ev,
+                                s2n_test_ctx->ipa_ctx, s2n_test_ctx->tctx->dom,
+                                s2n_test_ctx->sh, 10, BE_REQ_USER, REQ_FULL,
+                                REQ_INP_NAME, s2n_test_ctx->list, NULL);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_get_list_done, s2n_test_ctx);
+}
+
+static int s2n_test_setup(void **state)
+{
+    struct s2n_test_ctx *test_ctx;
+    struct ipa_options *ipa_options;
+    errno_t ret;
+    size_t i;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct s2n_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER, NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->ipa_ctx = talloc_zero(test_ctx, struct ipa_id_ctx);
+    assert_non_null(test_ctx->ipa_ctx);
+
+    test_ctx->ipa_ctx->sdap_id_ctx = talloc_zero(test_ctx->ipa_ctx,
+                                                 struct sdap_id_ctx);
+    assert_non_null(test_ctx->ipa_ctx->sdap_id_ctx);
+    test_ctx->ipa_ctx->sdap_id_ctx->be = mock_be_ctx(test_ctx->ipa_ctx,
+                                                     test_ctx->tctx);
+
+    ipa_options = talloc_zero(test_ctx->ipa_ctx, struct ipa_options);
+    assert_non_null(ipa_options);
+    ret = dp_copy_defaults(ipa_options, ipa_basic_opts, IPA_OPTS_BASIC,
+                           &ipa_options->basic);
+    assert_int_equal(ret, EOK);
+    test_ctx->ipa_ctx->ipa_options = ipa_options;
+
+    test_ctx->sh = talloc_zero(test_ctx, struct sdap_handle);
+    assert_non_null(test_ctx->sh);
+
+    test_ctx->list = talloc_zero_array(test_ctx, char *, TEST_LIST_LEN + 1);
+    assert_non_null(test_ctx->list);
+    for (i = 0; i < TEST_LIST_LEN; i++) {
+        test_ctx->list[i] = talloc_asprintf(test_ctx->list, "user%zu@%s",
+                                            i + 1, TEST_DOM_NAME);
+        assert_non_null(test_ctx->list[i]);
+    }
+
+    check_leaks_push(test_ctx);
+
+    s2n_test_ctx = test_ctx;
+    *state = test_ctx;
+    return 0;
+}
+
+static int s2n_test_teardown(void **state)
+{
+    struct s2n_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct s2n_test_ctx);
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_zfree(test_ctx);
+    s2n_test_ctx = NULL;
+
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void test_get_list_in_flight_limit(void **state)
+{
+    struct s2n_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct s2n_test_ctx);
+
+    test_get_list_send(2);
+
+    /* only two requests are started at once */
+    assert_int_equal(test_ctx->num_started, 2);
+    assert_int_equal(test_ctx->num_pending, 2);
+    assert_int_equal(test_ctx->started[0], 0);
+    assert_int_equal(test_ctx->started[1], 1);
+
+    /* each finished request starts the next object of the list, regardless
+     * of the order in which the replies arrive */
+    test_finish_acct(1, EOK);
+    assert_int_equal(test_ctx->num_started, 3);
+    assert_int_equal(test_ctx->started[2], 2);
+
+    test_finish_acct(0, EOK);
+    assert_int_equal(test_ctx->num_started, 4);
+    assert_int_equal(test_ctx->started[3], 3);
+
+    test_finish_acct(3, EOK);
+    assert_int_equal(test_ctx->num_started, 5);
+    assert_int_equal(test_ctx->started[4], 4);
+
+    /* the list is exhausted */
+    test_finish_acct(2, EOK);
+    assert_int_equal(test_ctx->num_started, 5);
+    assert_int_equal(test_ctx->num_pending, 1);
+    assert_false(test_ctx->done);
+
+    test_finish_acct(4, EOK);
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->result, EOK);
+    assert_int_equal(test_ctx->max_pending, 2);
+}
+
+static void test_get_list_in_order(void **state)
+{
+    struct s2n_test_ctx *test_ctx;
+    size_t i;
+
+    test_ctx = talloc_get_type_abort(*state, struct s2n_test_ctx);
+
+    /* with a single request in flight the objects are resolved one by one
+     * in the order of the list */
+    test_get_list_send(1);
+
+    for (i = 0; i < TEST_LIST_LEN; i++) {
+        assert_int_equal(test_ctx->num_started, i + 1);
+        assert_int_equal(test_ctx->num_pending, 1);
+        assert_int_equal(test_ctx->started[i], i);
+        assert_false(test_ctx->done);
+
+        test_finish_acct(i, EOK);
+    }
+
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->result, EOK);
+    assert_int_equal(test_ctx->max_pending, 1);
+}
+
+static void test_get_list_first_error(void **state)
+{
+    struct s2n_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type_abort(*state, struct s2n_test_ctx);
+
+    test_get_list_send(2);
+    assert_int_equal(test_ctx->num_started, 2);
+
+    /* no new request is started after the first error */
+    test_finish_acct(0, EIO);
+    assert_int_equal(test_ctx->num_started, 2);
+    assert_false(test_ctx->done);
+
+    /* the request fails once the pending one has finished, a later error
+     * does not replace the first one */
+    test_finish_acct(1, ENOENT);
+    assert_int_equal(test_ctx->num_started, 2);
+    assert_true(test_ctx->done);
+    assert_int_equal(test_ctx->result, EIO);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_get_list_in_flight_limit,
+                                        s2n_test_setup,
+                                        s2n_test_teardown),
+        cmocka_unit_test_setup_teardown(test_get_list_in_order,
+                                        s2n_test_setup,
+                                        s2n_test_teardown),
+        cmocka_unit_test_setup_teardown(test_get_list_first_error,
+                                        s2n_test_setup,
+                                        s2n_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old DB to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+
+    return rv;
+}
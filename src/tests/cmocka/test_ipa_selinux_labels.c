@@ -0,0 +1,255 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - SELinux labels remembered by the IPA back end
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <popt.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "providers/ipa/ipa_selinux_labels.h"
+
+#define TEST_USER "user1@ipa.example.com"
+#define TEST_SEUSER "staff_u"
+#define TEST_MLS "s0-s0:c0.c1023"
+
+int __wrap_getseuserbyname(const char *name, char **r_seuser, char **r_level)
+{
+    const char *seuser;
+    const char *level;
+
+    check_expected(name);
+    seuser = sss_mock_ptr_type(const char *);
+    level = sss_mock_ptr_type(const char *);
+
+    *r_seuser = strdup(seuser);
+    *r_level = strdup(level);
+    if (*r_seuser == NULL || *r_level == NULL) {
+        free(*r_seuser);
+        free(*r_level);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void mock_seuser(const char *name, const char *seuser,
+                        const char *level)
+{
+    expect_string(__wrap_getseuserbyname, name, name);
+    will_return(__wrap_getseuserbyname, seuser);
+    will_return(__wrap_getseuserbyname, level);
+}
+
+struct labels_test_ctx {
+    hash_table_t *labels;
+};
+
+static int labels_test_setup(void **state)
+{
+    struct labels_test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct labels_test_ctx);
+    assert_non_null(test_ctx);
+
+    ret = sss_hash_create(test_ctx, 0, &test_ctx->labels);
+    assert_int_equal(ret, EOK);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int labels_test_teardown(void **state)
+{
+    struct labels_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct labels_test_ctx);
+
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void test_label_unknown_user(void **state)
+{
+    struct labels_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct labels_test_ctx);
+
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                          TEST_SEUSER, TEST_MLS));
+}
+
+static void test_label_unchanged(void **state)
+{
+    struct labels_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct labels_test_ctx);
+
+    ipa_selinux_label_store(test_ctx->labels, TEST_USER,
+                            TEST_SEUSER, TEST_MLS);
+
+    mock_seuser(TEST_USER, TEST_SEUSER, TEST_MLS);
+    assert_true(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                         TEST_SEUSER, TEST_MLS));
+
+    /* The rules resolve to another label, the system is not asked */
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                          "user_u", TEST_MLS));
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                          TEST_SEUSER, "s0"));
+}
+
+static void test_label_changed_on_system(void **state)
+{
+    struct labels_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct labels_test_ctx);
+
+    ipa_selinux_label_store(test_ctx->labels, TEST_USER,
+                            TEST_SEUSER, TEST_MLS);
+
+    /* The mapping of the user was changed with semanage */
+    mock_seuser(TEST_USER, "user_u", "s0");
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                          TEST_SEUSER, TEST_MLS));
+
+    /* The label is forgotten until selinux_child sets it again */
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                          TEST_SEUSER, TEST_MLS));
+}
+
+static void test_label_default(void **state)
+{
+    struct labels_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct labels_test_ctx);
+
+    /* An empty SELinux user removes the mapping of the user */
+    ipa_selinux_label_store(test_ctx->labels, TEST_USER, "", TEST_MLS);
+
+    mock_seuser(TEST_USER, "unconfined_u", TEST_MLS);
+    mock_seuser("__default__", "unconfined_u", TEST_MLS);
+    assert_true(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                         "", TEST_MLS));
+
+    /* A mapping for the user was added on the system */
+    mock_seuser(TEST_USER, TEST_SEUSER, TEST_MLS);
+    mock_seuser("__default__", "unconfined_u", TEST_MLS);
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                          "", TEST_MLS));
+}
+
+static void test_label_removed(void **state)
+{
+    struct labels_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct labels_test_ctx);
+
+    ipa_selinux_label_store(test_ctx->labels, TEST_USER,
+                            TEST_SEUSER, TEST_MLS);
+    ipa_selinux_label_remove(test_ctx->labels, TEST_USER);
+
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, TEST_USER,
+                                          TEST_SEUSER, TEST_MLS));
+}
+
+static void test_labels_bounded(void **state)
+{
+    struct labels_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct labels_test_ctx);
+    char *username;
+    int i;
+
+    for (i = 0; i <= IPA_SELINUX_MAX_LABELS; i++) {
+        username = talloc_asprintf(test_ctx, "user%d", i);
+        assert_non_null(username);
+        ipa_selinux_label_store(test_ctx->labels, username,
+                                TEST_SEUSER, TEST_MLS);
+        talloc_free(username);
+    }
+
+    assert_int_equal(hash_count(test_ctx->labels), IPA_SELINUX_MAX_LABELS);
+
+    /* The last user is not remembered */
+    username = talloc_asprintf(test_ctx, "user%d", IPA_SELINUX_MAX_LABELS);
+    assert_non_null(username);
+    assert_false(ipa_selinux_label_is_set(test_ctx->labels, username,
+                                          TEST_SEUSER, TEST_MLS));
+
+    /* A user already known can still be updated */
+    ipa_selinux_label_store(test_ctx->labels, "user0", "user_u", "s0");
+    mock_seuser("user0", "user_u", "s0");
+    assert_true(ipa_selinux_label_is_set(test_ctx->labels, "user0",
+                                         "user_u", "s0"));
+
+    talloc_free(username);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_label_unknown_user,
+                                        labels_test_setup,
+                                        labels_test_teardown),
+        cmocka_unit_test_setup_teardown(test_label_unchanged,
+                                        labels_test_setup,
+                                        labels_test_teardown),
+        cmocka_unit_test_setup_teardown(test_label_changed_on_system,
+                                        labels_test_setup,
+                                        labels_test_teardown),
+        cmocka_unit_test_setup_teardown(test_label_default,
+                                        labels_test_setup,
+                                        labels_test_teardown),
+        cmocka_unit_test_setup_teardown(test_label_removed,
+                                        labels_test_setup,
+                                        labels_test_teardown),
+        cmocka_unit_test_setup_teardown(test_labels_bounded,
+                                        labels_test_setup,
+                                        labels_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
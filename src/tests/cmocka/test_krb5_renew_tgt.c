@@ -0,0 +1,445 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests: Kerberos TGT renewal scheduler tests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <security/pam_modules.h>
+
+/* In order to access opaque types */
+#include "providers/krb5/krb5_renew_tgt.c"
+
+#include "providers/krb5/krb5_opts.h"
+#include "tests/cmocka/common_mock.h"
+#include "tests/cmocka/common_mock_be.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_krb5_renew_tgt_conf.ldb"
+#define TEST_DOM_NAME "krb5_renew_tgt_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_RENEW_INTERVAL 60
+
+struct renew_tgt_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct be_ctx *be_ctx;
+    struct krb5_ctx *krb5_ctx;
+
+    int num_expected;
+    int num_finished;
+    int num_running;
+    int max_running;
+};
+
+/* Mock the backend and the krb5_child requests so we don't have to bring the
+ * whole data provider into this test. */
+
+bool be_is_offline(struct be_ctx *ctx)
+{
+    return ctx->offline;
+}
+
+int be_add_online_cb(TALLOC_CTX *mem_ctx,
+                     struct be_ctx *ctx,
+                     be_callback_t cb,
+                     void *pvt,
+                     struct be_cb **online_cb)
+{
+    return ERR_OK;
+}
+
+int be_add_offline_cb(TALLOC_CTX *mem_ctx,
+                      struct be_ctx *ctx,
+                      be_callback_t cb,
+                      void *pvt,
+                      struct be_cb **offline_cb)
+{
+    return ERR_OK;
+}
+
+errno_t find_or_guess_upn(TALLOC_CTX *mem_ctx, struct ldb_message *msg,
+                          struct krb5_ctx *krb5_ctx,
+                          struct sss_domain_info *dom, const char *user,
+                          const char *user_dom, char **_upn)
+{
+    return ENOENT;
+}
+
+errno_t get_ccache_file_data(const char *ccache_file, const char *client_name,
+                             struct tgt_times *tgtt)
+{
+    return ENOENT;
+}
+
+struct krb5_mocked_renew_state {
+    struct renew_tgt_test_ctx *test_ctx;
+    int pam_status;
+};
+
+static void krb5_mocked_renew_done(struct tevent_context *ev,
+                                   struct tevent_timer *tt,
+                                   struct timeval tv,
+                                   void *pvt);
+
+struct tevent_req *krb5_auth_queue_send(TALLOC_CTX *mem_ctx,
+                                        struct tevent_context *ev,
+                                        struct be_ctx *be_ctx,
+                                        struct pam_data *pd,
+                                        struct krb5_ctx *krb5_ctx)
+{
+    struct krb5_mocked_renew_state *state;
+    struct renew_tgt_stats stats;
+    struct tevent_req *req;
+    struct tevent_timer *tt;
+    const char *user;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct krb5_mocked_renew_state);
+    assert_non_null(req);
+
+    state->test_ctx = sss_mock_ptr_type(struct renew_tgt_test_ctx *);
+    user = sss_mock_ptr_type(const char *);
+    state->pam_status = sss_mock_type(int);
+
+    assert_int_equal(pd->cmd, SSS_CMD_RENEW);
+    if (user != NULL) {
+        assert_string_equal(pd->user, user);
+    }
+
+    ret = get_renew_tgt_stats(krb5_ctx, &stats);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(stats.num_running, state->test_ctx->num_running);
+
+    state->test_ctx->num_running++;
+    state->test_ctx->max_running = MAX(state->test_ctx->max_running,
+                                       state->test_ctx->num_running);
+
+    tt = tevent_add_timer(ev, req, tevent_timeval_current_ofs(0, 1000),
+                          krb5_mocked_renew_done, req);
+    assert_non_null(tt);
+
+    return req;
+}
+
+static void krb5_mocked_renew_done(struct tevent_context *ev,
+                                   struct tevent_timer *tt,
+                                   struct timeval tv,
+                                   void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+
+    tevent_req_done(req);
+}
+
+int krb5_auth_queue_recv(struct tevent_req *req,
+                         int *_pam_status,
+                         int *_dp_err)
+{
+    struct krb5_mocked_renew_state *state;
+
+    state = tevent_req_data(req, struct krb5_mocked_renew_state);
+
+    state->test_ctx->num_running--;
+    state->test_ctx->num_finished++;
+    if (state->test_ctx->num_finished == state->test_ctx->num_expected) {
+        test_ev_done(state->test_ctx->tctx, EOK);
+    }
+
+    *_pam_status = state->pam_status;
+    *_dp_err = DP_ERR_OK;
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+    return EOK;
+}
+
+static void mock_renewal(struct renew_tgt_test_ctx *test_ctx,
+                         const char *user,
+                         int pam_status)
+{
+    will_return(krb5_auth_queue_send, test_ctx);
+    will_return(krb5_auth_queue_send, user);
+    will_return(krb5_auth_queue_send, pam_status);
+    test_ctx->num_expected++;
+}
+
+static void add_tgt(struct renew_tgt_test_ctx *test_ctx,
+                    const char *user,
+                    time_t starttime,
+                    time_t endtime)
+{
+    struct tgt_times tgtt;
+    struct pam_data pd;
+    char *upn;
+    char *ccfile;
+    errno_t ret;
+
+    upn = talloc_asprintf(test_ctx, "%s@EXAMPLE.COM", user);
+    assert_non_null(upn);
+    ccfile = talloc_asprintf(test_ctx, "FILE:/tmp/krb5cc_%s", user);
+    assert_non_null(ccfile);
+
+    memset(&tgtt, 0, sizeof(tgtt));
+    tgtt.starttime = starttime;
+    tgtt.endtime = endtime;
+    tgtt.renew_till = endtime + 86400;
+
+    memset(&pd, 0, sizeof(pd));
+    pd.cmd = SSS_PAM_AUTHENTICATE;
+    pd.user = discard_const(user);
+
+    ret = add_tgt_to_renew_table(test_ctx->krb5_ctx, ccfile, &tgtt, &pd, upn);
+    assert_int_equal(ret, EOK);
+}
+
+static int renew_tgt_test_setup(void **state, int max_parallel)
+{
+    struct renew_tgt_test_ctx *test_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_zero(NULL, struct renew_tgt_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                         NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
+    assert_non_null(test_ctx->be_ctx);
+
+    test_ctx->krb5_ctx = talloc_zero(test_ctx, struct krb5_ctx);
+    assert_non_null(test_ctx->krb5_ctx);
+
+    ret = dp_copy_defaults(test_ctx->krb5_ctx, default_krb5_opts, KRB5_OPTS,
+                           &test_ctx->krb5_ctx->opts);
+    assert_int_equal(ret, EOK);
+
+    ret = dp_opt_set_int(test_ctx->krb5_ctx->opts, KRB5_RENEW_MAX_PARALLEL,
+                         max_parallel);
+    assert_int_equal(ret, EOK);
+
+    ret = init_renew_tgt(test_ctx->krb5_ctx, test_ctx->be_ctx,
+                         test_ctx->tctx->ev, TEST_RENEW_INTERVAL);
+    assert_int_equal(ret, EOK);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int renew_tgt_test_setup_serial(void **state)
+{
+    return renew_tgt_test_setup(state, 1);
+}
+
+static int renew_tgt_test_setup_parallel(void **state)
+{
+    return renew_tgt_test_setup(state, 3);
+}
+
+static int renew_tgt_test_teardown(void **state)
+{
+    struct renew_tgt_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct renew_tgt_test_ctx);
+
+    talloc_free(test_ctx);
+    return 0;
+}
+
+static void test_renew_tgt_order(void **state)
+{
+    struct renew_tgt_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct renew_tgt_test_ctx);
+    struct renew_tgt_stats stats;
+    time_t now = time(NULL);
+    errno_t ret;
+
+    /* With the default threshold of 50% the renewal times are now - 400,
+     * now - 100 and now - 200. */
+    add_tgt(test_ctx, "user_a", now - 1000, now + 200);
+    add_tgt(test_ctx, "user_b", now - 400, now + 200);
+    add_tgt(test_ctx, "user_c", now - 600, now + 200);
+
+    ret = get_renew_tgt_stats(test_ctx->krb5_ctx, &stats);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(stats.num_queued, 3);
+    assert_int_equal(stats.num_waiting, 3);
+
+    mock_renewal(test_ctx, "user_a", PAM_SUCCESS);
+    mock_renewal(test_ctx, "user_c", PAM_SUCCESS);
+    mock_renewal(test_ctx, "user_b", PAM_SUCCESS);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->max_running, 1);
+
+    ret = get_renew_tgt_stats(test_ctx->krb5_ctx, &stats);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(stats.num_queued, 0);
+    assert_int_equal(stats.num_running, 0);
+    assert_int_equal(stats.num_renewed, 3);
+    assert_int_equal(stats.num_failed, 0);
+    assert_true(stats.max_delay >= 400);
+}
+
+static void test_renew_tgt_max_parallel(void **state)
+{
+    struct renew_tgt_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct renew_tgt_test_ctx);
+    struct renew_tgt_stats stats;
+    time_t now = time(NULL);
+    char *user;
+    errno_t ret;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        user = talloc_asprintf(test_ctx, "user_%d", i);
+        assert_non_null(user);
+        add_tgt(test_ctx, user, now - 1000 + i, now + 200);
+        mock_renewal(test_ctx, NULL, PAM_SUCCESS);
+    }
+
+    /* Not due yet */
+    add_tgt(test_ctx, "user_future", now, now + 3600);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->max_running, 3);
+
+    ret = get_renew_tgt_stats(test_ctx->krb5_ctx, &stats);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(stats.num_queued, 1);
+    assert_int_equal(stats.num_waiting, 0);
+    assert_int_equal(stats.num_renewed, 10);
+
+    /* The statistics are logged by the scheduling passes, at most once per
+     * renewal interval. */
+    assert_true(test_ctx->krb5_ctx->renew_tgt_ctx->stats_logged_at >= now);
+    assert_true(test_ctx->krb5_ctx->renew_tgt_ctx->stats_logged_at
+                    < now + TEST_RENEW_INTERVAL);
+}
+
+static void test_renew_tgt_retry(void **state)
+{
+    struct renew_tgt_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct renew_tgt_test_ctx);
+    struct renew_tgt_stats stats;
+    time_t now = time(NULL);
+    errno_t ret;
+
+    add_tgt(test_ctx, "user_offline", now - 1000, now + 200);
+    add_tgt(test_ctx, "user_failed", now - 800, now + 200);
+
+    mock_renewal(test_ctx, "user_offline", PAM_AUTHINFO_UNAVAIL);
+    mock_renewal(test_ctx, "user_failed", PAM_SYSTEM_ERR);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    /* The first one is retried after TEST_RENEW_INTERVAL, the second one is
+     * dropped. */
+    ret = get_renew_tgt_stats(test_ctx->krb5_ctx, &stats);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(stats.num_queued, 1);
+    assert_int_equal(stats.num_waiting, 0);
+    assert_int_equal(stats.num_renewed, 0);
+    assert_int_equal(stats.num_failed, 2);
+}
+
+static void test_renew_tgt_offline(void **state)
+{
+    struct renew_tgt_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct renew_tgt_test_ctx);
+    struct renew_tgt_stats stats;
+    time_t now = time(NULL);
+    errno_t ret;
+
+    test_ctx->be_ctx->offline = true;
+
+    add_tgt(test_ctx, "user_a", now - 1000, now + 200);
+
+    /* Let the timer fire, nothing may be started while offline. */
+    ret = tevent_loop_once(test_ctx->tctx->ev);
+    assert_int_equal(ret, 0);
+
+    ret = get_renew_tgt_stats(test_ctx->krb5_ctx, &stats);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(stats.num_queued, 1);
+    assert_int_equal(stats.num_waiting, 1);
+    assert_int_equal(stats.num_running, 0);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_renew_tgt_order,
+                                        renew_tgt_test_setup_serial,
+                                        renew_tgt_test_teardown),
+        cmocka_unit_test_setup_teardown(test_renew_tgt_max_parallel,
+                                        renew_tgt_test_setup_parallel,
+                                        renew_tgt_test_teardown),
+        cmocka_unit_test_setup_teardown(test_renew_tgt_retry,
+                                        renew_tgt_test_setup_serial,
+                                        renew_tgt_test_teardown),
+        cmocka_unit_test_setup_teardown(test_renew_tgt_offline,
+                                        renew_tgt_test_setup_serial,
+                                        renew_tgt_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old DB to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    }
+    return rv;
+}
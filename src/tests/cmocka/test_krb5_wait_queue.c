@@ -27,6 +27,7 @@
 #include "util/util.h"
 #include "providers/krb5/krb5_common.h"
 #include "providers/krb5/krb5_auth.h"
+#include "providers/krb5/krb5_opts.h"
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_be.h"
 
@@ -129,6 +130,7 @@ struct test_krb5_wait_queue {
 static int test_krb5_wait_queue_setup(void **state)
 {
     struct test_krb5_wait_queue *test_ctx;
+    errno_t ret;
 
     test_ctx = talloc_zero(global_talloc_context,
                            struct test_krb5_wait_queue);
@@ -146,6 +148,10 @@ static int test_krb5_wait_queue_setup(void **state)
     test_ctx->krb5_ctx = talloc_zero(test_ctx, struct krb5_ctx);
     assert_non_null(test_ctx->krb5_ctx);
 
+    ret = dp_copy_options(test_ctx->krb5_ctx, default_krb5_opts, KRB5_OPTS,
+                          &test_ctx->krb5_ctx->opts);
+    assert_int_equal(ret, EOK);
+
     *state = test_ctx;
     return 0;
 }
@@ -313,6 +319,218 @@ static void test_krb5_wait_queue_fail_odd_done(struct tevent_req *req)
     }
 }
 
+struct test_krb5_wait_req {
+    struct test_krb5_wait_queue *test_ctx;
+    int exp_ret;
+    int exp_pam_status;
+};
+
+static void test_krb5_wait_queue_shared_done(struct tevent_req *req);
+
+static struct pam_data *
+test_krb5_wait_queue_shared_pd(struct test_krb5_wait_queue *test_ctx,
+                               uint32_t cli_pid)
+{
+    struct pam_data *pd;
+
+    pd = talloc_zero(test_ctx, struct pam_data);
+    assert_non_null(pd);
+    pd->cmd = SSS_PAM_AUTHENTICATE;
+    pd->user = discard_const("krb5_user");
+    pd->cli_pid = cli_pid;
+    pd->authtok = sss_authtok_new(pd);
+    assert_non_null(pd->authtok);
+
+    return pd;
+}
+
+static void test_krb5_wait_queue_shared_send_pd(struct test_krb5_wait_queue *test_ctx,
+                                                struct pam_data *pd,
+                                                int exp_ret,
+                                                int exp_pam_status)
+{
+    struct tevent_req *req;
+    struct test_krb5_wait_req *wait_req;
+
+    wait_req = talloc_zero(test_ctx, struct test_krb5_wait_req);
+    assert_non_null(wait_req);
+    wait_req->test_ctx = test_ctx;
+    wait_req->exp_ret = exp_ret;
+    wait_req->exp_pam_status = exp_pam_status;
+
+    req = krb5_auth_queue_send(test_ctx,
+                               test_ctx->tctx->ev,
+                               test_ctx->be_ctx,
+                               pd,
+                               test_ctx->krb5_ctx);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_krb5_wait_queue_shared_done, wait_req);
+
+    test_ctx->num_auths++;
+}
+
+static void test_krb5_wait_queue_shared_send(struct test_krb5_wait_queue *test_ctx,
+                                             const char *password,
+                                             uint32_t cli_pid,
+                                             int exp_ret,
+                                             int exp_pam_status)
+{
+    struct pam_data *pd;
+    errno_t ret;
+
+    pd = test_krb5_wait_queue_shared_pd(test_ctx, cli_pid);
+    ret = sss_authtok_set_password(pd->authtok, password, 0);
+    assert_int_equal(ret, EOK);
+
+    test_krb5_wait_queue_shared_send_pd(test_ctx, pd, exp_ret, exp_pam_status);
+}
+
+static void test_krb5_wait_queue_shared_done(struct tevent_req *req)
+{
+    struct test_krb5_wait_req *wait_req = \
+        tevent_req_callback_data(req, struct test_krb5_wait_req);
+    struct test_krb5_wait_queue *test_ctx = wait_req->test_ctx;
+    errno_t ret;
+    int pam_status;
+    int dp_err;
+
+    ret = krb5_auth_queue_recv(req, &pam_status, &dp_err);
+    talloc_free(req);
+    assert_int_equal(ret, wait_req->exp_ret);
+    if (ret == EOK) {
+        assert_int_equal(pam_status, wait_req->exp_pam_status);
+    }
+    talloc_free(wait_req);
+
+    test_ctx->num_finished_auths++;
+
+    if (test_ctx->num_finished_auths == test_ctx->num_auths) {
+        test_ev_done(test_ctx->tctx, EOK);
+    }
+}
+
+static void test_krb5_wait_queue_shared(void **state)
+{
+    errno_t ret;
+    int i;
+    struct test_krb5_wait_queue *test_ctx =
+        talloc_get_type(*state, struct test_krb5_wait_queue);
+
+    /* Only the first request with the same password and the one with a
+     * different password run, cmocka fails if a mock is left over. */
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_SUCCESS, 0);
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_AUTH_ERR, 0);
+
+    for (i = 0; i < 5; i++) {
+        test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 0, EOK,
+                                         PAM_SUCCESS);
+    }
+    test_krb5_wait_queue_shared_send(test_ctx, "Wrong", 0, EOK,
+                                     PAM_AUTH_ERR);
+    for (i = 0; i < 5; i++) {
+        test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 0, EOK,
+                                         PAM_SUCCESS);
+    }
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_krb5_wait_queue_shared_fail(void **state)
+{
+    errno_t ret;
+    struct test_krb5_wait_queue *test_ctx =
+        talloc_get_type(*state, struct test_krb5_wait_queue);
+
+    /* If the running request fails the waiting ones run on their own */
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, EIO, PAM_SUCCESS, 0);
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_SUCCESS, 0);
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_SUCCESS, 0);
+
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 0, EIO,
+                                     PAM_SUCCESS);
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 0, EOK,
+                                     PAM_SUCCESS);
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 0, EOK,
+                                     PAM_SUCCESS);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_krb5_wait_queue_shared_pid_ccache(void **state)
+{
+    errno_t ret;
+    struct test_krb5_wait_queue *test_ctx =
+        talloc_get_type(*state, struct test_krb5_wait_queue);
+
+    ret = dp_opt_set_string(test_ctx->krb5_ctx->opts, KRB5_CCNAME_TMPL,
+                            "FILE:/tmp/krb5cc_%U_%P");
+    assert_int_equal(ret, EOK);
+
+    /* Each client PID gets a credential cache of its own, only the request
+     * of the same client shares the result */
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_SUCCESS, 0);
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_SUCCESS, 0);
+
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 1000, EOK,
+                                     PAM_SUCCESS);
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 1000, EOK,
+                                     PAM_SUCCESS);
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 1001, EOK,
+                                     PAM_SUCCESS);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_krb5_wait_queue_shared_pid_escaped(void **state)
+{
+    errno_t ret;
+    struct test_krb5_wait_queue *test_ctx =
+        talloc_get_type(*state, struct test_krb5_wait_queue);
+
+    ret = dp_opt_set_string(test_ctx->krb5_ctx->opts, KRB5_CCNAME_TMPL,
+                            "FILE:/tmp/krb5cc_%U_%%P");
+    assert_int_equal(ret, EOK);
+
+    /* '%%P' is not the PID, all requests share the result */
+    test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_SUCCESS, 0);
+
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 1000, EOK,
+                                     PAM_SUCCESS);
+    test_krb5_wait_queue_shared_send(test_ctx, "Secret123", 1001, EOK,
+                                     PAM_SUCCESS);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static void test_krb5_wait_queue_shared_2fa(void **state)
+{
+    errno_t ret;
+    int i;
+    struct pam_data *pd;
+    struct test_krb5_wait_queue *test_ctx =
+        talloc_get_type(*state, struct test_krb5_wait_queue);
+
+    /* A one-time second factor is only valid once, identical tokens must
+     * not share the result */
+    for (i = 0; i < 2; i++) {
+        test_krb5_wait_mock(test_ctx, "krb5_user", 200, 0, PAM_SUCCESS, 0);
+    }
+
+    for (i = 0; i < 2; i++) {
+        pd = test_krb5_wait_queue_shared_pd(test_ctx, 0);
+        ret = sss_authtok_set_2fa(pd->authtok, "Secret123", 0, "123456", 0);
+        assert_int_equal(ret, EOK);
+        test_krb5_wait_queue_shared_send_pd(test_ctx, pd, EOK, PAM_SUCCESS);
+    }
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -338,6 +556,29 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_krb5_wait_queue_fail_odd,
                                         test_krb5_wait_queue_setup,
                                         test_krb5_wait_queue_teardown),
+
+        /* Requests with the same password share the running request */
+        cmocka_unit_test_setup_teardown(test_krb5_wait_queue_shared,
+                                        test_krb5_wait_queue_setup,
+                                        test_krb5_wait_queue_teardown),
+
+        /* Waiting requests run on their own if the running one fails */
+        cmocka_unit_test_setup_teardown(test_krb5_wait_queue_shared_fail,
+                                        test_krb5_wait_queue_setup,
+                                        test_krb5_wait_queue_teardown),
+
+        /* Requests with different credential cache names do not share */
+        cmocka_unit_test_setup_teardown(test_krb5_wait_queue_shared_pid_ccache,
+                                        test_krb5_wait_queue_setup,
+                                        test_krb5_wait_queue_teardown),
+        cmocka_unit_test_setup_teardown(test_krb5_wait_queue_shared_pid_escaped,
+                                        test_krb5_wait_queue_setup,
+                                        test_krb5_wait_queue_teardown),
+
+        /* Tokens with a second factor never share */
+        cmocka_unit_test_setup_teardown(test_krb5_wait_queue_shared_2fa,
+                                        test_krb5_wait_queue_setup,
+                                        test_krb5_wait_queue_teardown),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
@@ -31,6 +31,7 @@
 #include "providers/ldap/sdap.h"
 #include "providers/ldap/sdap_idmap.h"
 #include "providers/ldap/sdap_async_private.h"
+#include "providers/ldap/sdap_range.h"
 #include "providers/ldap/ldap_opts.h"
 
 #define TESTS_PATH "tp_" BASE_FILE_STEM
@@ -587,6 +588,435 @@ static void nested_groups_test_nested_chain_with_error(void **state)
     assert_int_equal(ret, EIO);
 }
 
+static void nested_groups_test_one_group_batched_members(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct sysdb_attrs *rootgroup = NULL;
+    struct tevent_req *req = NULL;
+    TALLOC_CTX *req_mem_ctx = NULL;
+    errno_t ret;
+    const char *users[] = { "cn=user1,"USER_BASE_DN,
+                            "cn=user2,"USER_BASE_DN,
+                            "cn=user3,"USER_BASE_DN,
+                            NULL };
+    const struct sysdb_attrs *batch_reply[3] = { NULL };
+    const struct sysdb_attrs *user2_reply[2] = { NULL };
+    const char * expected[] = { "user1",
+                                "user2",
+                                "user3" };
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    ret = dp_opt_set_int(test_ctx->sdap_opts->basic,
+                         SDAP_NESTED_GROUP_BATCH_SIZE, 50);
+    assert_int_equal(ret, EOK);
+
+    /* mock return values */
+    rootgroup = mock_sysdb_group_rfc2307bis(test_ctx, GROUP_BASE_DN, 1000,
+                                            "rootgroup", users);
+
+    /* single search for all users, user2 is not returned */
+    batch_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2003, "user3");
+    assert_non_null(batch_reply[0]);
+    batch_reply[1] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2001, "user1");
+    assert_non_null(batch_reply[1]);
+    will_return(sdap_get_generic_recv, 2);
+    will_return(sdap_get_generic_recv, batch_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    /* user2 is looked up individually */
+    user2_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2002, "user2");
+    assert_non_null(user2_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user2_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    sss_will_return_always(sdap_has_deref_support, false);
+
+    /* run test, check for memory leaks */
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    req = sdap_nested_group_send(req_mem_ctx, test_ctx->tctx->ev,
+                                 test_ctx->sdap_domain, test_ctx->sdap_opts,
+                                 test_ctx->sdap_handle, rootgroup);
+    assert_non_null(req);
+    tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_zfree(req_mem_ctx);
+
+    /* check return code */
+    assert_int_equal(ret, ERR_OK);
+
+    /* Check the users */
+    assert_int_equal(test_ctx->num_users, N_ELEMENTS(expected));
+    assert_int_equal(test_ctx->num_groups, 1);
+
+    compare_sysdb_string_array_noorder(test_ctx->users,
+                                       expected, N_ELEMENTS(expected));
+}
+
+static void nested_groups_test_cached_members(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct sysdb_attrs *rootgroup = NULL;
+    struct tevent_req *req = NULL;
+    TALLOC_CTX *req_mem_ctx = NULL;
+    errno_t ret;
+    int i;
+    const char *users[] = { "cn=user1,"USER_BASE_DN,
+                            "cn=user2,"USER_BASE_DN,
+                            NULL };
+    /* the DNs are compared case-insensitively */
+    const char *users_upper[] = { "CN=user1,"USER_BASE_DN,
+                                  "CN=user2,"USER_BASE_DN,
+                                  NULL };
+    const struct sysdb_attrs *user1_reply[2] = { NULL };
+    const struct sysdb_attrs *user2_reply[2] = { NULL };
+    const char * expected[] = { "user1",
+                                "user2" };
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    ret = dp_opt_set_int(test_ctx->sdap_opts->basic,
+                         SDAP_NESTED_GROUP_CACHE_TIMEOUT, 60);
+    assert_int_equal(ret, EOK);
+
+    /* only the first run goes to LDAP */
+    user1_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2001, "user1");
+    assert_non_null(user1_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user1_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    user2_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2002, "user2");
+    assert_non_null(user2_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user2_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    sss_will_return_always(sdap_has_deref_support, false);
+
+    for (i = 0; i < 2; i++) {
+        rootgroup = mock_sysdb_group_rfc2307bis(test_ctx, GROUP_BASE_DN, 1000,
+                                                "rootgroup",
+                                                i == 0 ? users : users_upper);
+        assert_non_null(rootgroup);
+
+        /* run test, check for memory leaks */
+        req_mem_ctx = talloc_new(global_talloc_context);
+        assert_non_null(req_mem_ctx);
+        check_leaks_push(req_mem_ctx);
+
+        req = sdap_nested_group_send(req_mem_ctx, test_ctx->tctx->ev,
+                                     test_ctx->sdap_domain,
+                                     test_ctx->sdap_opts,
+                                     test_ctx->sdap_handle, rootgroup);
+        assert_non_null(req);
+        tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+        test_ctx->tctx->done = false;
+        ret = test_ev_loop(test_ctx->tctx);
+        assert_true(check_leaks_pop(req_mem_ctx) == true);
+        talloc_zfree(req_mem_ctx);
+
+        /* check return code */
+        assert_int_equal(ret, ERR_OK);
+
+        /* Check the users */
+        assert_int_equal(test_ctx->num_users, N_ELEMENTS(expected));
+        assert_int_equal(test_ctx->num_groups, 1);
+    }
+
+    compare_sysdb_string_array_noorder(test_ctx->users,
+                                       expected, N_ELEMENTS(expected));
+}
+
+static void nested_groups_test_cached_members_sysdb_valid(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct sysdb_attrs *rootgroup = NULL;
+    struct sysdb_attrs *user_attrs = NULL;
+    struct tevent_req *req = NULL;
+    TALLOC_CTX *req_mem_ctx = NULL;
+    char *fqdn = NULL;
+    errno_t ret;
+    int i;
+    const char *users[] = { "cn=user1,"USER_BASE_DN,
+                            NULL };
+    const struct sysdb_attrs *user1_reply[2] = { NULL };
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    ret = dp_opt_set_int(test_ctx->sdap_opts->basic,
+                         SDAP_NESTED_GROUP_CACHE_TIMEOUT, 60);
+    assert_int_equal(ret, EOK);
+
+    /* only the first run goes to LDAP */
+    user1_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2001, "user1");
+    assert_non_null(user1_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user1_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    sss_will_return_always(sdap_has_deref_support, false);
+
+    for (i = 0; i < 2; i++) {
+        rootgroup = mock_sysdb_group_rfc2307bis(test_ctx, GROUP_BASE_DN, 1000,
+                                                "rootgroup", users);
+        assert_non_null(rootgroup);
+
+        req_mem_ctx = talloc_new(global_talloc_context);
+        assert_non_null(req_mem_ctx);
+        check_leaks_push(req_mem_ctx);
+
+        req = sdap_nested_group_send(req_mem_ctx, test_ctx->tctx->ev,
+                                     test_ctx->sdap_domain,
+                                     test_ctx->sdap_opts,
+                                     test_ctx->sdap_handle, rootgroup);
+        assert_non_null(req);
+        tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+        test_ctx->tctx->done = false;
+        ret = test_ev_loop(test_ctx->tctx);
+        assert_true(check_leaks_pop(req_mem_ctx) == true);
+        talloc_zfree(req_mem_ctx);
+
+        assert_int_equal(ret, ERR_OK);
+
+        if (i == 0) {
+            assert_int_equal(test_ctx->num_users, 1);
+
+            /* the user is now valid in the sysdb */
+            fqdn = sss_create_internal_fqname(test_ctx, "user1",
+                                              test_ctx->tctx->dom->name);
+            assert_non_null(fqdn);
+            user_attrs = sysdb_new_attrs(test_ctx);
+            assert_non_null(user_attrs);
+            ret = sysdb_attrs_add_string(user_attrs, SYSDB_ORIG_DN, users[0]);
+            assert_int_equal(ret, EOK);
+            ret = sysdb_store_user(test_ctx->tctx->dom, fqdn, "*", 2001, 2001,
+                                   "user1", "/home/user1", "/bin/bash",
+                                   users[0], user_attrs, NULL, 1000,
+                                   time(NULL));
+            assert_int_equal(ret, EOK);
+        } else {
+            /* a valid sysdb member is skipped even though it is still
+             * kept in memory */
+            assert_int_equal(test_ctx->num_users, 0);
+        }
+    }
+
+    talloc_free(user_attrs);
+    talloc_free(fqdn);
+}
+
+static const struct sysdb_attrs **
+nested_groups_mock_range(TALLOC_CTX *mem_ctx, const char *member,
+                         uint32_t next_offset)
+{
+    const struct sysdb_attrs **reply = NULL;
+    struct sysdb_attrs *range_entry = NULL;
+    errno_t ret;
+
+    reply = talloc_zero_array(mem_ctx, const struct sysdb_attrs *, 2);
+    assert_non_null(reply);
+
+    range_entry = sysdb_new_attrs(reply);
+    assert_non_null(range_entry);
+    ret = sysdb_attrs_add_string(range_entry, "member", member);
+    assert_int_equal(ret, EOK);
+
+    /* range=<low>-* has no next offset */
+    if (next_offset != 0) {
+        ret = sdap_range_add_pending(range_entry, "member", next_offset);
+        assert_int_equal(ret, EOK);
+    }
+
+    reply[0] = range_entry;
+    will_return(sdap_get_and_parse_generic_recv, 1);
+    will_return(sdap_get_and_parse_generic_recv, reply);
+    will_return(sdap_get_and_parse_generic_recv, ERR_OK);
+
+    return reply;
+}
+
+static void nested_groups_mock_range_end(int num)
+{
+    int i;
+
+    /* ranges requested in parallel past the last one are empty */
+    for (i = 0; i < num; i++) {
+        will_return(sdap_get_and_parse_generic_recv, 0);
+        will_return(sdap_get_and_parse_generic_recv, NULL);
+        will_return(sdap_get_and_parse_generic_recv, ERR_OK);
+    }
+}
+
+static void nested_groups_test_one_group_ranged_members(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct sysdb_attrs *rootgroup = NULL;
+    struct ldb_message_element *el = NULL;
+    struct tevent_req *req = NULL;
+    TALLOC_CTX *req_mem_ctx = NULL;
+    uint32_t offset;
+    errno_t ret;
+    const char *users[] = { "cn=user1,"USER_BASE_DN,
+                            NULL };
+    const struct sysdb_attrs *user1_reply[2] = { NULL };
+    const struct sysdb_attrs *user2_reply[2] = { NULL };
+    const char * expected[] = { "user1",
+                                "user2" };
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    /* only the first member is returned with the group */
+    rootgroup = mock_sysdb_group_rfc2307bis(test_ctx, GROUP_BASE_DN, 1000,
+                                            "rootgroup", users);
+    assert_non_null(rootgroup);
+    ret = sdap_range_add_pending(rootgroup, "member", 1);
+    assert_int_equal(ret, EOK);
+
+    /* member;range=1-1 returns the last member */
+    nested_groups_mock_range(test_ctx, "cn=user2,"USER_BASE_DN, 0);
+    nested_groups_mock_range_end(3);
+
+    user1_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2001, "user1");
+    assert_non_null(user1_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user1_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    user2_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2002, "user2");
+    assert_non_null(user2_reply[0]);
+    will_return(sdap_get_generic_recv, 1);
+    will_return(sdap_get_generic_recv, user2_reply);
+    will_return(sdap_get_generic_recv, ERR_OK);
+
+    sss_will_return_always(sdap_has_deref_support, false);
+
+    /* run test, check for memory leaks */
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    req = sdap_nested_group_send(req_mem_ctx, test_ctx->tctx->ev,
+                                 test_ctx->sdap_domain, test_ctx->sdap_opts,
+                                 test_ctx->sdap_handle, rootgroup);
+    assert_non_null(req);
+    tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_zfree(req_mem_ctx);
+
+    /* check return code */
+    assert_int_equal(ret, ERR_OK);
+
+    /* Check the users */
+    assert_int_equal(test_ctx->num_users, N_ELEMENTS(expected));
+    assert_int_equal(test_ctx->num_groups, 1);
+
+    compare_sysdb_string_array_noorder(test_ctx->users,
+                                       expected, N_ELEMENTS(expected));
+
+    /* the group is saved with all members and without the range marker */
+    ret = sysdb_attrs_get_el_ext(rootgroup, SYSDB_MEMBER, false, &el);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(el->num_values, 2);
+
+    ret = sdap_range_get_pending(rootgroup, "member", &offset);
+    assert_int_equal(ret, ENOENT);
+}
+
+static void nested_groups_test_one_group_ranged_windows(void **state)
+{
+    struct nested_groups_test_ctx *test_ctx = NULL;
+    struct sysdb_attrs *rootgroup = NULL;
+    struct ldb_message_element *el = NULL;
+    struct tevent_req *req = NULL;
+    TALLOC_CTX *req_mem_ctx = NULL;
+    const struct sysdb_attrs **user_reply = NULL;
+    char *member = NULL;
+    char *name = NULL;
+    errno_t ret;
+    unsigned int i;
+    const char *users[] = { "cn=user1,"USER_BASE_DN,
+                            NULL };
+    const char * expected[] = { "user1",
+                                "user2",
+                                "user3",
+                                "user4",
+                                "user5",
+                                "user6" };
+
+    test_ctx = talloc_get_type_abort(*state, struct nested_groups_test_ctx);
+
+    rootgroup = mock_sysdb_group_rfc2307bis(test_ctx, GROUP_BASE_DN, 1000,
+                                            "rootgroup", users);
+    assert_non_null(rootgroup);
+    ret = sdap_range_add_pending(rootgroup, "member", 1);
+    assert_int_equal(ret, EOK);
+
+    /* the first window retrieves member;range=1-1 to member;range=4-4 and
+     * the second one member;range=5-* */
+    for (i = 2; i <= N_ELEMENTS(expected); i++) {
+        member = talloc_asprintf(test_ctx, "cn=user%u,"USER_BASE_DN, i);
+        assert_non_null(member);
+        nested_groups_mock_range(test_ctx, member,
+                                 i < N_ELEMENTS(expected) ? i : 0);
+    }
+    nested_groups_mock_range_end(3);
+
+    /* every member is looked up once */
+    for (i = 1; i <= N_ELEMENTS(expected); i++) {
+        name = talloc_asprintf(test_ctx, "user%u", i);
+        assert_non_null(name);
+        user_reply = talloc_zero_array(test_ctx, const struct sysdb_attrs *, 2);
+        assert_non_null(user_reply);
+        user_reply[0] = mock_sysdb_user(test_ctx, USER_BASE_DN, 2000 + i, name);
+        assert_non_null(user_reply[0]);
+        will_return(sdap_get_generic_recv, 1);
+        will_return(sdap_get_generic_recv, user_reply);
+        will_return(sdap_get_generic_recv, ERR_OK);
+    }
+
+    sss_will_return_always(sdap_has_deref_support, false);
+
+    /* run test, check for memory leaks */
+    req_mem_ctx = talloc_new(global_talloc_context);
+    assert_non_null(req_mem_ctx);
+    check_leaks_push(req_mem_ctx);
+
+    req = sdap_nested_group_send(req_mem_ctx, test_ctx->tctx->ev,
+                                 test_ctx->sdap_domain, test_ctx->sdap_opts,
+                                 test_ctx->sdap_handle, rootgroup);
+    assert_non_null(req);
+    tevent_req_set_callback(req, nested_groups_test_done, test_ctx);
+
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_true(check_leaks_pop(req_mem_ctx) == true);
+    talloc_zfree(req_mem_ctx);
+
+    /* check return code */
+    assert_int_equal(ret, ERR_OK);
+
+    /* Check the users */
+    assert_int_equal(test_ctx->num_users, N_ELEMENTS(expected));
+    assert_int_equal(test_ctx->num_groups, 1);
+
+    compare_sysdb_string_array_noorder(test_ctx->users,
+                                       expected, N_ELEMENTS(expected));
+
+    ret = sysdb_attrs_get_el_ext(rootgroup, SYSDB_MEMBER, false, &el);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(el->num_values, N_ELEMENTS(expected));
+}
+
 static int nested_groups_test_setup(void **state)
 {
     errno_t ret;
@@ -619,6 +1049,14 @@ static int nested_groups_test_setup(void **state)
     test_ctx->sdap_handle = mock_sdap_handle(test_ctx);
     assert_non_null(test_ctx->sdap_handle);
 
+    /* most tests mock the lookup of each member individually */
+    ret = dp_opt_set_int(test_ctx->sdap_opts->basic,
+                         SDAP_NESTED_GROUP_BATCH_SIZE, 0);
+    assert_int_equal(ret, EOK);
+    ret = dp_opt_set_int(test_ctx->sdap_opts->basic,
+                         SDAP_NESTED_GROUP_CACHE_TIMEOUT, 0);
+    assert_int_equal(ret, EOK);
+
     test_ctx->be_ctx = mock_be_ctx(test_ctx, test_ctx->tctx);
     assert_non_null(test_ctx->be_ctx);
 
@@ -1293,6 +1731,11 @@ int main(int argc, const char *argv[])
     const struct CMUnitTest tests[] = {
         new_test(one_group_no_members),
         new_test(one_group_unique_members),
+        new_test(one_group_batched_members),
+        new_test(cached_members),
+        new_test(cached_members_sysdb_valid),
+        new_test(one_group_ranged_members),
+        new_test(one_group_ranged_windows),
         new_test(one_group_dup_users),
         new_test(one_group_unique_group_members),
         new_test(one_group_dup_group_members),
@@ -0,0 +1,441 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests: p11_child OCSP cache tests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <errno.h>
+#include <popt.h>
+#include <sys/stat.h>
+
+#include "util/util.h"
+#include "p11_child/p11_child.h"
+#include "tests/cmocka/common_mock.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CACHE_FILE TESTS_PATH "/ocsp_cache"
+
+#define TEST_CA_DB_MTIME 1000
+#define TEST_CRL_MTIME 2000
+
+#define TEST_DIGEST_LEN 32
+
+/* Stands in for the OCSP responder, it answers with a fixed status and
+ * counts how often it was asked. */
+struct test_responder {
+    bool revoked;
+    time_t next_update_offset;
+    int num_queries;
+};
+
+struct ocsp_cache_test_ctx {
+    struct test_responder responder;
+    uint8_t digest_a[TEST_DIGEST_LEN];
+    uint8_t digest_b[TEST_DIGEST_LEN];
+};
+
+/* Does what do_ocsp() does with the cache, returns EOK if the certificate
+ * is good and EACCES if it is revoked. */
+static errno_t check_cert(struct p11_ocsp_cache *cache,
+                          struct test_responder *responder,
+                          const uint8_t *digest)
+{
+    errno_t ret;
+
+    ret = p11_ocsp_cache_lookup(cache, digest, TEST_DIGEST_LEN);
+    if (ret != ENOENT) {
+        return ret;
+    }
+
+    responder->num_queries++;
+    p11_ocsp_cache_add(cache, digest, TEST_DIGEST_LEN, responder->revoked,
+                       time(NULL) + responder->next_update_offset);
+
+    return responder->revoked ? EACCES : EOK;
+}
+
+static struct p11_ocsp_cache *open_cache_opts(TALLOC_CTX *mem_ctx,
+                                              const char *path,
+                                              time_t ca_db_mtime,
+                                              struct cert_verify_opts *opts)
+{
+    struct p11_ocsp_cache *cache;
+    errno_t ret;
+
+    ret = p11_ocsp_cache_init(mem_ctx, path, ca_db_mtime, TEST_CRL_MTIME,
+                              opts, &cache);
+    assert_int_equal(ret, EOK);
+    assert_non_null(cache);
+
+    return cache;
+}
+
+static struct p11_ocsp_cache *open_cache(TALLOC_CTX *mem_ctx,
+                                         const char *path,
+                                         time_t ca_db_mtime)
+{
+    return open_cache_opts(mem_ctx, path, ca_db_mtime, NULL);
+}
+
+static int ocsp_cache_test_setup(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct ocsp_cache_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->responder.next_update_offset = 600;
+    memset(test_ctx->digest_a, 'a', TEST_DIGEST_LEN);
+    memset(test_ctx->digest_b, 'b', TEST_DIGEST_LEN);
+
+    unlink(TEST_CACHE_FILE);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+
+    return 0;
+}
+
+static int ocsp_cache_test_teardown(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    unlink(TEST_CACHE_FILE);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+
+    return 0;
+}
+
+static void test_ocsp_cache_memory(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+    struct p11_ocsp_cache *cache;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    cache = open_cache(test_ctx, NULL, TEST_CA_DB_MTIME);
+
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 1);
+
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 1);
+
+    test_ctx->responder.revoked = true;
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+
+    /* Nothing must be written without a path. */
+    assert_int_equal(access(TEST_CACHE_FILE, F_OK), -1);
+
+    talloc_free(cache);
+}
+
+static void test_ocsp_cache_file(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+    struct p11_ocsp_cache *cache;
+    struct stat st;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    test_ctx->responder.revoked = true;
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+    talloc_free(cache);
+
+    assert_int_equal(stat(TEST_CACHE_FILE, &st), 0);
+    assert_int_equal(st.st_mode & (S_IRWXG | S_IRWXO), 0);
+
+    /* A new p11_child uses the results of the previous one and does not
+     * have to ask the responder again. */
+    test_ctx->responder.revoked = false;
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+    talloc_free(cache);
+}
+
+static void test_ocsp_cache_shared(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+    struct p11_ocsp_cache *cache1;
+    struct p11_ocsp_cache *cache2;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    /* Two p11_child processes running at the same time, each one adds an
+     * entry and none of them must get lost. */
+    cache1 = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    cache2 = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+
+    ret = check_cert(cache1, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    ret = check_cert(cache2, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+
+    talloc_free(cache1);
+    talloc_free(cache2);
+
+    cache1 = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache1, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    ret = check_cert(cache1, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+    talloc_free(cache1);
+}
+
+static void test_ocsp_cache_next_update(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+    struct p11_ocsp_cache *cache;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    /* A response which is already outdated is not cached at all. */
+    test_ctx->responder.next_update_offset = -10;
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+
+    test_ctx->responder.next_update_offset = 2;
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EOK);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 3);
+    talloc_free(cache);
+
+    sleep(3);
+
+    /* After nextUpdate the responder must be asked again, neither the memory
+     * nor the file cache may return the old result. */
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 4);
+    talloc_free(cache);
+}
+
+static void test_ocsp_cache_ca_db_changed(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+    struct p11_ocsp_cache *cache;
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    talloc_free(cache);
+
+    /* The cached responses were verified with a different CA DB. */
+    test_ctx->responder.revoked = true;
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME + 1);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+    talloc_free(cache);
+
+    /* Without the modification time of the CA DB the file is not used. */
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, 0);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 3);
+    talloc_free(cache);
+}
+
+static void test_ocsp_cache_opts_changed(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+    struct p11_ocsp_cache *cache;
+    struct cert_verify_opts opts = { 0 };
+    errno_t ret;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    opts.ocsp_dgst = CKM_SHA_1;
+    cache = open_cache_opts(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME,
+                            &opts);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    talloc_free(cache);
+
+    /* The same options use the stored result. */
+    cache = open_cache_opts(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME,
+                            &opts);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 1);
+    talloc_free(cache);
+
+    /* The cached response was not checked with this responder. */
+    test_ctx->responder.revoked = true;
+    opts.ocsp_default_responder = discard_const("http://ocsp.example.com");
+    opts.ocsp_default_responder_signing_cert = discard_const("ocsp-signer");
+    cache = open_cache_opts(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME,
+                            &opts);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+    talloc_free(cache);
+
+    /* Nor with this digest. */
+    opts.ocsp_dgst = CKM_SHA256;
+    cache = open_cache_opts(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME,
+                            &opts);
+    test_ctx->responder.revoked = false;
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(test_ctx->responder.num_queries, 3);
+    talloc_free(cache);
+}
+
+static void test_ocsp_cache_untrusted_file(void **state)
+{
+    struct ocsp_cache_test_ctx *test_ctx;
+    struct p11_ocsp_cache *cache;
+    errno_t ret;
+    FILE *f;
+
+    test_ctx = talloc_get_type(*state, struct ocsp_cache_test_ctx);
+
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EOK);
+    talloc_free(cache);
+
+    /* Everybody could have put a good status into the file. */
+    assert_int_equal(chmod(TEST_CACHE_FILE, 0666), 0);
+    test_ctx->responder.revoked = true;
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_a);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 2);
+    talloc_free(cache);
+
+    /* A damaged file is ignored and replaced. */
+    f = fopen(TEST_CACHE_FILE, "w");
+    assert_non_null(f);
+    fprintf(f, "this is not an OCSP cache");
+    fclose(f);
+
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 3);
+    talloc_free(cache);
+
+    cache = open_cache(test_ctx, TEST_CACHE_FILE, TEST_CA_DB_MTIME);
+    ret = check_cert(cache, &test_ctx->responder, test_ctx->digest_b);
+    assert_int_equal(ret, EACCES);
+    assert_int_equal(test_ctx->responder.num_queries, 3);
+    talloc_free(cache);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_ocsp_cache_memory,
+                                        ocsp_cache_test_setup,
+                                        ocsp_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ocsp_cache_file,
+                                        ocsp_cache_test_setup,
+                                        ocsp_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ocsp_cache_shared,
+                                        ocsp_cache_test_setup,
+                                        ocsp_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ocsp_cache_next_update,
+                                        ocsp_cache_test_setup,
+                                        ocsp_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ocsp_cache_ca_db_changed,
+                                        ocsp_cache_test_setup,
+                                        ocsp_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ocsp_cache_opts_changed,
+                                        ocsp_cache_test_setup,
+                                        ocsp_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_ocsp_cache_untrusted_file,
+                                        ocsp_cache_test_setup,
+                                        ocsp_cache_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+    if (rv == 0) {
+        rmdir(TESTS_PATH);
+    }
+    return rv;
+}
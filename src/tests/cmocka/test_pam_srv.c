@@ -23,6 +23,7 @@
 #include <security/pam_modules.h>
 #include <popt.h>
 #include <stdlib.h> /* putenv */
+#include <sys/time.h>
 
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
@@ -93,6 +94,9 @@ struct pam_test_ctx {
 /* Must be global because it is needed in some wrappers */
 struct pam_test_ctx *pam_test_ctx;
 
+/* Set with --p11-worker-bench */
+static int p11_worker_bench;
+
 struct pam_ctx *mock_pctx(TALLOC_CTX *mem_ctx)
 {
     struct pam_ctx *pctx;
@@ -317,6 +321,19 @@ static int pam_test_setup_no_verification(void **state)
     pam_test_setup_common();
     return 0;
 }
+
+static int pam_test_setup_p11_worker(void **state)
+{
+    int ret;
+
+    pam_test_setup(state);
+
+    ret = p11_child_worker_init(pam_test_ctx->pctx, pam_test_ctx->tctx->ev,
+                                &pam_test_ctx->pctx->p11_worker);
+    assert_int_equal(ret, EOK);
+
+    return 0;
+}
 #endif /* HAVE_TEST_CA */
 
 static int pam_cached_test_setup(void **state)
@@ -1177,6 +1194,79 @@ void test_pam_open_session(void **state)
     assert_int_equal(ret, EOK);
 }
 
+static void pam_test_expire_initgr(const char *name)
+{
+    hash_key_t key;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(name);
+
+    hret = hash_delete(pam_test_ctx->pctx->id_table, &key);
+    assert_int_equal(hret, HASH_SUCCESS);
+}
+
+static void pam_test_conn_request(enum sss_cli_command cmd, bool contact_dp)
+{
+    int ret;
+
+    /* If the groups are refreshed the account request must be consumed,
+     * an unexpected one fails the mock */
+    mock_input_pam_ex(pam_test_ctx, "pamuser", NULL, NULL, NULL, contact_dp);
+
+    will_return(__wrap_sss_packet_get_cmd, cmd);
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+
+    pam_test_ctx->tctx->done = false;
+    set_cmd_cb(test_pam_simple_check);
+    ret = sss_cmd_execute(pam_test_ctx->cctx, cmd, pam_test_ctx->pam_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with EOK */
+    ret = test_ev_loop(pam_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+void test_pam_conn_initgr_within_timeout(void **state)
+{
+    pam_test_ctx->cctx->state_ctx = talloc_zero(pam_test_ctx->cctx,
+                                                struct pam_state_ctx);
+    assert_non_null(pam_test_ctx->cctx->state_ctx);
+
+    /* The first stage of the transaction refreshes the groups */
+    pam_test_expire_initgr("pamuser");
+    pam_test_conn_request(SSS_PAM_AUTHENTICATE, true);
+
+    /* The second one on the same connection is still within
+     * pam_id_timeout and does not contact the backend */
+    pam_test_conn_request(SSS_PAM_ACCT_MGMT, false);
+}
+
+void test_pam_conn_initgr_after_timeout(void **state)
+{
+    pam_test_ctx->cctx->state_ctx = talloc_zero(pam_test_ctx->cctx,
+                                                struct pam_state_ctx);
+    assert_non_null(pam_test_ctx->cctx->state_ctx);
+
+    pam_test_expire_initgr("pamuser");
+    pam_test_conn_request(SSS_PAM_AUTHENTICATE, true);
+
+    /* pam_id_timeout expired but the groups were already refreshed on
+     * this connection */
+    pam_test_expire_initgr("pamuser");
+    pam_test_conn_request(SSS_PAM_ACCT_MGMT, false);
+
+    /* A new connection, e.g. after the idle one was closed, refreshes the
+     * groups again */
+    talloc_free(pam_test_ctx->cctx->state_ctx);
+    pam_test_ctx->cctx->state_ctx = talloc_zero(pam_test_ctx->cctx,
+                                                struct pam_state_ctx);
+    assert_non_null(pam_test_ctx->cctx->state_ctx);
+
+    pam_test_expire_initgr("pamuser");
+    pam_test_conn_request(SSS_PAM_ACCT_MGMT, true);
+}
+
 void test_pam_close_session(void **state)
 {
     int ret;
@@ -2041,6 +2131,110 @@ void test_pam_preauth_cert_match(void **state)
     assert_int_equal(ret, EOK);
 }
 
+static void run_preauth_cert_match(bool lookup_user)
+{
+    int ret;
+
+    mock_input_pam_cert(pam_test_ctx, "pamuser", NULL, NULL, NULL, NULL, NULL,
+                        lookup_user ? test_lookup_by_cert_cb : NULL,
+                        SSSD_TEST_CERT_0001);
+
+    will_return(__wrap_sss_packet_get_cmd, SSS_PAM_PREAUTH);
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+
+    set_cmd_cb(test_pam_cert_check);
+    ret = sss_cmd_execute(pam_test_ctx->cctx, SSS_PAM_PREAUTH,
+                          pam_test_ctx->pam_cmds);
+    assert_int_equal(ret, EOK);
+
+    /* Wait until the test finishes with EOK */
+    ret = test_ev_loop(pam_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+
+    pam_test_ctx->tctx->done = false;
+}
+
+#define P11_WORKER_TEST_ROUNDS 3
+
+/* All requests must be handled by the same p11_child worker process. */
+void test_pam_preauth_cert_match_p11_worker_reuse(void **state)
+{
+    size_t c;
+    pid_t pid;
+
+    set_cert_auth_param(pam_test_ctx->pctx, CA_DB);
+
+    /* The worker is started with the first request. */
+    assert_int_equal(p11_child_worker_get_pid(pam_test_ctx->pctx->p11_worker),
+                     -1);
+
+    /* Only the first request looks up the user in the back end. */
+    run_preauth_cert_match(true);
+
+    pid = p11_child_worker_get_pid(pam_test_ctx->pctx->p11_worker);
+    assert_int_not_equal(pid, -1);
+
+    for (c = 0; c < P11_WORKER_TEST_ROUNDS; c++) {
+        run_preauth_cert_match(false);
+        assert_int_equal(
+                p11_child_worker_get_pid(pam_test_ctx->pctx->p11_worker), pid);
+    }
+}
+
+#define P11_WORKER_BENCH_ROUNDS 5
+
+static uint64_t time_preauth_cert_match(bool lookup_user)
+{
+    struct timeval start;
+    struct timeval end;
+
+    gettimeofday(&start, NULL);
+    run_preauth_cert_match(lookup_user);
+    gettimeofday(&end, NULL);
+
+    return (end.tv_sec - start.tv_sec) * 1000000
+                + (end.tv_usec - start.tv_usec);
+}
+
+/* Compares a new p11_child for every request with the p11_child worker.
+ * The first request with the worker includes the start of the worker. The
+ * timings depend on the machine, they are only printed. */
+void test_pam_preauth_cert_match_p11_worker_bench(void **state)
+{
+    int ret;
+    size_t c;
+    uint64_t single_shot = 0;
+    uint64_t first;
+    uint64_t worker = 0;
+
+    if (!p11_worker_bench) {
+        skip();
+    }
+
+    set_cert_auth_param(pam_test_ctx->pctx, CA_DB);
+
+    /* Only the first request looks up the user in the back end. */
+    run_preauth_cert_match(true);
+
+    for (c = 0; c < P11_WORKER_BENCH_ROUNDS; c++) {
+        single_shot += time_preauth_cert_match(false);
+    }
+
+    ret = p11_child_worker_init(pam_test_ctx->pctx, pam_test_ctx->tctx->ev,
+                                &pam_test_ctx->pctx->p11_worker);
+    assert_int_equal(ret, EOK);
+
+    first = time_preauth_cert_match(false);
+    for (c = 0; c < P11_WORKER_BENCH_ROUNDS; c++) {
+        worker += time_preauth_cert_match(false);
+    }
+
+    print_message("p11_child per request: %"PRIu64" us, worker: first "
+                  "request %"PRIu64" us, then %"PRIu64" us\n",
+                  single_shot / P11_WORKER_BENCH_ROUNDS, first,
+                  worker / P11_WORKER_BENCH_ROUNDS);
+}
+
 /* Test if PKCS11_LOGIN_TOKEN_NAME is added for the gdm-smartcard service */
 void test_pam_preauth_cert_match_gdm_smartcard(void **state)
 {
@@ -3041,6 +3235,8 @@ int main(int argc, const char *argv[])
         SSSD_DEBUG_OPTS
         { "no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
           _("Do not delete the test database after a test run"), NULL },
+        { "p11-worker-bench", 0, POPT_ARG_NONE, &p11_worker_bench, 0,
+          _("Print the timings of the p11_child worker"), NULL },
         POPT_TABLEEND
     };
 
@@ -3053,6 +3249,10 @@ int main(int argc, const char *argv[])
                                         pam_test_setup, pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_open_session,
                                         pam_test_setup, pam_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_conn_initgr_within_timeout,
+                                        pam_test_setup, pam_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_conn_initgr_after_timeout,
+                                        pam_test_setup, pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_close_session,
                                         pam_test_setup, pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_chauthtok,
@@ -3127,6 +3327,16 @@ int main(int argc, const char *argv[])
                                         pam_test_setup, pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_preauth_cert_match,
                                         pam_test_setup, pam_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_preauth_cert_match,
+                                        pam_test_setup_p11_worker,
+                                        pam_test_teardown),
+        cmocka_unit_test_setup_teardown(
+                                  test_pam_preauth_cert_match_p11_worker_reuse,
+                                  pam_test_setup_p11_worker,
+                                  pam_test_teardown),
+        cmocka_unit_test_setup_teardown(
+                                  test_pam_preauth_cert_match_p11_worker_bench,
+                                  pam_test_setup, pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_preauth_cert_match_gdm_smartcard,
                                         pam_test_setup, pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_preauth_cert_match_wrong_user,
@@ -3152,6 +3362,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_pam_cert_auth,
                                         pam_test_setup_no_verification,
                                         pam_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_cert_auth,
+                                        pam_test_setup_p11_worker,
+                                        pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_ecc_cert_auth,
                                         pam_test_setup, pam_test_teardown),
         cmocka_unit_test_setup_teardown(test_pam_cert_auth_double_cert,
@@ -0,0 +1,441 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - PAM responder cache of successful authentications
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <popt.h>
+#include <security/pam_appl.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "responder/pam/pamsrv.h"
+
+#define TEST_USER "user1@test.domain"
+#define TEST_USER2 "user2@test.domain"
+#define TEST_SERVICE "imap"
+#define TEST_PASSWORD "secret"
+#define TEST_ENV "KRB5CCNAME=KEYRING:persistent:1000"
+
+struct auth_cache_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct pam_auth_cache *cache;
+};
+
+static int auth_cache_test_setup_timeout(void **state, time_t timeout)
+{
+    struct auth_cache_test_ctx *test_ctx;
+    errno_t ret;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct auth_cache_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_ctx->tctx = create_ev_test_ctx(test_ctx);
+    assert_non_null(test_ctx->tctx);
+
+    /* The entries are freed with the cache in the teardown */
+    check_leaks_push(test_ctx);
+
+    /* Without a pool the hashes are computed synchronously, the results
+     * are still delivered from the event loop. */
+    ret = pam_auth_cache_init(test_ctx, test_ctx->tctx->ev, NULL, timeout,
+                              &test_ctx->cache);
+    assert_int_equal(ret, EOK);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int auth_cache_test_setup(void **state)
+{
+    return auth_cache_test_setup_timeout(state, 300);
+}
+
+static int auth_cache_test_setup_short(void **state)
+{
+    return auth_cache_test_setup_timeout(state, 1);
+}
+
+static int auth_cache_test_teardown(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+
+    talloc_zfree(test_ctx->cache);
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static struct pam_data *test_pd(TALLOC_CTX *mem_ctx,
+                                const char *user,
+                                const char *password,
+                                int cmd,
+                                int pam_status)
+{
+    struct pam_data *pd;
+    errno_t ret;
+
+    pd = create_pam_data(mem_ctx);
+    assert_non_null(pd);
+
+    pd->cmd = cmd;
+    pd->pam_status = pam_status;
+    pd->user = talloc_strdup(pd, user);
+    assert_non_null(pd->user);
+    pd->service = talloc_strdup(pd, TEST_SERVICE);
+    assert_non_null(pd->service);
+
+    ret = sss_authtok_set_password(pd->authtok, password, 0);
+    assert_int_equal(ret, EOK);
+
+    return pd;
+}
+
+/* Reports a successful authentication and waits until the hash was
+ * computed and the entry stored. */
+static void test_store(struct auth_cache_test_ctx *test_ctx,
+                       const char *user,
+                       const char *password)
+{
+    struct pam_data *pd;
+    errno_t ret;
+
+    pd = test_pd(test_ctx, user, password, SSS_PAM_AUTHENTICATE, PAM_SUCCESS);
+    ret = pam_add_response(pd, SSS_PAM_ENV_ITEM, sizeof(TEST_ENV),
+                           (const uint8_t *) TEST_ENV);
+    assert_int_equal(ret, EOK);
+
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+
+    tevent_loop_once(test_ctx->tctx->ev);
+}
+
+static void test_check_done(struct tevent_req *req)
+{
+    struct sss_test_ctx *tctx = tevent_req_callback_data(req,
+                                                         struct sss_test_ctx);
+    errno_t ret;
+
+    ret = pam_auth_cache_check_recv(req);
+    talloc_free(req);
+    test_ev_done(tctx, ret);
+}
+
+static errno_t test_check_pd(struct auth_cache_test_ctx *test_ctx,
+                             struct pam_data *pd)
+{
+    struct tevent_req *req;
+
+    req = pam_auth_cache_check_send(test_ctx, test_ctx->tctx->ev,
+                                    test_ctx->cache, pd);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_check_done, test_ctx->tctx);
+
+    test_ctx->tctx->done = false;
+    return test_ev_loop(test_ctx->tctx);
+}
+
+static errno_t test_check(struct auth_cache_test_ctx *test_ctx,
+                          const char *user,
+                          const char *password)
+{
+    struct pam_data *pd;
+    errno_t ret;
+
+    pd = test_pd(test_ctx, user, password, SSS_PAM_AUTHENTICATE, 0);
+    ret = test_check_pd(test_ctx, pd);
+    talloc_free(pd);
+
+    return ret;
+}
+
+static void test_auth_cache_hit(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct pam_data *pd;
+    errno_t ret;
+
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+
+    /* The environment of the original reply is sent again */
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_AUTHENTICATE, 0);
+    ret = test_check_pd(test_ctx, pd);
+    assert_int_equal(ret, EOK);
+    assert_non_null(pd->resp_list);
+    assert_int_equal(pd->resp_list->type, SSS_PAM_ENV_ITEM);
+    assert_int_equal(pd->resp_list->len, sizeof(TEST_ENV));
+    assert_memory_equal(pd->resp_list->data, TEST_ENV, sizeof(TEST_ENV));
+    assert_null(pd->resp_list->next);
+    talloc_free(pd);
+
+    /* Other users are not affected */
+    assert_int_equal(test_check(test_ctx, TEST_USER2, TEST_PASSWORD), ENOENT);
+}
+
+static void test_auth_cache_wrong_password(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+
+    assert_int_equal(test_check(test_ctx, TEST_USER, "wrong"), ENOENT);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), EOK);
+}
+
+static void test_auth_cache_expired_done(struct tevent_context *ev,
+                                         struct tevent_timer *te,
+                                         struct timeval tv,
+                                         void *pvt)
+{
+    struct sss_test_ctx *tctx = talloc_get_type(pvt, struct sss_test_ctx);
+
+    test_ev_done(tctx, EOK);
+}
+
+static void test_auth_cache_expired(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct tevent_timer *te;
+
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), EOK);
+
+    /* Wait past the timeout of 1 second */
+    te = tevent_add_timer(test_ctx->tctx->ev, test_ctx,
+                          tevent_timeval_current_ofs(1, 500000),
+                          test_auth_cache_expired_done, test_ctx->tctx);
+    assert_non_null(te);
+    test_ctx->tctx->done = false;
+    assert_int_equal(test_ev_loop(test_ctx->tctx), EOK);
+
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+}
+
+static void test_auth_cache_auth_err(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct pam_data *pd;
+
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+    test_store(test_ctx, TEST_USER2, TEST_PASSWORD);
+
+    /* A failed online authentication drops the user */
+    pd = test_pd(test_ctx, TEST_USER, "wrong", SSS_PAM_AUTHENTICATE,
+                 PAM_AUTH_ERR);
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+    assert_int_equal(test_check(test_ctx, TEST_USER2, TEST_PASSWORD), EOK);
+}
+
+static void test_auth_cache_chauthtok(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct pam_data *pd;
+
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+
+    /* A failed password change keeps the entry */
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_CHAUTHTOK,
+                 PAM_AUTHTOK_ERR);
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), EOK);
+
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_CHAUTHTOK,
+                 PAM_SUCCESS);
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+}
+
+static void test_auth_cache_otp(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct pam_data *pd;
+    errno_t ret;
+
+    /* The back end reported that the password contained an OTP */
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_AUTHENTICATE,
+                 PAM_SUCCESS);
+    ret = pam_add_response(pd, SSS_OTP, 0, NULL);
+    assert_int_equal(ret, EOK);
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+
+    /* The user has a second factor */
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_AUTHENTICATE,
+                 PAM_SUCCESS);
+    ret = pam_add_response(pd, SSS_PAM_OTP_INFO, 0, NULL);
+    assert_int_equal(ret, EOK);
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+}
+
+static void test_auth_cache_offline(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct pam_data *pd;
+
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_AUTHENTICATE,
+                 PAM_SUCCESS);
+    pd->offline_auth = true;
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+}
+
+static void test_auth_cache_generation_race(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct pam_data *pd;
+
+    /* The hash of a successful authentication is still being computed when
+     * a failed authentication of the user invalidates the cache. */
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_AUTHENTICATE,
+                 PAM_SUCCESS);
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+
+    pd = test_pd(test_ctx, TEST_USER, "wrong", SSS_PAM_AUTHENTICATE,
+                 PAM_AUTH_ERR);
+    pam_auth_cache_update(test_ctx->cache, pd, false);
+    talloc_free(pd);
+
+    /* Let the hash finish */
+    tevent_loop_once(test_ctx->tctx->ev);
+
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), ENOENT);
+
+    /* A later authentication is cached again */
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), EOK);
+}
+
+static void test_auth_cache_check_invalidated(void **state)
+{
+    struct auth_cache_test_ctx *test_ctx =
+        talloc_get_type_abort(*state, struct auth_cache_test_ctx);
+    struct tevent_req *req;
+    struct pam_data *pd;
+    errno_t ret;
+
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+
+    /* The user is invalidated while the hash of a check is computed */
+    pd = test_pd(test_ctx, TEST_USER, TEST_PASSWORD, SSS_PAM_AUTHENTICATE, 0);
+    req = pam_auth_cache_check_send(test_ctx, test_ctx->tctx->ev,
+                                    test_ctx->cache, pd);
+    assert_non_null(req);
+    tevent_req_set_callback(req, test_check_done, test_ctx->tctx);
+
+    pam_auth_cache_invalidate(test_ctx->cache, TEST_USER);
+
+    test_ctx->tctx->done = false;
+    ret = test_ev_loop(test_ctx->tctx);
+    assert_int_equal(ret, ENOENT);
+    assert_null(pd->resp_list);
+    talloc_free(pd);
+
+    /* A later authentication is cached again */
+    test_store(test_ctx, TEST_USER, TEST_PASSWORD);
+    assert_int_equal(test_check(test_ctx, TEST_USER, TEST_PASSWORD), EOK);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_auth_cache_hit,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_wrong_password,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_expired,
+                                        auth_cache_test_setup_short,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_auth_err,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_chauthtok,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_otp,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_offline,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_generation_race,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_auth_cache_check_invalidated,
+                                        auth_cache_test_setup,
+                                        auth_cache_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
@@ -26,6 +26,7 @@
 #include "tests/cmocka/common_mock.h"
 #include "providers/ldap/ldap_opts.h"
 #include "providers/ipa/ipa_opts.h"
+#include "providers/ldap/sdap_range.h"
 #include "util/crypto/sss_crypto.h"
 
 /* mock an LDAP entry */
@@ -387,6 +388,48 @@ void test_parse_no_map(void **state)
     talloc_free(attrs);
 }
 
+void test_parse_ranged(void **state)
+{
+    int ret;
+    struct sysdb_attrs *attrs;
+    struct parse_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                      struct parse_test_ctx);
+    struct mock_ldap_entry test_ranged_entry;
+    struct ldb_message_element *el;
+    uint32_t offset;
+
+    const char *member_values[] = { "cn=user1,dc=example,dc=com",
+                                    "cn=user2,dc=example,dc=com",
+                                    NULL };
+    struct mock_ldap_attr test_ranged_entry_attrs[] = {
+        { .name = "member;range=0-1", .values = member_values },
+        { NULL, NULL }
+    };
+
+    test_ranged_entry.dn = "cn=testgroup,dc=example,dc=com";
+    test_ranged_entry.attrs = test_ranged_entry_attrs;
+    set_entry_parse(&test_ranged_entry);
+
+    ret = sdap_parse_entry(test_ctx, &test_ctx->sh, &test_ctx->sm,
+                           NULL, 0, &attrs, false);
+    assert_int_equal(ret, ERR_OK);
+
+    /* The values are stored under the base attribute name */
+    ret = sysdb_attrs_get_el_ext(attrs, "member", false, &el);
+    assert_int_equal(ret, ERR_OK);
+    assert_int_equal(el->num_values, 2);
+
+    /* and the next range is remembered */
+    ret = sdap_range_get_pending(attrs, "member", &offset);
+    assert_int_equal(ret, ERR_OK);
+    assert_int_equal(offset, 2);
+
+    ret = sdap_range_get_pending(attrs, "memberOf", &offset);
+    assert_int_equal(ret, ENOENT);
+
+    talloc_free(attrs);
+}
+
 /* Only DN and OC, no real attributes */
 void test_parse_no_attrs(void **state)
 {
@@ -1119,6 +1162,34 @@ static void test_sdap_copy_objects_in_dom_nofilter(void **state)
                      test_ctx->dom_objects);
 }
 
+static void test_sdap_make_or_filter(void **state)
+{
+    int ret;
+    char *filter;
+    const char *sids[] = { "S-1-5-21-3692237560-1981608775-3610128199-1110",
+                           "S-1-5-21-3692237560-1981608775-3610128199-1116",
+                           NULL };
+
+    ret = sdap_make_or_filter(global_talloc_context, "objectSID", sids, 0,
+                              &filter);
+    assert_int_equal(ret, EINVAL);
+
+    ret = sdap_make_or_filter(global_talloc_context, "objectSID", sids, 1,
+                              &filter);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(filter,
+            "(|(objectSID=S-1-5-21-3692237560-1981608775-3610128199-1110))");
+    talloc_free(filter);
+
+    ret = sdap_make_or_filter(global_talloc_context, "objectSID", sids, 2,
+                              &filter);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(filter,
+            "(|(objectSID=S-1-5-21-3692237560-1981608775-3610128199-1110)"
+            "(objectSID=S-1-5-21-3692237560-1981608775-3610128199-1116))");
+    talloc_free(filter);
+}
+
 int main(int argc, const char *argv[])
 {
     poptContext pc;
@@ -1136,6 +1207,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_parse_no_map,
                                         parse_entry_test_setup,
                                         parse_entry_test_teardown),
+        cmocka_unit_test_setup_teardown(test_parse_ranged,
+                                        parse_entry_test_setup,
+                                        parse_entry_test_teardown),
         cmocka_unit_test_setup_teardown(test_parse_no_attrs,
                                         parse_entry_test_setup,
                                         parse_entry_test_teardown),
@@ -1194,6 +1268,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sdap_copy_objects_in_dom_nofilter,
                                         sdap_copy_objects_in_dom_setup,
                                         sdap_copy_objects_in_dom_teardown),
+
+        /* OR filter helper */
+        cmocka_unit_test(test_sdap_make_or_filter),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
@@ -0,0 +1,355 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - cache of TGTs obtained by ldap_child
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cmocka.h>
+#include <popt.h>
+
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_async_private.h"
+#include "tests/common.h"
+
+#define TEST_REALM "EXAMPLE.COM"
+#define TEST_PRINC "host/client.example.com"
+#define TEST_PRINC2 "ldap/client.example.com"
+#define TEST_KEYTAB "/etc/krb5.keytab"
+#define TEST_CCACHE_FILE "ccache_" BASE_FILE_STEM
+
+struct tgt_cache_test_ctx {
+    struct sdap_options *opts;
+    struct sdap_options *opts2;
+    char *ccname;
+};
+
+static int tgt_cache_test_setup(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx;
+    int fd;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct tgt_cache_test_ctx);
+    assert_non_null(test_ctx);
+
+    fd = open(TEST_CCACHE_FILE, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    assert_true(fd != -1);
+    close(fd);
+
+    test_ctx->ccname = talloc_asprintf(test_ctx, "FILE:%s", TEST_CCACHE_FILE);
+    assert_non_null(test_ctx->ccname);
+
+    test_ctx->opts = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(test_ctx->opts);
+
+    test_ctx->opts2 = talloc_zero(test_ctx, struct sdap_options);
+    assert_non_null(test_ctx->opts2);
+
+    check_leaks_push(test_ctx);
+    *state = test_ctx;
+    return 0;
+}
+
+static int tgt_cache_test_teardown(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+
+    sdap_tgt_cache_invalidate(test_ctx->opts,
+                              TEST_REALM, TEST_PRINC, TEST_KEYTAB);
+    sdap_tgt_cache_invalidate(test_ctx->opts,
+                              TEST_REALM, TEST_PRINC2, TEST_KEYTAB);
+    sdap_tgt_cache_invalidate(test_ctx->opts, NULL, NULL, NULL);
+    sdap_tgt_cache_invalidate(test_ctx->opts2,
+                              TEST_REALM, TEST_PRINC, TEST_KEYTAB);
+    unlink(TEST_CCACHE_FILE);
+
+    assert_true(check_leaks_pop(test_ctx));
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+    return 0;
+}
+
+static void test_tgt_cache_hit(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+    time_t expire_time = time(NULL) + 3600;
+    time_t cached_expire_time = 0;
+    char *ccname = NULL;
+    errno_t ret;
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                               test_ctx->ccname, expire_time);
+    assert_int_equal(ret, EOK);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(ccname, test_ctx->ccname);
+    assert_int_equal(cached_expire_time, expire_time);
+    talloc_free(ccname);
+
+    /* Different principal or keytab */
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC2, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, NULL,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+
+    sdap_tgt_cache_invalidate(test_ctx->opts,
+                              TEST_REALM, TEST_PRINC, TEST_KEYTAB);
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+}
+
+static void test_tgt_cache_defaults(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+    time_t cached_expire_time = 0;
+    char *ccname = NULL;
+    errno_t ret;
+
+    /* Default realm, principal and keytab */
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               NULL, NULL, NULL,
+                               test_ctx->ccname, time(NULL) + 3600);
+    assert_int_equal(ret, EOK);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                NULL, NULL, NULL,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(ccname, test_ctx->ccname);
+    talloc_free(ccname);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, NULL, NULL,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+}
+
+static void test_tgt_cache_same_ccache(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+    time_t cached_expire_time = 0;
+    char *ccname = NULL;
+    errno_t ret;
+
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                               test_ctx->ccname, time(NULL) + 3600);
+    assert_int_equal(ret, EOK);
+
+    /* The ticket of the second principal overwrites the ccache */
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               TEST_REALM, TEST_PRINC2, TEST_KEYTAB,
+                               test_ctx->ccname, time(NULL) + 3600);
+    assert_int_equal(ret, EOK);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC2, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, EOK);
+    talloc_free(ccname);
+}
+
+static void test_tgt_cache_expiring(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+    time_t cached_expire_time = 0;
+    char *ccname = NULL;
+    errno_t ret;
+
+    /* Already past the renewal point */
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                               test_ctx->ccname, time(NULL));
+    assert_int_equal(ret, EOK);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+}
+
+static void test_tgt_cache_missing_ccache(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+    time_t cached_expire_time = 0;
+    char *ccname = NULL;
+    errno_t ret;
+
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                               test_ctx->ccname, time(NULL) + 3600);
+    assert_int_equal(ret, EOK);
+
+    unlink(TEST_CCACHE_FILE);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+}
+
+static void test_tgt_cache_per_domain(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+    time_t cached_expire_time = 0;
+    char *ccname = NULL;
+    errno_t ret;
+
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                               test_ctx->ccname, time(NULL) + 3600);
+    assert_int_equal(ret, EOK);
+
+    /* A domain with other options must not see the ticket */
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts2,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, ENOENT);
+
+    /* Nor does invalidating it there affect the first domain */
+    sdap_tgt_cache_invalidate(test_ctx->opts2,
+                              TEST_REALM, TEST_PRINC, TEST_KEYTAB);
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    assert_int_equal(ret, EOK);
+    talloc_free(ccname);
+}
+
+static void test_tgt_cache_replaced_ccache(void **state)
+{
+    struct tgt_cache_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                 struct tgt_cache_test_ctx);
+    time_t cached_expire_time = 0;
+    char *ccname = NULL;
+    errno_t ret;
+    int old_fd;
+    int fd;
+
+    ret = sdap_tgt_cache_store(test_ctx->opts,
+                               TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                               test_ctx->ccname, time(NULL) + 3600);
+    assert_int_equal(ret, EOK);
+
+    /* Another domain of the same realm gets a new ticket, ldap_child renames
+     * it over the ccache. Keep the old file open so its inode is not
+     * reused. */
+    old_fd = open(TEST_CCACHE_FILE, O_RDONLY);
+    assert_true(old_fd != -1);
+    fd = open(TEST_CCACHE_FILE "_new", O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    assert_true(fd != -1);
+    close(fd);
+    ret = rename(TEST_CCACHE_FILE "_new", TEST_CCACHE_FILE);
+    assert_int_equal(ret, 0);
+
+    ret = sdap_tgt_cache_lookup(test_ctx, test_ctx->opts,
+                                TEST_REALM, TEST_PRINC, TEST_KEYTAB,
+                                &ccname, &cached_expire_time);
+    close(old_fd);
+    assert_int_equal(ret, ENOENT);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_tgt_cache_hit,
+                                        tgt_cache_test_setup,
+                                        tgt_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tgt_cache_defaults,
+                                        tgt_cache_test_setup,
+                                        tgt_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tgt_cache_same_ccache,
+                                        tgt_cache_test_setup,
+                                        tgt_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tgt_cache_expiring,
+                                        tgt_cache_test_setup,
+                                        tgt_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tgt_cache_missing_ccache,
+                                        tgt_cache_test_setup,
+                                        tgt_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tgt_cache_per_domain,
+                                        tgt_cache_test_setup,
+                                        tgt_cache_test_teardown),
+        cmocka_unit_test_setup_teardown(test_tgt_cache_replaced_ccache,
+                                        tgt_cache_test_setup,
+                                        tgt_cache_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
@@ -0,0 +1,204 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - reuse of the PAM client connection
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <popt.h>
+#include <sys/socket.h>
+
+#include "tests/cmocka/common_mock.h"
+
+/* common.c comes with its own gettext wrapper */
+#undef _
+
+/* In order to access opaque types */
+#include "sss_client/common.c"
+
+/* The connection is reopened here on failure, the socket must not exist so
+ * that this fails immediately */
+#define TEST_NO_SOCKET "/nonexistent/sssd/pipes/pam"
+#define TEST_TIMEOUT 100
+
+struct conn_test_ctx {
+    struct sss_cli_conn *conn;
+    int peer;
+};
+
+/* Pretend the connection was already opened and its server credentials
+ * checked by a previous stage of the PAM transaction. The real socket must
+ * be owned by root, a socket pair stands in for it. */
+static int conn_test_setup(void **state)
+{
+    struct conn_test_ctx *test_ctx;
+    int sv[2];
+    int ret;
+
+    test_ctx = talloc_zero(NULL, struct conn_test_ctx);
+    assert_non_null(test_ctx);
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    assert_int_equal(ret, 0);
+
+    test_ctx->conn = sss_pam_conn_new();
+    assert_non_null(test_ctx->conn);
+
+    test_ctx->conn->sd = sv[0];
+    ret = fstat(sv[0], &test_ctx->conn->sb);
+    assert_int_equal(ret, 0);
+    test_ctx->conn->cred_checked = true;
+
+    test_ctx->peer = sv[1];
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int conn_test_teardown(void **state)
+{
+    struct conn_test_ctx *test_ctx;
+
+    test_ctx = talloc_get_type(*state, struct conn_test_ctx);
+    assert_non_null(test_ctx);
+
+    sss_pam_conn_free(test_ctx->conn);
+    if (test_ctx->peer != -1) {
+        close(test_ctx->peer);
+    }
+
+    talloc_free(test_ctx);
+    return 0;
+}
+
+static void test_pam_conn_reuse(void **state)
+{
+    struct conn_test_ctx *test_ctx;
+    enum sss_status status;
+    int errnop;
+    int sd;
+
+    test_ctx = talloc_get_type(*state, struct conn_test_ctx);
+    sd = test_ctx->conn->sd;
+
+    /* every stage of the transaction keeps using the open connection */
+    status = sss_pam_conn_check_socket(test_ctx->conn, &errnop,
+                                       TEST_NO_SOCKET, TEST_TIMEOUT);
+    assert_int_equal(status, SSS_STATUS_SUCCESS);
+    assert_int_equal(test_ctx->conn->sd, sd);
+    assert_true(test_ctx->conn->cred_checked);
+
+    status = sss_pam_conn_check_socket(test_ctx->conn, &errnop,
+                                       TEST_NO_SOCKET, TEST_TIMEOUT);
+    assert_int_equal(status, SSS_STATUS_SUCCESS);
+    assert_int_equal(test_ctx->conn->sd, sd);
+    assert_true(test_ctx->conn->cred_checked);
+}
+
+static void test_pam_conn_peer_closed(void **state)
+{
+    struct conn_test_ctx *test_ctx;
+    enum sss_status status;
+    int errnop;
+
+    test_ctx = talloc_get_type(*state, struct conn_test_ctx);
+
+    status = sss_pam_conn_check_socket(test_ctx->conn, &errnop,
+                                       TEST_NO_SOCKET, TEST_TIMEOUT);
+    assert_int_equal(status, SSS_STATUS_SUCCESS);
+
+    /* The responder closes idle connections, the next stage must not reuse
+     * it and the credentials have to be checked again for a new one */
+    close(test_ctx->peer);
+    test_ctx->peer = -1;
+
+    status = sss_pam_conn_check_socket(test_ctx->conn, &errnop,
+                                       TEST_NO_SOCKET, TEST_TIMEOUT);
+    assert_int_equal(status, SSS_STATUS_UNAVAIL);
+    assert_int_equal(test_ctx->conn->sd, -1);
+    assert_false(test_ctx->conn->cred_checked);
+}
+
+static void test_pam_conn_forked(void **state)
+{
+    struct conn_test_ctx *test_ctx;
+    enum sss_status status;
+    struct stat sb;
+    int errnop;
+    int sd;
+    int ret;
+
+    test_ctx = talloc_get_type(*state, struct conn_test_ctx);
+    sd = test_ctx->conn->sd;
+
+    /* a connection inherited from the parent is not shared with it */
+    test_ctx->conn->pid = getpid() + 1;
+
+    status = sss_pam_conn_check_socket(test_ctx->conn, &errnop,
+                                       TEST_NO_SOCKET, TEST_TIMEOUT);
+    assert_int_equal(status, SSS_STATUS_UNAVAIL);
+    assert_int_equal(test_ctx->conn->sd, -1);
+    assert_false(test_ctx->conn->cred_checked);
+    assert_int_equal(test_ctx->conn->pid, getpid());
+
+    ret = fstat(sd, &sb);
+    assert_int_equal(ret, -1);
+    assert_int_equal(errno, EBADF);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_pam_conn_reuse,
+                                        conn_test_setup,
+                                        conn_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_conn_peer_closed,
+                                        conn_test_setup,
+                                        conn_test_teardown),
+        cmocka_unit_test_setup_teardown(test_pam_conn_forked,
+                                        conn_test_setup,
+                                        conn_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
@@ -0,0 +1,463 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    SSSD tests - sudo rule index of the sudo responder
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+
+/* In order to access opaque types */
+#include "responder/sudo/sudosrv_get_sudorules.c"
+
+#include "tests/cmocka/common_mock.h"
+
+#define TESTS_PATH "tp_" BASE_FILE_STEM
+#define TEST_CONF_DB "test_sudosrv_rules.ldb"
+#define TEST_DOM_NAME "sudo_index_test"
+
+#define TEST_USER "sudo_user"
+#define TEST_UID 1001
+#define TEST_UID_STR "1001"
+#define TEST_GROUP "sudo_group"
+#define TEST_NETGROUP "sudo_netgroup"
+
+struct test_rule {
+    const char *name;
+    const char *order;
+    const char *users[3];
+} test_rules[] = {
+    { "rule_all", "5", { "ALL", NULL } },
+    { "rule_user", "1", { TEST_USER, NULL } },
+    { "rule_group", "3", { "%" TEST_GROUP, NULL } },
+    { "rule_uid", "2", { "#" TEST_UID_STR, NULL } },
+    { "rule_netgroup", "4", { "+" TEST_NETGROUP, NULL } },
+    { "rule_user_netgroup", "6", { TEST_USER, "+" TEST_NETGROUP, NULL } },
+    { "rule_other", "7", { "other_user", NULL } },
+    { "rule_other_netgroup", "8", { "%other_group", "+other_netgroup",
+                                    NULL } },
+};
+
+/* Not used by the tests, the responder itself is not running. */
+struct tevent_req *
+cache_req_initgr_by_name_send(TALLOC_CTX *mem_ctx,
+                              struct tevent_context *ev,
+                              struct resp_ctx *rctx,
+                              struct sss_nc_ctx *ncache,
+                              int cache_refresh_percent,
+                              enum cache_req_dom_type req_dom_type,
+                              const char *domain,
+                              const char *name)
+{
+    return NULL;
+}
+
+errno_t cache_req_single_domain_recv(TALLOC_CTX *mem_ctx,
+                                     struct tevent_req *req,
+                                     struct cache_req_result **_result)
+{
+    return ENOSYS;
+}
+
+struct tevent_req *
+sss_dp_get_sudoers_send(TALLOC_CTX *mem_ctx,
+                        struct resp_ctx *rctx,
+                        struct sss_domain_info *dom,
+                        bool fast_reply,
+                        enum sss_dp_sudo_type type,
+                        const char *name,
+                        uint32_t num_rules,
+                        struct sysdb_attrs **rules)
+{
+    return NULL;
+}
+
+errno_t
+sss_dp_get_sudoers_recv(TALLOC_CTX *mem_ctx,
+                        struct tevent_req *req,
+                        uint16_t *_dp_error,
+                        uint32_t *_error,
+                        const char ** _error_message)
+{
+    return ENOSYS;
+}
+
+struct sudo_index_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct sudo_ctx *sudo_ctx;
+    char **groups;
+};
+
+static struct sysdb_attrs *create_rule(TALLOC_CTX *mem_ctx,
+                                       struct test_rule *test_rule)
+{
+    struct sysdb_attrs *rule;
+    errno_t ret;
+    int i;
+
+    rule = sysdb_new_attrs(mem_ctx);
+    assert_non_null(rule);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_CN,
+                                 test_rule->name);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_HOST, "ALL");
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_COMMAND, "ALL");
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_ORDER,
+                                 test_rule->order);
+    assert_int_equal(ret, EOK);
+
+    for (i = 0; test_rule->users[i] != NULL; i++) {
+        ret = sysdb_attrs_add_string(rule, SYSDB_SUDO_CACHE_AT_USER,
+                                     test_rule->users[i]);
+        assert_int_equal(ret, EOK);
+    }
+
+    return rule;
+}
+
+static void store_rule(struct sudo_index_test_ctx *test_ctx,
+                       struct test_rule *test_rule)
+{
+    struct sysdb_attrs *rule;
+    errno_t ret;
+
+    rule = create_rule(test_ctx, test_rule);
+
+    ret = sysdb_sudo_store(test_ctx->tctx->dom, &rule, 1);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(rule);
+}
+
+static void purge_rule(struct sudo_index_test_ctx *test_ctx,
+                       struct test_rule *test_rule)
+{
+    struct sysdb_attrs *rule;
+    errno_t ret;
+
+    rule = create_rule(test_ctx, test_rule);
+
+    ret = sysdb_sudo_purge(test_ctx->tctx->dom, NULL, &rule, 1);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(rule);
+}
+
+static int sudo_index_test_setup(void **state)
+{
+    struct sudo_index_test_ctx *test_ctx;
+    size_t i;
+
+    assert_true(leak_check_setup());
+
+    test_ctx = talloc_zero(global_talloc_context, struct sudo_index_test_ctx);
+    assert_non_null(test_ctx);
+
+    test_dom_suite_setup(TESTS_PATH);
+
+    test_ctx->tctx = create_dom_test_ctx(test_ctx, TESTS_PATH, TEST_CONF_DB,
+                                         TEST_DOM_NAME, "ldap", NULL);
+    assert_non_null(test_ctx->tctx);
+
+    test_ctx->sudo_ctx = talloc_zero(test_ctx, struct sudo_ctx);
+    assert_non_null(test_ctx->sudo_ctx);
+
+    test_ctx->groups = talloc_zero_array(test_ctx, char *, 2);
+    assert_non_null(test_ctx->groups);
+    test_ctx->groups[0] = talloc_strdup(test_ctx->groups, TEST_GROUP);
+    assert_non_null(test_ctx->groups[0]);
+
+    for (i = 0; i < N_ELEMENTS(test_rules); i++) {
+        store_rule(test_ctx, &test_rules[i]);
+    }
+
+    check_leaks_push(test_ctx);
+
+    *state = test_ctx;
+    return 0;
+}
+
+static int sudo_index_test_teardown(void **state)
+{
+    struct sudo_index_test_ctx *test_ctx;
+    struct sudosrv_rule_index *index;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudo_index_test_ctx);
+
+    /* The indexes are kept for the next requests. */
+    while ((index = test_ctx->sudo_ctx->indexes) != NULL) {
+        DLIST_REMOVE(test_ctx->sudo_ctx->indexes, index);
+        talloc_free(index);
+    }
+
+    assert_true(check_leaks_pop(test_ctx));
+
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    talloc_free(test_ctx);
+    assert_true(leak_check_teardown());
+
+    return 0;
+}
+
+static void assert_rules_equal(struct sysdb_attrs **index_rules,
+                               uint32_t num_index_rules,
+                               struct sysdb_attrs **search_rules,
+                               uint32_t num_search_rules)
+{
+    struct ldb_message_element *index_el;
+    struct ldb_message_element *search_el;
+    const char *index_name;
+    const char *search_name;
+    unsigned int j;
+    uint32_t i;
+    errno_t ret;
+
+    assert_int_equal(num_index_rules, num_search_rules);
+
+    for (i = 0; i < num_index_rules; i++) {
+        ret = sysdb_attrs_get_string(index_rules[i], SYSDB_SUDO_CACHE_AT_CN,
+                                     &index_name);
+        assert_int_equal(ret, EOK);
+        ret = sysdb_attrs_get_string(search_rules[i], SYSDB_SUDO_CACHE_AT_CN,
+                                     &search_name);
+        assert_int_equal(ret, EOK);
+        assert_string_equal(index_name, search_name);
+
+        /* Either #uid of the client or the netgroups for sudo to check */
+        ret = sysdb_attrs_get_el_ext(index_rules[i],
+                                     SYSDB_SUDO_CACHE_AT_USER, false,
+                                     &index_el);
+        assert_int_equal(ret, EOK);
+        ret = sysdb_attrs_get_el_ext(search_rules[i],
+                                     SYSDB_SUDO_CACHE_AT_USER, false,
+                                     &search_el);
+        assert_int_equal(ret, EOK);
+
+        assert_int_equal(index_el->num_values, search_el->num_values);
+        for (j = 0; j < index_el->num_values; j++) {
+            assert_string_equal((const char *) index_el->values[j].data,
+                                (const char *) search_el->values[j].data);
+        }
+    }
+}
+
+static void assert_rule_names(struct sysdb_attrs **rules,
+                              uint32_t num_rules,
+                              const char **names)
+{
+    const char *name;
+    uint32_t i;
+    errno_t ret;
+
+    for (i = 0; names[i] != NULL; i++) {
+        assert_true(i < num_rules);
+
+        ret = sysdb_attrs_get_string(rules[i], SYSDB_SUDO_CACHE_AT_CN, &name);
+        assert_int_equal(ret, EOK);
+        assert_string_equal(name, names[i]);
+    }
+
+    assert_int_equal(i, num_rules);
+}
+
+/* Looks up the rules of the test user through the index and through the
+ * cache search and checks that both return the same. */
+static void lookup_and_compare(struct sudo_index_test_ctx *test_ctx,
+                               bool inverse_order,
+                               const char **expected)
+{
+    struct sudosrv_rule_index *index;
+    struct sysdb_attrs **index_rules;
+    struct sysdb_attrs **search_rules;
+    uint32_t num_index_rules;
+    uint32_t num_search_rules;
+    errno_t ret;
+
+    ret = sudosrv_rule_index_get(test_ctx->sudo_ctx, test_ctx->tctx->dom,
+                                 inverse_order, &index);
+    assert_int_equal(ret, EOK);
+
+    ret = sudosrv_rule_index_lookup(test_ctx, index, TEST_UID, TEST_UID,
+                                    TEST_USER, test_ctx->groups,
+                                    &index_rules, &num_index_rules);
+    assert_int_equal(ret, EOK);
+
+    ret = sudosrv_search_rules(test_ctx, test_ctx->tctx->dom,
+                               TEST_UID, TEST_UID, TEST_USER,
+                               test_ctx->groups, inverse_order,
+                               &search_rules, &num_search_rules);
+    assert_int_equal(ret, EOK);
+
+    assert_rules_equal(index_rules, num_index_rules,
+                       search_rules, num_search_rules);
+    assert_rule_names(index_rules, num_index_rules, expected);
+
+    talloc_free(index_rules);
+    talloc_free(search_rules);
+}
+
+static void test_sudo_index_matches_search(void **state)
+{
+    struct sudo_index_test_ctx *test_ctx;
+    const char *expected[] = { "rule_user", "rule_uid", "rule_group",
+                               "rule_netgroup", "rule_all",
+                               "rule_user_netgroup", "rule_other_netgroup",
+                               NULL };
+    const char *expected_inverse[] = { "rule_other_netgroup",
+                                       "rule_user_netgroup", "rule_all",
+                                       "rule_netgroup", "rule_group",
+                                       "rule_uid", "rule_user", NULL };
+
+    test_ctx = talloc_get_type_abort(*state, struct sudo_index_test_ctx);
+
+    lookup_and_compare(test_ctx, false, expected);
+
+    /* The index is reused */
+    lookup_and_compare(test_ctx, false, expected);
+
+    lookup_and_compare(test_ctx, true, expected_inverse);
+}
+
+static void test_sudo_index_no_rules(void **state)
+{
+    struct sudo_index_test_ctx *test_ctx;
+    struct sudosrv_rule_index *index;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    errno_t ret;
+
+    test_ctx = talloc_get_type_abort(*state, struct sudo_index_test_ctx);
+
+    ret = sysdb_sudo_purge(test_ctx->tctx->dom, "(objectClass=sudoRule)",
+                           NULL, 0);
+    assert_int_equal(ret, EOK);
+
+    ret = sudosrv_rule_index_get(test_ctx->sudo_ctx, test_ctx->tctx->dom,
+                                 false, &index);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(index->num_rules, 0);
+
+    ret = sudosrv_rule_index_lookup(test_ctx, index, TEST_UID, TEST_UID,
+                                    TEST_USER, test_ctx->groups,
+                                    &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_rules, 0);
+    assert_null(rules);
+}
+
+static void test_sudo_index_after_purge(void **state)
+{
+    struct sudo_index_test_ctx *test_ctx;
+    struct sudosrv_rule_index *index;
+    uint64_t revision;
+    errno_t ret;
+    const char *expected[] = { "rule_user", "rule_uid", "rule_group",
+                               "rule_netgroup", "rule_all",
+                               "rule_user_netgroup", "rule_other_netgroup",
+                               NULL };
+    const char *expected_purged[] = { "rule_uid", "rule_group",
+                                      "rule_all", "rule_user_netgroup",
+                                      "rule_other_netgroup", NULL };
+    const char *expected_stored[] = { "rule_user", "rule_uid", "rule_group",
+                                      "rule_all", "rule_user_netgroup",
+                                      "rule_other_netgroup", NULL };
+
+    test_ctx = talloc_get_type_abort(*state, struct sudo_index_test_ctx);
+
+    lookup_and_compare(test_ctx, false, expected);
+
+    ret = sudosrv_rule_index_get(test_ctx->sudo_ctx, test_ctx->tctx->dom,
+                                 false, &index);
+    assert_int_equal(ret, EOK);
+    revision = index->revision;
+
+    /* test_rules[1] is rule_user, test_rules[4] is rule_netgroup */
+    purge_rule(test_ctx, &test_rules[1]);
+    purge_rule(test_ctx, &test_rules[4]);
+
+    lookup_and_compare(test_ctx, false, expected_purged);
+
+    ret = sudosrv_rule_index_get(test_ctx->sudo_ctx, test_ctx->tctx->dom,
+                                 false, &index);
+    assert_int_equal(ret, EOK);
+    assert_true(index->revision > revision);
+    revision = index->revision;
+
+    /* A rule stored again is found as well */
+    store_rule(test_ctx, &test_rules[1]);
+
+    lookup_and_compare(test_ctx, false, expected_stored);
+
+    ret = sudosrv_rule_index_get(test_ctx->sudo_ctx, test_ctx->tctx->dom,
+                                 false, &index);
+    assert_int_equal(ret, EOK);
+    assert_true(index->revision > revision);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        POPT_TABLEEND
+    };
+
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_sudo_index_matches_search,
+                                        sudo_index_test_setup,
+                                        sudo_index_test_teardown),
+        cmocka_unit_test_setup_teardown(test_sudo_index_no_rules,
+                                        sudo_index_test_setup,
+                                        sudo_index_test_teardown),
+        cmocka_unit_test_setup_teardown(test_sudo_index_after_purge,
+                                        sudo_index_test_setup,
+                                        sudo_index_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can decide if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_CLI_INIT(debug_level);
+
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_DOM_NAME);
+    rv = cmocka_run_group_tests(tests, NULL, NULL);
+
+    return rv;
+}
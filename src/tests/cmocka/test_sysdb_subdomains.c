@@ -190,6 +190,79 @@ static void test_sysdb_subdomain_create(void **state)
     assert_true(test_ctx->tctx->dom->subdomains->next->mpg_mode == MPG_HYBRID);
 }
 
+static void test_sysdb_subdomain_changes(void **state)
+{
+    errno_t ret;
+    struct subdom_test_ctx *test_ctx =
+        talloc_get_type(*state, struct subdom_test_ctx);
+    const char *const dom1[4] = { "dom1.sub", "DOM1.SUB", "dom1", "S-1" };
+    bool changed;
+
+    /* new subdomain */
+    changed = false;
+    ret = sysdb_subdomain_store_ext(test_ctx->tctx->sysdb,
+                                    dom1[0], dom1[1], dom1[2], dom1[3],
+                                    MPG_DISABLED, false, NULL, 0, NULL,
+                                    &changed);
+    assert_int_equal(ret, EOK);
+    assert_true(changed);
+
+    changed = false;
+    ret = sysdb_update_subdomains_ext(test_ctx->tctx->dom,
+                                      test_ctx->tctx->confdb, &changed);
+    assert_int_equal(ret, EOK);
+    assert_true(changed);
+
+    /* nothing has changed */
+    changed = true;
+    ret = sysdb_subdomain_store_ext(test_ctx->tctx->sysdb,
+                                    dom1[0], dom1[1], dom1[2], dom1[3],
+                                    MPG_DISABLED, false, NULL, 0, NULL,
+                                    &changed);
+    assert_int_equal(ret, EOK);
+    assert_false(changed);
+
+    changed = true;
+    ret = sysdb_update_subdomains_ext(test_ctx->tctx->dom,
+                                      test_ctx->tctx->confdb, &changed);
+    assert_int_equal(ret, EOK);
+    assert_false(changed);
+
+    /* property change */
+    changed = false;
+    ret = sysdb_subdomain_store_ext(test_ctx->tctx->sysdb,
+                                    dom1[0], dom1[1], dom1[2], dom1[3],
+                                    MPG_ENABLED, false, NULL, 0, NULL,
+                                    &changed);
+    assert_int_equal(ret, EOK);
+    assert_true(changed);
+
+    changed = false;
+    ret = sysdb_update_subdomains_ext(test_ctx->tctx->dom,
+                                      test_ctx->tctx->confdb, &changed);
+    assert_int_equal(ret, EOK);
+    assert_true(changed);
+    assert_true(test_ctx->tctx->dom->subdomains->mpg_mode == MPG_ENABLED);
+
+    /* removed subdomain */
+    ret = sysdb_subdomain_delete(test_ctx->tctx->sysdb, dom1[0]);
+    assert_int_equal(ret, EOK);
+
+    changed = false;
+    ret = sysdb_update_subdomains_ext(test_ctx->tctx->dom,
+                                      test_ctx->tctx->confdb, &changed);
+    assert_int_equal(ret, EOK);
+    assert_true(changed);
+    assert_int_equal(sss_domain_get_state(test_ctx->tctx->dom->subdomains),
+                     DOM_DISABLED);
+
+    changed = true;
+    ret = sysdb_update_subdomains_ext(test_ctx->tctx->dom,
+                                      test_ctx->tctx->confdb, &changed);
+    assert_int_equal(ret, EOK);
+    assert_false(changed);
+}
+
 static void test_sysdb_master_domain_ops(void **state)
 {
     errno_t ret;
@@ -573,6 +646,54 @@ static void test_sysdb_set_and_get_site(void **state)
     talloc_free(tmp_ctx);
 }
 
+static void test_sysdb_set_and_get_dc_ranking(void **state)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct subdom_test_ctx *test_ctx =
+        talloc_get_type(*state, struct subdom_test_ctx);
+    const char *dcs[] = { "dc2.example.com", "dc1.example.com", NULL };
+    const char **ranking;
+    const char *forest;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = sysdb_get_dc_ranking(tmp_ctx, test_ctx->tctx->dom, &ranking);
+    assert_int_equal(ret, EOK);
+    assert_null(ranking);
+
+    ret = sysdb_get_site_forest(tmp_ctx, test_ctx->tctx->dom, &forest);
+    assert_int_equal(ret, EOK);
+    assert_null(forest);
+
+    ret = sysdb_set_dc_ranking(test_ctx->tctx->dom, dcs);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_set_site_forest(test_ctx->tctx->dom, "example.com");
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_get_dc_ranking(tmp_ctx, test_ctx->tctx->dom, &ranking);
+    assert_int_equal(ret, EOK);
+    assert_non_null(ranking);
+    assert_string_equal(ranking[0], "dc2.example.com");
+    assert_string_equal(ranking[1], "dc1.example.com");
+    assert_null(ranking[2]);
+
+    ret = sysdb_get_site_forest(tmp_ctx, test_ctx->tctx->dom, &forest);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(forest, "example.com");
+
+    ret = sysdb_set_dc_ranking(test_ctx->tctx->dom, NULL);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_get_dc_ranking(tmp_ctx, test_ctx->tctx->dom, &ranking);
+    assert_int_equal(ret, EOK);
+    assert_null(ranking);
+
+    talloc_free(tmp_ctx);
+}
+
 int main(int argc, const char *argv[])
 {
     int rv;
@@ -594,6 +715,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sysdb_subdomain_create,
                                         test_sysdb_subdom_setup,
                                         test_sysdb_subdom_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_subdomain_changes,
+                                        test_sysdb_subdom_setup,
+                                        test_sysdb_subdom_teardown),
         cmocka_unit_test_setup_teardown(test_sysdb_link_forest_root_ipa,
                                         test_sysdb_subdom_setup,
                                         test_sysdb_subdom_teardown),
@@ -609,6 +733,9 @@ int main(int argc, const char *argv[])
         cmocka_unit_test_setup_teardown(test_sysdb_set_and_get_site,
                                         test_sysdb_subdom_setup,
                                         test_sysdb_subdom_teardown),
+        cmocka_unit_test_setup_teardown(test_sysdb_set_and_get_dc_ranking,
+                                        test_sysdb_subdom_setup,
+                                        test_sysdb_subdom_teardown),
     };
 
     /* Set debug level to invalid value so we can decide if -d 0 was used. */
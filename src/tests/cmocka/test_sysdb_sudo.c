@@ -498,6 +498,52 @@ void test_sudo_set_get_last_full_refresh(void **state)
     assert_int_equal(now, loaded_time);
 }
 
+void test_sudo_revision(void **state)
+{
+    errno_t ret;
+    struct sysdb_attrs *rule;
+    uint64_t revision;
+    uint64_t old_revision;
+    struct sysdb_test_ctx *test_ctx = talloc_get_type_abort(*state,
+                                                         struct sysdb_test_ctx);
+
+    ret = sysdb_sudo_get_revision(test_ctx->tctx->dom, &revision);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(revision, 0);
+
+    rule = sysdb_new_attrs(test_ctx);
+    assert_non_null(rule);
+    create_rule_attrs(rule, 0);
+
+    ret = sysdb_sudo_store(test_ctx->tctx->dom, &rule, 1);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_sudo_get_revision(test_ctx->tctx->dom, &revision);
+    assert_int_equal(ret, EOK);
+    assert_true(revision > 0);
+    old_revision = revision;
+
+    /* Nothing is removed, the revision stays the same */
+    ret = sysdb_sudo_purge(test_ctx->tctx->dom, NULL, NULL, 0);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_sudo_get_revision(test_ctx->tctx->dom, &revision);
+    assert_int_equal(ret, EOK);
+    assert_true(revision == old_revision);
+
+    /* The whole subtree is removed, the revision must not start over */
+    ret = sysdb_sudo_purge(test_ctx->tctx->dom, "(objectClass=sudoRule)",
+                           NULL, 0);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(get_stored_rules_count(test_ctx), 0);
+
+    ret = sysdb_sudo_get_revision(test_ctx->tctx->dom, &revision);
+    assert_int_equal(ret, EOK);
+    assert_true(revision > old_revision);
+
+    talloc_zfree(rule);
+}
+
 void test_get_sudo_user_info(void **state)
 {
     errno_t ret;
@@ -989,6 +1035,11 @@ int main(int argc, const char *argv[])
                                         test_sysdb_setup,
                                         test_sysdb_teardown),
 
+        /* sysdb_sudo_get_revision() */
+        cmocka_unit_test_setup_teardown(test_sudo_revision,
+                                        test_sysdb_setup,
+                                        test_sysdb_teardown),
+
         /* sysdb_get_sudo_user_info() */
         cmocka_unit_test_setup_teardown(test_get_sudo_user_info,
                                         test_sysdb_setup,
@@ -1756,6 +1756,25 @@ static void test_parse_cert_verify_opts(void **state)
     assert_null(cv_opts->ocsp_default_responder_signing_cert);
     assert_string_equal(cv_opts->crl_file, "hij");
     talloc_free(cv_opts);
+
+    ret = parse_cert_verify_opts(global_talloc_context, "ocsp_cache=",
+                                 &cv_opts);
+    assert_int_equal(ret, EINVAL);
+
+    ret = parse_cert_verify_opts(global_talloc_context, "ocsp_cache=klm",
+                                 &cv_opts);
+    assert_int_equal(ret, EINVAL);
+
+    ret = parse_cert_verify_opts(global_talloc_context,
+                                 "ocsp_cache=/var/lib/sss/db/ocsp_cache",
+                                 &cv_opts);
+    assert_int_equal(ret, EOK);
+    assert_true(cv_opts->do_verification);
+    assert_true(cv_opts->do_ocsp);
+    assert_null(cv_opts->crl_file);
+    assert_string_equal(cv_opts->ocsp_cache_file,
+                        "/var/lib/sss/db/ocsp_cache");
+    talloc_free(cv_opts);
 }
 
 static void assert_parse_fqname(const char *fqname,
@@ -0,0 +1,314 @@
+/*
+    SSSD
+
+    Benchmark of the HBAC rule evaluation
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <talloc.h>
+#include <popt.h>
+
+#include "lib/ipa_hbac/ipa_hbac.h"
+
+#define DEFAULT_RULES       1000
+#define DEFAULT_SERVICES    20
+#define DEFAULT_ITERATIONS  10000
+
+#define BENCH_USER          "benchuser"
+#define BENCH_GROUP         "benchgroup"
+#define BENCH_HOSTGROUP     "benchhosts"
+
+static const char **bench_list(TALLOC_CTX *mem_ctx, const char *name)
+{
+    const char **list;
+
+    list = talloc_array(mem_ctx, const char *, 2);
+    if (list == NULL) {
+        return NULL;
+    }
+
+    list[0] = name;
+    list[1] = NULL;
+
+    return list;
+}
+
+static struct hbac_rule_element *bench_element(TALLOC_CTX *mem_ctx,
+                                               const char *name,
+                                               const char *group)
+{
+    struct hbac_rule_element *el;
+
+    el = talloc_zero(mem_ctx, struct hbac_rule_element);
+    if (el == NULL) {
+        return NULL;
+    }
+
+    if (name == NULL && group == NULL) {
+        el->category = HBAC_CATEGORY_ALL;
+        return el;
+    }
+
+    el->category = HBAC_CATEGORY_NULL;
+    el->names = bench_list(el, name);
+    el->groups = bench_list(el, group);
+    if (el->names == NULL || el->groups == NULL) {
+        talloc_free(el);
+        return NULL;
+    }
+
+    return el;
+}
+
+/* Each rule allows one user on one host through one of num_services
+ * services. Only the last rule matches the request. */
+static struct hbac_rule **bench_rules(TALLOC_CTX *mem_ctx,
+                                      int num_rules,
+                                      int num_services)
+{
+    struct hbac_rule **rules;
+    struct hbac_rule *rule;
+    int i;
+
+    rules = talloc_zero_array(mem_ctx, struct hbac_rule *, num_rules + 1);
+    if (rules == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < num_rules; i++) {
+        rule = talloc_zero(rules, struct hbac_rule);
+        if (rule == NULL) {
+            return NULL;
+        }
+
+        rule->enabled = true;
+        rule->name = talloc_asprintf(rule, "rule%d", i);
+        rule->users = bench_element(rule,
+                                    i == num_rules - 1 ? BENCH_USER
+                                        : talloc_asprintf(rule, "user%d", i),
+                                    NULL);
+        rule->services = bench_element(rule,
+                                       talloc_asprintf(rule, "svc%d",
+                                                       i % num_services),
+                                       NULL);
+        rule->targethosts = bench_element(rule,
+                                          talloc_asprintf(rule,
+                                                  "host%d.example.com", i),
+                                          NULL);
+        rule->srchosts = bench_element(rule, NULL, NULL);
+        if (rule->name == NULL || rule->users == NULL
+                || rule->services == NULL || rule->targethosts == NULL
+                || rule->srchosts == NULL) {
+            return NULL;
+        }
+
+        rules[i] = rule;
+    }
+
+    return rules;
+}
+
+static struct hbac_request_element *bench_req_element(TALLOC_CTX *mem_ctx,
+                                                      const char *name,
+                                                      const char *group)
+{
+    struct hbac_request_element *el;
+
+    el = talloc_zero(mem_ctx, struct hbac_request_element);
+    if (el == NULL) {
+        return NULL;
+    }
+
+    el->name = name;
+    el->groups = bench_list(el, group);
+    if (el->name == NULL || el->groups == NULL) {
+        talloc_free(el);
+        return NULL;
+    }
+
+    return el;
+}
+
+static struct hbac_eval_req *bench_request(TALLOC_CTX *mem_ctx,
+                                           int num_rules,
+                                           int num_services)
+{
+    struct hbac_eval_req *req;
+
+    req = talloc_zero(mem_ctx, struct hbac_eval_req);
+    if (req == NULL) {
+        return NULL;
+    }
+
+    req->request_time = time(NULL);
+    req->user = bench_req_element(req, BENCH_USER, BENCH_GROUP);
+    req->service = bench_req_element(req,
+                                     talloc_asprintf(req, "svc%d",
+                                             (num_rules - 1) % num_services),
+                                     "login_services");
+    req->targethost = bench_req_element(req,
+                                        talloc_asprintf(req,
+                                                "host%d.example.com",
+                                                num_rules - 1),
+                                        BENCH_HOSTGROUP);
+    req->srchost = bench_req_element(req, "client.example.com",
+                                     BENCH_HOSTGROUP);
+    if (req->user == NULL || req->service == NULL
+            || req->targethost == NULL || req->srchost == NULL) {
+        return NULL;
+    }
+
+    return req;
+}
+
+static double bench_elapsed_usec(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000.0
+           + (end->tv_nsec - start->tv_nsec) / 1000.0;
+}
+
+static int bench_check_result(enum hbac_eval_result result,
+                              struct hbac_info *info,
+                              const char *label)
+{
+    if (result != HBAC_EVAL_ALLOW) {
+        fprintf(stderr, "%s: expected [%s], got [%s]\n", label,
+                hbac_result_string(HBAC_EVAL_ALLOW),
+                hbac_result_string(result));
+        return 1;
+    }
+
+    hbac_free_info(info);
+    return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_rules = DEFAULT_RULES;
+    int pc_services = DEFAULT_SERVICES;
+    int pc_iterations = DEFAULT_ITERATIONS;
+    TALLOC_CTX *ctx = NULL;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *req;
+    struct hbac_rule_set *rule_set = NULL;
+    struct hbac_info *info;
+    enum hbac_eval_result result;
+    enum hbac_error_code code;
+    struct timespec start, end;
+    double linear_usec;
+    double compiled_usec;
+    double compile_usec;
+    int ret = 1;
+    int i;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "rules", 'r', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_rules, 0,
+                    "Number of HBAC rules", NULL },
+        { "services", 's', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_services, 0,
+                    "Number of distinct services in the rules", NULL },
+        { "iterations", 'i', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_iterations, 0,
+                    "Number of evaluations", NULL },
+        POPT_TABLEEND
+    };
+
+    /* parse the params */
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        switch (opt) {
+            default:
+                fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                        poptBadOption(pc, 0), poptStrerror(opt));
+                poptPrintUsage(pc, stderr, 0);
+                return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    if (pc_rules <= 0 || pc_services <= 0 || pc_iterations <= 0) {
+        fprintf(stderr, "All values must be positive\n");
+        return 1;
+    }
+
+    ctx = talloc_new(NULL);
+    if (ctx == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    rules = bench_rules(ctx, pc_rules, pc_services);
+    req = bench_request(ctx, pc_rules, pc_services);
+    if (rules == NULL || req == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        goto done;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < pc_iterations; i++) {
+        result = hbac_evaluate(rules, req, &info);
+        if (bench_check_result(result, info, "hbac_evaluate") != 0) {
+            goto done;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    linear_usec = bench_elapsed_usec(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    code = hbac_compile_rules(rules, &rule_set);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (code != HBAC_SUCCESS) {
+        fprintf(stderr, "hbac_compile_rules failed: %s\n",
+                hbac_error_string(code));
+        goto done;
+    }
+    compile_usec = bench_elapsed_usec(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < pc_iterations; i++) {
+        result = hbac_evaluate_rule_set(rule_set, req, &info);
+        if (bench_check_result(result, info,
+                               "hbac_evaluate_rule_set") != 0) {
+            goto done;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    compiled_usec = bench_elapsed_usec(&start, &end);
+
+    printf("%d rules, %d services, %d evaluations\n",
+           pc_rules, pc_services, pc_iterations);
+    printf("hbac_evaluate:          %10.2f us per evaluation\n",
+           linear_usec / pc_iterations);
+    printf("hbac_compile_rules:     %10.2f us\n", compile_usec);
+    printf("hbac_evaluate_rule_set: %10.2f us per evaluation\n",
+           compiled_usec / pc_iterations);
+
+    ret = 0;
+
+done:
+    hbac_free_rule_set(rule_set);
+    talloc_free(ctx);
+    return ret;
+}
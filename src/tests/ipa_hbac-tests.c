@@ -20,6 +20,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -862,6 +863,197 @@ START_TEST(ipa_hbac_test_incomplete)
 }
 END_TEST
 
+static void check_rule_set(struct hbac_rule **rules,
+                           struct hbac_eval_req *eval_req,
+                           enum hbac_eval_result expected,
+                           const char *expected_rule)
+{
+    enum hbac_eval_result result;
+    enum hbac_error_code code;
+    struct hbac_rule_set *rule_set = NULL;
+    struct hbac_info *info = NULL;
+
+    code = hbac_compile_rules(rules, &rule_set);
+    fail_unless(code == HBAC_SUCCESS,
+                "hbac_compile_rules failed: [%s]", hbac_error_string(code));
+
+    result = hbac_evaluate_rule_set(rule_set, eval_req, &info);
+    fail_unless(result == expected,
+                "Expected [%s], got [%s]; "
+                "Error: [%s]",
+                hbac_result_string(expected),
+                hbac_result_string(result),
+                info ? hbac_error_string(info->code):"Unknown");
+    if (expected_rule != NULL) {
+        fail_if(info->rule_name == NULL, "Missing rule name");
+        fail_unless(strcmp(info->rule_name, expected_rule) == 0,
+                    "Expected rule [%s], got [%s]",
+                    expected_rule, info->rule_name);
+    }
+    hbac_free_info(info);
+    info = NULL;
+
+    /* The result must not differ from evaluating all rules */
+    result = hbac_evaluate(rules, eval_req, &info);
+    fail_unless(result == expected,
+                "Expected [%s], got [%s] from hbac_evaluate",
+                hbac_result_string(expected),
+                hbac_result_string(result));
+    hbac_free_info(info);
+
+    hbac_free_rule_set(rule_set);
+}
+
+START_TEST(ipa_hbac_test_rule_set)
+{
+    TALLOC_CTX *test_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+
+    test_ctx = talloc_new(global_talloc_context);
+
+    /* Create a request */
+    eval_req = talloc_zero(test_ctx, struct hbac_eval_req);
+    fail_if (eval_req == NULL, "Failed to allocate memory");
+
+    get_test_user(eval_req, &eval_req->user);
+    get_test_service(eval_req, &eval_req->service);
+    get_test_srchost(eval_req, &eval_req->srchost);
+
+    rules = talloc_array(test_ctx, struct hbac_rule *, 5);
+    fail_if (rules == NULL, "Failed to allocate memory");
+
+    /* A rule for another service */
+    get_allow_all_rule(rules, &rules[0]);
+    rules[0]->name = talloc_strdup(rules[0], "Allow other service");
+    fail_if(rules[0]->name == NULL, "Failed to allocate memory");
+    rules[0]->services->category = HBAC_CATEGORY_NULL;
+    rules[0]->services->names = talloc_array(rules[0], const char *, 2);
+    fail_if(rules[0]->services->names == NULL, "Failed to allocate memory");
+    rules[0]->services->names[0] = HBAC_TEST_INVALID_SERVICE;
+    rules[0]->services->names[1] = NULL;
+
+    /* A disabled rule that would match */
+    get_allow_all_rule(rules, &rules[1]);
+    rules[1]->name = talloc_strdup(rules[1], "Disabled");
+    fail_if(rules[1]->name == NULL, "Failed to allocate memory");
+    rules[1]->enabled = false;
+
+    /* A rule for the service group, in a different case */
+    get_allow_all_rule(rules, &rules[2]);
+    rules[2]->name = talloc_strdup(rules[2], "Allow servicegroup");
+    fail_if(rules[2]->name == NULL, "Failed to allocate memory");
+    rules[2]->services->category = HBAC_CATEGORY_NULL;
+    rules[2]->services->groups = talloc_array(rules[2], const char *, 2);
+    fail_if(rules[2]->services->groups == NULL, "Failed to allocate memory");
+    rules[2]->services->groups[0] = "Login_Services";
+    rules[2]->services->groups[1] = NULL;
+
+    /* A rule with a non-ASCII service name */
+    get_allow_all_rule(rules, &rules[3]);
+    rules[3]->name = talloc_strdup(rules[3], "Allow UTF-8 service");
+    fail_if(rules[3]->name == NULL, "Failed to allocate memory");
+    rules[3]->services->category = HBAC_CATEGORY_NULL;
+    rules[3]->services->names = talloc_array(rules[3], const char *, 2);
+    fail_if(rules[3]->services->names == NULL, "Failed to allocate memory");
+    rules[3]->services->names[0] = (const char *) service_utf8_lowcase;
+    rules[3]->services->names[1] = NULL;
+
+    rules[4] = NULL;
+
+    check_rule_set(rules, eval_req, HBAC_EVAL_ALLOW, "Allow servicegroup");
+
+    /* Only the UTF-8 rule matches */
+    eval_req->service->name = (const char *) service_utf8_upcase;
+    eval_req->service->groups[0] = HBAC_TEST_INVALID_SERVICEGROUP;
+    check_rule_set(rules, eval_req, HBAC_EVAL_ALLOW, "Allow UTF-8 service");
+
+    /* No rule matches */
+    eval_req->service->name = HBAC_TEST_SERVICE;
+    check_rule_set(rules, eval_req, HBAC_EVAL_DENY, NULL);
+
+    /* An incomplete rule is always evaluated */
+    talloc_zfree(rules[1]->srchosts);
+    rules[1]->enabled = true;
+    check_rule_set(rules, eval_req, HBAC_EVAL_ERROR, "Disabled");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST(ipa_hbac_test_rule_set_candidates)
+{
+    TALLOC_CTX *test_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+    struct hbac_rule_set *rule_set = NULL;
+    enum hbac_error_code code;
+    size_t *idx = NULL;
+    size_t num;
+
+    test_ctx = talloc_new(global_talloc_context);
+
+    /* Create a request */
+    eval_req = talloc_zero(test_ctx, struct hbac_eval_req);
+    fail_if (eval_req == NULL, "Failed to allocate memory");
+
+    get_test_user(eval_req, &eval_req->user);
+    get_test_service(eval_req, &eval_req->service);
+    get_test_srchost(eval_req, &eval_req->srchost);
+
+    rules = talloc_array(test_ctx, struct hbac_rule *, 4);
+    fail_if (rules == NULL, "Failed to allocate memory");
+
+    /* A rule for another service */
+    get_allow_all_rule(rules, &rules[0]);
+    rules[0]->services->category = HBAC_CATEGORY_NULL;
+    rules[0]->services->names = talloc_array(rules[0], const char *, 2);
+    fail_if(rules[0]->services->names == NULL, "Failed to allocate memory");
+    rules[0]->services->names[0] = HBAC_TEST_INVALID_SERVICE;
+    rules[0]->services->names[1] = NULL;
+
+    /* A disabled rule */
+    get_allow_all_rule(rules, &rules[1]);
+    rules[1]->enabled = false;
+
+    /* A rule for all services */
+    get_allow_all_rule(rules, &rules[2]);
+
+    rules[3] = NULL;
+
+    code = hbac_compile_rules(rules, &rule_set);
+    fail_unless(code == HBAC_SUCCESS,
+                "hbac_compile_rules failed: [%s]", hbac_error_string(code));
+
+    /* The user elements are not needed to select the candidates */
+    talloc_zfree(rules[0]->users);
+    talloc_zfree(rules[2]->users);
+
+    code = hbac_rule_set_get_candidates(rule_set, eval_req, &idx, &num);
+    fail_unless(code == HBAC_SUCCESS,
+                "hbac_rule_set_get_candidates failed: [%s]",
+                hbac_error_string(code));
+    fail_unless(num == 1, "Expected 1 candidate, got %zu", num);
+    fail_unless(idx[0] == 2, "Expected candidate 2, got %zu", idx[0]);
+    free(idx);
+    idx = NULL;
+
+    eval_req->service->name = HBAC_TEST_INVALID_SERVICE;
+    code = hbac_rule_set_get_candidates(rule_set, eval_req, &idx, &num);
+    fail_unless(code == HBAC_SUCCESS,
+                "hbac_rule_set_get_candidates failed: [%s]",
+                hbac_error_string(code));
+    fail_unless(num == 2, "Expected 2 candidates, got %zu", num);
+    fail_unless(idx[0] == 0 && idx[1] == 2,
+                "Expected candidates 0 and 2, got %zu and %zu",
+                idx[0], idx[1]);
+    free(idx);
+
+    hbac_free_rule_set(rule_set);
+    talloc_free(test_ctx);
+}
+END_TEST
+
 Suite *hbac_test_suite (void)
 {
     Suite *s = suite_create ("HBAC");
@@ -880,6 +1072,8 @@ Suite *hbac_test_suite (void)
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_srchostgroup);
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_utf8);
     tcase_add_test(tc_hbac, ipa_hbac_test_incomplete);
+    tcase_add_test(tc_hbac, ipa_hbac_test_rule_set);
+    tcase_add_test(tc_hbac, ipa_hbac_test_rule_set_candidates);
 
     suite_add_tcase(s, tc_hbac);
     return s;
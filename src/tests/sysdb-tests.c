@@ -30,6 +30,7 @@
 #include <arpa/inet.h>
 #include "util/util.h"
 #include "util/crypto/sss_crypto.h"
+#include "util/s3crypt_pool.h"
 #include "db/sysdb_private.h"
 #include "db/sysdb_services.h"
 #include "db/sysdb_autofs.h"
@@ -2322,6 +2323,205 @@ START_TEST (test_sysdb_cached_authentication)
 }
 END_TEST
 
+static void test_cache_password_done(struct tevent_req *req)
+{
+    struct test_data *data = tevent_req_callback_data(req, struct test_data);
+
+    data->error = sysdb_cache_password_recv(req);
+    data->finished = true;
+    talloc_free(req);
+}
+
+static void test_cache_auth_done(struct tevent_req *req)
+{
+    struct test_data *data = tevent_req_callback_data(req, struct test_data);
+
+    data->error = sysdb_cache_auth_recv(req, NULL, NULL);
+    data->finished = true;
+    talloc_free(req);
+}
+
+static int test_cache_auth_async(struct test_data *data,
+                                 struct s3crypt_pool *pool,
+                                 const char *password)
+{
+    struct tevent_req *req;
+
+    req = sysdb_cache_auth_send(data, data->ev, pool, data->ctx->domain,
+                                data->username, password,
+                                data->ctx->confdb, false);
+    if (req == NULL) {
+        return ENOMEM;
+    }
+    tevent_req_set_callback(req, test_cache_auth_done, data);
+
+    data->finished = false;
+    while (!data->finished) {
+        tevent_loop_once(data->ev);
+    }
+
+    return data->error;
+}
+
+START_TEST (test_sysdb_cached_authentication_pool)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct s3crypt_pool *pool;
+    struct test_data *data;
+    struct tevent_req *req;
+    const char *val[2] = { "0", NULL };
+    int ret;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    fail_unless(ret == EOK, "Could not set up the test");
+
+    data = test_data_new_user(test_ctx, _i);
+    fail_if(data == NULL, "OOM\n");
+
+    ret = confdb_add_param(test_ctx->confdb, true, CONFDB_PAM_CONF_ENTRY,
+                           CONFDB_PAM_CRED_TIMEOUT, val);
+    fail_unless(ret == EOK, "Could not initialize provider");
+
+    ret = s3crypt_pool_init(test_ctx, test_ctx->ev, 2, &pool);
+    fail_unless(ret == EOK, "s3crypt_pool_init failed [%d].", ret);
+
+    req = sysdb_cache_password_send(data, data->ev, pool, test_ctx->domain,
+                                    data->username, "pool_password",
+                                    SSS_AUTHTOK_TYPE_PASSWORD, 0);
+    fail_if(req == NULL, "OOM\n");
+    tevent_req_set_callback(req, test_cache_password_done, data);
+
+    while (!data->finished) {
+        tevent_loop_once(data->ev);
+    }
+    fail_unless(data->error == EOK,
+                "sysdb_cache_password_send failed [%d].", data->error);
+
+    /* The hash computed in the pool is verified by the synchronous code */
+    ret = sysdb_cache_auth(test_ctx->domain, data->username, "pool_password",
+                           test_ctx->confdb, true, NULL, NULL);
+    fail_unless(ret == EOK, "sysdb_cache_auth failed [%d].", ret);
+
+    ret = test_cache_auth_async(data, pool, "pool_password");
+    fail_unless(ret == EOK, "sysdb_cache_auth_send failed [%d].", ret);
+
+    ret = test_cache_auth_async(data, pool, "wrong_password");
+    fail_unless(ret == ERR_AUTH_FAILED,
+                "sysdb_cache_auth_send returned [%d], expected [%d].",
+                ret, ERR_AUTH_FAILED);
+
+    /* Without a pool the hash is computed synchronously */
+    ret = test_cache_auth_async(data, NULL, "pool_password");
+    fail_unless(ret == EOK, "sysdb_cache_auth_send failed [%d].", ret);
+
+    /* A request freed while its hash is computed must not crash the
+     * pool */
+    req = sysdb_cache_auth_send(data, data->ev, pool, test_ctx->domain,
+                                data->username, "pool_password",
+                                test_ctx->confdb, false);
+    fail_if(req == NULL, "OOM\n");
+    talloc_free(req);
+
+    ret = test_cache_auth_async(data, pool, "pool_password");
+    fail_unless(ret == EOK, "sysdb_cache_auth_send failed [%d].", ret);
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+struct test_cache_auth_race {
+    bool finished;
+    int error;
+    time_t delayed_until;
+};
+
+static void test_cache_auth_race_done(struct tevent_req *req)
+{
+    struct test_cache_auth_race *res;
+
+    res = tevent_req_callback_data(req, struct test_cache_auth_race);
+    res->error = sysdb_cache_auth_recv(req, NULL, &res->delayed_until);
+    res->finished = true;
+    talloc_free(req);
+}
+
+START_TEST (test_sysdb_cached_authentication_lockout_race)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct test_data *data;
+    struct tevent_req *req;
+    struct test_cache_auth_race res[3];
+    const char *passwords[3] = { "wrong_password", "wrong_password",
+                                 "race_password" };
+    const char *val[2] = { "0", NULL };
+    const char *attempts[2] = { "2", NULL };
+    const char *delay[2] = { "5", NULL };
+    const char *attrs[] = { SYSDB_FAILED_LOGIN_ATTEMPTS, NULL };
+    struct ldb_message *msg;
+    size_t i;
+    int ret;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    fail_unless(ret == EOK, "Could not set up the test");
+
+    data = test_data_new_user(test_ctx, _i);
+    fail_if(data == NULL, "OOM\n");
+
+    ret = confdb_add_param(test_ctx->confdb, true, CONFDB_PAM_CONF_ENTRY,
+                           CONFDB_PAM_CRED_TIMEOUT, val);
+    fail_unless(ret == EOK, "Could not initialize provider");
+    ret = confdb_add_param(test_ctx->confdb, true, CONFDB_PAM_CONF_ENTRY,
+                           CONFDB_PAM_FAILED_LOGIN_ATTEMPTS, attempts);
+    fail_unless(ret == EOK, "Could not initialize provider");
+    ret = confdb_add_param(test_ctx->confdb, true, CONFDB_PAM_CONF_ENTRY,
+                           CONFDB_PAM_FAILED_LOGIN_DELAY, delay);
+    fail_unless(ret == EOK, "Could not initialize provider");
+
+    ret = sysdb_cache_password(test_ctx->domain, data->username,
+                               "race_password");
+    fail_unless(ret == EOK, "sysdb_cache_password failed [%d].", ret);
+
+    /* All attempts pass the initial lockout check before any result is
+     * stored. Without a pool the hashes are delivered in this order, so
+     * the two wrong passwords lock the account before the right one is
+     * recorded. */
+    memset(res, 0, sizeof(res));
+    for (i = 0; i < 3; i++) {
+        req = sysdb_cache_auth_send(data, data->ev, NULL, test_ctx->domain,
+                                    data->username, passwords[i],
+                                    test_ctx->confdb, false);
+        fail_if(req == NULL, "OOM\n");
+        tevent_req_set_callback(req, test_cache_auth_race_done, &res[i]);
+    }
+
+    while (!res[0].finished || !res[1].finished || !res[2].finished) {
+        tevent_loop_once(data->ev);
+    }
+
+    fail_unless(res[0].error == ERR_AUTH_FAILED,
+                "First attempt returned [%d].", res[0].error);
+    fail_unless(res[1].error == ERR_AUTH_FAILED,
+                "Second attempt returned [%d].", res[1].error);
+    fail_unless(res[2].error == ERR_AUTH_DENIED,
+                "The right password returned [%d], expected [%d].",
+                res[2].error, ERR_AUTH_DENIED);
+    fail_unless(res[2].delayed_until > time(NULL),
+                "Login is not delayed.");
+
+    /* The lockout was not reset by the right password */
+    ret = sysdb_search_user_by_name(test_ctx, test_ctx->domain,
+                                    data->username, attrs, &msg);
+    fail_unless(ret == EOK, "sysdb_search_user_by_name failed [%d].", ret);
+    fail_unless(ldb_msg_find_attr_as_uint(msg, SYSDB_FAILED_LOGIN_ATTEMPTS,
+                                          0) == 2,
+                "Unexpected number of failed login attempts.");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST (test_sysdb_prepare_asq_test_user)
 {
     struct sysdb_test_ctx *test_ctx;
@@ -6227,6 +6427,10 @@ START_TEST(test_sysdb_search_user_by_cert)
     struct test_data *data2;
     const char *name;
     const char *name2;
+    struct sysdb_attrs *mapped_attrs;
+    const char *hash_attrs[] = { SYSDB_USER_MAPPED_CERT_HASH, NULL };
+    const char *hash;
+    char *exp_hash;
 
     /* Setup */
     ret = setup_sysdb_tests(&test_ctx);
@@ -6246,6 +6450,21 @@ START_TEST(test_sysdb_search_user_by_cert)
     fail_unless(ret == EOK, "sysdb_add_user failed with [%d][%s].",
                 ret, strerror(ret));
 
+    /* The hash of the certificate is stored for the index lookup */
+    ret = sysdb_get_user_attr(test_ctx, test_ctx->domain, data->username,
+                              hash_attrs, &res);
+    fail_unless(ret == EOK, "sysdb_get_user_attr failed with [%d][%s].",
+                ret, strerror(ret));
+    fail_unless(res->count == 1, "Unexpected number of results, "
+                                 "expected [%u], get [%u].", 1, res->count);
+    exp_hash = sss_sha256_hex(test_ctx, val.data, val.length);
+    fail_unless(exp_hash != NULL, "sss_sha256_hex failed.");
+    hash = ldb_msg_find_attr_as_string(res->msgs[0],
+                                       SYSDB_USER_MAPPED_CERT_HASH, NULL);
+    fail_unless(hash != NULL && strcmp(hash, exp_hash) == 0,
+                "Unexpected certificate hash, expected [%s], got [%s].",
+                exp_hash, hash == NULL ? "-" : hash);
+
     ret = sysdb_search_user_by_cert(test_ctx, test_ctx->domain, "ABA=", &res);
     fail_unless(ret == ENOENT,
                 "Unexpected return code from sysdb_search_user_by_cert for "
@@ -6292,6 +6511,32 @@ START_TEST(test_sysdb_search_user_by_cert)
                 "Unexpected names found, expected [%s,%s], got [%s,%s].",
                 data->username, data2->username, name, name2);
 
+    /* Removing the certificate removes the hash as well */
+    mapped_attrs = sysdb_new_attrs(test_ctx);
+    fail_if(mapped_attrs == NULL, "Failed to allocate memory");
+
+    ret = sysdb_attrs_add_val(mapped_attrs, SYSDB_USER_MAPPED_CERT, &val);
+    fail_unless(ret == EOK, "sysdb_attrs_add_val failed with [%d][%s].",
+                ret, strerror(ret));
+
+    ret = sysdb_remove_mapped_data(test_ctx->domain, mapped_attrs);
+    fail_unless(ret == EOK, "sysdb_remove_mapped_data failed with [%d][%s].",
+                ret, strerror(ret));
+
+    ret = sysdb_get_user_attr(test_ctx, test_ctx->domain, data->username,
+                              hash_attrs, &res);
+    fail_unless(ret == EOK, "sysdb_get_user_attr failed with [%d][%s].",
+                ret, strerror(ret));
+    fail_unless(ldb_msg_find_element(res->msgs[0],
+                                     SYSDB_USER_MAPPED_CERT_HASH) == NULL,
+                "Certificate hash still present.");
+
+    ret = sysdb_search_user_by_cert(test_ctx, test_ctx->domain,
+                                    TEST_USER_CERT_DERB64, &res);
+    fail_unless(ret == ENOENT,
+                "Unexpected return code from sysdb_search_user_by_cert for "
+                "removed certificate, expected [%d], got [%d].", ENOENT, ret);
+
     talloc_free(test_ctx);
 }
 END_TEST
@@ -7916,6 +8161,13 @@ Suite *create_sysdb_suite(void)
 
     tcase_add_loop_test(tc_sysdb, test_sysdb_cache_password_ex, 27010, 27011);
 
+    /* Hash cached passwords in worker threads */
+    tcase_add_loop_test(tc_sysdb, test_sysdb_cached_authentication_pool,
+                        27010, 27011);
+    tcase_add_loop_test(tc_sysdb,
+                        test_sysdb_cached_authentication_lockout_race,
+                        27010, 27011);
+
     /* ASQ search test */
     tcase_add_loop_test(tc_sysdb, test_sysdb_prepare_asq_test_user, 28011, 28020);
     tcase_add_test(tc_sysdb, test_sysdb_asq_search);
@@ -58,3 +58,60 @@ ssize_t sss_atomic_io_s(int fd, void *buf, size_t n, bool do_read)
 
     return pos;
 }
+
+ssize_t sss_atomic_read_frame_s(int fd, void *buf, size_t max)
+{
+    uint32_t len;
+    ssize_t res;
+
+    errno = 0;
+    res = sss_atomic_read_s(fd, &len, sizeof(len));
+    if (res == -1) {
+        return -1;
+    } else if (res == 0) {
+        errno = 0;
+        return 0;
+    } else if (res != (ssize_t) sizeof(len)) {
+        errno = EIO;
+        return -1;
+    }
+
+    if (len > max) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    res = sss_atomic_read_s(fd, buf, len);
+    if (res == -1) {
+        return -1;
+    } else if (res != (ssize_t) len) {
+        errno = EIO;
+        return -1;
+    }
+
+    return res;
+}
+
+ssize_t sss_atomic_write_frame_s(int fd, void *buf, size_t n)
+{
+    uint32_t len;
+    ssize_t res;
+
+    if (n > UINT32_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    len = n;
+
+    res = sss_atomic_write_s(fd, &len, sizeof(len));
+    if (res != (ssize_t) sizeof(len)) {
+        return -1;
+    }
+
+    res = sss_atomic_write_s(fd, buf, n);
+    if (res != (ssize_t) n) {
+        return -1;
+    }
+
+    return res;
+}
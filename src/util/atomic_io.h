@@ -22,6 +22,7 @@
 #define __SSSD_ATOMIC_IO_H__
 
 #include <unistd.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <poll.h>
 #include <errno.h>
@@ -37,4 +38,16 @@ ssize_t sss_atomic_io_s(int fd, void *buf, size_t n, bool do_read);
 #define sss_atomic_read_s(fd, buf, n)  sss_atomic_io_s(fd, buf, n, true)
 #define sss_atomic_write_s(fd, buf, n) sss_atomic_io_s(fd, buf, n, false)
 
+/* Read or write one frame, i.e. a uint32_t length in host byte order
+ * followed by that many bytes. Frames let a long running child process
+ * handle several requests over the same pair of pipes.
+ *
+ * sss_atomic_read_frame_s() returns the length of the payload stored in buf
+ * or 0 with errno set to 0 if the other side closed the pipe before a new
+ * frame started. If the payload is larger than max, -1 is returned and errno
+ * is set to EMSGSIZE. A truncated frame sets errno to EIO.
+ */
+ssize_t sss_atomic_read_frame_s(int fd, void *buf, size_t max);
+ssize_t sss_atomic_write_frame_s(int fd, void *buf, size_t n);
+
 #endif /* __SSSD_ATOMIC_IO_H__ */
@@ -521,6 +521,163 @@ int read_pipe_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+struct tevent_req *write_pipe_frame_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         uint8_t *buf, size_t len, int fd)
+{
+    struct tevent_req *req;
+    uint8_t *frame;
+    uint32_t frame_len;
+    size_t p = 0;
+
+    if (len > UINT32_MAX) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "Message too large [%zu]\n", len);
+        return NULL;
+    }
+    frame_len = len;
+
+    frame = talloc_size(mem_ctx, sizeof(frame_len) + len);
+    if (frame == NULL) {
+        return NULL;
+    }
+
+    safealign_memcpy(&frame[p], &frame_len, sizeof(frame_len), &p);
+    safealign_memcpy(&frame[p], buf, len, &p);
+
+    req = write_pipe_send(mem_ctx, ev, frame, p, fd);
+    if (req == NULL) {
+        talloc_free(frame);
+        return NULL;
+    }
+    talloc_steal(req, frame);
+
+    return req;
+}
+
+struct read_pipe_frame_state {
+    int fd;
+    uint32_t frame_len;
+    size_t hdr_read;
+    uint8_t *buf;
+    size_t len;
+};
+
+static void read_pipe_frame_handler(struct tevent_context *ev,
+                                    struct tevent_fd *fde,
+                                    uint16_t flags, void *pvt);
+
+struct tevent_req *read_pipe_frame_send(TALLOC_CTX *mem_ctx,
+                                        struct tevent_context *ev, int fd)
+{
+    struct tevent_req *req;
+    struct read_pipe_frame_state *state;
+    struct tevent_fd *fde;
+
+    req = tevent_req_create(mem_ctx, &state, struct read_pipe_frame_state);
+    if (req == NULL) return NULL;
+
+    state->fd = fd;
+
+    fde = tevent_add_fd(ev, state, fd, TEVENT_FD_READ,
+                        read_pipe_frame_handler, req);
+    if (fde == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_add_fd failed.\n");
+        talloc_zfree(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+static void read_pipe_frame_handler(struct tevent_context *ev,
+                                    struct tevent_fd *fde,
+                                    uint16_t flags, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct read_pipe_frame_state *state;
+    bool in_header;
+    uint8_t *dest;
+    size_t want;
+    ssize_t size;
+    errno_t err;
+
+    state = tevent_req_data(req, struct read_pipe_frame_state);
+
+    if (flags & TEVENT_FD_WRITE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "read_pipe_frame_handler called with "
+              "TEVENT_FD_WRITE, this should not happen.\n");
+        tevent_req_error(req, EINVAL);
+        return;
+    }
+
+    /* The frame is read piecewise as the data arrives so that a slow
+     * child does not block the event loop. */
+    in_header = state->hdr_read < sizeof(state->frame_len);
+    if (in_header) {
+        dest = (uint8_t *) &state->frame_len + state->hdr_read;
+        want = sizeof(state->frame_len) - state->hdr_read;
+    } else {
+        dest = state->buf + state->len;
+        want = state->frame_len - state->len;
+    }
+
+    size = read(state->fd, dest, want);
+    if (size == -1) {
+        err = errno;
+        if (err == EINTR || err == EAGAIN || err == EWOULDBLOCK) {
+            return;
+        }
+
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              "read failed [%d][%s].\n", err, strerror(err));
+        talloc_free(fde);
+        tevent_req_error(req, err);
+        return;
+    } else if (size == 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "EOF received before the end of the "
+              "frame, the child probably exited\n");
+        talloc_free(fde);
+        tevent_req_error(req, EPIPE);
+        return;
+    }
+
+    if (in_header) {
+        state->hdr_read += size;
+        if (state->hdr_read < sizeof(state->frame_len)) {
+            return;
+        }
+
+        state->buf = talloc_array(state, uint8_t, state->frame_len);
+        if (state->buf == NULL) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+    } else {
+        state->len += size;
+    }
+
+    if (state->len == state->frame_len) {
+        DEBUG(SSSDBG_TRACE_FUNC, "Received frame of %zu bytes\n", state->len);
+        /* The next frame belongs to the next reader. */
+        talloc_free(fde);
+        tevent_req_done(req);
+    }
+}
+
+int read_pipe_frame_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
+                         uint8_t **buf, ssize_t *len)
+{
+    struct read_pipe_frame_state *state;
+    state = tevent_req_data(req, struct read_pipe_frame_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *buf = talloc_steal(mem_ctx, state->buf);
+    *len = state->len;
+
+    return EOK;
+}
+
 static void child_invoke_callback(struct tevent_context *ev,
                                   struct tevent_immediate *imm,
                                   void *pvt);
@@ -100,6 +100,18 @@ struct tevent_req *read_pipe_send(TALLOC_CTX *mem_ctx,
 int read_pipe_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
                    uint8_t **buf, ssize_t *len);
 
+/* Framed variants for children which handle several requests over the same
+ * pipes, see sss_atomic_read_frame_s(). The result of write_pipe_frame_send()
+ * is received with write_pipe_recv(). */
+struct tevent_req *write_pipe_frame_send(TALLOC_CTX *mem_ctx,
+                                         struct tevent_context *ev,
+                                         uint8_t *buf, size_t len, int fd);
+
+struct tevent_req *read_pipe_frame_send(TALLOC_CTX *mem_ctx,
+                                        struct tevent_context *ev, int fd);
+int read_pipe_frame_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
+                         uint8_t **buf, ssize_t *len);
+
 /* The pipes to communicate with the child must be nonblocking */
 void fd_nonblocking(int fd);
 
@@ -0,0 +1,69 @@
+/*
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "util/util.h"
+#include "util/crypto/sss_crypto.h"
+
+
+int sss_sha256(const uint8_t *in, size_t in_len, uint8_t *out)
+{
+    unsigned int res_len = 0;
+    unsigned char md[EVP_MAX_MD_SIZE];
+
+    if ((in == NULL) || (in_len == 0) || (out == NULL)) {
+        return EINVAL;
+    }
+
+    if (!EVP_Digest(in, in_len, md, &res_len, EVP_sha256(), NULL)) {
+        return EINVAL;
+    }
+
+    if (res_len != SSS_SHA256_LENGTH) {
+        return EINVAL;
+    }
+
+    memcpy(out, md, SSS_SHA256_LENGTH);
+
+    return EOK;
+}
+
+char *sss_sha256_hex(TALLOC_CTX *mem_ctx, const uint8_t *in, size_t in_len)
+{
+    uint8_t md[SSS_SHA256_LENGTH];
+    char *hex;
+    size_t c;
+    int ret;
+
+    ret = sss_sha256(in, in_len, md);
+    if (ret != EOK) {
+        return NULL;
+    }
+
+    hex = talloc_array(mem_ctx, char, 2 * SSS_SHA256_LENGTH + 1);
+    if (hex == NULL) {
+        return NULL;
+    }
+
+    for (c = 0; c < SSS_SHA256_LENGTH; c++) {
+        snprintf(hex + 2 * c, 3, "%02x", md[c]);
+    }
+
+    return hex;
+}
@@ -329,13 +329,24 @@ done:
     return ret;
 }
 
+size_t s3crypt_sha512_len(const char *salt)
+{
+    return (sizeof (sha512_salt_prefix) - 1
+            + sizeof (sha512_rounds_prefix) + 9 + 1
+            + strlen (salt) + 1 + 86 + 1);
+}
+
+int s3crypt_sha512_r(const char *key, const char *salt,
+                     char *buffer, size_t buflen)
+{
+    return sha512_crypt_r(key, salt, buffer, buflen);
+}
+
 int s3crypt_sha512(TALLOC_CTX *memctx,
                    const char *key, const char *salt, char **_hash)
 {
     char *hash;
-    int hlen = (sizeof (sha512_salt_prefix) - 1
-                + sizeof (sha512_rounds_prefix) + 9 + 1
-                + strlen (salt) + 1 + 86 + 1);
+    size_t hlen = s3crypt_sha512_len(salt);
     int ret;
 
     hash = talloc_size(memctx, hlen);
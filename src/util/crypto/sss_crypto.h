@@ -30,6 +30,14 @@ int sss_generate_csprng_buffer(uint8_t *buf, size_t size);
 
 int s3crypt_sha512(TALLOC_CTX *mmectx,
                    const char *key, const char *salt, char **_hash);
+
+/* Size of the buffer needed by s3crypt_sha512_r() for the given salt. */
+size_t s3crypt_sha512_len(const char *salt);
+
+/* Same as s3crypt_sha512() but writes the hash to the caller's buffer and
+ * does not allocate any memory, so it can be called from other threads. */
+int s3crypt_sha512_r(const char *key, const char *salt,
+                     char *buffer, size_t buflen);
 int s3crypt_gen_salt(TALLOC_CTX *memctx, char **_salt);
 
 /* Methods of obfuscation. */
@@ -54,6 +62,13 @@ int sss_hmac_sha1(const unsigned char *key,
                   size_t in_len,
                   unsigned char *out);
 
+#define SSS_SHA256_LENGTH 32
+
+int sss_sha256(const uint8_t *in, size_t in_len, uint8_t *out);
+
+/* Returns the SHA-256 hash of the input as lower-case hex string. */
+char *sss_sha256_hex(TALLOC_CTX *mem_ctx, const uint8_t *in, size_t in_len);
+
 int sss_password_encrypt(TALLOC_CTX *mem_ctx, const char *password, int plen,
                          enum obfmethod meth, char **obfpwd);
 
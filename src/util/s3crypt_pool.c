@@ -0,0 +1,419 @@
+/*
+    SSSD
+
+    Computing password hashes in worker threads
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <talloc.h>
+#include <tevent.h>
+
+#include "util/util.h"
+#include "util/crypto/sss_crypto.h"
+#include "util/s3crypt_pool.h"
+
+#define S3CRYPT_POOL_MAX_THREADS 4
+
+enum s3crypt_job_status {
+    S3CRYPT_JOB_QUEUED,
+    S3CRYPT_JOB_RUNNING,
+    S3CRYPT_JOB_DONE
+};
+
+/* The worker threads never call talloc. They only read key and salt and
+ * write hash and ret of a job they took from the queue. Everything else is
+ * touched by the main thread only. */
+struct s3crypt_job {
+    char *key;
+    char *salt;
+    char *hash;
+    size_t hash_len;
+    int ret;
+
+    /* protected by pool->lock */
+    enum s3crypt_job_status status;
+    struct s3crypt_job *prev;
+    struct s3crypt_job *next;
+
+    /* NULL if the request was freed before the job finished */
+    struct tevent_req *req;
+};
+
+struct s3crypt_pool {
+    struct tevent_context *ev;
+    struct tevent_fd *fde;
+    int pipefd[2];
+
+    pthread_t *threads;
+    int num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool shutdown;
+    struct s3crypt_job *queue;
+    struct s3crypt_job *done;
+};
+
+struct s3crypt_sha512_state {
+    struct s3crypt_job *job;
+    char *hash;
+};
+
+static void *s3crypt_pool_worker(void *pvt)
+{
+    struct s3crypt_pool *pool = (struct s3crypt_pool *) pvt;
+    struct s3crypt_job *job;
+    char c = 0;
+    ssize_t len;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->queue == NULL && !pool->shutdown) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+
+        if (pool->shutdown) {
+            break;
+        }
+
+        job = pool->queue;
+        DLIST_REMOVE(pool->queue, job);
+        job->status = S3CRYPT_JOB_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        job->ret = s3crypt_sha512_r(job->key, job->salt,
+                                    job->hash, job->hash_len);
+
+        pthread_mutex_lock(&pool->lock);
+        job->status = S3CRYPT_JOB_DONE;
+        DLIST_ADD_END(pool->done, job, struct s3crypt_job *);
+
+        /* Wake up the main thread. The pipe is non-blocking, if it is
+         * full the main thread will pick this job up together with the
+         * others. */
+        len = write(pool->pipefd[1], &c, 1);
+        (void) len;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void s3crypt_job_finish(struct s3crypt_job *job)
+{
+    struct s3crypt_sha512_state *state;
+    struct tevent_req *req = job->req;
+    errno_t ret = job->ret;
+
+    if (req == NULL) {
+        /* The request is gone, nobody is interested in the result. */
+        talloc_free(job);
+        return;
+    }
+
+    state = tevent_req_data(req, struct s3crypt_sha512_state);
+    state->job = NULL;
+
+    if (ret == EOK) {
+        state->hash = talloc_steal(state, job->hash);
+    }
+    talloc_free(job);
+
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static void s3crypt_pool_done_handler(struct tevent_context *ev,
+                                      struct tevent_fd *fde,
+                                      uint16_t flags, void *pvt)
+{
+    struct s3crypt_pool *pool = talloc_get_type(pvt, struct s3crypt_pool);
+    struct s3crypt_job *done;
+    struct s3crypt_job *job;
+    char buf[64];
+    ssize_t len;
+
+    do {
+        len = read(pool->pipefd[0], buf, sizeof(buf));
+    } while (len > 0 || (len == -1 && errno == EINTR));
+
+    pthread_mutex_lock(&pool->lock);
+    done = pool->done;
+    pool->done = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (done != NULL) {
+        job = done;
+        DLIST_REMOVE(done, job);
+        s3crypt_job_finish(job);
+    }
+}
+
+static int s3crypt_pool_destructor(struct s3crypt_pool *pool)
+{
+    struct s3crypt_sha512_state *state;
+    struct s3crypt_job *lists[2];
+    struct s3crypt_job *job;
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    /* The jobs are freed together with the pool, detach the requests
+     * which are still waiting for them. */
+    lists[0] = pool->queue;
+    lists[1] = pool->done;
+    for (i = 0; i < 2; i++) {
+        DLIST_FOR_EACH(job, lists[i]) {
+            if (job->req != NULL) {
+                state = tevent_req_data(job->req, struct s3crypt_sha512_state);
+                state->job = NULL;
+            }
+        }
+    }
+
+    talloc_zfree(pool->fde);
+    PIPE_CLOSE(pool->pipefd);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+
+    return 0;
+}
+
+errno_t s3crypt_pool_init(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          int num_threads,
+                          struct s3crypt_pool **_pool)
+{
+    struct s3crypt_pool *pool;
+    sigset_t sigmask;
+    sigset_t oldmask;
+    long ncpus;
+    errno_t ret;
+    int i;
+
+    if (num_threads <= 0) {
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = ncpus > 0 ? MIN(ncpus, S3CRYPT_POOL_MAX_THREADS) : 1;
+    }
+
+    pool = talloc_zero(mem_ctx, struct s3crypt_pool);
+    if (pool == NULL) {
+        return ENOMEM;
+    }
+
+    pool->ev = ev;
+    pool->pipefd[0] = -1;
+    pool->pipefd[1] = -1;
+
+    pool->threads = talloc_zero_array(pool, pthread_t, num_threads);
+    if (pool->threads == NULL) {
+        talloc_free(pool);
+        return ENOMEM;
+    }
+
+    ret = pthread_mutex_init(&pool->lock, NULL);
+    if (ret != 0) {
+        talloc_free(pool);
+        return ret;
+    }
+
+    ret = pthread_cond_init(&pool->cond, NULL);
+    if (ret != 0) {
+        pthread_mutex_destroy(&pool->lock);
+        talloc_free(pool);
+        return ret;
+    }
+
+    talloc_set_destructor(pool, s3crypt_pool_destructor);
+
+    ret = pipe(pool->pipefd);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, "pipe failed [%d]: %s\n",
+              ret, sss_strerror(ret));
+        goto done;
+    }
+
+    sss_fd_nonblocking(pool->pipefd[0]);
+    sss_fd_nonblocking(pool->pipefd[1]);
+
+    pool->fde = tevent_add_fd(ev, pool, pool->pipefd[0], TEVENT_FD_READ,
+                              s3crypt_pool_done_handler, pool);
+    if (pool->fde == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* The worker threads inherit the signal mask, signals must be handled
+     * by the main thread only. */
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+
+    for (i = 0; i < num_threads; i++) {
+        ret = pthread_create(&pool->threads[i], NULL,
+                             s3crypt_pool_worker, pool);
+        if (ret != 0) {
+            DEBUG(SSSDBG_CRIT_FAILURE, "pthread_create failed [%d]: %s\n",
+                  ret, sss_strerror(ret));
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+
+    if (pool->num_threads == 0) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, "Started %d password hashing threads\n",
+          pool->num_threads);
+
+    *_pool = pool;
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        talloc_free(pool);
+    }
+
+    return ret;
+}
+
+static int s3crypt_sha512_state_destructor(struct s3crypt_sha512_state *state)
+{
+    struct s3crypt_pool *pool;
+    struct s3crypt_job *job = state->job;
+
+    if (job == NULL) {
+        return 0;
+    }
+
+    pool = talloc_get_type(talloc_parent(job), struct s3crypt_pool);
+
+    pthread_mutex_lock(&pool->lock);
+    if (job->status == S3CRYPT_JOB_QUEUED) {
+        DLIST_REMOVE(pool->queue, job);
+        pthread_mutex_unlock(&pool->lock);
+        talloc_free(job);
+        return 0;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    /* A worker is using the job or it waits for the main thread, it will
+     * be freed in s3crypt_job_finish(). */
+    job->req = NULL;
+    return 0;
+}
+
+struct tevent_req *s3crypt_sha512_send(TALLOC_CTX *mem_ctx,
+                                       struct tevent_context *ev,
+                                       struct s3crypt_pool *pool,
+                                       const char *key,
+                                       const char *salt)
+{
+    struct s3crypt_sha512_state *state;
+    struct s3crypt_job *job;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct s3crypt_sha512_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, "tevent_req_create() failed\n");
+        return NULL;
+    }
+
+    if (pool == NULL) {
+        ret = s3crypt_sha512(state, key, salt, &state->hash);
+        goto immediately;
+    }
+
+    job = talloc_zero(pool, struct s3crypt_job);
+    if (job == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    job->key = talloc_strdup(job, key);
+    job->salt = talloc_strdup(job, salt);
+    if (job->key == NULL || job->salt == NULL) {
+        talloc_free(job);
+        ret = ENOMEM;
+        goto immediately;
+    }
+    talloc_set_destructor((TALLOC_CTX *) job->key,
+                          sss_erase_talloc_mem_securely);
+
+    job->hash_len = s3crypt_sha512_len(salt);
+    job->hash = talloc_zero_size(job, job->hash_len);
+    if (job->hash == NULL) {
+        talloc_free(job);
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    job->req = req;
+    job->status = S3CRYPT_JOB_QUEUED;
+    state->job = job;
+    talloc_set_destructor(state, s3crypt_sha512_state_destructor);
+
+    pthread_mutex_lock(&pool->lock);
+    DLIST_ADD_END(pool->queue, job, struct s3crypt_job *);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+errno_t s3crypt_sha512_recv(TALLOC_CTX *mem_ctx,
+                            struct tevent_req *req,
+                            char **_hash)
+{
+    struct s3crypt_sha512_state *state;
+
+    state = tevent_req_data(req, struct s3crypt_sha512_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *_hash = talloc_steal(mem_ctx, state->hash);
+
+    return EOK;
+}
@@ -0,0 +1,54 @@
+/*
+    SSSD
+
+    Computing password hashes in worker threads
+
+    Copyright (C) 2026 Red Hat
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __S3CRYPT_POOL_H__
+#define __S3CRYPT_POOL_H__
+
+#include <talloc.h>
+#include <tevent.h>
+
+#include "util/util.h"
+
+/* Hashing a password with s3crypt_sha512() takes several milliseconds on
+ * purpose. The pool runs it in worker threads so that the event loop can
+ * serve other requests meanwhile. The threads only run the hash function,
+ * all talloc and sysdb operations stay in the main thread. */
+struct s3crypt_pool;
+
+/* Starts up to num_threads worker threads, 0 means one per CPU up to a
+ * small limit. */
+errno_t s3crypt_pool_init(TALLOC_CTX *mem_ctx,
+                          struct tevent_context *ev,
+                          int num_threads,
+                          struct s3crypt_pool **_pool);
+
+/* If pool is NULL the hash is computed synchronously. */
+struct tevent_req *s3crypt_sha512_send(TALLOC_CTX *mem_ctx,
+                                       struct tevent_context *ev,
+                                       struct s3crypt_pool *pool,
+                                       const char *key,
+                                       const char *salt);
+
+errno_t s3crypt_sha512_recv(TALLOC_CTX *mem_ctx,
+                            struct tevent_req *req,
+                            char **_hash);
+
+#endif /* __S3CRYPT_POOL_H__ */